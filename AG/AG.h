@@ -21,6 +21,8 @@
 #include "libsyndicate/libsyndicate.h"
 #include "libsyndicate/ms/ms-client.h"
 
+#include "fs-map.h"
+
 // basic types 
 typedef map<string, string> AG_config_t;
 
@@ -28,7 +30,7 @@ typedef map<string, string> AG_config_t;
 typedef map<string, struct AG_driver*> AG_driver_map_t;
 
 // map path to AG_map_info 
-typedef map<string, struct AG_map_info*> AG_fs_map_t;
+typedef AG_fs_map AG_fs_map_t;
 
 
 #endif
@@ -39,6 +39,20 @@ int AG_cache_get_manifest( struct AG_state* state, char const* path, int64_t fil
    return rc;
 }
 
+// open a serialized manifest in the cache
+int AG_cache_open_manifest( struct AG_state* state, char const* path, int64_t file_version, int64_t mtime_sec, int32_t mtime_nsec, off_t* serialized_manifest_len ) {
+   
+   char* manifest_path = md_fullpath( path, "/manifest", NULL );
+   if( manifest_path == NULL ) {
+      return -ENOMEM;
+   }
+   
+   int rc = AG_cache_open_block( state, manifest_path, file_version, (uint64_t)mtime_sec, (int64_t)mtime_nsec, serialized_manifest_len );
+   
+   free( manifest_path );
+   return rc;
+}
+
 // promote a serialized manifest
 int AG_cache_promote_manifest( struct AG_state* state, char const* path, int64_t file_version, int64_t mtime_sec, int32_t mtime_nsec ) {
    
@@ -120,6 +134,55 @@ int AG_cache_get_block( struct AG_state* state, char const* path, int64_t file_v
    return 0;
 }
 
+// open a block in the cache, so it can be sent without reading it into RAM
+// return the file descriptor on success (which the caller must close), and set *block_len to the block's size
+// return -ENOENT on miss, including when the block is still being written
+// return negative on error
+int AG_cache_open_block( struct AG_state* state, char const* path, int64_t file_version, uint64_t block_id, int64_t block_version, off_t* block_len ) {
+   
+   // convert path into a file_id 
+   uint64_t file_id = AG_cache_file_id( path );
+   
+   struct stat sb;
+   
+   // don't send a partially-written block 
+   int rc = md_cache_is_block_readable( state->cache, file_id, file_version, block_id, block_version );
+   if( rc != 0 ) {
+      
+      SG_debug("CACHE MISS (writing) %s.%" PRId64 ".%" PRIu64 ".%" PRId64 "\n", path, file_version, block_id, block_version );
+      return -ENOENT;
+   }
+   
+   int fd = md_cache_open_block( state->cache, file_id, file_version, block_id, block_version, O_RDONLY );
+   if( fd < 0 ) {
+      
+      if( fd != -ENOENT ) {
+         SG_error("md_cache_open_block(%s.%" PRId64 ".%" PRIu64 ".%" PRId64 ") rc = %d\n", path, file_version, block_id, block_version, fd );
+      }
+      else {
+         SG_debug("CACHE MISS %s.%" PRId64 ".%" PRIu64 ".%" PRId64 "\n", path, file_version, block_id, block_version );
+      }
+      
+      return fd;
+   }
+   
+   rc = fstat( fd, &sb );
+   if( rc != 0 ) {
+      
+      rc = -errno;
+      SG_error("fstat(%s.%" PRId64 ".%" PRIu64 ".%" PRId64 ") rc = %d\n", path, file_version, block_id, block_version, rc );
+      
+      close( fd );
+      return rc;
+   }
+   
+   *block_len = sb.st_size;
+   
+   SG_debug("CACHE HIT %s.%" PRId64 ".%" PRIu64 ".%" PRId64 "\n", path, file_version, block_id, block_version );
+   
+   return fd;
+}
+
 // promote a block in the cache 
 int AG_cache_promote_block( struct AG_state* state, char const* path, int64_t file_version, uint64_t block_id, int64_t block_version ) {
    
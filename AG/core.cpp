@@ -19,6 +19,7 @@
 #include "cache.h"
 #include "http.h"
 #include "driver.h"
+#include "driver-pool.h"
 #include "events.h"
 #include "publish.h"
 #include "map-parser-xml.h"
@@ -199,9 +200,9 @@ int AG_load_spec_file_text( struct AG_state* state, char** specfile_text, size_t
 }
 
 
-// generate the latest fs_map and config from the specfile 
+// generate the latest fs_map and config from the specfile, and snapshot it for later incremental reloads
 // NOTE: state only needs .ms and .ag_opts to be initialized for this method to work.
-int AG_reload_specfile( struct AG_state* state, AG_fs_map_t** new_fs, AG_config_t** new_config ) {
+int AG_reload_specfile( struct AG_state* state, AG_fs_map_t** new_fs, AG_config_t** new_config, struct AG_spec_snapshot** new_snapshot ) {
    
    SG_debug("%s", "Reloading AG spec file...\n");
    
@@ -217,9 +218,9 @@ int AG_reload_specfile( struct AG_state* state, AG_fs_map_t** new_fs, AG_config_
    }
    
    // try to parse the text 
-   rc = AG_parse_spec( state, new_specfile_text, new_specfile_text_len, new_fs, new_config );
+   rc = AG_parse_spec_snapshot( state, new_specfile_text, new_specfile_text_len, new_fs, new_config, new_snapshot );
    if( rc != 0 ) {
-      SG_error("AG_parse_spec rc = %d\n", rc );
+      SG_error("AG_parse_spec_snapshot rc = %d\n", rc );
    }
    
    free( new_specfile_text );
@@ -316,20 +317,171 @@ int AG_resync( struct AG_state* state, struct AG_fs* old_fs, struct AG_fs* new_f
    return 0;
 }
 
-// get the latest specfile, and use it to publish new entries and withdraw now-old entries
-int AG_reload( struct AG_state* state ) {
+// for reloading, an element is fresh if it has the same AG-specific metadata 
+static bool AG_reload_fresh_equ( struct AG_map_info* mi1, struct AG_map_info* mi2 ) {
+   
+   bool streq = true;
+   if( mi1->query_string != NULL && mi2->query_string != NULL ) {
+      streq = (strcmp( mi1->query_string, mi2->query_string ) == 0);
+   }
+   
+   return (mi1->driver    == mi2->driver    &&
+           mi1->file_perm == mi2->file_perm &&
+           mi1->reval_sec == mi2->reval_sec &&
+           mi1->type      == mi2->type      &&
+           streq );
+}
+
+
+// reload only the parts of the specfile that changed since state->spec_snapshot was taken, and publish, update, and withdraw just those entries.
+// return 0 on success
+// return -ESTALE if the specfile needs a full reload instead (see AG_parse_spec_changes and AG_fs_map_changes)
+// return negative on error
+static int AG_reload_changes( struct AG_state* state, char const* specfile_text, size_t specfile_text_len ) {
    
    int rc = 0;
    
-   AG_fs_map_t* new_fs = NULL;
+   AG_fs_map_t* changed = NULL;
    AG_config_t* new_config = NULL;
+   struct AG_spec_snapshot* new_snapshot = NULL;
+   vector<string> removed;
    
-   SG_debug("%s", "Begin reload state\n");
+   AG_fs_map_t to_delete;
+   AG_fs_map_t to_publish;
+   AG_fs_map_t to_update;
+   AG_fs_map_t to_remain;
+   
+   rc = AG_parse_spec_changes( state, specfile_text, specfile_text_len, state->spec_snapshot, &changed, &new_config, &removed, &new_snapshot );
+   if( rc != 0 ) {
+      
+      if( rc != -ESTALE ) {
+         SG_error("AG_parse_spec_changes rc = %d\n", rc );
+      }
+      
+      return rc;
+   }
+   
+   SG_debug("Spec file changes: %zu new or changed entries, %zu removed, config %s\n", changed->size(), removed.size(), (new_config != NULL ? "changed" : "unchanged") );
+   
+   // apply them to the current fs (but prevent another thread from replacing state->ag_fs)
+   AG_state_fs_rlock( state );
+   AG_fs_rlock( state->ag_fs );
+   
+   rc = AG_fs_map_changes( state->ag_fs->fs, changed, &removed, &to_publish, &to_remain, &to_update, &to_delete, AG_reload_fresh_equ );
+   if( rc != 0 ) {
+      
+      if( rc != -ESTALE ) {
+         SG_error("AG_fs_map_changes rc = %d\n", rc );
+      }
+   }
+   else {
+      
+      // verify the fs's integrity once the changes are in
+      rc = AG_validate_map_info_changes( state->ag_fs->fs, changed, &to_delete );
+      if( rc != 0 ) {
+         SG_error("AG_validate_map_info_changes rc = %d\n", rc );
+      }
+   }
+   
+   if( rc == 0 ) {
+      
+      rc = AG_fs_publish_generate_metadata( &to_publish );
+      if( rc != 0 ) {
+         SG_error("AG_fs_publish_generate_metadata rc = %d\n", rc );
+      }
+   }
+   
+   if( rc != 0 ) {
+      
+      AG_fs_unlock( state->ag_fs );
+      AG_state_fs_unlock( state );
+      
+      AG_fs_map_free( changed );
+      delete changed;
+      
+      if( new_config != NULL ) {
+         delete new_config;
+      }
+      
+      AG_spec_snapshot_free( new_snapshot );
+      return rc;
+   }
+   
+   SG_debug("%s", "To publish:\n");
+   AG_dump_fs_map( &to_publish );
+   
+   SG_debug("%s", "To update:\n");
+   AG_dump_fs_map( &to_update );
+   
+   SG_debug("%s", "To delete:\n");
+   AG_dump_fs_map( &to_delete );
+   
+   // tell the MS (as AG_resync does, failures are logged and the fs is changed anyway)
+   int ms_rc = AG_fs_publish_all( state->ms, state->ag_fs->fs, &to_publish );
+   if( ms_rc != 0 ) {
+      SG_error("WARN: AG_fs_publish_all rc = %d\n", ms_rc );
+   }
+   else {
+      
+      ms_rc = AG_fs_update_all( state->ms, state->ag_fs->fs, &to_update );
+      if( ms_rc != 0 ) {
+         SG_error("WARN: AG_fs_update_all rc = %d\n", ms_rc );
+      }
+      else {
+         
+         ms_rc = AG_fs_delete_all( state->ms, state->ag_fs->fs, &to_delete );
+         if( ms_rc != 0 ) {
+            SG_error("WARN: AG_fs_delete_all rc = %d\n", ms_rc );
+         }
+      }
+   }
+   
+   AG_fs_unlock( state->ag_fs );
+   
+   // put the changes in (this frees the entries they replace)
+   AG_fs_wlock( state->ag_fs );
+   
+   AG_fs_map_apply_changes( state->ag_fs->fs, changed, &to_delete );
+   
+   AG_fs_unlock( state->ag_fs );
+   
+   AG_state_fs_unlock( state );
+   
+   delete changed;
+   
+   // swap the new config in 
+   if( new_config != NULL ) {
+      
+      AG_state_config_wlock( state );
+      
+      AG_config_t* old_config = state->config;
+      state->config = new_config;
+      
+      AG_state_config_unlock( state );
+      
+      delete old_config;
+   }
+   
+   AG_spec_snapshot_free( state->spec_snapshot );
+   state->spec_snapshot = new_snapshot;
+   
+   return 0;
+}
+
+
+// reload the whole specfile, and resync the MS with it
+static int AG_reload_all( struct AG_state* state, char const* specfile_text, size_t specfile_text_len ) {
+   
+   int rc = 0;
+   
+   AG_fs_map_t* new_fs = NULL;
+   AG_config_t* new_config = NULL;
+   struct AG_spec_snapshot* new_snapshot = NULL;
    
    // get the new fs data 
-   rc = AG_reload_specfile( state, &new_fs, &new_config );
+   rc = AG_parse_spec_snapshot( state, specfile_text, specfile_text_len, &new_fs, &new_config, &new_snapshot );
    if( rc != 0 ) {
-      SG_error("AG_reload_specfile rc = %d\n", rc );
+      SG_error("AG_parse_spec_snapshot rc = %d\n", rc );
       return rc;
    }
    
@@ -342,6 +494,7 @@ int AG_reload( struct AG_state* state ) {
       
       delete new_fs;
       delete new_config;
+      AG_spec_snapshot_free( new_snapshot );
       return rc;
    }
    
@@ -372,30 +525,13 @@ int AG_reload( struct AG_state* state ) {
       free( fs_clone );
       
       delete new_config;
+      AG_spec_snapshot_free( new_snapshot );
       
       return rc;
    }
    
-   
-   // for reloading, an element is fresh if it has the same AG-specific metadata 
-   struct AG_fresh_comparator {
-      static bool equ( struct AG_map_info* mi1, struct AG_map_info* mi2 ) {
-         
-         bool streq = true;
-         if( mi1->query_string != NULL && mi2->query_string != NULL ) {
-            streq = (strcmp( mi1->query_string, mi2->query_string ) == 0);
-         }
-         
-         return (mi1->driver    == mi2->driver    &&
-                 mi1->file_perm == mi2->file_perm &&
-                 mi1->reval_sec == mi2->reval_sec &&
-                 mi1->type      == mi2->type      &&
-                 streq );
-      }
-   };
-   
    // Evolve the current AG_fs into the one described by the specfile.
-   rc = AG_resync( state, state->ag_fs, fs_clone, AG_fresh_comparator::equ, false );
+   rc = AG_resync( state, state->ag_fs, fs_clone, AG_reload_fresh_equ, false );
    if( rc != 0 ) {
       SG_error("WARN: AG_resync rc = %d\n", rc );
       rc = 0;
@@ -434,11 +570,60 @@ int AG_reload( struct AG_state* state ) {
    
    delete old_config;
    
+   AG_spec_snapshot_free( state->spec_snapshot );
+   state->spec_snapshot = new_snapshot;
+   
+   return 0;
+}
+
+
+// get the latest specfile, and use it to publish new entries and withdraw now-old entries.
+// only the parts of the specfile that changed since the last reload are parsed and synced, if we can tell what they are.
+int AG_reload( struct AG_state* state ) {
+   
+   int rc = 0;
+   char* specfile_text = NULL;
+   size_t specfile_text_len = 0;
+   
+   SG_debug("%s", "Begin reload state\n");
+   
+   // get the text 
+   rc = AG_load_spec_file_text( state, &specfile_text, &specfile_text_len );
+   if( rc != 0 ) {
+      SG_error("AG_load_spec_file_text rc = %d\n", rc );
+      return rc;
+   }
+   
+   if( AG_spec_snapshot_matches( state->spec_snapshot, specfile_text, specfile_text_len ) ) {
+      
+      // nothing to do
+      SG_debug("%s", "Spec file is unchanged\n");
+      
+      free( specfile_text );
+      return 0;
+   }
+   
+   rc = AG_reload_changes( state, specfile_text, specfile_text_len );
+   if( rc == -ESTALE ) {
+      
+      SG_debug("%s", "Reloading the whole spec file\n");
+      rc = AG_reload_all( state, specfile_text, specfile_text_len );
+   }
+   
+   free( specfile_text );
+   
+   if( rc != 0 ) {
+      SG_error("Failed to reload spec file, rc = %d\n", rc );
+      return rc;
+   }
+   
    SG_debug("%s", "End reload state\n");
    return 0;
 }
 
 
+
+
 // view-change reload thread (triggerred in response to volume change)
 void* AG_reload_thread_main( void* arg ) {
    
@@ -584,7 +769,7 @@ int AG_state_init( struct AG_state* state, struct md_opts* opts, struct AG_opts*
    state->ag_fs = SG_CALLOC( struct AG_fs, 1 );
 
    // get the new FS mapping and config 
-   rc = AG_reload_specfile( state, &parsed_map, &state->config );
+   rc = AG_reload_specfile( state, &parsed_map, &state->config, &state->spec_snapshot );
    if( rc != 0 ) {
       SG_error("AG_reload_specfile rc = %d\n", rc );
       return rc;
@@ -622,6 +807,18 @@ int AG_state_init( struct AG_state* state, struct md_opts* opts, struct AG_opts*
       return rc;
    }
    
+   // initialize driver workers 
+   state->driver_pool = SG_CALLOC( struct AG_driver_pool, 1 );
+   
+   rc = AG_driver_pool_init( state->driver_pool, conf->num_driver_workers, conf->driver_max_concurrency, conf->driver_max_queue );
+   if( rc != 0 ) {
+      SG_error("AG_driver_pool_init rc = %d\n", rc );
+      
+      free( state->driver_pool );
+      state->driver_pool = NULL;
+      return rc;
+   }
+   
    // initialize event listener 
    state->event_listener = SG_CALLOC( struct AG_event_listener, 1 );
    
@@ -802,6 +999,15 @@ int AG_start( struct AG_state* state ) {
       AG_fs_unlock( state->ag_fs );
    }
    
+   // start driver workers before HTTP, so there's someone to serve cache misses 
+   SG_debug("Starting driver workers (%d threads)\n", state->conf->num_driver_workers );
+   
+   rc = AG_driver_pool_start( state->driver_pool );
+   if( rc != 0 ) {
+      SG_error("ERR: AG_driver_pool_start rc = %d\n", rc );
+      return rc;
+   }
+   
    // start HTTP 
    SG_debug("Starting HTTP server (%d threads)\n", state->conf->num_http_threads );
    
@@ -864,6 +1070,10 @@ int AG_stop( struct AG_state* state ) {
    pthread_cancel( state->specfile_reload_thread );
    pthread_join( state->specfile_reload_thread, NULL );
    
+   // reply to (and resume) every suspended connection before stopping HTTP 
+   SG_debug("%s", "Shutting down driver workers\n");
+   AG_driver_pool_stop( state->driver_pool );
+   
    SG_debug("%s", "Shutting down HTTP server\n");
    md_stop_HTTP( state->http );
    
@@ -904,6 +1114,12 @@ int AG_state_free( struct AG_state* state ) {
       state->http = NULL;
    }
    
+   if( state->driver_pool != NULL ) {
+      AG_driver_pool_free( state->driver_pool );
+      free( state->driver_pool );
+      state->driver_pool = NULL;
+   }
+   
    if( state->event_listener != NULL ) {
       AG_event_listener_free( state->event_listener );
       free( state->event_listener );
@@ -933,6 +1149,11 @@ int AG_state_free( struct AG_state* state ) {
       state->config = NULL;
    }
    
+   if( state->spec_snapshot != NULL ) {
+      AG_spec_snapshot_free( state->spec_snapshot );
+      state->spec_snapshot = NULL;
+   }
+   
    if( state->cache != NULL ) {
       md_cache_destroy( state->cache );
       free( state->cache );
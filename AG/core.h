@@ -36,6 +36,8 @@
 // prototypes
 struct AG_event_listener;
 struct AG_driver;
+struct AG_driver_pool;
+struct AG_spec_snapshot;
 
 // AG-specific options 
 struct AG_opts {
@@ -55,6 +57,7 @@ struct AG_state {
    struct ms_client* ms;
    struct md_HTTP* http;
    struct md_syndicate_cache* cache;
+   struct AG_driver_pool* driver_pool;          // serves requests that need the driver, off of the HTTP threads
    
    struct AG_event_listener* event_listener;
    struct md_wq* wq;
@@ -62,6 +65,8 @@ struct AG_state {
    struct AG_opts ag_opts;
    AG_config_t* config;
    
+   struct AG_spec_snapshot* spec_snapshot;      // spec file as of the last reload (NULL if it can't be reloaded incrementally).  Only the reload thread touches it.
+   
    AG_driver_map_t* drivers;
    
    bool running;
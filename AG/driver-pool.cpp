@@ -0,0 +1,317 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "driver-pool.h"
+
+// set up a driver worker pool
+// return 0 on success
+// return -ENOMEM if OOM
+int AG_driver_pool_init( struct AG_driver_pool* pool, unsigned int num_threads, unsigned int max_concurrency, unsigned int max_queue ) {
+   
+   memset( pool, 0, sizeof(struct AG_driver_pool) );
+   
+   pool->threads = SG_CALLOC( pthread_t, num_threads );
+   if( pool->threads == NULL ) {
+      return -ENOMEM;
+   }
+   
+   pool->queues = new (nothrow) AG_driver_pool_queue_map_t();
+   if( pool->queues == NULL ) {
+   
+      free( pool->threads );
+      pool->threads = NULL;
+      return -ENOMEM;
+   }
+   
+   pool->num_threads = num_threads;
+   pool->max_concurrency = max_concurrency;
+   pool->max_queue = max_queue;
+   
+   pthread_mutex_init( &pool->lock, NULL );
+   pthread_cond_init( &pool->work_cv, NULL );
+   
+   return 0;
+}
+
+
+// find the next driver queue with a request we can serve, going round-robin over the drivers.
+// pool->lock must be held
+static struct AG_driver_pool_queue* AG_driver_pool_next_queue( struct AG_driver_pool* pool ) {
+   
+   if( pool->queues->size() == 0 ) {
+      return NULL;
+   }
+   
+   // start just after the driver we served last
+   AG_driver_pool_queue_map_t::iterator itr = pool->queues->upper_bound( pool->last_driver );
+   
+   for( unsigned int i = 0; i < pool->queues->size(); i++ ) {
+   
+      if( itr == pool->queues->end() ) {
+         itr = pool->queues->begin();
+      }
+   
+      struct AG_driver_pool_queue* q = itr->second;
+   
+      if( !q->pending->empty() && q->running < pool->max_concurrency ) {
+   
+         pool->last_driver = itr->first;
+         return q;
+      }
+   
+      itr++;
+   }
+   
+   return NULL;
+}
+
+
+// worker thread: serve queued requests and resume their connections
+static void* AG_driver_pool_main( void* arg ) {
+   
+   struct AG_driver_pool* pool = (struct AG_driver_pool*)arg;
+   
+   pthread_mutex_lock( &pool->lock );
+   
+   while( pool->running ) {
+   
+      struct AG_driver_pool_queue* q = AG_driver_pool_next_queue( pool );
+      if( q == NULL ) {
+   
+         // nothing we can serve yet
+         pthread_cond_wait( &pool->work_cv, &pool->lock );
+         continue;
+      }
+   
+      struct AG_driver_pool_req req = q->pending->front();
+      q->pending->pop();
+   
+      q->running++;
+   
+      pthread_mutex_unlock( &pool->lock );
+   
+      struct md_HTTP_response* resp = (*req.serve)( req.md_con_data );
+   
+      if( resp == NULL ) {
+   
+         resp = SG_CALLOC( struct md_HTTP_response, 1 );
+         md_create_HTTP_response_ram_static( resp, "text/plain", 500, MD_HTTP_500_MSG, strlen(MD_HTTP_500_MSG) + 1 );
+      }
+   
+      // NOTE: don't touch md_con_data after this; the connection may finish (and free it) at any time
+      md_HTTP_connection_resume( req.md_con_data, resp );
+   
+      pthread_mutex_lock( &pool->lock );
+   
+      q->running--;
+   
+      if( !q->pending->empty() ) {
+   
+         // a worker may be waiting for this driver to have a free slot
+         pthread_cond_signal( &pool->work_cv );
+      }
+   }
+   
+   pthread_mutex_unlock( &pool->lock );
+   
+   return NULL;
+}
+
+
+// start the workers
+// return 0 on success
+// return negative if we couldn't start a thread
+int AG_driver_pool_start( struct AG_driver_pool* pool ) {
+   
+   pool->running = true;
+   
+   for( unsigned int i = 0; i < pool->num_threads; i++ ) {
+   
+      pool->threads[i] = md_start_thread( AG_driver_pool_main, pool, false );
+   
+      if( pool->threads[i] == (pthread_t)(-1) ) {
+   
+         SG_error("md_start_thread(driver worker %u) failed\n", i );
+   
+         pool->num_threads = i;
+         AG_driver_pool_stop( pool );
+   
+         return -EPERM;
+      }
+   }
+   
+   SG_debug("Started %u driver workers (at most %u requests per driver, %u queued)\n", pool->num_threads, pool->max_concurrency, pool->max_queue );
+   
+   return 0;
+}
+
+
+// stop the workers, letting them finish the requests they're serving, and turn away the requests still queued with a 503.
+// call this before stopping the HTTP server, so no connection is left suspended.
+// always succeeds
+int AG_driver_pool_stop( struct AG_driver_pool* pool ) {
+   
+   pthread_mutex_lock( &pool->lock );
+   
+   pool->running = false;
+   pthread_cond_broadcast( &pool->work_cv );
+   
+   pthread_mutex_unlock( &pool->lock );
+   
+   for( unsigned int i = 0; i < pool->num_threads; i++ ) {
+      pthread_join( pool->threads[i], NULL );
+   }
+   
+   pool->num_threads = 0;
+   
+   pthread_mutex_lock( &pool->lock );
+   
+   for( AG_driver_pool_queue_map_t::iterator itr = pool->queues->begin(); itr != pool->queues->end(); itr++ ) {
+   
+      struct AG_driver_pool_queue* q = itr->second;
+   
+      while( !q->pending->empty() ) {
+   
+         struct AG_driver_pool_req req = q->pending->front();
+         q->pending->pop();
+   
+         struct md_HTTP_response* resp = SG_CALLOC( struct md_HTTP_response, 1 );
+         md_create_HTTP_response_ram_static( resp, "text/plain", SG_HTTP_TRYAGAIN, SG_HTTP_TRYAGAIN_MSG, strlen(SG_HTTP_TRYAGAIN_MSG) + 1 );
+   
+         md_HTTP_connection_resume( req.md_con_data, resp );
+      }
+   }
+   
+   pthread_mutex_unlock( &pool->lock );
+   
+   return 0;
+}
+
+
+// free a (stopped) pool
+// always succeeds
+int AG_driver_pool_free( struct AG_driver_pool* pool ) {
+   
+   if( pool->queues != NULL ) {
+   
+      for( AG_driver_pool_queue_map_t::iterator itr = pool->queues->begin(); itr != pool->queues->end(); itr++ ) {
+   
+         delete itr->second->pending;
+         free( itr->second );
+      }
+   
+      delete pool->queues;
+      pool->queues = NULL;
+   }
+   
+   if( pool->threads != NULL ) {
+      free( pool->threads );
+      pool->threads = NULL;
+   }
+   
+   pthread_mutex_destroy( &pool->lock );
+   pthread_cond_destroy( &pool->work_cv );
+   
+   return 0;
+}
+
+
+// queue a request for the given driver, and defer its connection's response until a worker has served it with serve().
+// call this from the connection's GET handler, and return NULL from the handler on success.
+// return 0 on success
+// return -EAGAIN if the driver already has too many requests waiting
+// return -ENOTCONN if the pool is not running
+// return -ENOMEM if OOM
+int AG_driver_pool_submit( struct AG_driver_pool* pool, struct AG_driver* driver, struct md_HTTP_connection_data* md_con_data, AG_driver_pool_serve_func_t serve ) {
+   
+   struct AG_driver_pool_req req;
+   struct AG_driver_pool_queue* q = NULL;
+   
+   req.md_con_data = md_con_data;
+   req.serve = serve;
+   
+   pthread_mutex_lock( &pool->lock );
+   
+   if( !pool->running ) {
+   
+      pthread_mutex_unlock( &pool->lock );
+      return -ENOTCONN;
+   }
+   
+   AG_driver_pool_queue_map_t::iterator itr = pool->queues->find( driver );
+   if( itr != pool->queues->end() ) {
+   
+      q = itr->second;
+   }
+   else {
+   
+      // first request for this driver
+      q = SG_CALLOC( struct AG_driver_pool_queue, 1 );
+      if( q == NULL ) {
+   
+         pthread_mutex_unlock( &pool->lock );
+         return -ENOMEM;
+      }
+   
+      q->pending = new (nothrow) AG_driver_pool_queue_t();
+      if( q->pending == NULL ) {
+   
+         pthread_mutex_unlock( &pool->lock );
+   
+         free( q );
+         return -ENOMEM;
+      }
+   
+      try {
+         (*pool->queues)[ driver ] = q;
+      }
+      catch( bad_alloc& ba ) {
+   
+         pthread_mutex_unlock( &pool->lock );
+   
+         delete q->pending;
+         free( q );
+         return -ENOMEM;
+      }
+   }
+   
+   // backpressure
+   if( q->pending->size() >= pool->max_queue ) {
+   
+      pthread_mutex_unlock( &pool->lock );
+   
+      SG_error("Driver %p has %zu requests waiting; turning away %s\n", driver, q->pending->size(), md_con_data->url_path );
+      return -EAGAIN;
+   }
+   
+   try {
+      q->pending->push( req );
+   }
+   catch( bad_alloc& ba ) {
+   
+      pthread_mutex_unlock( &pool->lock );
+      return -ENOMEM;
+   }
+   
+   // no worker can get to it until we unlock
+   md_HTTP_connection_defer( md_con_data );
+   
+   pthread_cond_signal( &pool->work_cv );
+   
+   pthread_mutex_unlock( &pool->lock );
+   
+   return 0;
+}
@@ -0,0 +1,84 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Driver worker pool.
+// Requests that need the driver (i.e. cache misses) are not served on the HTTP threads.  Instead, the HTTP thread
+// suspends the connection and queues the request here, where a small set of worker threads serve it and resume the
+// connection with the reply.  Each driver gets its own queue, and may only be serving so many requests at once, so one
+// slow driver can't starve the others of workers.  If a driver's queue is full, new requests for it are turned away
+// with a 503 instead of queued.
+
+#ifndef _AG_DRIVER_POOL_H_
+#define _AG_DRIVER_POOL_H_
+
+#include "libsyndicate/libsyndicate.h"
+#include "libsyndicate/httpd.h"
+
+#include "AG.h"
+
+#include <queue>
+#include <map>
+
+using namespace std;
+
+// prototypes
+struct AG_driver;
+
+// serve a queued request on a worker thread, and return the response to send
+typedef struct md_HTTP_response* (*AG_driver_pool_serve_func_t)( struct md_HTTP_connection_data* md_con_data );
+
+// a request waiting for a worker
+struct AG_driver_pool_req {
+   struct md_HTTP_connection_data* md_con_data;          // suspended connection to reply to
+   AG_driver_pool_serve_func_t serve;
+};
+
+typedef queue<struct AG_driver_pool_req> AG_driver_pool_queue_t;
+
+// a driver's requests
+struct AG_driver_pool_queue {
+   AG_driver_pool_queue_t* pending;     // waiting for a worker
+   unsigned int running;                // being served by a worker
+};
+
+typedef map<struct AG_driver*, struct AG_driver_pool_queue*> AG_driver_pool_queue_map_t;
+
+// driver worker pool
+struct AG_driver_pool {
+
+   pthread_t* threads;
+   unsigned int num_threads;
+
+   unsigned int max_concurrency;        // most requests a driver may be serving at once
+   unsigned int max_queue;              // most requests that may wait for a driver
+
+   bool running;
+
+   AG_driver_pool_queue_map_t* queues;
+   struct AG_driver* last_driver;       // driver whose queue was served last (so we go round-robin)
+
+   pthread_mutex_t lock;                // guards all of the above
+   pthread_cond_t work_cv;              // signaled when a request can be served, or on shutdown
+};
+
+int AG_driver_pool_init( struct AG_driver_pool* pool, unsigned int num_threads, unsigned int max_concurrency, unsigned int max_queue );
+int AG_driver_pool_start( struct AG_driver_pool* pool );
+int AG_driver_pool_stop( struct AG_driver_pool* pool );
+int AG_driver_pool_free( struct AG_driver_pool* pool );
+
+int AG_driver_pool_submit( struct AG_driver_pool* pool, struct AG_driver* driver, struct md_HTTP_connection_data* md_con_data, AG_driver_pool_serve_func_t serve );
+
+#endif
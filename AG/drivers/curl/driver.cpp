@@ -19,6 +19,21 @@
 // start up the driver
 int driver_init( void** driver_state ) {
    
+   struct curl_engine* engine = SG_CALLOC( struct curl_engine, 1 );
+   if( engine == NULL ) {
+      return -ENOMEM;
+   }
+   
+   int rc = curl_engine_init( engine );
+   if( rc != 0 ) {
+      SG_error("curl_engine_init rc = %d\n", rc );
+      
+      free( engine );
+      return rc;
+   }
+   
+   *driver_state = engine;
+   
    return 0;
 }
 
@@ -26,6 +41,13 @@ int driver_init( void** driver_state ) {
 // shut down the driver 
 int driver_shutdown( void* driver_state ) {
    
+   struct curl_engine* engine = (struct curl_engine*)driver_state;
+   
+   if( engine != NULL ) {
+      curl_engine_shutdown( engine );
+      free( engine );
+   }
+   
    return 0;
 }
 
@@ -39,6 +61,7 @@ int connect_dataset_block( struct AG_connection_context* ag_ctx, void* driver_st
    
    curl_ctx->request_path = request_path;
    curl_ctx->url = url;
+   curl_ctx->engine = (struct curl_engine*)driver_state;
    
    *driver_connection_state = curl_ctx;
    
@@ -67,179 +90,14 @@ int close_dataset_block( void* driver_connection_state ) {
 }
 
 
-// dummy header function; seems to be needed to stat files 
-static size_t curl_null_header( void* ptr, size_t size, size_t nmemb, void* data ) {
-   return size * nmemb;
-}
-
-// write function to fill our buffer, and abort if we get too much 
-static size_t curl_write_block( void* ptr, size_t size, size_t nmemb, void* data ) {
+// get the publish information for a dataset.
+// use the engine's copy if it's fresh, or our cached copy if it's fresh, or ask upstream.
+int curl_get_pubinfo( struct curl_engine* engine, char const* request_path, char const* url, struct AG_driver_publish_info* pubinfo ) {
    
-   struct curl_write_context* write_ctx = (struct curl_write_context*)data;
-   
-   size_t total_available = size * nmemb;
-   
-   // have space?
-   if( write_ctx->num_written + total_available <= write_ctx->buf_len ) {
-      
-      memcpy( write_ctx->buf + write_ctx->num_written, ptr, total_available );
-      write_ctx->num_written += total_available;
-      
-      return total_available;
-   }
-   else {
-      // not enough space
-      SG_error("Not enough space (have %zu bytes, but need at least %zu)\n", write_ctx->buf_len, write_ctx->num_written + total_available );
+   int rc = curl_engine_get_cached_pubinfo( engine, url, pubinfo );
+   if( rc == 0 ) {
       return 0;
    }
-}
-
-
-// find out how big a file is, and when it was modified 
-// return 0 on success
-// return negative errno on failure, or if errno was not set, return positive curl status code on failure
-static int curl_stat_file( CURL* curl, char const* url, struct AG_driver_publish_info* pub_info ) {
-   
-   SG_debug("stat %s\n", url );
-   
-   // set up the curl handle
-   curl_easy_setopt( curl, CURLOPT_URL, url );
-   curl_easy_setopt( curl, CURLOPT_NOBODY, 1L );
-   curl_easy_setopt( curl, CURLOPT_FILETIME, 1L );
-   curl_easy_setopt( curl, CURLOPT_HEADERFUNCTION, curl_null_header );
-   curl_easy_setopt( curl, CURLOPT_HEADER, 0L );
-   
-   int rc = curl_easy_perform( curl );
-   
-   if( rc != 0 ) {
-      // error of some sort 
-      long oserr = 0;
-      
-      curl_easy_getinfo( curl, CURLINFO_OS_ERRNO, &oserr );
-      
-      if( oserr != 0 ) {
-         SG_error("curl_easy_perform(%s) rc = %d, errno = %ld\n", url, rc, -oserr );
-         return (int)(-oserr);
-      }
-      else {
-         SG_error("curl_easy_perform(%s) rc = %d\n", url, rc );
-         return rc;
-      }
-   }
-   
-   // success! get info 
-   long filetime = -1;
-   double filesize = -1.0;
-   
-   int filetime_rc = curl_easy_getinfo( curl, CURLINFO_FILETIME, &filetime );
-   int filesize_rc = curl_easy_getinfo( curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &filesize );
-   
-   if( (filetime_rc != 0 || filetime < 0) || (filesize_rc != 0 || filesize <= 0.0 ) ) {
-      
-      // failed to get data
-      rc = -ENODATA;
-      
-      if( filetime_rc != 0 ) {
-         SG_error("curl_easy_getinfo( CURLINFO_FILETIME ) rc = %d\n", filetime_rc );
-         rc = filetime_rc;
-      }
-      if( filesize_rc != 0 ) {
-         SG_error("curl_easy_getinfo( CURLINFO_CONTENT_LENGTH_DOWNLOAD ) rc = %d\n", filesize_rc );
-         rc = filesize_rc;
-      }
-      
-      return rc;
-   }
-   
-   // fill in our pubinfo 
-   pub_info->size = (off_t)filesize;
-   
-   // set the time to now 
-   pub_info->mtime_sec = (int64_t)filetime;
-   pub_info->mtime_nsec = 0;
-   
-   return 0;
-}
-
-
-// get a block of data, and get its pubinfo while we're at it
-// return the number of bytes received on success
-// return negative errno on failure, or if errno was not set, return positive curl status code on failure
-static int curl_download_block( CURL* curl, char const* url, uint64_t block_id, char* buf, uint64_t block_size, struct AG_driver_publish_info* pub_info ) {
-   
-   SG_debug("Get block %s\n", url );
-   
-   struct curl_write_context write_ctx;
-   memset( &write_ctx, 0, sizeof(struct curl_write_context) );
-   
-   write_ctx.num_written = 0;
-   write_ctx.buf = buf;
-   write_ctx.buf_len = block_size;
-   
-   // set up the curl handle
-   curl_easy_setopt( curl, CURLOPT_URL, url );
-   curl_easy_setopt( curl, CURLOPT_FILETIME, 1L );
-   curl_easy_setopt( curl, CURLOPT_HEADERFUNCTION, curl_null_header );
-   curl_easy_setopt( curl, CURLOPT_HEADER, 0L );
-   curl_easy_setopt( curl, CURLOPT_WRITEFUNCTION, curl_write_block );
-   curl_easy_setopt( curl, CURLOPT_WRITEDATA, &write_ctx );
-   
-   // add range requirement
-   // format: X-Y, where X and Y are 64-bit byte indices.  Y is inclusive
-   size_t range_maxlen = 20 + 1 + 20 + 1;  // NOTE: 19 < log10( UINT64_MAX ) < 20
-   char range_buf[20 + 1 + 20 + 1];     
-   snprintf( range_buf, range_maxlen, "%" PRIu64 "-%" PRIu64, block_id * block_size, (block_id + 1) * block_size - 1 );
-   
-   curl_easy_setopt( curl, CURLOPT_RANGE, range_buf );
-   
-   int rc = curl_easy_perform( curl );
-   
-   if( rc != 0 ) {
-      // error of some sort 
-      long oserr = 0;
-      
-      curl_easy_getinfo( curl, CURLINFO_OS_ERRNO, &oserr );
-      
-      if( oserr != 0 ) {
-         SG_error("curl_easy_perform(%s) rc = %d, errno = %ld\n", url, rc, -oserr );
-         return (int)(-oserr);
-      }
-      else {
-         if( rc == CURLE_BAD_DOWNLOAD_RESUME ) {
-            // EOF 
-            SG_error("WARN: Block %" PRIu64 " is off the end of the file\n", block_id );
-            
-            write_ctx.num_written = 0;
-         }
-         else {
-            SG_error("curl_easy_perform(%s) rc = %d\n", url, rc );
-            return -rc;
-         }
-      }
-   }
-   
-   // success! opportunistically try to get metadata info 
-   long filetime = -1;
-   double filesize = -1.0;
-   
-   int filetime_rc = curl_easy_getinfo( curl, CURLINFO_FILETIME, &filetime );
-   int filesize_rc = curl_easy_getinfo( curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD, &filesize );
-   
-   // opportunistically got metadata?
-   if( filetime_rc == 0 && filetime > 0 && filesize_rc == 0 && filesize >= 1.0 ) {
-      
-      // fill in our pubinfo 
-      pub_info->size = (off_t)filesize;
-      pub_info->mtime_sec = (int64_t)filetime;
-      pub_info->mtime_nsec = 0;
-   }
-   
-   return write_ctx.num_written;
-}
-
-
-// get the publish information for a dataset 
-int curl_get_pubinfo( char const* request_path, char const* url, struct AG_driver_publish_info* pubinfo ) {
    
    // maybe we've cached it?
    char* info_path = md_fullpath( request_path, "curl-info", NULL );
@@ -247,13 +105,15 @@ int curl_get_pubinfo( char const* request_path, char const* url, struct AG_drive
    char* pubinfo_buf = NULL;
    size_t pubinfo_buflen = 0;
    
-   int rc = AG_driver_cache_get_chunk( info_path, &pubinfo_buf, &pubinfo_buflen );
+   rc = AG_driver_cache_get_chunk( info_path, &pubinfo_buf, &pubinfo_buflen );
    
    if( rc == 0 ) {
       
-      if( pubinfo_buflen == sizeof(struct AG_driver_publish_info) ) {
+      struct curl_pubinfo_record* record = (struct curl_pubinfo_record*)pubinfo_buf;
+      
+      if( pubinfo_buflen == sizeof(struct curl_pubinfo_record) && time(NULL) - record->fetched_sec < engine->head_cache_ttl ) {
          // success!
-         memcpy( pubinfo, pubinfo_buf, sizeof(struct AG_driver_publish_info) );
+         memcpy( pubinfo, &record->pubinfo, sizeof(struct AG_driver_publish_info) );
          free( pubinfo_buf );
             
          AG_driver_cache_promote_chunk( info_path );
@@ -261,7 +121,10 @@ int curl_get_pubinfo( char const* request_path, char const* url, struct AG_drive
          return 0;
       }
       else {
-         SG_error("WARN: got invalid data for %s\n", info_path );
+         if( pubinfo_buflen != sizeof(struct curl_pubinfo_record) ) {
+            SG_error("WARN: got invalid data for %s\n", info_path );
+         }
+         
          AG_driver_cache_evict_chunk( info_path );
          
          rc = 0;
@@ -270,27 +133,26 @@ int curl_get_pubinfo( char const* request_path, char const* url, struct AG_drive
       }
    }
    
-   // miss
-   CURL* curl = curl_easy_init();
-
-   // not cached
-   rc = curl_stat_file( curl, url, pubinfo );
+   // miss, or stale
+   rc = curl_engine_stat( engine, url, pubinfo );
    if( rc != 0 ) {
-      SG_error("ERR: curl_stat_file(%s, %s) rc = %d\n", info_path, url, rc );
+      SG_error("ERR: curl_engine_stat(%s, %s) rc = %d\n", info_path, url, rc );
    }
    else {
       // success! cache it 
       
-      char* cache_chunk = SG_CALLOC( char, sizeof(struct AG_driver_publish_info) );
-      memcpy( cache_chunk, &pubinfo, sizeof(struct AG_driver_publish_info) );
-      
-      AG_driver_cache_put_chunk_async( info_path, cache_chunk, sizeof(struct AG_driver_publish_info) );
+      struct curl_pubinfo_record* record = SG_CALLOC( struct curl_pubinfo_record, 1 );
+      if( record != NULL ) {
+         
+         memcpy( &record->pubinfo, pubinfo, sizeof(struct AG_driver_publish_info) );
+         record->fetched_sec = time(NULL);
+         
+         AG_driver_cache_put_chunk_async( info_path, (char*)record, sizeof(struct curl_pubinfo_record) );
+      }
       
       SG_debug("Got pubinfo for %s: { size = %jd, mtime_sec = %" PRId64 ", mtime_nsec = %" PRId32 " }\n", request_path, pubinfo->size, pubinfo->mtime_sec, pubinfo->mtime_nsec );
    }
    
-   curl_easy_cleanup( curl );
-   
    free( info_path );
    
    return rc;
@@ -298,31 +160,26 @@ int curl_get_pubinfo( char const* request_path, char const* url, struct AG_drive
 
 
 // get data for a block.
-// get it from the cache, if possible.
-// otherwise, download it and serve it back 
+// the engine serves it from what it read ahead, if it can.
+// otherwise, it downloads it (possibly along with its neighbors) and serves it back 
 ssize_t get_dataset_block( struct AG_connection_context* ag_ctx, uint64_t block_id, char* block_buf, size_t buf_len, void* driver_connection_state ) {
    
    struct curl_connection_context* curl_ctx = (struct curl_connection_context*)driver_connection_state;
    
-   // opportunistically get pubinfo
-   struct AG_driver_publish_info pubinfo;
-   memset( &pubinfo, 0, sizeof(struct AG_driver_publish_info) );
-   
-   pubinfo.size = -1;
-   pubinfo.mtime_sec = -1;
-   
-   CURL* curl = curl_easy_init();
-   
-   // no data cached; go get it 
-   int num_read = curl_download_block( curl, curl_ctx->url, block_id, block_buf, buf_len, &pubinfo );
+   ssize_t num_read = curl_engine_get_block( curl_ctx->engine, curl_ctx->url, block_id, block_buf, buf_len );
    
    if( num_read < 0 ) {
       
-      SG_error("curl_download_block(%s, %" PRIu64 ") rc = %d\n", curl_ctx->url, block_id, num_read );
+      SG_error("curl_engine_get_block(%s, %" PRIu64 ") rc = %zd\n", curl_ctx->url, block_id, num_read );
+      
+      if( num_read == -ENOENT ) {
+         AG_driver_set_HTTP_status( ag_ctx, 404 );
+      }
+      else if( num_read == -EACCES ) {
+         AG_driver_set_HTTP_status( ag_ctx, 403 );
+      }
    }
    
-   curl_easy_cleanup( curl );
-   
    return num_read;
 }
 
@@ -360,7 +217,7 @@ int stat_dataset( char const* path, struct AG_map_info* map_info, struct AG_driv
       free( get_from_upstream );
       
       // get the info from upstream
-      int rc = curl_get_pubinfo( path, url, pub_info );
+      rc = curl_get_pubinfo( (struct curl_engine*)driver_state, path, url, pub_info );
       
       if( rc != 0 ) {
          SG_error("curl_get_pubinfo(%s, %s) rc = %d\n", path, url, rc );
@@ -392,6 +249,21 @@ int reversion_dataset( char const* path, struct AG_map_info* mi, void* driver_st
    AG_driver_cache_evict_chunk( info_path );
    
    free( info_path );
+   
+   // forget the blocks we read ahead, too
+   char* url = AG_driver_map_info_get_query_string( mi );
+   if( url != NULL ) {
+      
+      curl_engine_invalidate( (struct curl_engine*)driver_state, url );
+      free( url );
+   }
+   
+   return 0;
+}
+
+// handle a driver-specific event.
+// there are none for this driver.
+int handle_event( char* event_payload, size_t event_payload_len, void* driver_state ) {
    return 0;
 }
 
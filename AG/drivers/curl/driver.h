@@ -34,21 +34,22 @@
 
 #include "AG/driver.h"
 
+#include "engine.h"
 
 #define AG_CURL_DRIVER_CONFIG_CHECK_UPSTREAM "check_upstream"
 
-// curl write context 
-struct curl_write_context {
-   
-   char* buf;
-   uint64_t buf_len;
-   uint64_t num_written;
+// publish info, as cached with the driver cache API
+struct curl_pubinfo_record {
+   struct AG_driver_publish_info pubinfo;
+   int64_t fetched_sec;         // when we got it from upstream
 };
 
 // curl connection context 
 struct curl_connection_context {
    char* request_path;
    char* url;
+   
+   struct curl_engine* engine;
 };
 
 extern "C" {
@@ -63,6 +64,8 @@ ssize_t get_dataset_block( struct AG_connection_context* ag_ctx, uint64_t block_
 
 int stat_dataset( char const* path, struct AG_map_info* map_info, struct AG_driver_publish_info* pub_info, void* driver_state );
 
+int reversion_dataset( char const* path, struct AG_map_info* map_info, void* driver_state );
+
 int handle_event( char* event_payload, size_t event_payload_len, void* driver_state );
 
 char* get_query_type(void);
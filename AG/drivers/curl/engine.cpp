@@ -0,0 +1,1084 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "engine.h"
+
+// get a positive integer driver config var, or a default if it's not set or not valid
+static uint64_t curl_engine_config_uint( char const* name, uint64_t default_value ) {
+   
+   uint64_t ret = default_value;
+   
+   char* value_str = AG_driver_get_config_var( name );
+   if( value_str != NULL ) {
+   
+      char* tmp = NULL;
+      long long value = strtoll( value_str, &tmp, 10 );
+   
+      if( tmp == value_str || value <= 0 ) {
+         SG_error("Configuration error: Invalid value '%s' for '%s'; using %" PRIu64 "\n", value_str, name, default_value );
+      }
+      else {
+         ret = value;
+      }
+   
+      free( value_str );
+   }
+   
+   return ret;
+}
+
+// current time, in seconds since the epoch
+static int64_t curl_engine_now(void) {
+   
+   struct timespec ts;
+   clock_gettime( CLOCK_REALTIME, &ts );
+   
+   return ts.tv_sec;
+}
+
+// wake up the engine thread
+static void curl_engine_wake( struct curl_engine* engine ) {
+   
+   char c = 0;
+   
+   // if the pipe is full, the engine thread has wakeups pending already
+   ssize_t rc = write( engine->wake_pipe[1], &c, 1 );
+   if( rc < 0 && errno != EAGAIN ) {
+      SG_error("write(wake pipe) errno = %d\n", -errno );
+   }
+}
+
+
+// get a URL's state, creating it if need be
+// engine->lock must be held
+// return NULL if OOM
+static struct curl_url_state* curl_engine_url_state( struct curl_engine* engine, char const* url ) {
+   
+   curl_url_map_t::iterator itr = engine->urls->find( string(url) );
+   if( itr != engine->urls->end() ) {
+      return itr->second;
+   }
+   
+   struct curl_url_state* us = SG_CALLOC( struct curl_url_state, 1 );
+   if( us == NULL ) {
+      return NULL;
+   }
+   
+   us->blocks = new (nothrow) curl_prefetch_map_t();
+   if( us->blocks == NULL ) {
+   
+      free( us );
+      return NULL;
+   }
+   
+   try {
+      (*engine->urls)[ string(url) ] = us;
+   }
+   catch( bad_alloc& ba ) {
+   
+      delete us->blocks;
+      free( us );
+      return NULL;
+   }
+   
+   return us;
+}
+
+
+// forget a prefetched block
+// engine->lock must be held
+static void curl_engine_prefetch_remove( struct curl_engine* engine, struct curl_prefetch_block* pb ) {
+   
+   pb->owner->blocks->erase( pb->block_id );
+   engine->prefetch_lru->erase( pb->lru_itr );
+   
+   free( pb->buf );
+   free( pb );
+}
+
+
+// forget all of a URL's prefetched blocks
+// engine->lock must be held
+static void curl_engine_prefetch_clear( struct curl_engine* engine, struct curl_url_state* us ) {
+   
+   while( !us->blocks->empty() ) {
+      curl_engine_prefetch_remove( engine, us->blocks->begin()->second );
+   }
+}
+
+
+// remember a block no one has asked for yet, evicting the oldest ones if we have too many
+// engine->lock must be held
+// return 0 on success
+// return -ENOMEM if OOM
+static int curl_engine_prefetch_put( struct curl_engine* engine, struct curl_url_state* us, uint64_t block_id, char const* buf, size_t len ) {
+   
+   curl_prefetch_map_t::iterator itr = us->blocks->find( block_id );
+   if( itr != us->blocks->end() ) {
+   
+      // replace the older copy
+      curl_engine_prefetch_remove( engine, itr->second );
+   }
+   
+   struct curl_prefetch_block* pb = SG_CALLOC( struct curl_prefetch_block, 1 );
+   if( pb == NULL ) {
+      return -ENOMEM;
+   }
+   
+   pb->buf = SG_CALLOC( char, len );
+   if( pb->buf == NULL ) {
+   
+      free( pb );
+      return -ENOMEM;
+   }
+   
+   memcpy( pb->buf, buf, len );
+   
+   pb->owner = us;
+   pb->block_id = block_id;
+   pb->len = len;
+   
+   try {
+      pb->lru_itr = engine->prefetch_lru->insert( engine->prefetch_lru->end(), pb );
+   
+      try {
+         (*us->blocks)[ block_id ] = pb;
+      }
+      catch( bad_alloc& ba ) {
+   
+         engine->prefetch_lru->erase( pb->lru_itr );
+         throw;
+      }
+   }
+   catch( bad_alloc& ba ) {
+   
+      free( pb->buf );
+      free( pb );
+      return -ENOMEM;
+   }
+   
+   while( engine->prefetch_lru->size() > engine->max_prefetch_blocks ) {
+      curl_engine_prefetch_remove( engine, engine->prefetch_lru->front() );
+   }
+   
+   return 0;
+}
+
+
+// make a transfer
+// return NULL if OOM
+static struct curl_transfer* curl_transfer_new( int type, char const* url, uint64_t first_block, uint64_t num_blocks, uint64_t generation ) {
+   
+   struct curl_transfer* t = SG_CALLOC( struct curl_transfer, 1 );
+   if( t == NULL ) {
+      return NULL;
+   }
+   
+   t->url = strdup( url );
+   t->waiters = new (nothrow) curl_engine_waiter_list_t();
+   
+   if( t->url == NULL || t->waiters == NULL ) {
+   
+      if( t->url != NULL ) {
+         free( t->url );
+      }
+      if( t->waiters != NULL ) {
+         delete t->waiters;
+      }
+   
+      free( t );
+      return NULL;
+   }
+   
+   t->type = type;
+   t->first_block = first_block;
+   t->num_blocks = num_blocks;
+   t->total_size = -1;
+   t->generation = generation;
+   
+   return t;
+}
+
+
+// free a transfer (it must not be in the multi handle)
+static void curl_transfer_free( struct curl_transfer* t ) {
+   
+   if( t->curl != NULL ) {
+      curl_easy_cleanup( t->curl );
+   }
+   
+   if( t->buf != NULL ) {
+      free( t->buf );
+   }
+   
+   delete t->waiters;
+   free( t->url );
+   free( t );
+}
+
+
+// find a queued or running transfer for a URL that will get the given block (or HEAD)
+// engine->lock must be held
+static struct curl_transfer* curl_engine_find_transfer( curl_transfer_list_t* transfers, int type, char const* url, uint64_t block_id ) {
+   
+   for( unsigned int i = 0; i < transfers->size(); i++ ) {
+   
+      struct curl_transfer* t = transfers->at(i);
+   
+      if( t->type != type || strcmp( t->url, url ) != 0 ) {
+         continue;
+      }
+   
+      if( type == AG_CURL_TRANSFER_HEAD || (t->first_block <= block_id && block_id < t->first_block + t->num_blocks) ) {
+         return t;
+      }
+   }
+   
+   return NULL;
+}
+
+
+// receive part of a range
+static size_t curl_transfer_write( char* ptr, size_t size, size_t nmemb, void* data ) {
+   
+   struct curl_transfer* t = (struct curl_transfer*)data;
+   
+   size_t total = size * nmemb;
+   size_t consumed = 0;
+   
+   if( !t->checked_status ) {
+   
+      t->checked_status = true;
+   
+      long http_status = 0;
+      curl_easy_getinfo( t->curl, CURLINFO_RESPONSE_CODE, &http_status );
+   
+      if( http_status == 200 ) {
+   
+         // the origin ignored our Range, and is sending the whole file
+         t->skip = t->offset;
+      }
+   }
+   
+   if( t->skip > 0 ) {
+   
+      consumed = MIN( t->skip, total );
+      t->skip -= consumed;
+   
+      if( consumed == total ) {
+         return total;
+      }
+   }
+   
+   size_t len = MIN( t->buf_len - t->num_written, total - consumed );
+   
+   memcpy( t->buf + t->num_written, ptr + consumed, len );
+   t->num_written += len;
+   
+   if( consumed + len < total ) {
+   
+      // more than we asked for (i.e. the rest of the file); we're done
+      t->full = true;
+      return 0;
+   }
+   
+   return total;
+}
+
+
+// look for the file size in Content-Range
+static size_t curl_transfer_header( char* ptr, size_t size, size_t nmemb, void* data ) {
+   
+   struct curl_transfer* t = (struct curl_transfer*)data;
+   
+   size_t len = size * nmemb;
+   static char const content_range[] = "Content-Range:";
+   
+   if( len > strlen(content_range) && strncasecmp( ptr, content_range, strlen(content_range) ) == 0 ) {
+   
+      // Content-Range: bytes X-Y/SIZE
+      char* slash = (char*)memchr( ptr, '/', len );
+      if( slash != NULL ) {
+   
+         char size_buf[32];
+         size_t size_len = MIN( len - (slash + 1 - ptr), sizeof(size_buf) - 1 );
+   
+         memcpy( size_buf, slash + 1, size_len );
+         size_buf[size_len] = 0;
+   
+         char* tmp = NULL;
+         long long total_size = strtoll( size_buf, &tmp, 10 );
+   
+         // NOTE: SIZE may be "*"
+         if( tmp != size_buf && total_size >= 0 ) {
+            t->total_size = total_size;
+         }
+      }
+   }
+   
+   return len;
+}
+
+
+// set up a transfer's curl handle and start it
+// only call this from the engine thread
+// return 0 on success
+// return -ENOMEM if OOM
+static int curl_engine_start_transfer( struct curl_engine* engine, struct curl_transfer* t ) {
+   
+   t->curl = curl_easy_init();
+   if( t->curl == NULL ) {
+      return -ENOMEM;
+   }
+   
+   curl_easy_setopt( t->curl, CURLOPT_URL, t->url );
+   curl_easy_setopt( t->curl, CURLOPT_PRIVATE, t );
+   curl_easy_setopt( t->curl, CURLOPT_NOSIGNAL, 1L );
+   curl_easy_setopt( t->curl, CURLOPT_TCP_KEEPALIVE, 1L );
+   curl_easy_setopt( t->curl, CURLOPT_FAILONERROR, 1L );
+   curl_easy_setopt( t->curl, CURLOPT_FILETIME, 1L );
+   curl_easy_setopt( t->curl, CURLOPT_HEADERFUNCTION, curl_transfer_header );
+   curl_easy_setopt( t->curl, CURLOPT_HEADERDATA, t );
+   
+   if( t->type == AG_CURL_TRANSFER_HEAD ) {
+   
+      curl_easy_setopt( t->curl, CURLOPT_NOBODY, 1L );
+   }
+   else {
+   
+      t->offset = t->first_block * engine->block_size;
+      t->buf_len = t->num_blocks * engine->block_size;
+   
+      t->buf = SG_CALLOC( char, t->buf_len );
+      if( t->buf == NULL ) {
+         return -ENOMEM;
+      }
+   
+      // format: X-Y, where X and Y are 64-bit byte indices.  Y is inclusive
+      snprintf( t->range, sizeof(t->range), "%zu-%zu", t->offset, t->offset + t->buf_len - 1 );
+   
+      curl_easy_setopt( t->curl, CURLOPT_RANGE, t->range );
+      curl_easy_setopt( t->curl, CURLOPT_WRITEFUNCTION, curl_transfer_write );
+      curl_easy_setopt( t->curl, CURLOPT_WRITEDATA, t );
+   }
+   
+   CURLMcode mrc = curl_multi_add_handle( engine->multi, t->curl );
+   if( mrc != CURLM_OK ) {
+   
+      SG_error("curl_multi_add_handle(%s) rc = %d\n", t->url, mrc );
+      return -ENOMEM;
+   }
+   
+   SG_debug("GET %s %s\n", t->url, (t->type == AG_CURL_TRANSFER_HEAD ? "(HEAD)" : t->range) );
+   
+   return 0;
+}
+
+
+// translate a finished transfer's curl status into 0 or -errno
+static int curl_transfer_status( struct curl_transfer* t, CURLcode rc ) {
+   
+   if( rc == CURLE_OK ) {
+      return 0;
+   }
+   
+   if( rc == CURLE_WRITE_ERROR && t->full ) {
+      // we stopped it on purpose
+      return 0;
+   }
+   
+   if( rc == CURLE_BAD_DOWNLOAD_RESUME ) {
+   
+      // off the end of the file
+      t->num_written = 0;
+      return 0;
+   }
+   
+   if( rc == CURLE_HTTP_RETURNED_ERROR ) {
+   
+      long http_status = 0;
+      curl_easy_getinfo( t->curl, CURLINFO_RESPONSE_CODE, &http_status );
+   
+      SG_error("GET %s: HTTP status %ld\n", t->url, http_status );
+   
+      if( http_status == 416 ) {
+   
+         // off the end of the file
+         t->num_written = 0;
+         return 0;
+      }
+      else if( http_status == 404 || http_status == 410 ) {
+         return -ENOENT;
+      }
+      else if( http_status == 401 || http_status == 403 ) {
+         return -EACCES;
+      }
+      else {
+         return -EREMOTEIO;
+      }
+   }
+   
+   long oserr = 0;
+   curl_easy_getinfo( t->curl, CURLINFO_OS_ERRNO, &oserr );
+   
+   SG_error("GET %s: curl rc = %d, errno = %ld\n", t->url, rc, -oserr );
+   
+   if( oserr != 0 ) {
+      return (int)(-oserr);
+   }
+   
+   return -EIO;
+}
+
+
+// hand a finished (or failed) transfer's results to its waiters, remember whatever blocks no one was waiting for, and free it.
+// the transfer must have been taken out of the multi handle.
+static void curl_engine_finish_transfer( struct curl_engine* engine, struct curl_transfer* t, int status ) {
+   
+   struct AG_driver_publish_info pubinfo;
+   bool have_pubinfo = false;
+   
+   memset( &pubinfo, 0, sizeof(struct AG_driver_publish_info) );
+   
+   // opportunistically learn the file's size and modification time
+   if( status == 0 && t->curl != NULL ) {
+   
+      long filetime = -1;
+      long http_status = 0;
+      curl_off_t content_length = -1;
+      off_t size = -1;
+   
+      curl_easy_getinfo( t->curl, CURLINFO_FILETIME, &filetime );
+      curl_easy_getinfo( t->curl, CURLINFO_RESPONSE_CODE, &http_status );
+      curl_easy_getinfo( t->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &content_length );
+   
+      if( t->type == AG_CURL_TRANSFER_HEAD || http_status == 200 ) {
+         size = content_length;
+      }
+      else if( http_status == 206 ) {
+         size = t->total_size;
+      }
+   
+      if( filetime >= 0 && size > 0 ) {
+   
+         pubinfo.size = size;
+         pubinfo.mtime_sec = filetime;
+         pubinfo.mtime_nsec = 0;
+   
+         have_pubinfo = true;
+      }
+      else if( t->type == AG_CURL_TRANSFER_HEAD ) {
+   
+         SG_error("HEAD %s: no size or modification time\n", t->url );
+         status = -ENODATA;
+      }
+   }
+   
+   pthread_mutex_lock( &engine->lock );
+   
+   for( curl_transfer_list_t::iterator itr = engine->active->begin(); itr != engine->active->end(); itr++ ) {
+   
+      if( *itr == t ) {
+         engine->active->erase( itr );
+         break;
+      }
+   }
+   
+   struct curl_url_state* us = curl_engine_url_state( engine, t->url );
+   
+   // only a transfer queued since the URL was last invalidated may update what we know about it
+   if( us != NULL && us->generation != t->generation ) {
+      us = NULL;
+   }
+   
+   if( us != NULL && have_pubinfo ) {
+   
+      us->pubinfo = pubinfo;
+      us->pubinfo_time = curl_engine_now();
+      us->have_pubinfo = true;
+   }
+   
+   if( t->type == AG_CURL_TRANSFER_HEAD ) {
+   
+      for( unsigned int i = 0; i < t->waiters->size(); i++ ) {
+   
+         struct curl_engine_waiter* w = t->waiters->at(i);
+   
+         if( status == 0 ) {
+            *w->pub_info = pubinfo;
+         }
+   
+         w->ret = status;
+      }
+   }
+   else {
+   
+      for( uint64_t i = 0; i < t->num_blocks; i++ ) {
+   
+         uint64_t block_id = t->first_block + i;
+         size_t block_offset = i * engine->block_size;
+         size_t len = 0;
+         bool claimed = false;
+   
+         if( t->num_written > block_offset ) {
+            len = MIN( engine->block_size, t->num_written - block_offset );
+         }
+   
+         for( unsigned int j = 0; j < t->waiters->size(); j++ ) {
+   
+            struct curl_engine_waiter* w = t->waiters->at(j);
+   
+            if( w->block_id != block_id ) {
+               continue;
+            }
+   
+            claimed = true;
+   
+            if( status == 0 ) {
+   
+               w->ret = MIN( len, w->buf_len );
+               memcpy( w->buf, t->buf + block_offset, w->ret );
+            }
+            else {
+               w->ret = status;
+            }
+         }
+   
+         if( !claimed && status == 0 && len > 0 && us != NULL ) {
+   
+            int rc = curl_engine_prefetch_put( engine, us, block_id, t->buf + block_offset, len );
+            if( rc != 0 ) {
+               SG_error("curl_engine_prefetch_put(%s, %" PRIu64 ") rc = %d\n", t->url, block_id, rc );
+            }
+         }
+      }
+   }
+   
+   for( unsigned int i = 0; i < t->waiters->size(); i++ ) {
+      t->waiters->at(i)->done = true;
+   }
+   
+   pthread_cond_broadcast( &engine->done_cv );
+   
+   pthread_mutex_unlock( &engine->lock );
+   
+   curl_transfer_free( t );
+}
+
+
+// engine thread: start queued transfers, drive the multi handle, and finish completed transfers
+static void* curl_engine_main( void* arg ) {
+   
+   struct curl_engine* engine = (struct curl_engine*)arg;
+   curl_transfer_list_t starting;
+   int still_running = 0;
+   
+   while( true ) {
+   
+      pthread_mutex_lock( &engine->lock );
+   
+      if( !engine->running ) {
+   
+         pthread_mutex_unlock( &engine->lock );
+         break;
+      }
+   
+      // once started, a transfer's range is fixed
+      starting.swap( *engine->pending );
+   
+      for( unsigned int i = 0; i < starting.size(); i++ ) {
+         engine->active->push_back( starting[i] );
+      }
+   
+      pthread_mutex_unlock( &engine->lock );
+   
+      for( unsigned int i = 0; i < starting.size(); i++ ) {
+   
+         int rc = curl_engine_start_transfer( engine, starting[i] );
+         if( rc != 0 ) {
+   
+            SG_error("curl_engine_start_transfer(%s) rc = %d\n", starting[i]->url, rc );
+            curl_engine_finish_transfer( engine, starting[i], rc );
+         }
+      }
+   
+      starting.clear();
+   
+      curl_multi_perform( engine->multi, &still_running );
+   
+      CURLMsg* msg = NULL;
+      int msgs_left = 0;
+   
+      while( (msg = curl_multi_info_read( engine->multi, &msgs_left )) != NULL ) {
+   
+         if( msg->msg != CURLMSG_DONE ) {
+            continue;
+         }
+   
+         struct curl_transfer* t = NULL;
+         CURLcode result = msg->data.result;
+   
+         curl_easy_getinfo( msg->easy_handle, CURLINFO_PRIVATE, (char**)&t );
+         curl_multi_remove_handle( engine->multi, msg->easy_handle );
+   
+         curl_engine_finish_transfer( engine, t, curl_transfer_status( t, result ) );
+      }
+   
+      // wait for the network, or for new requests
+      struct curl_waitfd wake_fd;
+   
+      wake_fd.fd = engine->wake_pipe[0];
+      wake_fd.events = CURL_WAIT_POLLIN;
+      wake_fd.revents = 0;
+   
+      curl_multi_wait( engine->multi, &wake_fd, 1, 1000, NULL );
+   
+      if( wake_fd.revents != 0 ) {
+   
+         char buf[256];
+         while( read( engine->wake_pipe[0], buf, sizeof(buf) ) > 0 );
+      }
+   }
+   
+   return NULL;
+}
+
+
+// read the driver config and start the engine thread, if we haven't yet.
+// (the driver is initialized before its config is loaded, so we do this on first use)
+// engine->lock must be held
+// return 0 on success
+// return -EPERM if we couldn't start the thread
+static int curl_engine_start( struct curl_engine* engine ) {
+   
+   if( engine->running ) {
+      return 0;
+   }
+   
+   engine->block_size = AG_driver_get_block_size();
+   engine->readahead_blocks = curl_engine_config_uint( AG_CURL_DRIVER_CONFIG_READAHEAD_BLOCKS, AG_CURL_READAHEAD_BLOCKS_DEFAULT );
+   engine->max_range_blocks = curl_engine_config_uint( AG_CURL_DRIVER_CONFIG_MAX_RANGE_BLOCKS, AG_CURL_MAX_RANGE_BLOCKS_DEFAULT );
+   engine->max_prefetch_blocks = curl_engine_config_uint( AG_CURL_DRIVER_CONFIG_PREFETCH_BLOCKS, AG_CURL_PREFETCH_BLOCKS_DEFAULT );
+   engine->head_cache_ttl = curl_engine_config_uint( AG_CURL_DRIVER_CONFIG_HEAD_CACHE_TTL, AG_CURL_HEAD_CACHE_TTL_DEFAULT );
+   
+   long max_host_connections = curl_engine_config_uint( AG_CURL_DRIVER_CONFIG_MAX_HOST_CONNECTIONS, AG_CURL_MAX_HOST_CONNECTIONS_DEFAULT );
+   
+   curl_multi_setopt( engine->multi, CURLMOPT_MAX_HOST_CONNECTIONS, max_host_connections );
+   curl_multi_setopt( engine->multi, CURLMOPT_MAXCONNECTS, (long)AG_CURL_MAX_CONNECTS );
+   
+   engine->running = true;
+   
+   engine->thread = md_start_thread( curl_engine_main, engine, false );
+   if( engine->thread == (pthread_t)(-1) ) {
+   
+      SG_error("%s", "md_start_thread(curl engine) failed\n" );
+   
+      engine->running = false;
+      return -EPERM;
+   }
+   
+   SG_debug("curl engine started: %ld connections per origin, %" PRIu64 " blocks of readahead, at most %" PRIu64 " blocks per request\n",
+            max_host_connections, engine->readahead_blocks, engine->max_range_blocks );
+   
+   return 0;
+}
+
+
+// set up the engine (the thread starts on first use)
+// return 0 on success
+// return -ENOMEM if OOM
+// return -errno if we couldn't make the wakeup pipe
+int curl_engine_init( struct curl_engine* engine ) {
+   
+   memset( engine, 0, sizeof(struct curl_engine) );
+   
+   int rc = pipe( engine->wake_pipe );
+   if( rc != 0 ) {
+   
+      rc = -errno;
+      SG_error("pipe errno = %d\n", rc );
+      return rc;
+   }
+   
+   pthread_mutex_init( &engine->lock, NULL );
+   pthread_cond_init( &engine->done_cv, NULL );
+   
+   fcntl( engine->wake_pipe[0], F_SETFL, O_NONBLOCK );
+   fcntl( engine->wake_pipe[1], F_SETFL, O_NONBLOCK );
+   
+   engine->multi = curl_multi_init();
+   engine->pending = new (nothrow) curl_transfer_list_t();
+   engine->active = new (nothrow) curl_transfer_list_t();
+   engine->urls = new (nothrow) curl_url_map_t();
+   engine->prefetch_lru = new (nothrow) curl_prefetch_lru_t();
+   
+   if( engine->multi == NULL || engine->pending == NULL || engine->active == NULL || engine->urls == NULL || engine->prefetch_lru == NULL ) {
+   
+      curl_engine_shutdown( engine );
+      return -ENOMEM;
+   }
+   
+   return 0;
+}
+
+
+// stop the engine thread, fail any outstanding transfers, and free the engine.
+// no driver thread may be using the engine.
+// always succeeds
+int curl_engine_shutdown( struct curl_engine* engine ) {
+   
+   if( engine->pending != NULL && engine->active != NULL && engine->urls != NULL && engine->prefetch_lru != NULL ) {
+   
+      pthread_mutex_lock( &engine->lock );
+   
+      bool was_running = engine->running;
+      engine->running = false;
+   
+      pthread_mutex_unlock( &engine->lock );
+   
+      if( was_running ) {
+   
+         curl_engine_wake( engine );
+         pthread_join( engine->thread, NULL );
+      }
+   
+      // fail whatever didn't finish
+      while( !engine->active->empty() ) {
+   
+         struct curl_transfer* t = engine->active->back();
+   
+         if( t->curl != NULL ) {
+            curl_multi_remove_handle( engine->multi, t->curl );
+         }
+   
+         curl_engine_finish_transfer( engine, t, -ENOTCONN );
+      }
+   
+      while( !engine->pending->empty() ) {
+   
+         struct curl_transfer* t = engine->pending->back();
+         engine->pending->pop_back();
+   
+         curl_engine_finish_transfer( engine, t, -ENOTCONN );
+      }
+   
+      for( curl_url_map_t::iterator itr = engine->urls->begin(); itr != engine->urls->end(); itr++ ) {
+   
+         curl_engine_prefetch_clear( engine, itr->second );
+   
+         delete itr->second->blocks;
+         free( itr->second );
+      }
+   }
+   
+   if( engine->pending != NULL ) {
+      delete engine->pending;
+   }
+   if( engine->active != NULL ) {
+      delete engine->active;
+   }
+   if( engine->urls != NULL ) {
+      delete engine->urls;
+   }
+   if( engine->prefetch_lru != NULL ) {
+      delete engine->prefetch_lru;
+   }
+   if( engine->multi != NULL ) {
+      curl_multi_cleanup( engine->multi );
+   }
+   
+   close( engine->wake_pipe[0] );
+   close( engine->wake_pipe[1] );
+   
+   pthread_mutex_destroy( &engine->lock );
+   pthread_cond_destroy( &engine->done_cv );
+   
+   memset( engine, 0, sizeof(struct curl_engine) );
+   
+   return 0;
+}
+
+
+// get a block of a URL, and put it into buf.
+// if we got it already (i.e. by reading ahead), this doesn't go to the origin.
+// return the number of bytes received (0 if the block is off the end of the file)
+// return -ENOMEM if OOM
+// return -ENOENT or -EACCES if the origin says so
+// return other -errno on error
+ssize_t curl_engine_get_block( struct curl_engine* engine, char const* url, uint64_t block_id, char* buf, size_t buf_len ) {
+   
+   struct curl_engine_waiter w;
+   memset( &w, 0, sizeof(struct curl_engine_waiter) );
+   
+   w.block_id = block_id;
+   w.buf = buf;
+   w.buf_len = buf_len;
+   
+   pthread_mutex_lock( &engine->lock );
+   
+   int rc = curl_engine_start( engine );
+   if( rc != 0 ) {
+   
+      pthread_mutex_unlock( &engine->lock );
+      return rc;
+   }
+   
+   struct curl_url_state* us = curl_engine_url_state( engine, url );
+   if( us == NULL ) {
+   
+      pthread_mutex_unlock( &engine->lock );
+      return -ENOMEM;
+   }
+   
+   bool sequential = (block_id > 0 && us->next_block == block_id);
+   us->next_block = block_id + 1;
+   
+   // read ahead already?
+   curl_prefetch_map_t::iterator itr = us->blocks->find( block_id );
+   if( itr != us->blocks->end() ) {
+   
+      struct curl_prefetch_block* pb = itr->second;
+      ssize_t len = MIN( pb->len, buf_len );
+   
+      memcpy( buf, pb->buf, len );
+   
+      // the AG caches the block itself from here on
+      curl_engine_prefetch_remove( engine, pb );
+   
+      pthread_mutex_unlock( &engine->lock );
+      return len;
+   }
+   
+   // already on its way?
+   struct curl_transfer* t = curl_engine_find_transfer( engine->pending, AG_CURL_TRANSFER_BLOCKS, url, block_id );
+   if( t == NULL ) {
+      t = curl_engine_find_transfer( engine->active, AG_CURL_TRANSFER_BLOCKS, url, block_id );
+   }
+   
+   if( t == NULL ) {
+   
+      // next to a range that hasn't started yet?  merge it in
+      for( unsigned int i = 0; i < engine->pending->size(); i++ ) {
+   
+         struct curl_transfer* p = engine->pending->at(i);
+   
+         if( p->type != AG_CURL_TRANSFER_BLOCKS || p->num_blocks >= engine->max_range_blocks || strcmp( p->url, url ) != 0 ) {
+            continue;
+         }
+   
+         if( p->first_block + p->num_blocks == block_id ) {
+   
+            p->num_blocks++;
+            t = p;
+            break;
+         }
+         else if( block_id + 1 == p->first_block ) {
+   
+            p->first_block--;
+            p->num_blocks++;
+            t = p;
+            break;
+         }
+      }
+   }
+   
+   if( t == NULL ) {
+   
+      // new request.  If we're being read in order, get the next few blocks too (but not past the end of the file, if we know where it is)
+      uint64_t num_blocks = 1;
+   
+      if( sequential ) {
+         num_blocks = MIN( 1 + engine->readahead_blocks, engine->max_range_blocks );
+      }
+   
+      if( us->have_pubinfo && us->pubinfo.size >= 0 ) {
+   
+         uint64_t file_blocks = (us->pubinfo.size + engine->block_size - 1) / engine->block_size;
+   
+         if( block_id < file_blocks ) {
+            num_blocks = MIN( num_blocks, file_blocks - block_id );
+         }
+      }
+   
+      t = curl_transfer_new( AG_CURL_TRANSFER_BLOCKS, url, block_id, num_blocks, us->generation );
+      if( t == NULL ) {
+   
+         pthread_mutex_unlock( &engine->lock );
+         return -ENOMEM;
+      }
+   
+      try {
+         engine->pending->push_back( t );
+      }
+      catch( bad_alloc& ba ) {
+   
+         pthread_mutex_unlock( &engine->lock );
+   
+         curl_transfer_free( t );
+         return -ENOMEM;
+      }
+   
+      curl_engine_wake( engine );
+   }
+   
+   try {
+      t->waiters->push_back( &w );
+   }
+   catch( bad_alloc& ba ) {
+   
+      // the transfer will just prefetch our block
+      pthread_mutex_unlock( &engine->lock );
+      return -ENOMEM;
+   }
+   
+   while( !w.done ) {
+      pthread_cond_wait( &engine->done_cv, &engine->lock );
+   }
+   
+   pthread_mutex_unlock( &engine->lock );
+   
+   return w.ret;
+}
+
+
+// get a cached HEAD result for a URL, if we have a fresh one
+// return 0 on success
+// return -ENOENT if not cached, or if it's too old
+int curl_engine_get_cached_pubinfo( struct curl_engine* engine, char const* url, struct AG_driver_publish_info* pub_info ) {
+   
+   int rc = -ENOENT;
+   
+   pthread_mutex_lock( &engine->lock );
+   
+   curl_engine_start( engine );
+   
+   curl_url_map_t::iterator itr = engine->urls->find( string(url) );
+   if( itr != engine->urls->end() ) {
+   
+      struct curl_url_state* us = itr->second;
+   
+      if( us->have_pubinfo && curl_engine_now() - us->pubinfo_time < engine->head_cache_ttl ) {
+   
+         *pub_info = us->pubinfo;
+         rc = 0;
+      }
+   }
+   
+   pthread_mutex_unlock( &engine->lock );
+   
+   return rc;
+}
+
+
+// HEAD a URL to get its size and modification time, sharing the request with anyone else doing the same.
+// the result is cached.
+// return 0 on success
+// return -ENODATA if the origin didn't tell us
+// return -ENOMEM if OOM
+// return other -errno on error
+int curl_engine_stat( struct curl_engine* engine, char const* url, struct AG_driver_publish_info* pub_info ) {
+   
+   struct curl_engine_waiter w;
+   memset( &w, 0, sizeof(struct curl_engine_waiter) );
+   
+   w.pub_info = pub_info;
+   
+   pthread_mutex_lock( &engine->lock );
+   
+   int rc = curl_engine_start( engine );
+   if( rc != 0 ) {
+   
+      pthread_mutex_unlock( &engine->lock );
+      return rc;
+   }
+   
+   struct curl_url_state* us = curl_engine_url_state( engine, url );
+   if( us == NULL ) {
+   
+      pthread_mutex_unlock( &engine->lock );
+      return -ENOMEM;
+   }
+   
+   struct curl_transfer* t = curl_engine_find_transfer( engine->pending, AG_CURL_TRANSFER_HEAD, url, 0 );
+   if( t == NULL ) {
+      t = curl_engine_find_transfer( engine->active, AG_CURL_TRANSFER_HEAD, url, 0 );
+   }
+   
+   if( t == NULL ) {
+   
+      t = curl_transfer_new( AG_CURL_TRANSFER_HEAD, url, 0, 0, us->generation );
+      if( t == NULL ) {
+   
+         pthread_mutex_unlock( &engine->lock );
+         return -ENOMEM;
+      }
+   
+      try {
+         engine->pending->push_back( t );
+      }
+      catch( bad_alloc& ba ) {
+   
+         pthread_mutex_unlock( &engine->lock );
+   
+         curl_transfer_free( t );
+         return -ENOMEM;
+      }
+   
+      curl_engine_wake( engine );
+   }
+   
+   try {
+      t->waiters->push_back( &w );
+   }
+   catch( bad_alloc& ba ) {
+   
+      pthread_mutex_unlock( &engine->lock );
+      return -ENOMEM;
+   }
+   
+   while( !w.done ) {
+      pthread_cond_wait( &engine->done_cv, &engine->lock );
+   }
+   
+   pthread_mutex_unlock( &engine->lock );
+   
+   return (int)w.ret;
+}
+
+
+// forget everything we know about a URL:  its prefetched blocks and its HEAD result.
+// transfers already on their way will still be delivered to whoever is waiting for them, but won't be remembered.
+// always succeeds
+int curl_engine_invalidate( struct curl_engine* engine, char const* url ) {
+   
+   pthread_mutex_lock( &engine->lock );
+   
+   curl_url_map_t::iterator itr = engine->urls->find( string(url) );
+   if( itr != engine->urls->end() ) {
+   
+      struct curl_url_state* us = itr->second;
+   
+      curl_engine_prefetch_clear( engine, us );
+   
+      us->have_pubinfo = false;
+      us->next_block = 0;
+      us->generation++;
+   }
+   
+   pthread_mutex_unlock( &engine->lock );
+   
+   return 0;
+}
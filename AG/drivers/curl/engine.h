@@ -0,0 +1,168 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Download engine for the curl driver.
+// All requests to the origins go through one curl multi handle, driven by one thread, so connections (and DNS
+// lookups) are kept alive and reused across requests instead of set up for each block.  A driver thread that needs
+// a block queues a request for it and waits.  Requests for adjacent blocks of the same URL that are queued together
+// are merged into a single range GET, and a request that follows the previous one for its URL reads ahead a few
+// blocks; the blocks no one has asked for yet are kept in memory until someone does.  HEAD results are cached too,
+// and concurrent HEADs for the same URL share one request.
+
+#ifndef _AG_CURL_ENGINE_H_
+#define _AG_CURL_ENGINE_H_
+
+#include <map>
+#include <list>
+#include <vector>
+#include <string>
+
+#include <curl/curl.h>
+
+#include "libsyndicate/libsyndicate.h"
+
+#include "AG/driver.h"
+
+using namespace std;
+
+#define AG_CURL_DRIVER_CONFIG_MAX_HOST_CONNECTIONS "max_host_connections"
+#define AG_CURL_DRIVER_CONFIG_READAHEAD_BLOCKS "readahead_blocks"
+#define AG_CURL_DRIVER_CONFIG_MAX_RANGE_BLOCKS "max_range_blocks"
+#define AG_CURL_DRIVER_CONFIG_PREFETCH_BLOCKS "prefetch_blocks"
+#define AG_CURL_DRIVER_CONFIG_HEAD_CACHE_TTL "head_cache_ttl"
+
+#define AG_CURL_MAX_HOST_CONNECTIONS_DEFAULT 8
+#define AG_CURL_READAHEAD_BLOCKS_DEFAULT 4
+#define AG_CURL_MAX_RANGE_BLOCKS_DEFAULT 16
+#define AG_CURL_PREFETCH_BLOCKS_DEFAULT 256
+#define AG_CURL_HEAD_CACHE_TTL_DEFAULT 60
+
+#define AG_CURL_MAX_CONNECTS 64         // most idle connections to keep open, over all origins
+
+#define AG_CURL_TRANSFER_BLOCKS 1
+#define AG_CURL_TRANSFER_HEAD   2
+
+// a driver thread waiting on a transfer
+struct curl_engine_waiter {
+
+   uint64_t block_id;                           // block it wants (block transfers only)
+   char* buf;
+   size_t buf_len;
+
+   struct AG_driver_publish_info* pub_info;     // where to put the HEAD result (HEAD transfers only)
+
+   ssize_t ret;                                 // bytes received, or -errno
+   bool done;
+};
+
+typedef vector<struct curl_engine_waiter*> curl_engine_waiter_list_t;
+
+// a request to an origin
+struct curl_transfer {
+
+   int type;
+   char* url;
+   CURL* curl;
+
+   // range to get (block transfers only)
+   uint64_t first_block;
+   uint64_t num_blocks;
+   char range[42];                              // "X-Y", 64-bit byte offsets
+
+   char* buf;
+   size_t buf_len;
+   size_t num_written;
+
+   size_t offset;                               // byte offset of first_block
+   size_t skip;                                 // bytes to drop before the range starts, if the origin ignored our Range
+   bool checked_status;                         // if true, we've looked at the response status and set skip
+   bool full;                                   // if true, we aborted the download because we had the whole range
+
+   off_t total_size;                            // file size, from Content-Range (-1 if not known)
+
+   uint64_t generation;                         // URL's generation when we were queued
+
+   curl_engine_waiter_list_t* waiters;
+};
+
+typedef vector<struct curl_transfer*> curl_transfer_list_t;
+
+struct curl_url_state;
+
+// a block we got from the origin before anyone asked for it
+struct curl_prefetch_block {
+
+   struct curl_url_state* owner;
+   uint64_t block_id;
+
+   char* buf;
+   size_t len;
+
+   list<struct curl_prefetch_block*>::iterator lru_itr;
+};
+
+typedef map<uint64_t, struct curl_prefetch_block*> curl_prefetch_map_t;
+typedef list<struct curl_prefetch_block*> curl_prefetch_lru_t;
+
+// what we know about a URL
+struct curl_url_state {
+
+   curl_prefetch_map_t* blocks;                 // prefetched blocks
+
+   uint64_t next_block;                         // block after the last one requested (for detecting sequential reads)
+   uint64_t generation;                         // incremented when the URL is invalidated, so older transfers don't repopulate it
+
+   bool have_pubinfo;                           // cached HEAD result
+   struct AG_driver_publish_info pubinfo;
+   int64_t pubinfo_time;                        // when we got it (seconds since the epoch)
+};
+
+typedef map<string, struct curl_url_state*> curl_url_map_t;
+
+// the engine
+struct curl_engine {
+
+   CURLM* multi;
+
+   pthread_t thread;
+   bool running;
+   int wake_pipe[2];                            // written to wake up the engine thread
+
+   curl_transfer_list_t* pending;               // not yet started (and may still grow)
+   curl_transfer_list_t* active;                // started
+
+   curl_url_map_t* urls;
+   curl_prefetch_lru_t* prefetch_lru;           // prefetched blocks, least recently fetched first
+
+   uint64_t block_size;
+   uint64_t readahead_blocks;
+   uint64_t max_range_blocks;
+   uint64_t max_prefetch_blocks;
+   int64_t head_cache_ttl;
+
+   pthread_mutex_t lock;                        // guards all of the above
+   pthread_cond_t done_cv;                      // signaled when a transfer finishes
+};
+
+int curl_engine_init( struct curl_engine* engine );
+int curl_engine_shutdown( struct curl_engine* engine );
+
+ssize_t curl_engine_get_block( struct curl_engine* engine, char const* url, uint64_t block_id, char* buf, size_t buf_len );
+int curl_engine_stat( struct curl_engine* engine, char const* url, struct AG_driver_publish_info* pub_info );
+int curl_engine_get_cached_pubinfo( struct curl_engine* engine, char const* url, struct AG_driver_publish_info* pub_info );
+int curl_engine_invalidate( struct curl_engine* engine, char const* url );
+
+#endif
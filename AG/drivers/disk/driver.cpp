@@ -64,24 +64,332 @@ static int errno_to_HTTP_status( struct AG_connection_context* ag_ctx, int err )
    return -1;
 }
 
+// read from an offset, retrying on EINTR and short reads 
+// return the number of bytes read (less than len only at EOF)
+// return -errno on error
+static ssize_t pread_uninterrupted( int fd, char* buf, size_t len, off_t offset ) {
+   
+   ssize_t num_read = 0;
+   while( (unsigned)num_read < len ) {
+      
+      ssize_t nr = pread( fd, buf + num_read, len - num_read, offset + num_read );
+      if( nr < 0 ) {
+         
+         int errsv = -errno;
+         if( errsv == -EINTR ) {
+            continue;
+         }
+         
+         return errsv;
+      }
+      if( nr == 0 ) {
+         break;
+      }
+      
+      num_read += nr;
+   }
+   
+   return num_read;
+}
+
+// how many files should we keep open?
+// this is the configured fd_cache_size, but no more than half of our fd limit (the rest are for connections and the cache)
+static size_t fd_cache_size(void) {
+   
+   size_t max_fds = AG_DISK_FD_CACHE_SIZE_DEFAULT;
+   
+   char* max_fds_str = AG_driver_get_config_var( AG_CONFIG_DISK_FD_CACHE_SIZE );
+   if( max_fds_str != NULL ) {
+      
+      char* tmp = NULL;
+      long val = strtol( max_fds_str, &tmp, 10 );
+      
+      if( tmp == max_fds_str || val <= 0 ) {
+         SG_error("Configuration error: Invalid value '%s' for '%s'; using %zu\n", max_fds_str, AG_CONFIG_DISK_FD_CACHE_SIZE, max_fds );
+      }
+      else {
+         max_fds = val;
+      }
+      
+      free( max_fds_str );
+   }
+   
+   struct rlimit rlim;
+   int rc = getrlimit( RLIMIT_NOFILE, &rlim );
+   if( rc == 0 && rlim.rlim_cur != RLIM_INFINITY && max_fds > rlim.rlim_cur / 2 ) {
+      
+      SG_debug("Capping %s at %zu (half of RLIMIT_NOFILE)\n", AG_CONFIG_DISK_FD_CACHE_SIZE, (size_t)(rlim.rlim_cur / 2) );
+      max_fds = (rlim.rlim_cur > 1 ? rlim.rlim_cur / 2 : 1);
+   }
+   
+   return max_fds;
+}
+
+// close and free an fd entry
+static void fd_free( struct AG_disk_fd* fdent ) {
+   
+   close( fdent->fd );
+   free( fdent->path );
+   free( fdent );
+}
+
+// remove an fd entry from the cache, and drop the cache's reference to it.
+// state->lock must be held.
+// return true if that was the last reference, in which case the caller must fd_free() it (outside the lock)
+static bool fd_uncache_locked( struct AG_disk_state* state, struct AG_disk_fd* fdent ) {
+   
+   if( fdent->cached ) {
+      
+      state->fds->erase( string(fdent->path) );
+      state->lru->erase( fdent->lru_itr );
+      
+      fdent->cached = false;
+      fdent->refcount--;
+   }
+   
+   return (fdent->refcount == 0);
+}
+
+// drop a connection's reference to an fd entry.
+// it gets closed if it's no longer cached and no one else is reading it.
+static void fd_release( struct AG_disk_state* state, struct AG_disk_fd* fdent ) {
+   
+   pthread_mutex_lock( &state->lock );
+   
+   fdent->refcount--;
+   bool last = (fdent->refcount == 0);
+   
+   pthread_mutex_unlock( &state->lock );
+   
+   if( last ) {
+      fd_free( fdent );
+   }
+}
+
+// get a referenced fd entry for a dataset file, opening it and caching it if it isn't open already.
+// evicts the least-recently-used files once the cache is full.
+// return 0 on success, and set *ret_fdent
+// return -ENOMEM if OOM
+// return -errno if we couldn't open the file
+static int fd_acquire( struct AG_disk_state* state, char const* dataset_path, struct AG_disk_fd** ret_fdent ) {
+   
+   vector<struct AG_disk_fd*> evicted;
+   struct stat sb;
+   
+   pthread_mutex_lock( &state->lock );
+   
+   if( state->max_fds == 0 ) {
+      state->max_fds = fd_cache_size();
+   }
+   
+   AG_disk_fd_map_t::iterator itr = state->fds->find( string(dataset_path) );
+   if( itr != state->fds->end() ) {
+      
+      // hit
+      struct AG_disk_fd* fdent = itr->second;
+      
+      fdent->refcount++;
+      state->lru->splice( state->lru->end(), *state->lru, fdent->lru_itr );
+      
+      pthread_mutex_unlock( &state->lock );
+      
+      *ret_fdent = fdent;
+      return 0;
+   }
+   
+   pthread_mutex_unlock( &state->lock );
+   
+   // miss; open it 
+   int fd = open( dataset_path, O_RDONLY );
+   if( fd < 0 ) {
+      fd = -errno;
+      SG_error("Failed to open %s, errno = %d\n", dataset_path, fd );
+      
+      return fd;
+   }
+   
+   int rc = fstat( fd, &sb );
+   if( rc != 0 ) {
+      rc = -errno;
+      SG_error("fstat(%s) errno = %d\n", dataset_path, rc );
+      
+      close( fd );
+      return rc;
+   }
+   
+   // readers generally go through a file block by block
+   posix_fadvise( fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+   
+   struct AG_disk_fd* fdent = SG_CALLOC( struct AG_disk_fd, 1 );
+   char* path = strdup( dataset_path );
+   
+   if( fdent == NULL || path == NULL ) {
+      
+      if( fdent != NULL ) {
+         free( fdent );
+      }
+      if( path != NULL ) {
+         free( path );
+      }
+      
+      close( fd );
+      return -ENOMEM;
+   }
+   
+   fdent->fd = fd;
+   fdent->path = path;
+   fdent->dev = sb.st_dev;
+   fdent->ino = sb.st_ino;
+   fdent->refcount = 1;
+   fdent->next_offset = -1;
+   
+   pthread_mutex_lock( &state->lock );
+   
+   itr = state->fds->find( string(dataset_path) );
+   if( itr != state->fds->end() ) {
+      
+      // someone else opened it while we were
+      struct AG_disk_fd* other = itr->second;
+      
+      other->refcount++;
+      state->lru->splice( state->lru->end(), *state->lru, other->lru_itr );
+      
+      pthread_mutex_unlock( &state->lock );
+      
+      fd_free( fdent );
+      
+      *ret_fdent = other;
+      return 0;
+   }
+   
+   try {
+      
+      fdent->lru_itr = state->lru->insert( state->lru->end(), fdent );
+      
+      try {
+         (*state->fds)[ string(dataset_path) ] = fdent;
+      }
+      catch( bad_alloc& ba ) {
+         
+         state->lru->erase( fdent->lru_itr );
+         throw;
+      }
+      
+      fdent->cached = true;
+      fdent->refcount++;
+   }
+   catch( bad_alloc& ba ) {
+      
+      // just don't cache it 
+      SG_error("Not caching fd for %s: OOM\n", dataset_path );
+   }
+   
+   // make room 
+   while( state->fds->size() > state->max_fds ) {
+      
+      struct AG_disk_fd* victim = state->lru->front();
+      
+      if( fd_uncache_locked( state, victim ) ) {
+         evicted.push_back( victim );
+      }
+   }
+   
+   pthread_mutex_unlock( &state->lock );
+   
+   for( unsigned int i = 0; i < evicted.size(); i++ ) {
+      fd_free( evicted[i] );
+   }
+   
+   *ret_fdent = fdent;
+   return 0;
+}
+
+// forget the cached fd for a dataset file, so the next connection re-opens it.
+// connections still reading from the old fd keep it until they close.
+static void fd_invalidate( struct AG_disk_state* state, char const* dataset_path ) {
+   
+   struct AG_disk_fd* victim = NULL;
+   
+   pthread_mutex_lock( &state->lock );
+   
+   AG_disk_fd_map_t::iterator itr = state->fds->find( string(dataset_path) );
+   if( itr != state->fds->end() ) {
+      
+      if( fd_uncache_locked( state, itr->second ) ) {
+         victim = itr->second;
+      }
+   }
+   
+   pthread_mutex_unlock( &state->lock );
+   
+   if( victim != NULL ) {
+      fd_free( victim );
+   }
+}
+
 // initialize the driver 
 int driver_init( void** driver_state ) {
    SG_debug("%s driver init\n", DRIVER_QUERY_TYPE );
+   
+   struct AG_disk_state* state = SG_CALLOC( struct AG_disk_state, 1 );
+   if( state == NULL ) {
+      return -ENOMEM;
+   }
+   
+   state->fds = new (nothrow) AG_disk_fd_map_t();
+   state->lru = new (nothrow) AG_disk_fd_lru_t();
+   
+   if( state->fds == NULL || state->lru == NULL ) {
+      
+      if( state->fds != NULL ) {
+         delete state->fds;
+      }
+      if( state->lru != NULL ) {
+         delete state->lru;
+      }
+      
+      free( state );
+      return -ENOMEM;
+   }
+   
+   pthread_mutex_init( &state->lock, NULL );
+   
+   *driver_state = state;
    return 0;
 }
 
 // shut down the driver 
 int driver_shutdown( void* driver_state ) {
    SG_debug("%s driver shutdown\n", DRIVER_QUERY_TYPE );
+   
+   struct AG_disk_state* state = (struct AG_disk_state*)driver_state;
+   if( state == NULL ) {
+      return 0;
+   }
+   
+   // no connections are open at this point, so the cache holds the only references
+   for( AG_disk_fd_lru_t::iterator itr = state->lru->begin(); itr != state->lru->end(); itr++ ) {
+      fd_free( *itr );
+   }
+   
+   delete state->fds;
+   delete state->lru;
+   
+   pthread_mutex_destroy( &state->lock );
+   free( state );
+   
    return 0;
 }
 
 // set up an incoming connection.
-// try to open the file.
+// get the file's fd from the cache, opening it if need be.
 int connect_dataset_block( struct AG_connection_context* ag_ctx, void* driver_state, void** driver_connection_state ) {
    
    SG_debug("%s connect dataset\n", DRIVER_QUERY_TYPE );
    
+   struct AG_disk_state* state = (struct AG_disk_state*)driver_state;
+   struct AG_disk_fd* fdent = NULL;
+   
    char* request_path = AG_driver_get_request_path( ag_ctx );
    
    // get the absolute path 
@@ -96,14 +404,12 @@ int connect_dataset_block( struct AG_connection_context* ag_ctx, void* driver_st
    
    free( request_path );
    
-   // open the file 
-   int fd = open( dataset_path, O_RDONLY );
-   if( fd < 0 ) {
-      fd = -errno;
-      SG_error("Failed to open %s, errno = %d\n", dataset_path, fd );
+   // get the file 
+   int rc = fd_acquire( state, dataset_path, &fdent );
+   if( rc != 0 ) {
       
       free( dataset_path );
-      return fd;
+      return rc;
    }
    
    free( dataset_path );
@@ -111,8 +417,14 @@ int connect_dataset_block( struct AG_connection_context* ag_ctx, void* driver_st
    // got it!
    // set up a connection context 
    struct AG_disk_context* disk_ctx = SG_CALLOC( struct AG_disk_context, 1 );
+   if( disk_ctx == NULL ) {
+      
+      fd_release( state, fdent );
+      return -ENOMEM;
+   }
    
-   disk_ctx->fd = fd;
+   disk_ctx->fdent = fdent;
+   disk_ctx->state = state;
    
    *driver_connection_state = disk_ctx;
    
@@ -128,7 +440,7 @@ int close_dataset_block( void* driver_connection_state ) {
    struct AG_disk_context* disk_ctx = (struct AG_disk_context*)driver_connection_state;
    
    if( disk_ctx != NULL ) {
-      close( disk_ctx->fd );
+      fd_release( disk_ctx->state, disk_ctx->fdent );
       free( disk_ctx );
    }
    
@@ -142,26 +454,23 @@ ssize_t get_dataset_block( struct AG_connection_context* ag_ctx, uint64_t block_
    SG_debug("%s get dataset block %" PRIu64 "\n", DRIVER_QUERY_TYPE, block_id );
    
    struct AG_disk_context* disk_ctx = (struct AG_disk_context*)driver_connection_state;
+   struct AG_disk_fd* fdent = disk_ctx->fdent;
    
-   // seek to the appropriate offset 
    uint64_t block_size = AG_driver_get_block_size();
    off_t block_offset = block_size * block_id;
    
-   int rc = lseek( disk_ctx->fd, block_offset, SEEK_SET );
-   if( rc < 0 ) {
-      rc = -errno;
-      SG_error("lseek errno = %d\n", rc );
-      
-      errno_to_HTTP_status( ag_ctx, rc );
-      
-      return rc;
+   // if this block follows the last one read from this file, have the kernel start on the next few.
+   // (next_offset is only a hint, so racing readers just cost us a hint)
+   off_t prev_offset = __sync_lock_test_and_set( &fdent->next_offset, block_offset + (off_t)block_size );
+   if( prev_offset == block_offset ) {
+      posix_fadvise( fdent->fd, block_offset + block_size, block_size * AG_DISK_READAHEAD_BLOCKS, POSIX_FADV_WILLNEED );
    }
    
    // read in the buffer 
-   ssize_t num_read = md_read_uninterrupted( disk_ctx->fd, block_buf, buf_len );
+   ssize_t num_read = pread_uninterrupted( fdent->fd, block_buf, buf_len, block_offset );
    if( num_read < 0 ) {
       
-      SG_error("md_read_uninterrupted rc = %zd\n", num_read );
+      SG_error("pread(%s) rc = %zd\n", fdent->path, num_read );
       errno_to_HTTP_status( ag_ctx, num_read );
    }
    
@@ -184,15 +493,34 @@ int stat_dataset( char const* path, struct AG_map_info* map_info, struct AG_driv
    struct stat sb;
    int rc = 0;
    
+   struct AG_disk_state* state = (struct AG_disk_state*)driver_state;
+   
    // stat the path 
    rc = stat( dataset_path, &sb );
    if( rc != 0 ) {
       rc = -errno;
       SG_error("stat(%s) errno = %d\n", dataset_path, rc);
+      
+      fd_invalidate( state, dataset_path );
+      
       free( dataset_path );
       return rc;
    }
    
+   // if the file was replaced, stop serving the old one 
+   pthread_mutex_lock( &state->lock );
+   
+   AG_disk_fd_map_t::iterator itr = state->fds->find( string(dataset_path) );
+   bool stale = (itr != state->fds->end() && (itr->second->dev != sb.st_dev || itr->second->ino != sb.st_ino));
+   
+   pthread_mutex_unlock( &state->lock );
+   
+   if( stale ) {
+      
+      SG_debug("%s was replaced; reopening\n", dataset_path );
+      fd_invalidate( state, dataset_path );
+   }
+   
    free( dataset_path );
    
    // fill in the publish info
@@ -203,6 +531,26 @@ int stat_dataset( char const* path, struct AG_map_info* map_info, struct AG_driv
    return 0;
 }
 
+// a dataset has been republished.
+// close our cached fd for it, so subsequent block requests see the file as it is now.
+int reversion_dataset( char const* path, struct AG_map_info* map_info, void* driver_state ) {
+   
+   SG_debug("%s reversion dataset %s\n", DRIVER_QUERY_TYPE, path );
+   
+   struct AG_disk_state* state = (struct AG_disk_state*)driver_state;
+   
+   char* dataset_path = get_request_abspath( path );
+   if( dataset_path == NULL ) {
+      SG_error("%s", "Could not translate request to absolute path\n" );
+      return -EINVAL;
+   }
+   
+   fd_invalidate( state, dataset_path );
+   
+   free( dataset_path );
+   return 0;
+}
+
 // handle a driver-specfic event.
 // there are none for this driver.
 int handle_event( char* event_payload, size_t event_payload_len, void* driver_state ) {
@@ -18,10 +18,14 @@
 #define _AG_DISK_DRIVER_H_
 
 #include <map>
+#include <list>
 #include <string>
 #include <sstream>
 
 #include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <fcntl.h>
 #include <errno.h>
 
 #include "libsyndicate/libsyndicate.h"
@@ -29,13 +33,52 @@
 #include "AG/driver.h"
 
 #define AG_CONFIG_DISK_DATASET_ROOT "dataset_root"
+#define AG_CONFIG_DISK_FD_CACHE_SIZE "fd_cache_size"
+
+// default number of dataset files to keep open 
+#define AG_DISK_FD_CACHE_SIZE_DEFAULT 1024
+
+// number of blocks to read ahead once a file is being read sequentially
+#define AG_DISK_READAHEAD_BLOCKS 4
 
 using namespace std;
 
+// an open dataset file, shared by all connections reading it.
+// it stays open while it's cached or while a connection uses it, whichever is longer.
+struct AG_disk_fd {
+   int fd;
+   
+   char* path;          // absolute path on disk
+   dev_t dev;           // identity of the file we opened, so we can tell if it's been replaced
+   ino_t ino;
+   
+   int refcount;        // one per connection, plus one while cached
+   bool cached;         // if true, this is in the fd cache
+   
+   off_t next_offset;   // offset just past the last block read (for detecting sequential reads)
+   
+   list<struct AG_disk_fd*>::iterator lru_itr;  // position in the LRU list, if cached
+};
+
+typedef map<string, struct AG_disk_fd*> AG_disk_fd_map_t;
+typedef list<struct AG_disk_fd*> AG_disk_fd_lru_t;
+
+// driver state: the fd cache, keyed by absolute path
+struct AG_disk_state {
+   AG_disk_fd_map_t* fds;
+   AG_disk_fd_lru_t* lru;       // least-recently-used first
+   size_t max_fds;              // most files to keep open (0 means "not yet read from the config")
+   
+   pthread_mutex_t lock;        // guards all of the above, and each cached fd's refcount
+};
+
 // connection context for reading from disk
 struct AG_disk_context {
    // input descriptor
-   int fd;
+   struct AG_disk_fd* fdent;
+   
+   // driver state, for releasing fdent
+   struct AG_disk_state* state;
 };
 
 extern "C" {
@@ -51,6 +94,8 @@ ssize_t get_dataset_block( struct AG_connection_context* ag_ctx, uint64_t block_
 
 int stat_dataset( char const* path, struct AG_map_info* ag_dataset_info, struct AG_driver_publish_info* pub_info, void* driver_state );
 
+int reversion_dataset( char const* path, struct AG_map_info* ag_dataset_info, void* driver_state );
+
 int handle_event( char* event_payload, size_t event_payload_len, void* driver_state );
 
 char* get_query_type(void);
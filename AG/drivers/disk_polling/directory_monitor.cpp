@@ -17,10 +17,13 @@
 #include <map>
 #include <string.h>
 #include <string>
+#include <vector>
 #include <stdio.h>
 #include <stdlib.h>
 #include <iostream>
 #include <ftw.h>
+#include <pthread.h>
+#include <sys/stat.h>
 
 #include "directory_monitor.h"
 
@@ -29,6 +32,9 @@ using namespace std;
 static map<string, struct filestat_cache*> cached_entry_map;
 static map<string, struct filestat_cache*> current_entry_map;
 
+// serializes full rescans and single-entry checks (and so, the handler calls they make)
+static pthread_mutex_t monitor_lock = PTHREAD_MUTEX_INITIALIZER;
+
 static int check_current_entries(const char* parentDir);
 static int current_entry_found(const char *fpath, const struct stat *sb, int tflag, struct FTW *ftwbuf);
 
@@ -45,6 +51,9 @@ static void clear_current_entries();
 static void make_all_current_entries_cached();
 static bool is_same_entry(struct filestat_cache *pentry1, struct filestat_cache *pentry2);
 
+static void free_stat_cache(struct filestat_cache *pentry);
+static void remove_cached_subtree(string spath, PFN_DIR_ENTRY_MODIFIED_HANDLER handler);
+
 static int check_current_entries(const char* root) {
     int flags = FTW_PHYS;
     
@@ -73,6 +82,54 @@ static struct filestat_cache* make_stat_cache(const char *fpath, const struct st
     return pcache;
 }
 
+static void free_stat_cache(struct filestat_cache *pentry) {
+    if(pentry->fpath != NULL) {
+        free(pentry->fpath);
+    }
+
+    if(pentry->sb != NULL) {
+        free(pentry->sb);
+    }
+
+    free(pentry);
+}
+
+// report a cached entry and everything cached under it as removed, deepest first, and forget them
+static void remove_cached_subtree(string spath, PFN_DIR_ENTRY_MODIFIED_HANDLER handler) {
+    string prefix = spath + "/";
+    std::map<string, struct filestat_cache*>::iterator iter;
+    vector<string> children;
+
+    for(iter=cached_entry_map.lower_bound(prefix);iter!=cached_entry_map.end();iter++) {
+        if(iter->first.compare(0, prefix.size(), prefix) != 0) {
+            break;
+        }
+        children.push_back(iter->first);
+    }
+
+    // children sort after their parents, so go backwards
+    for(int i = (int)children.size() - 1; i >= 0; i--) {
+        iter = cached_entry_map.find(children[i]);
+
+        if(handler != NULL) {
+            handler(DIR_ENTRY_MODIFIED_FLAG_REMOVED, iter->first, iter->second);
+        }
+
+        free_stat_cache(iter->second);
+        cached_entry_map.erase(iter);
+    }
+
+    std::map<string, struct filestat_cache*>::iterator found = cached_entry_map.find(spath);
+    if(found != cached_entry_map.end()) {
+        if(handler != NULL) {
+            handler(DIR_ENTRY_MODIFIED_FLAG_REMOVED, found->first, found->second);
+        }
+
+        free_stat_cache(found->second);
+        cached_entry_map.erase(found);
+    }
+}
+
 static void add_cached_entry(const char *fpath, struct filestat_cache *pentry) {
     string spath(fpath);
     cached_entry_map[spath] = pentry;
@@ -172,6 +229,8 @@ int check_modified(const char *fpath, PFN_DIR_ENTRY_MODIFIED_HANDLER handler) {
         return -1;
     }
     
+    pthread_mutex_lock(&monitor_lock);
+    
     check_current_entries(fpath);
     
     // find new entry
@@ -206,6 +265,59 @@ int check_modified(const char *fpath, PFN_DIR_ENTRY_MODIFIED_HANDLER handler) {
     }
     
     make_all_current_entries_cached();
+    
+    pthread_mutex_unlock(&monitor_lock);
+    return 0;
+}
+
+// re-check a single path against the cache (i.e. because we were told it changed), and report what changed.
+// if it's gone, so is everything under it.
+int check_entry(const char *fpath, PFN_DIR_ENTRY_MODIFIED_HANDLER handler) {
+    if(fpath == NULL) {
+        return -1;
+    }
+    
+    string spath(fpath);
+    struct stat sb;
+    
+    pthread_mutex_lock(&monitor_lock);
+    
+    if(lstat(fpath, &sb) != 0 || !(S_ISDIR(sb.st_mode) || S_ISREG(sb.st_mode))) {
+        // gone, or not something we publish
+        remove_cached_subtree(spath, handler);
+        
+        pthread_mutex_unlock(&monitor_lock);
+        return 0;
+    }
+    
+    int tflag = (S_ISDIR(sb.st_mode) ? FTW_D : FTW_F);
+    struct filestat_cache *pcache = make_stat_cache(fpath, &sb, tflag);
+    
+    std::map<string, struct filestat_cache*>::iterator found = cached_entry_map.find(spath);
+    if(found != cached_entry_map.end() && found->second->tflag != tflag) {
+        // replaced a file with a directory, or vice versa
+        remove_cached_subtree(spath, handler);
+        found = cached_entry_map.end();
+    }
+    
+    if(found == cached_entry_map.end()) {
+        // new
+        if(handler != NULL) {
+            handler(DIR_ENTRY_MODIFIED_FLAG_NEW, spath, pcache);
+        }
+        add_cached_entry(spath, pcache);
+    } else if(!is_same_entry(found->second, pcache)) {
+        // modified
+        if(handler != NULL) {
+            handler(DIR_ENTRY_MODIFIED_FLAG_MODIFIED, spath, pcache);
+        }
+        free_stat_cache(found->second);
+        found->second = pcache;
+    } else {
+        free_stat_cache(pcache);
+    }
+    
+    pthread_mutex_unlock(&monitor_lock);
     return 0;
 }
 
@@ -19,6 +19,7 @@
 
 #include <string>
 #include <stdlib.h>
+#include <sys/stat.h>
 
 #define MAX_NUM_DIRECTORY_OPENED        20
 
@@ -38,6 +39,7 @@ typedef void (*PFN_DIR_ENTRY_MODIFIED_HANDLER)(int flag, std::string spath, stru
 
 void init_monitor();
 int check_modified(const char *fpath, PFN_DIR_ENTRY_MODIFIED_HANDLER handler);
+int check_entry(const char *fpath, PFN_DIR_ENTRY_MODIFIED_HANDLER handler);
 
 #endif	/* DIRECTORY_MONITOR_H */
 
@@ -252,8 +252,16 @@ extern "C" int publish_dataset (struct gateway_context*, ms_client *client,
         return pfunc_exit_code;        
     }
 
-    SG_debug("set timeout schedule - %dseconds\n", REFRESH_ENTRIES_TIMEOUT);
-    if (set_timeout_event(REFRESH_ENTRIES_TIMEOUT, timeout_handler) < 0) {
+    // publish changes as they happen, and fall back to rescanning
+    int timeout = RESCAN_ENTRIES_TIMEOUT;
+    int rc = start_inotify_monitor(datapath, entry_modified_handler);
+    if (rc != 0) {
+        SG_error("start_inotify_monitor(%s) rc = %d; polling instead\n", datapath, rc);
+        timeout = REFRESH_ENTRIES_TIMEOUT;
+    }
+
+    SG_debug("set timeout schedule - %dseconds\n", timeout);
+    if (set_timeout_event(timeout, timeout_handler) < 0) {
         SG_error("%s", "set_timeout_event error\n");
         return pfunc_exit_code;
     }
@@ -452,7 +460,7 @@ void entry_modified_handler(int flag, string spath, struct filestat_cache *pcach
 }
 
 void* term_handler(void *cls) {
-    //Nothing to do here.
+    stop_inotify_monitor();
     exit(0);
 }
 
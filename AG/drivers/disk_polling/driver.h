@@ -32,12 +32,18 @@
 #include <AG-util.h>
 
 #include "directory_monitor.h"
+#include "inotify_monitor.h"
 #include "timeout_event.h"
 
 using namespace std;
 
+// seconds between full rescans, if we can't watch the dataset for changes
 #define REFRESH_ENTRIES_TIMEOUT	10
 
+// seconds between full rescans, if we're watching the dataset for changes.
+// these only catch what the watches miss (i.e. files changed but not closed), so they can be rare.
+#define RESCAN_ENTRIES_TIMEOUT	3600
+
 
 #define GATEWAY_REQUEST_TYPE_NONE 0
 #define GATEWAY_REQUEST_TYPE_LOCAL_FILE 1
@@ -0,0 +1,292 @@
+/*
+   Copyright 2013 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include <map>
+#include <string.h>
+#include <string>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
+#include <limits.h>
+#include <poll.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <sys/inotify.h>
+
+#include "inotify_monitor.h"
+
+using namespace std;
+
+// what we want to hear about.  IN_MODIFY is left out on purpose:  a file being written gets one per write, and we
+// only need to look at it once it's closed (or its attributes change).  Files modified without being closed get
+// picked up by the next full rescan.
+#define INOTIFY_WATCH_MASK (IN_CREATE | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_ONLYDIR | IN_DONT_FOLLOW)
+
+static int g_inotify_fd = -1;
+static int g_stop_pipe[2] = {-1, -1};
+static pthread_t g_inotify_thread;
+static bool g_inotify_running = false;
+
+static string g_root;
+static PFN_DIR_ENTRY_MODIFIED_HANDLER g_handler = NULL;
+
+// watch descriptor to the directory it watches.  Only touched by the monitor thread once it's running.
+static map<int, string> g_watch_paths;
+
+// first error from adding watches during a walk
+static int g_watch_error = 0;
+
+static int add_watch(const char *dirpath);
+static int watch_found(const char *fpath, const struct stat *sb, int tflag, struct FTW *ftwbuf);
+static int check_found(const char *fpath, const struct stat *sb, int tflag, struct FTW *ftwbuf);
+static int watch_subtree(const char *dirpath);
+static void unwatch_subtree(string spath);
+static void handle_inotify_event(struct inotify_event *event);
+static void* inotify_monitor_thread(void *param);
+
+static int add_watch(const char *dirpath) {
+    int wd = inotify_add_watch(g_inotify_fd, dirpath, INOTIFY_WATCH_MASK);
+    if(wd < 0) {
+        return -errno;
+    }
+
+    // NOTE: re-watching a directory gives back the same wd
+    g_watch_paths[wd] = string(dirpath);
+    return 0;
+}
+
+static int watch_found(const char *fpath, const struct stat *sb, int tflag, struct FTW *ftwbuf) {
+    if(tflag == FTW_D) {
+        int rc = add_watch(fpath);
+        if(rc != 0 && rc != -ENOENT) {
+            // i.e. -ENOSPC if we're out of watches
+            g_watch_error = rc;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int check_found(const char *fpath, const struct stat *sb, int tflag, struct FTW *ftwbuf) {
+    if(tflag == FTW_D || tflag == FTW_F) {
+        check_entry(fpath, g_handler);
+    }
+
+    return 0;
+}
+
+// watch a directory and every directory under it
+// return 0 on success, or -errno if we couldn't add a watch
+static int watch_subtree(const char *dirpath) {
+    g_watch_error = 0;
+
+    if(nftw(dirpath, watch_found, MAX_NUM_DIRECTORY_OPENED, FTW_PHYS) == -1 && errno != ENOENT) {
+        return -errno;
+    }
+
+    return g_watch_error;
+}
+
+// stop watching a directory and every directory under it (i.e. it was moved away)
+static void unwatch_subtree(string spath) {
+    string prefix = spath + "/";
+    map<int, string>::iterator iter = g_watch_paths.begin();
+
+    while(iter != g_watch_paths.end()) {
+        if(iter->second == spath || iter->second.compare(0, prefix.size(), prefix) == 0) {
+            inotify_rm_watch(g_inotify_fd, iter->first);
+            g_watch_paths.erase(iter++);
+        } else {
+            iter++;
+        }
+    }
+}
+
+static void handle_inotify_event(struct inotify_event *event) {
+    if(event->mask & IN_Q_OVERFLOW) {
+        // we've lost events.  Make sure we're watching everything, and rescan.
+        fprintf(stderr, "inotify queue overflowed; rescanning %s\n", g_root.c_str());
+
+        int rc = watch_subtree(g_root.c_str());
+        if(rc != 0) {
+            fprintf(stderr, "watch_subtree(%s) rc = %d\n", g_root.c_str(), rc);
+        }
+
+        check_modified(g_root.c_str(), g_handler);
+        return;
+    }
+
+    map<int, string>::iterator found = g_watch_paths.find(event->wd);
+    if(found == g_watch_paths.end()) {
+        return;
+    }
+
+    if(event->mask & IN_IGNORED) {
+        // the directory is gone (its parent's watch tells us about that)
+        g_watch_paths.erase(found);
+        return;
+    }
+
+    if(event->len == 0) {
+        // about the directory itself
+        return;
+    }
+
+    string spath = found->second + "/" + event->name;
+
+    if((event->mask & IN_ISDIR) && (event->mask & (IN_CREATE | IN_MOVED_TO))) {
+        // a new directory.  Watch it before looking inside, so nothing created in it gets past us.
+        int rc = watch_subtree(spath.c_str());
+        if(rc != 0) {
+            fprintf(stderr, "watch_subtree(%s) rc = %d; changes under it will be found by rescanning\n", spath.c_str(), rc);
+        }
+
+        nftw(spath.c_str(), check_found, MAX_NUM_DIRECTORY_OPENED, FTW_PHYS);
+        return;
+    }
+
+    if((event->mask & IN_ISDIR) && (event->mask & IN_MOVED_FROM)) {
+        unwatch_subtree(spath);
+    }
+
+    check_entry(spath.c_str(), g_handler);
+}
+
+static void* inotify_monitor_thread(void *param) {
+    // room for at least one event with the longest name, aligned for struct inotify_event
+    char buf[64 * (sizeof(struct inotify_event) + NAME_MAX + 1)] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+    struct pollfd fds[2];
+    fds[0].fd = g_inotify_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = g_stop_pipe[0];
+    fds[1].events = POLLIN;
+
+    while(true) {
+        int rc = poll(fds, 2, -1);
+        if(rc < 0) {
+            if(errno == EINTR) {
+                continue;
+            }
+
+            fprintf(stderr, "poll errno = %d\n", -errno);
+            break;
+        }
+
+        if(fds[1].revents != 0) {
+            // stop
+            break;
+        }
+
+        ssize_t len = read(g_inotify_fd, buf, sizeof(buf));
+        if(len <= 0) {
+            continue;
+        }
+
+        for(char *ptr = buf; ptr < buf + len; ) {
+            struct inotify_event *event = (struct inotify_event*)ptr;
+
+            handle_inotify_event(event);
+
+            ptr += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    return NULL;
+}
+
+// watch everything under root, and report changes to handler as they happen.
+// call this after the first full scan (check_modified), so the cache is populated.
+// return 0 on success
+// return -ENOSPC if there are too many directories to watch (see /proc/sys/fs/inotify/max_user_watches), or another
+// -errno if we couldn't set up inotify.  Either way, we're not watching anything, and the caller should keep polling.
+int start_inotify_monitor(const char *root, PFN_DIR_ENTRY_MODIFIED_HANDLER handler) {
+    if(g_inotify_running) {
+        return -EINVAL;
+    }
+
+    g_root = string(root);
+    while(g_root.size() > 1 && g_root[g_root.size() - 1] == '/') {
+        g_root.erase(g_root.size() - 1);
+    }
+
+    g_handler = handler;
+
+    g_inotify_fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    if(g_inotify_fd < 0) {
+        int rc = -errno;
+        fprintf(stderr, "inotify_init1 errno = %d\n", rc);
+        return rc;
+    }
+
+    if(pipe(g_stop_pipe) != 0) {
+        int rc = -errno;
+        fprintf(stderr, "pipe errno = %d\n", rc);
+
+        close(g_inotify_fd);
+        g_inotify_fd = -1;
+        return rc;
+    }
+
+    int rc = watch_subtree(g_root.c_str());
+    if(rc == 0) {
+        rc = pthread_create(&g_inotify_thread, NULL, inotify_monitor_thread, NULL);
+        if(rc != 0) {
+            rc = -rc;
+        }
+    }
+
+    if(rc != 0) {
+        fprintf(stderr, "Failed to watch %s, rc = %d\n", g_root.c_str(), rc);
+
+        close(g_inotify_fd);
+        close(g_stop_pipe[0]);
+        close(g_stop_pipe[1]);
+
+        g_inotify_fd = -1;
+        g_watch_paths.clear();
+        return rc;
+    }
+
+    g_inotify_running = true;
+
+    printf("watching %zu directories under %s\n", g_watch_paths.size(), g_root.c_str());
+    return 0;
+}
+
+// stop watching
+void stop_inotify_monitor() {
+    if(!g_inotify_running) {
+        return;
+    }
+
+    char c = 0;
+    if(write(g_stop_pipe[1], &c, 1) < 0) {
+        fprintf(stderr, "write(stop pipe) errno = %d\n", -errno);
+    }
+
+    pthread_join(g_inotify_thread, NULL);
+
+    close(g_inotify_fd);
+    close(g_stop_pipe[0]);
+    close(g_stop_pipe[1]);
+
+    g_inotify_fd = -1;
+    g_watch_paths.clear();
+    g_inotify_running = false;
+}
@@ -0,0 +1,30 @@
+/*
+   Copyright 2013 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Event-driven change detection.
+// Puts an inotify watch on every directory under the dataset root, and re-checks each path the kernel says changed
+// (with check_entry), so changes reach the handler as they happen instead of at the next full rescan.  Directories
+// that appear are watched (and their contents reported) as they appear.  If the kernel drops events, we rescan.
+
+#ifndef INOTIFY_MONITOR_H
+#define	INOTIFY_MONITOR_H
+
+#include "directory_monitor.h"
+
+int start_inotify_monitor(const char *root, PFN_DIR_ENTRY_MODIFIED_HANDLER handler);
+void stop_inotify_monitor();
+
+#endif	/* INOTIFY_MONITOR_H */
@@ -16,11 +16,175 @@
 
 #include "block-index.h"
 #include <stdio.h>
+#include <string.h>
+
+//64-bit FNV-1a
+static uint64_t hash_string(string str)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < str.size(); i++) {
+	hash ^= (unsigned char)str[i];
+	hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
 
 BlockIndex::BlockIndex()
 {
     map_mutex = new pthread_mutex_t;
     pthread_mutex_init(map_mutex, NULL);
+    idx_files_lock = new pthread_rwlock_t;
+    pthread_rwlock_init(idx_files_lock, NULL);
+}
+
+//Keep block indexes in dir, so they outlive the driver.
+//Without one, block indexes are only kept in memory.
+void BlockIndex::set_index_dir(const char* dir)
+{
+    if (dir == NULL)
+	return;
+    if (mkdir(dir, 0700) < 0 && errno != EEXIST) {
+	perror("mkdir");
+	return;
+    }
+    pthread_mutex_lock(map_mutex);
+    index_dir = string(dir);
+    pthread_mutex_unlock(map_mutex);
+}
+
+string BlockIndex::index_path(string file_name)
+{
+    //One file per mapped file, named after a hash of its path (the
+    //path itself could be too long for a file name).
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.idx",
+	     (unsigned long long)hash_string(file_name));
+    return index_dir + name;
+}
+
+//Is fd the persisted block index of file_name, and not of another
+//file whose path has the same hash?
+bool BlockIndex::index_path_matches(int fd, string file_name)
+{
+    block_index_header hdr;
+    if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+	hdr.magic != BLOCK_INDEX_MAGIC ||
+	hdr.path_len != file_name.size())
+	return false;
+    string path(file_name.size(), '\0');
+    if (pread(fd, &path[0], path.size(), sizeof(hdr)) != (ssize_t)path.size())
+	return false;
+    return path == file_name;
+}
+
+//Does blkie pick up where prev (the entry of the block before it)
+//left off? Block 0 starts at the first byte of the first row. Every
+//block holds at least one byte, so a zero-filled entry (one whose
+//block was written after the next one's, and lost in a crash) fails.
+static bool block_index_entry_follows(block_index_entry *prev,
+				      block_index_entry *blkie)
+{
+    off_t start_row = (prev != NULL ? prev->end_row : 0);
+    off_t start_byte_offset = (prev != NULL ? prev->end_byte_offset : 0);
+    if (blkie->start_row != start_row ||
+	blkie->start_byte_offset != start_byte_offset)
+	return false;
+    return (blkie->end_row > blkie->start_row ||
+	    (blkie->end_row == blkie->start_row &&
+	     blkie->end_byte_offset > blkie->start_byte_offset));
+}
+
+//Read the persisted block index of file_name into blk_list, and keep
+//it open for new entries. If it was built with other queries or
+//another block size, start over. If its name is taken by another
+//file's index, file_name's index is only kept in memory.
+//Entries are written without holding map_mutex, so a crash can leave
+//a hole before the last ones; only the entries up to the first one
+//that doesn't follow on from the one before are kept.
+//map_mutex must be held.
+void BlockIndex::load_block_index(string file_name, uint64_t query_hash,
+				  vector<block_index_entry*> *blk_list)
+{
+    block_index_header hdr;
+    block_index_entry blkie;
+    block_index_file idxf;
+    string path = index_path(file_name);
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd < 0) {
+	perror("open");
+	return;
+    }
+    idxf.fd = fd;
+    idxf.entries_offset = sizeof(hdr) + file_name.size();
+    if (index_path_matches(fd, file_name)) {
+	if (pread(fd, &hdr, sizeof(hdr), 0) == sizeof(hdr) &&
+	    hdr.block_size == (uint64_t)AG_BLOCK_SIZE() &&
+	    hdr.query_hash == query_hash) {
+	    off_t offset = idxf.entries_offset;
+	    while (pread(fd, &blkie, sizeof(blkie), offset) == sizeof(blkie)) {
+		block_index_entry *prev = (blk_list->empty() ? NULL : blk_list->back());
+		if (!block_index_entry_follows(prev, &blkie)) {
+		    fprintf(stderr, "%s: block index %s is broken at block %zu\n",
+			    file_name.c_str(), path.c_str(), blk_list->size());
+		    break;
+		}
+		block_index_entry *new_blkie = alloc_block_index_entry();
+		*new_blkie = blkie;
+		blk_list->push_back(new_blkie);
+		offset += sizeof(blkie);
+	    }
+	    //Drop a record cut short by a crash, and whatever follows a
+	    //broken one.
+	    if (ftruncate(fd, offset) < 0)
+		perror("ftruncate");
+	    idx_files[file_name] = idxf;
+	    return;
+	}
+    }
+    else if (pread(fd, &hdr, sizeof(hdr), 0) == sizeof(hdr) &&
+	     hdr.magic == BLOCK_INDEX_MAGIC) {
+	fprintf(stderr, "%s: block index %s belongs to another file\n",
+		file_name.c_str(), path.c_str());
+	close(fd);
+	return;
+    }
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = BLOCK_INDEX_MAGIC;
+    hdr.block_size = AG_BLOCK_SIZE();
+    hdr.query_hash = query_hash;
+    hdr.path_len = file_name.size();
+    if (ftruncate(fd, 0) < 0 || 
+	pwrite(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) ||
+	pwrite(fd, file_name.data(), file_name.size(), sizeof(hdr)) != (ssize_t)file_name.size()) {
+	perror("write");
+	close(fd);
+	return;
+    }
+    idx_files[file_name] = idxf;
+}
+
+//idx_files_lock must be read-locked, so idxf.fd stays open.
+void BlockIndex::persist_entry(block_index_file idxf, off_t block_id,
+			       block_index_entry* blkie)
+{
+    off_t offset = idxf.entries_offset + (block_id * sizeof(block_index_entry));
+    if (pwrite(idxf.fd, blkie, sizeof(block_index_entry), offset) != sizeof(block_index_entry))
+	perror("pwrite");
+}
+
+//Get file_name's block index ready, loading it from index_dir if
+//this is the first we've seen of it. query identifies the mapping.
+void BlockIndex::open_block_index(string file_name, string query)
+{
+    pthread_mutex_lock(map_mutex);
+    if (blk_map.find(file_name) == blk_map.end()) {
+	vector<block_index_entry*> *blk_list = new vector<block_index_entry*>();
+	blk_list->reserve(MAX_INDEX_SIZE);
+	if (!index_dir.empty())
+	    load_block_index(file_name, hash_string(query), blk_list);
+	blk_map[file_name] = blk_list;
+    }
+    pthread_mutex_unlock(map_mutex);
 }
 
 block_index_entry* BlockIndex::alloc_block_index_entry()
@@ -33,96 +197,164 @@ block_index_entry* BlockIndex::alloc_block_index_entry()
     return blkie;
 }
 
+//Entries are written to disk after map_mutex is released, so indexing
+//blocks of other files doesn't wait on the disk.
 void BlockIndex::update_block_index(string file_name, off_t block_id, block_index_entry* blkie)
 {
-    vector<block_index_entry*> *blk_list = NULL, *old_blk_list = NULL;
-    pthread_mutex_t blk_index_mutex = PTHREAD_MUTEX_INITIALIZER;
+    vector<block_index_entry*> *blk_list = NULL;
+    bool persist = false;
+    block_index_file idxf;
+    block_index_entry entry = *blkie;
+    pthread_mutex_lock(map_mutex);
     BlockMap::iterator itr = blk_map.find(file_name);
-    MutexMap::iterator mitr = mutex_map.find(file_name);
-    if (itr != blk_map.end() && mitr != mutex_map.end()) {
-	//Acquire lock for this file's block index
-	pthread_mutex_lock(&(mitr->second));
+    if (itr != blk_map.end()) {
 	blk_list = itr->second;
-	blk_list->resize(blk_list->size() + 1);
-	(*blk_list)[block_id] = blkie;
-	//Release block index lock
-	pthread_mutex_unlock(&(mitr->second));
     }
     else {
 	blk_list = new vector<block_index_entry*>();
 	blk_list->reserve(MAX_INDEX_SIZE);
-	blk_list->resize(1);
-	(*blk_list)[block_id] = blkie;
-	//Acquire locks for maps...
-	pthread_mutex_lock(map_mutex);
-	//Check whether someone has already updated 
-	//blk_map and mutex_map... if so replace them.
-	if ((old_blk_list = blk_map[file_name]) != NULL) {
-	    blk_map[file_name] = blk_list;
-	    delete old_blk_list;
-	    mutex_map[file_name] = blk_index_mutex;
-	}
-	else {
-	    blk_map[file_name] = blk_list;
-	    mutex_map[file_name] = blk_index_mutex;
+	blk_map[file_name] = blk_list;
+    }
+    if ((ssize_t)blk_list->size() <= block_id) {
+	//Entries are only persisted while there is no gap before them.
+	if ((ssize_t)blk_list->size() == block_id) {
+	    BlockIndexFiles::iterator fitr = idx_files.find(file_name);
+	    if (fitr != idx_files.end()) {
+		idxf = fitr->second;
+		persist = true;
+	    }
 	}
-	//Release locks for maps...
+	blk_list->resize(block_id + 1, NULL);
+    }
+    else if ((*blk_list)[block_id] != NULL) {
+	delete (*blk_list)[block_id];
+    }
+    (*blk_list)[block_id] = blkie;
+    if (!persist) {
 	pthread_mutex_unlock(map_mutex);
+	return;
     }
+    //Keep idxf.fd from being closed before we're done with it.
+    pthread_rwlock_rdlock(idx_files_lock);
+    pthread_mutex_unlock(map_mutex);
+    persist_entry(idxf, block_id, &entry);
+    pthread_rwlock_unlock(idx_files_lock);
 }
 
-const block_index_entry* BlockIndex::get_block(string file_name, off_t block_id)
+bool BlockIndex::get_block(string file_name, off_t block_id, block_index_entry* blkie)
 {
+    bool found = false;
     if (block_id < 0)
-	return NULL;
-    vector<block_index_entry*> *blk_list = NULL;
+	return false;
+    pthread_mutex_lock(map_mutex);
     BlockMap::iterator itr = blk_map.find(file_name);
     if (itr != blk_map.end()) {
-	blk_list = itr->second;
-	if ((ssize_t)blk_list->size() <= block_id)
-	    return NULL;
-	if (blk_list)
-	    return (*blk_list)[block_id];
-	else
-	    return NULL;
+	vector<block_index_entry*> *blk_list = itr->second;
+	if ((ssize_t)blk_list->size() > block_id && (*blk_list)[block_id] != NULL) {
+	    *blkie = *(*blk_list)[block_id];
+	    found = true;
+	}
     }
-    else 
-	return NULL;
+    pthread_mutex_unlock(map_mutex);
+    return found;
 }
 
-const block_index_entry* BlockIndex::get_last_block(string file_name, off_t *block_id)
+bool BlockIndex::get_last_block(string file_name, off_t *block_id, block_index_entry* blkie)
 {
-    vector<block_index_entry*> *blk_list = NULL;
+    bool found = false;
+    pthread_mutex_lock(map_mutex);
     BlockMap::iterator itr = blk_map.find(file_name);
     if (itr != blk_map.end()) {
-	blk_list = itr->second;
-	if (blk_list) {
-	    block_index_entry *blkie =  blk_list->back();
+	vector<block_index_entry*> *blk_list = itr->second;
+	if (!blk_list->empty() && blk_list->back() != NULL) {
+	    *blkie = *blk_list->back();
 	    *block_id = blk_list->size() - 1;
-	    return blkie;
+	    found = true;
 	}
-	return NULL;
     }
-    else 
-	return NULL;
+    pthread_mutex_unlock(map_mutex);
+    return found;
 }
 
+//Keep a block read ahead of the reader until it asks for it.
+void BlockIndex::cache_block(string file_name, off_t block_id, string& data)
+{
+    pthread_mutex_lock(map_mutex);
+    block_cache_entry *bce = blk_cache[file_name];
+    if (bce == NULL) {
+	bce = new block_cache_entry;
+	bce->next_block_id = 0;
+	blk_cache[file_name] = bce;
+    }
+    bce->blocks[block_id] = data;
+    while (bce->blocks.size() > MAX_CACHED_BLOCKS)
+	bce->blocks.erase(bce->blocks.begin());
+    pthread_mutex_unlock(map_mutex);
+}
+
+//Take block_id out of the read-ahead cache, if it's there. Either
+//way, sequential is set to whether the reader asked for the block
+//right after the last one it asked for.
+bool BlockIndex::get_cached_block(string file_name, off_t block_id,
+				  string* data, bool* sequential)
+{
+    bool found = false;
+    pthread_mutex_lock(map_mutex);
+    block_cache_entry *bce = blk_cache[file_name];
+    if (bce == NULL) {
+	bce = new block_cache_entry;
+	bce->next_block_id = 0;
+	blk_cache[file_name] = bce;
+    }
+    *sequential = (bce->next_block_id == block_id);
+    bce->next_block_id = block_id + 1;
+    map<off_t, string>::iterator itr = bce->blocks.find(block_id);
+    if (itr != bce->blocks.end()) {
+	data->swap(itr->second);
+	bce->blocks.erase(itr);
+	found = true;
+    }
+    pthread_mutex_unlock(map_mutex);
+    return found;
+}
 
+//Forget everything about file_name, on disk too.
 void BlockIndex::invalidate_entry(string file_name) {
-    vector<block_index_entry*> *blk_list = NULL;
+    pthread_mutex_lock(map_mutex);
     BlockMap::iterator itr = blk_map.find(file_name);
-    MutexMap::iterator mitr = mutex_map.find(file_name);
-    if (itr != blk_map.end() && mitr != mutex_map.end()) {
-	pthread_mutex_lock(map_mutex);
-	//Acquire lock for this file's block index
-	pthread_mutex_lock(&(mitr->second));
-	blk_list = itr->second;
-	free_block_index(blk_list);
-	blk_list->resize(blk_list->size() - 1);
-	//Release block index lock
-	pthread_mutex_unlock(&(mitr->second));
-	pthread_mutex_unlock(map_mutex);
+    if (itr != blk_map.end()) {
+	free_block_index(itr->second);
+	blk_map.erase(itr);
+    }
+    BlockCache::iterator citr = blk_cache.find(file_name);
+    if (citr != blk_cache.end()) {
+	delete citr->second;
+	blk_cache.erase(citr);
+    }
+    if (!index_dir.empty()) {
+	string path = index_path(file_name);
+	//Wait for entries being written to it.
+	pthread_rwlock_wrlock(idx_files_lock);
+	BlockIndexFiles::iterator fitr = idx_files.find(file_name);
+	bool ours = false;
+	if (fitr != idx_files.end()) {
+	    close(fitr->second.fd);
+	    idx_files.erase(fitr);
+	    ours = true;
+	}
+	else {
+	    //Not opened yet; don't remove another file's index.
+	    int fd = open(path.c_str(), O_RDONLY);
+	    if (fd >= 0) {
+		ours = index_path_matches(fd, file_name);
+		close(fd);
+	    }
+	}
+	pthread_rwlock_unlock(idx_files_lock);
+	if (ours && unlink(path.c_str()) < 0 && errno != ENOENT)
+	    perror("unlink");
     }
+    pthread_mutex_unlock(map_mutex);
 }
 
 void BlockIndex::free_block_index(vector<block_index_entry*> *blk_list) {
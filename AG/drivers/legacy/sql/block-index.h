@@ -18,7 +18,11 @@
 #define _BLOCK_INDEX_H_
 
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
 #include <pthread.h>
 
 #include <map>
@@ -29,6 +33,8 @@
 #include <gateway-ctx.h>
 
 #define MAX_INDEX_SIZE 1024
+#define MAX_CACHED_BLOCKS 16
+#define BLOCK_INDEX_MAGIC 0x53514c424c4b4958ULL //"SQLBLKIX"
 #define AG_BLOCK_SIZE()\
     (sysconf(_SC_PAGESIZE) * 10)
 
@@ -48,9 +54,32 @@ typedef struct {
     off_t   end_byte_offset;
 } block_index_entry;
 
+//Header of a persisted block index. It is followed by the path of
+//the mapped file (path_len bytes), and then the entries, which are
+//only good for the queries and the block size they were built with.
+typedef struct {
+    uint64_t	magic;
+    uint64_t	block_size;
+    uint64_t	query_hash;
+    uint64_t	path_len;
+} block_index_header;
+
+//Open persisted block index.
+typedef struct {
+    int		fd;
+    off_t	entries_offset;
+} block_index_file;
+
+//Blocks read ahead of the reader, not asked for yet.
+typedef struct {
+    map<off_t, string>	blocks;
+    off_t		next_block_id;
+} block_cache_entry;
+
 
 typedef map<string, vector<block_index_entry*>*> BlockMap;
-typedef map<string, pthread_mutex_t> MutexMap;
+typedef map<string, block_cache_entry*> BlockCache;
+typedef map<string, block_index_file> BlockIndexFiles;
 
 void invalidate_entry(void* cls);
 
@@ -59,17 +88,32 @@ block_translation_info volume_block_to_ag_block(struct gateway_ctx *ctx);
 class BlockIndex {
     private:
 	BlockMap	    blk_map;
-	MutexMap	    mutex_map;
+	BlockCache	    blk_cache;
+	BlockIndexFiles	    idx_files;
 	pthread_mutex_t	    *map_mutex;
+	pthread_rwlock_t    *idx_files_lock;
+	string		    index_dir;
 	void free_block_index(vector<block_index_entry*> *);
+	string index_path(string file_name);
+	bool index_path_matches(int fd, string file_name);
+	void load_block_index(string file_name, uint64_t query_hash,
+				vector<block_index_entry*> *blk_list);
+	void persist_entry(block_index_file idxf, off_t block_id,
+				block_index_entry* blkie);
     public:
 	BlockIndex();
+	void set_index_dir(const char* dir);
+	void open_block_index(string file_name, string query);
 	block_index_entry* alloc_block_index_entry();
 	void update_block_index(string file_name, off_t block_id, 
 				block_index_entry* blkie);
-	const block_index_entry* get_block(string file_name,
-					   off_t block_id);
-	const block_index_entry* get_last_block(string file_name, off_t *block_id);
+	bool get_block(string file_name, off_t block_id,
+			block_index_entry* blkie);
+	bool get_last_block(string file_name, off_t *block_id,
+			block_index_entry* blkie);
+	void cache_block(string file_name, off_t block_id, string& data);
+	bool get_cached_block(string file_name, off_t block_id,
+				string* data, bool* sequential);
 	void invalidate_entry(string file_name);
 };
 
@@ -529,6 +529,12 @@ void init(unsigned char* dsn) {
       memcpy(dsn_string, ODBC_DSN_PREFIX, strlen((const char*)ODBC_DSN_PREFIX));
       memcpy(dsn_string + strlen((const char*)ODBC_DSN_PREFIX), dsn, strlen((const char*)dsn));
    }
+   if (global_conf->storage_root != NULL) {
+      // keep block indexes across restarts
+      char* index_dir = md_fullpath(global_conf->storage_root, SQL_BLOCK_INDEX_DIR, NULL);
+      ODBCHandler::get_handle(dsn_string).set_index_dir(index_dir);
+      free(index_dir);
+   }
    if (revd == NULL) {
       revd = new ReversionDaemon();
       revd->run();
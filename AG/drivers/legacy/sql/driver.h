@@ -52,6 +52,9 @@ using namespace std;
 
 #define ODBC_DSN_PREFIX                "DSN="
 
+// where block indexes are kept, under the storage root
+#define SQL_BLOCK_INDEX_DIR            "sql-block-index"
+
 struct path_comp {
    bool operator()(char *path1, char *path2) 
    {
@@ -168,101 +168,146 @@ string ODBCHandler::get_tables()
     return tbl_list.str();
 }
 
-string ODBCHandler::execute_query(unsigned char* query, ssize_t threashold, 
-				  off_t *row_count, ssize_t *len, ssize_t *last_row_len)
+void ODBCHandler::set_index_dir(const char* dir)
 {
-    SQLHSTMT		stmt;
-    SQLRETURN		ret; 
-    SQLSMALLINT		nr_columns;
-    string		ODBC_error; 
-    stringstream	result_str;
-    bool		row_bound = false;
+    blk_index.set_index_dir(dir);
+}
+
+static void copy_block(struct gateway_ctx *ctx, string& block)
+{
+    if (block.empty())
+	return;
+    ctx->data_len = block.size();
+    ctx->data = (char*)malloc(ctx->data_len);
+    memcpy(ctx->data, block.data(), ctx->data_len);
+}
+
+//Run query, which must return rows from start_row on, and cut the
+//encoded rows into up to nr_blocks consecutive AG blocks. The first
+//block starts start_byte_offset bytes into the first row. Each block
+//is appended to blocks and its row range to entries; only the last
+//block of the result set can be shorter than ag_blk_size.
+void ODBCHandler::fetch_blocks(unsigned char* query, off_t start_row, off_t start_byte_offset,
+			       off_t nr_blocks, vector<string>& blocks, vector<block_index_entry>& entries)
+{
+    SQLHSTMT            stmt;
+    SQLRETURN           ret; 
+    SQLSMALLINT         nr_columns = 0;
+    SQLULEN             rowset_size = ODBC_ROWSET_SIZE;
+    SQLULEN             nr_fetched = 0;
+    SQLUSMALLINT        row_status[ODBC_ROWSET_SIZE];
+    string              ODBC_error; 
+    string              block;
+    block_index_entry   blkie;
+    off_t               row = start_row;
+    size_t              row_offset = start_byte_offset;
+    bool                done = false;
 
     cout<<"Query: "<<query<<endl;
     SQLAllocHandle(SQL_HANDLE_STMT, dbc, &stmt);
-    ret = SQLPrepare(stmt, query , SQL_NTS);
-    if (!SQL_SUCCEEDED(ret)) { 
-	ODBC_error = extract_error(stmt, SQL_HANDLE_STMT);
-	cout<<ODBC_error<<endl;
+    //Fetch ODBC_ROWSET_SIZE rows at a time into column-wise bound
+    //arrays. Drivers without block cursors may give us fewer.
+    SQLSetStmtAttr(stmt, SQL_ATTR_ROW_BIND_TYPE, (SQLPOINTER)SQL_BIND_BY_COLUMN, 0);
+    SQLSetStmtAttr(stmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)rowset_size, 0);
+    SQLGetStmtAttr(stmt, SQL_ATTR_ROW_ARRAY_SIZE, &rowset_size, 0, NULL);
+    if (rowset_size < 1 || rowset_size > ODBC_ROWSET_SIZE) {
+	rowset_size = 1;
+	SQLSetStmtAttr(stmt, SQL_ATTR_ROW_ARRAY_SIZE, (SQLPOINTER)rowset_size, 0);
     }
-    ret = SQLExecute(stmt);
+    SQLSetStmtAttr(stmt, SQL_ATTR_ROW_STATUS_PTR, row_status, 0);
+    SQLSetStmtAttr(stmt, SQL_ATTR_ROWS_FETCHED_PTR, &nr_fetched, 0);
+
+    ret = SQLPrepare(stmt, query , SQL_NTS);
+    if (SQL_SUCCEEDED(ret))
+	ret = SQLExecute(stmt);
     if (!SQL_SUCCEEDED(ret)) { 
 	ODBC_error = extract_error(stmt, SQL_HANDLE_STMT);
 	cout<<ODBC_error<<endl;
+	SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+	return;
     }
 
     SQLNumResultCols(stmt, &nr_columns);
-    *row_count = 0;
-    *len = 0;
-    while (SQL_SUCCEEDED(ret = SQLFetch(stmt))) {
-	SQLUSMALLINT i;
-	*len += *last_row_len;
-	(*last_row_len) = 0;
-	for (i = 1; i <= nr_columns; i++) {
-	    SQLLEN indicator;
-	    char buf[512];
-	    ret = SQLGetData(stmt, i, SQL_C_CHAR,
-		    buf, sizeof(buf), &indicator);
-	    if (i == nr_columns)
-		row_bound = true;
-	    if (SQL_SUCCEEDED(ret)) {
-		if (indicator == SQL_NULL_DATA) 
-		    strcpy(buf, "NULL");
-		*last_row_len += encode_results(result_str, buf, row_bound);
+    if (nr_columns <= 0) {
+	SQLFreeHandle(SQL_HANDLE_STMT, stmt);
+	return;
+    }
+    char* columns = (char*)malloc(nr_columns * rowset_size * ODBC_COLUMN_SIZE);
+    SQLLEN* indicators = (SQLLEN*)malloc(nr_columns * rowset_size * sizeof(SQLLEN));
+    for (SQLSMALLINT i = 0; i < nr_columns; i++) {
+	SQLBindCol(stmt, i + 1, SQL_C_CHAR, columns + (i * rowset_size * ODBC_COLUMN_SIZE),
+		ODBC_COLUMN_SIZE, indicators + (i * rowset_size));
+    }
+
+    blkie.start_row = start_row;
+    blkie.start_byte_offset = start_byte_offset;
+    while (!done && SQL_SUCCEEDED(ret = SQLFetch(stmt))) {
+	for (SQLULEN r = 0; r < nr_fetched && !done; r++) {
+	    if (row_status[r] == SQL_ROW_NOROW)
+		break;
+	    stringstream row_str;
+	    for (SQLSMALLINT i = 0; i < nr_columns; i++) {
+		char* column = columns + (((i * rowset_size) + r) * ODBC_COLUMN_SIZE);
+		if (indicators[(i * rowset_size) + r] == SQL_NULL_DATA) 
+		    strcpy(column, "NULL");
+		encode_results(row_str, column, (i == nr_columns - 1));
+	    }
+	    string row_data = row_str.str();
+	    //A block that fills up in the middle of a row ends
+	    //there, and the next one starts at the same byte.
+	    while (row_offset < row_data.size()) {
+		size_t chunk = row_data.size() - row_offset;
+		if (chunk > ag_blk_size - block.size())
+		    chunk = ag_blk_size - block.size();
+		block.append(row_data, row_offset, chunk);
+		row_offset += chunk;
+		if ((ssize_t)block.size() == ag_blk_size) {
+		    blkie.end_row = row;
+		    blkie.end_byte_offset = row_offset;
+		    blocks.push_back(block);
+		    entries.push_back(blkie);
+		    block.clear();
+		    blkie.start_row = row;
+		    blkie.start_byte_offset = row_offset;
+		    if ((off_t)blocks.size() == nr_blocks) {
+			done = true;
+			break;
+		    }
+		}
 	    }
+	    row++;
+	    row_offset = 0;
 	}
-	if (*len + *last_row_len >= threashold)
-	    break;
-	(*row_count)++;
-	row_bound = false;
     }
-    return result_str.str();
+    if (!done && !block.empty()) {
+	//Result set ended part way into a block.
+	blkie.end_row = row;
+	blkie.end_byte_offset = 0;
+	blocks.push_back(block);
+	entries.push_back(blkie);
+    }
+    free(columns);
+    free(indicators);
+    SQLFreeHandle(SQL_HANDLE_STMT, stmt);
 }
 
 void ODBCHandler::execute_query(struct gateway_ctx *ctx, struct map_info* mi, ssize_t read_size) 
 {
-    stringstream	result_str;
-    stringstream	shadow_result_str;
-    string		ret_str;
-    const block_index_entry	*blkie = NULL;
-    block_index_entry	*new_blkie = NULL;
-    ssize_t		query_len = 0;
-    unsigned char*	query = NULL;
-    off_t		last_blk_id = 0;
-    bool		query_unbound = false;
-    off_t		row_count = 0;
-    ssize_t		len = 0, last_row_len = 0;
-    string		results;
-    const char*		results_cstr;
-    off_t		block_start_byte_offset = 0;
-    ssize_t		db_read_size = 0;
-
-    //Get the block_index_entry for ctx->block_id of the file_name.
-    //If it is there, skip rows. Else get the last block_index_entry
-    //for the file. If its block id is ctx->block_id - 1 then process 
-    //from there and update block index for ctx->block_id block. 
-    //Else go through last block to ctx->block_id and update block index
-    //for each block.
-
-    blkie = blk_index.get_block(ctx->file_path, ctx->block_id);
-    if (blkie != NULL) {
-	if (ctx->sql_query_bounded == NULL)
-	    return;
-	//I'm feeling lucky...
-	query_len = strlen((const char*)ctx->sql_query_bounded) + 21;
-	query = (unsigned char*)malloc(query_len);
-	memset(query, 0, query_len);
-	snprintf((char*)query, query_len, (const char*)ctx->sql_query_bounded, 
-	     (blkie->end_row - blkie->start_row) + 1, blkie->start_row);
-    }
-    else {
-	blkie = blk_index.get_last_block(ctx->file_path, &last_blk_id);
-	if (ctx->sql_query_unbounded == NULL)
-	    return;
-	query_unbound = true;
-	query_len = strlen((const char*)ctx->sql_query_unbounded) + 11;
-	query = (unsigned char*)malloc(query_len);
-    }
+    string              file_name(ctx->file_path);
+    string              data;
+    vector<string>      blocks;
+    vector<block_index_entry>   entries;
+    block_index_entry   blkie, last_blkie, to_blkie;
+    ssize_t             query_len = 0;
+    unsigned char*      query = NULL;
+    off_t               last_blk_id = 0;
+    off_t               nr_indexed = 0;
+    off_t               from_blk_id = 0, to_blk_id = 0;
+    bool                sequential = false;
+
+    //The block index can only be built with the unbounded query.
+    if (ctx->sql_query_unbounded == NULL)
+	return;
 
     //Invalidation info...
     struct invalidation_info *inval = new struct invalidation_info;
@@ -270,55 +315,73 @@ void ODBCHandler::execute_query(struct gateway_ctx *ctx, struct map_info* mi, ss
     inval->blk_index = &blk_index;
     mi->entry = inval;
     mi->invalidate_entry = invalidate_entry;
-    
-    if (query_unbound) {
-	off_t blk_count = (blkie != NULL)?last_blk_id+1:0;
-	off_t start_row = (blkie != NULL)?blkie->end_row:0;
-	off_t start_byte_offset = (blkie != NULL)?blkie->end_byte_offset:0;
-	for (; blk_count < ctx->block_id+1; blk_count++) {
-	    row_count = 0;
-	    len = 0;
-	    last_row_len = 0;
-	    memset(query, 0, query_len);
-	    snprintf((char*)query, query_len, (const char*)ctx->sql_query_unbounded, start_row);
-	    db_read_size = ag_blk_size + start_byte_offset;
-	    results = execute_query(query, db_read_size, &row_count, &len, &last_row_len);
-
-	    //If there is no data do not proceed...
-	    if (!(len + last_row_len)) {
-		break;
-	    }
 
-	    //Update the block index
-	    new_blkie = blk_index.alloc_block_index_entry();
-	    new_blkie->start_row = start_row;
-	    new_blkie->start_byte_offset = start_byte_offset;
-	    block_start_byte_offset = start_byte_offset;
-	    new_blkie->end_row = start_row + row_count;
-	    new_blkie->end_byte_offset = db_read_size - len;
-	    len += last_row_len;
-	    len = (ag_blk_size > len - start_byte_offset)?
-		    len - start_byte_offset:ag_blk_size;
-	    blk_index.update_block_index(ctx->file_path, blk_count, new_blkie);
-
-	    //Update start_row and start_byte_offset for the next block
-	    start_row += row_count;
-	    start_byte_offset = new_blkie->end_byte_offset;
-	}
+    string mapping((const char*)ctx->sql_query_unbounded);
+    if (ctx->sql_query_bounded != NULL)
+	mapping += string("\n") + (const char*)ctx->sql_query_bounded;
+    blk_index.open_block_index(file_name, mapping);
+
+    //A block read ahead by an earlier cursor pass needs no query.
+    if (blk_index.get_cached_block(file_name, ctx->block_id, &data, &sequential)) {
+	copy_block(ctx, data);
+	return;
+    }
+
+    //Start the cursor at ctx->block_id if we know where it starts.
+    //Else start it at the end of the last block we know of, and index
+    //each block from there to ctx->block_id on the way.
+    if (blk_index.get_last_block(file_name, &last_blk_id, &last_blkie))
+	nr_indexed = last_blk_id + 1;
+    if (ctx->block_id < nr_indexed && blk_index.get_block(file_name, ctx->block_id, &blkie)) {
+	from_blk_id = ctx->block_id;
+    }
+    else if (nr_indexed > 0) {
+	from_blk_id = nr_indexed;
+	blkie.start_row = last_blkie.end_row;
+	blkie.start_byte_offset = last_blkie.end_byte_offset;
+    }
+    else {
+	from_blk_id = 0;
+	blkie.start_row = 0;
+	blkie.start_byte_offset = 0;
+    }
+    if (from_blk_id > ctx->block_id)
+	return;
+
+    //Sequential readers get the next few blocks from the same pass.
+    to_blk_id = ctx->block_id + (sequential ? SQL_READAHEAD_BLOCKS : 0);
+
+    if (ctx->sql_query_bounded != NULL && blk_index.get_block(file_name, to_blk_id, &to_blkie)) {
+	//I'm feeling lucky...
+	query_len = strlen((const char*)ctx->sql_query_bounded) + 21;
+	query = (unsigned char*)malloc(query_len);
+	memset(query, 0, query_len);
+	snprintf((char*)query, query_len, (const char*)ctx->sql_query_bounded, 
+	     (int)((to_blkie.end_row - blkie.start_row) + 1), (int)blkie.start_row);
     }
     else {
-	db_read_size = ag_blk_size + blkie->start_byte_offset;
-	results = execute_query(query, db_read_size, &row_count, &len, &last_row_len);
-	len += last_row_len;
-	len = (ag_blk_size > len - blkie->start_byte_offset)?
-		len - blkie->start_byte_offset:ag_blk_size;
-	block_start_byte_offset = blkie->start_byte_offset;
+	query_len = strlen((const char*)ctx->sql_query_unbounded) + 11;
+	query = (unsigned char*)malloc(query_len);
+	memset(query, 0, query_len);
+	snprintf((char*)query, query_len, (const char*)ctx->sql_query_unbounded, (int)blkie.start_row);
     }
-    if (len) {
-	results_cstr = results.c_str();
-	ctx->data_len = len;
-	ctx->data = (char*)malloc(ctx->data_len);
-	memcpy(ctx->data, results_cstr+block_start_byte_offset, ctx->data_len);
+    fetch_blocks(query, blkie.start_row, blkie.start_byte_offset,
+		 (to_blk_id - from_blk_id) + 1, blocks, entries);
+    free(query);
+
+    for (size_t i = 0; i < blocks.size(); i++) {
+	off_t blk_id = from_blk_id + i;
+	//The last block of the result set may still grow, so only
+	//full blocks go in the index.
+	if (blk_id >= nr_indexed && (ssize_t)blocks[i].size() == ag_blk_size) {
+	    block_index_entry *new_blkie = blk_index.alloc_block_index_entry();
+	    *new_blkie = entries[i];
+	    blk_index.update_block_index(file_name, blk_id, new_blkie);
+	}
+	if (blk_id == ctx->block_id)
+	    copy_block(ctx, blocks[i]);
+	else if (blk_id > ctx->block_id)
+	    blk_index.cache_block(file_name, blk_id, blocks[i]);
     }
 }
 
@@ -32,6 +32,10 @@
 #include "gateway-ctx.h"
 #include "map-parser.h"
 
+#define ODBC_ROWSET_SIZE	64	//Rows fetched by each SQLFetch
+#define ODBC_COLUMN_SIZE	512	//Longer column values are truncated
+#define SQL_READAHEAD_BLOCKS	8	//Blocks read past a sequential reader's
+
 using namespace std;
 
 struct invalidation_info {
@@ -58,7 +62,9 @@ class ODBCHandler
 	static  ODBCHandler&  get_handle(unsigned char* con_str);
 	void    execute_query(struct gateway_ctx *ctx, struct map_info *mi, ssize_t read_size); 
 	string  get_tables();
-	string  execute_query(unsigned char* query, ssize_t threashold, off_t *row_count, ssize_t *len, ssize_t *last_row_len); 
+	void    fetch_blocks(unsigned char* query, off_t start_row, off_t start_byte_offset,
+			     off_t nr_blocks, vector<string>& blocks, vector<block_index_entry>& entries); 
+	void    set_index_dir(const char* dir);
 	string  get_db_info();
 	string  extract_error(SQLHANDLE handle, SQLSMALLINT type);
 	ssize_t	encode_results(stringstream& str_stream, char* column, 
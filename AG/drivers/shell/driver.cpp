@@ -84,6 +84,37 @@ int driver_shutdown( void* driver_state ) {
 }
 
 
+// how long should a block request wait for the block to be generated?
+// read from the config the first time, since the config isn't loaded until after driver_init
+static int shell_driver_block_wait_timeout( struct shell_driver_state* state ) {
+   
+   if( state->block_wait_timeout > 0 ) {
+      return state->block_wait_timeout;
+   }
+   
+   int timeout = AG_SHELL_DRIVER_BLOCK_WAIT_TIMEOUT_DEFAULT;
+   
+   char* timeout_str = AG_driver_get_config_var( AG_SHELL_DRIVER_CONFIG_BLOCK_WAIT_TIMEOUT );
+   if( timeout_str != NULL ) {
+      
+      char* tmp = NULL;
+      long val = strtol( timeout_str, &tmp, 10 );
+      
+      if( tmp == timeout_str || val <= 0 ) {
+         SG_error("Configuration error: Invalid value '%s' for '%s'; using %d\n", timeout_str, AG_SHELL_DRIVER_CONFIG_BLOCK_WAIT_TIMEOUT, timeout );
+      }
+      else {
+         timeout = val;
+      }
+      
+      free( timeout_str );
+   }
+   
+   state->block_wait_timeout = timeout;
+   return timeout;
+}
+
+
 // read a block 
 ssize_t get_dataset_block( struct AG_connection_context* ag_ctx, uint64_t block_id, char* block_buf, size_t size, void* driver_conn_state ) {
    
@@ -101,13 +132,22 @@ ssize_t get_dataset_block( struct AG_connection_context* ag_ctx, uint64_t block_
       return rc;
    }
    
-   // try to get the block
-   rc = proc_read_block_data( state, request_path, block_id, block_buf, size );
-   if( rc < 0 ) {
-      SG_error("proc_read_block_data(%s) rc = %zd\n", request_path, rc );
+   // get the block, once the process has generated it
+   rc = proc_read_block_data( state, request_path, block_id, block_buf, size, shell_driver_block_wait_timeout( state ) );
+   if( rc == -EAGAIN ) {
+      
+      // still not generated.  Have the client try again.
+      SG_debug("%s: block %" PRIu64 " not generated yet\n", request_path, block_id );
+      AG_driver_set_HTTP_status( ag_ctx, SG_HTTP_TRYAGAIN );
    }
-   else {
-      rc = size;
+   else if( rc == 0 ) {
+      
+      // past the end of the output
+      AG_driver_set_HTTP_status( ag_ctx, 404 );
+      rc = -ENOENT;
+   }
+   else if( rc < 0 ) {
+      SG_error("proc_read_block_data(%s) rc = %zd\n", request_path, rc );
    }
    
    return rc;
@@ -162,7 +202,9 @@ int stat_dataset( char const* path, struct AG_map_info* mi, struct AG_driver_pub
    
    // we can give back publish information for at least partial results
    struct stat sb;
-   rc = proc_stat_data( state, path, &sb );
+   bool done = false;
+   
+   rc = proc_stat_data( state, path, &sb, &done );
    if( rc != 0 ) {
       
       if( rc == -ENOENT ) {
@@ -185,9 +227,17 @@ int stat_dataset( char const* path, struct AG_map_info* mi, struct AG_driver_pub
          return rc;
       }
    }
+   else if( !done ) {
+      
+      // still generating it.  Don't publish the length so far, since readers would stop there;
+      // blocks can be read as they're generated, and we'll republish the real size once the process exits.
+      pubinfo->size = -1;
+      pubinfo->mtime_sec = sb.st_mtime;
+      pubinfo->mtime_nsec = 0;
+   }
    else {
       
-      // fill in what we know, even if it's partial
+      // fill in the final size
       pubinfo->size = sb.st_size;
       pubinfo->mtime_sec = sb.st_mtime;
       pubinfo->mtime_nsec = 0;
@@ -35,6 +35,11 @@
 
 using namespace std;
 
+#define AG_SHELL_DRIVER_CONFIG_BLOCK_WAIT_TIMEOUT "block_wait_timeout"
+
+// how long a block request waits for the process to generate the block, before telling the client to try again
+#define AG_SHELL_DRIVER_BLOCK_WAIT_TIMEOUT_DEFAULT 10
+
 // driver-wide state 
 struct shell_driver_state {
    
@@ -44,8 +49,18 @@ struct shell_driver_state {
    cache_table_t* cache_table;                  // cached data for requests
    pthread_rwlock_t cache_lock;                 // lock governing access to cache
    
+   proc_output_table_t* outputs;                // output generated so far for requests
+   proc_output_watch_table_t* output_watches;   // which output each inotify watch is on
+   pthread_mutex_t output_lock;                 // lock governing access to outputs and output_watches
+   
    char* storage_root;                          // root directory for storing stdout/stderr data and cached data
    
+   int inotify_fd;                              // watches the outputs of running processes grow
+   int inotify_stop_pipe[2];                    // written to stop the inotify thread
+   pthread_t inotify_thread;
+   
+   int block_wait_timeout;                      // seconds to wait for a block to be generated (0 if not yet configured)
+   
    bool is_running;                             // set to true if we're running the inotify thread
 };
 
@@ -76,6 +76,359 @@ static int cache_table_unlock( struct shell_driver_state* state ) {
    SG_debug("unlock cache table %p\n", state->cache_table );
    return pthread_rwlock_unlock( &state->cache_lock );
 }
+
+
+// wake up the readers waiting on an output that is now long enough for them, or finished.
+// state->output_lock must be held
+static void proc_output_wake( struct proc_output* out ) {
+   
+   proc_output_waiter_list_t::iterator itr = out->waiters->begin();
+   
+   while( itr != out->waiters->end() ) {
+      
+      struct proc_output_waiter* waiter = *itr;
+      
+      if( out->done || waiter->want <= out->size ) {
+         
+         waiter->registered = false;
+         pthread_cond_signal( &waiter->cv );
+         
+         itr = out->waiters->erase( itr );
+      }
+      else {
+         itr++;
+      }
+   }
+}
+
+// re-read the length of an output from disk
+// state->output_lock must be held
+static int proc_output_refresh( struct proc_output* out ) {
+   
+   struct stat sb;
+   
+   int rc = stat( out->stdout_path, &sb );
+   if( rc != 0 ) {
+      
+      rc = -errno;
+      SG_error("stat(%s) errno = %d\n", out->stdout_path, rc );
+      return rc;
+   }
+   
+   out->size = sb.st_size;
+   return 0;
+}
+
+// stop watching an output
+// state->output_lock must be held
+static void proc_output_unwatch( struct shell_driver_state* state, struct proc_output* out ) {
+   
+   if( out->wd >= 0 ) {
+      
+      inotify_rm_watch( state->inotify_fd, out->wd );
+      state->output_watches->erase( out->wd );
+      
+      out->wd = -1;
+   }
+}
+
+// free an output, and wake up everyone waiting on it (they'll find it gone)
+// state->output_lock must be held, and the output must no longer be in state->outputs
+static void proc_output_free( struct shell_driver_state* state, struct proc_output* out ) {
+   
+   proc_output_unwatch( state, out );
+   
+   out->done = true;
+   proc_output_wake( out );
+   
+   delete out->waiters;
+   free( out->stdout_path );
+   free( out );
+}
+
+// start tracking the output of a process we're about to run for a request.
+// call this before the process can write anything, so we see all of it.
+// return 0 on success
+// return -ENOMEM if OOM
+static int proc_output_add( struct shell_driver_state* state, char const* request_path, char const* stdout_path ) {
+   
+   struct proc_output* out = SG_CALLOC( struct proc_output, 1 );
+   if( out == NULL ) {
+      return -ENOMEM;
+   }
+   
+   out->stdout_path = strdup( stdout_path );
+   out->waiters = new (nothrow) proc_output_waiter_list_t();
+   
+   if( out->stdout_path == NULL || out->waiters == NULL ) {
+      
+      if( out->stdout_path != NULL ) {
+         free( out->stdout_path );
+      }
+      
+      if( out->waiters != NULL ) {
+         delete out->waiters;
+      }
+      
+      free( out );
+      return -ENOMEM;
+   }
+   
+   out->wd = -1;
+   
+   pthread_mutex_lock( &state->output_lock );
+   
+   // have the inotify thread tell readers when the process writes more
+   if( state->is_running ) {
+      
+      out->wd = inotify_add_watch( state->inotify_fd, stdout_path, IN_MODIFY | IN_CLOSE_WRITE );
+      if( out->wd < 0 ) {
+         
+         int rc = -errno;
+         SG_error("WARN: inotify_add_watch(%s) errno = %d; readers of %s will wait for it to finish\n", stdout_path, rc, request_path );
+         
+         out->wd = -1;
+      }
+      else {
+         
+         (*state->output_watches)[ out->wd ] = string(request_path);
+      }
+   }
+   
+   // replace the output of an earlier run, if there is one
+   proc_output_table_t::iterator itr = state->outputs->find( string(request_path) );
+   if( itr != state->outputs->end() ) {
+      
+      struct proc_output* old_out = itr->second;
+      
+      itr->second = out;
+      proc_output_free( state, old_out );
+   }
+   else {
+      
+      (*state->outputs)[ string(request_path) ] = out;
+   }
+   
+   pthread_mutex_unlock( &state->output_lock );
+   
+   return 0;
+}
+
+// the process generating a request's output has exited, so the output is as long as it will get.
+// wake up everyone waiting on it.
+static void proc_output_finish( struct shell_driver_state* state, char const* request_path ) {
+   
+   pthread_mutex_lock( &state->output_lock );
+   
+   proc_output_table_t::iterator itr = state->outputs->find( string(request_path) );
+   if( itr != state->outputs->end() ) {
+      
+      struct proc_output* out = itr->second;
+      
+      proc_output_unwatch( state, out );
+      proc_output_refresh( out );
+      
+      out->done = true;
+      proc_output_wake( out );
+   }
+   
+   pthread_mutex_unlock( &state->output_lock );
+}
+
+// stop tracking the output for a request
+static void proc_output_remove( struct shell_driver_state* state, char const* request_path ) {
+   
+   pthread_mutex_lock( &state->output_lock );
+   
+   proc_output_table_t::iterator itr = state->outputs->find( string(request_path) );
+   if( itr != state->outputs->end() ) {
+      
+      struct proc_output* out = itr->second;
+      
+      state->outputs->erase( itr );
+      proc_output_free( state, out );
+   }
+   
+   pthread_mutex_unlock( &state->output_lock );
+}
+
+// wait until the output for a request is at least want bytes long, or until the process generating it exits.
+// on success, return 0 and set *ret_size to the output's length so far, *ret_done to whether or not that length is final,
+// and *ret_stdout_path to a copy of the output's path (the caller must free it).
+// return -ENOENT if there is no output for this request
+// return -EAGAIN if the output didn't get long enough within timeout seconds
+// return -ENOMEM if OOM
+static int proc_output_wait( struct shell_driver_state* state, char const* request_path, off_t want, int timeout, off_t* ret_size, bool* ret_done, char** ret_stdout_path ) {
+   
+   int rc = 0;
+   bool timed_out = false;
+   
+   struct proc_output_waiter waiter;
+   struct timespec deadline;
+   
+   memset( &waiter, 0, sizeof(struct proc_output_waiter) );
+   
+   waiter.want = want;
+   pthread_cond_init( &waiter.cv, NULL );
+   
+   clock_gettime( CLOCK_REALTIME, &deadline );
+   deadline.tv_sec += timeout;
+   
+   pthread_mutex_lock( &state->output_lock );
+   
+   while( true ) {
+      
+      proc_output_table_t::iterator itr = state->outputs->find( string(request_path) );
+      if( itr == state->outputs->end() ) {
+         
+         // evicted, or never started
+         rc = -ENOENT;
+         break;
+      }
+      
+      struct proc_output* out = itr->second;
+      
+      if( out->done || out->size >= want ) {
+         
+         *ret_stdout_path = strdup( out->stdout_path );
+         if( *ret_stdout_path == NULL ) {
+            
+            rc = -ENOMEM;
+            break;
+         }
+         
+         *ret_size = out->size;
+         *ret_done = out->done;
+         
+         rc = 0;
+         break;
+      }
+      
+      if( timed_out ) {
+         
+         rc = -EAGAIN;
+         break;
+      }
+      
+      if( !waiter.registered ) {
+         
+         out->waiters->push_back( &waiter );
+         waiter.registered = true;
+      }
+      
+      rc = pthread_cond_timedwait( &waiter.cv, &state->output_lock, &deadline );
+      if( rc == ETIMEDOUT ) {
+         
+         // check once more before giving up
+         timed_out = true;
+      }
+   }
+   
+   if( waiter.registered ) {
+      
+      // still in the list of the output we waited on, which is still the request's output
+      proc_output_table_t::iterator itr = state->outputs->find( string(request_path) );
+      if( itr != state->outputs->end() ) {
+         
+         proc_output_waiter_list_t* waiters = itr->second->waiters;
+         waiters->erase( remove( waiters->begin(), waiters->end(), &waiter ), waiters->end() );
+      }
+   }
+   
+   pthread_mutex_unlock( &state->output_lock );
+   
+   pthread_cond_destroy( &waiter.cv );
+   
+   return rc;
+}
+
+
+// inotify thread: keep track of how much output each running process has generated, and wake up the readers waiting on it
+static void* proc_inotify_main( void* arg ) {
+   
+   struct shell_driver_state* state = (struct shell_driver_state*)arg;
+   
+   // room for many events at once (ours have no names), aligned for struct inotify_event
+   char buf[ 64 * (sizeof(struct inotify_event) + NAME_MAX + 1) ] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+   
+   struct pollfd fds[2];
+   
+   fds[0].fd = state->inotify_fd;
+   fds[0].events = POLLIN;
+   fds[1].fd = state->inotify_stop_pipe[0];
+   fds[1].events = POLLIN;
+   
+   while( true ) {
+      
+      int rc = poll( fds, 2, -1 );
+      if( rc < 0 ) {
+         
+         rc = -errno;
+         if( rc == -EINTR ) {
+            continue;
+         }
+         
+         SG_error("poll errno = %d\n", rc );
+         break;
+      }
+      
+      if( fds[1].revents != 0 ) {
+         
+         // told to stop
+         break;
+      }
+      
+      ssize_t len = read( state->inotify_fd, buf, sizeof(buf) );
+      if( len <= 0 ) {
+         continue;
+      }
+      
+      // a busy process generates many events per read; only look at each output once
+      set<int> refreshed;
+      
+      pthread_mutex_lock( &state->output_lock );
+      
+      for( char* ptr = buf; ptr < buf + len; ) {
+         
+         struct inotify_event* event = (struct inotify_event*)ptr;
+         ptr += sizeof(struct inotify_event) + event->len;
+         
+         proc_output_watch_table_t::iterator watch_itr = state->output_watches->find( event->wd );
+         if( watch_itr == state->output_watches->end() ) {
+            
+            // already unwatched
+            continue;
+         }
+         
+         proc_output_table_t::iterator itr = state->outputs->find( watch_itr->second );
+         
+         if( event->mask & IN_IGNORED ) {
+            
+            // the kernel dropped the watch (i.e. the output was unlinked)
+            if( itr != state->outputs->end() && itr->second->wd == event->wd ) {
+               itr->second->wd = -1;
+            }
+            
+            state->output_watches->erase( watch_itr );
+            continue;
+         }
+         
+         if( itr == state->outputs->end() || refreshed.count( event->wd ) > 0 ) {
+            continue;
+         }
+         
+         refreshed.insert( event->wd );
+         
+         if( proc_output_refresh( itr->second ) == 0 ) {
+            proc_output_wake( itr->second );
+         }
+      }
+      
+      pthread_mutex_unlock( &state->output_lock );
+   }
+   
+   return NULL;
+}
    
    
 // set up a proc table entry 
@@ -252,6 +605,11 @@ void proc_sigchld_handler(int signum) {
          }
       }
       
+      if( pid == 0 ) {
+         // the rest are still running 
+         return;
+      }
+      
       if( WIFEXITED( status ) || WIFSIGNALED( status ) ) {
          
          // a child died
@@ -276,12 +634,15 @@ void proc_sigchld_handler(int signum) {
          
          if( request_path != NULL ) {
             
+            // the output won't grow any more; serve readers the rest of it
+            proc_output_finish( state, request_path );
+            
             // ask the AG to post new information for our stdout--i.e. the size and mtime
             struct stat sb;
             
             SG_debug("Process %d finished generating %s; try to re-publish\n", pid, request_path);
             
-            int rc = proc_stat_data( state, request_path, &sb );
+            int rc = proc_stat_data( state, request_path, &sb, NULL );
             if( rc != 0 ) {
                SG_error("proc_stat_data(%s) rc = %d\n", request_path, rc );
             }
@@ -299,6 +660,8 @@ void proc_sigchld_handler(int signum) {
                   SG_error("WARN: AG_driver_request_reversion(%s) rc = %d\n", request_path, rc );
                }
             }
+            
+            free( request_path );
          }
       }
    }
@@ -312,17 +675,66 @@ int shell_driver_state_init( struct shell_driver_state* state ) {
    // allocate 
    state->running = new proc_table_t();
    state->cache_table = new cache_table_t();
+   state->outputs = new proc_output_table_t();
+   state->output_watches = new proc_output_watch_table_t();
    
    pthread_rwlock_init( &state->running_lock, NULL );
    pthread_rwlock_init( &state->cache_lock, NULL );
+   pthread_mutex_init( &state->output_lock, NULL );
+   
+   state->inotify_fd = -1;
+   state->inotify_stop_pipe[0] = -1;
+   state->inotify_stop_pipe[1] = -1;
    
    return 0;
 }
 
 
-// start the driver
+// start the driver:  start watching process outputs.
+// if we can't, readers of a running process's output wait for it to exit instead, so this is not fatal.
 int shell_driver_state_start( struct shell_driver_state* state ) {
    
+   int rc = 0;
+   
+   state->inotify_fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+   if( state->inotify_fd < 0 ) {
+      
+      rc = -errno;
+      SG_error("WARN: inotify_init1 errno = %d\n", rc );
+      
+      state->inotify_fd = -1;
+      return 0;
+   }
+   
+   rc = pipe( state->inotify_stop_pipe );
+   if( rc != 0 ) {
+      
+      rc = -errno;
+      SG_error("WARN: pipe errno = %d\n", rc );
+      
+      close( state->inotify_fd );
+      state->inotify_fd = -1;
+      return 0;
+   }
+   
+   state->is_running = true;
+   
+   state->inotify_thread = md_start_thread( proc_inotify_main, state, false );
+   if( state->inotify_thread == (pthread_t)(-1) ) {
+      
+      SG_error("%s", "WARN: failed to start inotify thread\n");
+      
+      state->is_running = false;
+      
+      close( state->inotify_fd );
+      close( state->inotify_stop_pipe[0] );
+      close( state->inotify_stop_pipe[1] );
+      
+      state->inotify_fd = -1;
+      state->inotify_stop_pipe[0] = -1;
+      state->inotify_stop_pipe[1] = -1;
+   }
+   
    return 0;
 }
 
@@ -331,6 +743,31 @@ int shell_driver_state_stop( struct shell_driver_state* state ) {
    
    SG_debug("Stopping all running processes for %p\n", state );
    
+   // stop watching outputs
+   pthread_mutex_lock( &state->output_lock );
+   
+   bool was_running = state->is_running;
+   state->is_running = false;
+   
+   pthread_mutex_unlock( &state->output_lock );
+   
+   if( was_running ) {
+      
+      char c = 0;
+      ssize_t len = write( state->inotify_stop_pipe[1], &c, 1 );
+      if( len < 0 ) {
+         SG_error("WARN: write(inotify stop pipe) errno = %d\n", -errno );
+      }
+      
+      pthread_join( state->inotify_thread, NULL );
+      
+      close( state->inotify_stop_pipe[0] );
+      close( state->inotify_stop_pipe[1] );
+      
+      state->inotify_stop_pipe[0] = -1;
+      state->inotify_stop_pipe[1] = -1;
+   }
+   
    proc_table_wlock( state );
    
    for( proc_table_t::iterator itr = state->running->begin(); itr != state->running->end(); itr++ ) {
@@ -369,6 +806,23 @@ int shell_driver_state_stop( struct shell_driver_state* state ) {
    
    cache_table_unlock( state );
    
+   // forget outputs, and wake up their readers
+   pthread_mutex_lock( &state->output_lock );
+   
+   for( proc_output_table_t::iterator itr = state->outputs->begin(); itr != state->outputs->end(); itr++ ) {
+      proc_output_free( state, itr->second );
+   }
+   
+   state->outputs->clear();
+   
+   if( state->inotify_fd >= 0 ) {
+      
+      close( state->inotify_fd );
+      state->inotify_fd = -1;
+   }
+   
+   pthread_mutex_unlock( &state->output_lock );
+   
    return 0;
 }
 
@@ -402,10 +856,23 @@ int shell_driver_state_free( struct shell_driver_state* state ) {
       state->cache_table = NULL;
    }
    
+   if( state->outputs != NULL ) {
+      
+      delete state->outputs;
+      state->outputs = NULL;
+   }
+   
+   if( state->output_watches != NULL ) {
+      
+      delete state->output_watches;
+      state->output_watches = NULL;
+   }
+   
    proc_table_unlock( state );
    
    pthread_rwlock_destroy( &state->running_lock );
    pthread_rwlock_destroy( &state->cache_lock );
+   pthread_mutex_destroy( &state->output_lock );
    
    return 0;
 }
@@ -422,7 +889,7 @@ static char* proc_stdout_path( char const* storage_root ) {
 static int dup2_or_exit( int old_fd, int new_fd ) {
    
    int rc = dup2( old_fd, new_fd );
-   if( rc != 0 ) {
+   if( rc < 0 ) {
       
       rc = -errno;
       SG_error("dup2 errno = %d\n", rc );
@@ -457,6 +924,9 @@ int proc_evict_cache( struct shell_driver_state* state, char const* request_path
    
    cache_table_unlock( state );
    
+   // readers waiting on the old output will find it gone
+   proc_output_remove( state, request_path );
+   
    return rc;
 }
 
@@ -550,14 +1020,13 @@ static int proc_start( struct shell_driver_state* state, char const* request_pat
       close( child_pipe[1] );
       
       // re-route stdout to stdout_fd 
-      close( STDOUT_FILENO );
-      dup2_or_exit( STDOUT_FILENO, stdout_fd );
+      dup2_or_exit( stdout_fd, STDOUT_FILENO );
       
       // close everything else, except the new stdout and the current stderr
       long max_fd = sysconf( _SC_OPEN_MAX );
       for( int fd = 0; fd < max_fd; fd++ ) {
          
-         if( fd == stdout_fd || fd == STDERR_FILENO ) {
+         if( fd == STDOUT_FILENO || fd == STDERR_FILENO ) {
             continue;
          }
          
@@ -585,14 +1054,26 @@ static int proc_start( struct shell_driver_state* state, char const* request_pat
       
       proc_table_wlock( state );
       
-      // tell the child to go!
-      int go = 0;
-      ssize_t len = write( child_pipe[1], &go, sizeof(int) );
-      if( len < 0 ) {
+      // watch its output before it can write any
+      rc = proc_output_add( state, request_path, stdout_path );
+      if( rc != 0 ) {
          
-         // somehow, we failed to wake the child up 
-         rc = -errno;
-         SG_error("ERR: write(%d) for child %d errno = %d\n", child_pipe[1], child_pid, rc );
+         SG_error("ERR: proc_output_add(%s) rc = %d\n", request_path, rc );
+      }
+      else {
+         
+         // tell the child to go!
+         int go = 0;
+         ssize_t len = write( child_pipe[1], &go, sizeof(int) );
+         if( len < 0 ) {
+            
+            // somehow, we failed to wake the child up 
+            rc = -errno;
+            SG_error("ERR: write(%d) for child %d errno = %d\n", child_pipe[1], child_pid, rc );
+         }
+      }
+      
+      if( rc != 0 ) {
          
          // clean up 
          proc_kill( pte );
@@ -696,7 +1177,7 @@ bool proc_finished_generating_data( struct shell_driver_state* state, char const
    cache_table_rlock( state );
    
    cache_table_t::iterator cache_itr = state->cache_table->find( string(request_path) );
-   if( cache_itr != state->cache_table->end() ) {
+   if( cache_itr == state->cache_table->end() ) {
       
       // no cached data? hasn't even started.
       cache_table_unlock( state );
@@ -709,14 +1190,13 @@ bool proc_finished_generating_data( struct shell_driver_state* state, char const
 }
 
 
-// stat the output of a running process
-int proc_stat_data( struct shell_driver_state* state, char const* request_path, struct stat* sb ) {
-   
+// stat the output of a process, and if done is not NULL, set it to whether or not the process has finished generating it
+int proc_stat_data( struct shell_driver_state* state, char const* request_path, struct stat* sb, bool* done ) {
    
    cache_table_rlock( state );
    
    cache_table_t::iterator cache_itr = state->cache_table->find( string(request_path) );
-   if( cache_itr != state->cache_table->end() ) {
+   if( cache_itr == state->cache_table->end() ) {
       
       // no cached data? hasn't even started.
       cache_table_unlock( state );
@@ -735,99 +1215,98 @@ int proc_stat_data( struct shell_driver_state* state, char const* request_path,
       rc = -errno;
       SG_error("stat(%s) errno = %d\n", stdout_path, rc );
    }
+   else if( done != NULL ) {
+      
+      pthread_mutex_lock( &state->output_lock );
+      
+      proc_output_table_t::iterator itr = state->outputs->find( string(request_path) );
+      *done = (itr == state->outputs->end() || itr->second->done);
+      
+      pthread_mutex_unlock( &state->output_lock );
+   }
    
    free( stdout_path );
    return rc;
 }
 
-// read data into the buffer
-// return 0 on success
-// if the process is still running, and the requested data hasn't been generated yet, then return -EAGAIN.
-// if the process is not running, and the requested data is out of range, then return 1
-// if there is no data for this request, then return -ENOENT (to avoid this, call proc_ensure_has_data first).
-int proc_read_block_data( struct shell_driver_state* state, char const* request_path, uint64_t block_id, char* buf, ssize_t read_size ) {
+// read a block of a process's output into buf, waiting up to timeout seconds for the process to generate it.
+// the block can be read as soon as the output has grown past it; we don't wait for the process to exit.
+// return the number of bytes read on success (fewer than read_size for the last block)
+// return 0 if the block is past the end of a finished process's output (i.e. EOF)
+// return -EAGAIN if the process still hasn't generated the block after timeout seconds
+// return -ENOENT if there is no data for this request (to avoid this, call proc_ensure_has_data first).
+ssize_t proc_read_block_data( struct shell_driver_state* state, char const* request_path, uint64_t block_id, char* buf, ssize_t read_size, int timeout ) {
    
    int rc = 0;
-   struct stat sb;
+   off_t size = 0;
+   bool done = false;
+   char* stdout_path = NULL;
    
-   // look up the location on disk where this should be
-   cache_table_rlock( state );
+   uint64_t block_size = AG_driver_get_block_size();
+   off_t offset = block_id * block_size;
    
-   cache_table_t::iterator cache_itr = state->cache_table->find( string(request_path) );
-   if( cache_itr == state->cache_table->end() ) {
+   // wait for the whole block, or for the process to exit
+   rc = proc_output_wait( state, request_path, offset + read_size, timeout, &size, &done, &stdout_path );
+   if( rc != 0 ) {
       
-      // no data 
-      cache_table_unlock( state );
+      if( rc != -EAGAIN ) {
+         SG_error("proc_output_wait(%s) rc = %d\n", request_path, rc );
+      }
       
-      return -ENOENT;
+      return rc;
    }
    
-   char* stdout_path = strdup( cache_itr->second.c_str() );
+   if( offset >= size ) {
+      
+      // EOF 
+      free( stdout_path );
+      return 0;
+   }
    
-   cache_table_unlock( state );
+   // read what there is of it
+   ssize_t len = (offset + read_size <= size ? read_size : size - offset);
    
-   // look up size
-   rc = stat( stdout_path, &sb );
-   if( rc != 0 ) {
+   int fd = open( stdout_path, O_RDONLY );
+   if( fd < 0 ) {
       
       rc = -errno;
-      SG_error("stat(%s) for %s errno = %d\n", stdout_path, request_path, rc );
+      SG_error("open(%s) errno = %d\n", stdout_path, rc );
       
       free( stdout_path );
       return rc;
    }
    
-   // do we have enough data?
-   uint64_t block_size = AG_driver_get_block_size();
-   uint64_t offset = block_id * block_size;
-   
-   if( offset > (unsigned)sb.st_size || offset + (unsigned)read_size > (unsigned)sb.st_size ) {
+   ssize_t num_read = 0;
+   while( num_read < len ) {
       
-      free( stdout_path );
-      
-      // is the process still working on generating data for us?
-      if( proc_is_generating_data( state, request_path ) ) {
-         return -EAGAIN;
-      }
-      else {
-         // EOF 
-         return 1;
-      }
-   }
-   else {
-      
-      // read data 
-      int fd = open( stdout_path, O_RDONLY );
-      if( fd < 0 ) {
+      ssize_t nr = pread( fd, buf + num_read, len - num_read, offset + num_read );
+      if( nr < 0 ) {
          
          rc = -errno;
-         SG_error("open(%s) errno = %d\n", stdout_path, rc );
-         
-         free( stdout_path );
-         return rc;
-      }
-      
-      ssize_t num_read = 0;
-      while( num_read < read_size ) {
-         
-         ssize_t nr = read( fd, buf + num_read, read_size - num_read );
-         if( nr < 0 ) {
+         if( rc == -EINTR ) {
             
-            rc = -errno;
-            SG_error("read(%s) errno = %d\n", stdout_path, rc );
-            break;
-         }
-         if( nr == 0 ) {
-            
-            // EOF 
-            rc = 1;
-            break;
+            rc = 0;
+            continue;
          }
          
-         num_read += nr;
+         SG_error("pread(%s) errno = %d\n", stdout_path, rc );
+         break;
+      }
+      if( nr == 0 ) {
+         
+         // EOF 
+         break;
       }
       
-      free( stdout_path );
+      num_read += nr;
+   }
+   
+   close( fd );
+   free( stdout_path );
+   
+   if( rc < 0 ) {
       return rc;
    }
+   
+   return num_read;
 }
@@ -30,12 +30,15 @@
 #include <sys/time.h>
 #include <signal.h>
 #include <sys/wait.h>
+#include <sys/inotify.h>
+#include <poll.h>
 
 #include <string.h>
 #include <sstream>
 #include <iostream>
 #include <vector>
 #include <set>
+#include <map>
 
 #include "libsyndicate/libsyndicate.h"
 
@@ -60,6 +63,24 @@ struct proc_block_status {
     off_t   written_so_far;
 };
 
+// a reader waiting for a process to generate more output
+struct proc_output_waiter {
+   off_t want;                         // wake up once the output is at least this long (or the process exits)
+   bool registered;                    // if true, we're in the output's waiter list (cleared by whoever wakes us up)
+   pthread_cond_t cv;
+};
+
+typedef vector<struct proc_output_waiter*> proc_output_waiter_list_t;
+
+// a process's output, as it's being generated
+struct proc_output {
+   char*       stdout_path;            // path to the process's stdout on disk
+   int         wd;                     // inotify watch on stdout_path (-1 if not watched)
+   off_t       size;                   // bytes generated so far
+   bool        done;                   // if true, the process has exited, and size is final
+   
+   proc_output_waiter_list_t* waiters;
+};
 
 // map PIDs to running processes
 typedef map<pid_t, struct proc_table_entry*> proc_table_t;
@@ -67,6 +88,12 @@ typedef map<pid_t, struct proc_table_entry*> proc_table_t;
 // map request paths to names of cached data
 typedef map<string, string> cache_table_t;
 
+// map request paths to the output of the processes run for them
+typedef map<string, struct proc_output*> proc_output_table_t;
+
+// map inotify watch descriptors to request paths
+typedef map<int, string> proc_output_watch_table_t;
+
 void proc_sigchld_handler(int signum);
 
 int shell_driver_state_init( struct shell_driver_state* state );
@@ -77,8 +104,8 @@ int shell_driver_state_free( struct shell_driver_state* state );
 int proc_ensure_has_data( struct shell_driver_state* state, struct proc_connection_context* ctx );
 bool proc_is_generating_data( struct shell_driver_state* state, char const* request_path );
 bool proc_finished_generating_data( struct shell_driver_state* state, char const* request_path );
-int proc_stat_data( struct shell_driver_state* state, char const* request_path, struct stat* sb );
-int proc_read_block_data( struct shell_driver_state* state, char const* request_path, uint64_t block_id, char* buf, ssize_t read_size );
+int proc_stat_data( struct shell_driver_state* state, char const* request_path, struct stat* sb, bool* done );
+ssize_t proc_read_block_data( struct shell_driver_state* state, char const* request_path, uint64_t block_id, char* buf, ssize_t read_size, int timeout );
 
 int proc_evict_cache( struct shell_driver_state* state, char const* request_path );
 
@@ -0,0 +1,779 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+   
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+       
+       http://www.apache.org/licenses/LICENSE-2.0
+   
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "fs-map.h"
+
+#include <algorithm>
+#include <new>
+
+#include <string.h>
+
+// compare two paths in AG_fs_map order: component by component, with a name that is a prefix of another sorting first.
+// For paths without repeated or trailing slashes, this is string order with '/' sorting before every other character.
+int AG_path_compare( string const& p1, string const& p2 ) {
+   
+   size_t len = min( p1.size(), p2.size() );
+   
+   for( size_t i = 0; i < len; i++ ) {
+      
+      unsigned char c1 = p1[i];
+      unsigned char c2 = p2[i];
+      
+      if( c1 == c2 ) {
+         continue;
+      }
+      
+      if( c1 == '/' ) {
+         return -1;
+      }
+      if( c2 == '/' ) {
+         return 1;
+      }
+      
+      return (c1 < c2 ? -1 : 1);
+   }
+   
+   if( p1.size() == p2.size() ) {
+      return 0;
+   }
+   
+   return (p1.size() < p2.size() ? -1 : 1);
+}
+
+
+bool AG_path_less( string const& p1, string const& p2 ) {
+   return AG_path_compare( p1, p2 ) < 0;
+}
+
+
+// find the next component of path at or after *pos.
+// set *name and *name_len to it, and advance *pos past it.
+// return false if there are no more components
+static bool AG_fs_map_next_component( char const* path, size_t len, size_t* pos, char const** name, size_t* name_len ) {
+   
+   size_t i = *pos;
+   
+   while( i < len && path[i] == '/' ) {
+      i++;
+   }
+   
+   if( i == len ) {
+      *pos = i;
+      return false;
+   }
+   
+   size_t start = i;
+   
+   while( i < len && path[i] != '/' ) {
+      i++;
+   }
+   
+   *name = path + start;
+   *name_len = i - start;
+   *pos = i;
+
+   return true;
+}
+
+
+AG_fs_map::iterator::iterator() {
+   
+   this->fs_map = NULL;
+   this->node = AG_FS_MAP_NIL;
+   this->value.second = NULL;
+   this->value_node = AG_FS_MAP_NIL;
+}
+
+
+AG_fs_map::iterator::iterator( AG_fs_map* fs_map, uint32_t node ) {
+   
+   this->fs_map = fs_map;
+   this->node = node;
+   this->value.second = NULL;
+   this->value_node = AG_FS_MAP_NIL;
+}
+
+
+AG_fs_map::value_type const& AG_fs_map::iterator::operator*() const {
+   return *(this->operator->());
+}
+
+
+AG_fs_map::value_type const* AG_fs_map::iterator::operator->() const {
+   
+   if( this->node == AG_FS_MAP_NIL ) {
+      
+      this->value.first.clear();
+      this->value.second = NULL;
+   }
+   else {
+      
+      if( this->value_node != this->node ) {
+         
+         struct AG_fs_map_node const& n = this->fs_map->nodes[ this->node ];
+         
+         if( this->value_node != AG_FS_MAP_NIL && this->fs_map->nodes[ this->value_node ].parent == n.parent ) {
+            
+            // moved to a sibling; only the last component changes
+            this->value.first.resize( this->value.first.size() - this->fs_map->nodes[ this->value_node ].name_len );
+            this->value.first.append( &this->fs_map->names[ n.name_off ], n.name_len );
+         }
+         else {
+            this->fs_map->node_path( this->node, &this->value.first );
+         }
+         
+         this->value_node = this->node;
+      }
+      
+      // the entry may have been assigned since we got here
+      this->value.second = this->fs_map->nodes[ this->node ].mi;
+   }
+   
+   return &this->value;
+}
+
+
+AG_fs_map::iterator& AG_fs_map::iterator::operator++() {
+   
+   this->node = this->fs_map->next_entry( this->node );
+   return *this;
+}
+
+
+AG_fs_map::iterator AG_fs_map::iterator::operator++(int) {
+   
+   // don't copy the path; it's usually not needed
+   iterator old( this->fs_map, this->node );
+   ++(*this);
+   return old;
+}
+
+
+bool AG_fs_map::iterator::operator==( iterator const& other ) const {
+   return this->node == other.node && (this->node == AG_FS_MAP_NIL || this->fs_map == other.fs_map);
+}
+
+
+bool AG_fs_map::iterator::operator!=( iterator const& other ) const {
+   return !(*this == other);
+}
+
+
+AG_fs_map::AG_fs_map() {
+   
+   this->num_entries = 0;
+   this->clear();
+}
+
+
+// start over, releasing all memory
+void AG_fs_map::clear() {
+   
+   this->nodes.clear();
+   vector< vector<uint32_t> >().swap( this->child_lists );
+   this->names.clear();
+   vector<uint32_t>().swap( this->buckets );
+   
+   this->num_entries = 0;
+   
+   this->last_dir.clear();
+   this->last_dir_node = 0;
+   
+   // root, i.e. "/"
+   struct AG_fs_map_node root;
+   memset( &root, 0, sizeof(struct AG_fs_map_node) );
+   
+   root.parent = AG_FS_MAP_NIL;
+   root.children = AG_FS_MAP_NIL;
+   
+   this->nodes.push_back( root );
+}
+
+
+size_t AG_fs_map::size() const {
+   return this->num_entries;
+}
+
+
+bool AG_fs_map::empty() const {
+   return this->num_entries == 0;
+}
+
+
+AG_fs_map::iterator AG_fs_map::begin() {
+   
+   uint32_t node = 0;
+   
+   if( (this->nodes[0].flags & AG_FS_MAP_NODE_ENTRY) == 0 ) {
+      node = this->next_entry( 0 );
+   }
+   
+   return iterator( this, node );
+}
+
+
+AG_fs_map::iterator AG_fs_map::end() {
+   return iterator( this, AG_FS_MAP_NIL );
+}
+
+
+AG_fs_map::iterator AG_fs_map::find( string const& path ) {
+   
+   uint32_t node = this->find_node( path.data(), path.size() );
+   
+   if( node == AG_FS_MAP_NIL || (this->nodes[node].flags & AG_FS_MAP_NODE_ENTRY) == 0 ) {
+      return this->end();
+   }
+   
+   return iterator( this, node );
+}
+
+
+size_t AG_fs_map::count( string const& path ) {
+   
+   uint32_t node = this->find_node( path.data(), path.size() );
+   
+   if( node == AG_FS_MAP_NIL || (this->nodes[node].flags & AG_FS_MAP_NODE_ENTRY) == 0 ) {
+      return 0;
+   }
+   
+   return 1;
+}
+
+
+// first entry that is not before path (i.e. path itself, or its first descendant, or whatever comes after it)
+AG_fs_map::iterator AG_fs_map::lower_bound( string const& path ) {
+   
+   char const* name = NULL;
+   size_t name_len = 0;
+   size_t pos = 0;
+   
+   uint32_t node = 0;
+   uint32_t next = AG_FS_MAP_NIL;
+   
+   while( AG_fs_map_next_component( path.data(), path.size(), &pos, &name, &name_len ) ) {
+      
+      uint32_t child = this->find_child( node, name, name_len );
+      if( child != AG_FS_MAP_NIL ) {
+         
+         node = child;
+         continue;
+      }
+      
+      // path isn't here.  It would go before the first child with a bigger name, or after node's subtree if there is none.
+      next = AG_FS_MAP_NIL;
+      
+      if( this->nodes[node].children != AG_FS_MAP_NIL ) {
+         
+         vector<uint32_t> const& children = this->child_lists[ this->nodes[node].children ];
+         
+         for( size_t lo = 0, hi = children.size(); lo < hi; ) {
+            
+            size_t mid = lo + (hi - lo) / 2;
+            
+            if( this->compare_name( children[mid], name, name_len ) < 0 ) {
+               lo = mid + 1;
+            }
+            else {
+               hi = mid;
+               next = children[mid];
+            }
+         }
+      }
+      
+      if( next == AG_FS_MAP_NIL ) {
+         next = this->next_sibling( node );
+      }
+      
+      if( next != AG_FS_MAP_NIL && (this->nodes[next].flags & AG_FS_MAP_NODE_ENTRY) == 0 ) {
+         next = this->next_entry( next );
+      }
+      
+      return iterator( this, next );
+   }
+   
+   // path is a node (but maybe not an entry)
+   if( (this->nodes[node].flags & AG_FS_MAP_NODE_ENTRY) == 0 ) {
+      node = this->next_entry( node );
+   }
+   
+   return iterator( this, node );
+}
+
+
+// first entry after path and its descendants.  [lower_bound( path ), subtree_end( path )) is path and everything under it.
+AG_fs_map::iterator AG_fs_map::subtree_end( string const& path ) {
+   
+   uint32_t node = this->find_node( path.data(), path.size() );
+   if( node == AG_FS_MAP_NIL ) {
+      
+      // nothing under it
+      return this->lower_bound( path );
+   }
+   
+   node = this->next_sibling( node );
+   
+   if( node != AG_FS_MAP_NIL && (this->nodes[node].flags & AG_FS_MAP_NODE_ENTRY) == 0 ) {
+      node = this->next_entry( node );
+   }
+   
+   return iterator( this, node );
+}
+
+
+// get a reference to path's AG_map_info, adding path (with NULL) if it isn't here.
+// the reference is good until the next insertion.
+struct AG_map_info*& AG_fs_map::operator[]( string const& path ) {
+   
+   uint32_t node = this->make_node( path.data(), path.size() );
+   
+   if( (this->nodes[node].flags & AG_FS_MAP_NODE_ENTRY) == 0 ) {
+      
+      this->nodes[node].flags |= AG_FS_MAP_NODE_ENTRY;
+      this->nodes[node].mi = NULL;
+      this->num_entries++;
+   }
+   
+   return this->nodes[node].mi;
+}
+
+
+// add value, unless its path is already here
+pair<AG_fs_map::iterator, bool> AG_fs_map::insert( value_type const& value ) {
+   
+   uint32_t node = this->make_node( value.first.data(), value.first.size() );
+   
+   if( this->nodes[node].flags & AG_FS_MAP_NODE_ENTRY ) {
+      return pair<iterator, bool>( iterator( this, node ), false );
+   }
+   
+   this->nodes[node].flags |= AG_FS_MAP_NODE_ENTRY;
+   this->nodes[node].mi = value.second;
+   this->num_entries++;
+   
+   return pair<iterator, bool>( iterator( this, node ), true );
+}
+
+
+// the hint is not needed; finding the spot costs the same either way
+AG_fs_map::iterator AG_fs_map::insert( iterator hint, value_type const& value ) {
+   return this->insert( value ).first;
+}
+
+
+// point an entry at a different AG_map_info
+void AG_fs_map::assign( iterator const& itr, struct AG_map_info* mi ) {
+   
+   this->nodes[ itr.node ].mi = mi;
+}
+
+
+// take an entry out of the map.  Its node stays, so iterators to other entries stay valid.
+void AG_fs_map::erase( iterator itr ) {
+   
+   struct AG_fs_map_node* node = &this->nodes[ itr.node ];
+   
+   if( node->flags & AG_FS_MAP_NODE_ENTRY ) {
+      
+      node->flags &= ~AG_FS_MAP_NODE_ENTRY;
+      node->mi = NULL;
+      this->num_entries--;
+   }
+}
+
+
+size_t AG_fs_map::erase( string const& path ) {
+   
+   uint32_t node = this->find_node( path.data(), path.size() );
+   
+   if( node == AG_FS_MAP_NIL || (this->nodes[node].flags & AG_FS_MAP_NODE_ENTRY) == 0 ) {
+      return 0;
+   }
+   
+   this->erase( iterator( this, node ) );
+   return 1;
+}
+
+
+size_t AG_fs_map::memory_used() const {
+   
+   size_t total = sizeof(AG_fs_map);
+   
+   total += this->nodes.memory_used();
+   total += this->child_lists.capacity() * sizeof(vector<uint32_t>);
+   total += this->names.memory_used();
+   total += this->buckets.capacity() * sizeof(uint32_t);
+   
+   for( size_t i = 0; i < this->child_lists.size(); i++ ) {
+      total += this->child_lists[i].capacity() * sizeof(uint32_t);
+   }
+   
+   return total;
+}
+
+
+// find the node for a path
+// return AG_FS_MAP_NIL if there is none
+uint32_t AG_fs_map::find_node( char const* path, size_t len ) const {
+   
+   char const* name = NULL;
+   size_t name_len = 0;
+   size_t pos = 0;
+   
+   uint32_t node = 0;
+   
+   while( node != AG_FS_MAP_NIL && AG_fs_map_next_component( path, len, &pos, &name, &name_len ) ) {
+      node = this->find_child( node, name, name_len );
+   }
+   
+   return node;
+}
+
+
+// find the node for a path, adding it (and its ancestors) if need be
+// throws bad_alloc if OOM
+uint32_t AG_fs_map::make_node( char const* path, size_t len ) {
+   
+   char const* name = NULL;
+   size_t name_len = 0;
+   size_t pos = 0;
+   
+   uint32_t node = this->start_node( path, len, &pos );
+   
+   while( AG_fs_map_next_component( path, len, &pos, &name, &name_len ) ) {
+      
+      uint32_t child = AG_FS_MAP_NIL;
+      
+      // paths are usually added in order, so this is usually a new last child, which we can tell without looking it up
+      if( !this->after_children( node, name, name_len ) ) {
+         child = this->find_child( node, name, name_len );
+      }
+      
+      if( child == AG_FS_MAP_NIL ) {
+         child = this->add_child( node, name, name_len );
+      }
+      
+      node = child;
+   }
+   
+   return node;
+}
+
+
+// find the node to start adding path from: the last directory added to, if path is in it, and the root if not.
+// remember path's directory for next time.
+// set *pos to where the rest of path starts.
+uint32_t AG_fs_map::start_node( char const* path, size_t len, size_t* pos ) {
+   
+   size_t dir_len = len;
+   
+   // ignore trailing slashes
+   while( dir_len > 0 && path[ dir_len - 1 ] == '/' ) {
+      dir_len--;
+   }
+   
+   while( dir_len > 0 && path[ dir_len - 1 ] != '/' ) {
+      dir_len--;
+   }
+   
+   if( dir_len > 0 && dir_len == this->last_dir.size() && memcmp( path, this->last_dir.data(), dir_len ) == 0 ) {
+      
+      *pos = dir_len;
+      return this->last_dir_node;
+   }
+   
+   // find the directory, and remember it
+   uint32_t node = 0;
+   char const* name = NULL;
+   size_t name_len = 0;
+   
+   *pos = 0;
+
+   while( node != AG_FS_MAP_NIL && AG_fs_map_next_component( path, dir_len, pos, &name, &name_len ) ) {
+      node = this->find_child( node, name, name_len );
+   }
+   
+   if( node != AG_FS_MAP_NIL ) {
+      
+      try {
+         this->last_dir.assign( path, dir_len );
+         this->last_dir_node = node;
+      }
+      catch( bad_alloc& ba ) {
+         this->last_dir.clear();
+      }
+      
+      *pos = dir_len;
+      return node;
+   }
+   
+   // not there; start over from the root
+   *pos = 0;
+   return 0;
+}
+
+
+// does name sort after all of a node's children?  (i.e. it's not one of them)
+bool AG_fs_map::after_children( uint32_t node, char const* name, size_t name_len ) const {
+   
+   if( this->nodes[node].children == AG_FS_MAP_NIL ) {
+      return true;
+   }
+   
+   vector<uint32_t> const& children = this->child_lists[ this->nodes[node].children ];
+   
+   return children.size() == 0 || this->compare_name( children[ children.size() - 1 ], name, name_len ) < 0;
+}
+
+
+// compare a node's name to name
+int AG_fs_map::compare_name( uint32_t node, char const* name, size_t name_len ) const {
+   
+   struct AG_fs_map_node const& n = this->nodes[node];
+   
+   int rc = memcmp( &this->names[ n.name_off ], name, min( (size_t)n.name_len, name_len ) );
+   if( rc != 0 ) {
+      return rc;
+   }
+   
+   if( n.name_len == name_len ) {
+      return 0;
+   }
+   
+   return (n.name_len < name_len ? -1 : 1);
+}
+
+
+uint32_t AG_fs_map::hash_name( uint32_t parent, char const* name, size_t name_len ) const {
+   
+   // FNV-1a, seeded with the parent
+   uint64_t hash = 14695981039346656037ULL ^ ((uint64_t)parent * 0x9e3779b97f4a7c15ULL);
+   
+   for( size_t i = 0; i < name_len; i++ ) {
+      
+      hash ^= (unsigned char)name[i];
+      hash *= 1099511628211ULL;
+   }
+   
+   return (uint32_t)(hash ^ (hash >> 32));
+}
+
+
+// find a node's child by name
+// return AG_FS_MAP_NIL if there is no such child
+uint32_t AG_fs_map::find_child( uint32_t parent, char const* name, size_t name_len ) const {
+   
+   if( this->buckets.size() == 0 ) {
+      return AG_FS_MAP_NIL;
+   }
+   
+   size_t mask = this->buckets.size() - 1;
+   uint32_t hash = this->hash_name( parent, name, name_len );
+   
+   for( size_t i = hash & mask; this->buckets[i] != AG_FS_MAP_NIL; i = (i + 1) & mask ) {
+      
+      struct AG_fs_map_node const& n = this->nodes[ this->buckets[i] ];
+      
+      if( n.hash == hash && n.parent == parent && n.name_len == name_len && this->compare_name( this->buckets[i], name, name_len ) == 0 ) {
+         return this->buckets[i];
+      }
+   }
+   
+   return AG_FS_MAP_NIL;
+}
+
+
+// put a node into the hash table, which must have room
+void AG_fs_map::hash_insert( uint32_t node ) {
+   
+   size_t mask = this->buckets.size() - 1;
+   size_t i = this->nodes[node].hash & mask;
+   
+   while( this->buckets[i] != AG_FS_MAP_NIL ) {
+      i = (i + 1) & mask;
+   }
+   
+   this->buckets[i] = node;
+}
+
+
+// double the hash table
+// throws bad_alloc if OOM
+void AG_fs_map::hash_grow() {
+   
+   vector<uint32_t> new_buckets( max( (size_t)64, this->buckets.size() * 2 ), AG_FS_MAP_NIL );
+   
+   this->buckets.swap( new_buckets );
+   
+   // every node but the root is in the table
+   for( uint32_t i = 1; i < this->nodes.size(); i++ ) {
+      this->hash_insert( i );
+   }
+}
+
+
+// add a child node
+// return its index
+// throws bad_alloc if OOM.  Nothing changes if so.
+uint32_t AG_fs_map::add_child( uint32_t parent, char const* name, size_t name_len ) {
+   
+   uint32_t node = this->nodes.size();
+   
+   if( node == AG_FS_MAP_NIL || this->names.size() + name_len + (1 << AG_FS_MAP_NAME_CHUNK_BITS) > (uint32_t)(-1) ) {
+      throw bad_alloc();
+   }
+   
+   // keep the table at most 3/4 full
+   if( (this->nodes.size() + 1) * 4 > this->buckets.size() * 3 ) {
+      this->hash_grow();
+   }
+   
+   if( this->nodes[parent].children == AG_FS_MAP_NIL ) {
+      
+      this->child_lists.push_back( vector<uint32_t>() );
+      this->nodes[parent].children = this->child_lists.size() - 1;
+   }
+   
+   vector<uint32_t>& children = this->child_lists[ this->nodes[parent].children ];
+   
+   if( children.size() == children.capacity() ) {
+      children.reserve( max( (size_t)2, children.size() * 2 ) );
+   }
+   
+   struct AG_fs_map_node n;
+   memset( &n, 0, sizeof(struct AG_fs_map_node) );
+   
+   n.parent = parent;
+   n.children = AG_FS_MAP_NIL;
+   n.name_len = name_len;
+   n.hash = this->hash_name( parent, name, name_len );
+   
+   // find its place among its siblings.  Usually it goes last.
+   size_t pos = children.size();
+   
+   if( pos > 0 && this->compare_name( children[ pos - 1 ], name, name_len ) > 0 ) {
+      
+      size_t lo = 0;
+      size_t hi = pos - 1;
+      
+      while( lo < hi ) {
+         
+         size_t mid = lo + (hi - lo) / 2;
+         
+         if( this->compare_name( children[mid], name, name_len ) < 0 ) {
+            lo = mid + 1;
+         }
+         else {
+            hi = mid;
+         }
+      }
+      
+      pos = lo;
+   }
+   
+   n.pos = pos;
+   
+   n.name_off = this->names.append( name, name_len );
+   this->nodes.push_back( n );
+   
+   children.insert( children.begin() + pos, node );
+   
+   for( size_t i = pos + 1; i < children.size(); i++ ) {
+      this->nodes[ children[i] ].pos = i;
+   }
+   
+   this->hash_insert( node );
+   
+   return node;
+}
+
+
+// next node in order: the first child, or the next sibling of the node or its nearest ancestor that has one
+// return AG_FS_MAP_NIL if node is the last one
+uint32_t AG_fs_map::next_node( uint32_t node ) const {
+   
+   if( this->nodes[node].children != AG_FS_MAP_NIL ) {
+      
+      vector<uint32_t> const& children = this->child_lists[ this->nodes[node].children ];
+      if( children.size() > 0 ) {
+         return children[0];
+      }
+   }
+   
+   return this->next_sibling( node );
+}
+
+
+// next node in order that is not below node
+// return AG_FS_MAP_NIL if there is none
+uint32_t AG_fs_map::next_sibling( uint32_t node ) const {
+   
+   while( node != 0 ) {
+      
+      uint32_t parent = this->nodes[node].parent;
+      vector<uint32_t> const& siblings = this->child_lists[ this->nodes[parent].children ];
+      
+      size_t i = this->nodes[node].pos;
+      
+      if( i + 1 < siblings.size() ) {
+         return siblings[i + 1];
+      }
+      
+      node = parent;
+   }
+   
+   return AG_FS_MAP_NIL;
+}
+
+
+// next node in order that is an entry
+// return AG_FS_MAP_NIL if there is none
+uint32_t AG_fs_map::next_entry( uint32_t node ) const {
+   
+   do {
+      node = this->next_node( node );
+   } while( node != AG_FS_MAP_NIL && (this->nodes[node].flags & AG_FS_MAP_NODE_ENTRY) == 0 );
+   
+   return node;
+}
+
+
+// get the path to a node
+void AG_fs_map::node_path( uint32_t node, string* path ) const {
+   
+   if( node == 0 ) {
+      path->assign( "/" );
+      return;
+   }
+   
+   size_t len = 0;
+   
+   for( uint32_t n = node; n != 0; n = this->nodes[n].parent ) {
+      len += 1 + this->nodes[n].name_len;
+   }
+   
+   path->resize( len );
+   
+   // fill in from the end
+   for( uint32_t n = node; n != 0; n = this->nodes[n].parent ) {
+      
+      len -= this->nodes[n].name_len;
+      memcpy( &(*path)[len], &this->names[ this->nodes[n].name_off ], this->nodes[n].name_len );
+      
+      len--;
+      (*path)[len] = '/';
+   }
+}
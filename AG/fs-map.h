@@ -0,0 +1,332 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Path-to-AG_map_info map, stored as a trie of path components.
+// Each path component is stored once, in a shared name pool, instead of once per full path in every key below it,
+// and finding a path costs one hash table probe per component.  Nodes are kept in arrays and refer to each other by
+// index, so there is no per-entry allocation.
+//
+// It has the subset of std::map<string, AG_map_info*>'s interface that the AG uses, with these differences:
+// * keys are compared component by component (see AG_path_compare), so "/a" and "/a/" (and "/a//") are the same key, and a
+//   directory's descendants sort right after it (i.e. "/a/b" comes before "/a-b").
+// * iterators are read-only; use assign() to change the AG_map_info an entry refers to.
+// * erasing an entry leaves its node in place (so other iterators stay valid, and putting the path back is cheap).
+//   The memory is reclaimed by clear().
+// As with std::map, lookups and iteration don't change the map, so any number of threads can do them at once.
+
+#ifndef _AG_FS_MAP_H_
+#define _AG_FS_MAP_H_
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <new>
+
+#include <stdint.h>
+
+using namespace std;
+
+#define AG_FS_MAP_NIL ((uint32_t)(-1))
+
+struct AG_map_info;
+
+// compare two paths in AG_fs_map order
+int AG_path_compare( string const& p1, string const& p2 );
+
+// AG_path_compare( p1, p2 ) < 0, for sort() and friends
+bool AG_path_less( string const& p1, string const& p2 );
+
+// trie node
+struct AG_fs_map_node {
+
+   struct AG_map_info* mi;
+
+   uint32_t parent;             // index of the parent node (AG_FS_MAP_NIL for the root)
+   uint32_t children;           // index of the child list (AG_FS_MAP_NIL if there are none)
+   uint32_t pos;                // index in the parent's child list
+
+   uint32_t name_off;           // component name, in the name pool
+   uint32_t name_len : 24;
+   uint32_t flags : 8;
+
+   uint32_t hash;               // of the parent and name (see hash_name)
+};
+
+#define AG_FS_MAP_NODE_ENTRY            0x1     // this node is in the map (otherwise, it's only an ancestor of nodes that are, or was erased)
+
+#define AG_FS_MAP_NODE_CHUNK_BITS       12      // 4096 nodes per chunk
+#define AG_FS_MAP_NAME_CHUNK_BITS       16      // 64KB of names per chunk (so no name can be longer)
+
+// array of plain data, allocated in fixed-size chunks, so it grows without moving what's already in it or leaving much room unused.
+// the first chunk starts out small and grows to full size, so small arrays stay small.
+template <class T, unsigned int CHUNK_BITS> class AG_fs_map_chunks {
+
+public:
+
+   AG_fs_map_chunks() : count( 0 ), first_capacity( 0 ) {}
+
+   AG_fs_map_chunks( AG_fs_map_chunks const& other ) : count( 0 ), first_capacity( 0 ) {
+      this->copy( other );
+   }
+
+   AG_fs_map_chunks& operator=( AG_fs_map_chunks const& other ) {
+
+      if( this != &other ) {
+         this->clear();
+         this->copy( other );
+      }
+
+      return *this;
+   }
+
+   ~AG_fs_map_chunks() {
+      this->clear();
+   }
+
+   T& operator[]( size_t i ) {
+      return this->chunks[ i >> CHUNK_BITS ][ i & ((1 << CHUNK_BITS) - 1) ];
+   }
+
+   T const& operator[]( size_t i ) const {
+      return this->chunks[ i >> CHUNK_BITS ][ i & ((1 << CHUNK_BITS) - 1) ];
+   }
+
+   size_t size() const {
+      return this->count;
+   }
+
+   // add n items, all in the same chunk (so they can be read as an array), and return the index of the first.
+   // throws bad_alloc if OOM, or if n is bigger than a chunk
+   size_t append( T const* items, size_t n ) {
+
+      size_t chunk_size = (1 << CHUNK_BITS);
+      size_t start = this->count;
+
+      if( n > chunk_size ) {
+         throw bad_alloc();
+      }
+
+      // start a new chunk if they won't fit in this one
+      if( (start & (chunk_size - 1)) + n > chunk_size ) {
+         start = (start + chunk_size - 1) & ~(chunk_size - 1);
+      }
+
+      if( start + n <= this->first_capacity ) {
+         // fits in the first chunk
+      }
+      else if( ((start + n - 1) >> CHUNK_BITS) == 0 ) {
+
+         // grow the first chunk
+         size_t capacity = std::min( chunk_size, std::max( start + n, std::max( (size_t)8, this->first_capacity * 2 ) ) );
+         T* chunk = new T[ capacity ];
+
+         if( this->chunks.size() == 0 ) {
+
+            try {
+               this->chunks.push_back( chunk );
+            }
+            catch( bad_alloc& ba ) {
+               delete[] chunk;
+               throw;
+            }
+         }
+         else {
+
+            std::copy( this->chunks[0], this->chunks[0] + this->count, chunk );
+
+            delete[] this->chunks[0];
+            this->chunks[0] = chunk;
+         }
+
+         this->first_capacity = capacity;
+      }
+      else if( ((start + n - 1) >> CHUNK_BITS) >= this->chunks.size() ) {
+
+         T* chunk = new T[ chunk_size ];
+
+         try {
+            this->chunks.push_back( chunk );
+         }
+         catch( bad_alloc& ba ) {
+            delete[] chunk;
+            throw;
+         }
+      }
+
+      std::copy( items, items + n, &(*this)[start] );
+      this->count = start + n;
+
+      return start;
+   }
+
+   size_t push_back( T const& item ) {
+      return this->append( &item, 1 );
+   }
+
+   void clear() {
+
+      for( size_t i = 0; i < this->chunks.size(); i++ ) {
+         delete[] this->chunks[i];
+      }
+
+      vector<T*>().swap( this->chunks );
+      this->count = 0;
+      this->first_capacity = 0;
+   }
+
+   size_t memory_used() const {
+
+      if( this->chunks.size() == 0 ) {
+         return 0;
+      }
+
+      return this->chunks.capacity() * sizeof(T*) + (this->first_capacity + (this->chunks.size() - 1) * (1 << CHUNK_BITS)) * sizeof(T);
+   }
+
+private:
+
+   void copy( AG_fs_map_chunks const& other ) {
+
+      for( size_t i = 0; i < other.chunks.size(); i++ ) {
+
+         size_t capacity = (i == 0 ? other.first_capacity : (1 << CHUNK_BITS));
+
+         T* chunk = new T[ capacity ];
+         std::copy( other.chunks[i], other.chunks[i] + capacity, chunk );
+
+         try {
+            this->chunks.push_back( chunk );
+         }
+         catch( bad_alloc& ba ) {
+            delete[] chunk;
+            throw;
+         }
+      }
+
+      this->count = other.count;
+      this->first_capacity = other.first_capacity;
+   }
+
+   vector<T*> chunks;
+   size_t count;
+   size_t first_capacity;       // number of items the first chunk has room for
+};
+
+class AG_fs_map {
+
+public:
+
+   typedef pair<string, struct AG_map_info*> value_type;
+
+   class iterator {
+
+   public:
+
+      iterator();
+
+      value_type const& operator*() const;
+      value_type const* operator->() const;
+
+      iterator& operator++();
+      iterator operator++(int);
+
+      bool operator==( iterator const& other ) const;
+      bool operator!=( iterator const& other ) const;
+
+   private:
+
+      friend class AG_fs_map;
+
+      iterator( AG_fs_map* fs_map, uint32_t node );
+
+      AG_fs_map* fs_map;
+      uint32_t node;
+
+      // entry's path (built on first access), and its AG_map_info (re-read on each access)
+      mutable value_type value;
+      mutable uint32_t value_node;
+   };
+
+   AG_fs_map();
+
+   iterator begin();
+   iterator end();
+
+   size_t size() const;
+   bool empty() const;
+   void clear();
+
+   iterator find( string const& path );
+   size_t count( string const& path );
+
+   // first entry that is not before path
+   iterator lower_bound( string const& path );
+
+   // first entry after path and all of its descendants
+   iterator subtree_end( string const& path );
+
+   struct AG_map_info*& operator[]( string const& path );
+
+   pair<iterator, bool> insert( value_type const& value );
+   iterator insert( iterator hint, value_type const& value );
+
+   void assign( iterator const& itr, struct AG_map_info* mi );
+
+   void erase( iterator itr );
+   size_t erase( string const& path );
+
+   // bytes used by the trie itself (not the AG_map_infos)
+   size_t memory_used() const;
+
+private:
+
+   friend class iterator;
+
+   uint32_t find_node( char const* path, size_t len ) const;
+   uint32_t make_node( char const* path, size_t len );
+   uint32_t start_node( char const* path, size_t len, size_t* pos );
+
+   uint32_t find_child( uint32_t parent, char const* name, size_t name_len ) const;
+   bool after_children( uint32_t node, char const* name, size_t name_len ) const;
+   uint32_t add_child( uint32_t parent, char const* name, size_t name_len );
+
+   int compare_name( uint32_t node, char const* name, size_t name_len ) const;
+
+   uint32_t next_node( uint32_t node ) const;
+   uint32_t next_sibling( uint32_t node ) const;
+   uint32_t next_entry( uint32_t node ) const;
+
+   void node_path( uint32_t node, string* path ) const;
+
+   uint32_t hash_name( uint32_t parent, char const* name, size_t name_len ) const;
+   void hash_insert( uint32_t node );
+   void hash_grow();
+
+   AG_fs_map_chunks<struct AG_fs_map_node, AG_FS_MAP_NODE_CHUNK_BITS> nodes;     // node 0 is the root
+   vector< vector<uint32_t> > child_lists;                                      // each node's children, sorted by name
+   AG_fs_map_chunks<char, AG_FS_MAP_NAME_CHUNK_BITS> names;
+
+   vector<uint32_t> buckets;                    // open-addressed (parent, name) --> node
+
+   size_t num_entries;
+
+   // directory of the last path added, since the next one usually goes next to it
+   string last_dir;
+   uint32_t last_dir_node;
+};
+
+#endif
@@ -20,9 +20,14 @@
 #include "core.h"
 #include "cache.h"
 #include "workqueue.h"
+#include "driver-pool.h"
 
 static char const* AG_HTTP_DRIVER_ERROR = "AG driver error\n";
 
+// blocks and manifests being generated right now
+static AG_inflight_map_t g_AG_inflight;
+static pthread_mutex_t g_AG_inflight_lock = PTHREAD_MUTEX_INITIALIZER;
+
 // free a AG_connection_data
 static void AG_connection_data_free( struct AG_connection_data* con_data ) {
    
@@ -33,7 +38,7 @@ static void AG_connection_data_free( struct AG_connection_data* con_data ) {
    struct AG_driver* driver = con_data->ctx.driver;
    
    // driver connection cleanup
-   if( con_data->ctx.request_type == AG_REQUEST_BLOCK ) {
+   if( con_data->driver_connected ) {
       AG_driver_cleanup_block( driver, &con_data->ctx );
    }
    
@@ -512,30 +517,11 @@ static void* AG_HTTP_connect( struct md_HTTP_connection_data* md_con_data ) {
    con_data->ctx.query_string = SG_strdup_or_null( mi->query_string );
    
    // connection context is set up.
-   // set up the driver state.
-   if( con_data->ctx.request_type == AG_REQUEST_BLOCK ) {
-      rc = AG_driver_connect_block( con_data->ctx.driver, &con_data->ctx );
-   }
-   
+   // the driver state gets set up on a driver worker, if the block isn't cached (see AG_make_block)
    AG_release_state( state );
    
-   if( rc != 0 ) {
-      
-      SG_error("AG_driver_connect_block(%s) rc = %d\n", md_con_data->url_path, rc );
-      
-      AG_HTTP_driver_error( md_con_data, AG_get_driver_HTTP_status( &con_data->ctx, 502 ) );
-      
-      AG_connection_data_free( con_data );
-      free( con_data );
-      con_data = NULL;
-      
-      return NULL;
-   }
-   
-   else {
-      // so far so good!
-      md_con_data->status = 200;
-   }
+   // so far so good!
+   md_con_data->status = 200;
    
    return (void*)con_data;
 }
@@ -578,12 +564,17 @@ static int AG_serialize_block( struct AG_state* state, struct AG_connection_data
 }
 
 
-// AG GET block handler 
-static struct md_HTTP_response* AG_GET_block_handler( struct AG_state* state, struct AG_connection_data* rpc ) {
+// generate a signed block or manifest, and cache it
+// return 0 on success, and set *buf and *len to a copy the caller owns
+// return negative on error, and set *http_status and *http_msg to the reply to send
+typedef int (*AG_make_func_t)( struct AG_state* state, struct AG_connection_data* rpc, char** buf, size_t* len, int* http_status, char const** http_msg );
 
+
+// fetch a block from the driver, then sign, serialize, and cache it
+static int AG_make_block( struct AG_state* state, struct AG_connection_data* rpc, char** ret_block, size_t* ret_block_len, int* http_status, char const** http_msg ) {
+   
    int ret = 0;
    int rc = 0;
-   struct md_HTTP_response* resp = SG_CALLOC( struct md_HTTP_response, 1 );
    
    char* block_buf = NULL;
    size_t block_size = 0;
@@ -592,196 +583,499 @@ static struct md_HTTP_response* AG_GET_block_handler( struct AG_state* state, st
    size_t serialized_block_len = 0;
    
    char* http_reply = NULL;
-   size_t http_reply_len = 0;
-   
-   // check cache for the signed serialized block
-   ret = AG_cache_get_block( state, rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.block_id, rpc->ctx.reqdat.block_version, &serialized_block, &serialized_block_len );
    
-   if( ret != 0 ) {
-      // cache miss
-      // get the bits from the driver
-      block_size = ms_client_get_volume_blocksize( state->ms );
-      block_buf = SG_CALLOC( char, block_size );
-      
-      ret = AG_driver_get_block( rpc->ctx.driver, &rpc->ctx, rpc->ctx.reqdat.block_id, block_buf, block_size );
+   // set up the driver state 
+   if( !rpc->driver_connected ) {
       
-      if( ret < 0 ) {
-         // driver failure 
-         SG_error("AG_driver_get_block(%s %" PRIX64 ".%" PRId64 "[%" PRId64 ".%" PRId64 "]) rc = %d\n",
-               rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_id, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.block_id, rpc->ctx.reqdat.block_version, ret );
+      rc = AG_driver_connect_block( rpc->ctx.driver, &rpc->ctx );
+      if( rc != 0 ) {
          
-         // clean up 
-         free( block_buf );
-         md_create_HTTP_response_ram_static( resp, "text/plain", AG_get_driver_HTTP_status( &rpc->ctx, 502 ), AG_HTTP_DRIVER_ERROR, strlen(AG_HTTP_DRIVER_ERROR) + 1);
-         return resp;
-      }
-      if( ret > 0 && (unsigned)ret < block_size ) {
+         SG_error("AG_driver_connect_block(%s %" PRIX64 ".%" PRId64 "[%" PRId64 ".%" PRId64 "]) rc = %d\n",
+                  rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_id, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.block_id, rpc->ctx.reqdat.block_version, rc );
          
-         // zero untouched area of the block
-         memset( block_buf + ret, 0, block_size - ret ); 
+         *http_status = AG_get_driver_HTTP_status( &rpc->ctx, 502 );
+         *http_msg = AG_HTTP_DRIVER_ERROR;
+         return rc;
       }
       
-      // serialize the block
-      rc = AG_serialize_block( state, rpc, block_buf, ret, &serialized_block, &serialized_block_len );
+      rpc->driver_connected = true;
+   }
+   
+   // get the bits from the driver
+   block_size = ms_client_get_volume_blocksize( state->ms );
+   block_buf = SG_CALLOC( char, block_size );
+   if( block_buf == NULL ) {
+      *http_status = 500;
+      *http_msg = MD_HTTP_500_MSG;
+      return -ENOMEM;
+   }
+   
+   ret = AG_driver_get_block( rpc->ctx.driver, &rpc->ctx, rpc->ctx.reqdat.block_id, block_buf, block_size );
+   
+   if( ret < 0 ) {
+      // driver failure 
+      SG_error("AG_driver_get_block(%s %" PRIX64 ".%" PRId64 "[%" PRId64 ".%" PRId64 "]) rc = %d\n",
+            rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_id, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.block_id, rpc->ctx.reqdat.block_version, ret );
       
+      // clean up 
       free( block_buf );
       
-      if( rc != 0 ) {
-         SG_error("AG_serialize_block(%s %" PRIX64 ".%" PRId64 "[%" PRIu64 ".%" PRId64 "]) rc = %d\n",
-                rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_id, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.block_id, rpc->ctx.reqdat.block_version, rc );
-         
-         md_create_HTTP_response_ram_static( resp, "text/plain", 500, MD_HTTP_500_MSG, strlen(MD_HTTP_500_MSG) + 1);
-         return resp;
-      }
-      
-      // duplicate: one for the cache, one for the HTTP server (!!)
-      http_reply = SG_CALLOC( char, serialized_block_len );
-      if( http_reply == NULL ) {
-         SG_error("%s\n", "OOM");
-         md_create_HTTP_response_ram_static( resp, "text/plain", 500, MD_HTTP_500_MSG, strlen(MD_HTTP_500_MSG) + 1);
-         return resp;
-      }
-      
-      http_reply_len = serialized_block_len;
-      memcpy( http_reply, serialized_block, http_reply_len );
+      *http_status = AG_get_driver_HTTP_status( &rpc->ctx, 502 );
+      *http_msg = AG_HTTP_DRIVER_ERROR;
+      return ret;
+   }
+   if( ret > 0 && (unsigned)ret < block_size ) {
       
-      // cache the serialized block for future use (NOTE: cache takes ownership on success)
-      ret = AG_cache_put_block_async( state, rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.block_id, rpc->ctx.reqdat.block_version, serialized_block, serialized_block_len );
+      // zero untouched area of the block
+      memset( block_buf + ret, 0, block_size - ret ); 
+   }
+   
+   // serialize the block
+   rc = AG_serialize_block( state, rpc, block_buf, ret, &serialized_block, &serialized_block_len );
+   
+   free( block_buf );
+   
+   if( rc != 0 ) {
+      SG_error("AG_serialize_block(%s %" PRIX64 ".%" PRId64 "[%" PRIu64 ".%" PRId64 "]) rc = %d\n",
+             rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_id, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.block_id, rpc->ctx.reqdat.block_version, rc );
       
-      if( ret != 0 ) {
-         SG_error("WARN: AG_cache_put_block_async(%s %" PRIX64 ".%" PRId64 "[%" PRIu64 ".%" PRId64 "]) rc = %d\n",
-                rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_id, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.block_id, rpc->ctx.reqdat.block_version, ret );
-         
-         // mask this, since this isn't necessary for correctness
-         ret = 0;
-         
-         free( serialized_block );
-         serialized_block = NULL;
-      }
+      *http_status = 500;
+      *http_msg = MD_HTTP_500_MSG;
+      return rc;
    }
-   else {
-      // on hit, promote 
-      ret = AG_cache_promote_block( state, rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.block_id, rpc->ctx.reqdat.block_version );
+   
+   // duplicate: one for the cache, one for the HTTP server (!!)
+   http_reply = SG_CALLOC( char, serialized_block_len );
+   if( http_reply == NULL ) {
+      SG_error("%s\n", "OOM");
       
-      if( ret != 0 ) {
-         SG_error("WARN: AG_cache_promote_block(%s %" PRIX64 ".%" PRId64 ".%" PRId64 ".%" PRId64 ") rc = %d\n",
-                rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_id, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.block_id, rpc->ctx.reqdat.block_version, ret );
-         
-         // mask this, since this isn't necessary for correctness 
-         ret = 0;
-      }
+      free( serialized_block );
       
-      http_reply = serialized_block;
-      http_reply_len = serialized_block_len;
+      *http_status = 500;
+      *http_msg = MD_HTTP_500_MSG;
+      return -ENOMEM;
    }
    
-   // send it off 
-   md_HTTP_add_header( resp, "Connection", "keep-alive" );
-   md_create_HTTP_response_ram_nocopy( resp, "application/octet-stream", 200, http_reply, http_reply_len );
+   memcpy( http_reply, serialized_block, serialized_block_len );
    
-   SG_debug("Send block %s.%" PRIX64 ".%" PRId64 ".%" PRIu64 ".%" PRId64 "\n",
-            rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_id, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.block_id, rpc->ctx.reqdat.block_version );
+   *ret_block = http_reply;
+   *ret_block_len = serialized_block_len;
    
-   return resp;
+   // cache the serialized block for future use (NOTE: cache takes ownership on success)
+   ret = AG_cache_put_block_async( state, rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.block_id, rpc->ctx.reqdat.block_version, serialized_block, serialized_block_len );
+   
+   if( ret != 0 ) {
+      SG_error("WARN: AG_cache_put_block_async(%s %" PRIX64 ".%" PRId64 "[%" PRIu64 ".%" PRId64 "]) rc = %d\n",
+             rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_id, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.block_id, rpc->ctx.reqdat.block_version, ret );
+      
+      // not an error, since not needed for correctness
+      free( serialized_block );
+   }
+   
+   return 0;
 }
 
 
-// AG GET manifest handler 
-static struct md_HTTP_response* AG_GET_manifest_handler( struct AG_state* state, struct AG_connection_data* rpc ) {
-
-   // manifest request 
-   Serialization::ManifestMsg mmsg;
+// populate, sign, serialize, and cache a manifest
+static int AG_make_manifest( struct AG_state* state, struct AG_connection_data* rpc, char** ret_manifest, size_t* ret_manifest_len, int* http_status, char const** http_msg ) {
    
+   Serialization::ManifestMsg mmsg;
    int rc = 0;
-   struct md_HTTP_response* resp = SG_CALLOC( struct md_HTTP_response, 1 );
-   
-   if( rpc->pubinfo == NULL ) {
-      SG_error("BUG: %p is a manifest request, but no pubinfo given!\n", rpc );
-      
-      md_create_HTTP_response_ram_static( resp, "text/plain", 500, MD_HTTP_500_MSG, strlen(MD_HTTP_500_MSG) + 1 );
-      return resp;
-   }
    
    char* serialized_manifest = NULL;
    size_t serialized_manifest_len = 0;
    
    char* http_reply = NULL;
-   size_t http_reply_len = 0;
    
-   // cached manifest?
-   rc = AG_cache_get_manifest( state, rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.manifest_timestamp.tv_sec, rpc->ctx.reqdat.manifest_timestamp.tv_nsec,
-                               &serialized_manifest, &serialized_manifest_len );
+   // populate the manifest
+   rc = AG_populate_manifest( &mmsg, rpc->ctx.reqdat.fs_path, rpc->mi, rpc->pubinfo );
+   if( rc != 0 ) {
+      
+      SG_error("AG_populate_manifest( %s %" PRIX64 ".%" PRId64 "/manifest.%" PRIu64 ".%ld ) rc = %d\n",
+            rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_id, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.manifest_timestamp.tv_sec, rpc->ctx.reqdat.manifest_timestamp.tv_nsec, rc );
+      
+      *http_status = 500;
+      *http_msg = MD_HTTP_500_MSG;
+      return rc;
+   }
    
+   // serialize the manifest 
+   rc = md_serialize< Serialization::ManifestMsg >( &mmsg, &serialized_manifest, &serialized_manifest_len );
    if( rc != 0 ) {
       
-      // populate the manifest
-      rc = AG_populate_manifest( &mmsg, rpc->ctx.reqdat.fs_path, rpc->mi, rpc->pubinfo );
-      if( rc != 0 ) {
+      SG_error("Failed to serialize AG manifest %s %" PRIX64 ".%" PRId64 "/manifest.%" PRIu64 ".%ld rc = %d\n",
+            rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_id, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.manifest_timestamp.tv_sec, rpc->ctx.reqdat.manifest_timestamp.tv_nsec, rc );
+      
+      *http_status = 500;
+      *http_msg = MD_HTTP_500_MSG;
+      return rc;
+   }
+   
+   // duplicate, since we need to hand off a copy to the HTTP server 
+   http_reply = SG_CALLOC( char, serialized_manifest_len );
+   if( http_reply == NULL ) {
+      
+      SG_error("%s\n", "OOM");
+      
+      free( serialized_manifest );
+      
+      *http_status = 500;
+      *http_msg = MD_HTTP_500_MSG;
+      return -ENOMEM;
+   }
+   
+   memcpy( http_reply, serialized_manifest, serialized_manifest_len );
+   
+   *ret_manifest = http_reply;
+   *ret_manifest_len = serialized_manifest_len;
+   
+   // cache the manifest 
+   rc = AG_cache_put_manifest_async( state, rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.manifest_timestamp.tv_sec, rpc->ctx.reqdat.manifest_timestamp.tv_nsec,
+                                     serialized_manifest, serialized_manifest_len );
+   
+   if( rc != 0 ) {
+      SG_error("WARN: AG_cache_put_manifest_async( %s %" PRIX64 ".%" PRId64 "/manifest.%" PRId64 ".%ld ) rc = %d\n",
+              rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_id, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.manifest_timestamp.tv_sec, rpc->ctx.reqdat.manifest_timestamp.tv_nsec, rc );
+      
+      // Not an error, since not needed for correctness
+      free( serialized_manifest );
+   }
+   
+   return 0;
+}
+
+
+// drop a reference to an in-flight request, freeing it if we were the last.
+// g_AG_inflight_lock must be held
+static void AG_inflight_unref( struct AG_inflight* inflight ) {
+   
+   inflight->refcount--;
+   
+   if( inflight->refcount == 0 ) {
+      
+      if( inflight->buf != NULL ) {
+         free( inflight->buf );
+      }
+      
+      pthread_cond_destroy( &inflight->cv );
+      free( inflight );
+   }
+}
+
+
+// generate a block or manifest (given by key) with make(), unless another request is already generating it, in which
+// case wait for it to finish and reply with a copy of what it generated.  This way, a herd of requests for the same
+// uncached block costs one driver fetch and one signature.
+// return 0 on success, and set *buf and *len to a copy the caller owns
+// return negative on error, and set *http_status and *http_msg to the reply to send
+static int AG_make_once( struct AG_state* state, struct AG_connection_data* rpc, char const* key, AG_make_func_t make, char** buf, size_t* len, int* http_status, char const** http_msg ) {
+   
+   int rc = 0;
+   struct AG_inflight* inflight = NULL;
+   
+   pthread_mutex_lock( &g_AG_inflight_lock );
+   
+   AG_inflight_map_t::iterator itr = g_AG_inflight.find( string(key) );
+   if( itr != g_AG_inflight.end() ) {
+      
+      // someone's already on it
+      inflight = itr->second;
+      inflight->refcount++;
+      
+      while( !inflight->done ) {
+         pthread_cond_wait( &inflight->cv, &g_AG_inflight_lock );
+      }
+      
+      pthread_mutex_unlock( &g_AG_inflight_lock );
+   }
+   else {
+      
+      // we're the leader
+      inflight = SG_CALLOC( struct AG_inflight, 1 );
+      if( inflight == NULL ) {
          
-         SG_error("AG_populate_manifest( %s %" PRIX64 ".%" PRId64 "/manifest.%" PRIu64 ".%ld ) rc = %d\n",
-               rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_id, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.manifest_timestamp.tv_sec, rpc->ctx.reqdat.manifest_timestamp.tv_nsec, rc );
+         pthread_mutex_unlock( &g_AG_inflight_lock );
          
-         md_create_HTTP_response_ram_static( resp, "text/plain", 500, MD_HTTP_500_MSG, strlen(MD_HTTP_500_MSG) + 1 );
-         return resp;
+         // go it alone
+         return (*make)( state, rpc, buf, len, http_status, http_msg );
       }
       
-      // serialize the manifest 
-      rc = md_serialize< Serialization::ManifestMsg >( &mmsg, &serialized_manifest, &serialized_manifest_len );
-      if( rc != 0 ) {
+      inflight->refcount = 1;
+      pthread_cond_init( &inflight->cv, NULL );
+      
+      try {
+         g_AG_inflight[ string(key) ] = inflight;
+      }
+      catch( bad_alloc& ba ) {
+         
+         pthread_mutex_unlock( &g_AG_inflight_lock );
          
-         SG_error("Failed to serialize AG manifest %s %" PRIX64 ".%" PRId64 "/manifest.%" PRIu64 ".%ld rc = %d\n",
-               rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_id, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.manifest_timestamp.tv_sec, rpc->ctx.reqdat.manifest_timestamp.tv_nsec, rc );
+         pthread_cond_destroy( &inflight->cv );
+         free( inflight );
          
-         // clean up 
-         md_create_HTTP_response_ram_static( resp, "text/plain", 500, MD_HTTP_500_MSG, strlen(MD_HTTP_500_MSG) + 1 );
-         return resp;
+         return (*make)( state, rpc, buf, len, http_status, http_msg );
       }
       
-      // duplicate, since we need to hand off a copy to the HTTP server 
-      http_reply_len = serialized_manifest_len;
-      http_reply = SG_CALLOC( char, http_reply_len );
-      if( http_reply == NULL ) {
+      pthread_mutex_unlock( &g_AG_inflight_lock );
+      
+      rc = (*make)( state, rpc, buf, len, http_status, http_msg );
+      
+      pthread_mutex_lock( &g_AG_inflight_lock );
+      
+      // later requests can find it in the cache
+      g_AG_inflight.erase( string(key) );
+      
+      if( inflight->refcount == 1 ) {
+         
+         // no one joined us
+         AG_inflight_unref( inflight );
+         pthread_mutex_unlock( &g_AG_inflight_lock );
          
-         SG_error("%s\n", "OOM");
-         md_create_HTTP_response_ram_static( resp, "text/plain", 500, MD_HTTP_500_MSG, strlen(MD_HTTP_500_MSG) + 1 );
-         return resp;
+         return rc;
       }
       
-      memcpy( http_reply, serialized_manifest, http_reply_len );
+      SG_debug("%d requests share %s\n", inflight->refcount, key );
       
-      // cache the manifest 
-      rc = AG_cache_put_manifest_async( state, rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.manifest_timestamp.tv_sec, rpc->ctx.reqdat.manifest_timestamp.tv_nsec,
-                                        serialized_manifest, serialized_manifest_len );
+      // hand the result over, and wake everyone up
+      inflight->rc = rc;
+      inflight->http_status = *http_status;
+      inflight->http_msg = *http_msg;
+      inflight->done = true;
       
-      if( rc != 0 ) {
-         SG_error("WARN: AG_cache_put_manifest_async( %s %" PRIX64 ".%" PRId64 "/manifest.%" PRId64 ".%ld ) rc = %d\n",
-                 rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_id, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.manifest_timestamp.tv_sec, rpc->ctx.reqdat.manifest_timestamp.tv_nsec, rc );
+      if( rc == 0 ) {
+         inflight->buf = *buf;
+         inflight->len = *len;
+      }
+      
+      pthread_cond_broadcast( &inflight->cv );
+      
+      pthread_mutex_unlock( &g_AG_inflight_lock );
+   }
+   
+   // copy out the result (it won't change once done)
+   rc = inflight->rc;
+   
+   if( rc == 0 ) {
+      
+      *buf = SG_CALLOC( char, inflight->len );
+      if( *buf == NULL ) {
          
-         // Not an error, since not needed for correctness
-         rc = 0;
+         rc = -ENOMEM;
+         *http_status = 500;
+         *http_msg = MD_HTTP_500_MSG;
+      }
+      else {
+         
+         memcpy( *buf, inflight->buf, inflight->len );
+         *len = inflight->len;
       }
    }
    else {
       
-      // hit the cache!  promote 
-      rc = AG_cache_promote_manifest( state, rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.manifest_timestamp.tv_sec, rpc->ctx.reqdat.manifest_timestamp.tv_nsec );
+      *http_status = inflight->http_status;
+      *http_msg = inflight->http_msg;
+   }
+   
+   pthread_mutex_lock( &g_AG_inflight_lock );
+   
+   AG_inflight_unref( inflight );
+   
+   pthread_mutex_unlock( &g_AG_inflight_lock );
+   
+   return rc;
+}
+
+
+// serve a block from the cache, if it's there
+// return the response on hit, or NULL on miss
+static struct md_HTTP_response* AG_GET_block_from_cache( struct AG_state* state, struct AG_connection_data* rpc ) {
+   
+   int ret = 0;
+   off_t serialized_block_len = 0;
+   
+   // check cache for the signed serialized block
+   int block_fd = AG_cache_open_block( state, rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.block_id, rpc->ctx.reqdat.block_version, &serialized_block_len );
+   
+   if( block_fd < 0 ) {
+      return NULL;
+   }
+   
+   struct md_HTTP_response* resp = SG_CALLOC( struct md_HTTP_response, 1 );
+   
+   // on hit, promote 
+   ret = AG_cache_promote_block( state, rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.block_id, rpc->ctx.reqdat.block_version );
+   
+   if( ret != 0 ) {
+      SG_error("WARN: AG_cache_promote_block(%s %" PRIX64 ".%" PRId64 ".%" PRId64 ".%" PRId64 ") rc = %d\n",
+             rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_id, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.block_id, rpc->ctx.reqdat.block_version, ret );
       
-      if( rc != 0 ) {
-         SG_error("WARN: AG_cache_promote_manifest( %s %" PRIX64 ".%" PRId64 "/manifest.%" PRId64 ".%ld ) rc = %d\n",
-                 rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_id, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.manifest_timestamp.tv_sec, rpc->ctx.reqdat.manifest_timestamp.tv_nsec, rc );
-         
-         // not an error, since not required for correctness
-         rc = 0;
-      }
+      // mask this, since this isn't necessary for correctness 
+      ret = 0;
+   }
+   
+   // send it straight from the cache (MHD closes block_fd)
+   ret = md_create_HTTP_response_fd( resp, "application/octet-stream", 200, block_fd, 0, serialized_block_len );
+   if( ret != 0 ) {
       
-      http_reply = serialized_manifest;
-      http_reply_len = serialized_manifest_len;
+      SG_error("md_create_HTTP_response_fd(%s %" PRIX64 ".%" PRId64 ".%" PRId64 ".%" PRId64 ") rc = %d\n",
+             rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_id, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.block_id, rpc->ctx.reqdat.block_version, ret );
+      
+      close( block_fd );
+      
+      md_create_HTTP_response_ram_static( resp, "text/plain", 500, MD_HTTP_500_MSG, strlen(MD_HTTP_500_MSG) + 1 );
+      return resp;
+   }
+   
+   md_HTTP_add_header( resp, "Connection", "keep-alive" );
+   
+   SG_debug("Send cached block %s.%" PRIX64 ".%" PRId64 ".%" PRIu64 ".%" PRId64 "\n",
+            rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_id, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.block_id, rpc->ctx.reqdat.block_version );
+   
+   return resp;
+}
+
+
+// AG GET block handler 
+static struct md_HTTP_response* AG_GET_block_handler( struct AG_state* state, struct AG_connection_data* rpc ) {
+
+   int ret = 0;
+   struct md_HTTP_response* resp = NULL;
+   
+   char* http_reply = NULL;
+   size_t http_reply_len = 0;
+   
+   // check cache for the signed serialized block (it may have been cached since the request was queued)
+   resp = AG_GET_block_from_cache( state, rpc );
+   if( resp != NULL ) {
+      return resp;
+   }
+   
+   resp = SG_CALLOC( struct md_HTTP_response, 1 );
+   
+   // cache miss.
+   // get the block from the driver, unless someone else is already doing so
+   int http_status = 0;
+   char const* http_msg = NULL;
+   
+   char* key = SG_CALLOC( char, strlen(rpc->ctx.reqdat.fs_path) + 100 );
+   if( key == NULL ) {
+      md_create_HTTP_response_ram_static( resp, "text/plain", 500, MD_HTTP_500_MSG, strlen(MD_HTTP_500_MSG) + 1);
+      return resp;
+   }
+   
+   sprintf( key, "%s.%" PRId64 "/%" PRIu64 ".%" PRId64, rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.block_id, rpc->ctx.reqdat.block_version );
+   
+   ret = AG_make_once( state, rpc, key, AG_make_block, &http_reply, &http_reply_len, &http_status, &http_msg );
+   
+   free( key );
+   
+   if( ret != 0 ) {
+      md_create_HTTP_response_ram_static( resp, "text/plain", http_status, http_msg, strlen(http_msg) + 1 );
+      return resp;
    }
-         
    
    // send it off 
+   md_create_HTTP_response_ram_nocopy( resp, "application/octet-stream", 200, http_reply, http_reply_len );
+   md_HTTP_add_header( resp, "Connection", "keep-alive" );
+   
+   SG_debug("Send block %s.%" PRIX64 ".%" PRId64 ".%" PRIu64 ".%" PRId64 "\n",
+            rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_id, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.block_id, rpc->ctx.reqdat.block_version );
+   
+   return resp;
+}
+
+
+// serve a manifest from the cache, if it's there
+// return the response on hit, or NULL on miss
+static struct md_HTTP_response* AG_GET_manifest_from_cache( struct AG_state* state, struct AG_connection_data* rpc ) {
+   
+   int rc = 0;
+   off_t serialized_manifest_len = 0;
+   
+   // cached manifest?
+   int manifest_fd = AG_cache_open_manifest( state, rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.manifest_timestamp.tv_sec, rpc->ctx.reqdat.manifest_timestamp.tv_nsec,
+                                             &serialized_manifest_len );
+   
+   if( manifest_fd < 0 ) {
+      return NULL;
+   }
+   
+   struct md_HTTP_response* resp = SG_CALLOC( struct md_HTTP_response, 1 );
+   
+   // hit the cache!  promote 
+   rc = AG_cache_promote_manifest( state, rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.manifest_timestamp.tv_sec, rpc->ctx.reqdat.manifest_timestamp.tv_nsec );
+   
+   if( rc != 0 ) {
+      SG_error("WARN: AG_cache_promote_manifest( %s %" PRIX64 ".%" PRId64 "/manifest.%" PRId64 ".%ld ) rc = %d\n",
+              rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_id, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.manifest_timestamp.tv_sec, rpc->ctx.reqdat.manifest_timestamp.tv_nsec, rc );
+      
+      // not an error, since not required for correctness
+      rc = 0;
+   }
+   
+   // send it straight from the cache (MHD closes manifest_fd)
+   rc = md_create_HTTP_response_fd( resp, "application/octet-stream", 200, manifest_fd, 0, serialized_manifest_len );
+   if( rc != 0 ) {
+      
+      SG_error("md_create_HTTP_response_fd( %s %" PRIX64 ".%" PRId64 "/manifest.%" PRId64 ".%ld ) rc = %d\n",
+              rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_id, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.manifest_timestamp.tv_sec, rpc->ctx.reqdat.manifest_timestamp.tv_nsec, rc );
+      
+      close( manifest_fd );
+      
+      md_create_HTTP_response_ram_static( resp, "text/plain", 500, MD_HTTP_500_MSG, strlen(MD_HTTP_500_MSG) + 1 );
+      return resp;
+   }
+   
    md_HTTP_add_header( resp, "Connection", "keep-alive" );
+   
+   SG_debug("Send cached manifest %s.%" PRIX64 ".%" PRId64 "/manifest.%" PRId64 ".%ld\n",
+            rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_id, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.manifest_timestamp.tv_sec, rpc->ctx.reqdat.manifest_timestamp.tv_nsec );
+   
+   return resp;
+}
+
+
+// AG GET manifest handler 
+static struct md_HTTP_response* AG_GET_manifest_handler( struct AG_state* state, struct AG_connection_data* rpc ) {
+
+   int rc = 0;
+   struct md_HTTP_response* resp = NULL;
+   
+   char* http_reply = NULL;
+   size_t http_reply_len = 0;
+   
+   // cached manifest?  (it may have been cached since the request was queued)
+   resp = AG_GET_manifest_from_cache( state, rpc );
+   if( resp != NULL ) {
+      return resp;
+   }
+   
+   resp = SG_CALLOC( struct md_HTTP_response, 1 );
+   
+   // generate the manifest, unless someone else is already doing so
+   int http_status = 0;
+   char const* http_msg = NULL;
+   
+   char* key = SG_CALLOC( char, strlen(rpc->ctx.reqdat.fs_path) + 100 );
+   if( key == NULL ) {
+      md_create_HTTP_response_ram_static( resp, "text/plain", 500, MD_HTTP_500_MSG, strlen(MD_HTTP_500_MSG) + 1 );
+      return resp;
+   }
+   
+   sprintf( key, "%s.%" PRId64 "/manifest.%ld.%ld", rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_version, (long)rpc->ctx.reqdat.manifest_timestamp.tv_sec, (long)rpc->ctx.reqdat.manifest_timestamp.tv_nsec );
+   
+   rc = AG_make_once( state, rpc, key, AG_make_manifest, &http_reply, &http_reply_len, &http_status, &http_msg );
+   
+   free( key );
+   
+   if( rc != 0 ) {
+      md_create_HTTP_response_ram_static( resp, "text/plain", http_status, http_msg, strlen(http_msg) + 1 );
+      return resp;
+   }
+   
+   // send it off 
    md_create_HTTP_response_ram_nocopy( resp, "application/octet-stream", 200, http_reply, http_reply_len );
+   md_HTTP_add_header( resp, "Connection", "keep-alive" );
    
    SG_debug("Send manifest %s.%" PRIX64 ".%" PRId64 "/manifest.%" PRId64 ".%ld\n",
             rpc->ctx.reqdat.fs_path, rpc->ctx.reqdat.file_id, rpc->ctx.reqdat.file_version, rpc->ctx.reqdat.manifest_timestamp.tv_sec, rpc->ctx.reqdat.manifest_timestamp.tv_nsec );
@@ -790,11 +1084,45 @@ static struct md_HTTP_response* AG_GET_manifest_handler( struct AG_state* state,
 }
 
 
-// AG GET handler
+// serve a request that missed the cache, on a driver worker thread 
+static struct md_HTTP_response* AG_GET_serve( struct md_HTTP_connection_data* md_con_data ) {
+   
+   struct AG_connection_data* rpc = (struct AG_connection_data*)md_con_data->cls;
+   struct md_HTTP_response* resp = NULL;
+   
+   struct AG_state* state = AG_get_state();
+   if( state == NULL ) {
+      
+      // shutting down 
+      resp = SG_CALLOC( struct md_HTTP_response, 1 );
+      md_create_HTTP_response_ram_static( resp, "text/plain", 503, MD_HTTP_503_MSG, strlen(MD_HTTP_503_MSG) + 1);
+      return resp;
+   }
+   
+   // what kind of request?
+   if( rpc->ctx.request_type == AG_REQUEST_MANIFEST ) {
+      
+      // manifest request 
+      resp = AG_GET_manifest_handler( state, rpc );
+   }
+   else {
+      
+      // block request 
+      resp = AG_GET_block_handler( state, rpc );
+   }
+   
+   AG_release_state( state );
+   return resp;
+}
+
+
+// AG GET handler.
+// serve cache hits right away; queue everything else for the driver workers, so a slow driver doesn't tie up this thread
 static struct md_HTTP_response* AG_GET_handler( struct md_HTTP_connection_data* md_con_data ) {
    
    struct AG_connection_data* rpc = (struct AG_connection_data*)md_con_data->cls;
    struct md_HTTP_response* resp = NULL;
+   int rc = 0;
    
    // sanity check
    if( rpc == NULL ) {
@@ -819,12 +1147,35 @@ static struct md_HTTP_response* AG_GET_handler( struct md_HTTP_connection_data*
    if( rpc->ctx.request_type == AG_REQUEST_MANIFEST ) {
       
       // manifest request 
-      resp = AG_GET_manifest_handler( state, rpc );
+      resp = AG_GET_manifest_from_cache( state, rpc );
    }
    else {
       
       // block request 
-      resp = AG_GET_block_handler( state, rpc );
+      resp = AG_GET_block_from_cache( state, rpc );
+   }
+   
+   if( resp == NULL ) {
+      
+      // miss.  have a worker ask the driver, and reply when it's done
+      rc = AG_driver_pool_submit( state->driver_pool, rpc->ctx.driver, md_con_data, AG_GET_serve );
+      if( rc != 0 ) {
+         
+         SG_error("AG_driver_pool_submit(%s) rc = %d\n", md_con_data->url_path, rc );
+         
+         resp = SG_CALLOC( struct md_HTTP_response, 1 );
+         
+         if( rc == -EAGAIN || rc == -ENOTCONN ) {
+            
+            // overloaded, or shutting down 
+            md_create_HTTP_response_ram_static( resp, "text/plain", SG_HTTP_TRYAGAIN, SG_HTTP_TRYAGAIN_MSG, strlen(SG_HTTP_TRYAGAIN_MSG) + 1 );
+            md_HTTP_add_header( resp, "Retry-After", "1" );
+         }
+         else {
+            
+            md_create_HTTP_response_ram_static( resp, "text/plain", 500, MD_HTTP_500_MSG, strlen(MD_HTTP_500_MSG) + 1 );
+         }
+      }
    }
 
    AG_release_state( state );
@@ -845,7 +1196,8 @@ static void AG_cleanup( struct MHD_Connection *connection, void *user_cls, enum
 // start up server
 int AG_http_init( struct md_HTTP* http, struct md_syndicate_conf* conf ) {
    
-   md_HTTP_init( http, MHD_USE_SELECT_INTERNALLY | MHD_USE_POLL | MHD_USE_DEBUG );
+   // connections that miss the cache get suspended while a driver worker serves them 
+   md_HTTP_init( http, MHD_USE_SELECT_INTERNALLY | MHD_USE_POLL | MHD_USE_DEBUG | MHD_USE_SUSPEND_RESUME );
    md_HTTP_connect( *http, AG_HTTP_connect );
    md_HTTP_GET( *http, AG_GET_handler );
    md_HTTP_close( *http, AG_cleanup );
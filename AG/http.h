@@ -59,10 +59,29 @@ struct AG_connection_data {
    
    struct AG_connection_context ctx;      // AG connection context
    void* user_cls;                        // driver-supplied
+   bool driver_connected;                 // set once the driver's connect_dataset_block has succeeded (i.e. on the first cache miss)
    
    struct AG_driver_publish_info* pubinfo;       // if this is a manifest request, this is filled in with the results of stat_dataset()
 };
 
+// a signed block or manifest being generated on behalf of every request for it that arrives in the mean time.
+// the first request to miss the cache (the leader) generates it; the others wait for it, and reply with copies.
+struct AG_inflight {
+   int refcount;                // number of requests using this (including the leader)
+   bool done;                   // set once the leader has filled in the result
+   
+   int rc;                      // result of generating it
+   char* buf;                   // what to send on success
+   size_t len;
+   int http_status;             // what to send on error
+   char const* http_msg;
+   
+   pthread_cond_t cv;           // signaled when done
+};
+
+// map "path.file_version/block_id.block_version" (or "path.file_version/manifest.sec.nsec") to the request generating it
+typedef map<string, struct AG_inflight*> AG_inflight_map_t;
+
 int AG_http_init( struct md_HTTP* http, struct md_syndicate_conf* conf );
 
 #define AG_IS_MANIFEST_REQUEST( agctx ) ((agctx).reqdat.manifest_timestamp.tv_sec > 0)
@@ -203,52 +203,175 @@ int AG_fs_map_dup( AG_fs_map_t* dest, AG_fs_map_t* src ) {
 // NOTE: to_publish, to_update, and to_delete SHOULD NOT BE FREED.
 int AG_fs_map_transforms( AG_fs_map_t* old_fs, AG_fs_map_t* new_fs, AG_fs_map_t* to_publish, AG_fs_map_t* to_remain, AG_fs_map_t* to_update, AG_fs_map_t* to_delete, AG_map_info_equality_func_t mi_equ ) {
    
-   set<string> intersection;
+   // both maps are sorted by path, so walk them together.
+   // each output map is filled in order, so we can insert at its end.
+   AG_fs_map_t::iterator old_itr = old_fs->begin();
+   AG_fs_map_t::iterator new_itr = new_fs->begin();
    
-   for( AG_fs_map_t::iterator itr = old_fs->begin(); itr != old_fs->end(); itr++ ) {
+   while( old_itr != old_fs->end() || new_itr != new_fs->end() ) {
       
-      const string& old_path = itr->first;
-      struct AG_map_info* old_mi = itr->second;
+      int cmp = 0;
+      
+      if( old_itr == old_fs->end() ) {
+         cmp = 1;
+      }
+      else if( new_itr == new_fs->end() ) {
+         cmp = -1;
+      }
+      else {
+         cmp = AG_path_compare( old_itr->first, new_itr->first );
+      }
       
-      // is this entry in new_fs?
-      AG_fs_map_t::iterator new_itr = new_fs->find( old_path );
-      if( new_itr == new_fs->end() ) {
+      if( cmp < 0 ) {
          
          // this old entry is not in the new fs.  We should delete it.
-         (*to_delete)[ old_path ] = old_mi;
+         to_delete->insert( to_delete->end(), AG_fs_map_t::value_type( old_itr->first, old_itr->second ) );
+         old_itr++;
+      }
+      else if( cmp > 0 ) {
+         
+         // should publish this, since it's not in old_fs
+         to_publish->insert( to_publish->end(), AG_fs_map_t::value_type( new_itr->first, new_itr->second ) );
+         new_itr++;
       }
       else {
          
          // this old entry is also in the new fs.
-         if( !(*mi_equ)( old_mi, new_itr->second ) ) {
-            (*to_update)[ old_path ] = new_itr->second;
+         if( !(*mi_equ)( old_itr->second, new_itr->second ) ) {
+            to_update->insert( to_update->end(), AG_fs_map_t::value_type( new_itr->first, new_itr->second ) );
          }
          else {
-            (*to_remain)[ old_path ] = new_itr->second;
+            to_remain->insert( to_remain->end(), AG_fs_map_t::value_type( new_itr->first, new_itr->second ) );
          }
          
-         // track intersection between old_fs and new_fs
-         intersection.insert( old_path );
+         old_itr++;
+         new_itr++;
       }
    }
    
-   // find the entries in new_fs that are not in old_fs 
-   for( AG_fs_map_t::iterator itr = new_fs->begin(); itr != new_fs->end(); itr++ ) {
+   return 0;
+}
+
+
+// given fs_map and the results of a partial spec file reload (see AG_parse_spec_changes)--the entries for the new and changed Pairs
+// (changed) and the paths of the Pairs that are gone (removed, sorted by AG_path_less)--find the set of operations needed to apply the reload.
+// entries in changed that replace ones in fs_map get their cached MS, driver, and AG data.
+// to_publish, to_remain, and to_update will contain pointers to map_infos in changed (as in AG_fs_map_transforms)
+// to_delete will contain pointers to map_infos in fs_map that were removed and not replaced
+// fs_map must be read-locked
+// return 0 on success
+// return -ESTALE if a changed entry replaces one that no removed Pair mapped (i.e. another Pair maps it too, or it was published at runtime),
+// in which case only a full reload can tell which one wins.
+int AG_fs_map_changes( AG_fs_map_t* fs_map, AG_fs_map_t* changed, vector<string>* removed, AG_fs_map_t* to_publish, AG_fs_map_t* to_remain, AG_fs_map_t* to_update, AG_fs_map_t* to_delete, AG_map_info_equality_func_t mi_equ ) {
+   
+   // changed and removed are both sorted by path, so walk them together
+   AG_fs_map_t::iterator changed_itr = changed->begin();
+   vector<string>::iterator removed_itr = removed->begin();
+   
+   while( changed_itr != changed->end() || removed_itr != removed->end() ) {
       
-      const string& new_path = itr->first;
-      struct AG_map_info* new_mi = itr->second;
+      int cmp = 0;
       
-      // is this entry in old_fs?
-      if( intersection.count( new_path ) > 0 ) {
-         // already accounted for 
+      if( changed_itr == changed->end() ) {
+         cmp = 1;
+      }
+      else if( removed_itr == removed->end() ) {
+         cmp = -1;
+      }
+      else {
+         cmp = AG_path_compare( changed_itr->first, *removed_itr );
+      }
+      
+      if( cmp > 0 ) {
+         
+         // removed, and not replaced
+         AG_fs_map_t::iterator itr = fs_map->find( *removed_itr );
+         if( itr != fs_map->end() ) {
+            to_delete->insert( to_delete->end(), AG_fs_map_t::value_type( itr->first, itr->second ) );
+         }
+         
+         removed_itr++;
          continue;
       }
+      
+      struct AG_map_info* new_mi = changed_itr->second;
+      
+      AG_fs_map_t::iterator itr = fs_map->find( changed_itr->first );
+      if( itr == fs_map->end() ) {
+         
+         // new 
+         to_publish->insert( to_publish->end(), AG_fs_map_t::value_type( changed_itr->first, new_mi ) );
+      }
+      else if( cmp < 0 ) {
+         
+         // this path is still mapped by something else 
+         SG_debug("%s is mapped by a Pair that did not change\n", changed_itr->first.c_str() );
+         return -ESTALE;
+      }
       else {
-         // should publish this, since it's not in old_fs
-         (*to_publish)[ new_path ] = new_mi;
+         
+         // replaced.  Keep what we know about it.
+         struct AG_map_info* old_mi = itr->second;
+         
+         AG_map_info_copy_MS_data( new_mi, old_mi );
+         AG_map_info_copy_driver_data( new_mi, old_mi );
+         AG_map_info_copy_AG_data( new_mi, old_mi );
+         
+         if( !(*mi_equ)( old_mi, new_mi ) ) {
+            to_update->insert( to_update->end(), AG_fs_map_t::value_type( changed_itr->first, new_mi ) );
+         }
+         else {
+            to_remain->insert( to_remain->end(), AG_fs_map_t::value_type( changed_itr->first, new_mi ) );
+         }
+      }
+      
+      if( cmp == 0 ) {
+         removed_itr++;
+      }
+      
+      changed_itr++;
+   }
+   
+   return 0;
+}
+
+
+// apply a partial reload to fs_map: remove the entries in to_delete, and put in the ones in changed, replacing (and freeing) the entries they replace.
+// to_delete's entries are looked up again by path, so they need not be valid anymore.
+// fs_map takes ownership of changed's map_infos; changed will be empty afterwards.
+// fs_map must be write-locked
+// always succeeds
+int AG_fs_map_apply_changes( AG_fs_map_t* fs_map, AG_fs_map_t* changed, AG_fs_map_t* to_delete ) {
+   
+   for( AG_fs_map_t::iterator itr = to_delete->begin(); itr != to_delete->end(); itr++ ) {
+      
+      AG_fs_map_t::iterator found = fs_map->find( itr->first );
+      if( found != fs_map->end() ) {
+         
+         AG_map_info_free( found->second );
+         free( found->second );
+         
+         fs_map->erase( found );
+      }
+   }
+   
+   for( AG_fs_map_t::iterator itr = changed->begin(); itr != changed->end(); itr++ ) {
+      
+      AG_fs_map_t::iterator found = fs_map->find( itr->first );
+      if( found != fs_map->end() ) {
+         
+         AG_map_info_free( found->second );
+         free( found->second );
+         
+         fs_map->assign( found, itr->second );
+      }
+      else {
+         (*fs_map)[ itr->first ] = itr->second;
       }
    }
    
+   changed->clear();
+   
    return 0;
 }
 
@@ -473,6 +596,102 @@ int AG_validate_map_info( AG_fs_map_t* fs ) {
 }
 
 
+// does fs have any entries below dir_path, other than the ones in excluded?
+static bool AG_fs_map_has_children( AG_fs_map_t* fs, string const& dir_path, AG_fs_map_t* excluded ) {
+   
+   // descendants sort together, right after the directory
+   AG_fs_map_t::iterator dir_itr = fs->find( dir_path );
+   AG_fs_map_t::iterator end = fs->subtree_end( dir_path );
+   
+   for( AG_fs_map_t::iterator itr = fs->lower_bound( dir_path ); itr != end; itr++ ) {
+      
+      if( itr != dir_itr && excluded->count( itr->first ) == 0 ) {
+         return true;
+      }
+   }
+   
+   return false;
+}
+
+// verify that fs stays structurally sound (see AG_validate_map_info) once to_delete is removed from it and changed is put into it.
+// fs is assumed to be sound already, so only the changes are checked:
+// * every ancestor of a changed entry must be a directory, in changed or left in fs
+// * a directory in fs that's deleted or turned into a file can't have children left
+// fs must be read-locked
+int AG_validate_map_info_changes( AG_fs_map_t* fs, AG_fs_map_t* changed, AG_fs_map_t* to_delete ) {
+   
+   int rc = 0;
+   
+   for( AG_fs_map_t::iterator itr = changed->begin(); itr != changed->end(); itr++ ) {
+      
+      char** ancestors = NULL;
+      AG_path_prefixes( itr->first.c_str(), &ancestors );
+      
+      // each ancestor (but the path itself) must be a directory 
+      for( unsigned int j = 0; ancestors[j] != NULL && ancestors[j+1] != NULL; j++ ) {
+         
+         string ancestor( ancestors[j] );
+         struct AG_map_info* mi = NULL;
+         
+         AG_fs_map_t::iterator found = changed->find( ancestor );
+         if( found != changed->end() ) {
+            mi = found->second;
+         }
+         else if( to_delete->count( ancestor ) == 0 ) {
+            
+            found = fs->find( ancestor );
+            if( found != fs->end() ) {
+               mi = found->second;
+            }
+         }
+         
+         if( mi == NULL ) {
+            // missing!
+            SG_error("ERR: Missing %s (ancestor of %s)\n", ancestors[j], itr->first.c_str() );
+            rc = -ENOENT;
+            break;
+         }
+         
+         if( mi->type != MD_ENTRY_DIR ) {
+            // not a directory 
+            SG_error("ERR: not a directory: %s (ancestor of %s)\n", ancestors[j], itr->first.c_str() );
+            rc = -ENOTDIR;
+            break;
+         }
+      }
+      
+      SG_FREE_LIST( ancestors, free );
+      
+      if( rc != 0 ) {
+         return rc;
+      }
+      
+      // a directory turned into a file can't keep its children
+      if( itr->second->type != MD_ENTRY_DIR ) {
+         
+         AG_fs_map_t::iterator found = fs->find( itr->first );
+         if( found != fs->end() && found->second->type == MD_ENTRY_DIR && AG_fs_map_has_children( fs, itr->first, to_delete ) ) {
+            
+            SG_error("ERR: not a directory: %s (has children)\n", itr->first.c_str() );
+            return -ENOTDIR;
+         }
+      }
+   }
+   
+   // a deleted directory can't keep its children 
+   for( AG_fs_map_t::iterator itr = to_delete->begin(); itr != to_delete->end(); itr++ ) {
+      
+      if( itr->second->type == MD_ENTRY_DIR && AG_fs_map_has_children( fs, itr->first, to_delete ) ) {
+         
+         SG_error("ERR: Missing %s (ancestor of remaining entries)\n", itr->first.c_str() );
+         return -ENOENT;
+      }
+   }
+   
+   return 0;
+}
+
+
 // given a path and map_info, get its pubinfo.
 // check the cache first, and use the driver to get the pubinfo on cache miss.  cache the result.
 // if mi is not coherent, then this method will skip the cache and poll the pubinfo from the driver.
@@ -818,7 +1037,7 @@ int AG_fs_map_merge_tree( AG_fs_map_t* fs_map, AG_fs_map_t* path_data, bool merg
          AG_map_info_merge( old_info, info );
          
          // consumed!
-         itr->second = NULL;
+         path_data->assign( itr, NULL );
          
          if( old_info != info ) {
             AG_map_info_free( info );
@@ -897,15 +1116,21 @@ int AG_map_info_copy_AG_data( struct AG_map_info* dest, struct AG_map_info* src
 // dest must be write-locked
 int AG_fs_copy_cached_data( struct AG_fs* dest, struct AG_fs* src, int (*copy)( struct AG_map_info* dest, struct AG_map_info* src ) ) {
    
-   for( AG_fs_map_t::iterator itr = src->fs->begin(); itr != src->fs->end(); itr++ ) {
+   // both maps are sorted by path, so walk them together
+   AG_fs_map_t::iterator dest_itr = dest->fs->begin();
+   
+   for( AG_fs_map_t::iterator itr = src->fs->begin(); itr != src->fs->end() && dest_itr != dest->fs->end(); itr++ ) {
       
       const string& path_string = itr->first;
       struct AG_map_info* info = itr->second;
       int rc = 0;
       
       // find the matching dest 
-      AG_fs_map_t::iterator dest_itr = dest->fs->find( path_string );
-      if( dest_itr == dest->fs->end() ) {
+      while( dest_itr != dest->fs->end() && AG_path_compare( dest_itr->first, path_string ) < 0 ) {
+         dest_itr++;
+      }
+      
+      if( dest_itr == dest->fs->end() || dest_itr->first != path_string ) {
          continue;
       }
       
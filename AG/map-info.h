@@ -122,9 +122,12 @@ int AG_invalidate_metadata_all( AG_fs_map_t* fs_map, int (*invalidator)( struct
 
 // validation 
 int AG_validate_map_info( AG_fs_map_t* fs );
+int AG_validate_map_info_changes( AG_fs_map_t* fs, AG_fs_map_t* changed, AG_fs_map_t* to_delete );
 
 // tree operations
 int AG_fs_map_transforms( AG_fs_map_t* old_fs, AG_fs_map_t* new_fs, AG_fs_map_t* to_publish, AG_fs_map_t* to_fresh, AG_fs_map_t* to_update, AG_fs_map_t* to_delete, AG_map_info_equality_func_t mi_equ );
+int AG_fs_map_changes( AG_fs_map_t* fs_map, AG_fs_map_t* changed, vector<string>* removed, AG_fs_map_t* to_publish, AG_fs_map_t* to_remain, AG_fs_map_t* to_update, AG_fs_map_t* to_delete, AG_map_info_equality_func_t mi_equ );
+int AG_fs_map_apply_changes( AG_fs_map_t* fs_map, AG_fs_map_t* changed, AG_fs_map_t* to_delete );
 int AG_fs_map_clone_path( AG_fs_map_t* fs_map, char const* path, AG_fs_map_t* path_data );
 int AG_fs_map_merge_tree( AG_fs_map_t* fs_map, AG_fs_map_t* path_data, bool merge_new, AG_fs_map_t* not_merged );
 int AG_fs_map_delete_tree( AG_fs_map_t* fs_map, AG_fs_map_t* to_delete );
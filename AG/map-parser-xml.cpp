@@ -67,6 +67,7 @@ AG_XMLMapParserHandler::AG_XMLMapParserHandler( struct AG_state* state )
    this->reset_element_parse_state( -1 );
    
    this->num_pairs_parsed = 0;
+   this->pair_paths = NULL;
    this->state = state;
 }
 
@@ -570,6 +571,10 @@ void AG_XMLMapParserHandler::endElement( const   XMLCh *const    uri,
          // convert path to string 
          string path_s( this->file_path );
          
+         if( this->pair_paths != NULL ) {
+            this->pair_paths->push_back( path_s );
+         }
+         
          // look for dups 
          if( this->xmlmap->count( path_s ) > 0 ) {
             SG_error("WARN: ignoring duplicate entry for %s in %s\n", this->file_path, qname_str );
@@ -749,8 +754,10 @@ int64_t AG_XMLMapParserHandler::parse_time(char *tm_str) {
    return secs;
 }
 
-// parse a spec_file (as text) into a new map and config
-int AG_parse_spec( struct AG_state* state, char const* spec_file_text, size_t spec_file_text_len, AG_fs_map_t** new_map, AG_config_t** new_config )
+// parse a spec file (as text) into a new map and config.
+// if pair_paths is not NULL, it gets the path of each Pair parsed, in document order.
+// the map may be empty.
+static int AG_parse_spec_text( struct AG_state* state, char const* spec_file_text, size_t spec_file_text_len, AG_fs_map_t** new_map, AG_config_t** new_config, vector<string>* pair_paths )
 {
    try {
       XMLPlatformUtils::Initialize();
@@ -771,6 +778,8 @@ int AG_parse_spec( struct AG_state* state, char const* spec_file_text, size_t sp
    
    AG_XMLMapParserHandler* mph = new AG_XMLMapParserHandler( state );
    
+   mph->pair_paths = pair_paths;
+   
    parser->setContentHandler(mph);
    parser->setErrorHandler(mph);
    
@@ -808,24 +817,625 @@ int AG_parse_spec( struct AG_state* state, char const* spec_file_text, size_t sp
       return -EINVAL;
    }
    
-   AG_fs_map_t* m = mph->extract_map();
+   // extract the map and config 
+   *new_map = mph->extract_map();
+   *new_config = mph->extract_config();
+   
+   delete parser;
+   delete mph;
+   
+   return 0;
+}
+
+
+// parse a spec_file (as text) into a new map and config
+int AG_parse_spec( struct AG_state* state, char const* spec_file_text, size_t spec_file_text_len, AG_fs_map_t** new_map, AG_config_t** new_config )
+{
+   AG_fs_map_t* m = NULL;
+   AG_config_t* config = NULL;
+   
+   int rc = AG_parse_spec_text( state, spec_file_text, spec_file_text_len, &m, &config, NULL );
+   if( rc != 0 ) {
+      return rc;
+   }
+   
    if( m->size() == 0 ) {
       // invalid--we didn't parse anything
       SG_error("ERR: empty spec file text (size = %zu)\n", spec_file_text_len );
       
       delete m;
+      delete config;
+      return -EINVAL;
+   }
+   
+   *new_map = m;
+   *new_config = config;
+   
+   return 0;
+}
+
+
+#define AG_SPEC_HASH_INIT       0xcbf29ce484222325ULL
+#define AG_SPEC_HASH_PRIME      0x9e3779b97f4a7c15ULL
+
+// continue a 64-bit multiply-xorshift hash over len bytes of text, a word at a time.
+// spec files can be tens of megabytes, and we hash each one a few times per reload.
+static uint64_t AG_spec_hash( uint64_t hash, char const* text, size_t len ) {
+   
+   size_t i = 0;
+   uint64_t word = 0;
+   
+   for( i = 0; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t) ) {
       
-      delete parser;
-      delete mph;
+      memcpy( &word, text + i, sizeof(uint64_t) );
+      
+      hash = (hash ^ word) * AG_SPEC_HASH_PRIME;
+      hash ^= (hash >> 29);
+   }
+   
+   for( ; i < len; i++ ) {
+      
+      hash = (hash ^ (unsigned char)text[i]) * AG_SPEC_HASH_PRIME;
+      hash ^= (hash >> 29);
+   }
+   
+   return hash ^ len;
+}
+
+// a Config or Pair element in a spec file's text
+struct AG_spec_section {
+   size_t start;
+   size_t len;
+   uint64_t hash;
+};
+
+typedef vector<struct AG_spec_section> AG_spec_section_list_t;
+
+// does an element with the given tag name start at text[i]?
+static bool AG_spec_tag_at( char const* text, size_t len, size_t i, char const* tag ) {
+   
+   size_t tag_len = strlen(tag);
+   
+   if( text[i] != '<' || i + 1 + tag_len >= len || strncmp( text + i + 1, tag, tag_len ) != 0 ) {
+      return false;
+   }
+   
+   char c = text[i + 1 + tag_len];
+   return (c == '>' || c == '/' || isspace(c));
+}
+
+// find where the element that starts at text[i] ends (just past its close tag)
+// return 0 on success, and set *end
+// return -ENOTSUP if there's a comment, CDATA, or a DTD in it
+// return -EINVAL if it isn't closed
+static int AG_spec_element_end( char const* text, size_t len, size_t i, char const* close_tag, size_t* end ) {
+   
+   size_t close_tag_len = strlen(close_tag);
+   
+   char const* gt = (char const*)memchr( text + i, '>', len - i );
+   if( gt == NULL ) {
+      return -EINVAL;
+   }
+   
+   if( *(gt - 1) == '/' ) {
+      // empty element 
+      *end = gt - text + 1;
+      return 0;
+   }
+   
+   char const* text_end = text + len;
+   char const* lt = (char const*)memchr( gt, '<', text_end - gt );
+   
+   while( lt != NULL && lt + 1 < text_end ) {
+      
+      if( lt[1] == '!' ) {
+         return -ENOTSUP;
+      }
+      
+      if( lt + close_tag_len <= text_end && strncmp( lt, close_tag, close_tag_len ) == 0 ) {
+         
+         *end = lt - text + close_tag_len;
+         return 0;
+      }
+      
+      lt = (char const*)memchr( lt + 1, '<', text_end - lt - 1 );
+   }
+   
+   return -EINVAL;
+}
+
+// split a spec file's text into its Config element and its Pair elements, and hash each one.
+// everything else (the skeleton) is hashed, less whitespace, into *skeleton_hash.
+// *prefix_len is how much text comes before the first element, and *suffix_start is where the text after the last one starts.
+// return 0 on success
+// return -ENOTSUP if the text has comments, CDATA or a DTD (which can hide or invent tags), more than one Config, or no Pairs
+// return -EINVAL if an element isn't closed
+static int AG_spec_split( char const* text, size_t len, struct AG_spec_section* config, AG_spec_section_list_t* pairs, uint64_t* skeleton_hash, size_t* prefix_len, size_t* suffix_start ) {
+   
+   uint64_t skeleton = AG_SPEC_HASH_INIT;
+   bool have_config = false;
+   bool have_section = false;
+   
+   config->start = 0;
+   config->len = 0;
+   config->hash = AG_SPEC_HASH_INIT;
+   
+   *prefix_len = len;
+   *suffix_start = len;
+   
+   size_t i = 0;
+   while( i < len ) {
+      
+      // skip to the next tag
+      char const* lt = (char const*)memchr( text + i, '<', len - i );
+      size_t next = (lt != NULL ? lt - text : len);
+      
+      for( ; i < next; i++ ) {
+         
+         if( !isspace( text[i] ) ) {
+            skeleton = AG_spec_hash( skeleton, text + i, 1 );
+         }
+      }
+      
+      if( i >= len ) {
+         break;
+      }
+      
+      if( i + 1 < len && text[i + 1] == '!' ) {
+         // comments, CDATA, and DTDs all start with "<!"
+         return -ENOTSUP;
+      }
+      
+      bool is_pair = AG_spec_tag_at( text, len, i, AG_TAG_PAIR_NAME );
+      bool is_config = !is_pair && AG_spec_tag_at( text, len, i, AG_TAG_CONFIG_NAME );
+      
+      if( !is_pair && !is_config ) {
+         
+         skeleton = AG_spec_hash( skeleton, text + i, 1 );
+         i++;
+         continue;
+      }
+      
+      // find the end of the element 
+      size_t end = 0;
+      
+      int rc = AG_spec_element_end( text, len, i, (is_pair ? "</" AG_TAG_PAIR_NAME ">" : "</" AG_TAG_CONFIG_NAME ">"), &end );
+      if( rc != 0 ) {
+         return rc;
+      }
+      
+      struct AG_spec_section section;
+      section.start = i;
+      section.len = end - i;
+      section.hash = AG_spec_hash( AG_SPEC_HASH_INIT, text + i, end - i );
+      
+      if( is_pair ) {
+         pairs->push_back( section );
+      }
+      else {
+         
+         if( have_config ) {
+            return -ENOTSUP;
+         }
+         
+         *config = section;
+         have_config = true;
+      }
+      
+      if( !have_section ) {
+         *prefix_len = i;
+         have_section = true;
+      }
+      
+      *suffix_start = end;
+      i = end;
+   }
+   
+   if( pairs->size() == 0 ) {
+      return -ENOTSUP;
+   }
+   
+   *skeleton_hash = skeleton;
+   return 0;
+}
+
+
+static bool AG_spec_pair_hash_less( struct AG_spec_pair_hash const& p1, struct AG_spec_pair_hash const& p2 ) {
+   return p1.hash < p2.hash;
+}
+
+// a Pair in the new text, while we match it to the old snapshot
+struct AG_spec_pair_order {
+   uint64_t hash;
+   size_t section;                      // index in the text's Pairs
+   ssize_t old_idx;                     // index in the old snapshot's Pairs, or -1 if it's new
+};
+
+static bool AG_spec_pair_order_less( struct AG_spec_pair_order const& p1, struct AG_spec_pair_order const& p2 ) {
+   return p1.hash < p2.hash;
+}
+
+// do any two Pairs have the same text?
+// pairs must be sorted by hash
+static bool AG_spec_pair_hash_has_dups( AG_spec_pair_hash_list_t* pairs ) {
+   
+   for( size_t i = 1; i < pairs->size(); i++ ) {
+      
+      if( pairs->at(i - 1).hash == pairs->at(i).hash ) {
+         return true;
+      }
+   }
+   
+   return false;
+}
+
+// make a snapshot from the split-up text, and the path of each Pair (in document order)
+// return NULL if OOM
+static struct AG_spec_snapshot* AG_spec_snapshot_new( uint64_t text_hash, uint64_t skeleton_hash, uint64_t config_hash, AG_spec_section_list_t* pairs, vector<string>* pair_paths ) {
+   
+   struct AG_spec_snapshot* snapshot = SG_CALLOC( struct AG_spec_snapshot, 1 );
+   if( snapshot == NULL ) {
+      return NULL;
+   }
+   
+   snapshot->pairs = new (nothrow) AG_spec_pair_hash_list_t();
+   if( snapshot->pairs == NULL ) {
+      
+      free( snapshot );
+      return NULL;
+   }
+   
+   snapshot->text_hash = text_hash;
+   snapshot->skeleton_hash = skeleton_hash;
+   snapshot->config_hash = config_hash;
+   
+   try {
+      
+      snapshot->pairs->reserve( pairs->size() );
+      
+      for( size_t i = 0; i < pairs->size(); i++ ) {
+         
+         struct AG_spec_pair_hash pair_hash;
+         pair_hash.hash = pairs->at(i).hash;
+         pair_hash.path = pair_paths->at(i);
+         
+         snapshot->pairs->push_back( pair_hash );
+      }
+   }
+   catch( bad_alloc& ba ) {
+      
+      AG_spec_snapshot_free( snapshot );
+      return NULL;
+   }
+   
+   sort( snapshot->pairs->begin(), snapshot->pairs->end(), AG_spec_pair_hash_less );
+   
+   return snapshot;
+}
+
+
+// parse a spec file (as text) into a new map and config, like AG_parse_spec, and snapshot the text so the next reload can be incremental (see AG_parse_spec_changes).
+// *new_snapshot is NULL if the text can't be reloaded incrementally (i.e. it has comments, or duplicate entries); it still parses.
+// return 0 on success
+// return -EINVAL if the text couldn't be parsed
+int AG_parse_spec_snapshot( struct AG_state* state, char const* spec_file_text, size_t spec_file_text_len, AG_fs_map_t** new_map, AG_config_t** new_config, struct AG_spec_snapshot** new_snapshot ) {
+   
+   vector<string> pair_paths;
+   AG_spec_section_list_t pairs;
+   struct AG_spec_section config_section;
+   uint64_t skeleton_hash = 0;
+   size_t prefix_len = 0;
+   size_t suffix_start = 0;
+   
+   AG_fs_map_t* m = NULL;
+   AG_config_t* config = NULL;
+   
+   *new_snapshot = NULL;
+   
+   int rc = AG_parse_spec_text( state, spec_file_text, spec_file_text_len, &m, &config, &pair_paths );
+   if( rc != 0 ) {
+      return rc;
+   }
+   
+   if( m->size() == 0 ) {
+      // invalid--we didn't parse anything
+      SG_error("ERR: empty spec file text (size = %zu)\n", spec_file_text_len );
+      
+      delete m;
+      delete config;
       return -EINVAL;
    }
    
-   // extract the map and config 
    *new_map = m;
-   *new_config = mph->extract_config();
+   *new_config = config;
    
-   delete parser;
-   delete mph;
+   rc = AG_spec_split( spec_file_text, spec_file_text_len, &config_section, &pairs, &skeleton_hash, &prefix_len, &suffix_start );
+   if( rc != 0 ) {
+      
+      SG_debug("Spec file can't be reloaded incrementally (AG_spec_split rc = %d)\n", rc );
+      return 0;
+   }
+   
+   if( pairs.size() != pair_paths.size() || m->size() != pair_paths.size() ) {
+      
+      // either we didn't find the Pairs the parser did, or some of them map the same path (in which case which one wins is up to document order)
+      SG_debug("Spec file can't be reloaded incrementally (%zu Pairs found, %zu parsed, %zu entries)\n", pairs.size(), pair_paths.size(), m->size() );
+      return 0;
+   }
+   
+   *new_snapshot = AG_spec_snapshot_new( AG_spec_hash( AG_SPEC_HASH_INIT, spec_file_text, spec_file_text_len ), skeleton_hash, config_section.hash, &pairs, &pair_paths );
+   if( *new_snapshot == NULL ) {
+      SG_error("%s", "Out of memory; spec file can't be reloaded incrementally\n");
+   }
+   
+   if( *new_snapshot != NULL && AG_spec_pair_hash_has_dups( (*new_snapshot)->pairs ) ) {
+      
+      // can't tell identical Pairs apart
+      SG_debug("%s", "Spec file can't be reloaded incrementally (identical Pairs)\n");
+      
+      AG_spec_snapshot_free( *new_snapshot );
+      *new_snapshot = NULL;
+   }
+   
+   return 0;
+}
+
+
+// is the spec file text the same as it was when we snapshotted it?
+bool AG_spec_snapshot_matches( struct AG_spec_snapshot* snapshot, char const* spec_file_text, size_t spec_file_text_len ) {
+   
+   return (snapshot != NULL && snapshot->text_hash == AG_spec_hash( AG_SPEC_HASH_INIT, spec_file_text, spec_file_text_len ));
+}
+
+
+// find what changed in a spec file since old_snapshot was taken, and parse only that.
+// The text is split into its Config and Pair elements, each of which is hashed; only the ones whose hashes aren't in old_snapshot get parsed.
+// On success:
+// * *changed_map holds the entries for the new and changed Pairs (it may be empty).
+// * *new_config is the new config, or NULL if the Config element didn't change.
+// * removed_paths gets the paths of the old snapshot's Pairs that are gone from the text (sorted by AG_path_less).  A path can be both removed and changed (i.e. its Pair was edited).
+// * *new_snapshot is the snapshot of the new text.
+// return 0 on success
+// return -ESTALE if the spec file needs a full reload instead: there's no old snapshot, the text outside the Config and Pairs changed, or Pairs are duplicated
+// return -EINVAL if the changed Pairs couldn't be parsed
+// return -ENOMEM if OOM
+int AG_parse_spec_changes( struct AG_state* state, char const* spec_file_text, size_t spec_file_text_len, struct AG_spec_snapshot* old_snapshot,
+                           AG_fs_map_t** changed_map, AG_config_t** new_config, vector<string>* removed_paths, struct AG_spec_snapshot** new_snapshot ) {
+   
+   AG_spec_section_list_t pairs;
+   struct AG_spec_section config_section;
+   uint64_t skeleton_hash = 0;
+   size_t prefix_len = 0;
+   size_t suffix_start = 0;
+   int rc = 0;
+   
+   if( old_snapshot == NULL ) {
+      return -ESTALE;
+   }
+   
+   rc = AG_spec_split( spec_file_text, spec_file_text_len, &config_section, &pairs, &skeleton_hash, &prefix_len, &suffix_start );
+   if( rc != 0 ) {
+      
+      SG_debug("AG_spec_split rc = %d\n", rc );
+      return -ESTALE;
+   }
+   
+   if( skeleton_hash != old_snapshot->skeleton_hash ) {
+      
+      SG_debug("%s", "Spec file structure changed\n");
+      return -ESTALE;
+   }
+   
+   bool config_changed = (config_section.hash != old_snapshot->config_hash);
+   
+   // match the new Pairs to the old ones by hash.
+   // order is sorted the same way as the snapshot, so this is a merge.
+   AG_spec_pair_hash_list_t* old_pairs = old_snapshot->pairs;
+   vector<struct AG_spec_pair_order> order;
+   vector<size_t> changed;                      // indexes into pairs of the Pairs we have to parse
+   vector<bool> old_matched;
+   vector<string> pair_paths;
+   
+   try {
+      
+      order.resize( pairs.size() );
+      old_matched.resize( old_pairs->size(), false );
+      
+      for( size_t i = 0; i < pairs.size(); i++ ) {
+         
+         order[i].hash = pairs[i].hash;
+         order[i].section = i;
+         order[i].old_idx = -1;
+      }
+      
+      sort( order.begin(), order.end(), AG_spec_pair_order_less );
+      
+      for( size_t i = 1; i < order.size(); i++ ) {
+         
+         if( order[i - 1].hash == order[i].hash ) {
+            
+            // can't tell identical Pairs apart
+            SG_debug("%s", "Spec file has identical Pairs\n");
+            return -ESTALE;
+         }
+      }
+      
+      size_t j = 0;
+      for( size_t i = 0; i < order.size(); i++ ) {
+         
+         while( j < old_pairs->size() && old_pairs->at(j).hash < order[i].hash ) {
+            j++;
+         }
+         
+         if( j < old_pairs->size() && old_pairs->at(j).hash == order[i].hash ) {
+            
+            // unchanged 
+            order[i].old_idx = j;
+            old_matched[j] = true;
+         }
+         else {
+            changed.push_back( order[i].section );
+         }
+      }
+      
+      for( size_t j = 0; j < old_pairs->size(); j++ ) {
+         
+         if( !old_matched[j] ) {
+            removed_paths->push_back( old_pairs->at(j).path );
+         }
+      }
+      
+      sort( removed_paths->begin(), removed_paths->end(), AG_path_less );
+      
+      // parse changed Pairs in document order 
+      sort( changed.begin(), changed.end() );
+   }
+   catch( bad_alloc& ba ) {
+      return -ENOMEM;
+   }
+   
+   AG_fs_map_t* m = NULL;
+   AG_config_t* config = NULL;
+   
+   if( changed.size() > 0 || config_changed ) {
+      
+      // make a document out of the text around the elements, and the elements that changed 
+      string partial_text;
+      
+      try {
+         
+         partial_text.append( spec_file_text, prefix_len );
+         
+         if( config_changed ) {
+            partial_text.append( spec_file_text + config_section.start, config_section.len );
+         }
+         
+         for( size_t i = 0; i < changed.size(); i++ ) {
+            
+            partial_text.append( "\n" );
+            partial_text.append( spec_file_text + pairs[ changed[i] ].start, pairs[ changed[i] ].len );
+         }
+         
+         partial_text.append( spec_file_text + suffix_start, spec_file_text_len - suffix_start );
+      }
+      catch( bad_alloc& ba ) {
+         return -ENOMEM;
+      }
+      
+      rc = AG_parse_spec_text( state, partial_text.data(), partial_text.size(), &m, &config, &pair_paths );
+      if( rc != 0 ) {
+         
+         SG_error("AG_parse_spec_text(%zu changed Pairs) rc = %d\n", changed.size(), rc );
+         return rc;
+      }
+      
+      if( pair_paths.size() != changed.size() || m->size() != changed.size() ) {
+         
+         // the changed Pairs didn't parse one-to-one into entries
+         SG_debug("%zu changed Pairs parsed into %zu Pairs, %zu entries\n", changed.size(), pair_paths.size(), m->size() );
+         
+         AG_fs_map_free( m );
+         delete m;
+         delete config;
+         return -ESTALE;
+      }
+   }
+   else {
+      
+      m = new (nothrow) AG_fs_map_t();
+      if( m == NULL ) {
+         return -ENOMEM;
+      }
+   }
+   
+   if( !config_changed && config != NULL ) {
+      
+      // not ours to replace
+      delete config;
+      config = NULL;
+   }
+   
+   // fill in the paths of the changed Pairs, and snapshot the new text 
+   struct AG_spec_snapshot* snapshot = SG_CALLOC( struct AG_spec_snapshot, 1 );
+   if( snapshot != NULL ) {
+      
+      snapshot->pairs = new (nothrow) AG_spec_pair_hash_list_t();
+      if( snapshot->pairs == NULL ) {
+         
+         free( snapshot );
+         snapshot = NULL;
+      }
+   }
+   
+   if( snapshot == NULL ) {
+      
+      AG_fs_map_free( m );
+      delete m;
+      
+      if( config != NULL ) {
+         delete config;
+      }
+      
+      return -ENOMEM;
+   }
+   
+   snapshot->text_hash = AG_spec_hash( AG_SPEC_HASH_INIT, spec_file_text, spec_file_text_len );
+   snapshot->skeleton_hash = skeleton_hash;
+   snapshot->config_hash = config_section.hash;
+   
+   try {
+      
+      snapshot->pairs->resize( order.size() );
+      
+      for( size_t i = 0; i < order.size(); i++ ) {
+         
+         struct AG_spec_pair_hash* pair_hash = &snapshot->pairs->at(i);
+         
+         pair_hash->hash = order[i].hash;
+         
+         if( order[i].old_idx >= 0 ) {
+            pair_hash->path = old_pairs->at( order[i].old_idx ).path;
+         }
+         else {
+            
+            // changed Pairs were parsed in document order
+            size_t changed_pos = lower_bound( changed.begin(), changed.end(), order[i].section ) - changed.begin();
+            pair_hash->path = pair_paths[ changed_pos ];
+         }
+      }
+   }
+   catch( bad_alloc& ba ) {
+      
+      AG_spec_snapshot_free( snapshot );
+      AG_fs_map_free( m );
+      delete m;
+      
+      if( config != NULL ) {
+         delete config;
+      }
+      
+      return -ENOMEM;
+   }
+   
+   *changed_map = m;
+   *new_config = config;
+   *new_snapshot = snapshot;
    
    return 0;
 }
+
+
+// free a spec snapshot
+void AG_spec_snapshot_free( struct AG_spec_snapshot* snapshot ) {
+   
+   if( snapshot == NULL ) {
+      return;
+   }
+   
+   if( snapshot->pairs != NULL ) {
+      delete snapshot->pairs;
+      snapshot->pairs = NULL;
+   }
+   
+   free( snapshot );
+}
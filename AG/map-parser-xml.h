@@ -19,6 +19,7 @@
 
 #include <map>
 #include <set>
+#include <vector>
 #include <iostream>
 #include <string>
 #include <sstream>
@@ -119,6 +120,9 @@ public:
    // how many pairs parsed?
    uint64_t num_pairs_parsed;
    
+   // if not NULL, the path of each Pair parsed, in document order (duplicates included)
+   vector<string>* pair_paths;
+   
    static int64_t parse_time(char *tm_str);
    
    void reset_element_parse_state( int tag_id );
@@ -185,8 +189,33 @@ public:
    }
 };
 
+// hash of a Pair's text, and the path it maps
+struct AG_spec_pair_hash {
+   uint64_t hash;
+   string path;
+};
+
+typedef vector<struct AG_spec_pair_hash> AG_spec_pair_hash_list_t;
+
+// what a spec file's text looked like when we last loaded it.
+// On reload, the new text is hashed the same way, and only the Config and Pair elements whose hashes changed get parsed.
+struct AG_spec_snapshot {
+   
+   uint64_t text_hash;                  // hash of the whole text
+   uint64_t skeleton_hash;              // hash of everything outside the Config and Pair elements, less whitespace
+   uint64_t config_hash;                // hash of the Config element
+   
+   AG_spec_pair_hash_list_t* pairs;     // each Pair's hash and path, sorted by hash
+};
+
 // public C method 
 int AG_parse_spec( struct AG_state* state, char const* spec_file_text, size_t spec_file_text_len, AG_fs_map_t** new_map, AG_config_t** new_config );
+int AG_parse_spec_snapshot( struct AG_state* state, char const* spec_file_text, size_t spec_file_text_len, AG_fs_map_t** new_map, AG_config_t** new_config, struct AG_spec_snapshot** new_snapshot );
+int AG_parse_spec_changes( struct AG_state* state, char const* spec_file_text, size_t spec_file_text_len, struct AG_spec_snapshot* old_snapshot,
+                           AG_fs_map_t** changed_map, AG_config_t** new_config, vector<string>* removed_paths, struct AG_spec_snapshot** new_snapshot );
+
+bool AG_spec_snapshot_matches( struct AG_spec_snapshot* snapshot, char const* spec_file_text, size_t spec_file_text_len );
+void AG_spec_snapshot_free( struct AG_spec_snapshot* snapshot );
 
 
 #endif //_AG_MAP_PARSER_XML_H_
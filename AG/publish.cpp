@@ -175,6 +175,7 @@ static int AG_requests_free_all( struct ms_client_request* requests, size_t num_
 // associate with each request its absolute path, so we can merge the result back in.
 // map_infos contains the data we know, and each element must have both the driver-given and MS-given metadata.
 // request_infos contains the data to send to the MS, and each element must include at least the driver-given metadata.
+// each request's parent is looked up in map_infos, and then in request_infos (i.e. if it was published by an earlier batch of requests).
 // on success, *ret_requests will point to an array of *ret_num_requests requests
 static int AG_build_requests( struct ms_client* client, AG_fs_map_t* map_infos, AG_fs_map_t* request_infos,
                               AG_build_request_filter_t filter, void* filter_cls, AG_make_request_func_t make_request, struct ms_client_request** ret_requests, size_t* ret_num_requests ) {
@@ -206,7 +207,18 @@ static int AG_build_requests( struct ms_client* client, AG_fs_map_t* map_infos,
       parent_path = md_dirname( path, NULL );
       parent_itr = map_infos->find( string( parent_path ) );
       
-      if( parent_itr == map_infos->end() ) {
+      if( parent_itr != map_infos->end() ) {
+         parent_mi = parent_itr->second;
+      }
+      else {
+         
+         parent_itr = request_infos->find( string( parent_path ) );
+         if( parent_itr != request_infos->end() ) {
+            parent_mi = parent_itr->second;
+         }
+      }
+      
+      if( parent_mi == NULL ) {
          // incomplete 
          SG_error("ERR: not found: '%s'\n", parent_path );
          
@@ -216,7 +228,6 @@ static int AG_build_requests( struct ms_client* client, AG_fs_map_t* map_infos,
       }
       
       free( parent_path );
-      parent_mi = parent_itr->second;
       
       // make request 
       ent = SG_CALLOC( struct md_entry, 1 );
@@ -392,27 +403,10 @@ static int AG_run_requests( struct ms_client* client, AG_fs_map_t* dest, struct
 }
 
 
-// shallow-copy entries from one AG_fs_map_t to another that are of the same depth.
-// NOTE: duplicates are overwritten!
-static int AG_fs_find_entries_at_depth( AG_fs_map_t* dest, AG_fs_map_t* source, int depth ) {
-   
-   for( AG_fs_map_t::iterator itr = source->begin(); itr != source->end(); itr++ ) {
-      
-      char const* path = itr->first.c_str();
-      
-      if( md_depth(path) != depth ) {
-         continue;
-      }
-      
-      (*dest)[ itr->first ] = itr->second;
-   }
-   
-   return 0;
-}
-
 // Publish an fs_map of entries to the MS (to_publish).
 // Each entry in to_publish needs to have its driver-given metadata.  It does not need MS metadata--that will be obtained.
-// map_infos must contain the parents of everything in to_publish
+// map_infos must contain the parents of everything in to_publish that isn't itself in to_publish.
+// Directories are published a depth at a time, so their children can find them in to_publish.
 // put the resulting MS metadata into to_publish on success.
 int AG_fs_publish_all( struct ms_client* client, AG_fs_map_t* map_infos, AG_fs_map_t* to_publish ) {
    
@@ -422,17 +416,10 @@ int AG_fs_publish_all( struct ms_client* client, AG_fs_map_t* map_infos, AG_fs_m
    size_t num_requests = 0;
    int max_depth = AG_max_depth( to_publish );
    
-   // have map_infos reference the parents of all entries for which we have data
-   AG_fs_map_t parents;
-   
-   for( AG_fs_map_t::iterator itr = map_infos->begin(); itr != map_infos->end(); itr++ ) {
-      parents[ itr->first ] = itr->second;
-   }
-   
    for( depth = 0; depth <= max_depth; depth++ ) {
       
       // make directory requests
-      rc = AG_build_mkdir_requests_at_depth( client, &parents, to_publish, depth, &requests, &num_requests );
+      rc = AG_build_mkdir_requests_at_depth( client, map_infos, to_publish, depth, &requests, &num_requests );
       if( rc != 0 ) {
          
          SG_error("AG_build_mkdir_requests_at_depth(%d) rc = %d\n", depth, rc );
@@ -453,7 +440,7 @@ int AG_fs_publish_all( struct ms_client* client, AG_fs_map_t* map_infos, AG_fs_m
       }
       
       // make file requests 
-      rc = AG_build_create_async_requests_at_depth( client, &parents, to_publish, depth, &requests, &num_requests );
+      rc = AG_build_create_async_requests_at_depth( client, map_infos, to_publish, depth, &requests, &num_requests );
       if( rc != 0 ) {
          
          SG_error("AG_build_create_async_requests_at_depth(%d) rc = %d\n", depth, rc );
@@ -472,9 +459,6 @@ int AG_fs_publish_all( struct ms_client* client, AG_fs_map_t* map_infos, AG_fs_m
             break;
          }
       }
-      
-      // merge mkdir requests to parents, so we can look them up later when building the next generation of requests.
-      AG_fs_find_entries_at_depth( &parents, to_publish, depth );
    }
    
    return rc;
@@ -0,0 +1,36 @@
+#!/bin/sh
+
+# Make an AG spec file that publishes a dataset made by ../disk-blocks/mkdataset.sh through the curl driver, from
+# an origin.py serving DATASET_ROOT at ORIGIN_URL.
+# Usage: mkspec.sh DATASET_ROOT ORIGIN_URL > spec.xml
+
+if [ $# -ne 2 ]; then
+   echo "Usage: $0 DATASET_ROOT ORIGIN_URL > spec.xml" >&2
+   exit 1
+fi
+
+ROOT=$1
+ORIGIN_URL=${2%/}
+
+echo "<Map>"
+echo "   <Config>"
+echo "      <check_upstream>1</check_upstream>"
+echo "   </Config>"
+
+for dir in / /small /huge; do
+   echo "   <Pair reval=\"1d\">"
+   echo "      <Dir perm=\"0555\">$dir</Dir>"
+   echo "      <Query type=\"curl\">$dir</Query>"
+   echo "   </Pair>"
+done
+
+for dir in small huge; do
+   for f in $(ls $ROOT/$dir | sort -n); do
+      echo "   <Pair reval=\"1d\">"
+      echo "      <File perm=\"0444\">/$dir/$f</File>"
+      echo "      <Query type=\"curl\">$ORIGIN_URL/$dir/$f</Query>"
+      echo "   </Pair>"
+   done
+done
+
+echo "</Map>"
@@ -0,0 +1,217 @@
+#!/usr/bin/python
+
+"""
+Local HTTP origin for benchmarking the curl AG driver.
+
+Serves the files under a directory over HTTP/1.1 with keep-alive, HEAD, single byte-range GETs, and Last-Modified,
+which is all the curl driver needs from an origin.  It can add a fixed delay to each new connection and to each
+request, to stand in for a remote origin.  When it's stopped (SIGINT or SIGTERM), it prints how many connections it
+accepted and how many HEADs, GETs, and bytes it served, so you can see how well the driver reuses connections and
+merges block requests.
+"""
+
+import os
+import re
+import sys
+import time
+import signal
+import threading
+
+try:
+   import BaseHTTPServer
+   import SocketServer
+except ImportError:
+   import http.server as BaseHTTPServer
+   import socketserver as SocketServer
+
+RANGE_RE = re.compile( r"^bytes=(\d+)-(\d*)$" )
+
+#-------------------------------
+class OriginStats( object ):
+   def __init__( self ):
+      self.lock = threading.Lock()
+      self.connections = 0
+      self.heads = 0
+      self.gets = 0
+      self.bytes = 0
+
+   def add( self, **kw ):
+      with self.lock:
+         for (name, value) in kw.items():
+            setattr( self, name, getattr( self, name ) + value )
+
+   def report( self ):
+      with self.lock:
+         print( "connections: %d" % self.connections )
+         print( "HEADs:       %d" % self.heads )
+         print( "GETs:        %d" % self.gets )
+         print( "bytes:       %d" % self.bytes )
+         if self.connections > 0:
+            print( "requests per connection: %.2f" % (float(self.heads + self.gets) / self.connections) )
+
+         sys.stdout.flush()
+
+
+#-------------------------------
+class OriginHandler( BaseHTTPServer.BaseHTTPRequestHandler ):
+
+   protocol_version = "HTTP/1.1"
+
+   def setup( self ):
+      BaseHTTPServer.BaseHTTPRequestHandler.setup( self )
+
+      self.server.stats.add( connections=1 )
+
+      if self.server.connect_delay > 0:
+         time.sleep( self.server.connect_delay )
+
+   def log_message( self, format, *args ):
+      if self.server.verbose:
+         BaseHTTPServer.BaseHTTPRequestHandler.log_message( self, format, *args )
+
+   def send_empty( self, status ):
+      self.send_response( status )
+      self.send_header( "Content-Length", "0" )
+      self.end_headers()
+
+   def resolve( self ):
+      """
+      Get the path and stat of the requested file, or None if there isn't one.
+      """
+      path = os.path.normpath( os.path.join( self.server.root, self.path.split("?")[0].lstrip("/") ) )
+      if not path.startswith( self.server.root ):
+         return (None, None)
+
+      try:
+         sb = os.stat( path )
+      except OSError:
+         return (None, None)
+
+      if not os.path.isfile( path ):
+         return (None, None)
+
+      return (path, sb)
+
+   def send_file_headers( self, status, sb, length ):
+      self.send_response( status )
+      self.send_header( "Content-Length", str(length) )
+      self.send_header( "Last-Modified", self.date_time_string( int(sb.st_mtime) ) )
+      self.send_header( "Accept-Ranges", "bytes" )
+
+   def do_HEAD( self ):
+      self.server.stats.add( heads=1 )
+
+      if self.server.request_delay > 0:
+         time.sleep( self.server.request_delay )
+
+      (path, sb) = self.resolve()
+      if path is None:
+         return self.send_empty( 404 )
+
+      self.send_file_headers( 200, sb, sb.st_size )
+      self.end_headers()
+
+   def do_GET( self ):
+      self.server.stats.add( gets=1 )
+
+      if self.server.request_delay > 0:
+         time.sleep( self.server.request_delay )
+
+      (path, sb) = self.resolve()
+      if path is None:
+         return self.send_empty( 404 )
+
+      start = 0
+      end = sb.st_size - 1
+      status = 200
+
+      range_hdr = self.headers.get( "Range" )
+      if range_hdr is not None:
+         m = RANGE_RE.match( range_hdr.strip() )
+         if m is None:
+            return self.send_empty( 400 )
+
+         start = int( m.group(1) )
+         if m.group(2) != "":
+            end = min( int( m.group(2) ), sb.st_size - 1 )
+
+         if start >= sb.st_size:
+            self.send_response( 416 )
+            self.send_header( "Content-Range", "bytes */%d" % sb.st_size )
+            self.send_header( "Content-Length", "0" )
+            self.end_headers()
+            return
+
+         status = 206
+
+      length = end - start + 1
+
+      self.send_file_headers( status, sb, length )
+      if status == 206:
+         self.send_header( "Content-Range", "bytes %d-%d/%d" % (start, end, sb.st_size) )
+
+      self.end_headers()
+
+      with open( path, "rb" ) as f:
+         f.seek( start )
+         left = length
+         while left > 0:
+            buf = f.read( min( left, 1024 * 1024 ) )
+            if len(buf) == 0:
+               break
+
+            self.wfile.write( buf )
+            left -= len(buf)
+
+      self.server.stats.add( bytes=length )
+
+
+#-------------------------------
+class OriginServer( SocketServer.ThreadingMixIn, BaseHTTPServer.HTTPServer ):
+   daemon_threads = True
+   allow_reuse_address = True
+
+
+#-------------------------------
+def usage( progname ):
+   print( "Usage: %s ROOT_DIR PORT [CONNECT_DELAY_MS [REQUEST_DELAY_MS]] [-v]" % progname )
+   sys.exit(1)
+
+
+#-------------------------------
+if __name__ == "__main__":
+   args = [a for a in sys.argv[1:] if a != "-v"]
+   verbose = (len(args) != len(sys.argv) - 1)
+
+   if len(args) < 2 or len(args) > 4:
+      usage( sys.argv[0] )
+
+   root = os.path.abspath( args[0] )
+   port = int( args[1] )
+   connect_delay = 0.0
+   request_delay = 0.0
+
+   if len(args) > 2:
+      connect_delay = float( args[2] ) / 1000.0
+
+   if len(args) > 3:
+      request_delay = float( args[3] ) / 1000.0
+
+   server = OriginServer( ("", port), OriginHandler )
+   server.root = root
+   server.connect_delay = connect_delay
+   server.request_delay = request_delay
+   server.verbose = verbose
+   server.stats = OriginStats()
+
+   def stop( signum, frame ):
+      server.stats.report()
+      os._exit(0)
+
+   signal.signal( signal.SIGINT, stop )
+   signal.signal( signal.SIGTERM, stop )
+
+   print( "Serving %s on port %d (connect delay %.0f ms, request delay %.0f ms)" % (root, port, connect_delay * 1000, request_delay * 1000) )
+   sys.stdout.flush()
+
+   server.serve_forever()
@@ -0,0 +1,235 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Block-serving benchmark for the disk driver.
+// Point it at an AG that serves a dataset made by mkdataset.sh (NUM_SMALL files in /small, NUM_HUGE files in /huge),
+// with a cold block cache, so every block we ask for is read through the driver.  First, NUM_CLIENTS clients fetch
+// the first block of each small file, so the driver opens many files once each.  Then, one client per huge file reads
+// its first HUGE_BLOCKS blocks in order, so the driver reads a few files sequentially.  We report the throughput of
+// each phase.
+//
+// We don't need to know the files' IDs or versions:  we ask for each block with made-up ones, and follow the AG's
+// redirect to the current URL.
+
+#include "libsyndicate/libsyndicate.h"
+#include "libsyndicate/url.h"
+
+char const* global_ag_url = NULL;
+uint64_t global_volume_id = 0;
+
+// one client's share of a phase
+struct disk_blocks_client {
+   // fetch blocks [first_block, first_block + num_blocks) of each of the files named <dir>/<i> for i in [first_file, num_files) by stride
+   char const* dir;
+   int first_file;
+   int num_files;
+   int stride;
+   uint64_t first_block;
+   uint64_t num_blocks;
+
+   uint64_t blocks_fetched;
+   uint64_t bytes_fetched;
+   int failures;
+};
+
+void usage( char* progname ) {
+   fprintf(stderr, "Usage: %s AG_URL VOLUME_ID NUM_SMALL NUM_HUGE HUGE_BLOCKS NUM_CLIENTS\n", progname );
+   exit(1);
+}
+
+// count a response body
+size_t disk_blocks_write( char* ptr, size_t size, size_t nmemb, void* userdata ) {
+
+   uint64_t* len = (uint64_t*)userdata;
+   *len += size * nmemb;
+
+   return size * nmemb;
+}
+
+// seconds since a start time
+double disk_blocks_elapsed( struct timespec* start ) {
+
+   struct timespec now;
+   clock_gettime( CLOCK_MONOTONIC, &now );
+
+   return ((double)(now.tv_nsec - start->tv_nsec) + (double)(1e9 * (now.tv_sec - start->tv_sec))) / 1e9;
+}
+
+// fetch this client's blocks, over one connection
+void* disk_blocks_main( void* arg ) {
+
+   struct disk_blocks_client* client = (struct disk_blocks_client*)arg;
+   char fs_path[PATH_MAX];
+
+   CURL* curl = curl_easy_init();
+
+   curl_easy_setopt( curl, CURLOPT_FOLLOWLOCATION, 1L );
+   curl_easy_setopt( curl, CURLOPT_WRITEFUNCTION, disk_blocks_write );
+
+   for( int i = client->first_file; i < client->num_files; i += client->stride ) {
+
+      snprintf( fs_path, PATH_MAX, "%s/%d", client->dir, i );
+
+      for( uint64_t block_id = client->first_block; block_id < client->first_block + client->num_blocks; block_id++ ) {
+
+         uint64_t len = 0;
+         long http_status = 0;
+
+         char* url = md_url_public_block_url( global_ag_url, global_volume_id, fs_path, 0, 0, block_id, 0 );
+
+         curl_easy_setopt( curl, CURLOPT_URL, url );
+         curl_easy_setopt( curl, CURLOPT_WRITEDATA, &len );
+
+         int rc = curl_easy_perform( curl );
+         curl_easy_getinfo( curl, CURLINFO_RESPONSE_CODE, &http_status );
+
+         if( rc != 0 || http_status != 200 ) {
+
+            fprintf(stderr, "GET %s: curl rc = %d, HTTP status = %ld\n", url, rc, http_status );
+            client->failures++;
+         }
+         else {
+
+            client->blocks_fetched++;
+            client->bytes_fetched += len;
+         }
+
+         free( url );
+      }
+   }
+
+   curl_easy_cleanup( curl );
+   return NULL;
+}
+
+// run a phase with num_clients clients
+// return 0 if all fetches succeeded, or -1 if not
+int disk_blocks_phase( char const* name, struct disk_blocks_client* clients, int num_clients ) {
+
+   struct timespec start;
+   uint64_t blocks = 0;
+   uint64_t bytes = 0;
+   int failures = 0;
+
+   pthread_t* threads = SG_CALLOC( pthread_t, num_clients );
+   if( threads == NULL ) {
+      exit( ENOMEM );
+   }
+
+   clock_gettime( CLOCK_MONOTONIC, &start );
+
+   for( int i = 0; i < num_clients; i++ ) {
+      pthread_create( &threads[i], NULL, disk_blocks_main, &clients[i] );
+   }
+
+   for( int i = 0; i < num_clients; i++ ) {
+      pthread_join( threads[i], NULL );
+   }
+
+   double elapsed = disk_blocks_elapsed( &start );
+
+   for( int i = 0; i < num_clients; i++ ) {
+
+      blocks += clients[i].blocks_fetched;
+      bytes += clients[i].bytes_fetched;
+      failures += clients[i].failures;
+   }
+
+   free( threads );
+
+   printf("%s: %" PRIu64 " blocks (%" PRIu64 " bytes) in %lf s: %lf blocks/s, %lf MB/s, %d failures\n",
+          name, blocks, bytes, elapsed, (double)blocks / elapsed, (double)bytes / elapsed / (1024.0 * 1024.0), failures );
+
+   return (failures == 0 ? 0 : -1);
+}
+
+
+int main( int argc, char** argv ) {
+
+   if( argc != 7 ) {
+      usage( argv[0] );
+   }
+
+   global_ag_url = argv[1];
+   global_volume_id = (uint64_t)strtoull( argv[2], NULL, 10 );
+
+   int num_small = atoi( argv[3] );
+   int num_huge = atoi( argv[4] );
+   uint64_t huge_blocks = (uint64_t)strtoull( argv[5], NULL, 10 );
+   int num_clients = atoi( argv[6] );
+
+   if( num_small < 0 || num_huge < 0 || num_clients <= 0 ) {
+      usage( argv[0] );
+   }
+
+   int rc = 0;
+
+   curl_global_init( CURL_GLOBAL_ALL );
+
+   // many small files:  the first block of each, spread across the clients
+   if( num_small > 0 ) {
+
+      struct disk_blocks_client* clients = SG_CALLOC( struct disk_blocks_client, num_clients );
+      if( clients == NULL ) {
+         exit( ENOMEM );
+      }
+
+      for( int i = 0; i < num_clients; i++ ) {
+
+         clients[i].dir = "/small";
+         clients[i].first_file = i;
+         clients[i].num_files = num_small;
+         clients[i].stride = num_clients;
+         clients[i].first_block = 0;
+         clients[i].num_blocks = 1;
+      }
+
+      if( disk_blocks_phase( "small files", clients, num_clients ) != 0 ) {
+         rc = 1;
+      }
+
+      free( clients );
+   }
+
+   // a few huge files:  one client reads each one in order
+   if( num_huge > 0 && huge_blocks > 0 ) {
+
+      struct disk_blocks_client* clients = SG_CALLOC( struct disk_blocks_client, num_huge );
+      if( clients == NULL ) {
+         exit( ENOMEM );
+      }
+
+      for( int i = 0; i < num_huge; i++ ) {
+
+         clients[i].dir = "/huge";
+         clients[i].first_file = i;
+         clients[i].num_files = i + 1;
+         clients[i].stride = 1;
+         clients[i].first_block = 0;
+         clients[i].num_blocks = huge_blocks;
+      }
+
+      if( disk_blocks_phase( "huge files", clients, num_huge ) != 0 ) {
+         rc = 1;
+      }
+
+      free( clients );
+   }
+
+   curl_global_cleanup();
+
+   return rc;
+}
@@ -0,0 +1,55 @@
+#!/bin/sh
+
+# Make a dataset for the disk-blocks benchmark, and an AG spec file that publishes it with the disk driver.
+# Usage: mkdataset.sh DATASET_ROOT NUM_SMALL SMALL_KB NUM_HUGE HUGE_MB > spec.xml
+
+if [ $# -ne 5 ]; then
+   echo "Usage: $0 DATASET_ROOT NUM_SMALL SMALL_KB NUM_HUGE HUGE_MB > spec.xml" >&2
+   exit 1
+fi
+
+ROOT=$1
+NUM_SMALL=$2
+SMALL_KB=$3
+NUM_HUGE=$4
+HUGE_MB=$5
+
+mkdir -p $ROOT/small $ROOT/huge || exit 1
+
+echo "<Map>"
+echo "   <Config>"
+echo "      <dataset_root>$ROOT/</dataset_root>"
+echo "   </Config>"
+
+for dir in / /small /huge; do
+   echo "   <Pair reval=\"1d\">"
+   echo "      <Dir perm=\"0555\">$dir</Dir>"
+   echo "      <Query type=\"disk\"></Query>"
+   echo "   </Pair>"
+done
+
+i=0
+while [ $i -lt $NUM_SMALL ]; do
+   dd if=/dev/urandom of=$ROOT/small/$i bs=1024 count=$SMALL_KB 2>/dev/null || exit 1
+
+   echo "   <Pair reval=\"1d\">"
+   echo "      <File perm=\"0444\">/small/$i</File>"
+   echo "      <Query type=\"disk\">$ROOT/small/$i</Query>"
+   echo "   </Pair>"
+
+   i=$((i + 1))
+done
+
+i=0
+while [ $i -lt $NUM_HUGE ]; do
+   dd if=/dev/urandom of=$ROOT/huge/$i bs=1048576 count=$HUGE_MB 2>/dev/null || exit 1
+
+   echo "   <Pair reval=\"1d\">"
+   echo "      <File perm=\"0444\">/huge/$i</File>"
+   echo "      <Query type=\"disk\">$ROOT/huge/$i</Query>"
+   echo "   </Pair>"
+
+   i=$((i + 1))
+done
+
+echo "</Map>"
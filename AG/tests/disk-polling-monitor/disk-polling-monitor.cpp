@@ -0,0 +1,384 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Change detection test for the disk_polling driver.
+// Makes a dataset of NUM_DIRS directories with NUM_FILES files each under a scratch directory, scans it once, and
+// starts the inotify monitor on it.  Then it makes NUM_CHANGES changes (creating, rewriting, and deleting files, and
+// making, moving, and removing directories), and times how long each takes to reach the handler.  After that, it
+// leaves the dataset alone for IDLE_SECONDS and measures how much CPU we used, and checks that a full rescan finds
+// nothing the monitor missed.  For comparison, it reports what a full rescan costs, which polling pays every interval.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <pthread.h>
+#include <ftw.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#include <string>
+#include <vector>
+
+#include "AG/drivers/disk_polling/directory_monitor.h"
+#include "AG/drivers/disk_polling/inotify_monitor.h"
+
+using namespace std;
+
+// how long to wait for a change to be reported
+#define MONITOR_TEST_TIMEOUT 5
+
+struct monitor_report {
+   int flag;
+   string path;
+   double when;
+};
+
+pthread_mutex_t global_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t global_cv = PTHREAD_COND_INITIALIZER;
+vector<struct monitor_report> global_reports;
+
+char const* global_root = NULL;
+int global_num_failures = 0;
+
+void usage( char* progname ) {
+   fprintf(stderr, "Usage: %s /path/to/scratch/dir NUM_DIRS NUM_FILES NUM_CHANGES IDLE_SECONDS\n", progname );
+   exit(1);
+}
+
+// monotonic time, in seconds
+double monitor_now(void) {
+
+   struct timespec ts;
+   clock_gettime( CLOCK_MONOTONIC, &ts );
+
+   return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// CPU time we've used, in seconds
+double monitor_cpu_time(void) {
+
+   struct rusage ru;
+   getrusage( RUSAGE_SELF, &ru );
+
+   return (double)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) + (double)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+}
+
+// record a change
+void monitor_handler( int flag, string spath, struct filestat_cache* cache ) {
+
+   struct monitor_report report;
+
+   report.flag = flag;
+   report.path = spath;
+   report.when = monitor_now();
+
+   pthread_mutex_lock( &global_lock );
+
+   global_reports.push_back( report );
+   pthread_cond_broadcast( &global_cv );
+
+   pthread_mutex_unlock( &global_lock );
+}
+
+// forget recorded changes
+size_t monitor_reset(void) {
+
+   pthread_mutex_lock( &global_lock );
+
+   size_t ret = global_reports.size();
+   global_reports.clear();
+
+   pthread_mutex_unlock( &global_lock );
+
+   return ret;
+}
+
+// wait for a change to a path to be reported at or after a given time
+// return the time it was reported, or negative on timeout
+double monitor_wait( string const& path, int flag, double since ) {
+
+   double deadline = monitor_now() + MONITOR_TEST_TIMEOUT;
+   double ret = -1;
+
+   pthread_mutex_lock( &global_lock );
+
+   while( ret < 0 ) {
+
+      for( unsigned int i = 0; i < global_reports.size(); i++ ) {
+
+         if( global_reports[i].path == path && global_reports[i].flag == flag && global_reports[i].when >= since ) {
+            ret = global_reports[i].when;
+            break;
+         }
+      }
+
+      if( ret >= 0 || monitor_now() > deadline ) {
+         break;
+      }
+
+      struct timespec ts;
+      clock_gettime( CLOCK_REALTIME, &ts );
+      ts.tv_nsec += 10 * 1000 * 1000;
+      if( ts.tv_nsec >= 1000 * 1000 * 1000 ) {
+         ts.tv_sec++;
+         ts.tv_nsec -= 1000 * 1000 * 1000;
+      }
+
+      pthread_cond_timedwait( &global_cv, &global_lock, &ts );
+   }
+
+   pthread_mutex_unlock( &global_lock );
+
+   if( ret < 0 ) {
+      fprintf(stderr, "Timed out waiting for change %d to %s\n", flag, path.c_str() );
+      global_num_failures++;
+   }
+
+   return ret;
+}
+
+// write a file and close it
+int monitor_write_file( string const& path, char const* data ) {
+
+   int fd = open( path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+   if( fd < 0 ) {
+      fprintf(stderr, "open(%s) errno = %d\n", path.c_str(), -errno );
+      exit(1);
+   }
+
+   if( write( fd, data, strlen(data) ) < 0 ) {
+      fprintf(stderr, "write(%s) errno = %d\n", path.c_str(), -errno );
+      exit(1);
+   }
+
+   close( fd );
+   return 0;
+}
+
+int monitor_rm_found( char const* fpath, const struct stat* sb, int tflag, struct FTW* ftwbuf ) {
+   remove( fpath );
+   return 0;
+}
+
+// remove a directory tree
+void monitor_rm_tree( string const& path ) {
+   nftw( path.c_str(), monitor_rm_found, MAX_NUM_DIRECTORY_OPENED, FTW_DEPTH | FTW_PHYS );
+}
+
+// make a change, and return how long it took to be reported (or negative if it wasn't)
+double monitor_change( int i ) {
+
+   char name[PATH_MAX];
+   double start = 0, reported = 0;
+   string root( global_root );
+
+   snprintf( name, PATH_MAX, "%s/change-%d", global_root, i );
+   string path( name );
+
+   switch( i % 5 ) {
+
+      case 0: {
+         // new file
+         start = monitor_now();
+         monitor_write_file( path, "new" );
+         reported = monitor_wait( path, DIR_ENTRY_MODIFIED_FLAG_NEW, start );
+         break;
+      }
+
+      case 1: {
+         // rewrite a file (with a different size, since we compare sizes and mtimes to the second).
+         // move the old one into place, so its own creation isn't also reported as a modification.
+         monitor_write_file( path + ".tmp", "old" );
+         rename( (path + ".tmp").c_str(), path.c_str() );
+         monitor_wait( path, DIR_ENTRY_MODIFIED_FLAG_NEW, start );
+
+         start = monitor_now();
+         monitor_write_file( path, "modified" );
+         reported = monitor_wait( path, DIR_ENTRY_MODIFIED_FLAG_MODIFIED, start );
+         break;
+      }
+
+      case 2: {
+         // delete a file
+         monitor_write_file( path, "doomed" );
+         monitor_wait( path, DIR_ENTRY_MODIFIED_FLAG_NEW, start );
+
+         start = monitor_now();
+         unlink( path.c_str() );
+         reported = monitor_wait( path, DIR_ENTRY_MODIFIED_FLAG_REMOVED, start );
+         break;
+      }
+
+      case 3: {
+         // new directory, with a file made right away (before we could have watched it)
+         start = monitor_now();
+         mkdir( path.c_str(), 0755 );
+         monitor_write_file( path + "/child", "child" );
+
+         monitor_wait( path, DIR_ENTRY_MODIFIED_FLAG_NEW, start );
+         reported = monitor_wait( path + "/child", DIR_ENTRY_MODIFIED_FLAG_NEW, start );
+         break;
+      }
+
+      case 4: {
+         // move a directory with a file in it, then remove it
+         mkdir( path.c_str(), 0755 );
+         monitor_write_file( path + "/child", "child" );
+         monitor_wait( path + "/child", DIR_ENTRY_MODIFIED_FLAG_NEW, start );
+
+         string moved = path + "-moved";
+
+         start = monitor_now();
+         rename( path.c_str(), moved.c_str() );
+
+         monitor_wait( path + "/child", DIR_ENTRY_MODIFIED_FLAG_REMOVED, start );
+         monitor_wait( path, DIR_ENTRY_MODIFIED_FLAG_REMOVED, start );
+         monitor_wait( moved, DIR_ENTRY_MODIFIED_FLAG_NEW, start );
+         reported = monitor_wait( moved + "/child", DIR_ENTRY_MODIFIED_FLAG_NEW, start );
+
+         monitor_rm_tree( moved );
+         monitor_wait( moved, DIR_ENTRY_MODIFIED_FLAG_REMOVED, start );
+         break;
+      }
+   }
+
+   if( reported < 0 ) {
+      return -1;
+   }
+
+   return reported - start;
+}
+
+
+int main( int argc, char** argv ) {
+
+   char path[PATH_MAX];
+
+   if( argc != 6 ) {
+      usage( argv[0] );
+   }
+
+   global_root = argv[1];
+   int num_dirs = atoi( argv[2] );
+   int num_files = atoi( argv[3] );
+   int num_changes = atoi( argv[4] );
+   int idle_seconds = atoi( argv[5] );
+
+   if( num_dirs < 0 || num_files < 0 || num_changes < 0 || idle_seconds < 0 ) {
+      usage( argv[0] );
+   }
+
+   // make the dataset
+   monitor_rm_tree( string(global_root) );
+
+   if( mkdir( global_root, 0755 ) != 0 ) {
+      fprintf(stderr, "mkdir(%s) errno = %d\n", global_root, -errno );
+      exit(1);
+   }
+
+   for( int i = 0; i < num_dirs; i++ ) {
+
+      snprintf( path, PATH_MAX, "%s/dir-%d", global_root, i );
+      mkdir( path, 0755 );
+
+      for( int j = 0; j < num_files; j++ ) {
+
+         snprintf( path, PATH_MAX, "%s/dir-%d/file-%d", global_root, i, j );
+         monitor_write_file( string(path), "data" );
+      }
+   }
+
+   // initial scan, which is also what every polling interval costs
+   init_monitor();
+
+   double scan_start = monitor_now();
+   double scan_cpu_start = monitor_cpu_time();
+
+   check_modified( global_root, monitor_handler );
+
+   double scan_time = monitor_now() - scan_start;
+   double scan_cpu = monitor_cpu_time() - scan_cpu_start;
+
+   printf("full scan: %zu entries in %lf s (%lf s CPU)\n", monitor_reset(), scan_time, scan_cpu );
+
+   int rc = start_inotify_monitor( global_root, monitor_handler );
+   if( rc != 0 ) {
+      fprintf(stderr, "start_inotify_monitor(%s) rc = %d\n", global_root, rc );
+      exit(1);
+   }
+
+   // change-to-report latency
+   double total_latency = 0, max_latency = 0;
+   int num_reported = 0;
+
+   for( int i = 0; i < num_changes; i++ ) {
+
+      double latency = monitor_change( i );
+      if( latency < 0 ) {
+         continue;
+      }
+
+      total_latency += latency;
+      num_reported++;
+
+      if( latency > max_latency ) {
+         max_latency = latency;
+      }
+   }
+
+   if( num_reported > 0 ) {
+      printf("change-to-report latency: mean %lf s, max %lf s over %d changes\n", total_latency / num_reported, max_latency, num_reported );
+   }
+
+   // idle CPU
+   monitor_reset();
+
+   double idle_cpu_start = monitor_cpu_time();
+
+   sleep( idle_seconds );
+
+   double idle_cpu = monitor_cpu_time() - idle_cpu_start;
+
+   printf("idle CPU: %lf s over %d s\n", idle_cpu, idle_seconds );
+   printf("polling every %d s would use about %lf s CPU over the same time\n", 10, scan_cpu * idle_seconds / 10 );
+
+   if( monitor_reset() != 0 ) {
+      fprintf(stderr, "%s", "Changes reported while idle\n" );
+      global_num_failures++;
+   }
+
+   // a rescan should find nothing new
+   check_modified( global_root, monitor_handler );
+
+   size_t missed = monitor_reset();
+   if( missed != 0 ) {
+      fprintf(stderr, "Rescan found %zu changes the monitor missed\n", missed );
+      global_num_failures++;
+   }
+
+   stop_inotify_monitor();
+
+   monitor_rm_tree( string(global_root) );
+
+   printf("\n\nTotal failures: %d\n", global_num_failures );
+
+   return (global_num_failures == 0 ? 0 : 1);
+}
@@ -0,0 +1,258 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+   
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+       
+       http://www.apache.org/licenses/LICENSE-2.0
+   
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// AG_fs_map benchmark.
+// Fills an AG_fs_map, and a std::map<string, AG_map_info*> (what AG_fs_map_t used to be), with NUM_ENTRIES files spread
+// over directories of FILES_PER_DIR files each, and compares their memory use and how long it takes to fill them, look up
+// NUM_LOOKUPS paths (present and absent), walk all entries in order, and list directories.  Only the maps are measured;
+// the AG_map_infos are not allocated.
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <malloc.h>
+
+#include "AG/fs-map.h"
+
+using namespace std;
+
+typedef map<string, struct AG_map_info*> bench_std_map_t;
+
+// what we found, so the two maps can be checked against each other
+struct bench_result {
+   size_t size;
+   size_t found;
+   size_t missed;
+   size_t walked;
+   size_t listed;
+};
+
+static double bench_now_ms() {
+   
+   struct timespec ts;
+   clock_gettime( CLOCK_MONOTONIC, &ts );
+   
+   return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// bytes allocated from the heap
+static size_t bench_heap_used() {
+   
+   struct mallinfo2 mi = mallinfo2();
+   return mi.uordblks + mi.hblkhd;
+}
+
+// path of the ith file
+static void bench_file_path( char* buf, int i, int files_per_dir ) {
+   
+   int dir = i / files_per_dir;
+   sprintf( buf, "/volume/dir-%d/subdir-%d/file-%d.dat", dir / 100, dir, i );
+}
+
+// path of the ith file's directory
+static void bench_dir_path( char* buf, int i, int files_per_dir ) {
+   
+   int dir = i / files_per_dir;
+   sprintf( buf, "/volume/dir-%d/subdir-%d", dir / 100, dir );
+}
+
+// list a directory in an AG_fs_map
+static size_t bench_list( AG_fs_map* fs_map, string const& dir_path ) {
+   
+   size_t count = 0;
+   AG_fs_map::iterator end = fs_map->subtree_end( dir_path );
+   
+   for( AG_fs_map::iterator itr = fs_map->lower_bound( dir_path ); itr != end; itr++ ) {
+      count += (itr->second != NULL);
+   }
+   
+   return count;
+}
+
+// list a directory in a std::map
+static size_t bench_list( bench_std_map_t* fs_map, string const& dir_path ) {
+   
+   size_t count = 0;
+   string prefix = dir_path + "/";
+   
+   bench_std_map_t::iterator itr = fs_map->find( dir_path );
+   if( itr != fs_map->end() ) {
+      count++;
+   }
+   
+   for( itr = fs_map->lower_bound( prefix ); itr != fs_map->end() && itr->first.compare( 0, prefix.size(), prefix ) == 0; itr++ ) {
+      count += (itr->second != NULL);
+   }
+   
+   return count;
+}
+
+// fill, measure, and free a map
+template <class fs_map_t> static void bench_run( char const* name, int num_entries, int files_per_dir, vector<string>& hits, vector<string>& misses, vector<string>& dirs, struct bench_result* result ) {
+   
+   // any non-NULL value will do
+   struct AG_map_info* mi = (struct AG_map_info*)&result;
+   char path_buf[100];
+   
+   size_t heap_start = bench_heap_used();
+   double start = bench_now_ms();
+   
+   fs_map_t* fs_map = new fs_map_t();
+   
+   (*fs_map)[ string("/") ] = mi;
+   (*fs_map)[ string("/volume") ] = mi;
+   
+   for( int i = 0; i < num_entries; i++ ) {
+      
+      if( i % files_per_dir == 0 ) {
+         
+         if( i % (files_per_dir * 100) == 0 ) {
+            sprintf( path_buf, "/volume/dir-%d", i / files_per_dir / 100 );
+            (*fs_map)[ string(path_buf) ] = mi;
+         }
+         
+         bench_dir_path( path_buf, i, files_per_dir );
+         (*fs_map)[ string(path_buf) ] = mi;
+      }
+      
+      bench_file_path( path_buf, i, files_per_dir );
+      (*fs_map)[ string(path_buf) ] = mi;
+   }
+   
+   double fill_ms = bench_now_ms() - start;
+   size_t heap_used = bench_heap_used() - heap_start;
+   
+   result->size = fs_map->size();
+   
+   // lookups
+   start = bench_now_ms();
+   
+   result->found = 0;
+   for( size_t i = 0; i < hits.size(); i++ ) {
+      result->found += fs_map->count( hits[i] );
+   }
+   
+   double hit_ms = bench_now_ms() - start;
+   start = bench_now_ms();
+   
+   result->missed = 0;
+   for( size_t i = 0; i < misses.size(); i++ ) {
+      result->missed += 1 - fs_map->count( misses[i] );
+   }
+   
+   double miss_ms = bench_now_ms() - start;
+   
+   // walk everything, in order
+   start = bench_now_ms();
+   
+   result->walked = 0;
+   for( typename fs_map_t::iterator itr = fs_map->begin(); itr != fs_map->end(); itr++ ) {
+      result->walked += itr->first.size();
+   }
+   
+   double walk_ms = bench_now_ms() - start;
+   
+   // list directories
+   start = bench_now_ms();
+   
+   result->listed = 0;
+   for( size_t i = 0; i < dirs.size(); i++ ) {
+      result->listed += bench_list( fs_map, dirs[i] );
+   }
+   
+   double list_ms = bench_now_ms() - start;
+   
+   start = bench_now_ms();
+   
+   delete fs_map;
+   
+   double free_ms = bench_now_ms() - start;
+   
+   printf("%s: %zu entries\n", name, result->size );
+   printf("   memory:  %zu bytes (%.1f bytes/entry)\n", heap_used, (double)heap_used / result->size );
+   printf("   fill:    %.1f ms (%.0f ns/entry)\n", fill_ms, fill_ms * 1e6 / result->size );
+   printf("   lookup:  %.0f ns/hit, %.0f ns/miss\n", hit_ms * 1e6 / hits.size(), miss_ms * 1e6 / misses.size() );
+   printf("   walk:    %.1f ms (%.0f ns/entry)\n", walk_ms, walk_ms * 1e6 / result->size );
+   printf("   list:    %.1f us/directory\n", list_ms * 1e3 / dirs.size() );
+   printf("   free:    %.1f ms\n", free_ms );
+}
+
+void usage( char* progname ) {
+   fprintf(stderr, "Usage: %s NUM_ENTRIES FILES_PER_DIR NUM_LOOKUPS\n", progname );
+   exit(1);
+}
+
+int main( int argc, char** argv ) {
+   
+   if( argc != 4 ) {
+      usage( argv[0] );
+   }
+   
+   int num_entries = atoi( argv[1] );
+   int files_per_dir = atoi( argv[2] );
+   int num_lookups = atoi( argv[3] );
+   
+   if( num_entries <= 0 || files_per_dir <= 0 || num_lookups <= 0 ) {
+      usage( argv[0] );
+   }
+   
+   // paths to look up, chosen before either map is filled so they're not counted
+   vector<string> hits, misses, dirs;
+   char path_buf[100];
+   unsigned int seed = 1;
+   
+   for( int i = 0; i < num_lookups; i++ ) {
+      
+      int file = rand_r( &seed ) % num_entries;
+      
+      bench_file_path( path_buf, file, files_per_dir );
+      hits.push_back( string(path_buf) );
+      
+      // same directory, different file
+      strcat( path_buf, ".tmp" );
+      misses.push_back( string(path_buf) );
+   }
+   
+   for( int i = 0; i < 1000; i++ ) {
+      
+      bench_dir_path( path_buf, rand_r( &seed ) % num_entries, files_per_dir );
+      dirs.push_back( string(path_buf) );
+   }
+   
+   struct bench_result std_result, trie_result;
+   
+   bench_run<bench_std_map_t>( "std::map", num_entries, files_per_dir, hits, misses, dirs, &std_result );
+   bench_run<AG_fs_map>( "AG_fs_map", num_entries, files_per_dir, hits, misses, dirs, &trie_result );
+   
+   if( std_result.size != trie_result.size || std_result.found != trie_result.found || std_result.missed != trie_result.missed ||
+       std_result.walked != trie_result.walked || std_result.listed != trie_result.listed ) {
+      
+      fprintf(stderr, "Maps differ: size %zu/%zu, found %zu/%zu, missed %zu/%zu, walked %zu/%zu, listed %zu/%zu\n",
+              std_result.size, trie_result.size, std_result.found, trie_result.found, std_result.missed, trie_result.missed,
+              std_result.walked, trie_result.walked, std_result.listed, trie_result.listed );
+      
+      printf("FAIL\n");
+      exit(1);
+   }
+   
+   printf("PASS\n");
+   return 0;
+}
@@ -0,0 +1,390 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Block read test for the legacy SQL driver.
+// Reads /foo/bar (mapped as in ../test-sql.xml) through the driver's ODBCHandler, over the ODBC-on-sqlite stand-in in
+// sqlite-odbc.cpp, and checks each block against the query's rows read straight from sqlite.  Each mode is one run of
+// the driver; the Makefile runs them in order, so later ones find the block index the earlier ones persisted.
+//
+//   sequential        make the database, and read every block in order
+//   restart N         read block N with the block index persisted by an earlier run, without going through the rows before it
+//   torn K N          zero out block K's persisted index entry (as a crash can leave it), check that loading the index
+//                     drops it and everything after it, and read block N
+//   cold N            read block N with no block index at all
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sqlite3.h>
+
+#include <string>
+
+#include "odbc-handler.h"
+
+using namespace std;
+
+#define FILE_PATH "/foo/bar"
+#define QUERY_BOUNDED "SELECT * FROM mytable WHERE id > 100 LIMIT %i OFFSET %i"
+#define QUERY_UNBOUNDED "SELECT * FROM mytable WHERE id > 100 LIMIT -1 OFFSET %i"
+#define QUERY_ALL "SELECT * FROM mytable WHERE id > 100"
+
+extern int sqlite_odbc_num_executes;
+extern long sqlite_odbc_num_rows;
+
+int global_num_failures = 0;
+
+#define CHECK( cond ) \
+   do { \
+      if( !(cond) ) { \
+         fprintf(stderr, "FAILED: %s\n", #cond ); \
+         global_num_failures++; \
+      } \
+   } while( 0 )
+
+
+void usage( char* progname ) {
+   fprintf(stderr, "Usage: %s SCRATCH_DIR NUM_ROWS [sequential | restart BLOCK_ID | torn HOLE_BLOCK_ID BLOCK_ID | cold BLOCK_ID]\n", progname );
+   exit(1);
+}
+
+
+// make the database: NUM_ROWS rows of mixed width, with a NULL in every 7th row (like mkfixture.sh, but the same every time)
+int make_database( char const* db_path, long num_rows ) {
+
+   sqlite3* db = NULL;
+   char* errmsg = NULL;
+   char sql[1024];
+
+   unlink( db_path );
+
+   if( sqlite3_open( db_path, &db ) != SQLITE_OK ) {
+      fprintf(stderr, "sqlite3_open(%s): %s\n", db_path, sqlite3_errmsg( db ) );
+      return -EIO;
+   }
+
+   snprintf( sql, sizeof(sql),
+             "CREATE TABLE mytable( id INTEGER PRIMARY KEY, name TEXT, value REAL, note TEXT );"
+             "WITH RECURSIVE n(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM n WHERE x < %ld) "
+             "INSERT INTO mytable SELECT x, 'name-' || x, x * 0.5, CASE WHEN x %% 7 = 0 THEN NULL "
+             "ELSE substr('0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef', 1 + x %% 16, (x %% 60) + 1) END FROM n;",
+             num_rows );
+
+   int rc = sqlite3_exec( db, sql, NULL, NULL, &errmsg );
+   if( rc != SQLITE_OK ) {
+      fprintf(stderr, "sqlite3_exec: %s\n", errmsg );
+      sqlite3_free( errmsg );
+   }
+
+   sqlite3_close( db );
+   return (rc == SQLITE_OK ? 0 : -EIO);
+}
+
+
+// what the driver should serve for /foo/bar: the query's rows, encoded the way ODBCHandler::encode_results does
+string expected_data( char const* db_path ) {
+
+   sqlite3* db = NULL;
+   sqlite3_stmt* stmt = NULL;
+   string data;
+
+   sqlite3_open_v2( db_path, &db, SQLITE_OPEN_READONLY, NULL );
+   sqlite3_prepare_v2( db, QUERY_ALL, -1, &stmt, NULL );
+
+   while( sqlite3_step( stmt ) == SQLITE_ROW ) {
+
+      int num_columns = sqlite3_column_count( stmt );
+
+      for( int i = 0; i < num_columns; i++ ) {
+
+         char const* value = (char const*)sqlite3_column_text( stmt, i );
+
+         // long values are truncated to fit the driver's column buffers
+         data += (value != NULL ? string( value ).substr( 0, ODBC_COLUMN_SIZE - 1 ) : string("NULL"));
+         data += (i == num_columns - 1 ? "\n" : ",");
+      }
+   }
+
+   sqlite3_finalize( stmt );
+   sqlite3_close( db );
+
+   return data;
+}
+
+
+// read a block of /foo/bar through the driver
+string read_block( ODBCHandler& odh, off_t block_id ) {
+
+   struct gateway_ctx ctx;
+   struct map_info mi;
+
+   memset( &ctx, 0, sizeof(ctx) );
+   memset( &mi, 0, sizeof(mi) );
+
+   ctx.file_path = FILE_PATH;
+   ctx.block_id = block_id;
+   ctx.sql_query_bounded = (unsigned char*)QUERY_BOUNDED;
+   ctx.sql_query_unbounded = (unsigned char*)QUERY_UNBOUNDED;
+
+   odh.execute_query( &ctx, &mi, 0 );
+
+   string block( ctx.data != NULL ? ctx.data : "", ctx.data_len );
+
+   free( ctx.data );
+
+   struct invalidation_info* inval = (struct invalidation_info*)mi.entry;
+   if( inval != NULL ) {
+      free( inval->file_path );
+      delete inval;
+   }
+
+   return block;
+}
+
+
+// check that the driver serves block_id as expected
+void check_block( ODBCHandler& odh, string const& expected, off_t block_id ) {
+
+   ssize_t block_size = AG_BLOCK_SIZE();
+
+   CHECK( (ssize_t)expected.size() > block_id * block_size );
+   if( (ssize_t)expected.size() <= block_id * block_size ) {
+      return;
+   }
+
+   string block = read_block( odh, block_id );
+
+   printf("block %ld: %zu bytes, %d queries, %ld rows fetched\n", (long)block_id, block.size(), sqlite_odbc_num_executes, sqlite_odbc_num_rows );
+
+   CHECK( block == expected.substr( block_id * block_size, block_size ) );
+}
+
+
+// how many of the query's rows start before block_id
+long rows_before_block( string const& expected, off_t block_id ) {
+
+   string before = expected.substr( 0, block_id * AG_BLOCK_SIZE() );
+   long num_rows = 0;
+
+   for( size_t i = 0; i < before.size(); i++ ) {
+      if( before[i] == '\n' ) {
+         num_rows++;
+      }
+   }
+
+   return num_rows;
+}
+
+
+// find the persisted block index in index_dir (there is only the one, for /foo/bar)
+string find_index_file( string const& index_dir ) {
+
+   string path;
+
+   DIR* dir = opendir( index_dir.c_str() );
+   if( dir == NULL ) {
+      return path;
+   }
+
+   struct dirent* dent = NULL;
+   while( (dent = readdir( dir )) != NULL ) {
+
+      size_t len = strlen( dent->d_name );
+      if( len > 4 && strcmp( dent->d_name + len - 4, ".idx" ) == 0 ) {
+         path = index_dir + "/" + dent->d_name;
+         break;
+      }
+   }
+
+   closedir( dir );
+   return path;
+}
+
+
+// remove index_dir and the block indexes in it
+void remove_index_dir( string const& index_dir ) {
+
+   string path;
+   while( !(path = find_index_file( index_dir )).empty() ) {
+      unlink( path.c_str() );
+   }
+
+   rmdir( index_dir.c_str() );
+}
+
+
+// zero out the persisted entry of hole_block_id, as if the entries after it were written and it wasn't when we crashed.
+// Then check that loading the index keeps only the entries before it, and cuts the rest off the file.
+void tear_index( string const& index_dir, off_t hole_block_id ) {
+
+   string path = find_index_file( index_dir );
+
+   CHECK( !path.empty() );
+   if( path.empty() ) {
+      return;
+   }
+
+   off_t entries_offset = sizeof(block_index_header) + strlen( FILE_PATH );
+   block_index_entry zero;
+   struct stat sb;
+
+   memset( &zero, 0, sizeof(zero) );
+
+   int fd = open( path.c_str(), O_RDWR );
+   CHECK( fd >= 0 );
+   if( fd < 0 ) {
+      return;
+   }
+
+   fstat( fd, &sb );
+
+   // the index must have entries past the hole, or there's nothing to cut off
+   CHECK( sb.st_size > entries_offset + (off_t)((hole_block_id + 1) * sizeof(block_index_entry)) );
+
+   CHECK( pwrite( fd, &zero, sizeof(zero), entries_offset + hole_block_id * sizeof(block_index_entry) ) == sizeof(zero) );
+   close( fd );
+
+   BlockIndex blk_index;
+   block_index_entry last_blkie;
+   off_t last_block_id = -1;
+
+   blk_index.set_index_dir( index_dir.c_str() );
+   blk_index.open_block_index( FILE_PATH, string(QUERY_UNBOUNDED) + "\n" + QUERY_BOUNDED );
+
+   bool found = blk_index.get_last_block( FILE_PATH, &last_block_id, &last_blkie );
+
+   printf("index torn at block %ld: last indexed block is %ld\n", (long)hole_block_id, (long)(found ? last_block_id : -1) );
+
+   if( hole_block_id > 0 ) {
+      CHECK( found && last_block_id == hole_block_id - 1 );
+   }
+   else {
+      CHECK( !found );
+   }
+
+   stat( path.c_str(), &sb );
+   CHECK( sb.st_size == entries_offset + (off_t)(hole_block_id * sizeof(block_index_entry)) );
+}
+
+
+int main( int argc, char** argv ) {
+
+   if( argc < 4 ) {
+      usage( argv[0] );
+   }
+
+   string scratch_dir( argv[1] );
+   long num_rows = strtol( argv[2], NULL, 10 );
+   string mode( argv[3] );
+
+   string db_path = scratch_dir + "/test.db";
+   string index_dir = scratch_dir + "/sql-block-index";
+   string dsn = string("DSN=") + db_path;
+
+   mkdir( scratch_dir.c_str(), 0700 );
+
+   if( mode == "sequential" ) {
+
+      remove_index_dir( index_dir );
+
+      if( make_database( db_path.c_str(), num_rows ) != 0 ) {
+         exit(1);
+      }
+   }
+   else if( mode == "cold" ) {
+      remove_index_dir( index_dir );
+   }
+
+   string expected = expected_data( db_path.c_str() );
+   if( expected.empty() ) {
+      fprintf(stderr, "No rows in %s; run the sequential test first\n", db_path.c_str() );
+      exit(1);
+   }
+
+   if( mode == "torn" ) {
+
+      if( argc != 6 ) {
+         usage( argv[0] );
+      }
+
+      tear_index( index_dir, strtol( argv[4], NULL, 10 ) );
+   }
+
+   ODBCHandler& odh = ODBCHandler::get_handle( (unsigned char*)dsn.c_str() );
+   odh.set_index_dir( index_dir.c_str() );
+
+   if( mode == "sequential" ) {
+
+      // every block, in order, must add up to the whole result set
+      string data;
+      off_t num_blocks = 0;
+
+      while( true ) {
+
+         string block = read_block( odh, num_blocks );
+         if( block.empty() ) {
+            break;
+         }
+
+         data += block;
+         num_blocks++;
+      }
+
+      printf("sequential: %ld blocks, %zu bytes, %d queries, %ld of %ld rows fetched\n", (long)num_blocks, data.size(), sqlite_odbc_num_executes, sqlite_odbc_num_rows, rows_before_block( expected, num_blocks ) );
+
+      CHECK( data == expected );
+      CHECK( num_blocks == (off_t)((expected.size() + AG_BLOCK_SIZE() - 1) / AG_BLOCK_SIZE()) );
+      CHECK( !find_index_file( index_dir ).empty() );
+   }
+   else if( mode == "restart" || mode == "cold" ) {
+
+      if( argc != 5 ) {
+         usage( argv[0] );
+      }
+
+      off_t block_id = strtol( argv[4], NULL, 10 );
+
+      if( mode == "restart" ) {
+         CHECK( !find_index_file( index_dir ).empty() );
+      }
+
+      check_block( odh, expected, block_id );
+
+      if( mode == "restart" ) {
+         // the persisted index says where block_id starts, so the rows before it are skipped
+         CHECK( sqlite_odbc_num_rows < rows_before_block( expected, block_id ) );
+      }
+   }
+   else if( mode == "torn" ) {
+
+      check_block( odh, expected, strtol( argv[5], NULL, 10 ) );
+   }
+   else {
+      usage( argv[0] );
+   }
+
+   if( global_num_failures != 0 ) {
+      printf("%s: %d checks failed\n", mode.c_str(), global_num_failures );
+      return 1;
+   }
+
+   printf("%s: all checks passed\n", mode.c_str() );
+   return 0;
+}
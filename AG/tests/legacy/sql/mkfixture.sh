@@ -0,0 +1,53 @@
+#!/bin/sh
+
+# Make a SQLite database for the SQL AG driver, and the ODBC configuration that serves it through the SQLite3 ODBC
+# driver under the DSN "sqlite" (the DSN ../test-sql.xml uses).  mytable gets NUM_ROWS rows of mixed width, with
+# a NULL in every 7th row.
+# Usage: mkfixture.sh FIXTURE_DIR NUM_ROWS
+# Then: export ODBCSYSINI=FIXTURE_DIR ODBCINI=FIXTURE_DIR/odbc.ini
+
+if [ $# -ne 2 ]; then
+   echo "Usage: $0 FIXTURE_DIR NUM_ROWS" >&2
+   exit 1
+fi
+
+DIR=$(mkdir -p $1 && cd $1 && pwd) || exit 1
+NUM_ROWS=$2
+
+# libsqlite3odbc (Debian/Ubuntu: libsqliteodbc, Fedora: sqliteodbc)
+if [ -z "$SQLITE3_ODBC_DRIVER" ]; then
+   for lib in /usr/lib/x86_64-linux-gnu/odbc/libsqlite3odbc.so /usr/lib/odbc/libsqlite3odbc.so /usr/lib64/libsqlite3odbc.so /usr/local/lib/libsqlite3odbc.so; do
+      if [ -f $lib ]; then
+         SQLITE3_ODBC_DRIVER=$lib
+         break
+      fi
+   done
+fi
+
+if [ -z "$SQLITE3_ODBC_DRIVER" ]; then
+   echo "No SQLite3 ODBC driver found; install it, or set SQLITE3_ODBC_DRIVER to libsqlite3odbc.so" >&2
+   exit 1
+fi
+
+rm -f $DIR/test.db
+
+sqlite3 $DIR/test.db <<EOSQL || exit 1
+CREATE TABLE mytable( id INTEGER PRIMARY KEY, name TEXT, value REAL, note TEXT );
+WITH RECURSIVE n(x) AS (SELECT 1 UNION ALL SELECT x + 1 FROM n WHERE x < $NUM_ROWS)
+INSERT INTO mytable SELECT x, 'name-' || x, x * 0.5, CASE WHEN x % 7 = 0 THEN NULL ELSE substr(hex(randomblob(40)), 1, (x % 60) + 1) END FROM n;
+EOSQL
+
+cat > $DIR/odbcinst.ini <<EOINI
+[SQLite3]
+Description = SQLite3 ODBC driver
+Driver = $SQLITE3_ODBC_DRIVER
+EOINI
+
+cat > $DIR/odbc.ini <<EOINI
+[sqlite]
+Description = SQL AG test database
+Driver = SQLite3
+Database = $DIR/test.db
+EOINI
+
+echo "export ODBCSYSINI=$DIR ODBCINI=$DIR/odbc.ini"
@@ -0,0 +1,279 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// The ODBC calls the legacy SQL driver's ODBCHandler makes, implemented over libsqlite3.
+// The connection string is "DSN=/path/to/database.db".  Statements support column-wise binding of SQL_C_CHAR columns
+// and block cursors (SQL_ATTR_ROW_ARRAY_SIZE rows per SQLFetch), which is how the ODBCHandler reads rows.  We count
+// executed statements and fetched rows, so a test can tell how much of a table a read went through.
+
+#include <stdlib.h>
+#include <string.h>
+#include <sqlite3.h>
+
+#include <string>
+#include <vector>
+
+#include "sql.h"
+#include "sqlext.h"
+
+using namespace std;
+
+int sqlite_odbc_num_executes = 0;
+long sqlite_odbc_num_rows = 0;
+
+struct sqlite_odbc_dbc {
+   sqlite3* db;
+};
+
+struct sqlite_odbc_column {
+   char* buf;
+   SQLLEN buf_len;
+   SQLLEN* indicators;
+};
+
+struct sqlite_odbc_stmt {
+   struct sqlite_odbc_dbc* dbc;
+   sqlite3_stmt* stmt;
+
+   SQLULEN rowset_size;
+   SQLULEN* rows_fetched;
+   SQLUSMALLINT* row_status;
+
+   vector<struct sqlite_odbc_column> columns;
+   bool done;
+};
+
+SQLRETURN SQLAllocHandle( SQLSMALLINT type, SQLHANDLE input, SQLHANDLE* output ) {
+
+   if( type == SQL_HANDLE_STMT ) {
+
+      struct sqlite_odbc_stmt* s = new struct sqlite_odbc_stmt();
+      s->dbc = (struct sqlite_odbc_dbc*)input;
+      s->stmt = NULL;
+      s->rowset_size = 1;
+      s->rows_fetched = NULL;
+      s->row_status = NULL;
+      s->done = false;
+
+      *output = s;
+   }
+   else if( type == SQL_HANDLE_DBC ) {
+
+      struct sqlite_odbc_dbc* d = new struct sqlite_odbc_dbc();
+      d->db = NULL;
+
+      *output = d;
+   }
+   else {
+      // environments hold nothing
+      *output = (SQLHANDLE)1;
+   }
+
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQLFreeHandle( SQLSMALLINT type, SQLHANDLE handle ) {
+
+   if( type == SQL_HANDLE_STMT ) {
+
+      struct sqlite_odbc_stmt* s = (struct sqlite_odbc_stmt*)handle;
+      if( s->stmt != NULL ) {
+         sqlite3_finalize( s->stmt );
+      }
+
+      delete s;
+   }
+   else if( type == SQL_HANDLE_DBC ) {
+
+      struct sqlite_odbc_dbc* d = (struct sqlite_odbc_dbc*)handle;
+      if( d->db != NULL ) {
+         sqlite3_close( d->db );
+      }
+
+      delete d;
+   }
+
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQLSetEnvAttr( SQLHENV env, SQLINTEGER attr, SQLPOINTER value, SQLINTEGER value_len ) {
+   return SQL_SUCCESS;
+}
+
+// connect to the database named by "DSN=/path/to/database.db"
+SQLRETURN SQLDriverConnect( SQLHDBC dbc, SQLHWND window, SQLCHAR* con_str, SQLSMALLINT con_str_len, SQLCHAR* out_con_str, SQLSMALLINT out_con_str_len, SQLSMALLINT* out_len, SQLUSMALLINT completion ) {
+
+   struct sqlite_odbc_dbc* d = (struct sqlite_odbc_dbc*)dbc;
+
+   char const* path = strchr( (char const*)con_str, '=' );
+   if( path == NULL ) {
+      return SQL_ERROR;
+   }
+
+   string db_path( path + 1 );
+   if( !db_path.empty() && db_path[ db_path.size() - 1 ] == ';' ) {
+      db_path.erase( db_path.size() - 1 );
+   }
+
+   if( sqlite3_open_v2( db_path.c_str(), &d->db, SQLITE_OPEN_READONLY, NULL ) != SQLITE_OK ) {
+      return SQL_ERROR;
+   }
+
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQLSetStmtAttr( SQLHSTMT stmt, SQLINTEGER attr, SQLPOINTER value, SQLINTEGER value_len ) {
+
+   struct sqlite_odbc_stmt* s = (struct sqlite_odbc_stmt*)stmt;
+
+   if( attr == SQL_ATTR_ROW_ARRAY_SIZE ) {
+      s->rowset_size = (SQLULEN)value;
+   }
+   else if( attr == SQL_ATTR_ROWS_FETCHED_PTR ) {
+      s->rows_fetched = (SQLULEN*)value;
+   }
+   else if( attr == SQL_ATTR_ROW_STATUS_PTR ) {
+      s->row_status = (SQLUSMALLINT*)value;
+   }
+
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQLGetStmtAttr( SQLHSTMT stmt, SQLINTEGER attr, SQLPOINTER value, SQLINTEGER value_len, SQLINTEGER* len ) {
+
+   struct sqlite_odbc_stmt* s = (struct sqlite_odbc_stmt*)stmt;
+
+   if( attr == SQL_ATTR_ROW_ARRAY_SIZE ) {
+      *(SQLULEN*)value = s->rowset_size;
+   }
+
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQLPrepare( SQLHSTMT stmt, SQLCHAR* query, SQLINTEGER query_len ) {
+
+   struct sqlite_odbc_stmt* s = (struct sqlite_odbc_stmt*)stmt;
+
+   if( sqlite3_prepare_v2( s->dbc->db, (char const*)query, -1, &s->stmt, NULL ) != SQLITE_OK ) {
+      return SQL_ERROR;
+   }
+
+   return SQL_SUCCESS;
+}
+
+// sqlite runs the statement as rows are fetched
+SQLRETURN SQLExecute( SQLHSTMT stmt ) {
+
+   sqlite_odbc_num_executes++;
+   return SQL_SUCCESS;
+}
+
+SQLRETURN SQLNumResultCols( SQLHSTMT stmt, SQLSMALLINT* nr_columns ) {
+
+   struct sqlite_odbc_stmt* s = (struct sqlite_odbc_stmt*)stmt;
+
+   *nr_columns = (s->stmt != NULL ? sqlite3_column_count( s->stmt ) : 0);
+   return SQL_SUCCESS;
+}
+
+// bind a column to an array of rowset_size buffers of buf_len bytes each
+SQLRETURN SQLBindCol( SQLHSTMT stmt, SQLUSMALLINT column, SQLSMALLINT type, SQLPOINTER buf, SQLLEN buf_len, SQLLEN* indicators ) {
+
+   struct sqlite_odbc_stmt* s = (struct sqlite_odbc_stmt*)stmt;
+
+   if( type != SQL_C_CHAR || column < 1 ) {
+      return SQL_ERROR;
+   }
+
+   if( s->columns.size() < column ) {
+      s->columns.resize( column );
+   }
+
+   struct sqlite_odbc_column& c = s->columns[ column - 1 ];
+   c.buf = (char*)buf;
+   c.buf_len = buf_len;
+   c.indicators = indicators;
+
+   return SQL_SUCCESS;
+}
+
+// fetch up to rowset_size rows into the bound columns.  Values too long for their buffer are truncated, like ODBC does.
+SQLRETURN SQLFetch( SQLHSTMT stmt ) {
+
+   struct sqlite_odbc_stmt* s = (struct sqlite_odbc_stmt*)stmt;
+   SQLULEN n = 0;
+
+   if( s->stmt == NULL || s->done ) {
+      return SQL_NO_DATA;
+   }
+
+   for( n = 0; n < s->rowset_size; n++ ) {
+
+      if( sqlite3_step( s->stmt ) != SQLITE_ROW ) {
+         s->done = true;
+         break;
+      }
+
+      sqlite_odbc_num_rows++;
+
+      for( size_t i = 0; i < s->columns.size(); i++ ) {
+
+         struct sqlite_odbc_column& c = s->columns[i];
+         char* dest = c.buf + (n * c.buf_len);
+         char const* value = (char const*)sqlite3_column_text( s->stmt, i );
+
+         if( value == NULL ) {
+            c.indicators[n] = SQL_NULL_DATA;
+            continue;
+         }
+
+         size_t len = strlen( value );
+         size_t copy_len = (len < (size_t)c.buf_len - 1 ? len : (size_t)c.buf_len - 1);
+
+         memcpy( dest, value, copy_len );
+         dest[ copy_len ] = 0;
+
+         c.indicators[n] = len;
+      }
+
+      if( s->row_status != NULL ) {
+         s->row_status[n] = SQL_ROW_SUCCESS;
+      }
+   }
+
+   if( s->rows_fetched != NULL ) {
+      *s->rows_fetched = n;
+   }
+
+   return (n > 0 ? SQL_SUCCESS : SQL_NO_DATA);
+}
+
+// only used for table listings, which the test doesn't read
+SQLRETURN SQLGetData( SQLHSTMT stmt, SQLUSMALLINT column, SQLSMALLINT type, SQLPOINTER buf, SQLLEN buf_len, SQLLEN* indicator ) {
+   return SQL_ERROR;
+}
+
+SQLRETURN SQLGetDiagRec( SQLSMALLINT type, SQLHANDLE handle, SQLSMALLINT rec, SQLCHAR* state, SQLINTEGER* native, SQLCHAR* text, SQLSMALLINT text_len, SQLSMALLINT* len ) {
+   return SQL_NO_DATA;
+}
+
+SQLRETURN SQLGetInfo( SQLHDBC dbc, SQLUSMALLINT type, SQLPOINTER buf, SQLSMALLINT buf_len, SQLSMALLINT* len ) {
+   return SQL_ERROR;
+}
+
+SQLRETURN SQLTables( SQLHSTMT stmt, SQLCHAR* catalog, SQLSMALLINT catalog_len, SQLCHAR* schema, SQLSMALLINT schema_len, SQLCHAR* table, SQLSMALLINT table_len, SQLCHAR* type, SQLSMALLINT type_len ) {
+   return SQL_ERROR;
+}
@@ -0,0 +1,27 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// The part of the legacy AG's map-parser.h that the ODBCHandler uses, for the block-read test.
+
+#ifndef _STUB_MAP_PARSER_H_
+#define _STUB_MAP_PARSER_H_
+
+struct map_info {
+   void* entry;
+   void (*invalidate_entry)( void* );
+};
+
+#endif
@@ -0,0 +1,78 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Just enough of the ODBC API for the legacy SQL driver's ODBCHandler, implemented over libsqlite3 by
+// ../sqlite-odbc.cpp.  Stands in for unixODBC's sql.h, so the block-read test needs neither unixODBC nor an ODBC driver.
+
+#ifndef _STUB_SQL_H_
+#define _STUB_SQL_H_
+
+#include <stdint.h>
+
+typedef void* SQLHANDLE;
+typedef SQLHANDLE SQLHENV;
+typedef SQLHANDLE SQLHDBC;
+typedef SQLHANDLE SQLHSTMT;
+typedef void* SQLHWND;
+typedef void* SQLPOINTER;
+
+typedef short SQLSMALLINT;
+typedef unsigned short SQLUSMALLINT;
+typedef int SQLINTEGER;
+typedef unsigned int SQLUINTEGER;
+typedef long SQLLEN;
+typedef unsigned long SQLULEN;
+typedef unsigned char SQLCHAR;
+typedef SQLSMALLINT SQLRETURN;
+
+#define SQL_SUCCESS 0
+#define SQL_SUCCESS_WITH_INFO 1
+#define SQL_ERROR (-1)
+#define SQL_NO_DATA 100
+#define SQL_SUCCEEDED( rc ) (((rc) & (~1)) == 0)
+
+#define SQL_HANDLE_ENV 1
+#define SQL_HANDLE_DBC 2
+#define SQL_HANDLE_STMT 3
+#define SQL_NULL_HANDLE 0
+
+#define SQL_NTS (-3)
+#define SQL_NULL_DATA (-1)
+#define SQL_C_CHAR 1
+
+#define SQL_ROW_SUCCESS 0
+#define SQL_ROW_NOROW 3
+
+#define SQL_MAX_CONCURRENT_ACTIVITIES 1
+#define SQL_DBMS_NAME 17
+#define SQL_DBMS_VER 18
+#define SQL_GETDATA_EXTENSIONS 81
+#define SQL_GD_ANY_COLUMN 1
+#define SQL_GD_ANY_ORDER 2
+
+SQLRETURN SQLAllocHandle( SQLSMALLINT type, SQLHANDLE input, SQLHANDLE* output );
+SQLRETURN SQLFreeHandle( SQLSMALLINT type, SQLHANDLE handle );
+SQLRETURN SQLPrepare( SQLHSTMT stmt, SQLCHAR* query, SQLINTEGER query_len );
+SQLRETURN SQLExecute( SQLHSTMT stmt );
+SQLRETURN SQLNumResultCols( SQLHSTMT stmt, SQLSMALLINT* nr_columns );
+SQLRETURN SQLBindCol( SQLHSTMT stmt, SQLUSMALLINT column, SQLSMALLINT type, SQLPOINTER buf, SQLLEN buf_len, SQLLEN* indicators );
+SQLRETURN SQLFetch( SQLHSTMT stmt );
+SQLRETURN SQLGetData( SQLHSTMT stmt, SQLUSMALLINT column, SQLSMALLINT type, SQLPOINTER buf, SQLLEN buf_len, SQLLEN* indicator );
+SQLRETURN SQLGetDiagRec( SQLSMALLINT type, SQLHANDLE handle, SQLSMALLINT rec, SQLCHAR* state, SQLINTEGER* native, SQLCHAR* text, SQLSMALLINT text_len, SQLSMALLINT* len );
+SQLRETURN SQLGetInfo( SQLHDBC dbc, SQLUSMALLINT type, SQLPOINTER buf, SQLSMALLINT buf_len, SQLSMALLINT* len );
+SQLRETURN SQLTables( SQLHSTMT stmt, SQLCHAR* catalog, SQLSMALLINT catalog_len, SQLCHAR* schema, SQLSMALLINT schema_len, SQLCHAR* table, SQLSMALLINT table_len, SQLCHAR* type, SQLSMALLINT type_len );
+
+#endif
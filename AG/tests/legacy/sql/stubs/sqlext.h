@@ -0,0 +1,40 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Stands in for unixODBC's sqlext.h; see sql.h.
+
+#ifndef _STUB_SQLEXT_H_
+#define _STUB_SQLEXT_H_
+
+#include "sql.h"
+
+#define SQL_ATTR_ODBC_VERSION 200
+#define SQL_OV_ODBC3 3UL
+
+#define SQL_DRIVER_COMPLETE 1
+
+#define SQL_ATTR_ROW_BIND_TYPE 5
+#define SQL_BIND_BY_COLUMN 0UL
+#define SQL_ATTR_ROW_STATUS_PTR 25
+#define SQL_ATTR_ROWS_FETCHED_PTR 26
+#define SQL_ATTR_ROW_ARRAY_SIZE 27
+
+SQLRETURN SQLSetEnvAttr( SQLHENV env, SQLINTEGER attr, SQLPOINTER value, SQLINTEGER value_len );
+SQLRETURN SQLDriverConnect( SQLHDBC dbc, SQLHWND window, SQLCHAR* con_str, SQLSMALLINT con_str_len, SQLCHAR* out_con_str, SQLSMALLINT out_con_str_len, SQLSMALLINT* out_len, SQLUSMALLINT completion );
+SQLRETURN SQLSetStmtAttr( SQLHSTMT stmt, SQLINTEGER attr, SQLPOINTER value, SQLINTEGER value_len );
+SQLRETURN SQLGetStmtAttr( SQLHSTMT stmt, SQLINTEGER attr, SQLPOINTER value, SQLINTEGER value_len, SQLINTEGER* len );
+
+#endif
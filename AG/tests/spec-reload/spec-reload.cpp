@@ -0,0 +1,366 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Spec file reload benchmark.
+// Generates a spec file with NUM_DIRS directories of FILES_PER_DIR files each, loads it, and then edits NUM_EDITS files'
+// permissions, adds a file, and removes one.  The edited spec is then reloaded both ways the AG can:  in full (parse,
+// validate, carry over cached data, and diff against the current fs), and incrementally (diff the spec's hashes, parse
+// the changed Pairs, and apply them).  Both must end up with the same fs.  MS requests are not part of either timing.
+
+#include "AG/map-parser-xml.h"
+#include "AG/map-info.h"
+#include "AG/core.h"
+
+#define BENCH_QUERY_TYPE "bench"
+
+// map-info.cpp and map-parser-xml.cpp need these from the rest of the AG.  We never call into a driver.
+struct AG_driver* AG_lookup_driver( AG_driver_map_t* driver_map, char const* driver_query_type ) {
+   
+   AG_driver_map_t::iterator itr = driver_map->find( string(driver_query_type) );
+   if( itr == driver_map->end() ) {
+      return NULL;
+   }
+   
+   return itr->second;
+}
+
+char* AG_driver_get_query_type( struct AG_driver* driver ) {
+   return strdup( BENCH_QUERY_TYPE );
+}
+
+int AG_driver_stat( struct AG_driver* driver, char const* path, struct AG_map_info* mi, struct AG_driver_publish_info* pub_info ) {
+   return -ENOSYS;
+}
+
+struct AG_state* AG_get_state() {
+   return NULL;
+}
+
+void AG_release_state( struct AG_state* state ) {
+   return;
+}
+
+
+// one Pair
+struct bench_entry {
+   string path;
+   bool dir;
+   mode_t perm;
+};
+
+// generate spec file text
+static string bench_spec_text( vector<struct bench_entry>& entries ) {
+   
+   string text = "<?xml version=\"1.0\"?>\n<Map>\n   <Config>\n      <bench>true</bench>\n   </Config>\n";
+   char perm_buf[16];
+   
+   for( unsigned int i = 0; i < entries.size(); i++ ) {
+      
+      char const* tag = (entries[i].dir ? AG_TAG_DIR_NAME : AG_TAG_FILE_NAME);
+      sprintf( perm_buf, "%o", entries[i].perm );
+      
+      text += "   <Pair reval=\"1h\">\n";
+      text += string("      <") + tag + " perm=\"" + perm_buf + "\">" + entries[i].path + "</" + tag + ">\n";
+      text += "      <Query type=\"" BENCH_QUERY_TYPE "\">" + entries[i].path + "</Query>\n";
+      text += "   </Pair>\n";
+   }
+   
+   text += "</Map>\n";
+   return text;
+}
+
+static bool bench_mi_equ( struct AG_map_info* mi1, struct AG_map_info* mi2 ) {
+   
+   return (mi1->driver == mi2->driver && mi1->file_perm == mi2->file_perm && mi1->reval_sec == mi2->reval_sec && mi1->type == mi2->type &&
+           strcmp( mi1->query_string, mi2->query_string ) == 0);
+}
+
+static double bench_now_ms() {
+   
+   struct timespec ts;
+   clock_gettime( CLOCK_MONOTONIC, &ts );
+   
+   return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// load the spec text in full, as the AG does at startup
+static int bench_load( struct AG_state* state, string const& text, struct AG_fs* ag_fs, AG_config_t** config, struct AG_spec_snapshot** snapshot ) {
+   
+   AG_fs_map_t* fs_map = NULL;
+   
+   int rc = AG_parse_spec_snapshot( state, text.data(), text.size(), &fs_map, config, snapshot );
+   if( rc != 0 ) {
+      fprintf(stderr, "AG_parse_spec_snapshot rc = %d\n", rc );
+      return rc;
+   }
+   
+   rc = AG_validate_map_info( fs_map );
+   if( rc != 0 ) {
+      fprintf(stderr, "AG_validate_map_info rc = %d\n", rc );
+      return rc;
+   }
+   
+   return AG_fs_init( ag_fs, fs_map, NULL );
+}
+
+// reload the spec text in full, as AG_reload_all does
+static int bench_reload_all( struct AG_state* state, string const& text, struct AG_fs* ag_fs ) {
+   
+   struct AG_fs new_fs;
+   AG_config_t* config = NULL;
+   struct AG_spec_snapshot* snapshot = NULL;
+   AG_fs_map_t to_publish, to_remain, to_update, to_delete;
+   
+   int rc = bench_load( state, text, &new_fs, &config, &snapshot );
+   if( rc != 0 ) {
+      return rc;
+   }
+   
+   AG_fs_copy_cached_data( &new_fs, ag_fs, AG_map_info_copy_MS_data );
+   AG_fs_copy_cached_data( &new_fs, ag_fs, AG_map_info_copy_driver_data );
+   AG_fs_copy_cached_data( &new_fs, ag_fs, AG_map_info_copy_AG_data );
+   
+   rc = AG_fs_map_transforms( ag_fs->fs, new_fs.fs, &to_publish, &to_remain, &to_update, &to_delete, bench_mi_equ );
+   if( rc != 0 ) {
+      fprintf(stderr, "AG_fs_map_transforms rc = %d\n", rc );
+      return rc;
+   }
+   
+   printf("   full:        %zu to publish, %zu to update, %zu to delete\n", to_publish.size(), to_update.size(), to_delete.size() );
+   
+   // swap it in 
+   AG_fs_map_t* old_fs_map = ag_fs->fs;
+   ag_fs->fs = new_fs.fs;
+   new_fs.fs = old_fs_map;
+   
+   AG_fs_free( &new_fs );
+   
+   delete config;
+   AG_spec_snapshot_free( snapshot );
+   return 0;
+}
+
+// reload only the changed parts of the spec text, as AG_reload_changes does
+static int bench_reload_changes( struct AG_state* state, string const& text, struct AG_fs* ag_fs, struct AG_spec_snapshot** snapshot ) {
+   
+   AG_fs_map_t* changed = NULL;
+   AG_config_t* config = NULL;
+   struct AG_spec_snapshot* new_snapshot = NULL;
+   vector<string> removed;
+   AG_fs_map_t to_publish, to_remain, to_update, to_delete;
+   
+   if( AG_spec_snapshot_matches( *snapshot, text.data(), text.size() ) ) {
+      return 0;
+   }
+   
+   int rc = AG_parse_spec_changes( state, text.data(), text.size(), *snapshot, &changed, &config, &removed, &new_snapshot );
+   if( rc != 0 ) {
+      fprintf(stderr, "AG_parse_spec_changes rc = %d\n", rc );
+      return rc;
+   }
+   
+   rc = AG_fs_map_changes( ag_fs->fs, changed, &removed, &to_publish, &to_remain, &to_update, &to_delete, bench_mi_equ );
+   if( rc != 0 ) {
+      fprintf(stderr, "AG_fs_map_changes rc = %d\n", rc );
+      return rc;
+   }
+   
+   rc = AG_validate_map_info_changes( ag_fs->fs, changed, &to_delete );
+   if( rc != 0 ) {
+      fprintf(stderr, "AG_validate_map_info_changes rc = %d\n", rc );
+      return rc;
+   }
+   
+   printf("   incremental: %zu to publish, %zu to update, %zu to delete\n", to_publish.size(), to_update.size(), to_delete.size() );
+   
+   AG_fs_map_apply_changes( ag_fs->fs, changed, &to_delete );
+   delete changed;
+   
+   if( config != NULL ) {
+      delete config;
+   }
+   
+   AG_spec_snapshot_free( *snapshot );
+   *snapshot = new_snapshot;
+   return 0;
+}
+
+// do two fs maps have the same entries?
+static bool bench_same_fs( AG_fs_map_t* fs1, AG_fs_map_t* fs2 ) {
+   
+   if( fs1->size() != fs2->size() ) {
+      return false;
+   }
+   
+   for( AG_fs_map_t::iterator itr1 = fs1->begin(), itr2 = fs2->begin(); itr1 != fs1->end(); itr1++, itr2++ ) {
+      
+      if( itr1->first != itr2->first || !bench_mi_equ( itr1->second, itr2->second ) ) {
+         
+         fprintf(stderr, "%s differs\n", itr1->first.c_str() );
+         return false;
+      }
+   }
+   
+   return true;
+}
+
+void usage( char* progname ) {
+   fprintf(stderr, "Usage: %s NUM_DIRS FILES_PER_DIR NUM_EDITS\n", progname );
+   exit(1);
+}
+
+int main( int argc, char** argv ) {
+   
+   if( argc != 4 ) {
+      usage( argv[0] );
+   }
+   
+   int num_dirs = atoi( argv[1] );
+   int files_per_dir = atoi( argv[2] );
+   int num_edits = atoi( argv[3] );
+   
+   if( num_dirs <= 0 || files_per_dir <= 1 || num_edits < 0 ) {
+      usage( argv[0] );
+   }
+   
+   struct AG_state state;
+   struct AG_driver driver;
+   
+   memset( &state, 0, sizeof(struct AG_state) );
+   memset( &driver, 0, sizeof(struct AG_driver) );
+   
+   state.drivers = new AG_driver_map_t();
+   (*state.drivers)[ string(BENCH_QUERY_TYPE) ] = &driver;
+   
+   // generate the spec 
+   vector<struct bench_entry> entries;
+   char path_buf[100];
+   
+   struct bench_entry root = { "/", true, 0555 };
+   entries.push_back( root );
+   
+   for( int i = 0; i < num_dirs; i++ ) {
+      
+      sprintf( path_buf, "/dir-%d", i );
+      
+      struct bench_entry dir = { path_buf, true, 0555 };
+      entries.push_back( dir );
+      
+      for( int j = 0; j < files_per_dir; j++ ) {
+         
+         sprintf( path_buf, "/dir-%d/file-%d", i, j );
+         
+         struct bench_entry file = { path_buf, false, 0444 };
+         entries.push_back( file );
+      }
+   }
+   
+   string text = bench_spec_text( entries );
+   
+   printf("Spec file: %zu entries, %zu bytes\n", entries.size(), text.size() );
+   
+   struct AG_fs full_fs, incremental_fs;
+   AG_config_t* config = NULL;
+   struct AG_spec_snapshot* snapshot = NULL;
+   
+   double start = bench_now_ms();
+   
+   int rc = bench_load( &state, text, &full_fs, &config, &snapshot );
+   if( rc != 0 ) {
+      exit(1);
+   }
+   
+   printf("Initial load: %.1f ms\n", bench_now_ms() - start );
+   
+   delete config;
+   AG_spec_snapshot_free( snapshot );
+   
+   rc = bench_load( &state, text, &incremental_fs, &config, &snapshot );
+   if( rc != 0 ) {
+      exit(1);
+   }
+   
+   if( snapshot == NULL ) {
+      fprintf(stderr, "%s", "Spec file can't be reloaded incrementally\n");
+      exit(1);
+   }
+   
+   // unchanged reload 
+   start = bench_now_ms();
+   
+   rc = bench_reload_changes( &state, text, &incremental_fs, &snapshot );
+   if( rc != 0 ) {
+      exit(1);
+   }
+   
+   printf("Unchanged reload: %.1f ms (incremental)\n", bench_now_ms() - start );
+   
+   // edit the spec: change some permissions, add a file, and remove one 
+   for( int i = 0; i < num_edits; i++ ) {
+      
+      // spread them out (a directory's first file follows it)
+      struct bench_entry* e = &entries[ 2 + ((uint64_t)(i + 1) * (entries.size() - 2)) / (num_edits + 1) ];
+      
+      if( e->dir ) {
+         e++;
+      }
+      
+      e->perm = (e->perm == 0444 ? 0440 : 0444);
+   }
+   
+   struct bench_entry added = { "/dir-0/added", false, 0444 };
+   entries.push_back( added );
+   
+   entries.erase( entries.begin() + 2 );
+   
+   text = bench_spec_text( entries );
+   
+   start = bench_now_ms();
+   
+   rc = bench_reload_all( &state, text, &full_fs );
+   if( rc != 0 ) {
+      exit(1);
+   }
+   
+   double full_ms = bench_now_ms() - start;
+   
+   start = bench_now_ms();
+   
+   rc = bench_reload_changes( &state, text, &incremental_fs, &snapshot );
+   if( rc != 0 ) {
+      exit(1);
+   }
+   
+   double incremental_ms = bench_now_ms() - start;
+   
+   printf("Reload after edits: %.1f ms (full), %.1f ms (incremental), %.1fx\n", full_ms, incremental_ms, full_ms / incremental_ms );
+   
+   if( !bench_same_fs( full_fs.fs, incremental_fs.fs ) ) {
+      
+      fprintf(stderr, "%s", "FAIL: full and incremental reloads disagree\n");
+      exit(1);
+   }
+   
+   printf("%s", "PASS\n");
+   
+   AG_fs_free( &full_fs );
+   AG_fs_free( &incremental_fs );
+   AG_spec_snapshot_free( snapshot );
+   delete config;
+   delete state.drivers;
+   
+   return 0;
+}
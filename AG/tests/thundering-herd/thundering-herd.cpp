@@ -0,0 +1,289 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Thundering-herd benchmark for a running AG.
+// Point it at a file the AG publishes (i.e. one from tests/test-disk-big.xml, served by the disk driver), on an AG
+// whose block cache is cold.  For each of the first NUM_BLOCKS blocks, one client fetches it alone; then, for each of
+// the next NUM_BLOCKS blocks, NUM_CLIENTS clients fetch it at the same time.  Since the AG generates an uncached block
+// once no matter how many requests for it arrive together, a herd should take about as long as a lone fetch, instead
+// of NUM_CLIENTS driver reads and signatures.  Every client in a herd must get back the same bytes.
+//
+// We don't need to know the file's ID or versions:  we ask for the block with made-up ones, and the AG redirects us
+// to the current URL.
+
+#include "libsyndicate/libsyndicate.h"
+#include "libsyndicate/url.h"
+
+#define HERD_MAX_TRIES 10
+
+char const* global_ag_url = NULL;
+uint64_t global_volume_id = 0;
+char const* global_fs_path = NULL;
+
+pthread_barrier_t global_barrier;
+
+// one client's fetch
+struct herd_fetch {
+   char const* url;
+
+   long http_status;
+   char* buf;
+   size_t len;
+   double latency;
+};
+
+void usage( char* progname ) {
+   fprintf(stderr, "Usage: %s AG_URL VOLUME_ID /path/to/file NUM_CLIENTS NUM_BLOCKS\n", progname );
+   exit(1);
+}
+
+// accumulate a response body
+size_t herd_write( char* ptr, size_t size, size_t nmemb, void* userdata ) {
+
+   struct herd_fetch* fetch = (struct herd_fetch*)userdata;
+   size_t len = size * nmemb;
+
+   char* new_buf = (char*)realloc( fetch->buf, fetch->len + len );
+   if( new_buf == NULL ) {
+      return 0;
+   }
+
+   memcpy( new_buf + fetch->len, ptr, len );
+
+   fetch->buf = new_buf;
+   fetch->len += len;
+
+   return len;
+}
+
+// seconds since a start time
+double herd_elapsed( struct timespec* start ) {
+
+   struct timespec now;
+   clock_gettime( CLOCK_MONOTONIC, &now );
+
+   return ((double)(now.tv_nsec - start->tv_nsec) + (double)(1e9 * (now.tv_sec - start->tv_sec))) / 1e9;
+}
+
+// get the current URL of a block, by asking for it with made-up versions and reading the redirect
+// return the URL on success, or NULL on error
+char* herd_resolve_block_url( uint64_t block_id ) {
+
+   char* url = md_url_public_block_url( global_ag_url, global_volume_id, global_fs_path, 0, 0, block_id, 0 );
+   char* ret = NULL;
+
+   for( int i = 0; i < HERD_MAX_TRIES && ret == NULL; i++ ) {
+
+      struct herd_fetch fetch;
+      memset( &fetch, 0, sizeof(struct herd_fetch) );
+
+      CURL* curl = curl_easy_init();
+
+      curl_easy_setopt( curl, CURLOPT_URL, url );
+      curl_easy_setopt( curl, CURLOPT_WRITEFUNCTION, herd_write );
+      curl_easy_setopt( curl, CURLOPT_WRITEDATA, &fetch );
+
+      int rc = curl_easy_perform( curl );
+      curl_easy_getinfo( curl, CURLINFO_RESPONSE_CODE, &fetch.http_status );
+
+      if( rc == 0 && fetch.http_status == 302 ) {
+
+         char* location = NULL;
+         curl_easy_getinfo( curl, CURLINFO_REDIRECT_URL, &location );
+
+         if( location != NULL ) {
+            ret = strdup( location );
+         }
+      }
+      else if( rc == 0 && fetch.http_status == SG_HTTP_TRYAGAIN ) {
+
+         // AG is reversioning the file
+         sleep(1);
+      }
+      else {
+
+         fprintf(stderr, "GET %s: curl rc = %d, HTTP status = %ld\n", url, rc, fetch.http_status );
+         i = HERD_MAX_TRIES;
+      }
+
+      curl_easy_cleanup( curl );
+
+      if( fetch.buf != NULL ) {
+         free( fetch.buf );
+      }
+   }
+
+   free( url );
+   return ret;
+}
+
+// fetch a block, once every client is ready
+void* herd_main( void* arg ) {
+
+   struct herd_fetch* fetch = (struct herd_fetch*)arg;
+   struct timespec start;
+
+   CURL* curl = curl_easy_init();
+
+   curl_easy_setopt( curl, CURLOPT_URL, fetch->url );
+   curl_easy_setopt( curl, CURLOPT_WRITEFUNCTION, herd_write );
+   curl_easy_setopt( curl, CURLOPT_WRITEDATA, fetch );
+
+   pthread_barrier_wait( &global_barrier );
+
+   clock_gettime( CLOCK_MONOTONIC, &start );
+
+   int rc = curl_easy_perform( curl );
+
+   fetch->latency = herd_elapsed( &start );
+
+   if( rc != 0 ) {
+      fprintf(stderr, "GET %s: curl rc = %d\n", fetch->url, rc );
+      fetch->http_status = -1;
+   }
+   else {
+      curl_easy_getinfo( curl, CURLINFO_RESPONSE_CODE, &fetch->http_status );
+   }
+
+   curl_easy_cleanup( curl );
+   return NULL;
+}
+
+// have num_clients clients fetch a block at once
+// return the time until the last one got it, or negative if any of them failed or got different bytes
+double herd_fetch_block( uint64_t block_id, int num_clients ) {
+
+   double slowest = 0;
+
+   char* url = herd_resolve_block_url( block_id );
+   if( url == NULL ) {
+      return -1;
+   }
+
+   struct herd_fetch* fetches = SG_CALLOC( struct herd_fetch, num_clients );
+   pthread_t* threads = SG_CALLOC( pthread_t, num_clients );
+
+   if( fetches == NULL || threads == NULL ) {
+      exit( ENOMEM );
+   }
+
+   pthread_barrier_init( &global_barrier, NULL, num_clients );
+
+   for( int i = 0; i < num_clients; i++ ) {
+
+      fetches[i].url = url;
+      pthread_create( &threads[i], NULL, herd_main, &fetches[i] );
+   }
+
+   for( int i = 0; i < num_clients; i++ ) {
+      pthread_join( threads[i], NULL );
+   }
+
+   pthread_barrier_destroy( &global_barrier );
+
+   for( int i = 0; i < num_clients; i++ ) {
+
+      if( fetches[i].http_status != 200 ) {
+
+         fprintf(stderr, "GET %s: HTTP status %ld\n", url, fetches[i].http_status );
+         slowest = -1;
+         break;
+      }
+
+      if( fetches[i].len != fetches[0].len || memcmp( fetches[i].buf, fetches[0].buf, fetches[0].len ) != 0 ) {
+
+         fprintf(stderr, "GET %s: client %d got different data than client 0\n", url, i );
+         slowest = -1;
+         break;
+      }
+
+      if( fetches[i].latency > slowest ) {
+         slowest = fetches[i].latency;
+      }
+   }
+
+   for( int i = 0; i < num_clients; i++ ) {
+
+      if( fetches[i].buf != NULL ) {
+         free( fetches[i].buf );
+      }
+   }
+
+   free( fetches );
+   free( threads );
+   free( url );
+
+   return slowest;
+}
+
+
+int main( int argc, char** argv ) {
+
+   if( argc != 6 ) {
+      usage( argv[0] );
+   }
+
+   global_ag_url = argv[1];
+   global_volume_id = (uint64_t)strtoull( argv[2], NULL, 10 );
+   global_fs_path = argv[3];
+
+   int num_clients = atoi( argv[4] );
+   int num_blocks = atoi( argv[5] );
+
+   if( num_clients <= 0 || num_blocks <= 0 ) {
+      usage( argv[0] );
+   }
+
+   curl_global_init( CURL_GLOBAL_ALL );
+
+   double solo_total = 0;
+   double herd_total = 0;
+
+   // lone fetches of blocks [0, num_blocks)
+   for( int i = 0; i < num_blocks; i++ ) {
+
+      double latency = herd_fetch_block( i, 1 );
+      if( latency < 0 ) {
+         fprintf(stderr, "Lone fetch of block %d failed\n", i );
+         exit(1);
+      }
+
+      solo_total += latency;
+   }
+
+   // herds on blocks [num_blocks, 2*num_blocks)
+   for( int i = num_blocks; i < 2 * num_blocks; i++ ) {
+
+      double latency = herd_fetch_block( i, num_clients );
+      if( latency < 0 ) {
+         fprintf(stderr, "Herd fetch of block %d failed\n", i );
+         exit(1);
+      }
+
+      herd_total += latency;
+   }
+
+   curl_global_cleanup();
+
+   double solo_mean = solo_total / num_blocks;
+   double herd_mean = herd_total / num_blocks;
+
+   printf("mean lone fetch: %lf s\n", solo_mean );
+   printf("mean herd of %d: %lf s (until the last client has the block)\n", num_clients, herd_mean );
+   printf("herd / lone: %lf\n", herd_mean / solo_mean );
+
+   return 0;
+}
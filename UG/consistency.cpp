@@ -23,6 +23,7 @@
 #include "replication.h"
 #include "driver.h"
 #include "vacuumer.h"
+#include "negative.h"
 #include "syndicate.h"
 
 // is a fent stale for reads?
@@ -46,6 +47,70 @@ bool fs_entry_is_read_stale( struct fs_entry* fent ) {
 }
 
 
+// is a fent stale for reads, given the metadata leases the MS has granted us?
+// a lease on a directory covers its children (and the root, if the lease is on the root), so lease_dir_id is
+// the ID of fent's parent (or of fent, if it is the root).
+// a directory whose own lease has run out is stale, so revalidating it renews the lease.
+// the lease only covers fent for as long as fent's own max_read_freshness past its last renewal, since a change on the MS
+// only shows up when the lease gets renewed.
+// fent must be at least read-locked
+static bool fs_entry_is_read_stale_leased( struct fs_core* core, uint64_t lease_dir_id, struct fs_entry* fent ) {
+   
+   if( fent->read_stale ) {
+      SG_debug("%s is read stale\n", fent->name);
+      return true;
+   }
+   
+   if( fent->ftype == FTYPE_DIR && ms_client_lease_check( core->ms, fent->file_id, NULL, 0 ) == -ETIMEDOUT ) {
+      SG_debug("STALE: lease on %s expired\n", fent->name );
+      return true;
+   }
+   
+   if( ms_client_lease_check( core->ms, lease_dir_id, &fent->refresh_time, fent->max_read_freshness ) == 0 ) {
+      SG_debug("FRESH: %s is covered by the lease on %" PRIX64 "\n", fent->name, lease_dir_id );
+      return false;
+   }
+   
+   return fs_entry_is_read_stale( fent );
+}
+
+
+// is a fent fresh for reads, given the metadata leases the MS has granted us?  (see fs_entry_is_read_stale_leased)
+// this is the evaluator for fs_entry_revalidate_path's lock-free fast path, so fent is not locked and may be changing:
+// this only reads fent's fixed-size fields, and does not log.
+// return 0 if fresh
+// return -ESTALE if not
+static int fs_entry_rcu_check_fresh( struct fs_entry* parent, struct fs_entry* fent, void* cls ) {
+   
+   struct fs_core* core = (struct fs_core*)cls;
+   uint64_t lease_dir_id = (parent != NULL ? parent->file_id : fent->file_id);
+   
+   // a concurrent refresh can tear this, but only while it is making fent fresh anyway
+   struct timespec refresh_time = fent->refresh_time;
+   
+   if( fent->read_stale ) {
+      return -ESTALE;
+   }
+   
+   if( fent->ftype == FTYPE_DIR && ms_client_lease_check( core->ms, fent->file_id, NULL, 0 ) == -ETIMEDOUT ) {
+      return -ESTALE;
+   }
+   
+   if( ms_client_lease_check( core->ms, lease_dir_id, &refresh_time, fent->max_read_freshness ) == 0 ) {
+      return 0;
+   }
+   
+   uint64_t now_ms = md_current_time_millis();
+   uint64_t refresh_ms = (uint64_t)(refresh_time.tv_sec) * 1000 + (uint64_t)(refresh_time.tv_nsec) / 1000000;
+   
+   if( now_ms - refresh_ms >= (uint64_t)fent->max_read_freshness ) {
+      return -ESTALE;
+   }
+   
+   return 0;
+}
+
+
 // determine whether or not an entry is stale, given the current entry's modtime and the time of the query.
 // for files, the modtime is the manifest modtime (which increases monotonically)
 // for directories, the modtime is the fs_entry modtime (which also increases monotonically)
@@ -197,13 +262,15 @@ int fs_entry_reload( struct fs_entry* fent, struct md_entry* ent ) {
                SG_debug("%" PRIX64 " (%s)'s manifest is stale\n", fent->file_id, fent->name );
                // manifest has changed remotely
                fent->manifest->mark_stale();
+               fent->kernel_cache_stale = true;
             }
 
-            if( fent->version != fent->manifest->get_file_version() ) {
+            if( fent->version != fent->manifest->get_file_version() || fent->version != ent->version ) {
                
                // file was reversioned (i.e. truncated)
                SG_debug("%" PRIX64 " (%s)'s manifest was reversioned\n", fent->file_id, fent->name );
                fent->manifest->mark_stale();
+               fent->kernel_cache_stale = true;
             }
          }
          else {
@@ -280,23 +347,31 @@ static void fs_entry_getattr_cls_free( void* _cls ) {
 }
 
 
+// state for building up an ms_path from a cached path
+struct fs_entry_ms_path_cls {
+   struct fs_core* core;
+   ms_path_t* ms_path;
+};
+
 // visitor along a path for building up an ms_path with inode consistency status.
 // return 0 on success (always succeds)
-static int fs_entry_ms_path_append( struct fs_entry* fent, void* ms_path_cls ) {
+static int fs_entry_ms_path_append( struct fs_entry* fent, void* _cls ) {
    // build up the ms_path as we traverse our cached path
-   ms_path_t* ms_path = (ms_path_t*)ms_path_cls;
+   struct fs_entry_ms_path_cls* ms_path_cls = (struct fs_entry_ms_path_cls*)_cls;
+   ms_path_t* ms_path = ms_path_cls->ms_path;
 
    struct fs_entry_getattr_cls* cls = SG_CALLOC( struct fs_entry_getattr_cls, 1 );
 
    if( ms_path->size() == 0 ) {
       // root
-      fs_entry_getattr_cls_init( cls, "/", "", true, fs_entry_is_read_stale( fent ) );
+      fs_entry_getattr_cls_init( cls, "/", "", true, fs_entry_is_read_stale_leased( ms_path_cls->core, fent->file_id, fent ) );
    }
    else {
       // not root
       struct fs_entry_getattr_cls* parent_cls = (struct fs_entry_getattr_cls*)ms_path->at( ms_path->size() - 1 ).cls;
+      uint64_t parent_id = ms_path->at( ms_path->size() - 1 ).file_id;
       
-      fs_entry_getattr_cls_init( cls, parent_cls->fs_path, fent->name, true, fs_entry_is_read_stale( fent ) );
+      fs_entry_getattr_cls_init( cls, parent_cls->fs_path, fent->name, true, fs_entry_is_read_stale_leased( ms_path_cls->core, parent_id, fent ) );
    }
                               
    struct ms_path_ent path_ent;
@@ -338,9 +413,13 @@ static int fs_entry_build_ms_path( struct fs_core* core, char const* path, ms_pa
    vector<char*> path_parts;
    size_t path_len = fs_entry_split_path( path, &path_parts );
    int rc = 0;
+   struct fs_entry_ms_path_cls ms_path_cls;
+   
+   ms_path_cls.core = core;
+   ms_path_cls.ms_path = ms_path;
    
    // populate ms_path with our cached entries
-   struct fs_entry* fent = fs_entry_resolve_path_cls( core, path, core->ms->owner_id, core->volume, false, &rc, fs_entry_ms_path_append, ms_path );
+   struct fs_entry* fent = fs_entry_resolve_path_cls( core, path, core->ms->owner_id, core->volume, false, &rc, fs_entry_ms_path_append, &ms_path_cls );
    if( fent == NULL ) {
       
       // end of path reached prematurely?
@@ -732,20 +811,22 @@ static int fs_entry_path_getattr_all( struct fs_core* core, ms_path_t* to_downlo
 
 
 // download a path of entries that we do not have locally.
+// if the MS could not give us one of them, *download_rc is set to its error and *failed_idx to its index.
 // return 0 on success
 // return -EUCLEAN if we failed to merge the data into the path
 // return negative on protocol-level error
-static int fs_entry_path_download_all( struct fs_core* core, ms_path_t* to_download ) {
+static int fs_entry_path_download_all( struct fs_core* core, ms_path_t* to_download, int* download_rc, int* failed_idx ) {
    
    int rc = 0;
-   int download_rc = 0;
-   int failed_idx = -1;
    struct ms_client_multi_result results;
    
    memset( &results, 0, sizeof(struct ms_client_multi_result) );
    
    // fetch all 
-   rc = ms_client_path_download( core->ms, to_download, NULL, NULL, &download_rc, &failed_idx );
+   *download_rc = 0;
+   *failed_idx = -1;
+   
+   rc = ms_client_path_download( core->ms, to_download, NULL, NULL, download_rc, failed_idx );
    
    if( rc != 0 ) {
       // protocol-level error 
@@ -753,8 +834,13 @@ static int fs_entry_path_download_all( struct fs_core* core, ms_path_t* to_downl
       return rc;
    }
    
-   if( download_rc != 0 || failed_idx >= 0 ) {
-      SG_debug("WARN: ms_client_download_path() RPC failed with rc = %d, failed path node %d\n", download_rc, failed_idx );
+   if( *download_rc != 0 || *failed_idx >= 0 ) {
+      SG_debug("WARN: ms_client_download_path() RPC failed with rc = %d, failed path node %d\n", *download_rc, *failed_idx );
+      
+      if( *download_rc == -ENOENT ) {
+         // nothing to merge past this point 
+         return 0;
+      }
    }
    
    // merge what we can
@@ -833,12 +919,25 @@ static int fs_entry_download_remote_path_entries( struct fs_entry_consistency_cl
 
    SG_debug("download remote entries of %s, starting at %d\n", deepest_path, cls->remote_path_idx);
    
-   int rc = fs_entry_path_download_all( core, ms_path );
+   int download_rc = 0;
+   int failed_idx = -1;
+   
+   int rc = fs_entry_path_download_all( core, ms_path, &download_rc, &failed_idx );
    if( rc != 0 ) {
       SG_error("fs_entry_path_download_all(%s) rc = %d\n", deepest_path, rc );
       return rc;
    }
    
+   if( download_rc == -ENOENT && failed_idx > 0 ) {
+      
+      // the MS says this name does not exist.  Remember that, so we don't ask again for a while.
+      struct ms_path_ent* parent_ent = &ms_path->at( failed_idx - 1 );
+      
+      fs_entry_negative_cache_put( core->negative_cache, parent_ent->file_id, parent_ent->write_nonce, ms_path->at( failed_idx ).name );
+      
+      return -ENOENT;
+   }
+   
    // re-integrate downloaded data with the FS
    cls->path = ms_path;
    
@@ -884,7 +983,7 @@ int fs_entry_consistency_cls_init( struct fs_entry_consistency_cls* consistency_
 // walk down an absolute path and check to see if the directories leading to the requested entries are fresh.
 // for each stale entry, re-download metadata and merge it into their respective inodes.
 // for each entry not found locally, try to download metadata and attach it to the metadata hierarchy.
-int fs_entry_revalidate_path( struct fs_core* core, char const* fs_path ) {
+static int fs_entry_revalidate_path_impl( struct fs_core* core, char const* fs_path ) {
    
    // must be absolute
    if( fs_path[0] != '/' ) {
@@ -903,6 +1002,20 @@ int fs_entry_revalidate_path( struct fs_core* core, char const* fs_path ) {
    
    SG_debug("Revalidate %s\n", path );
    
+   // fast path: if everything along the path is cached and fresh, there is nothing to do, and we needn't lock anything but the last entry to find out
+   struct fs_entry* fent = fs_entry_resolve_path_rcu( core, path, core->ms->owner_id, core->volume, false, &rc, fs_entry_rcu_check_fresh, core );
+   if( fent != NULL ) {
+      
+      fs_entry_unlock( fent );
+      
+      SG_debug("%s is complete and fresh\n", path );
+      
+      free( path );
+      return 0;
+   }
+   
+   rc = 0;
+   
    fs_entry_consistency_cls_init( &consistency_cls, core, &ms_path );
    
    // build the whole path 
@@ -957,6 +1070,22 @@ int fs_entry_revalidate_path( struct fs_core* core, char const* fs_path ) {
       
       return 0;
    }
+   
+   if( ms_path_stale.size() == 0 && missing_local && consistency_cls.remote_path_idx > 0 ) {
+      
+      // everything we have is fresh.  Did the MS recently tell us that the first missing entry does not exist?
+      struct ms_path_ent* parent_ent = &ms_path[ consistency_cls.remote_path_idx - 1 ];
+      
+      if( fs_entry_negative_cache_has( core->negative_cache, parent_ent->file_id, parent_ent->write_nonce, ms_path[ consistency_cls.remote_path_idx ].name ) ) {
+         
+         SG_debug("%s does not exist (cached)\n", path );
+         
+         free( path );
+         ms_client_free_path( &ms_path, fs_entry_getattr_cls_free );
+         
+         return -ENOENT;
+      }
+   }
 
    if( ms_path_stale.size() > 0 ) {
       
@@ -998,6 +1127,21 @@ int fs_entry_revalidate_path( struct fs_core* core, char const* fs_path ) {
    return rc;
 }
 
+// revalidate a path's metadata, and time it
+int fs_entry_revalidate_path( struct fs_core* core, char const* fs_path ) {
+   
+   struct md_trace_span span;
+   md_trace_begin( &span, "revalidate_path", 0 );
+   core->state->stats->enter( STAT_REVALIDATE );
+   
+   int rc = fs_entry_revalidate_path_impl( core, fs_path );
+   
+   core->state->stats->leave( STAT_REVALIDATE, rc );
+   md_trace_end( &span );
+   
+   return rc;
+}
+
 
 // resolve an entry, and make sure it's a directory 
 struct fs_entry* fs_entry_resolve_directory( struct fs_core* core, char const* fs_path, uint64_t owner_id, uint64_t volume_id, bool writelock, int* rc ) {
@@ -1026,7 +1170,7 @@ struct fs_entry* fs_entry_resolve_directory( struct fs_core* core, char const* f
 
 // convert a parent's stale children to an ms_path_t, for purposes of doing a getattr_multi
 // parent must be at least read-locked
-static int fs_entry_getattr_stale_children_to_path( char const* parent_path, struct fs_entry* parent, ms_path_t* children ) {
+static int fs_entry_getattr_stale_children_to_path( struct fs_core* core, char const* parent_path, struct fs_entry* parent, ms_path_t* children ) {
 
    for( fs_entry_set::iterator itr = parent->children->begin(); itr != parent->children->end(); itr++ ) {
       
@@ -1052,7 +1196,7 @@ static int fs_entry_getattr_stale_children_to_path( char const* parent_path, str
       }
       
       // is this child stale?
-      if( fs_entry_is_read_stale( child ) ) {
+      if( fs_entry_is_read_stale_leased( core, parent->file_id, child ) ) {
       
          // do a getattr on it 
          memset( &ms_child, 0, sizeof(struct ms_path_ent) );
@@ -1073,14 +1217,110 @@ static int fs_entry_getattr_stale_children_to_path( char const* parent_path, str
 }
 
 
-// revalidate a directory's children, using diffdir to find the latest children and getattr_multi to revalidate the cached children 
-// return 0 on success 
+// state for merging a directory listing, page by page
+struct fs_entry_listing_cls {
+   struct fs_core* core;
+   char const* fs_path;                 // path to the directory
+   struct timespec* query_time;         // when the listing started
+   int worst_rc;                        // last merge error
+};
+
+
+// merge one page of a directory listing into the directory, as soon as it arrives.
+// the directory is write-locked only for the duration of the page, so readers see the children as they come in.
+// return 0 on success, even if some children could not be merged (they get recorded in worst_rc)
+// return negative if the directory could not be resolved
+static int fs_entry_merge_listing_page( struct ms_client* client, struct md_entry* ents, size_t num_ents, void* cls ) {
+   
+   struct fs_entry_listing_cls* listing_cls = (struct fs_entry_listing_cls*)cls;
+   struct fs_core* core = listing_cls->core;
+   int rc = 0;
+   
+   struct fs_entry* parent = fs_entry_resolve_directory( core, listing_cls->fs_path, SG_SYS_USER, core->volume, true, &rc );
+   if( rc != 0 ) {
+      
+      SG_error("fs_entry_resolve_directory(%s) rc = %d\n", listing_cls->fs_path, rc );
+      return rc;
+   }
+   
+   for( unsigned int i = 0; i < num_ents; i++ ) {
+      
+      // was the entry modified?  if not, don't bother 
+      if( ents[i].error == MS_LISTING_NOCHANGE || ents[i].error == MS_LISTING_NONE ) {
+         continue;
+      }
+      
+      // attach/merge the child.  keep trying even on error.
+      rc = fs_entry_merge_entry( core, listing_cls->query_time, parent, ents[i].name, &ents[i] );
+      if( rc != 0 ) {
+         SG_error("fs_entry_merge_entry( %" PRIX64 ".%s ) rc = %d\n", parent->file_id, ents[i].name, rc );
+         listing_cls->worst_rc = rc;
+      }
+   }
+   
+   fs_entry_unlock( parent );
+   
+   return 0;
+}
+
+
+// merge revalidated cached children back into their directory 
+// return 0 on success
+// return negative if the directory could not be resolved
+static int fs_entry_merge_stale_children( struct fs_entry_listing_cls* listing_cls, ms_path_t* stale_children_list ) {
+   
+   struct fs_core* core = listing_cls->core;
+   int rc = 0;
+   
+   if( stale_children_list->size() == 0 ) {
+      return 0;
+   }
+   
+   struct fs_entry* parent = fs_entry_resolve_directory( core, listing_cls->fs_path, SG_SYS_USER, core->volume, true, &rc );
+   if( rc != 0 ) {
+      return rc;
+   }
+   
+   for( unsigned int i = 0; i < stale_children_list->size(); i++ ) {
+      
+      struct ms_path_ent* ms_child = &(stale_children_list->at(i));
+      struct fs_entry_getattr_cls* getattr_cls = (struct fs_entry_getattr_cls*)ms_child->cls;
+      
+      // does this child still exist?  if not, don't include 
+      if( !getattr_cls->exists ) {
+         continue;
+      }
+      
+      // was the child remotely modified?  if not, don't reload 
+      if( !getattr_cls->modified ) {
+         continue;
+      }
+      
+      // attach/merge the child.  keep trying even on error
+      rc = fs_entry_merge_entry( core, listing_cls->query_time, parent, getattr_cls->ent.name, &getattr_cls->ent );
+      if( rc != 0 ) {
+         SG_error("fs_entry_merge_entry( %" PRIX64 ".%s ) rc = %d\n", parent->file_id, getattr_cls->ent.name, rc );
+         listing_cls->worst_rc = rc;
+      }
+   }
+   
+   fs_entry_unlock( parent );
+   
+   return 0;
+}
+
+
+// revalidate a directory's children, using getattr_multi to revalidate the cached children and diffdir to find the latest children.
+// new children are merged into the directory page by page, as they arrive.
+// return 0 on success, and set *reply_error to the MS's listing error (if any)
 // return negative if getattr_multi fails, or if diffdir fails
-static int fs_entry_revalidate_children_diffdir( struct fs_core* core, char const* fs_path, ms_path_t* stale_children_list,
-                                                 uint64_t parent_id, int64_t parent_ms_num_children, int64_t parent_max_generation, int64_t parent_capacity,
-                                                 struct ms_client_multi_result* results ) {
+static int fs_entry_revalidate_children_diffdir( struct fs_entry_listing_cls* listing_cls, ms_path_t* stale_children_list,
+                                                 uint64_t parent_id, int64_t parent_ms_num_children, int64_t parent_max_generation,
+                                                 int* reply_error ) {
    
    int rc = 0;
+   struct fs_core* core = listing_cls->core;
+   char const* fs_path = listing_cls->fs_path;
    
    // revalidate children, if there are any
    if( stale_children_list->size() > 0 ) {
@@ -1110,15 +1350,23 @@ static int fs_entry_revalidate_children_diffdir( struct fs_core* core, char cons
             parent_max_generation = getattr_cls->ent.generation;
          }
       }
+      
+      // put them back 
+      rc = fs_entry_merge_stale_children( listing_cls, stale_children_list );
+      if( rc != 0 ) {
+         SG_error("fs_entry_merge_stale_children(%s) rc = %d\n", fs_path, rc );
+         
+         return rc;
+      }
    }
    
    SG_debug("Diff dir %s (ms_num_children = %" PRId64 ", l.u.g = %" PRId64 ")\n", fs_path, parent_ms_num_children, parent_max_generation + 1 );
    
    // get the difference
-   rc = ms_client_diffdir( core->ms, parent_id, parent_ms_num_children, parent_max_generation + 1, results );
+   rc = ms_client_listdir_stream( core->ms, parent_id, parent_ms_num_children, parent_max_generation + 1, -1, fs_entry_merge_listing_page, listing_cls, reply_error );
    
    if( rc != 0 ) {
-      SG_error("ms_client_diffdir(%s) rc = %d\n", fs_path, rc );
+      SG_error("ms_client_listdir_stream(%s) rc = %d\n", fs_path, rc );
       
       return rc;
    }
@@ -1138,7 +1386,6 @@ int fs_entry_revalidate_children( struct fs_core* core, char const* fs_path ) {
    }
    
    int rc = 0;
-   int worst_rc = 0;
    char* path = md_flatten_path( fs_path );
    struct fs_entry* parent = NULL;
    uint64_t parent_file_id = 0;
@@ -1146,7 +1393,7 @@ int fs_entry_revalidate_children( struct fs_core* core, char const* fs_path ) {
    uint64_t parent_num_children = 0;            // number of cached children (only relevant if it's empty)
    uint64_t parent_max_generation = 0;          // largest known generation
    int64_t parent_capacity = 0;                 // largest index a child can have
-   struct ms_client_multi_result results;
+   int reply_error = 0;
    struct timespec query_time;
    ms_path_t stale_children_list;
    
@@ -1172,109 +1419,57 @@ int fs_entry_revalidate_children( struct fs_core* core, char const* fs_path ) {
    // if we're going to do a diffdir and a getattr_multi, then get the children's metadata 
    if( do_diff_dir ) {
       
-      fs_entry_getattr_stale_children_to_path( path, parent, &stale_children_list );
+      fs_entry_getattr_stale_children_to_path( core, path, parent, &stale_children_list );
    }
    
    fs_entry_unlock( parent );
    
    SG_debug("%s %" PRId64 " children of %s (max cached generation %" PRId64 ")\n", (do_diff_dir ? "DIFF" : "LIST"), parent_ms_num_children, fs_path, parent_max_generation );
    
+   struct fs_entry_listing_cls listing_cls;
+   memset( &listing_cls, 0, sizeof(struct fs_entry_listing_cls) );
+   
+   listing_cls.core = core;
+   listing_cls.fs_path = path;
+   listing_cls.query_time = &query_time;
+   
    // fetch all children (listdir), or only the new ones (diffdir)?
+   // either way, each page gets merged in while the next ones download.
    if( do_diff_dir ) {
       
       // have listed before; just get the difference
-      rc = fs_entry_revalidate_children_diffdir( core, path, &stale_children_list, parent_file_id, parent_ms_num_children, parent_max_generation, parent_capacity, &results );
+      rc = fs_entry_revalidate_children_diffdir( &listing_cls, &stale_children_list, parent_file_id, parent_ms_num_children, parent_max_generation, &reply_error );
       
       if( rc != 0 ) {
          
          SG_error("fs_entry_revalidate_children_diffdir(%s) rc = %d\n", path, rc );
-         
-         ms_client_free_path( &stale_children_list, fs_entry_getattr_cls_free );
-         free( path );
-         return rc;
       }  
    }
    else {
       
       // not listed yet
-      rc = ms_client_listdir( core->ms, parent_file_id, parent_ms_num_children, parent_capacity, &results );
+      rc = ms_client_listdir_stream( core->ms, parent_file_id, parent_ms_num_children, -1, parent_capacity, fs_entry_merge_listing_page, &listing_cls, &reply_error );
 
       if( rc != 0 ) {
          
-         SG_error("ms_client_listdir(%s) rc = %d\n", fs_path, rc );
-         return rc;
+         SG_error("ms_client_listdir_stream(%s) rc = %d\n", fs_path, rc );
       }
    }
    
-   if( results.reply_error != 0 ) {
-   
-      SG_error("MS replied error %d\n", results.reply_error );
-      
-      ms_client_multi_result_free( &results );
-      ms_client_free_path( &stale_children_list, fs_entry_getattr_cls_free );
-      free( path );
-      
-      return -abs(results.reply_error);
-   }
+   ms_client_free_path( &stale_children_list, fs_entry_getattr_cls_free );
+   free( path );
    
-   // re-acquire the parent, so we can merge the children in 
-   parent = fs_entry_resolve_directory( core, path, SG_SYS_USER, core->volume, false, &rc );
    if( rc != 0 ) {
-      
-      ms_client_multi_result_free( &results );
-      ms_client_free_path( &stale_children_list, fs_entry_getattr_cls_free );
-      free( path );
-      
       return rc;
    }
    
-   // merge path 
-   for( unsigned int i = 0; i < stale_children_list.size(); i++ ) {
-      
-      struct ms_path_ent* ms_child = &(stale_children_list[i]);
-      struct fs_entry_getattr_cls* getattr_cls = (struct fs_entry_getattr_cls*)ms_child->cls;
-      
-      // does this child still exist?  if not, don't include 
-      if( !getattr_cls->exists ) {
-         continue;
-      }
-      
-      // was the child remotely modified?  if not, don't reload 
-      if( !getattr_cls->modified ) {
-         continue;
-      }
-      
-      // attach/merge the child.  keep trying even on error
-      rc = fs_entry_merge_entry( core, &query_time, parent, getattr_cls->ent.name, &getattr_cls->ent );
-      if( rc != 0 ) {
-         SG_error("fs_entry_merge_entry( %" PRIX64 ".%s ) rc = %d\n", parent->file_id, getattr_cls->ent.name, rc );
-         worst_rc = rc;
-      }
-   }
+   if( reply_error != 0 ) {
    
-   // merge results
-   for( unsigned int i = 0; i < results.num_ents; i++ ) {
-      
-      // was the entry modified?  if not, don't bother 
-      if( results.ents[i].error == MS_LISTING_NOCHANGE || results.ents[i].error == MS_LISTING_NONE ) {
-         continue;
-      }
-      
-      // attach/merge the child.  keep trying even on error.
-      rc = fs_entry_merge_entry( core, &query_time, parent, results.ents[i].name, &results.ents[i] );
-      if( rc != 0 ) {
-         SG_error("fs_entry_merge_entry( %" PRIX64 ".%s ) rc = %d\n", parent->file_id, results.ents[i].name, rc );
-         worst_rc = rc;
-      }
+      SG_error("MS replied error %d\n", reply_error );
+      return -abs(reply_error);
    }
    
-   fs_entry_unlock( parent );
-   
-   ms_client_multi_result_free( &results );
-   ms_client_free_path( &stale_children_list, fs_entry_getattr_cls_free );
-   free( path );
-   
-   return worst_rc;
+   return listing_cls.worst_rc;
 }
 
 
@@ -1292,6 +1487,30 @@ int fs_entry_reload_manifest( struct fs_core* core, struct fs_entry* fent, Seria
 }
 
 
+// tell the front-end that a file's data changed remotely, so it drops any pages it cached from the old data.
+// until it reopens the file, it may still have them (i.e. if it can't invalidate them on its own)
+// fent must be write-locked
+static int fs_entry_invalidate_cached_data( struct fs_core* core, struct fs_entry* fent ) {
+   
+   fent->kernel_cache_stale = true;
+   
+   fs_core_rlock( core );
+   
+   fs_entry_cache_inval_func cache_inval_cb = core->cache_inval_cb;
+   void* cache_inval_cls = core->cache_inval_cls;
+   
+   fs_core_unlock( core );
+   
+   if( cache_inval_cb != NULL ) {
+      
+      SG_debug("invalidate cached data of %" PRIX64 " (%s)\n", fent->file_id, fent->name );
+      (*cache_inval_cb)( core, fent, cache_inval_cls );
+   }
+   
+   return 0;
+}
+
+
 // ensure that the manifest is up to date.
 // if successful_gateway_id != NULL, then fill it with the ID of the gateway that served the manifest (if any). Otherwise set to 0 if given but the manifest was fresh.
 // a manifest fetched from an AG will be marked as stale, since a subsequent read can fail with HTTP 204.  The caller should mark the manifest as fresh if it succeeds in reading data.
@@ -1344,7 +1563,15 @@ int fs_entry_revalidate_manifest_ex( struct fs_core* core, char const* fs_path,
    int rc = 0;
    Serialization::ManifestMsg manifest_msg;
    
+   struct md_trace_span span;
+   md_trace_begin( &span, "manifest_fetch", fent->file_id );
+   core->state->stats->enter( STAT_MANIFEST_FETCH );
+   
    rc = fs_entry_get_manifest( core, fs_path, fent, mtime_sec, mtime_nsec, &manifest_msg, successful_gateway_id );
+   
+   core->state->stats->leave( STAT_MANIFEST_FETCH, rc );
+   md_trace_end( &span );
+   
    if( rc != 0 ) {
       SG_error("fs_entry_get_manifest(%s.%" PRId64 ".%d) rc = %d\n", fs_path, mtime_sec, mtime_nsec, rc );
       
@@ -1359,9 +1586,31 @@ int fs_entry_revalidate_manifest_ex( struct fs_core* core, char const* fs_path,
       }
    }
    
+   // remember which version of the data we had, so we can tell if it changed
+   bool had_manifest = fent->manifest->is_initialized();
+   int64_t old_version = fent->version;
+   int64_t old_manifest_mtime_sec = 0;
+   int32_t old_manifest_mtime_nsec = 0;
+   
+   fent->manifest->get_modtime( &old_manifest_mtime_sec, &old_manifest_mtime_nsec );
+   
    // repopulate the manifest and update the relevant metadata
    fs_entry_reload_manifest( core, fent, &manifest_msg );
    
+   if( had_manifest ) {
+      
+      int64_t new_manifest_mtime_sec = 0;
+      int32_t new_manifest_mtime_nsec = 0;
+      
+      fent->manifest->get_modtime( &new_manifest_mtime_sec, &new_manifest_mtime_nsec );
+      
+      if( old_version != fent->version || old_manifest_mtime_sec != new_manifest_mtime_sec || old_manifest_mtime_nsec != new_manifest_mtime_nsec ) {
+         
+         // new file or block versions
+         fs_entry_invalidate_cached_data( core, fent );
+      }
+   }
+   
    ///////////////////////////////
    char* dat = fent->manifest->serialize_str();
    SG_debug("Manifest:\n%s\n", dat);
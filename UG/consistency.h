@@ -20,6 +20,7 @@
 #include "fs_entry.h"
 
 #include "libsyndicate/ms/getattr.h"
+#include "libsyndicate/ms/lease.h"
 #include "libsyndicate/ms/listdir.h"
 #include "libsyndicate/ms/path.h"
 
@@ -142,9 +142,15 @@ int driver_write_block_preup( struct fs_core* core, struct md_closure* closure,
    int ret = 0;
    
    if( md_closure_find_callback( closure, "write_block_preup" ) != NULL ) {
+      
+      struct md_trace_span span;
+      md_trace_begin( &span, "driver_write_block_preup", block_id );
+      
       MD_CLOSURE_CALL( ret, closure, "write_block_preup", driver_write_block_preup_func, core, closure,
                        fs_path, fent, block_id, block_version, in_block_data, in_block_data_len, out_block_data, out_block_data_len,
                        closure->cls );
+      
+      md_trace_end( &span );
    }
    else {
       SG_error("%s", "WARN: write_block_preup stub\n");
@@ -158,6 +164,12 @@ int driver_write_block_preup( struct fs_core* core, struct md_closure* closure,
    return ret;
 }
 
+// does the driver process blocks before uploading?
+// if not, then the block data that gets cached and replicated is exactly what was written.
+bool driver_has_write_block_preup( struct md_closure* closure ) {
+   return (md_closure_find_callback( closure, "write_block_preup" ) != NULL);
+}
+
 int driver_write_manifest_preup( struct fs_core* core, struct md_closure* closure, char const* fs_path, struct fs_entry* fent, int64_t manifest_mtime_sec, int32_t manifest_mtime_nsec,
                                  char const* in_manifest_data, size_t in_manifest_data_len, char** out_manifest_data, size_t* out_manifest_data_len ) {
  
@@ -190,9 +202,15 @@ ssize_t driver_read_block_postdown( struct fs_core* core, struct md_closure* clo
    ssize_t ret = 0;
    
    if( md_closure_find_callback( closure, "read_block_postdown" ) != NULL ) {
+      
+      struct md_trace_span span;
+      md_trace_begin( &span, "driver_read_block_postdown", block_id );
+      
       MD_CLOSURE_CALL( ret, closure, "read_block_postdown", driver_read_block_postdown_func, core, closure,
                        fs_path, fent, block_id, block_version, in_block_data, in_block_data_len, out_block_data, out_block_data_len,
                        closure->cls );
+      
+      md_trace_end( &span );
    }
    else {
       SG_error("WARN: read_block_postdown stub (in buffer len = %zu, out buffer len = %zu)\n", in_block_data_len, out_block_data_len);
@@ -204,6 +222,12 @@ ssize_t driver_read_block_postdown( struct fs_core* core, struct md_closure* clo
    return ret;
 }
 
+// does the driver process blocks after downloading?
+// if not, then a block is read back exactly as it was cached and replicated.
+bool driver_has_read_block_postdown( struct md_closure* closure ) {
+   return (md_closure_find_callback( closure, "read_block_postdown" ) != NULL);
+}
+
 
 // process a manifest after downloading (called by md_download_manifest())
 int driver_read_manifest_postdown( struct md_closure* closure, char const* in_manifest_data, size_t in_manifest_data_len, char** out_manifest_data, size_t* out_manifest_data_len, void* user_cls ) {
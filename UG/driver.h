@@ -76,6 +76,8 @@ int driver_delete_file( struct fs_core* core, struct md_closure* closure, char c
 // called by read(), write(), and trunc()
 int driver_write_block_preup( struct fs_core* core, struct md_closure* closure, char const* fs_path, struct fs_entry* fent, uint64_t block_id, int64_t block_version,
                               char const* in_block_data, size_t in_block_data_len, char** out_block_data, size_t* out_block_data_len );
+bool driver_has_write_block_preup( struct md_closure* closure );
+bool driver_has_read_block_postdown( struct md_closure* closure );
 int driver_write_manifest_preup( struct fs_core* core, struct md_closure* closure, char const* fs_path, struct fs_entry* fent, int64_t manifest_mtime_sec, int32_t manifest_mtime_nsec,
                                  char const* in_manifest_data, size_t in_manifest_data_len, char** out_manifest_data, size_t* out_manifest_data_len );
 ssize_t driver_read_block_postdown( struct fs_core* core, struct md_closure* closure, char const* fs_path, struct fs_entry* fent, uint64_t block_id, int64_t block_version,
@@ -56,7 +56,7 @@ int fs_entry_close( struct fs_core* core, struct fs_file_handle* fh ) {
       rc = fs_entry_try_destroy( core, fh->fent );
       if( rc > 0 ) {
          // fent was unlocked and destroyed
-         free( fh->fent );
+         fs_entry_free( fh->fent );
          sync = false;  // don't sync data--the file no longer exists
       }
    }
@@ -30,9 +30,9 @@ int fs_entry_closedir( struct fs_core* core, struct fs_dir_handle* dirh ) {
 
       dirh->dent->open_count--;
 
-      if( dirh->dent->open_count <= 0 && dirh->dent->link_count <= 0 ) {
+      if( dirh->dent->open_count <= 0 && dirh->dent->link_count <= 0 && dirh->dent->ref_count <= 0 ) {
          fs_entry_destroy( dirh->dent, false );
-         free( dirh->dent );
+         fs_entry_free( dirh->dent );
          dirh->dent = NULL;
       }
       else {
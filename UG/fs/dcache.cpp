@@ -0,0 +1,470 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "dcache.h"
+
+// a reader thread's state
+struct fs_rcu_thread {
+   volatile uint64_t epoch;     // global epoch when this thread entered its read-side section, or 0 if it isn't in one
+   int nesting;                 // depth of nested read-side sections
+   bool in_use;                 // false once the thread exits (so the record can be reused)
+};
+
+// something to free once its epoch is old enough
+struct fs_rcu_callback {
+   void (*free_cb)( void* );
+   void* arg;
+   uint64_t epoch;              // global epoch when it was retired
+};
+
+typedef vector<struct fs_rcu_thread*> fs_rcu_thread_list_t;
+typedef list<struct fs_rcu_callback> fs_rcu_callback_list_t;
+
+// a child in the index
+struct fs_dcache_node {
+   fs_entry_set* dir;
+   long name_hash;
+   struct fs_entry* volatile child;
+   struct fs_dcache_node* volatile next;
+};
+
+static volatile uint64_t fs_rcu_epoch = 1;
+static fs_rcu_thread_list_t* fs_rcu_threads = NULL;
+static fs_rcu_callback_list_t* fs_rcu_callbacks = NULL;
+static pthread_mutex_t fs_rcu_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t fs_rcu_thread_key;
+static pthread_once_t fs_rcu_once = PTHREAD_ONCE_INIT;
+
+static struct fs_dcache_node* volatile fs_dcache_buckets[ FS_DCACHE_NUM_BUCKETS ];
+static pthread_mutex_t fs_dcache_locks[ FS_DCACHE_NUM_LOCKS ];
+
+static volatile uint64_t fs_dcache_rename_seq = 0;
+static volatile int fs_dcache_num_renames = 0;           // renames in progress
+static volatile bool fs_dcache_complete = true;          // false if we failed to index a child (so lock-free walks can't trust a miss)
+
+// release an exiting thread's record for reuse
+static void fs_rcu_thread_release( void* arg ) {
+
+   struct fs_rcu_thread* rec = (struct fs_rcu_thread*)arg;
+
+   pthread_mutex_lock( &fs_rcu_lock );
+
+   rec->epoch = 0;
+   rec->nesting = 0;
+   rec->in_use = false;
+
+   pthread_mutex_unlock( &fs_rcu_lock );
+}
+
+// set up global state, once
+static void fs_rcu_setup(void) {
+
+   fs_rcu_threads = new fs_rcu_thread_list_t();
+   fs_rcu_callbacks = new fs_rcu_callback_list_t();
+
+   pthread_key_create( &fs_rcu_thread_key, fs_rcu_thread_release );
+
+   for( int i = 0; i < FS_DCACHE_NUM_LOCKS; i++ ) {
+      pthread_mutex_init( &fs_dcache_locks[i], NULL );
+   }
+}
+
+// get the calling thread's record, reusing an exited thread's record or making a new one if need be
+// return NULL if out of memory
+static struct fs_rcu_thread* fs_rcu_get_thread(void) {
+
+   pthread_once( &fs_rcu_once, fs_rcu_setup );
+
+   struct fs_rcu_thread* rec = (struct fs_rcu_thread*)pthread_getspecific( fs_rcu_thread_key );
+   if( rec != NULL ) {
+      return rec;
+   }
+
+   pthread_mutex_lock( &fs_rcu_lock );
+
+   for( unsigned int i = 0; i < fs_rcu_threads->size(); i++ ) {
+
+      if( !fs_rcu_threads->at(i)->in_use ) {
+         rec = fs_rcu_threads->at(i);
+         break;
+      }
+   }
+
+   if( rec == NULL ) {
+
+      rec = SG_CALLOC( struct fs_rcu_thread, 1 );
+      if( rec == NULL ) {
+
+         pthread_mutex_unlock( &fs_rcu_lock );
+         return NULL;
+      }
+
+      try {
+         fs_rcu_threads->push_back( rec );
+      }
+      catch( bad_alloc& ba ) {
+
+         pthread_mutex_unlock( &fs_rcu_lock );
+         free( rec );
+         return NULL;
+      }
+   }
+
+   rec->in_use = true;
+
+   pthread_mutex_unlock( &fs_rcu_lock );
+
+   pthread_setspecific( fs_rcu_thread_key, rec );
+
+   return rec;
+}
+
+
+// enter a read-side section.  Nothing a reader finds in the dcache will be freed until it leaves.
+// if we're out of memory, this blocks reclamation instead (by never leaving the oldest epoch)
+void fs_rcu_read_lock(void) {
+
+   struct fs_rcu_thread* rec = fs_rcu_get_thread();
+   if( rec == NULL ) {
+
+      SG_error("%s", "Out of memory; freeing nothing until further notice\n");
+      pthread_mutex_lock( &fs_rcu_lock );
+      fs_rcu_epoch = 0;
+      pthread_mutex_unlock( &fs_rcu_lock );
+      return;
+   }
+
+   if( rec->nesting == 0 ) {
+
+      rec->epoch = fs_rcu_epoch;
+
+      // announce the epoch before reading anything
+      __sync_synchronize();
+   }
+
+   rec->nesting++;
+}
+
+
+// leave a read-side section
+void fs_rcu_read_unlock(void) {
+
+   struct fs_rcu_thread* rec = (struct fs_rcu_thread*)pthread_getspecific( fs_rcu_thread_key );
+   if( rec == NULL ) {
+      return;
+   }
+
+   rec->nesting--;
+
+   if( rec->nesting == 0 ) {
+
+      // finish reading before announcing that we're done
+      __sync_synchronize();
+      rec->epoch = 0;
+   }
+}
+
+
+// advance the global epoch if every reader has seen it, and take every callback that is now two epochs old.
+// fs_rcu_lock must be held
+static void fs_rcu_reclaim_locked( fs_rcu_callback_list_t* ready ) {
+
+   if( fs_rcu_epoch == 0 ) {
+      // out of memory earlier; never free anything
+      return;
+   }
+
+   bool advance = true;
+
+   __sync_synchronize();
+
+   for( unsigned int i = 0; i < fs_rcu_threads->size(); i++ ) {
+
+      uint64_t epoch = fs_rcu_threads->at(i)->epoch;
+
+      if( epoch != 0 && epoch != fs_rcu_epoch ) {
+         // someone is still reading in an older epoch
+         advance = false;
+         break;
+      }
+   }
+
+   if( advance ) {
+      fs_rcu_epoch++;
+   }
+
+   // callbacks retired two epochs ago can't be seen by anyone
+   while( fs_rcu_callbacks->size() > 0 && fs_rcu_callbacks->front().epoch + 2 <= fs_rcu_epoch ) {
+
+      ready->push_back( fs_rcu_callbacks->front() );
+      fs_rcu_callbacks->pop_front();
+   }
+}
+
+
+// run free callbacks
+static void fs_rcu_run_callbacks( fs_rcu_callback_list_t* ready ) {
+
+   for( fs_rcu_callback_list_t::iterator itr = ready->begin(); itr != ready->end(); itr++ ) {
+      (*itr->free_cb)( itr->arg );
+   }
+}
+
+
+// free something once no reader can still see it.  It must already be unreachable to new readers.
+// this does not block; anything old enough to free gets freed by this call
+// return 0 on success
+// return -ENOMEM if out of memory (in which case arg is never freed)
+int fs_rcu_call( void (*free_cb)( void* ), void* arg ) {
+
+   struct fs_rcu_callback cb;
+   fs_rcu_callback_list_t ready;
+
+   pthread_once( &fs_rcu_once, fs_rcu_setup );
+
+   cb.free_cb = free_cb;
+   cb.arg = arg;
+
+   pthread_mutex_lock( &fs_rcu_lock );
+
+   cb.epoch = fs_rcu_epoch;
+
+   try {
+      fs_rcu_callbacks->push_back( cb );
+   }
+   catch( bad_alloc& ba ) {
+
+      pthread_mutex_unlock( &fs_rcu_lock );
+      return -ENOMEM;
+   }
+
+   fs_rcu_reclaim_locked( &ready );
+
+   pthread_mutex_unlock( &fs_rcu_lock );
+
+   fs_rcu_run_callbacks( &ready );
+
+   return 0;
+}
+
+
+// free everything waiting to be freed.
+// only call this once no thread is in a read-side section
+int fs_rcu_barrier(void) {
+
+   fs_rcu_callback_list_t ready;
+
+   pthread_once( &fs_rcu_once, fs_rcu_setup );
+
+   pthread_mutex_lock( &fs_rcu_lock );
+
+   ready.swap( *fs_rcu_callbacks );
+
+   pthread_mutex_unlock( &fs_rcu_lock );
+
+   fs_rcu_run_callbacks( &ready );
+
+   return 0;
+}
+
+
+// which bucket does a child go in?
+static unsigned int fs_dcache_bucket( fs_entry_set* dir, long name_hash ) {
+
+   uint64_t h = ((uint64_t)(uintptr_t)dir * 0x9E3779B97F4A7C15ULL) ^ (uint64_t)name_hash;
+
+   h ^= (h >> 29);
+   h *= 0xBF58476D1CE4E5B9ULL;
+   h ^= (h >> 32);
+
+   return (unsigned int)(h & (FS_DCACHE_NUM_BUCKETS - 1));
+}
+
+
+static void fs_dcache_node_free( void* arg ) {
+   free( arg );
+}
+
+
+// add a directory's child to the index
+// dir must be write-locked
+// return 0 on success
+// return -ENOMEM if out of memory
+int fs_dcache_insert( fs_entry_set* dir, long name_hash, struct fs_entry* child ) {
+
+   pthread_once( &fs_rcu_once, fs_rcu_setup );
+
+   struct fs_dcache_node* node = SG_CALLOC( struct fs_dcache_node, 1 );
+   if( node == NULL ) {
+
+      SG_error("%s", "Out of memory; path walks will take locks from now on\n");
+      fs_dcache_complete = false;
+      return -ENOMEM;
+   }
+
+   unsigned int b = fs_dcache_bucket( dir, name_hash );
+
+   node->dir = dir;
+   node->name_hash = name_hash;
+   node->child = child;
+
+   pthread_mutex_lock( &fs_dcache_locks[ b & (FS_DCACHE_NUM_LOCKS - 1) ] );
+
+   // add to the tail, so lookups find the same child fs_entry_set_find_hash() would if a name hash is duplicated
+   struct fs_dcache_node* volatile* pos = &fs_dcache_buckets[b];
+   while( *pos != NULL ) {
+      pos = &(*pos)->next;
+   }
+
+   // fill in the node before publishing it
+   __sync_synchronize();
+   *pos = node;
+
+   pthread_mutex_unlock( &fs_dcache_locks[ b & (FS_DCACHE_NUM_LOCKS - 1) ] );
+
+   return 0;
+}
+
+
+// remove a directory's child from the index.  If child is NULL, remove whichever child has the name hash.
+// dir must be write-locked
+// return 0 on success
+// return -ENOENT if it's not indexed
+int fs_dcache_remove( fs_entry_set* dir, long name_hash, struct fs_entry* child ) {
+
+   pthread_once( &fs_rcu_once, fs_rcu_setup );
+
+   unsigned int b = fs_dcache_bucket( dir, name_hash );
+   struct fs_dcache_node* node = NULL;
+
+   pthread_mutex_lock( &fs_dcache_locks[ b & (FS_DCACHE_NUM_LOCKS - 1) ] );
+
+   for( struct fs_dcache_node* volatile* pos = &fs_dcache_buckets[b]; *pos != NULL; pos = &(*pos)->next ) {
+
+      if( (*pos)->dir == dir && (*pos)->name_hash == name_hash && (child == NULL || (*pos)->child == child) ) {
+
+         // unlink it; readers already on it can still follow its next pointer
+         node = *pos;
+         *pos = node->next;
+         break;
+      }
+   }
+
+   pthread_mutex_unlock( &fs_dcache_locks[ b & (FS_DCACHE_NUM_LOCKS - 1) ] );
+
+   if( node == NULL ) {
+      return -ENOENT;
+   }
+
+   int rc = fs_rcu_call( fs_dcache_node_free, node );
+   if( rc != 0 ) {
+      SG_error("fs_rcu_call rc = %d; leaking dcache node\n", rc );
+   }
+
+   return 0;
+}
+
+
+// point a directory's indexed name at a different child, or index it if it isn't already
+// dir must be write-locked
+// return 0 on success
+// return -ENOMEM if out of memory
+int fs_dcache_replace( fs_entry_set* dir, long name_hash, struct fs_entry* child ) {
+
+   pthread_once( &fs_rcu_once, fs_rcu_setup );
+
+   unsigned int b = fs_dcache_bucket( dir, name_hash );
+   bool found = false;
+
+   pthread_mutex_lock( &fs_dcache_locks[ b & (FS_DCACHE_NUM_LOCKS - 1) ] );
+
+   for( struct fs_dcache_node* node = fs_dcache_buckets[b]; node != NULL; node = node->next ) {
+
+      if( node->dir == dir && node->name_hash == name_hash ) {
+
+         __sync_synchronize();
+         node->child = child;
+
+         found = true;
+         break;
+      }
+   }
+
+   pthread_mutex_unlock( &fs_dcache_locks[ b & (FS_DCACHE_NUM_LOCKS - 1) ] );
+
+   if( found ) {
+      return 0;
+   }
+
+   return fs_dcache_insert( dir, name_hash, child );
+}
+
+
+// find a directory's child by name hash
+// the caller must be in a read-side section, or hold dir's lock
+// return NULL if not found
+struct fs_entry* fs_dcache_lookup( fs_entry_set* dir, long name_hash ) {
+
+   if( dir == NULL ) {
+      return NULL;
+   }
+
+   unsigned int b = fs_dcache_bucket( dir, name_hash );
+
+   for( struct fs_dcache_node* node = fs_dcache_buckets[b]; node != NULL; node = node->next ) {
+
+      if( node->dir == dir && node->name_hash == name_hash ) {
+         return node->child;
+      }
+   }
+
+   return NULL;
+}
+
+
+// start moving an entry from one place in the tree to another.
+// lock-free path walks that overlap this will be redone with locks
+void fs_dcache_rename_begin(void) {
+
+   __sync_fetch_and_add( &fs_dcache_num_renames, 1 );
+   __sync_fetch_and_add( &fs_dcache_rename_seq, 1 );
+}
+
+// finish moving an entry
+void fs_dcache_rename_end(void) {
+
+   __sync_fetch_and_add( &fs_dcache_rename_seq, 1 );
+   __sync_fetch_and_sub( &fs_dcache_num_renames, 1 );
+}
+
+// begin a lock-free path walk.
+// return true, and set *seq, if no rename is in progress
+// return false if one is, or if the index is incomplete (so the walk should take locks)
+bool fs_dcache_read_seqbegin( uint64_t* seq ) {
+
+   *seq = fs_dcache_rename_seq;
+   __sync_synchronize();
+
+   return (fs_dcache_num_renames == 0 && fs_dcache_complete);
+}
+
+// check a lock-free path walk
+// return true if a rename started since fs_dcache_read_seqbegin() (so the walk should be redone with locks)
+bool fs_dcache_read_seqretry( uint64_t seq ) {
+
+   __sync_synchronize();
+   return (fs_dcache_rename_seq != seq);
+}
@@ -0,0 +1,59 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Lock-free dentry cache.
+// Every directory's fs_entry_set is mirrored into one hash table, keyed on (the set's address, name hash), whose
+// buckets readers can walk without taking any locks.  Path walks (see fs_entry_resolve_path_rcu) use it to get from
+// the root to the last entry on a path, locking only that entry.
+//
+// Whatever a lock-free reader can reach--hash table nodes, fs_entry structures, and child sets--is freed only once
+// every reader that might have seen it has left its read-side section (epoch-based reclamation).  Writers still
+// change the tree under the entries' locks as before, and renames bump a sequence count so readers can tell when a
+// walk raced one and must be redone with locks.
+
+#ifndef _DCACHE_H_
+#define _DCACHE_H_
+
+#include "fs_entry.h"
+
+#define FS_DCACHE_NUM_BUCKETS 65536             // must be a power of 2
+#define FS_DCACHE_NUM_LOCKS   256               // writers lock buckets in stripes; must be a power of 2
+
+// read-side sections
+void fs_rcu_read_lock(void);
+void fs_rcu_read_unlock(void);
+
+// free something once no reader can still see it
+int fs_rcu_call( void (*free_cb)( void* ), void* arg );
+
+// free everything waiting to be freed.  Only call this once there are no readers (i.e. on shutdown)
+int fs_rcu_barrier(void);
+
+// index maintenance (the caller must hold the directory's write lock)
+int fs_dcache_insert( fs_entry_set* dir, long name_hash, struct fs_entry* child );
+int fs_dcache_remove( fs_entry_set* dir, long name_hash, struct fs_entry* child );
+int fs_dcache_replace( fs_entry_set* dir, long name_hash, struct fs_entry* child );
+
+// lookup (the caller must be in a read-side section, or hold the directory's lock)
+struct fs_entry* fs_dcache_lookup( fs_entry_set* dir, long name_hash );
+
+// rename sequence count
+void fs_dcache_rename_begin(void);
+void fs_dcache_rename_end(void);
+bool fs_dcache_read_seqbegin( uint64_t* seq );
+bool fs_dcache_read_seqretry( uint64_t seq );
+
+#endif
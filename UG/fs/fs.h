@@ -19,10 +19,13 @@
 
 #include "close.h"
 #include "closedir.h"
+#include "dcache.h"
 #include "fs_entry.h"
+#include "inode.h"
 #include "link.h"
 #include "manifest.h"
 #include "mkdir.h"
+#include "negative.h"
 #include "open.h"
 #include "opendir.h"
 #include "read.h"
@@ -20,6 +20,8 @@
 #include "replication.h"
 #include "driver.h"
 #include "sync.h"
+#include "negative.h"
+#include "dcache.h"
 
 int _debug_locks = 0;
 
@@ -34,8 +36,11 @@ void fs_entry_set_insert( fs_entry_set* set, char const* name, struct fs_entry*
    return fs_entry_set_insert_hash( set, nh, child );
 }
 
-// insert a child entry into an fs_entry_set
+// insert a child entry into an fs_entry_set (and the dcache)
 void fs_entry_set_insert_hash( fs_entry_set* set, long hash, struct fs_entry* child ) {
+   
+   fs_dcache_insert( set, hash, child );
+   
    for( unsigned int i = 0; i < set->size(); i++ ) {
       if( set->at(i).second == NULL ) {
          set->at(i).second = child;
@@ -80,6 +85,8 @@ bool fs_entry_set_remove_hash( fs_entry_set* set, long nh ) {
    for( unsigned int i = 0; i < set->size(); i++ ) {
       if( set->at(i).first == nh ) {
          // invalidate this
+         fs_dcache_remove( set, nh, set->at(i).second );
+         
          set->at(i).second = NULL;
          set->at(i).first = 0;
          removed = true;
@@ -99,6 +106,8 @@ bool fs_entry_set_replace( fs_entry_set* set, char const* name, struct fs_entry*
    long nh = fs_entry_name_hash( name );
    for( unsigned int i = 0; i < set->size(); i++ ) {
       if( set->at(i).first == nh ) {
+         fs_dcache_replace( set, nh, replacement );
+         
          (*set)[i].second = replacement;
          return true;
       }
@@ -127,6 +136,39 @@ long fs_entry_set_get_name_hash( fs_entry_set::iterator* itr ) {
    return (*itr)->first;
 }
 
+// remove the member at an iterator from an fs_entry_set (and the dcache)
+// return the iterator to the next member
+fs_entry_set::iterator fs_entry_set_erase( fs_entry_set* set, fs_entry_set::iterator itr ) {
+   
+   if( itr->second != NULL ) {
+      fs_dcache_remove( set, itr->first, itr->second );
+   }
+   
+   return set->erase( itr );
+}
+
+static void fs_entry_set_delete( void* arg ) {
+   fs_entry_set* set = (fs_entry_set*)arg;
+   delete set;
+}
+
+// free an fs_entry_set, once lock-free path walks can no longer be looking up its members.
+// the set's directory must be write-locked (or unreachable)
+void fs_entry_set_free( fs_entry_set* set ) {
+   
+   for( unsigned int i = 0; i < set->size(); i++ ) {
+      if( set->at(i).second != NULL ) {
+         fs_dcache_remove( set, set->at(i).first, set->at(i).second );
+      }
+   }
+   
+   // path walks use the set's address to look up its members, so it must not be reused while they might be running
+   int rc = fs_rcu_call( fs_entry_set_delete, set );
+   if( rc != 0 ) {
+      SG_error("fs_rcu_call rc = %d; leaking child set\n", rc );
+   }
+}
+
 // get the maximum generation for an entry set 
 int64_t fs_entry_set_max_generation( fs_entry_set* children ) {
    
@@ -179,20 +221,59 @@ int fs_core_init( struct fs_core* core, struct syndicate_state* state, struct md
    
    pthread_rwlock_init( &core->lock, NULL );
    pthread_rwlock_init( &core->fs_lock, NULL );
+   
+   core->remote_write_batches = new fs_entry_remote_write_batch_map_t();
+   core->remote_writes_in_flight = new map<uint64_t, int>();
+   pthread_mutex_init( &core->remote_write_batches_lock, NULL );
+   
+   core->negative_cache = SG_CALLOC( struct fs_entry_negative_cache, 1 );
+   if( core->negative_cache == NULL ) {
+      
+      pthread_rwlock_destroy( &core->lock );
+      pthread_rwlock_destroy( &core->fs_lock );
+      
+      delete core->remote_write_batches;
+      delete core->remote_writes_in_flight;
+      pthread_mutex_destroy( &core->remote_write_batches_lock );
+      return -ENOMEM;
+   }
+   
+   int rc = fs_entry_negative_cache_init( core->negative_cache, conf->negative_cache_size, conf->negative_cache_ttl_ms );
+   if( rc != 0 ) {
+      
+      pthread_rwlock_destroy( &core->lock );
+      pthread_rwlock_destroy( &core->fs_lock );
+      
+      delete core->remote_write_batches;
+      delete core->remote_writes_in_flight;
+      pthread_mutex_destroy( &core->remote_write_batches_lock );
+      
+      free( core->negative_cache );
+      return rc;
+   }
 
    // initialize the root, but make it searchable and mark it as stale 
    core->root = SG_CALLOC( struct fs_entry, 1 );
 
-   int rc = fs_entry_init_dir( core, core->root, "/", 0, 1, owner_id, 0, volume, mode, 0, 0, 0, 0 );
+   rc = fs_entry_init_dir( core, core->root, "/", 0, 1, owner_id, 0, volume, mode, 0, 0, 0, 0 );
    if( rc != 0 ) {
       SG_error("fs_entry_init_dir rc = %d\n", rc );
       
       pthread_rwlock_destroy( &core->lock );
       pthread_rwlock_destroy( &core->fs_lock );
+      
+      delete core->remote_write_batches;
+      delete core->remote_writes_in_flight;
+      pthread_mutex_destroy( &core->remote_write_batches_lock );
+      
+      fs_entry_negative_cache_free( core->negative_cache );
+      free( core->negative_cache );
       return rc;
    }
 
    core->root->link_count = 1;
+   core->rcu_walk = true;
+   
    fs_entry_set_insert( core->root->children, ".", core->root );
    fs_entry_set_insert( core->root->children, "..", core->root );
 
@@ -209,13 +290,27 @@ int fs_core_init( struct fs_core* core, struct syndicate_state* state, struct md
          free( core->closure );
       
       fs_entry_destroy( core->root, true );
-      free( core->root );
+      fs_entry_free( core->root );
       
       pthread_rwlock_destroy( &core->lock );
       pthread_rwlock_destroy( &core->fs_lock );
+      
+      delete core->remote_write_batches;
+      delete core->remote_writes_in_flight;
+      pthread_mutex_destroy( &core->remote_write_batches_lock );
+      
+      fs_entry_negative_cache_free( core->negative_cache );
+      free( core->negative_cache );
       return rc;
    }
 
+   // set up rename batching
+   core->rename_batch = NULL;
+   core->renames_in_flight = new set<uint64_t>();
+   core->rename_names_in_flight = new set< pair<uint64_t, string> >();
+   pthread_mutex_init( &core->rename_lock, NULL );
+   pthread_cond_init( &core->rename_cv, NULL );
+   
    // start watching for reloads 
    struct fs_entry_view_change_cls* cls = SG_CALLOC( struct fs_entry_view_change_cls, 1 );
    
@@ -247,6 +342,35 @@ int fs_core_destroy( struct fs_core* core ) {
    pthread_rwlock_destroy( &core->lock );
    pthread_rwlock_destroy( &core->fs_lock );
    
+   if( core->remote_write_batches != NULL ) {
+      delete core->remote_write_batches;
+      core->remote_write_batches = NULL;
+   }
+   
+   if( core->remote_writes_in_flight != NULL ) {
+      delete core->remote_writes_in_flight;
+      core->remote_writes_in_flight = NULL;
+   }
+   
+   pthread_mutex_destroy( &core->remote_write_batches_lock );
+   
+   if( core->renames_in_flight != NULL ) {
+      delete core->renames_in_flight;
+      core->renames_in_flight = NULL;
+      
+      delete core->rename_names_in_flight;
+      core->rename_names_in_flight = NULL;
+      
+      pthread_mutex_destroy( &core->rename_lock );
+      pthread_cond_destroy( &core->rename_cv );
+   }
+   
+   if( core->negative_cache != NULL ) {
+      fs_entry_negative_cache_free( core->negative_cache );
+      free( core->negative_cache );
+      core->negative_cache = NULL;
+   }
+   
    ms_client_set_config_change_callback( core->ms, NULL, NULL );
    
    if( core->viewchange_cls != NULL ) {
@@ -281,7 +405,7 @@ int fs_unlink_children( struct fs_core* core, fs_entry_set* dir_children, bool r
       struct fs_entry* child = fs_entry_set_get( &itr );
 
       if( child == NULL ) {
-         itr = dir_children->erase( itr );
+         itr = fs_entry_set_erase( dir_children, itr );
          continue;
       }
 
@@ -293,13 +417,13 @@ int fs_unlink_children( struct fs_core* core, fs_entry_set* dir_children, bool r
       }
 
       if( fs_entry_wlock( child ) != 0 ) {
-         itr = dir_children->erase( itr );
+         itr = fs_entry_set_erase( dir_children, itr );
          continue;
       }
 
       destroy_queue.push( child );
       
-      itr = dir_children->erase( itr );
+      itr = fs_entry_set_erase( dir_children, itr );
    }
    
    while( destroy_queue.size() > 0 ) {
@@ -312,13 +436,13 @@ int fs_unlink_children( struct fs_core* core, fs_entry_set* dir_children, bool r
       fent->link_count = 0;
 
       if( old_type == FTYPE_FILE || old_type == FTYPE_FIFO ) {
-         if( fent->open_count == 0 ) {
+         if( fent->open_count == 0 && fent->ref_count == 0 ) {
             if( FS_ENTRY_LOCAL( core, fent ) && remove_data ) {
                md_cache_evict_file( core->cache, fent->file_id, fent->version );
             }
             
             fs_entry_destroy( fent, false );
-            free( fent );
+            fs_entry_free( fent );
          }
       }
 
@@ -328,9 +452,9 @@ int fs_unlink_children( struct fs_core* core, fs_entry_set* dir_children, bool r
 
          fent->link_count = 0;
 
-         if( fent->open_count == 0 ) {
+         if( fent->open_count == 0 && fent->ref_count == 0 ) {
             fs_entry_destroy( fent, false );
-            free( fent );
+            fs_entry_free( fent );
          }
 
          for( fs_entry_set::iterator itr = children->begin(); itr != children->end(); itr++ ) {
@@ -350,7 +474,7 @@ int fs_unlink_children( struct fs_core* core, fs_entry_set* dir_children, bool r
             destroy_queue.push( child );
          }
 
-         delete children;
+         fs_entry_set_free( children );
       }
    }
 
@@ -371,9 +495,14 @@ int fs_destroy( struct fs_core* core ) {
 
    fs_entry_destroy( core->root, false );
 
-   free( core->root );
+   fs_entry_free( core->root );
+   
+   rc = fs_core_destroy( core );
+   
+   // no more path walks; free everything they could have seen
+   fs_rcu_barrier();
    
-   return fs_core_destroy( core );
+   return rc;
 }
 
 
@@ -412,6 +541,7 @@ static int fs_entry_init_data( struct fs_core* core, struct fs_entry* fent,
    fent->ms_manifest_mtime_nsec = 0;
    fent->read_stale = false;
    fent->xattr_cache = new xattr_cache_t();
+   fent->xattr_cache_complete = false;
    fent->write_nonce = write_nonce;
    fent->xattr_nonce = xattr_nonce;
    fent->generation = -1;               // unknown
@@ -591,7 +721,7 @@ int fs_entry_destroy( struct fs_entry* fent, bool needlock ) {
    }
 
    if( fent->children ) {
-      delete fent->children;
+      fs_entry_set_free( fent->children );
       fent->children = NULL;
    }
    
@@ -614,10 +744,26 @@ int fs_entry_destroy( struct fs_entry* fent, bool needlock ) {
    
    fent->ftype = FTYPE_DEAD;      // next thread to hold this lock knows this is a dead entry
    
+   // NOTE: a lock-free path walk may still lock fent, so its locks get destroyed by fs_entry_free()
    fs_entry_unlock( fent );
+   return 0;
+}
+
+static void fs_entry_free_rcu( void* arg ) {
+   struct fs_entry* fent = (struct fs_entry*)arg;
+   
    pthread_rwlock_destroy( &fent->lock );
    pthread_rwlock_destroy( &fent->xattr_lock );
-   return 0;
+   free( fent );
+}
+
+// free a destroyed fs_entry, once no lock-free path walk can still be looking at it
+void fs_entry_free( struct fs_entry* fent ) {
+   
+   int rc = fs_rcu_call( fs_entry_free_rcu, fent );
+   if( rc != 0 ) {
+      SG_error("fs_rcu_call rc = %d; leaking %p\n", rc, fent );
+   }
 }
 
 // destroy an fs_entry if it is no longer referenced.
@@ -630,7 +776,7 @@ int fs_entry_try_destroy( struct fs_core* core, struct fs_entry* fent ) {
    // decrement reference count on the fs_entry itself
    int rc = 0;
    
-   if( fent->link_count <= 0 && fent->open_count <= 0 ) {
+   if( fent->link_count <= 0 && fent->open_count <= 0 && fent->ref_count <= 0 ) {
       
       if( fent->ftype == FTYPE_FILE ) {
          // file is unlinked and no one is manipulating it--safe to destroy
@@ -713,23 +859,22 @@ int fs_entry_get_cached_xattr( struct fs_entry* fent, char const* xattr_name, ch
    xattr_cache_t::iterator itr = fent->xattr_cache->find( xattr_name_s );
    if( itr != fent->xattr_cache->end() ) {
       
+      // NOTE: the value can be empty
       size_t retlen = itr->second.size();
-      if( retlen > 0 ) {
-         char* ret = SG_CALLOC( char, retlen );
+      char* ret = SG_CALLOC( char, retlen + 1 );
+      if( ret == NULL ) {
+         pthread_rwlock_unlock( &fent->xattr_lock );
+         return -ENOMEM;
+      }
       
-         memcpy( ret, itr->second.data(), retlen );
+      memcpy( ret, itr->second.data(), retlen );
       
-         *xattr_value = ret;
-         *xattr_value_len = retlen;
-         
-         pthread_rwlock_unlock( &fent->xattr_lock );
+      *xattr_value = ret;
+      *xattr_value_len = retlen;
       
-         return 0;
-      }
-      else {
-         pthread_rwlock_unlock( &fent->xattr_lock );
-         return -ENODATA;
-      }
+      pthread_rwlock_unlock( &fent->xattr_lock );
+      
+      return 0;
    }
    
    pthread_rwlock_unlock( &fent->xattr_lock );
@@ -738,13 +883,16 @@ int fs_entry_get_cached_xattr( struct fs_entry* fent, char const* xattr_name, ch
    return -ENODATA;
 }
 
-// evict a cached xattr
+// evict a cached xattr.
+// The cache no longer holds every xattr, since we can't tell whether or not the xattr is still readable.
 // fent must be read-locked
 int fs_entry_evict_cached_xattr( struct fs_entry* fent, char const* xattr_name ) {
    string xattr_name_s( xattr_name );
    
    pthread_rwlock_wrlock( &fent->xattr_lock );
    
+   fent->xattr_cache_complete = false;
+   
    xattr_cache_t::iterator itr = fent->xattr_cache->find( xattr_name_s );
    if( itr != fent->xattr_cache->end() ) {
       // erase this 
@@ -769,6 +917,7 @@ int fs_entry_clear_cached_xattrs( struct fs_entry* fent, int64_t new_xattr_nonce
    pthread_rwlock_wrlock( &fent->xattr_lock );
 
    fent->xattr_cache->clear();
+   fent->xattr_cache_complete = false;
 
    fent->xattr_nonce = new_xattr_nonce;
    
@@ -799,7 +948,12 @@ int fs_entry_list_cached_xattrs( struct fs_entry* fent, char** xattr_list, size_
       total_len += itr->first.size() + 1;
    }
    
-   char* ret = SG_CALLOC( char, total_len );
+   char* ret = SG_CALLOC( char, total_len + 1 );
+   if( ret == NULL ) {
+      pthread_rwlock_unlock( &fent->xattr_lock );
+      return -ENOMEM;
+   }
+   
    size_t offset = 0;
    
    for( xattr_cache_t::iterator itr = fent->xattr_cache->begin(); itr != fent->xattr_cache->end(); itr++ ) {
@@ -815,7 +969,8 @@ int fs_entry_list_cached_xattrs( struct fs_entry* fent, char** xattr_list, size_
 }
 
 
-// cache a list of xattr names, if the caller's last known xattr_nonce is fresh (i.e. CAS semantics)
+// cache the complete set of xattrs we can read, if the caller's last known xattr_nonce is fresh (i.e. CAS semantics).
+// on success, fent takes ownership of new_listing
 int fs_entry_cache_xattr_list( struct fs_entry* fent, xattr_cache_t* new_listing, int64_t last_known_xattr_nonce ) {
    
    pthread_rwlock_wrlock( &fent->xattr_lock );
@@ -830,6 +985,7 @@ int fs_entry_cache_xattr_list( struct fs_entry* fent, xattr_cache_t* new_listing
    
    xattr_cache_t* old_listing = fent->xattr_cache;
    fent->xattr_cache = new_listing;
+   fent->xattr_cache_complete = true;
    
    pthread_rwlock_unlock( &fent->xattr_lock );
    
@@ -839,6 +995,20 @@ int fs_entry_cache_xattr_list( struct fs_entry* fent, xattr_cache_t* new_listing
 }
 
 
+// does the cache hold every xattr we can read, as of last_known_xattr_nonce?
+// if so, a cache miss means the xattr does not exist (or is not readable to us)
+bool fs_entry_has_all_cached_xattrs( struct fs_entry* fent, int64_t last_known_xattr_nonce ) {
+   
+   pthread_rwlock_rdlock( &fent->xattr_lock );
+   
+   bool ret = (fent->xattr_cache_complete && fent->xattr_nonce == last_known_xattr_nonce);
+   
+   pthread_rwlock_unlock( &fent->xattr_lock );
+   
+   return ret;
+}
+
+
 // lock a file for reading
 int fs_entry_rlock2( struct fs_entry* fent, char const* from_str, int line_no ) {
    int rc = pthread_rwlock_rdlock( &fent->lock );
@@ -932,6 +1102,20 @@ int fs_core_unlock( struct fs_core* core ) {
    return pthread_rwlock_unlock( &core->lock );
 }
 
+// set the callback to invoke when a file's data changes remotely, so the front-end can drop what it has cached.
+// pass NULL to unset it.
+int fs_core_set_cache_inval_callback( struct fs_core* core, fs_entry_cache_inval_func cache_inval_cb, void* cls ) {
+
+   fs_core_wlock( core );
+
+   core->cache_inval_cb = cache_inval_cb;
+   core->cache_inval_cls = cls;
+
+   fs_core_unlock( core );
+
+   return 0;
+}
+
 // run the eval function on cur_ent.
 // prev_ent must be write-locked, in case cur_ent gets deleted.
 // return the eval function's return code.
@@ -953,7 +1137,7 @@ static int fs_entry_ent_eval( struct fs_entry* prev_ent, struct fs_entry* cur_en
          }
       }
       else {
-         free( cur_ent );
+         fs_entry_free( cur_ent );
          
          if( prev_ent ) {
             SG_debug("Remove %s from %s\n", name_dup, prev_ent->name );
@@ -968,6 +1152,184 @@ static int fs_entry_ent_eval( struct fs_entry* prev_ent, struct fs_entry* cur_en
    return eval_rc;
 }
 
+// get the next name in a path, skipping '.' components, and advance *path past it
+// return its length (0 at the end of the path)
+// return -ENAMETOOLONG if it's longer than NAME_MAX
+static int fs_entry_path_next_name( char const** path, char* name ) {
+   
+   while( true ) {
+      
+      char const* start = *path;
+      while( *start == '/' ) {
+         start++;
+      }
+      
+      char const* end = start;
+      while( *end != '/' && *end != '\0' ) {
+         end++;
+      }
+      
+      size_t len = end - start;
+      *path = end;
+      
+      if( len == 0 ) {
+         return 0;
+      }
+      
+      if( len == 1 && start[0] == '.' ) {
+         continue;
+      }
+      
+      if( len > NAME_MAX ) {
+         return -ENAMETOOLONG;
+      }
+      
+      memcpy( name, start, len );
+      name[len] = '\0';
+      
+      return (int)len;
+   }
+}
+
+
+// resolve an absolute path without locking the entries along it, except for the one at the end.
+// children are looked up in the dcache, and ent_eval (if given) runs on each entry (and its parent, or NULL for the root) as the path is walked.
+// the entries are unlocked and may be changing, so ent_eval must only read fixed-size fields (not fent->name).
+// returns the locked fs_entry at the end of the path on success
+// returns NULL with *err == -EAGAIN if the walk raced a change to the tree (or can't be done without locks); the caller should take locks instead
+// returns NULL with *err set to the error (or ent_eval's nonzero return) otherwise
+struct fs_entry* fs_entry_resolve_path_rcu( struct fs_core* core, char const* path, uint64_t user, uint64_t vol, bool writelock, int* err, int (*ent_eval)( struct fs_entry*, struct fs_entry*, void* ), void* cls ) {
+   
+   uint64_t seq = 0;
+   char name[NAME_MAX+1];
+   int rc = 0;
+   
+   if( vol != core->volume && user != SG_SYS_USER ) {
+      // wrong volume
+      *err = -EXDEV;
+      return NULL;
+   }
+   
+   if( path[0] == '\0' ) {
+      *err = -EINVAL;
+      return NULL;
+   }
+   
+   if( !core->rcu_walk || !fs_dcache_read_seqbegin( &seq ) ) {
+      *err = -EAGAIN;
+      return NULL;
+   }
+   
+   fs_rcu_read_lock();
+   
+   struct fs_entry* cur_ent = core->root;
+   struct fs_entry* prev_ent = NULL;
+   fs_entry_set* prev_children = NULL;       // set cur_ent was found in
+   long cur_hash = 0;
+   
+   if( cur_ent->link_count == 0 ) {
+      // filesystem was nuked
+      rc = -ENOENT;
+   }
+   
+   while( rc == 0 ) {
+      
+      if( ent_eval != NULL ) {
+         rc = (*ent_eval)( prev_ent, cur_ent, cls );
+         if( rc != 0 ) {
+            break;
+         }
+      }
+      
+      int name_len = fs_entry_path_next_name( &path, name );
+      if( name_len < 0 ) {
+         rc = -EAGAIN;
+         break;
+      }
+      
+      // do we have permission to search this directory?
+      if( cur_ent->ftype == FTYPE_DIR && !IS_DIR_READABLE( cur_ent->mode, cur_ent->owner, cur_ent->volume, user, vol ) ) {
+         
+         SG_error("User %" PRIu64 " of volume %" PRIu64 " cannot read directory %" PRIX64 " owned by %" PRIu64 " in volume %" PRIu64 "\n",
+                user, vol, cur_ent->file_id, cur_ent->owner, cur_ent->volume );
+         
+         rc = -EACCES;
+         break;
+      }
+      
+      if( name_len == 0 ) {
+         // ran out of path
+         break;
+      }
+      
+      // if this isn't a directory, then invalid path
+      if( cur_ent->ftype != FTYPE_DIR ) {
+         rc = (cur_ent->ftype == FTYPE_FILE ? -ENOTDIR : -ENOENT);
+         break;
+      }
+      
+      prev_ent = cur_ent;
+      prev_children = cur_ent->children;
+      cur_hash = fs_entry_name_hash( name );
+      
+      cur_ent = fs_dcache_lookup( prev_children, cur_hash );
+      
+      if( cur_ent == NULL || cur_ent->deletion_in_progress ) {
+         // not found
+         rc = -ENOENT;
+         break;
+      }
+   }
+   
+   if( rc == 0 ) {
+      
+      if( writelock ) {
+         fs_entry_wlock( cur_ent );
+      }
+      else {
+         fs_entry_rlock( cur_ent );
+      }
+      
+      // make sure it's still there, now that no one can unlink it
+      if( cur_ent->ftype == FTYPE_DEAD || cur_ent->link_count == 0 || cur_ent->deletion_in_progress ||
+          (prev_children != NULL && fs_dcache_lookup( prev_children, cur_hash ) != cur_ent) ) {
+         
+         fs_entry_unlock( cur_ent );
+         rc = -EAGAIN;
+      }
+   }
+   
+   if( rc != -EAGAIN && fs_dcache_read_seqretry( seq ) ) {
+      
+      // something moved while we walked, so our answer might be wrong
+      if( rc == 0 ) {
+         fs_entry_unlock( cur_ent );
+      }
+      
+      rc = -EAGAIN;
+   }
+   
+   fs_rcu_read_unlock();
+   
+   if( rc == 0 && !IS_READABLE( cur_ent->mode, cur_ent->owner, cur_ent->volume, user, vol ) ) {
+      
+      SG_error("User %" PRIu64 " of volume %" PRIu64 " cannot read file %" PRIX64 " owned by %" PRIu64 " in volume %" PRIu64 "\n",
+               user, vol, cur_ent->file_id, cur_ent->owner, cur_ent->volume );
+      
+      fs_entry_unlock( cur_ent );
+      rc = -EACCES;
+   }
+   
+   *err = rc;
+   
+   if( rc != 0 ) {
+      return NULL;
+   }
+   
+   return cur_ent;
+}
+
+
 // resolve an absolute path, running a given function on each entry as the path is walked
 // returns the locked fs_entry at the end of the path on success
 struct fs_entry* fs_entry_resolve_path_cls( struct fs_core* core, char const* path, uint64_t user, uint64_t vol, bool writelock, int* err, int (*ent_eval)( struct fs_entry*, void* ), void* cls ) {
@@ -978,6 +1340,15 @@ struct fs_entry* fs_entry_resolve_path_cls( struct fs_core* core, char const* pa
       return NULL;
    }
    
+   if( ent_eval == NULL ) {
+      
+      // try without locking the entries along the path first
+      struct fs_entry* fent = fs_entry_resolve_path_rcu( core, path, user, vol, writelock, err, NULL, NULL );
+      if( fent != NULL || *err != -EAGAIN ) {
+         return fent;
+      }
+   }
+   
    // if this path ends in '/', then append a '.'
    char* fpath = NULL;
    if( strlen(path) == 0 ) {
@@ -1362,6 +1733,11 @@ int fs_entry_block_info_free_ex( struct fs_entry_block_info* binfo, bool close_f
       binfo->block_buf = NULL;  
    }
    
+   if( binfo->dirty_ranges ) {
+      delete binfo->dirty_ranges;
+      binfo->dirty_ranges = NULL;
+   }
+   
    if( close_fd && binfo->block_fd >= 0 ) {
       close( binfo->block_fd );  
    }
@@ -1654,6 +2030,84 @@ int fs_entry_merge_old_dirty_blocks( struct fs_core* core, struct fs_entry* fent
    return 0;
 }
 
+// mark [start, end) of a sparse bufferred block as written, coalescing it with any ranges it overlaps or abuts
+static void fs_entry_dirty_ranges_add( fs_entry_dirty_range_map_t* ranges, off_t start, off_t end ) {
+   
+   // find the first range that could touch [start, end)
+   fs_entry_dirty_range_map_t::iterator itr = ranges->upper_bound( start );
+   if( itr != ranges->begin() ) {
+      
+      fs_entry_dirty_range_map_t::iterator prev = itr;
+      prev--;
+      
+      if( prev->second >= start ) {
+         itr = prev;
+      }
+   }
+   
+   // absorb it and everything after it that touches [start, end)
+   while( itr != ranges->end() && itr->first <= end ) {
+      
+      start = MIN( start, itr->first );
+      end = MAX( end, itr->second );
+      
+      ranges->erase( itr++ );
+   }
+   
+   (*ranges)[ start ] = end;
+}
+
+// has all of [start, end) of a sparse bufferred block been written?
+static bool fs_entry_dirty_ranges_cover( fs_entry_dirty_range_map_t* ranges, off_t start, off_t end ) {
+   
+   if( start >= end ) {
+      return true;
+   }
+   
+   // ranges are coalesced, so only the range starting at or before start can cover it
+   fs_entry_dirty_range_map_t::iterator itr = ranges->upper_bound( start );
+   if( itr == ranges->begin() ) {
+      return false;
+   }
+   
+   itr--;
+   return (itr->second >= end);
+}
+
+// fill in the unwritten parts of a sparse bufferred block from base_block, a copy of the older version it patches.
+// afterwards, binfo holds a whole block.
+// always succeeds
+int fs_entry_block_info_fill_sparse( struct fs_entry_block_info* binfo, char const* base_block, size_t base_len ) {
+   
+   if( binfo->dirty_ranges == NULL ) {
+      // already whole
+      return 0;
+   }
+   
+   off_t gap_start = 0;
+   off_t block_len = MIN( binfo->block_len, base_len );
+   
+   // copy everything between the written ranges
+   for( fs_entry_dirty_range_map_t::iterator itr = binfo->dirty_ranges->begin(); itr != binfo->dirty_ranges->end(); itr++ ) {
+      
+      if( gap_start < itr->first && gap_start < block_len ) {
+         memcpy( binfo->block_buf + gap_start, base_block + gap_start, MIN( itr->first, block_len ) - gap_start );
+      }
+      
+      gap_start = itr->second;
+   }
+   
+   // copy everything after the last written range
+   if( gap_start < block_len ) {
+      memcpy( binfo->block_buf + gap_start, base_block + gap_start, block_len - gap_start );
+   }
+   
+   delete binfo->dirty_ranges;
+   binfo->dirty_ranges = NULL;
+   
+   return 0;
+}
+
 // is a block bufferred in RAM?
 // return 1 if so.
 // return -ENOENT if not.
@@ -1689,6 +2143,7 @@ int fs_entry_has_bufferred_block( struct fs_entry* fent, uint64_t block_id ) {
 // read part of a bufferred block, starting at block_offset
 // return 0 on success
 // return -ENOENT if there is no block.
+// return -ENODATA if the block is sparse and not all of the requested range has been written (see fs_entry_fill_sparse_bufferred_blocks)
 // return negative on error
 // fent must be read-locked 
 int fs_entry_read_bufferred_block( struct fs_entry* fent, uint64_t block_id, char* buf, off_t block_offset, size_t read_len ) {
@@ -1705,6 +2160,10 @@ int fs_entry_read_bufferred_block( struct fs_entry* fent, uint64_t block_id, cha
             if( block_offset + read_len < 0 || block_offset + read_len > binfo->block_len ) {
                return -ERANGE;
             }
+            else if( binfo->dirty_ranges != NULL && !fs_entry_dirty_ranges_cover( binfo->dirty_ranges, block_offset, block_offset + read_len ) ) {
+               // part of this range was never written, and the older version has not been filled in yet
+               return -ENODATA;
+            }
             else {
                // have an in-core copy of this block.  Read it 
                memcpy( buf, binfo->block_buf + block_offset, read_len );
@@ -1767,6 +2226,22 @@ int fs_entry_write_bufferred_block( struct fs_core* core, struct fs_entry* fent,
             // have an in-core copy of this block.  Write to it 
             memcpy( binfo->block_buf + block_offset, buf, write_len );
             binfo->dirty = true;
+            
+            if( binfo->dirty_ranges != NULL ) {
+               
+               // remember which bytes we have
+               fs_entry_dirty_ranges_add( binfo->dirty_ranges, block_offset, block_offset + write_len );
+               
+               if( fs_entry_dirty_ranges_cover( binfo->dirty_ranges, 0, binfo->block_len ) ) {
+                  
+                  // overwritten completely, so the older version will never be needed
+                  SG_debug("sparse bufferred block %" PRIX64 "[%" PRIu64 "] is now whole\n", fent->file_id, block_id );
+                  
+                  delete binfo->dirty_ranges;
+                  binfo->dirty_ranges = NULL;
+               }
+            }
+            
             return 0;
          }
       }
@@ -1788,6 +2263,125 @@ int fs_entry_write_bufferred_block( struct fs_core* core, struct fs_entry* fent,
    }
 }
 
+// write to a bufferred block without reading in the rest of it first.
+// if the block is not bufferred yet, create it as a sparse block that remembers only the written bytes, along with the
+// version (and its host) of the block it patches, so the rest can be filled in later if the block is not overwritten first.
+// if the block is already bufferred, this is the same as fs_entry_write_bufferred_block.
+// return 0 on success
+// return negative on error
+// fent must be write-locked
+int fs_entry_write_sparse_bufferred_block( struct fs_core* core, struct fs_entry* fent, uint64_t block_id, int64_t base_version, uint64_t base_gateway_id, char const* buf, off_t block_offset, size_t write_len ) {
+   
+   if( fent->bufferred_blocks ) {
+      
+      int has_block = fs_entry_has_bufferred_block( fent, block_id );
+      if( has_block == -ENOENT ) {
+         
+         struct fs_entry_block_info* binfo = &((*fent->bufferred_blocks)[ block_id ]);
+         
+         fs_entry_block_info_buffer_init( binfo, core->blocking_factor );
+         
+         binfo->version = base_version;
+         binfo->gateway_id = base_gateway_id;
+         binfo->dirty_ranges = new fs_entry_dirty_range_map_t();
+      }
+      
+      return fs_entry_write_bufferred_block( core, fent, block_id, buf, block_offset, write_len );
+   }
+   else {
+      SG_error("BUG: %" PRIX64 "'s bufferred_blocks is not allocated\n", fent->file_id);
+      return -ENODATA;
+   }
+}
+
+
+// get a reference to a bufferred block's data, if all of it is present.
+// the reference remains valid until the block is cleared or extracted.
+// return 0 on success, and set *block_buf and *block_len
+// return -ENOENT if the block is not bufferred
+// return -EAGAIN if the block is sparse
+// fent must be at least read-locked
+int fs_entry_get_whole_bufferred_block( struct fs_entry* fent, uint64_t block_id, char** block_buf, size_t* block_len ) {
+   
+   if( fent->bufferred_blocks ) {
+      
+      modification_map::iterator itr = fent->bufferred_blocks->find( block_id );
+      if( itr == fent->bufferred_blocks->end() || itr->second.block_buf == NULL ) {
+         return -ENOENT;
+      }
+      
+      if( itr->second.dirty_ranges != NULL ) {
+         return -EAGAIN;
+      }
+      
+      *block_buf = itr->second.block_buf;
+      *block_len = itr->second.block_len;
+      return 0;
+   }
+   else {
+      SG_error("BUG: %" PRIX64 "'s bufferred_blocks is not allocated\n", fent->file_id);
+      return -ENODATA;
+   }
+}
+
+
+// how many sparse bufferred blocks are there in [start_block_id, end_block_id]?
+// return the number on success
+// return negative on error
+// fent must be at least read-locked
+int fs_entry_has_sparse_bufferred_blocks( struct fs_entry* fent, uint64_t start_block_id, uint64_t end_block_id ) {
+   
+   if( fent->bufferred_blocks ) {
+      
+      int count = 0;
+      
+      for( modification_map::iterator itr = fent->bufferred_blocks->lower_bound( start_block_id ); itr != fent->bufferred_blocks->end() && itr->first <= end_block_id; itr++ ) {
+         
+         if( itr->second.dirty_ranges != NULL ) {
+            count++;
+         }
+      }
+      
+      return count;
+   }
+   else {
+      SG_error("BUG: %" PRIX64 "'s bufferred_blocks is not allocated\n", fent->file_id);
+      return -ENODATA;
+   }
+}
+
+
+// extract the sparse bufferred blocks in [start_block_id, end_block_id] to a modification map, removing them from fent.
+// put them back with fs_entry_emplace_bufferred_blocks.
+// fent must be write-locked 
+int fs_entry_extract_sparse_bufferred_blocks( struct fs_entry* fent, uint64_t start_block_id, uint64_t end_block_id, modification_map* block_info ) {
+   
+   if( fent->bufferred_blocks ) {
+      
+      modification_map::iterator itr = fent->bufferred_blocks->lower_bound( start_block_id );
+      
+      while( itr != fent->bufferred_blocks->end() && itr->first <= end_block_id ) {
+         
+         if( itr->second.dirty_ranges != NULL ) {
+            
+            // NOTE: don't duplicate; copy directly
+            (*block_info)[ itr->first ] = itr->second;
+            fent->bufferred_blocks->erase( itr++ );
+         }
+         else {
+            itr++;
+         }
+      }
+   }
+   else {
+      SG_error("BUG: %" PRIX64 "'s bufferred_blocks is not allocated\n", fent->file_id );
+      return -ENODATA;
+   }
+   
+   return 0;
+}
+
+
 // replace a bufferred block's contents, indicating in the process whether or not it came from a read or write (i.e. not dirty or dirty)
 // if there is no block data, then allocate it.
 // return 0 and fill in buf, buf_len on success with the block buffer
@@ -1827,6 +2421,12 @@ int fs_entry_replace_bufferred_block( struct fs_core* core, struct fs_entry* fen
       memcpy( binfo->block_buf, buf, buf_len );
       binfo->dirty = dirty;
       
+      // the block is whole now
+      if( binfo->dirty_ranges != NULL ) {
+         delete binfo->dirty_ranges;
+         binfo->dirty_ranges = NULL;
+      }
+      
       return 0;
    }
    else {
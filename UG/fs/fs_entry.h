@@ -46,6 +46,7 @@
 
 #include "libsyndicate/libsyndicate.h"
 #include "libsyndicate/cache.h"
+#include "libsyndicate/trace.h"
 #include "libsyndicate/ms/ms-client.h"
 
 using namespace std;
@@ -68,6 +69,9 @@ using namespace std;
 typedef pair<long, struct fs_entry*> fs_dirent;
 typedef vector<fs_dirent> fs_entry_set;
 
+// byte ranges written to a bufferred block: start offset --> end offset (exclusive)
+typedef map<off_t, off_t> fs_entry_dirty_range_map_t;
+
 struct fs_entry_block_info {
    int64_t version;
    uint64_t gateway_id;
@@ -79,6 +83,10 @@ struct fs_entry_block_info {
    char* block_buf;     // if non-NULL, this is the block itself in RAM (only applicable for bufferred blocks)
    size_t block_len;    // length of block_buf
    bool dirty;          // if true, then this block must be flushed to disk
+   
+   // if non-NULL, this bufferred block is sparse: only these ranges of block_buf have been written, and the rest must be
+   // filled in from the older version of the block (given by version and gateway_id) before the whole block can be used.
+   fs_entry_dirty_range_map_t* dirty_ranges;
 };
 
 typedef map<uint64_t, struct fs_entry_block_info> modification_map;
@@ -93,6 +101,18 @@ struct sync_context;
 
 typedef list<struct sync_context*> sync_context_list_t;     // queue of sync contexts
 
+// remote writes to a file that are waiting to be applied together (see write.h)
+struct fs_entry_remote_write_req;
+typedef vector<struct fs_entry_remote_write_req*> fs_entry_remote_write_batch_t;
+typedef map<uint64_t, fs_entry_remote_write_batch_t*> fs_entry_remote_write_batch_map_t;
+
+// renames that will be sent to the MS together (see rename.h)
+struct fs_entry_rename_req;
+typedef vector<struct fs_entry_rename_req*> fs_entry_rename_batch_t;
+
+// names we know do not exist (see negative.h)
+struct fs_entry_negative_cache;
+
 // Syndicate filesystem entry
 struct fs_entry {
    char ftype;                // what type of file this is
@@ -108,6 +128,7 @@ struct fs_entry {
    off_t size;                // how big is this file's content?
    int link_count;            // how many other fs_entry structures refer to this file
    int open_count;            // how many file descriptors refer to this file
+   int ref_count;             // how many other references a front-end holds on this fs_entry (i.e. inodes the kernel looked up)
    int64_t generation;        // the generation number of this file (n, as in, the nth creat() in the parent directory)
    
    int64_t mtime_sec;         // modification time (seconds)
@@ -143,12 +164,15 @@ struct fs_entry {
    
    pthread_rwlock_t xattr_lock;
    xattr_cache_t* xattr_cache;  // cached xattrs
+   bool xattr_cache_complete;   // if true, xattr_cache holds every xattr we can read (as of xattr_nonce)
    
    bool created_in_session;     // if we're in client mode, then this is true of the file was created in this session
    bool deletion_in_progress;   // if true, we're in the process of deleting a file (which is not atomic)
    
    bool vacuuming;              // if true, then we're currently vacuuming this file
    bool vacuumed;               // if true, then we've already tried to vacuum this file upon discovery (false means we should try again)
+   
+   bool kernel_cache_stale;     // if true, then the kernel may still be caching pages from an older version of this file's data
 };
 
 #define IS_STREAM_FILE( fent ) ((fent).size < 0)
@@ -201,6 +225,10 @@ struct fs_entry_view_change_cls {
    uint64_t cert_version;
 };
 
+// called when a file's data changes out from under any copies of it cached above us (i.e. in the kernel).
+// fent will be write-locked, and a reader may be holding kernel pages locked while it waits on it, so this must not wait on the kernel.
+typedef void (*fs_entry_cache_inval_func)( struct fs_core* core, struct fs_entry* fent, void* cls );
+
 // Syndicate core information
 struct fs_core {
    struct fs_entry* root;              // root FS entry
@@ -217,6 +245,23 @@ struct fs_core {
 
    pthread_rwlock_t lock;     // lock to control access to this structure
    pthread_rwlock_t fs_lock;  // lock to create/remove entries in the filesystem
+   
+   fs_entry_remote_write_batch_map_t* remote_write_batches;   // file ID to the remote writes that will be applied to it next
+   map<uint64_t, int>* remote_writes_in_flight;               // file ID to the number of remote writes to it that have arrived but not finished
+   pthread_mutex_t remote_write_batches_lock;                 // lock to control access to remote_write_batches and remote_writes_in_flight
+   
+   fs_entry_rename_batch_t* rename_batch;                     // renames that will be sent to the MS next (NULL if no batch is open)
+   set<uint64_t>* renames_in_flight;                          // IDs of files being renamed, or renamed over, whose MS update is outstanding
+   set< pair<uint64_t, string> >* rename_names_in_flight;     // (parent ID, name) of each rename destination whose MS update is outstanding
+   pthread_mutex_t rename_lock;                               // lock to control access to rename_batch, renames_in_flight, and rename_names_in_flight
+   pthread_cond_t rename_cv;                                  // signaled when files or names leave renames_in_flight or rename_names_in_flight
+   
+   struct fs_entry_negative_cache* negative_cache;            // nonexistent names we have looked up recently
+   
+   fs_entry_cache_inval_func cache_inval_cb;                  // tell the front-end to drop its cached copy of a file's data
+   void* cache_inval_cls;                                     // passed to cache_inval_cb
+   
+   bool rcu_walk;                                             // if true, resolve paths without locking the entries along them (see dcache.h)
 };
 
 #define FS_ENTRY_LOCAL( core, fent ) (fent->coordinator == core->gateway)
@@ -243,6 +288,9 @@ int fs_core_rlock( struct fs_core* core );
 int fs_core_wlock( struct fs_core* core );
 int fs_core_unlock( struct fs_core* core );
 
+// front-end cache invalidation
+int fs_core_set_cache_inval_callback( struct fs_core* core, fs_entry_cache_inval_func cache_inval_cb, void* cls );
+
 // fs_entry initialization
 int fs_entry_init_file( struct fs_core* core, struct fs_entry* fent,
                         char const* name, uint64_t file_id, int64_t version, uint64_t owner, uint64_t coordinator, uint64_t volume, mode_t mode, off_t size, int64_t mtime_sec, int32_t mtime_nsec,
@@ -265,6 +313,7 @@ int64_t fs_entry_next_block_version(void);
 // fs_entry cleanup 
 int fs_entry_destroy( struct fs_entry* fent, bool needlock );
 int fs_entry_try_destroy( struct fs_core* core, struct fs_entry* fent );
+void fs_entry_free( struct fs_entry* fent );
 
 // fs_file_handle cleanup
 int fs_file_handle_destroy( struct fs_file_handle* fh );
@@ -283,6 +332,7 @@ int fs_entry_evict_cached_xattr( struct fs_entry* fent, char const* xattr_name )
 int fs_entry_clear_cached_xattrs( struct fs_entry* fent, int64_t new_xattr_nonce );
 int fs_entry_list_cached_xattrs( struct fs_entry* fent, char** xattr_list, size_t* xattr_list_len, int64_t last_known_xattr_nonce );
 int fs_entry_cache_xattr_list( struct fs_entry* fent, xattr_cache_t* new_listing, int64_t last_known_xattr_nonce );
+bool fs_entry_has_all_cached_xattrs( struct fs_entry* fent, int64_t last_known_xattr_nonce );
 
 // dirty block handling 
 int fs_entry_setup_garbage_blocks( struct fs_entry* fent );
@@ -320,6 +370,7 @@ long fs_entry_name_hash( char const* name );
 // resolution
 struct fs_entry* fs_entry_resolve_path( struct fs_core* core, char const* path, uint64_t user, uint64_t vol, bool writelock, int* err );
 struct fs_entry* fs_entry_resolve_path_cls( struct fs_core* core, char const* path, uint64_t user, uint64_t vol, bool writelock, int* err, int (*ent_eval)( struct fs_entry*, void* ), void* cls );
+struct fs_entry* fs_entry_resolve_path_rcu( struct fs_core* core, char const* path, uint64_t user, uint64_t vol, bool writelock, int* err, int (*ent_eval)( struct fs_entry*, struct fs_entry*, void* ), void* cls );
 struct fs_entry* fs_entry_resolve_path_and_parent_info( struct fs_core* core, char const* path, uint64_t user, uint64_t vol, bool writelock, int* err, uint64_t* parent_id, char** parent_name );
 char* fs_entry_resolve_block( struct fs_core* core, struct fs_file_handle* fh, off_t offset );
 uint64_t fs_entry_block_id( struct fs_core* core, off_t offset );
@@ -336,6 +387,8 @@ bool fs_entry_set_replace( fs_entry_set* set, char const* name, struct fs_entry*
 unsigned int fs_entry_set_count( fs_entry_set* set );
 struct fs_entry* fs_entry_set_get( fs_entry_set::iterator* itr );
 long fs_entry_set_get_name_hash( fs_entry_set::iterator* itr );
+fs_entry_set::iterator fs_entry_set_erase( fs_entry_set* set, fs_entry_set::iterator itr );
+void fs_entry_set_free( fs_entry_set* set );
 int64_t fs_entry_set_max_generation( fs_entry_set* children );
 
 // conversion
@@ -360,6 +413,11 @@ int fs_entry_block_info_free_ex( struct fs_entry_block_info* binfo, bool close_f
 int fs_entry_has_bufferred_block( struct fs_entry* fent, uint64_t block_id );
 int fs_entry_read_bufferred_block( struct fs_entry* fent, uint64_t block_id, char* buf, off_t block_offset, size_t read_len );
 int fs_entry_write_bufferred_block( struct fs_core* core, struct fs_entry* fent, uint64_t block_id, char const* buf, off_t block_offset, size_t write_len );
+int fs_entry_write_sparse_bufferred_block( struct fs_core* core, struct fs_entry* fent, uint64_t block_id, int64_t base_version, uint64_t base_gateway_id, char const* buf, off_t block_offset, size_t write_len );
+int fs_entry_get_whole_bufferred_block( struct fs_entry* fent, uint64_t block_id, char** block_buf, size_t* block_len );
+int fs_entry_has_sparse_bufferred_blocks( struct fs_entry* fent, uint64_t start_block_id, uint64_t end_block_id );
+int fs_entry_extract_sparse_bufferred_blocks( struct fs_entry* fent, uint64_t start_block_id, uint64_t end_block_id, modification_map* block_info );
+int fs_entry_block_info_fill_sparse( struct fs_entry_block_info* binfo, char const* base_block, size_t base_len );
 int fs_entry_replace_bufferred_block( struct fs_core* core, struct fs_entry* fent, uint64_t block_id, char* buf, size_t buf_len, bool dirty );
 int fs_entry_clear_bufferred_block( struct fs_entry* fent, uint64_t block_id );
 int fs_entry_extract_bufferred_blocks( struct fs_entry* fent, modification_map* block_info );
@@ -0,0 +1,329 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "inode.h"
+
+// set up an inode table
+// return 0 on success
+// return -ENOMEM if out of memory
+int fs_inode_table_init( struct fs_inode_table* table ) {
+
+   memset( table, 0, sizeof(struct fs_inode_table) );
+
+   table->inodes = SG_safe_new( fs_inode_map_t() );
+   if( table->inodes == NULL ) {
+      return -ENOMEM;
+   }
+
+   table->paths = SG_safe_new( fs_inode_path_map_t() );
+   if( table->paths == NULL ) {
+
+      SG_safe_delete( table->inodes );
+      return -ENOMEM;
+   }
+
+   pthread_mutex_init( &table->lock, NULL );
+
+   return 0;
+}
+
+
+// free an inode table, dropping the references its inodes held
+int fs_inode_table_free( struct fs_core* core, struct fs_inode_table* table ) {
+
+   if( table->inodes != NULL ) {
+
+      for( fs_inode_map_t::iterator itr = table->inodes->begin(); itr != table->inodes->end(); itr++ ) {
+
+         struct fs_inode* inode = itr->second;
+
+         fs_inode_put_entry( core, inode->fent );
+
+         free( inode );
+      }
+
+      SG_safe_delete( table->inodes );
+   }
+
+   SG_safe_delete( table->paths );
+
+   pthread_mutex_destroy( &table->lock );
+
+   return 0;
+}
+
+
+// get the inode number of a file
+uint64_t fs_inode_from_file_id( uint64_t file_id ) {
+
+   if( file_id == 0 ) {
+      return FS_INODE_ROOT;
+   }
+
+   if( file_id == FS_INODE_ROOT ) {
+      // taken by the root
+      return FS_INODE_FILE_ID_ROOT;
+   }
+
+   return file_id;
+}
+
+
+// drop a reference to an fs_entry obtained from the inode table, destroying it if it was the last one (and the entry is unlinked).
+// fent must not be locked
+// always succeeds
+int fs_inode_put_entry( struct fs_core* core, struct fs_entry* fent ) {
+
+   uint64_t file_id = fent->file_id;
+
+   fs_entry_wlock( fent );
+
+   __sync_fetch_and_sub( &fent->ref_count, 1 );
+
+   int rc = fs_entry_try_destroy( core, fent );
+   if( rc > 0 ) {
+
+      // fent was unlocked and destroyed
+      SG_debug("Destroyed %" PRIX64 "\n", file_id );
+      fs_entry_free( fent );
+   }
+   else {
+
+      fs_entry_unlock( fent );
+   }
+
+   return 0;
+}
+
+
+// record a lookup of an fs_entry, creating its inode if need be, and get back its inode number.
+// if the inode referred to an older fs_entry for the same file (i.e. one that got replaced), it will refer to fent from now on.
+// fent must be at least read-locked
+// return 0 on success
+// return -ENOMEM if out of memory
+int fs_inode_table_lookup( struct fs_core* core, struct fs_inode_table* table, struct fs_entry* fent, char const* path, uint64_t* ino ) {
+
+   uint64_t inode_number = fs_inode_from_file_id( fent->file_id );
+   struct fs_entry* old_fent = NULL;
+
+   pthread_mutex_lock( &table->lock );
+
+   fs_inode_map_t::iterator itr = table->inodes->find( inode_number );
+
+   if( itr == table->inodes->end() ) {
+
+      // first lookup
+      struct fs_inode* inode = SG_CALLOC( struct fs_inode, 1 );
+      if( inode == NULL ) {
+
+         pthread_mutex_unlock( &table->lock );
+         return -ENOMEM;
+      }
+
+      inode->fent = fent;
+      inode->nlookup = 1;
+
+      try {
+
+         inode->path_itr = table->paths->insert( fs_inode_path_map_t::value_type( string(path), inode ) );
+
+         try {
+            (*table->inodes)[ inode_number ] = inode;
+         }
+         catch( bad_alloc& ba ) {
+
+            table->paths->erase( inode->path_itr );
+            throw;
+         }
+      }
+      catch( bad_alloc& ba ) {
+
+         pthread_mutex_unlock( &table->lock );
+         free( inode );
+         return -ENOMEM;
+      }
+
+      __sync_fetch_and_add( &fent->ref_count, 1 );
+   }
+   else {
+
+      struct fs_inode* inode = itr->second;
+
+      // path may have changed
+      if( inode->path_itr->first != path ) {
+
+         try {
+
+            fs_inode_path_map_t::iterator path_itr = table->paths->insert( fs_inode_path_map_t::value_type( string(path), inode ) );
+
+            table->paths->erase( inode->path_itr );
+            inode->path_itr = path_itr;
+         }
+         catch( bad_alloc& ba ) {
+
+            pthread_mutex_unlock( &table->lock );
+            return -ENOMEM;
+         }
+      }
+
+      inode->nlookup++;
+
+      if( inode->fent != fent ) {
+
+         // the entry got replaced
+         old_fent = inode->fent;
+
+         inode->fent = fent;
+         __sync_fetch_and_add( &fent->ref_count, 1 );
+      }
+   }
+
+   pthread_mutex_unlock( &table->lock );
+
+   if( old_fent != NULL ) {
+      fs_inode_put_entry( core, old_fent );
+   }
+
+   *ino = inode_number;
+
+   return 0;
+}
+
+
+// forget nlookup lookups of an inode.  If there are none left, the inode is removed and its fs_entry reference dropped.
+// return 0 on success
+// return -ENOENT if there is no such inode
+int fs_inode_table_forget( struct fs_core* core, struct fs_inode_table* table, uint64_t ino, uint64_t nlookup ) {
+
+   struct fs_inode* dead_inode = NULL;
+
+   pthread_mutex_lock( &table->lock );
+
+   fs_inode_map_t::iterator itr = table->inodes->find( ino );
+
+   if( itr == table->inodes->end() ) {
+
+      pthread_mutex_unlock( &table->lock );
+      return -ENOENT;
+   }
+
+   struct fs_inode* inode = itr->second;
+
+   if( inode->nlookup <= nlookup ) {
+
+      // no more lookups
+      dead_inode = inode;
+      table->paths->erase( inode->path_itr );
+      table->inodes->erase( itr );
+   }
+   else {
+
+      inode->nlookup -= nlookup;
+   }
+
+   pthread_mutex_unlock( &table->lock );
+
+   if( dead_inode != NULL ) {
+
+      fs_inode_put_entry( core, dead_inode->fent );
+
+      free( dead_inode );
+   }
+
+   return 0;
+}
+
+
+// get a referenced fs_entry for an inode, and optionally a copy of its path.
+// the caller must release the entry with fs_inode_put_entry, and free the path.
+// return NULL if there is no such inode, or if out of memory
+struct fs_entry* fs_inode_table_get( struct fs_inode_table* table, uint64_t ino, char** path ) {
+
+   struct fs_entry* fent = NULL;
+
+   pthread_mutex_lock( &table->lock );
+
+   fs_inode_map_t::iterator itr = table->inodes->find( ino );
+
+   if( itr != table->inodes->end() ) {
+
+      struct fs_inode* inode = itr->second;
+
+      if( path != NULL ) {
+
+         *path = strdup( inode->path_itr->first.c_str() );
+         if( *path == NULL ) {
+
+            pthread_mutex_unlock( &table->lock );
+            return NULL;
+         }
+      }
+
+      fent = inode->fent;
+
+      // the inode holds a reference, so fent can't go away while we add ours
+      __sync_fetch_and_add( &fent->ref_count, 1 );
+   }
+
+   pthread_mutex_unlock( &table->lock );
+
+   return fent;
+}
+
+
+// update the paths of the inodes at and beneath old_path, after a rename
+// return 0 on success
+// return -ENOMEM if out of memory
+int fs_inode_table_rename( struct fs_inode_table* table, char const* old_path, char const* new_path ) {
+
+   int rc = 0;
+   size_t old_path_len = strlen( old_path );
+   vector<struct fs_inode*> renamed;
+
+   pthread_mutex_lock( &table->lock );
+
+   try {
+
+      // old_path itself, and then everything beneath it (which sorts together)
+      string old_prefix = string(old_path) + "/";
+
+      for( fs_inode_path_map_t::iterator itr = table->paths->lower_bound( string(old_path) ); itr != table->paths->end() && itr->first == old_path; itr++ ) {
+         renamed.push_back( itr->second );
+      }
+
+      for( fs_inode_path_map_t::iterator itr = table->paths->lower_bound( old_prefix ); itr != table->paths->end() && itr->first.compare( 0, old_prefix.size(), old_prefix ) == 0; itr++ ) {
+         renamed.push_back( itr->second );
+      }
+
+      for( unsigned int i = 0; i < renamed.size(); i++ ) {
+
+         struct fs_inode* inode = renamed[i];
+         string renamed_path = string(new_path) + inode->path_itr->first.substr( old_path_len );
+
+         fs_inode_path_map_t::iterator path_itr = table->paths->insert( fs_inode_path_map_t::value_type( renamed_path, inode ) );
+
+         table->paths->erase( inode->path_itr );
+         inode->path_itr = path_itr;
+      }
+   }
+   catch( bad_alloc& ba ) {
+      rc = -ENOMEM;
+   }
+
+   pthread_mutex_unlock( &table->lock );
+
+   return rc;
+}
@@ -0,0 +1,62 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef _INODE_H_
+#define _INODE_H_
+
+#include "fs_entry.h"
+
+// Inode table, for front-ends that address entries by inode number instead of by path (i.e. the FUSE low-level API).
+// An entry's inode number is its file ID, except for the root (file ID 0), which gets FS_INODE_ROOT, and the file with
+// file ID FS_INODE_ROOT, which gets FS_INODE_FILE_ID_ROOT instead (ms_client_make_file_id never hands that one out).
+// Each inode holds a reference on its fs_entry (see fs_entry::ref_count) until the front-end forgets all of its lookups,
+// so the fs_entry stays valid even if it gets unlinked or removed from the MS in the meantime.
+// NOTE: the table's lock is never held while waiting on an fs_entry's lock.
+
+#define FS_INODE_ROOT 1
+#define FS_INODE_FILE_ID_ROOT ((uint64_t)(-1))
+
+struct fs_inode;
+
+// inodes by path, so a rename only visits the inodes it moves
+typedef multimap<string, struct fs_inode*> fs_inode_path_map_t;
+
+struct fs_inode {
+   struct fs_entry* fent;                       // referenced entry
+   fs_inode_path_map_t::iterator path_itr;      // path to the entry as of its last lookup (for operations that need one)
+   uint64_t nlookup;                            // number of lookups not yet forgotten
+};
+
+typedef map<uint64_t, struct fs_inode*> fs_inode_map_t;
+
+struct fs_inode_table {
+   fs_inode_map_t* inodes;
+   fs_inode_path_map_t* paths;
+   pthread_mutex_t lock;
+};
+
+int fs_inode_table_init( struct fs_inode_table* table );
+int fs_inode_table_free( struct fs_core* core, struct fs_inode_table* table );
+
+uint64_t fs_inode_from_file_id( uint64_t file_id );
+
+int fs_inode_table_lookup( struct fs_core* core, struct fs_inode_table* table, struct fs_entry* fent, char const* path, uint64_t* ino );
+int fs_inode_table_forget( struct fs_core* core, struct fs_inode_table* table, uint64_t ino, uint64_t nlookup );
+struct fs_entry* fs_inode_table_get( struct fs_inode_table* table, uint64_t ino, char** path );
+int fs_inode_put_entry( struct fs_core* core, struct fs_entry* fent );
+int fs_inode_table_rename( struct fs_inode_table* table, char const* old_path, char const* new_path );
+
+#endif
@@ -15,6 +15,7 @@
 */
 
 #include "link.h"
+#include "negative.h"
 
 
 // attach an entry as a child directly
@@ -30,6 +31,9 @@ int fs_entry_attach_lowlevel( struct fs_core* core, struct fs_entry* parent, str
 
    fs_entry_set_insert( parent->children, fent->name, fent );
    fs_core_fs_unlock( core );
+   
+   // it exists now
+   fs_entry_negative_cache_evict( core->negative_cache, parent->file_id, fent->name );
    return 0;
 }
 
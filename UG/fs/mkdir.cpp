@@ -16,6 +16,7 @@
 
 #include "mkdir.h"
 #include "link.h"
+#include "rename.h"
 
 // low-level mkdir
 int fs_entry_mkdir_lowlevel( struct fs_core* core, char const* path, struct fs_entry* parent, char const* path_basename, mode_t mode, uint64_t user, uint64_t vol, int64_t mtime_sec, int32_t mtime_nsec ) {
@@ -102,6 +103,19 @@ int fs_entry_mkdir_once( struct fs_core* core, char const* path, mode_t mode, ui
    }
 
    uint64_t parent_id = parent->file_id;
+   
+   // something is being renamed to this name.  Wait for it to land, and have the caller try again.
+   if( fs_entry_set_find_name( parent->children, path_basename ) == NULL && fs_entry_rename_name_claimed( core, parent_id, path_basename ) ) {
+      
+      fs_entry_unlock( parent );
+      
+      fs_entry_rename_wait_name( core, parent_id, path_basename );
+      
+      free( path_basename );
+      free( path_dirname );
+      return -EAGAIN;
+   }
+   
    char* parent_name = strdup( parent->name );
    
    struct timespec ts;
@@ -156,7 +170,7 @@ int fs_entry_mkdir_once( struct fs_core* core, char const* path, mode_t mode, ui
    return err;
 }
 
-// mkdir, but try again if revalidation fails
+// mkdir, but try again if revalidation fails, or if we had to wait for a rename onto the same name
 // return -ENODATA if all attempts fail
 int fs_entry_mkdir( struct fs_core* core, char const* path, mode_t mode, uint64_t user, uint64_t vol ) {
    
@@ -0,0 +1,173 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "negative.h"
+
+// set up a negative entry cache 
+// return 0 on success
+// return -ENOMEM if out of memory
+int fs_entry_negative_cache_init( struct fs_entry_negative_cache* cache, size_t max_size, int ttl_ms ) {
+   
+   memset( cache, 0, sizeof(struct fs_entry_negative_cache) );
+   
+   cache->ents = SG_safe_new( fs_entry_negative_map_t() );
+   cache->lru = SG_safe_new( fs_entry_negative_lru_t() );
+   
+   if( cache->ents == NULL || cache->lru == NULL ) {
+      
+      SG_safe_delete( cache->ents );
+      SG_safe_delete( cache->lru );
+      return -ENOMEM;
+   }
+   
+   cache->max_size = max_size;
+   cache->ttl_ms = ttl_ms;
+   
+   pthread_mutex_init( &cache->lock, NULL );
+   
+   return 0;
+}
+
+
+// free a negative entry cache 
+int fs_entry_negative_cache_free( struct fs_entry_negative_cache* cache ) {
+   
+   SG_safe_delete( cache->ents );
+   SG_safe_delete( cache->lru );
+   
+   pthread_mutex_destroy( &cache->lock );
+   
+   return 0;
+}
+
+
+// remember that a name does not exist in a directory (as of the given parent write nonce).
+// evicts the least-recently-used entry if the cache is full.
+// return 0 on success (including if the cache is disabled)
+// return -ENOMEM if out of memory
+int fs_entry_negative_cache_put( struct fs_entry_negative_cache* cache, uint64_t parent_id, int64_t parent_write_nonce, char const* name ) {
+   
+   if( cache->max_size == 0 || cache->ttl_ms <= 0 ) {
+      return 0;
+   }
+   
+   int64_t now_ms = md_current_time_millis();
+   
+   pthread_mutex_lock( &cache->lock );
+   
+   try {
+      
+      fs_entry_negative_key_t key( parent_id, string(name) );
+      
+      fs_entry_negative_map_t::iterator itr = cache->ents->find( key );
+      
+      if( itr != cache->ents->end() ) {
+         
+         // refresh, and move to the back of the line 
+         cache->lru->splice( cache->lru->end(), *cache->lru, itr->second.lru_itr );
+         
+         itr->second.parent_write_nonce = parent_write_nonce;
+         itr->second.expires_ms = now_ms + cache->ttl_ms;
+      }
+      else {
+         
+         // make room 
+         while( cache->ents->size() >= cache->max_size && cache->lru->size() > 0 ) {
+            
+            cache->ents->erase( cache->lru->front() );
+            cache->lru->pop_front();
+         }
+         
+         struct fs_entry_negative_ent ent;
+         
+         ent.parent_write_nonce = parent_write_nonce;
+         ent.expires_ms = now_ms + cache->ttl_ms;
+         ent.lru_itr = cache->lru->insert( cache->lru->end(), key );
+         
+         (*cache->ents)[ key ] = ent;
+      }
+   }
+   catch( bad_alloc& ba ) {
+      
+      pthread_mutex_unlock( &cache->lock );
+      return -ENOMEM;
+   }
+   
+   pthread_mutex_unlock( &cache->lock );
+   
+   return 0;
+}
+
+
+// do we know that a name does not exist in a directory, given the parent's current write nonce?
+// expired or voided entries get dropped.
+bool fs_entry_negative_cache_has( struct fs_entry_negative_cache* cache, uint64_t parent_id, int64_t parent_write_nonce, char const* name ) {
+   
+   if( cache->max_size == 0 || cache->ttl_ms <= 0 ) {
+      return false;
+   }
+   
+   bool ret = false;
+   int64_t now_ms = md_current_time_millis();
+   
+   pthread_mutex_lock( &cache->lock );
+   
+   fs_entry_negative_map_t::iterator itr = cache->ents->find( fs_entry_negative_key_t( parent_id, string(name) ) );
+   
+   if( itr != cache->ents->end() ) {
+      
+      if( itr->second.expires_ms <= now_ms || itr->second.parent_write_nonce != parent_write_nonce ) {
+         
+         // no longer valid
+         cache->lru->erase( itr->second.lru_itr );
+         cache->ents->erase( itr );
+      }
+      else {
+         
+         // hit; keep it around
+         cache->lru->splice( cache->lru->end(), *cache->lru, itr->second.lru_itr );
+         ret = true;
+      }
+   }
+   
+   pthread_mutex_unlock( &cache->lock );
+   
+   return ret;
+}
+
+
+// forget that a name does not exist in a directory (i.e. because we just created it)
+// always succeeds
+int fs_entry_negative_cache_evict( struct fs_entry_negative_cache* cache, uint64_t parent_id, char const* name ) {
+   
+   if( cache->max_size == 0 ) {
+      return 0;
+   }
+   
+   pthread_mutex_lock( &cache->lock );
+   
+   fs_entry_negative_map_t::iterator itr = cache->ents->find( fs_entry_negative_key_t( parent_id, string(name) ) );
+   
+   if( itr != cache->ents->end() ) {
+      
+      cache->lru->erase( itr->second.lru_itr );
+      cache->ents->erase( itr );
+   }
+   
+   pthread_mutex_unlock( &cache->lock );
+   
+   return 0;
+}
@@ -0,0 +1,52 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef _NEGATIVE_H_
+#define _NEGATIVE_H_
+
+#include "fs_entry.h"
+
+// negative entry: a name the MS told us does not exist in a directory
+typedef pair<uint64_t, string> fs_entry_negative_key_t;                 // (parent ID, name)
+typedef list<fs_entry_negative_key_t> fs_entry_negative_lru_t;
+
+struct fs_entry_negative_ent {
+   int64_t parent_write_nonce;                  // parent's write nonce when the MS told us; if it changes, the entry is void
+   int64_t expires_ms;                          // when to ask the MS again
+   fs_entry_negative_lru_t::iterator lru_itr;   // where this entry is in the eviction order
+};
+
+typedef map<fs_entry_negative_key_t, struct fs_entry_negative_ent> fs_entry_negative_map_t;
+
+// bounded cache of negative entries, evicted least-recently-used first
+struct fs_entry_negative_cache {
+   fs_entry_negative_map_t* ents;
+   fs_entry_negative_lru_t* lru;                // least-recently-used entry first
+   
+   size_t max_size;                             // maximum number of entries (0 means don't cache)
+   int ttl_ms;                                  // how long an entry lasts
+   
+   pthread_mutex_t lock;
+};
+
+int fs_entry_negative_cache_init( struct fs_entry_negative_cache* cache, size_t max_size, int ttl_ms );
+int fs_entry_negative_cache_free( struct fs_entry_negative_cache* cache );
+
+int fs_entry_negative_cache_put( struct fs_entry_negative_cache* cache, uint64_t parent_id, int64_t parent_write_nonce, char const* name );
+bool fs_entry_negative_cache_has( struct fs_entry_negative_cache* cache, uint64_t parent_id, int64_t parent_write_nonce, char const* name );
+int fs_entry_negative_cache_evict( struct fs_entry_negative_cache* cache, uint64_t parent_id, char const* name );
+
+#endif
@@ -21,6 +21,7 @@
 #include "unlink.h"
 #include "driver.h"
 #include "trunc.h"
+#include "rename.h"
 
 // create a file handle from an fs_entry
 struct fs_file_handle* fs_file_handle_create( struct fs_core* core, struct fs_entry* ent, char const* opened_path, uint64_t parent_id, char const* parent_name ) {
@@ -78,37 +79,63 @@ int fs_entry_mknod( struct fs_core* core, char const* path, mode_t mode, dev_t d
    }
    
    int err = 0;
-
-   // get the parent directory and lock it
+   
    char* path_dirname = md_dirname( path, NULL );
-   struct fs_entry* parent = fs_entry_resolve_path( core, path_dirname, user, vol, true, &err );
-   free( path_dirname );
+   char* path_basename = md_basename( path, NULL );
+   struct fs_entry* parent = NULL;
+   
+   while( true ) {
+      
+      // get the parent directory and lock it
+      parent = fs_entry_resolve_path( core, path_dirname, user, vol, true, &err );
+      
+      if( parent == NULL ) {
+         free( path_dirname );
+         free( path_basename );
+         return err;
+      }
 
-   if( !IS_DIR_READABLE( parent->mode, parent->owner, parent->volume, user, vol ) ) {
-      // not searchable
-      fs_entry_unlock( parent );
-      return -EACCES;
-   }
+      if( !IS_DIR_READABLE( parent->mode, parent->owner, parent->volume, user, vol ) ) {
+         // not searchable
+         fs_entry_unlock( parent );
+         free( path_dirname );
+         free( path_basename );
+         return -EACCES;
+      }
 
-   if( !IS_WRITEABLE( parent->mode, parent->owner, parent->volume, user, vol ) ) {
-      // not writeable
+      if( !IS_WRITEABLE( parent->mode, parent->owner, parent->volume, user, vol ) ) {
+         // not writeable
+         fs_entry_unlock( parent );
+         free( path_dirname );
+         free( path_basename );
+         return -EACCES;
+      }
+
+      // make sure it doesn't exist already (or isn't in the process of being deleted, since we might have to re-create it if deleting it fails)
+      if( fs_entry_set_find_name( parent->children, path_basename ) != NULL ) {
+         fs_entry_unlock( parent );
+         free( path_dirname );
+         free( path_basename );
+         return -EEXIST;
+      }
+      
+      if( !fs_entry_rename_name_claimed( core, parent->file_id, path_basename ) ) {
+         break;
+      }
+      
+      // something is being renamed to this name.  Wait for it to land, and look again.
+      uint64_t claimed_parent_id = parent->file_id;
+      
       fs_entry_unlock( parent );
-      return -EACCES;
+      
+      fs_entry_rename_wait_name( core, claimed_parent_id, path_basename );
    }
+   
+   free( path_dirname );
 
    uint64_t parent_id = parent->file_id;
    char* parent_name = strdup( parent->name );
 
-   char* path_basename = md_basename( path, NULL );
-
-   // make sure it doesn't exist already (or isn't in the process of being deleted, since we might have to re-create it if deleting it fails)
-   if( fs_entry_set_find_name( parent->children, path_basename ) != NULL ) {
-      free( path_basename );
-      fs_entry_unlock( parent );
-      free( parent_name );
-      return -EEXIST;
-   }
-
    struct fs_entry* child = (struct fs_entry*)calloc( sizeof(struct fs_entry), 1 );
 
    struct timespec ts;
@@ -144,7 +171,7 @@ int fs_entry_mknod( struct fs_core* core, char const* path, mode_t mode, dev_t d
          
          fs_entry_unlock( child );
          fs_entry_destroy( child, false );
-         free( child );
+         fs_entry_free( child );
       }
       
       else {
@@ -166,8 +193,9 @@ int fs_entry_mknod( struct fs_core* core, char const* path, mode_t mode, dev_t d
 
             child->open_count = 0;
             fs_entry_unlock( child );
+            
+            // this destroys and frees child, since no one else refers to it
             fs_entry_detach_lowlevel( core, parent, child );
-            free( child );
          }
          else {
             fs_entry_unlock( child );
@@ -188,49 +216,68 @@ int fs_entry_mknod( struct fs_core* core, char const* path, mode_t mode, dev_t d
 // write-lock the parent. 
 // do NOT touch the child
 // if the child is not found, *child will be set to NULL
+// if a rename onto the child's name is in flight, wait for it to land first, so we don't create over it
 // return 0 on success
 // return -ENOTDIR if a directory along the path wasn't a directory
 // return -EACCES on permission error
 int fs_entry_open_parent_and_child( struct fs_core* core, char const* path, uint64_t user, uint64_t vol, struct fs_entry** ret_parent, struct fs_entry** ret_child ) {
    
-   // resolve the parent of this child (and write-lock it)
    int rc = 0;
    char* path_dirname = md_dirname( path, NULL );
    char* path_basename = md_basename( path, NULL );
    
-   struct fs_entry* parent = fs_entry_resolve_path( core, path_dirname, user, vol, true, &rc );
+   struct fs_entry* parent = NULL;
+   struct fs_entry* child = NULL;
+   
+   while( true ) {
+      
+      // resolve the parent of this child (and write-lock it)
+      parent = fs_entry_resolve_path( core, path_dirname, user, vol, true, &rc );
 
-   if( parent == NULL ) {
+      if( parent == NULL ) {
 
-      free( path_basename );
-      free( path_dirname );
-      
-      return rc;
-   }
+         free( path_basename );
+         free( path_dirname );
+         
+         return rc;
+      }
 
-   free( path_dirname );
+      if( parent->ftype != FTYPE_DIR ) {
+         // parent is not a directory
+         fs_entry_unlock( parent );
+         free( path_basename );
+         free( path_dirname );
+         
+         return -ENOTDIR;
+      }
 
-   if( parent->ftype != FTYPE_DIR ) {
-      // parent is not a directory
-      fs_entry_unlock( parent );
-      free( path_basename );
+      // can parent be searched?
+      if( !IS_DIR_READABLE( parent->mode, parent->owner, parent->volume, user, vol ) ) {
+         // nope
+         fs_entry_unlock( parent );
+         free( path_basename );
+         free( path_dirname );
+         
+         return -EACCES;
+      }
+      
+      // resolve the child
+      child = fs_entry_set_find_name( parent->children, path_basename );
+      
+      if( child != NULL || !fs_entry_rename_name_claimed( core, parent->file_id, path_basename ) ) {
+         break;
+      }
+      
+      // something is being renamed to this name.  Wait for it to land, and look again.
+      uint64_t parent_id = parent->file_id;
       
-      return -ENOTDIR;
-   }
-
-   // can parent be searched?
-   if( !IS_DIR_READABLE( parent->mode, parent->owner, parent->volume, user, vol ) ) {
-      // nope
       fs_entry_unlock( parent );
-      free( path_basename );
       
-      return -EACCES;
+      fs_entry_rename_wait_name( core, parent_id, path_basename );
    }
    
-   // resolve the child
-   struct fs_entry* child = fs_entry_set_find_name( parent->children, path_basename );
-   
    free( path_basename );
+   free( path_dirname );
    
    *ret_parent = parent;
    *ret_child = child;
@@ -327,7 +374,7 @@ int fs_entry_do_create( struct fs_core* core, char const* path, struct fs_entry*
          SG_error("fs_entry_init_file(%s) rc = %d\n", path, rc );
 
          fs_entry_destroy( child, false );
-         free( child );
+         fs_entry_free( child );
          
          return rc;
       }
@@ -344,7 +391,7 @@ int fs_entry_do_create( struct fs_core* core, char const* path, struct fs_entry*
             SG_error("driver_create_file(%s) rc = %d\n", path, driver_rc );
             
             fs_entry_destroy( child, false );
-            free( child );
+            fs_entry_free( child );
             
             return driver_rc;
          }
@@ -694,3 +741,28 @@ struct fs_file_handle* fs_entry_open( struct fs_core* core, char const* _path, u
    return ret;
 }
 
+
+
+// can the front-end keep the pages it cached for this handle's file, now that the file has been (re)opened?
+// if not, the front-end is expected to drop them, so we clear the file's kernel_cache_stale flag.
+// AG-hosted files don't know their sizes up front, so their pages are never kept.
+bool fs_file_handle_keep_cache( struct fs_file_handle* fh ) {
+   
+   bool keep_cache = false;
+   
+   fs_file_handle_rlock( fh );
+   
+   if( fh->fent != NULL && !fh->is_AG ) {
+      
+      fs_entry_wlock( fh->fent );
+      
+      keep_cache = !fh->fent->kernel_cache_stale;
+      fh->fent->kernel_cache_stale = false;
+      
+      fs_entry_unlock( fh->fent );
+   }
+   
+   fs_file_handle_unlock( fh );
+   
+   return keep_cache;
+}
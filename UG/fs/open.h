@@ -30,5 +30,6 @@ int fs_entry_mknod( struct fs_core* core, char const* path, mode_t mode, dev_t d
 // filehandles
 struct fs_file_handle* fs_file_handle_create( struct fs_core* core, struct fs_entry* ent, char const* opened_path, uint64_t parent_id, char const* parent_name );
 int fs_file_handle_open( struct fs_file_handle* fh, int flags, mode_t mode );
+bool fs_file_handle_keep_cache( struct fs_file_handle* fh );
 
 #endif
\ No newline at end of file
@@ -124,6 +124,73 @@ ssize_t fs_entry_read_block_local( struct fs_core* core, char const* fs_path, ui
 }
 
 
+// open a block in the on-disk cache, so it can be sent to another gateway without reading it into RAM.
+// The bytes on disk are only what fs_entry_read_block_local would serve if the driver does not process blocks after
+// downloading them, so a driver with read_block_postdown always gets -ENOENT here.
+// return the file descriptor on success (which the caller must close), and set *block_len to the block's size
+// return -ENOENT if the block is not in the on-disk cache (i.e. it's past EOF, a write hole, bufferred, still being written, or remote),
+// or if the driver transforms blocks on read
+// return negative on error
+int fs_entry_open_block_local( struct fs_core* core, char const* fs_path, uint64_t block_id, off_t* block_len ) {
+   int err = 0;
+   int rc = 0;
+   struct stat sb;
+   
+   if( driver_has_read_block_postdown( core->closure ) ) {
+      return -ENOENT;
+   }
+   
+   struct fs_entry* fent = fs_entry_resolve_path( core, fs_path, SG_SYS_USER, 0, false, &err );
+   if( !fent || err ) {
+      return err;
+   }
+   
+   if( block_id * core->blocking_factor >= (uint64_t)fent->size || fent->manifest->is_hole( block_id ) || fs_entry_has_bufferred_block( fent, block_id ) > 0 ) {
+      fs_entry_unlock( fent );
+      return -ENOENT;
+   }
+   
+   int64_t block_version = fent->manifest->get_block_version( block_id );
+   
+   // lookaside: if this block is being written, then we can't send it 
+   rc = md_cache_is_block_readable( core->cache, fent->file_id, fent->version, block_id, block_version );
+   if( rc != 0 ) {
+      fs_entry_unlock( fent );
+      return -ENOENT;
+   }
+   
+   int block_fd = md_cache_open_block( core->cache, fent->file_id, fent->version, block_id, block_version, O_RDONLY );
+   if( block_fd < 0 ) {
+      if( block_fd != -ENOENT ) {
+         SG_error("md_cache_open_block( %" PRIX64 ".%" PRId64 "[%" PRIu64 ".%" PRId64 "] (%s) ) rc = %d\n", fent->file_id, fent->version, block_id, block_version, fs_path, block_fd );
+      }
+      
+      fs_entry_unlock( fent );
+      return block_fd;
+   }
+   
+   rc = fstat( block_fd, &sb );
+   if( rc != 0 ) {
+      rc = -errno;
+      SG_error("fstat( %" PRIX64 ".%" PRId64 "[%" PRIu64 ".%" PRId64 "] (%s) ) rc = %d\n", fent->file_id, fent->version, block_id, block_version, fs_path, rc );
+      
+      close( block_fd );
+      fs_entry_unlock( fent );
+      return rc;
+   }
+   
+   *block_len = sb.st_size;
+   
+   // hit! promote!
+   md_cache_promote_block( core->cache, fent->file_id, fent->version, block_id, block_version );
+   
+   SG_debug("Cache HIT on %" PRIX64 ".%" PRId64 "[%" PRIu64 ".%" PRId64 "]\n", fent->file_id, fent->version, block_id, block_version );
+   
+   fs_entry_unlock( fent );
+   return block_fd;
+}
+
+
 // parse and verify an AG block 
 // fent must be at least read-locked
 static int fs_entry_parse_verify_AG_block( struct fs_core* core, struct fs_entry* fent, uint64_t block_id, int64_t block_version, char* serialized_msg, size_t serialized_msg_len, char** block_bits, size_t* block_len ) {
@@ -1098,8 +1165,8 @@ static int fs_entry_read_context_untrack_and_cancel_downloads( struct fs_core* c
 // run one or more read downloads in a read context.
 // stop downloading if we encounter an EOF condition
 // fent will be read-locked and read-unlocked across multiple download completions, unless we indicate otherwise in the write_locked flag
-int fs_entry_read_context_run_downloads_ex( struct fs_core* core, struct fs_entry* fent, struct fs_entry_read_context* read_ctx, bool write_locked,
-                                            fs_entry_read_block_future_download_finalizer_func finalizer, void* finalizer_cls ) {
+static int fs_entry_read_context_run_downloads_impl( struct fs_core* core, struct fs_entry* fent, struct fs_entry_read_context* read_ctx, bool write_locked,
+                                                    fs_entry_read_block_future_download_finalizer_func finalizer, void* finalizer_cls ) {
    
    int rc = 0;
    
@@ -1230,6 +1297,22 @@ int fs_entry_read_context_run_downloads_ex( struct fs_core* core, struct fs_entr
    return rc;
 }
 
+// run one or more read downloads in a read context, and time them
+int fs_entry_read_context_run_downloads_ex( struct fs_core* core, struct fs_entry* fent, struct fs_entry_read_context* read_ctx, bool write_locked,
+                                            fs_entry_read_block_future_download_finalizer_func finalizer, void* finalizer_cls ) {
+   
+   struct md_trace_span span;
+   md_trace_begin( &span, "block_download", fent->file_id );
+   core->state->stats->enter( STAT_BLOCK_DOWNLOAD );
+   
+   int rc = fs_entry_read_context_run_downloads_impl( core, fent, read_ctx, write_locked, finalizer, finalizer_cls );
+   
+   core->state->stats->leave( STAT_BLOCK_DOWNLOAD, rc );
+   md_trace_end( &span );
+   
+   return rc;
+}
+
 // default download runner--doesn't do any finalization of its own
 int fs_entry_read_context_run_downloads( struct fs_core* core, struct fs_entry* fent, struct fs_entry_read_context* read_ctx ) {
    return fs_entry_read_context_run_downloads_ex( core, fent, read_ctx, false, NULL, NULL );
@@ -1320,7 +1403,13 @@ static int fs_entry_try_read_block_local( struct fs_core* core, char const* fs_p
    char* buf = NULL;
    off_t buflen = 0;
    
+   struct md_trace_span span;
+   md_trace_begin( &span, "cache_read", block_id );
+   
    rc = fs_entry_try_cache_block_read( core, fs_path, fent, block_id, block_version, &buf, &buflen );
+   
+   md_trace_end( &span );
+   
    if( rc == 0 ) {
       
       // hit cache!  Process the block 
@@ -1759,6 +1848,41 @@ static int fs_entry_read_flush_cache( vector<struct md_cache_block_future*>* cac
    return cache_rc;
 }
 
+// read-lock fent for a read of [offset, offset + count), first filling in any sparse bufferred blocks the read will touch,
+// since their unwritten bytes are only available from their older versions.
+// return 0 on success, with fent read-locked
+// return negative on error, with fent unlocked
+// fent must not be locked in any way.
+static int fs_entry_read_lock_filled( struct fs_core* core, char const* fs_path, struct fs_entry* fent, size_t count, off_t offset ) {
+   
+   uint64_t start_block_id = offset / core->blocking_factor;
+   uint64_t end_block_id = (offset + count) / core->blocking_factor;
+   
+   while( true ) {
+      
+      fs_entry_rlock( fent );
+      
+      if( fs_entry_has_sparse_bufferred_blocks( fent, start_block_id, end_block_id ) <= 0 ) {
+         // nothing to fill
+         return 0;
+      }
+      
+      fs_entry_unlock( fent );
+      
+      // fill them, and try again (in case someone wrote another sparse block in the meantime)
+      fs_entry_wlock( fent );
+      
+      int rc = fs_entry_fill_sparse_bufferred_blocks( core, fs_path, fent, start_block_id, end_block_id );
+      
+      fs_entry_unlock( fent );
+      
+      if( rc != 0 ) {
+         SG_error("fs_entry_fill_sparse_bufferred_blocks( %s [%" PRIu64 ", %" PRIu64 "] ) rc = %d\n", fs_path, start_block_id, end_block_id, rc );
+         return rc;
+      }
+   }
+}
+
 // service a read request.
 // split the read into a series of block requests, and fetch each block.
 // Try the bufferred block cache, then the disk block cache, then the CDN
@@ -1776,7 +1900,10 @@ static ssize_t fs_entry_read_run( struct fs_core* core, char const* fs_path, str
    int64_t write_nonce = 0;
    off_t file_size = 0;
    
-   fs_entry_rlock( fent );
+   rc = fs_entry_read_lock_filled( core, fs_path, fent, count, offset );
+   if( rc != 0 ) {
+      return rc;
+   }
    
    // preserve information on fent 
    file_id = fent->file_id;
@@ -1904,7 +2031,7 @@ static ssize_t fs_entry_read_run( struct fs_core* core, char const* fs_path, str
 
 
 // top-level read request 
-ssize_t fs_entry_read( struct fs_core* core, struct fs_file_handle* fh, char* buf, size_t count, off_t offset ) {
+static ssize_t fs_entry_read_impl( struct fs_core* core, struct fs_file_handle* fh, char* buf, size_t count, off_t offset ) {
    
    fs_file_handle_rlock( fh );
    
@@ -1948,3 +2075,16 @@ ssize_t fs_entry_read( struct fs_core* core, struct fs_file_handle* fh, char* bu
    
    return num_read;
 }
+
+// read from a file, tracing the request
+ssize_t fs_entry_read( struct fs_core* core, struct fs_file_handle* fh, char* buf, size_t count, off_t offset ) {
+   
+   struct md_trace_span span;
+   md_trace_request_begin( &span, "read", fh->file_id );
+   
+   ssize_t rc = fs_entry_read_impl( core, fh, buf, count, offset );
+   
+   md_trace_end( &span );
+   
+   return rc;
+}
@@ -111,6 +111,7 @@ int fs_entry_update_bufferred_block( struct fs_file_handle* fh, struct fs_entry*
 
 int fs_entry_read_block( struct fs_core* core, char const* fs_path, struct fs_entry* fent, uint64_t block_id, char* block_buf, size_t block_len );
 ssize_t fs_entry_read_block_local( struct fs_core* core, char const* fs_path, uint64_t block_id, char* block_buf, size_t block_len );
+int fs_entry_open_block_local( struct fs_core* core, char const* fs_path, uint64_t block_id, off_t* block_len );
 
 ssize_t fs_entry_read( struct fs_core* core, struct fs_file_handle* fh, char* buf, size_t count, off_t offset );
 
@@ -132,3 +132,103 @@ struct fs_dir_entry** fs_entry_readdir( struct fs_core* core, struct fs_dir_hand
 
    return dents;
 }
+
+
+// list a directory, one entry at a time, starting from a given offset.
+// An entry's offset is its slot in the directory's children set, which does not change while the entry exists
+// (removed children leave holes), so a listing can be resumed where it left off without re-listing what came before.
+// The directory is revalidated only when a listing starts (offset 0); later pages read the cached children.
+// filler is called with the directory read-locked, and with each child read-locked (see fs_dir_filler_func).
+// return 0 on success, including when filler stops the listing early
+// return -EBADF if the handle is not open
+// return negative on revalidation error
+int fs_entry_readdir_iter( struct fs_core* core, struct fs_dir_handle* dirh, off_t offset, fs_dir_filler_func filler, void* cls ) {
+
+   int rc = 0;
+
+   fs_dir_handle_rlock( dirh );
+   if( dirh->dent == NULL || dirh->open_count <= 0 ) {
+      // invalid
+      fs_dir_handle_unlock( dirh );
+      return -EBADF;
+   }
+
+   if( offset == 0 ) {
+
+      // starting a new listing; revalidate path metadata...
+      rc = fs_entry_revalidate_path( core, dirh->path );
+      if( rc != 0 ) {
+         SG_error("fs_entry_revalidate_path(%s) rc = %d\n", dirh->path, rc );
+
+         fs_dir_handle_unlock( dirh );
+         return rc;
+      }
+
+      // ...and ensure that our listing metadata is up-to-date
+      rc = fs_entry_revalidate_children( core, dirh->path );
+      if( rc != 0 ) {
+         SG_error("fs_entry_revalidate_children(%s) rc = %d\n", dirh->path, rc );
+
+         fs_dir_handle_unlock( dirh );
+         return rc;
+      }
+   }
+
+   struct fs_entry* dent = dirh->dent;
+
+   fs_entry_rlock( dent );
+
+   if( dent->children == NULL ) {
+      // directory got removed
+      fs_entry_unlock( dent );
+      fs_dir_handle_unlock( dirh );
+      return 0;
+   }
+
+   long dot_hash = fs_entry_name_hash( "." );
+   long dotdot_hash = fs_entry_name_hash( ".." );
+
+   for( off_t i = offset; i < (off_t)dent->children->size(); i++ ) {
+
+      struct fs_entry* fent = dent->children->at(i).second;
+      long fent_name_hash = dent->children->at(i).first;
+
+      if( fent == NULL ) {
+         continue;
+      }
+
+      int fill_rc = 0;
+
+      // handle . and .. separately--we only want to lock children (not the current or parent directory)
+      if( fent_name_hash == dot_hash ) {
+         fill_rc = (*filler)( core, ".", FTYPE_DIR, dent, i + 1, cls );
+      }
+      else if( fent_name_hash == dotdot_hash ) {
+         fill_rc = (*filler)( core, "..", FTYPE_DIR, NULL, i + 1, cls );
+      }
+      else {
+         if( fent != dent && fs_entry_rlock( fent ) != 0 ) {
+            continue;
+         }
+
+         if( fent->name != NULL && !fent->deletion_in_progress ) {    // only show entries that exist
+            fill_rc = (*filler)( core, fent->name, fent->ftype, fent, i + 1, cls );
+         }
+
+         if( fent != dent ) {
+            fs_entry_unlock( fent );
+         }
+      }
+
+      if( fill_rc != 0 ) {
+         // caller has all it can take
+         break;
+      }
+   }
+
+   fs_entry_unlock( dent );
+
+   fs_dir_handle_unlock( dirh );
+
+   return 0;
+}
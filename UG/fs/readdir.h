@@ -19,7 +19,14 @@
 
 #include "fs_entry.h"
 
+// called by fs_entry_readdir_iter for each entry in a listing.
+// fent is the entry, read-locked (the directory itself for "."), or NULL for "..".
+// next_offset is where to resume the listing after this entry.
+// return 0 to keep going, or nonzero to stop the listing here (e.g. the caller's buffer is full)
+typedef int (*fs_dir_filler_func)( struct fs_core* core, char const* name, int ftype, struct fs_entry* fent, off_t next_offset, void* cls );
+
 struct fs_dir_entry** fs_entry_readdir( struct fs_core* core, struct fs_dir_handle* dirh, int* err );
 struct fs_dir_entry** fs_entry_readdir_lowlevel( struct fs_core* core, char const* fs_path, struct fs_entry* dent );
+int fs_entry_readdir_iter( struct fs_core* core, struct fs_dir_handle* dirh, off_t offset, fs_dir_filler_func filler, void* cls );
 
 #endif
\ No newline at end of file
@@ -20,6 +20,8 @@
 #include "replication.h"
 #include "unlink.h"
 #include "vacuumer.h"
+#include "negative.h"
+#include "dcache.h"
 
 // generate an md_entry for the destination that does not (yet) exist
 int fs_entry_make_dest_entry( struct fs_core* core, char const* new_path, uint64_t parent_id, struct md_entry* src, struct md_entry* dest ) {
@@ -89,33 +91,56 @@ int fs_entry_verify_no_loop( struct fs_entry* fent, void* cls ) {
 }
 
 
-// rename a file
-int fs_entry_versioned_rename( struct fs_core* core, char const* old_path, char const* new_path, uint64_t user, uint64_t volume, int64_t version ) {
+// mark the deepest directory above path that we can still resolve read-stale (the root, if none), so the next lookup beneath it
+// reloads from the MS.  Use this when we know path changed on the MS, but can't find its parent to fix it up ourselves.
+static void fs_entry_rename_mark_ancestor_stale( struct fs_core* core, char const* path, uint64_t user, uint64_t volume ) {
    
-   // renaming is forbidden if anonymous
-   if( core->gateway == SG_GATEWAY_ANON ) {
-      SG_error("%s", "Renaming is forbidden for anonymous gateways\n");
-      return -EPERM;
+   char* dir_path = md_dirname( path, NULL );
+   
+   while( dir_path != NULL ) {
+      
+      int err = 0;
+      struct fs_entry* dir = fs_entry_resolve_path( core, dir_path, user, volume, true, &err );
+      
+      if( dir != NULL ) {
+         
+         SG_debug("mark %s read-stale\n", dir_path );
+         
+         fs_entry_mark_read_stale( dir );
+         fs_entry_unlock( dir );
+         
+         free( dir_path );
+         return;
+      }
+      
+      if( strcmp( dir_path, "/" ) == 0 ) {
+         break;
+      }
+      
+      char* parent_path = md_dirname( dir_path, NULL );
+      
+      free( dir_path );
+      dir_path = parent_path;
    }
    
-   int err_old = 0, err_new = 0, err = 0;
-
-   int rc = 0;
+   SG_safe_free( dir_path );
    
-   // consistency check
-   err = fs_entry_revalidate_path( core, old_path );
-   if( err != 0 ) {
-      SG_error("fs_entry_revalidate_path(%s) rc = %d\n", old_path, err );
-      return err;
-   }
+   // out of memory, or we couldn't even resolve the root
+   fs_entry_wlock( core->root );
+   fs_entry_mark_read_stale( core->root );
+   fs_entry_unlock( core->root );
+}
 
-   // consistency check
-   err = fs_entry_revalidate_path( core, new_path );
-   if( err != 0 && err != -ENOENT ) {
-      SG_error("fs_entry_revalidate_path(%s) rc = %d\n", new_path, err );
-      return err;
-   }
 
+// resolve and write-lock the parents of old_path and new_path, and check that user can write to them.
+// if both paths have the same parent, only *fent_common_parent is set.  Otherwise, *fent_old_parent and *fent_new_parent are set.
+// return 0 on success
+// return negative on error, in which case nothing is locked
+static int fs_entry_rename_lock_parents( struct fs_core* core, char const* old_path, char const* new_path, uint64_t user, uint64_t volume,
+                                         struct fs_entry** ret_common_parent, struct fs_entry** ret_old_parent, struct fs_entry** ret_new_parent ) {
+   
+   int err_old = 0, err_new = 0;
+   
    // identify the parents of old_path and new_path
    char* old_path_dirname = md_dirname( old_path, NULL );
    char* new_path_dirname = md_dirname( new_path, NULL );
@@ -177,42 +202,450 @@ int fs_entry_versioned_rename( struct fs_core* core, char const* old_path, char
       fs_entry_rename_cleanup( fent_common_parent, fent_old_parent, fent_new_parent );
       return -EACCES;
    }
+   
+   *ret_common_parent = fent_common_parent;
+   *ret_old_parent = fent_old_parent;
+   *ret_new_parent = fent_new_parent;
+   
+   return 0;
+}
 
-   // now, look up the children
-   char* new_path_basename = md_basename( new_path, NULL );
-   char* old_path_basename = md_basename( old_path, NULL );
-
-   struct fs_entry* fent_old = NULL;
-   struct fs_entry* fent_new = NULL;
 
+// move fent_old to new_name, replacing fent_new (if given) and detaching it.
+// fent_old's name is replaced with new_name, which the caller must not free afterwards.
+// the parents and children must be write-locked; fent_new will be unlocked.
+static int fs_entry_rename_swap( struct fs_core* core, struct fs_entry* fent_common_parent, struct fs_entry* fent_old_parent, struct fs_entry* fent_new_parent,
+                                 struct fs_entry* fent_old, struct fs_entry* fent_new, char* new_name ) {
+   
+   int err = 0;
+   struct fs_entry* dest_parent = NULL;
+   
+   // lock-free path walks that see the tree mid-move will retry with locks
+   fs_dcache_rename_begin();
+   
    if( fent_common_parent ) {
-      fent_new = fs_entry_set_find_name( fent_common_parent->children, new_path_basename );
-      fent_old = fs_entry_set_find_name( fent_common_parent->children, old_path_basename );
+      dest_parent = fent_common_parent;
+      
+      fs_entry_set_remove( fent_common_parent->children, fent_old->name );
+
+      // rename this fs_entry
+      free( fent_old->name );
+      fent_old->name = new_name;
+
+      if( fent_new )
+         fs_entry_set_remove( fent_common_parent->children, fent_new->name );
+
+      fs_entry_set_insert( fent_common_parent->children, fent_old->name, fent_old );
    }
    else {
-      fent_new = fs_entry_set_find_name( fent_new_parent->children, new_path_basename );
-      fent_old = fs_entry_set_find_name( fent_old_parent->children, old_path_basename );
+      dest_parent = fent_new_parent;
+      
+      fs_entry_set_remove( fent_old_parent->children, fent_old->name );
+
+      // rename this fs_entry
+      free( fent_old->name );
+      fent_old->name = new_name;
+
+      if( fent_new )
+         fs_entry_set_remove( fent_new_parent->children, fent_new->name );
+
+      fs_entry_set_insert( fent_new_parent->children, fent_old->name, fent_old );
+   }
+   
+   fs_dcache_rename_end();
+   
+   // the new name exists now
+   fs_entry_negative_cache_evict( core->negative_cache, dest_parent->file_id, fent_old->name );
+   
+   if( fent_new ) {
+      
+      // clean up fent_new and erase it
+      fs_entry_unlock( fent_new );
+      err = fs_entry_detach_lowlevel( core, dest_parent, fent_new );
+      
+      if( err != 0 ) {
+         // technically, it's still safe to access fent_new since dest_parent is write-locked
+         SG_error("fs_entry_detach_lowlevel(%s from %s) rc = %d\n", fent_new->name, dest_parent->name, err );
+      }
    }
+   
+   return err;
+}
 
-   free( old_path_basename );
 
-   // old must exist...
-   err = 0;
-   if( fent_old == NULL )
-      err = -ENOENT;
+// send a batch of renames to the MS, and set each one's result
+static int fs_entry_rename_batch_send( struct fs_core* core, fs_entry_rename_batch_t* batch ) {
+   
+   int rc = 0;
+   size_t num_requests = batch->size();
+   
+   if( num_requests == 1 ) {
+      
+      // nothing to batch with
+      struct fs_entry_rename_req* req = batch->at(0);
+      
+      req->rc = ms_client_rename( core->ms, &req->write_nonce, req->src, req->dest );
+      return req->rc;
+   }
+   
+   struct ms_client_request* requests = SG_CALLOC( struct ms_client_request, num_requests );
+   struct ms_client_request_result* results = SG_CALLOC( struct ms_client_request_result, num_requests );
+   
+   if( requests == NULL || results == NULL ) {
+      
+      if( requests != NULL ) {
+         free( requests );
+      }
+      if( results != NULL ) {
+         free( results );
+      }
+      
+      for( size_t i = 0; i < num_requests; i++ ) {
+         batch->at(i)->rc = -ENOMEM;
+      }
+      
+      return -ENOMEM;
+   }
+   
+   map<uint64_t, struct fs_entry_rename_req*> reqs_by_id;
+   
+   for( size_t i = 0; i < num_requests; i++ ) {
+      
+      struct fs_entry_rename_req* req = batch->at(i);
+      
+      ms_client_rename_request( core->ms, req->src, req->dest, &requests[i] );
+      
+      // no news is bad news
+      req->rc = -ENODATA;
+      reqs_by_id[ req->src->file_id ] = req;
+   }
+   
+   SG_debug("send a batch of %zu renames\n", num_requests );
+   
+   rc = ms_client_run_requests( core->ms, requests, results, num_requests );
+   if( rc != 0 ) {
+      
+      SG_error("ms_client_run_requests(%zu renames) rc = %d\n", num_requests, rc );
+      
+      for( size_t i = 0; i < num_requests; i++ ) {
+         batch->at(i)->rc = rc;
+      }
+   }
+   else {
+      
+      // results come back in file ID order, so match them to the requests by file ID
+      for( size_t i = 0; i < num_requests; i++ ) {
+         
+         map<uint64_t, struct fs_entry_rename_req*>::iterator itr = reqs_by_id.find( results[i].file_id );
+         if( itr == reqs_by_id.end() ) {
+            continue;
+         }
+         
+         struct fs_entry_rename_req* req = itr->second;
+         
+         if( results[i].reply_error != 0 ) {
+            SG_error("ERR: MS reply error %d\n", results[i].reply_error );
+            req->rc = results[i].reply_error;
+         }
+         else if( results[i].rc != 0 ) {
+            SG_error("ERR: MS file_rename( %" PRIX64 " ) rc = %d\n", results[i].file_id, results[i].rc );
+            req->rc = results[i].rc;
+         }
+         else if( results[i].ent != NULL ) {
+            req->write_nonce = results[i].ent->write_nonce;
+            req->rc = 0;
+         }
+      }
+   }
+   
+   ms_client_request_result_free_all( results, num_requests );
+   free( requests );
+   
+   return rc;
+}
+
+
+// Rename src to dest on the MS, together with any other renames that arrive while we wait for the batch window to pass.
+// The first renamer to arrive sends the batch on behalf of the rest, and wakes them up with their results.  Batches do not
+// wait on one another, so the next one fills up while this one is in flight.
+// The caller must not hold any fs_entry locks, and must have put the IDs of the files involved into core->renames_in_flight,
+// so no batch renames the same file twice.
+// return 0 on success, and set *write_nonce to src's new write nonce
+// return negative on error
+int fs_entry_rename_ms_batched( struct fs_core* core, struct md_entry* src, struct md_entry* dest, int64_t* write_nonce ) {
+   
+   struct fs_entry_rename_req req;
+   memset( &req, 0, sizeof(struct fs_entry_rename_req) );
+   
+   req.src = src;
+   req.dest = dest;
+   sem_init( &req.sem, 0, 0 );
+   
+   pthread_mutex_lock( &core->rename_lock );
+   
+   if( core->rename_batch != NULL ) {
+      
+      // join the open batch
+      core->rename_batch->push_back( &req );
+      
+      pthread_mutex_unlock( &core->rename_lock );
+      
+      // wait for the leader to send it
+      sem_wait( &req.sem );
+      sem_destroy( &req.sem );
+      
+      if( req.rc == 0 ) {
+         *write_nonce = req.write_nonce;
+      }
+      
+      return req.rc;
+   }
+   
+   // start a new batch
+   fs_entry_rename_batch_t* batch = new fs_entry_rename_batch_t();
+   batch->push_back( &req );
+   
+   core->rename_batch = batch;
+   
+   // only wait for other renames if there are any (we account for one or two of the files in flight)
+   size_t num_ours = (dest->file_id != 0 ? 2 : 1);
+   bool others = (core->renames_in_flight->size() > num_ours);
+   
+   pthread_mutex_unlock( &core->rename_lock );
+   
+   // give concurrent renames a chance to join
+   if( others && core->conf->rename_batch_window_ms > 0 ) {
+      
+      struct timespec window_ts;
+      window_ts.tv_sec = core->conf->rename_batch_window_ms / 1000;
+      window_ts.tv_nsec = (core->conf->rename_batch_window_ms % 1000) * 1000000;
+      
+      nanosleep( &window_ts, NULL );
+   }
+   
+   // close the batch; later renames start the next one
+   pthread_mutex_lock( &core->rename_lock );
+   
+   core->rename_batch = NULL;
+   
+   pthread_mutex_unlock( &core->rename_lock );
+   
+   fs_entry_rename_batch_send( core, batch );
+   
+   // wake up everyone else (but not ourselves)
+   for( size_t i = 1; i < batch->size(); i++ ) {
+      sem_post( &(batch->at(i)->sem) );
+   }
+   
+   delete batch;
+   sem_destroy( &req.sem );
    
-   // old must be the right version
-   if( fent_old != NULL && version > 0 && fent_old->version != version )
-      err = -ENOENT;
+   if( req.rc == 0 ) {
+      *write_nonce = req.write_nonce;
+   }
+   
+   return req.rc;
+}
 
-   // also, if we rename a file into itself, then it's okay
-   if( err != 0 || fent_old == fent_new ) {
-      fs_entry_rename_cleanup( fent_common_parent, fent_old_parent, fent_new_parent );
-      free( new_path_basename );
 
+// claim the files and the destination name involved in a rename, so no other rename touches them (and nothing gets created
+// under the destination name) until our MS update is done.
+// return true if we got them, or false if another rename has one of them (in which case the caller should unlock everything and call fs_entry_rename_wait_files)
+static bool fs_entry_rename_claim_files( struct fs_core* core, uint64_t old_file_id, uint64_t new_file_id, uint64_t new_parent_id, char const* new_name ) {
+   
+   bool claimed = false;
+   pair<uint64_t, string> dest_name( new_parent_id, string(new_name) );
+   
+   pthread_mutex_lock( &core->rename_lock );
+   
+   if( core->renames_in_flight->count( old_file_id ) == 0 && (new_file_id == 0 || core->renames_in_flight->count( new_file_id ) == 0) && core->rename_names_in_flight->count( dest_name ) == 0 ) {
+      
+      core->renames_in_flight->insert( old_file_id );
+      
+      if( new_file_id != 0 ) {
+         core->renames_in_flight->insert( new_file_id );
+      }
+      
+      core->rename_names_in_flight->insert( dest_name );
+      
+      claimed = true;
+   }
+   
+   pthread_mutex_unlock( &core->rename_lock );
+   
+   return claimed;
+}
+
+// wait for other renames to release the given files and destination name
+static void fs_entry_rename_wait_files( struct fs_core* core, uint64_t old_file_id, uint64_t new_file_id, uint64_t new_parent_id, char const* new_name ) {
+   
+   pair<uint64_t, string> dest_name( new_parent_id, string(new_name) );
+   
+   pthread_mutex_lock( &core->rename_lock );
+   
+   while( core->renames_in_flight->count( old_file_id ) != 0 || (new_file_id != 0 && core->renames_in_flight->count( new_file_id ) != 0) || core->rename_names_in_flight->count( dest_name ) != 0 ) {
+      pthread_cond_wait( &core->rename_cv, &core->rename_lock );
+   }
+   
+   pthread_mutex_unlock( &core->rename_lock );
+}
+
+// release the files and destination name claimed by fs_entry_rename_claim_files
+static void fs_entry_rename_release_files( struct fs_core* core, uint64_t old_file_id, uint64_t new_file_id, uint64_t new_parent_id, char const* new_name ) {
+   
+   pair<uint64_t, string> dest_name( new_parent_id, string(new_name) );
+   
+   pthread_mutex_lock( &core->rename_lock );
+   
+   core->renames_in_flight->erase( old_file_id );
+   
+   if( new_file_id != 0 ) {
+      core->renames_in_flight->erase( new_file_id );
+   }
+   
+   core->rename_names_in_flight->erase( dest_name );
+   
+   pthread_cond_broadcast( &core->rename_cv );
+   
+   pthread_mutex_unlock( &core->rename_lock );
+}
+
+// is a rename onto the given name in the given directory waiting on the MS?  If so, nothing else may be created under that name until it lands.
+// the caller should have the directory locked, so a rename can't claim the name between this check and the caller's create.
+bool fs_entry_rename_name_claimed( struct fs_core* core, uint64_t parent_id, char const* name ) {
+   
+   pair<uint64_t, string> dest_name( parent_id, string(name) );
+   
+   pthread_mutex_lock( &core->rename_lock );
+   
+   bool claimed = (core->rename_names_in_flight->count( dest_name ) != 0);
+   
+   pthread_mutex_unlock( &core->rename_lock );
+   
+   return claimed;
+}
+
+// wait for renames onto the given name in the given directory to finish.
+// the caller must not hold any fs_entry locks, since the rename needs the directory to finish.
+void fs_entry_rename_wait_name( struct fs_core* core, uint64_t parent_id, char const* name ) {
+   
+   pair<uint64_t, string> dest_name( parent_id, string(name) );
+   
+   pthread_mutex_lock( &core->rename_lock );
+   
+   while( core->rename_names_in_flight->count( dest_name ) != 0 ) {
+      pthread_cond_wait( &core->rename_cv, &core->rename_lock );
+   }
+   
+   pthread_mutex_unlock( &core->rename_lock );
+}
+
+
+// Rename a file.
+// This happens in two phases, so the parent directories are not locked across the MS round-trip.  First, with the parents
+// and children locked, we check that the rename can happen and claim the files involved.  Then, with nothing locked, we
+// rename them on the MS (batched with concurrent renames).  Finally, we lock the parents again and move the entry.
+// Directories are renamed the same way:  the MS moves the whole subtree in one update, and so do we.
+int fs_entry_versioned_rename( struct fs_core* core, char const* old_path, char const* new_path, uint64_t user, uint64_t volume, int64_t version ) {
+   
+   // renaming is forbidden if anonymous
+   if( core->gateway == SG_GATEWAY_ANON ) {
+      SG_error("%s", "Renaming is forbidden for anonymous gateways\n");
+      return -EPERM;
+   }
+   
+   int err = 0;
+
+   int rc = 0;
+   
+   // consistency check
+   err = fs_entry_revalidate_path( core, old_path );
+   if( err != 0 ) {
+      SG_error("fs_entry_revalidate_path(%s) rc = %d\n", old_path, err );
+      return err;
+   }
+
+   // consistency check
+   err = fs_entry_revalidate_path( core, new_path );
+   if( err != 0 && err != -ENOENT ) {
+      SG_error("fs_entry_revalidate_path(%s) rc = %d\n", new_path, err );
       return err;
    }
 
+   struct fs_entry* fent_old_parent = NULL;
+   struct fs_entry* fent_new_parent = NULL;
+   struct fs_entry* fent_common_parent = NULL;
+   
+   struct fs_entry* fent_old = NULL;
+   struct fs_entry* fent_new = NULL;
+   
+   uint64_t old_file_id = 0;
+   uint64_t new_file_id = 0;
+   uint64_t dest_parent_id = 0;
+   
+   char* new_path_basename = md_basename( new_path, NULL );
+   char* old_path_basename = md_basename( old_path, NULL );
+   
+   // fs_entry_rename_swap consumes new_path_basename, but we need the name to release our claim on it
+   char* dest_name = strdup( new_path_basename );
+   
+   while( true ) {
+      
+      err = fs_entry_rename_lock_parents( core, old_path, new_path, user, volume, &fent_common_parent, &fent_old_parent, &fent_new_parent );
+      if( err != 0 ) {
+         free( new_path_basename );
+         free( old_path_basename );
+         free( dest_name );
+         return err;
+      }
+
+      // now, look up the children
+      if( fent_common_parent ) {
+         fent_new = fs_entry_set_find_name( fent_common_parent->children, new_path_basename );
+         fent_old = fs_entry_set_find_name( fent_common_parent->children, old_path_basename );
+      }
+      else {
+         fent_new = fs_entry_set_find_name( fent_new_parent->children, new_path_basename );
+         fent_old = fs_entry_set_find_name( fent_old_parent->children, old_path_basename );
+      }
+
+      // old must exist...
+      err = 0;
+      if( fent_old == NULL )
+         err = -ENOENT;
+      
+      // old must be the right version
+      if( fent_old != NULL && version > 0 && fent_old->version != version )
+         err = -ENOENT;
+
+      // also, if we rename a file into itself, then it's okay
+      if( err != 0 || fent_old == fent_new ) {
+         fs_entry_rename_cleanup( fent_common_parent, fent_old_parent, fent_new_parent );
+         free( new_path_basename );
+         free( old_path_basename );
+         free( dest_name );
+
+         return err;
+      }
+      
+      // only one rename at a time per file, and per destination name.
+      // the destination name is claimed even if nothing has it yet, so a concurrent create or rename can't take it while we talk to the MS.
+      old_file_id = fent_old->file_id;
+      new_file_id = (fent_new != NULL ? fent_new->file_id : 0);
+      dest_parent_id = (fent_common_parent != NULL ? fent_common_parent->file_id : fent_new_parent->file_id);
+      
+      if( fs_entry_rename_claim_files( core, old_file_id, new_file_id, dest_parent_id, dest_name ) ) {
+         break;
+      }
+      
+      // wait for the other rename to finish, and try again
+      fs_entry_rename_cleanup( fent_common_parent, fent_old_parent, fent_new_parent );
+      
+      fent_common_parent = fent_old_parent = fent_new_parent = NULL;
+      
+      fs_entry_rename_wait_files( core, old_file_id, new_file_id, dest_parent_id, dest_name );
+   }
+
    // lock the chilren
    fs_entry_wlock( fent_old );
    if( fent_new )
@@ -231,8 +664,14 @@ int fs_entry_versioned_rename( struct fs_core* core, char const* old_path, char
    }
    
    if( err != 0 ) {
+      fs_entry_unlock( fent_old );
+      if( fent_new )
+         fs_entry_unlock( fent_new );
       fs_entry_rename_cleanup( fent_common_parent, fent_old_parent, fent_new_parent );
+      fs_entry_rename_release_files( core, old_file_id, new_file_id, dest_parent_id, dest_name );
       free( new_path_basename );
+      free( old_path_basename );
+      free( dest_name );
 
       return err;
    }
@@ -247,6 +686,7 @@ int fs_entry_versioned_rename( struct fs_core* core, char const* old_path, char
    uint64_t old_parent_id = 0;
    char const* new_parent_name = NULL;
    char const* old_parent_name = NULL;
+   bool ms_rename = false;
    
    memset( &old_ent, 0, sizeof(old_ent) );
    memset( &new_ent, 0, sizeof(new_ent) );
@@ -335,10 +775,7 @@ int fs_entry_versioned_rename( struct fs_core* core, char const* old_path, char
          }
          if( err == 0 ) {
             // rename on the MS 
-            err = ms_client_rename( core->ms, &fent_old->write_nonce, &old_ent, &new_ent );
-            if( err != 0 ) {
-               SG_error("ms_client_rename(%s --> %s) rc = %d\n", old_ent.name, new_ent.name, err );
-            }
+            ms_rename = true;
          }
       }
    }
@@ -351,68 +788,110 @@ int fs_entry_versioned_rename( struct fs_core* core, char const* old_path, char
       }
       else {
          // do the rename on the MS
-         err = ms_client_rename( core->ms, &fent_old->write_nonce, &old_ent, &new_ent );
-         if( err != 0 ) {
-            SG_error("ms_client_rename(%s --> %s) rc = %d\n", old_ent.name, new_ent.name, err );
-         }
+         ms_rename = true;
       }
    }
    
-   // update our metadata
-   if( err == 0 ) {
+   if( err == 0 && ms_rename ) {
+      
+      // don't hold up the directories while we talk to the MS.
+      // the files are ours until we release them, so they won't be renamed again in the mean time.
+      fs_entry_unlock( fent_old );
+      if( fent_new )
+         fs_entry_unlock( fent_new );
       
-      struct fs_entry* dest_parent = NULL;
+      fs_entry_rename_cleanup( fent_common_parent, fent_old_parent, fent_new_parent );
       
-      if( fent_common_parent ) {
-         dest_parent = fent_common_parent;
-         
-         fs_entry_set_remove( fent_common_parent->children, fent_old->name );
-
-         // rename this fs_entry
-         free( fent_old->name );
-         fent_old->name = new_path_basename;
-
-         if( fent_new )
-            fs_entry_set_remove( fent_common_parent->children, fent_new->name );
-
-         fs_entry_set_insert( fent_common_parent->children, fent_old->name, fent_old );
+      fent_common_parent = fent_old_parent = fent_new_parent = NULL;
+      fent_old = fent_new = NULL;
+      
+      int64_t write_nonce = 0;
+      
+      err = fs_entry_rename_ms_batched( core, &old_ent, &new_ent, &write_nonce );
+      if( err != 0 ) {
+         SG_error("fs_entry_rename_ms_batched(%s --> %s) rc = %d\n", old_path, new_path, err );
       }
       else {
-         dest_parent = fent_new_parent;
          
-         fs_entry_set_remove( fent_old_parent->children, fent_old->name );
-
-         // rename this fs_entry
-         free( fent_old->name );
-         fent_old->name = new_path_basename;
-
-         if( fent_new )
-            fs_entry_set_remove( fent_new_parent->children, fent_new->name );
-
-         fs_entry_set_insert( fent_new_parent->children, fent_old->name, fent_old );
-      }
-      if( fent_new ) {
-         
-         // clean up fent_new and erase it
-         fs_entry_unlock( fent_new );
-         err = fs_entry_detach_lowlevel( core, dest_parent, fent_new );
-         
-         if( err != 0 ) {
-            // technically, it's still safe to access fent_new since dest_parent is write-locked
-            SG_error("fs_entry_detach_lowlevel(%s from %s) rc = %d\n", fent_new->name, dest_parent->name, err );
+         // the MS has it; now move the entry
+         rc = fs_entry_rename_lock_parents( core, old_path, new_path, user, volume, &fent_common_parent, &fent_old_parent, &fent_new_parent );
+         if( rc != 0 ) {
+            
+            // a parent got moved or removed while we were away.  Make sure we reload what's left of both paths, so we find out where the entry went.
+            SG_error("WARN: fs_entry_rename_lock_parents(%s --> %s) rc = %d\n", old_path, new_path, rc );
+            
+            fs_entry_rename_mark_ancestor_stale( core, old_path, user, volume );
+            fs_entry_rename_mark_ancestor_stale( core, new_path, user, volume );
+         }
+         else {
+            
+            struct fs_entry* fent_src = NULL;
+            struct fs_entry* fent_dest = NULL;
+            
+            if( fent_common_parent ) {
+               fent_dest = fs_entry_set_find_name( fent_common_parent->children, new_path_basename );
+               fent_src = fs_entry_set_find_name( fent_common_parent->children, old_path_basename );
+            }
+            else {
+               fent_dest = fs_entry_set_find_name( fent_new_parent->children, new_path_basename );
+               fent_src = fs_entry_set_find_name( fent_old_parent->children, old_path_basename );
+            }
+            
+            if( fent_src == NULL || fent_src->file_id != old_file_id || (fent_dest != NULL ? fent_dest->file_id : 0) != new_file_id ) {
+               
+               // someone created or unlinked one of the names in the mean time.  The MS knows what happened; ask it.
+               SG_debug("%s --> %s changed during rename; reloading parents\n", old_path, new_path );
+               
+               if( fent_common_parent ) {
+                  fs_entry_mark_read_stale( fent_common_parent );
+               }
+               else {
+                  fs_entry_mark_read_stale( fent_old_parent );
+                  fs_entry_mark_read_stale( fent_new_parent );
+               }
+            }
+            else {
+               
+               fent_old = fent_src;
+               fent_new = fent_dest;
+               
+               fs_entry_wlock( fent_old );
+               if( fent_new )
+                  fs_entry_wlock( fent_new );
+               
+               fent_old->write_nonce = write_nonce;
+            }
          }
       }
    }
    
+   // update our metadata
+   if( err == 0 && fent_old != NULL ) {
+      
+      err = fs_entry_rename_swap( core, fent_common_parent, fent_old_parent, fent_new_parent, fent_old, fent_new, new_path_basename );
+      
+      // consumed
+      new_path_basename = NULL;
+      
+      // fent_new is unlocked, and maybe freed
+      fent_new = NULL;
+   }
+   
    // unlock everything
    fs_entry_rename_cleanup( fent_common_parent, fent_old_parent, fent_new_parent );
-   fs_entry_unlock( fent_old );
+   if( fent_old )
+      fs_entry_unlock( fent_old );
    if( fent_new )
       fs_entry_unlock( fent_new );
    
-   if( err != 0 )
+   fs_entry_rename_release_files( core, old_file_id, new_file_id, dest_parent_id, dest_name );
+   
+   if( new_path_basename != NULL )
       free( new_path_basename );
    
+   free( old_path_basename );
+   free( dest_name );
+   
    md_entry_free( &old_ent );
    md_entry_free( &new_ent );
 
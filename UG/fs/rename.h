@@ -19,9 +19,26 @@
 
 #include "fs_entry.h"
 
+// a rename waiting to be sent to the MS along with others
+struct fs_entry_rename_req {
+   struct md_entry* src;
+   struct md_entry* dest;
+   
+   int64_t write_nonce;         // src's new write nonce, if renamed
+   int rc;                      // result of the MS rename
+   sem_t sem;                   // posted once rc is set
+};
+
 // rename
 int fs_entry_versioned_rename( struct fs_core* core, char const* old_path, char const* new_path, uint64_t user, uint64_t volume, int64_t version );
 int fs_entry_remote_rename( struct fs_core* core, Serialization::WriteMsg* renameMsg );
 int fs_entry_rename( struct fs_core* core, char const* old_path, char const* new_path, uint64_t user, uint64_t volume );
 
+// MS update, batched with concurrent renames
+int fs_entry_rename_ms_batched( struct fs_core* core, struct md_entry* src, struct md_entry* dest, int64_t* write_nonce );
+
+// destination names claimed by renames in flight
+bool fs_entry_rename_name_claimed( struct fs_core* core, uint64_t parent_id, char const* name );
+void fs_entry_rename_wait_name( struct fs_core* core, uint64_t parent_id, char const* name );
+
 #endif
\ No newline at end of file
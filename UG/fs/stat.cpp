@@ -282,6 +282,13 @@ static int fs_entry_do_stat( struct fs_core* core, struct fs_entry* fent, struct
 
 
 
+// stat an fs_entry we already have (i.e. from an inode table), without resolving or revalidating its path
+// fent must be at least read-locked
+int fs_entry_stat_locked( struct fs_core* core, struct fs_entry* fent, struct stat* sb ) {
+   return fs_entry_do_stat( core, fent, sb );
+}
+
+
 // stat
 int fs_entry_stat_extended( struct fs_core* core, char const* path, struct stat* sb, bool* is_local, int64_t* version, uint64_t* coordinator_id, uint64_t user, uint64_t volume, bool revalidate ) {
 
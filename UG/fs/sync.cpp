@@ -109,6 +109,13 @@ int fs_entry_flush_bufferred_blocks_async( struct fs_core* core, char const* fs_
    
    int rc = 0;
    
+   // partially-written blocks have to go out whole, so fetch whatever of them was never written
+   rc = fs_entry_fill_sparse_bufferred_blocks( core, fs_path, fent, 0, SG_INVALID_BLOCK_ID );
+   if( rc != 0 ) {
+      SG_error("fs_entry_fill_sparse_bufferred_blocks( %s %" PRIX64 " ) rc = %d\n", fs_path, fent->file_id, rc );
+      return rc;
+   }
+   
    // get bufferred blocks
    fs_entry_extract_bufferred_blocks( fent, &bufferred_blocks );
    
@@ -645,6 +652,19 @@ int fs_entry_fsync_gc_cls_free( struct sync_gc_cls* gc_cls ) {
 }
 
 
+// finish a garbage collection: tell the vacuumer how it went (if it asked), and free gc_cls.
+// gc_cls must not be locked
+static void fs_entry_fsync_gc_finish( struct sync_gc_cls* gc_cls, int rc ) {
+   
+   if( gc_cls->journal_id != 0 ) {
+      fs_entry_vacuumer_gc_done( gc_cls->vac, gc_cls->journal_id, rc );
+   }
+   
+   fs_entry_fsync_gc_cls_free( gc_cls );
+   free( gc_cls );
+}
+
+
 // continuation for garbage collection: once the manifest has been garbage collected, request the vacuumer to vacuum the old vacuum log entries 
 int fs_entry_fsync_gc_manifest_cont( struct rg_client* rg, struct replica_context* rctx, void* cls ) {
    
@@ -673,8 +693,7 @@ int fs_entry_fsync_gc_manifest_cont( struct rg_client* rg, struct replica_contex
    pthread_mutex_unlock( &gc_cls->lock );
    
    // clean up 
-   fs_entry_fsync_gc_cls_free( gc_cls );
-   free( gc_cls );
+   fs_entry_fsync_gc_finish( gc_cls, rc );
    
    return rc;
 }
@@ -798,20 +817,20 @@ int fs_entry_fsync_gc_block_cont( struct rg_client* rg, struct replica_context*
             unlocked = true;
             
             // clean up 
-            fs_entry_fsync_gc_cls_free( gc_cls );
-            free( gc_cls );
+            fs_entry_fsync_gc_finish( gc_cls, rc );
          }
       }
       else {
          SG_error("Garbage collection for %" PRIX64 " failed, rc = %d\n", fs_entry_replica_context_get_file_id( rctx ), gc_cls->rc );
          
          // unsuccessful.  we're done
+         int gc_rc = gc_cls->rc;
+         
          pthread_mutex_unlock( &gc_cls->lock );
          unlocked = true;
          
          // clean up 
-         fs_entry_fsync_gc_cls_free( gc_cls );
-         free( gc_cls );
+         fs_entry_fsync_gc_finish( gc_cls, gc_rc );
       }
    }
    
@@ -828,6 +847,19 @@ int fs_entry_fsync_gc_block_cont( struct rg_client* rg, struct replica_context*
 // fent must be read-locked.
 // NOTE: the replica_snapshot doesn't have to be from fent.  fent is only needed for the driver.
 int fs_entry_garbage_collect_kickoff( struct fs_core* core, char const* fs_path, struct replica_snapshot* gc_snapshot, modification_map* garbage_blocks, bool gc_manifest ) {
+   return fs_entry_garbage_collect_kickoff_ex( core, fs_path, gc_snapshot, garbage_blocks, gc_manifest, 0, NULL );
+}
+
+// kick off garbage collection in the background, on behalf of a vacuumer journal record (if journal_id is not 0).
+// if *pending is set to true, fs_entry_vacuumer_gc_done() will be called with journal_id once every RG has acknowledged
+// the blocks (and the manifest, if gc_manifest is set), or once garbage collection fails.
+// if *pending is set to false, there was nothing to garbage-collect.
+// return 0 on success; negative on error (in which case fs_entry_vacuumer_gc_done() will not be called)
+int fs_entry_garbage_collect_kickoff_ex( struct fs_core* core, char const* fs_path, struct replica_snapshot* gc_snapshot, modification_map* garbage_blocks, bool gc_manifest, uint64_t journal_id, bool* pending ) {
+   
+   if( pending != NULL ) {
+      *pending = false;
+   }
    
    SG_debug("Garbage collect %zu blocks; garbage collect manifest = %d\n", garbage_blocks->size(), gc_manifest );
    
@@ -872,10 +904,15 @@ int fs_entry_garbage_collect_kickoff( struct fs_core* core, char const* fs_path,
    
    fs_entry_fsync_gc_cls_init( gc_cls, core, &core->state->vac, fs_path, gc_snapshot, garbage_blocks, gc_manifest );
    
+   gc_cls->journal_id = journal_id;
+   
    rc = fs_entry_garbage_collect_blocks_ex( core, gc_snapshot, garbage_blocks, NULL, REPLICATE_BACKGROUND, fs_entry_fsync_gc_block_cont, gc_cls );
    if( rc != 0 ) {
       SG_error("fs_entry_garbage_collect_blocks_ex(%" PRIX64 ") rc = %d\n", gc_snapshot->file_id, rc );
    }
+   else if( pending != NULL ) {
+      *pending = true;
+   }
    
    return rc;
 }
@@ -970,8 +1007,13 @@ int fs_entry_fsync_locked( struct fs_core* core, struct fs_file_handle* fh, stru
    fs_entry_unlock( fh->fent );
    
    // finish sync'ing data
+   struct md_trace_span data_span;
+   md_trace_begin( &data_span, "fsync_data", sync_ctx->fent_snapshot->file_id );
+   
    rc = fs_entry_fsync_end_data( core, fh, sync_ctx, begin_rc );
    
+   md_trace_end( &data_span );
+   
    if( rc != 0 ) {
       SG_error("fs_entry_fsync_end_data( %s %" PRIX64 " ) rc = %d\n", fh->path, sync_ctx->fent_snapshot->file_id, rc );
       
@@ -1017,8 +1059,13 @@ int fs_entry_fsync_locked( struct fs_core* core, struct fs_file_handle* fh, stru
    if( begin_rc >= 0 && begin_rc != SYNC_NOTHING && replicate_metadata ) {
       
       // sync metadata, possibly becoming the coordinator
+      struct md_trace_span metadata_span;
+      md_trace_begin( &metadata_span, "fsync_metadata", fh->fent->file_id );
+      
       int metadata_rc = fs_entry_fsync_metadata( core, fh, sync_ctx );
       
+      md_trace_end( &metadata_span );
+      
       if( metadata_rc < 0 ) {
          SG_error("fs_entry_fsync_metadata( %s ) rc = %d\n", fh->path, metadata_rc );
          
@@ -1061,7 +1108,7 @@ int fs_entry_fsync_locked( struct fs_core* core, struct fs_file_handle* fh, stru
 
 
 // sync a file's data and metadata with the MS and flush replicas
-int fs_entry_fsync( struct fs_core* core, struct fs_file_handle* fh ) {
+static int fs_entry_fsync_impl( struct fs_core* core, struct fs_file_handle* fh ) {
    fs_file_handle_wlock( fh );
    if( fh->fent == NULL ) {
       fs_file_handle_unlock( fh );
@@ -1098,6 +1145,19 @@ int fs_entry_fsync( struct fs_core* core, struct fs_file_handle* fh ) {
    return rc;
 }
 
+// synchronize a file's data and metadata, tracing the request
+int fs_entry_fsync( struct fs_core* core, struct fs_file_handle* fh ) {
+   
+   struct md_trace_span span;
+   md_trace_request_begin( &span, "fsync", fh->file_id );
+   
+   int rc = fs_entry_fsync_impl( core, fh );
+   
+   md_trace_end( &span );
+   
+   return rc;
+}
+
 
 // synchronize only a file's data
 int fs_entry_fdatasync( struct fs_core* core, struct fs_file_handle* fh ) {
@@ -99,6 +99,10 @@ struct sync_gc_cls {
    
    // whether or not we should garbage-collect the manifest
    bool gc_manifest;
+   
+   // the vacuumer journal record to remove once everything has been garbage-collected (0 for none)
+   uint64_t journal_id;
+   
    int64_t manifest_mtime_sec;
    int32_t manifest_mtime_nsec;
    
@@ -127,6 +131,7 @@ int fs_entry_fsync_end_data( struct fs_core* core, struct fs_file_handle* fh, st
 int fs_entry_fsync_metadata( struct fs_core* core, struct fs_file_handle* fh, struct sync_context* sync_ctx );
 int fs_entry_fsync_garbage_collect( struct fs_core* core, struct fs_entry* fent, struct sync_context* sync_ctx, bool gc_manifest );
 int fs_entry_garbage_collect_kickoff( struct fs_core* core, char const* fs_path, struct replica_snapshot* old_snapshot, modification_map* garbage_blocks, bool gc_manifest );
+int fs_entry_garbage_collect_kickoff_ex( struct fs_core* core, char const* fs_path, struct replica_snapshot* old_snapshot, modification_map* garbage_blocks, bool gc_manifest, uint64_t journal_id, bool* pending );
 
 // do fsync, but with fh->fent write-locked 
 int fs_entry_fsync_locked( struct fs_core* core, struct fs_file_handle* fh, struct sync_context* sync_ctx );
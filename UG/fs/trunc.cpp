@@ -23,14 +23,24 @@
 #include "write.h"
 #include "replication.h"
 #include "sync.h"
+#include "vacuumer.h"
+#include "syndicate.h"
 
 
 // read one block, and fill the end of it with zeros 
+// fent must be write-locked
 static int fs_entry_get_truncated_block( struct fs_core* core, char const* fs_path, struct fs_entry* fent, uint64_t block_id, off_t block_zero_offset, char** _block_buf, size_t* _block_len ) {
    
+   // if we only partially wrote this block, get the rest of it first
+   int rc = fs_entry_fill_sparse_bufferred_blocks( core, fs_path, fent, block_id, block_id );
+   if( rc != 0 ) {
+      SG_error("fs_entry_fill_sparse_bufferred_blocks( %s %" PRIu64 " ) rc = %d\n", fs_path, block_id, rc );
+      return -ENODATA;
+   }
+   
    // go get the block 
    char* block_buf = SG_CALLOC( char, core->blocking_factor );
-   int rc = fs_entry_read_block( core, fs_path, fent, block_id, block_buf, core->blocking_factor );
+   rc = fs_entry_read_block( core, fs_path, fent, block_id, block_buf, core->blocking_factor );
    
    if( rc != 0 ) {
       SG_error("fs_entry_read_block( %s %" PRIu64 " ) rc = %d\n", fs_path, block_id, rc );
@@ -270,7 +280,10 @@ int fs_entry_truncate_local( struct fs_core* core, char const* fs_path, struct f
    // remember blocks that we need to garbage-collect, and blocks that we need to replicate
    modification_map dirty_blocks;
    modification_map garbage_blocks;
-   modification_map unmerged_garbage;
+   
+   // the garbage blocks belong to the file as it is now 
+   struct replica_snapshot old_snapshot;
+   fs_entry_replica_snapshot( core, fent, 0, 0, &old_snapshot );
    
    int rc = 0;
    
@@ -281,6 +294,7 @@ int fs_entry_truncate_local( struct fs_core* core, char const* fs_path, struct f
       if( rc != 0 ) {
          SG_error("fs_entry_shrink_file( %s to %jd ) rc = %d\n", fs_path, size, rc );
          
+         fs_entry_free_modification_map( &garbage_blocks );
          return -EIO;
       }
    }
@@ -292,6 +306,8 @@ int fs_entry_truncate_local( struct fs_core* core, char const* fs_path, struct f
       if( rc != 0 ) {
          SG_error("fs_entry_expand_file( %s to %jd ) rc = %d\n", fs_path, size, rc );
          
+         fs_entry_free_modification_map( &garbage_blocks );
+         
          if( rc == -ENODATA ) {
             // remote IO error
             return -EREMOTEIO;
@@ -307,6 +323,7 @@ int fs_entry_truncate_local( struct fs_core* core, char const* fs_path, struct f
          SG_error( "md_cache_flush_write( %s %" PRIu64 " ) rc = %d\n", fs_path, max_block, rc );
          
          md_cache_block_future_free( cache_fut );
+         fs_entry_free_modification_map( &garbage_blocks );
          return -EIO;
       }
    }
@@ -320,9 +337,19 @@ int fs_entry_truncate_local( struct fs_core* core, char const* fs_path, struct f
    if( rc != 0 ) {
       
       SG_error("fs_entry_truncate_local_sync( %s %" PRIX64 " ) rc = %d\n", fs_path, fent->file_id, rc );
+      
+      fs_entry_free_modification_map( &garbage_blocks );
       return rc;
    }
    
+   // the MS has the new version, so the cut-off blocks are garbage.  Let the vacuumer collect them, so we don't wait on the RGs.
+   int gc_rc = fs_entry_vacuumer_blocks_bg( &core->state->vac, fs_path, &old_snapshot, &garbage_blocks );
+   if( gc_rc != 0 ) {
+      SG_error("WARN: fs_entry_vacuumer_blocks_bg( %s %" PRIX64 ".%" PRId64 " ) rc = %d; blocks will not be garbage-collected\n", fs_path, old_snapshot.file_id, old_snapshot.file_version, gc_rc );
+   }
+   
+   fs_entry_free_modification_map( &garbage_blocks );
+   
    return 0;
 }
 
@@ -20,6 +20,7 @@
 #include "network.h"
 #include "vacuumer.h"
 #include "driver.h"
+#include "syndicate.h"
 
 // lowlevel unlink operation--given an fs_entry and the name of an entry
 // parent must be write-locked!
@@ -51,8 +52,9 @@ int fs_entry_detach_lowlevel( struct fs_core* core, struct fs_entry* parent, str
       return -ENOTEMPTY;
    }
 
-   // unlink
+   // unlink (and tell lock-free path walks that find it anyway that it's gone)
    fs_entry_set_remove( parent->children, child->name );
+   child->link_count = 0;
    
    struct timespec ts;
    clock_gettime( CLOCK_REALTIME, &ts );
@@ -62,7 +64,7 @@ int fs_entry_detach_lowlevel( struct fs_core* core, struct fs_entry* parent, str
 
    int rc = 0;
 
-   if( child->open_count == 0 ) {
+   if( child->open_count == 0 && child->ref_count == 0 ) {
       
       // evict blocks, if there is a file to begin with
       if( child->ftype == FTYPE_FILE && child->file_id != 0 ) {
@@ -75,7 +77,7 @@ int fs_entry_detach_lowlevel( struct fs_core* core, struct fs_entry* parent, str
       
       if( rc == 0 ) {
          fs_entry_destroy( child, false );
-         free( child );
+         fs_entry_free( child );
          child = NULL;
       }
       else {
@@ -86,10 +88,6 @@ int fs_entry_detach_lowlevel( struct fs_core* core, struct fs_entry* parent, str
       fs_entry_unlock( child );
    }
 
-   if( rc == 0 && child ) {
-      child->link_count = 0;
-   }
-
    return rc;
 }
 
@@ -322,11 +320,28 @@ int fs_entry_versioned_unlink( struct fs_core* core, char const* path, uint64_t
       // safe to unlock parent--it won't be empty (in a rmdir-able sense) until fent is fully garbage-collected, but fent won't be listed either
       fs_entry_unlock( parent );
       
-      // garbage-collect, then unlink on the MS.  Loop this until we succeed in unlinking on the MS (which can only happen 
-      // once all of fent's data has been garbage-collected).
+      // if we have the latest manifest, hand fent's writes and data to the vacuumer, so we can unlink without waiting for them
+      // to be garbage-collected.  The request is journaled, so it survives a restart; it takes effect once the MS forgets fent.
+      struct fs_vacuumer_request vreq;
+      bool deferred = false;
+      
+      if( !no_manifest ) {
+         
+         rc = fs_entry_vacuumer_file_bg_begin( &core->state->vac, path, fent, &vreq );
+         if( rc != 0 ) {
+            SG_error("fs_entry_vacuumer_file_bg_begin( %s %" PRIX64 " ) rc = %d; vacuuming synchronously\n", path, fent->file_id, rc );
+            rc = 0;
+         }
+         else {
+            deferred = true;
+         }
+      }
+      
+      // garbage-collect (unless deferred), then unlink on the MS.  Loop this until we succeed in unlinking on the MS (which can only happen 
+      // once all of fent's data has been garbage-collected, or the MS knows we'll do so later).
       while( true ) {
          
-         if( !no_manifest ) {
+         if( !no_manifest && !deferred ) {
             // if we got the latest manifest, garbage-collect all writes on the file 
             rc = fs_entry_vacuumer_file( core, path, fent );
             
@@ -346,11 +361,17 @@ int fs_entry_versioned_unlink( struct fs_core* core, char const* path, uint64_t
          struct md_entry ent;
          fs_entry_to_md_entry( core, &ent, fent, parent->file_id, parent->name );
 
-         rc = ms_client_delete( core->ms, &ent );
+         rc = ms_client_delete_ex( core->ms, &ent, deferred ? MS_CLIENT_DELETE_DEFER_VACUUM : 0 );
          md_entry_free( &ent );
             
          if( rc != 0 ) {
-            SG_error( "ms_client_delete(%s) rc = %d\n", path, rc );
+            SG_error( "ms_client_delete_ex(%s, deferred = %d) rc = %d\n", path, deferred, rc );
+            
+            if( deferred ) {
+               // the file still exists; don't vacuum it behind its back 
+               fs_entry_vacuumer_file_bg_abort( &core->state->vac, &vreq );
+               deferred = false;
+            }
             
             if( rc == -EAGAIN ) {
                if( !no_manifest ) {
@@ -381,6 +402,10 @@ int fs_entry_versioned_unlink( struct fs_core* core, char const* path, uint64_t
          }
          else {
             // success!
+            if( deferred ) {
+               fs_entry_vacuumer_file_bg_commit( &core->state->vac, &vreq );
+            }
+            
             break;
          }
       }
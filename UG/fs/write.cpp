@@ -20,6 +20,7 @@
 #include "read.h"
 #include "consistency.h"
 #include "driver.h"
+#include "syndicate.h"
 
 // does a previous version of the block exist within a file?
 bool fs_entry_has_old_block( struct fs_core* core, struct fs_entry* fent, uint64_t block_id ) {
@@ -72,9 +73,11 @@ static int fs_entry_clear_bufferred_blocks( struct fs_entry* fent, modification_
 
 // write a block to a file (processing it first with the driver), asynchronously putting it on local storage, and updating the filesystem entry's manifest to refer to it.
 // This updates the manifest's last-mod time, but not the fs_entry's
+// If borrow is true and the driver does not process blocks, the cache writes block_data directly instead of a copy of it.
+// In that case, the caller must keep block_data alive and unmodified until the future has been waited on.
 // return a cache_block_future for it.
 // fent MUST BE WRITE LOCKED, SINCE WE MODIFY THE MANIFEST
-struct md_cache_block_future* fs_entry_flush_block_async( struct fs_core* core, char const* fs_path, struct fs_entry* fent, uint64_t block_id, char const* block_data, size_t block_len, int* _rc ) {
+static struct md_cache_block_future* fs_entry_flush_block_async_ex( struct fs_core* core, char const* fs_path, struct fs_entry* fent, uint64_t block_id, char const* block_data, size_t block_len, bool borrow, int* _rc ) {
    
    int64_t new_block_version = fs_entry_next_block_version();
    
@@ -85,33 +88,51 @@ struct md_cache_block_future* fs_entry_flush_block_async( struct fs_core* core,
    // do pre-upload write processing...
    char* processed_block = NULL;
    size_t processed_block_len = 0;
+   bool borrowed = false;
    
-   rc = driver_write_block_preup( core, core->closure, fs_path, fent, block_id, new_block_version, block_data, block_len, &processed_block, &processed_block_len );
-   if( rc != 0 ) {
-      SG_error("driver_write_block_preup(%s %" PRIX64 ".%" PRId64 "[%" PRIu64 ".%" PRId64 "]) rc = %d\n", fs_path, fent->file_id, fent->version, block_id, new_block_version, rc );
-      *_rc = rc;
-      return NULL;
+   if( borrow && !driver_has_write_block_preup( core->closure ) ) {
+      
+      // nothing to process, so there's nothing to copy either
+      processed_block = (char*)block_data;
+      processed_block_len = block_len;
+      borrowed = true;
+   }
+   else {
+      
+      rc = driver_write_block_preup( core, core->closure, fs_path, fent, block_id, new_block_version, block_data, block_len, &processed_block, &processed_block_len );
+      if( rc != 0 ) {
+         SG_error("driver_write_block_preup(%s %" PRIX64 ".%" PRId64 "[%" PRIu64 ".%" PRId64 "]) rc = %d\n", fs_path, fent->file_id, fent->version, block_id, new_block_version, rc );
+         *_rc = rc;
+         return NULL;
+      }
    }
    
    // hash the contents of this block and the processed block, including anything read with fs_entry_read_block
    unsigned char* block_hash = BLOCK_HASH_DATA( processed_block, processed_block_len );
    
-   // for debugging...
-   char prefix[21];
-   memset( prefix, 0, 21 );
-   memcpy( prefix, processed_block, MIN( 20, processed_block_len ) );
-   
    // cache the new block.  Get back the future (caller will manage it).
-   struct md_cache_block_future* f = md_cache_write_block_async( core->cache, fent->file_id, fent->version, block_id, new_block_version, processed_block, processed_block_len, false, &rc );
+   struct md_cache_block_future* f = NULL;
+   
+   if( borrowed ) {
+      f = md_cache_write_block_async_borrowed( core->cache, fent->file_id, fent->version, block_id, new_block_version, processed_block, processed_block_len, &rc );
+   }
+   else {
+      f = md_cache_write_block_async( core->cache, fent->file_id, fent->version, block_id, new_block_version, processed_block, processed_block_len, false, &rc );
+   }
+   
    if( f == NULL ) {
       SG_error("WARN: failed to cache %" PRIX64 ".%" PRId64 "[%" PRIu64 ".%" PRId64 "], rc = %d\n", fent->file_id, fent->version, block_id, new_block_version, rc );
       *_rc = rc;
       free( block_hash );
-      free( processed_block );
+      
+      if( !borrowed ) {
+         free( processed_block );
+      }
+      
       return NULL;
    }
    else {
-      SG_debug("cache %zu bytes for %" PRIX64 ".%" PRId64 "[%" PRIu64 ".%" PRId64 "]: data: '%s'...\n", processed_block_len, fent->file_id, fent->version, block_id, new_block_version, prefix );
+      SG_debug("cache %zu bytes for %" PRIX64 ".%" PRId64 "[%" PRIu64 ".%" PRId64 "]%s\n", processed_block_len, fent->file_id, fent->version, block_id, new_block_version, (borrowed ? " (borrowed)" : "") );
       
       // update the manifest (including its lastmod)
       fs_entry_manifest_put_block( core, core->gateway, fent, block_id, new_block_version, block_hash );
@@ -122,6 +143,14 @@ struct md_cache_block_future* fs_entry_flush_block_async( struct fs_core* core,
    }
 }
 
+
+// write a block to a file (processing it first with the driver), asynchronously putting it on local storage, and updating the filesystem entry's manifest to refer to it.
+// the cache gets its own copy of the data.
+// fent MUST BE WRITE LOCKED, SINCE WE MODIFY THE MANIFEST
+struct md_cache_block_future* fs_entry_flush_block_async( struct fs_core* core, char const* fs_path, struct fs_entry* fent, uint64_t block_id, char const* block_data, size_t block_len, int* _rc ) {
+   return fs_entry_flush_block_async_ex( core, fs_path, fent, block_id, block_data, block_len, false, _rc );
+}
+
 // does a partial head "complete" a block?  As in, does it write up to the end of the block?
 bool fs_entry_head_completes_block( struct fs_core* core, struct fs_entry_partial_head* head ) {
    return (head->write_offset + head->write_len >= core->blocking_factor);
@@ -165,14 +194,7 @@ int fs_entry_split_write( struct fs_core* core, struct fs_entry* fent, char cons
       // align the next blocks to the block boundary 
       buf_off = core->blocking_factor - (offset % core->blocking_factor);
       
-      ////////////////////////////////////////////////////////////
-      char* tmp = SG_CALLOC( char, head->write_len + 1 );
-      memcpy( tmp, head->buf_ptr, head->write_len );
-      
-      SG_debug("Partial head: block %" PRIu64 " [%zu] offset %zu, data '%s'\n", head->block_id, head->write_len, head->write_offset, tmp );
-      
-      free( tmp );
-      ////////////////////////////////////////////////////////////
+      SG_debug("Partial head: block %" PRIu64 " [%zu] offset %zu\n", head->block_id, head->write_len, head->write_offset );
    }
    
    // do we have a partial tail?
@@ -197,14 +219,7 @@ int fs_entry_split_write( struct fs_core* core, struct fs_entry* fent, char cons
       
       wvec->has_tail = true;
       
-      ////////////////////////////////////////////////////////////
-      char* tmp = SG_CALLOC( char, tail->write_len + 1 );
-      memcpy( tmp, tail->buf_ptr, tail->write_len );
-      
-      SG_debug("Partial tail: block %" PRIu64 " [%zu], data '%s'\n", tail->block_id, tail->write_len, tmp );
-      
-      free( tmp );
-      ////////////////////////////////////////////////////////////
+      SG_debug("Partial tail: block %" PRIu64 " [%zu]\n", tail->block_id, tail->write_len );
    }
    
    // do we have overwritten blocks?
@@ -236,16 +251,9 @@ int fs_entry_split_write( struct fs_core* core, struct fs_entry* fent, char cons
          whole_block.block_id = block_id;
          
          wvec->overwritten->push_back( whole_block );
-         
-         ////////////////////////////////////////////////////////////
-         char* tmp = SG_CALLOC( char, core->blocking_factor + 1 );
-         memcpy( tmp, whole_block.buf_ptr, core->blocking_factor );
-         
-         SG_debug("Whole block: block %" PRIu64 ", data '%s'\n", block_id, tmp );
-            
-         free( tmp );
-         ////////////////////////////////////////////////////////////
       }
+      
+      SG_debug("Whole blocks: [%" PRIu64 ", %" PRIu64 "]\n", overwrite_start, overwrite_end );
    }
    
    wvec->start_block_id = start_block_id;
@@ -321,9 +329,10 @@ int fs_entry_put_write_holes( struct fs_core* core, struct fs_entry* fent, off_t
 // return 0 or 1 (via ret)
 // if there is an old block, store it to binfo_old and return 1.  Otherwise, return 0 via ret.
 // store the new block info to binfo_new.
+// if borrow is true, the cache may write block directly (see fs_entry_flush_block_async_ex)
 // fent must be write-locked--we'll update the manifest
-struct md_cache_block_future* fs_entry_write_block_async( struct fs_core* core, char const* fs_path, struct fs_entry* fent, uint64_t block_id, char const* block, size_t block_len,
-                                                          struct fs_entry_block_info* binfo_old, struct fs_entry_block_info* binfo_new, int* ret ) {
+static struct md_cache_block_future* fs_entry_write_block_async_ex( struct fs_core* core, char const* fs_path, struct fs_entry* fent, uint64_t block_id, char const* block, size_t block_len, bool borrow,
+                                                                    struct fs_entry_block_info* binfo_old, struct fs_entry_block_info* binfo_new, int* ret ) {
 
    *ret = 0;
    
@@ -343,10 +352,10 @@ struct md_cache_block_future* fs_entry_write_block_async( struct fs_core* core,
    
    // write the data and update the manifest...
    int rc = 0;
-   struct md_cache_block_future* block_fut = fs_entry_flush_block_async( core, fs_path, fent, block_id, block, block_len, &rc );
+   struct md_cache_block_future* block_fut = fs_entry_flush_block_async_ex( core, fs_path, fent, block_id, block, block_len, borrow, &rc );
    
    if( block_fut == NULL ) {
-      SG_error("ERR: fs_entry_flush_block_async(%s/%" PRId64 ", block_len=%zu) failed, rc = %d\n", fs_path, block_id, block_len, rc );
+      SG_error("ERR: fs_entry_flush_block_async_ex(%s/%" PRId64 ", block_len=%zu) failed, rc = %d\n", fs_path, block_id, block_len, rc );
       *ret = -EIO;
       
       if( old_hash )
@@ -382,6 +391,16 @@ struct md_cache_block_future* fs_entry_write_block_async( struct fs_core* core,
 }
 
 
+// Write one block of data for a local file, giving the cache its own copy of the data.
+// See fs_entry_write_block_async_ex for return values.
+// fent must be write-locked--we'll update the manifest
+struct md_cache_block_future* fs_entry_write_block_async( struct fs_core* core, char const* fs_path, struct fs_entry* fent, uint64_t block_id, char const* block, size_t block_len,
+                                                          struct fs_entry_block_info* binfo_old, struct fs_entry_block_info* binfo_new, int* ret ) {
+   
+   return fs_entry_write_block_async_ex( core, fs_path, fent, block_id, block, block_len, false, binfo_old, binfo_new, ret );
+}
+
+
 // get the partially-overwritten blocks' data, so we can put a full block.
 // fent must be at least read-locked, but we need to indicate if it is write-locked (since the downloader needs to know)
 // return 0 on success
@@ -427,6 +446,8 @@ int fs_entry_read_partial_blocks( struct fs_core* core, char const* fs_path, str
 
 // start writing all whole blocks to the cache
 // record the old and new versions of the blocks as we do so.
+// whole blocks are aligned slices of the client's buffer (or of partial blocks we read), and the caller waits on the
+// returned futures before releasing them, so the cache can write them out without copying.
 // fent must be write-locked
 // return 0 on success.
 // return negative and fail fast otherwise
@@ -451,9 +472,9 @@ static int fs_entry_write_full_blocks_async( struct fs_core* core, char const* f
       struct fs_entry_whole_block* blk = &(*itr);
       
       // flush it 
-      struct md_cache_block_future* fut = fs_entry_write_block_async( core, fs_path, fent, blk->block_id, blk->buf_ptr, core->blocking_factor, &old_binfo, &new_binfo, &rc );
+      struct md_cache_block_future* fut = fs_entry_write_block_async_ex( core, fs_path, fent, blk->block_id, blk->buf_ptr, core->blocking_factor, true, &old_binfo, &new_binfo, &rc );
       if( rc < 0 || fut == NULL ) {
-         SG_error("fs_entry_write_block_async( %s %" PRIX64 ".%" PRId64 "[%" PRIu64 "]) rc = %d\n", fs_path, fent->file_id, fent->version, blk->block_id, rc );
+         SG_error("fs_entry_write_block_async_ex( %s %" PRIX64 ".%" PRId64 "[%" PRIu64 "]) rc = %d\n", fs_path, fent->file_id, fent->version, blk->block_id, rc );
          break;
       }
       
@@ -506,45 +527,6 @@ int fs_entry_cache_evict_blocks_async( struct fs_core* core, struct fs_entry* fe
    return 0;
 }
 
-// apply partial blocks to existing block data.
-// block_head and block_tail are full-sized blocks that need to be patched
-// if we patch the head to the point where it forms a complete block, then put it into the overwritten list
-static int fs_entry_apply_partial_blocks( struct fs_core* core, struct fs_entry_write_vec* wvec, char* block_head, char* block_tail, fs_entry_whole_block_list_t* overwritten ) {
-
-   if( block_head ) {
-      // write the head to the buffer
-      fs_entry_apply_partial_head( block_head, &wvec->head );
-      
-      // has this block been made whole?
-      if( fs_entry_head_completes_block( core, &wvec->head ) ) {
-         
-         SG_debug("partial head %" PRIu64 " is now a whole block\n", wvec->head.block_id );
-         
-         // the head block is now a full block (which we allocated)
-         struct fs_entry_whole_block full_head;
-         
-         full_head.block_id = wvec->head.block_id;
-         full_head.buf_ptr = block_head;
-         
-         overwritten->push_back( full_head );
-      }
-   }
-   else {
-      SG_debug("%s", "No partial head to read\n");
-   }
-   
-   if( block_tail ) {
-      // write the tail 
-      fs_entry_apply_partial_tail( block_tail, &wvec->tail );
-   }
-   else {
-      SG_debug("%s", "No partial tail to read\n");
-   }
-
-   return 0;
-}
-
-
 // put a block version for a bufferred block, putting the new version and hash into the manifest
 // fent must be write-locked
 static int fs_entry_manifest_put_bufferred_block( struct fs_core* core, struct fs_entry* fent, uint64_t block_id ) {
@@ -567,83 +549,187 @@ static int fs_entry_manifest_put_bufferred_block( struct fs_core* core, struct f
    return 0;
 }
 
-// write partial blocks to the block buffer.
-// if opt_block_head is not NULL, it must be a full block and will serve as the partial head to be bufferred.  Otherwise, the partial head client buffer in the write vector will be used.
-// if opt_block_tail is not NULL, it must be a full block and will serve as the partial tail to be bufferred.  Otherwise, the partial tail client buffer in the write vector will be used.
+// write a partial block to the block buffer, without reading in the rest of the block.
+// if the block is not bufferred yet but has an older version, the bufferred block will be sparse, and the rest of it will
+// only be fetched if something needs the whole block before it gets overwritten (see fs_entry_fill_sparse_bufferred_blocks).
 // return 0 on success
-// fent must be write-locked, in the same context as fs_entry_writev.  we update the manifest
-static int fs_entry_buffer_partial_blocks( struct fs_core* core, char const* fs_path, struct fs_entry* fent, struct fs_entry_write_vec* wvec, char* opt_block_head, char* opt_block_tail ) {
+// fent must be write-locked, in the same context as fs_entry_writev.
+static int fs_entry_buffer_partial_block( struct fs_core* core, char const* fs_path, struct fs_entry* fent, uint64_t block_id, bool has_old_version, int64_t old_block_version,
+                                          char const* buf, off_t block_offset, size_t write_len ) {
    
    int rc = 0;
    
-   // write the partial head to the block buffer, if we can
-   if( wvec->has_head && !fs_entry_head_completes_block( core, &wvec->head ) ) {
+   if( has_old_version && fs_entry_has_bufferred_block( fent, block_id ) == -ENOENT ) {
       
-      SG_debug("write partial head block %" PRIu64 " to bufferred blocks\n", wvec->head.block_id );
+      // remember where the older version lives, in case we need it later
+      uint64_t gateway_id = fent->manifest->get_block_host( core, block_id );
       
-      // update the block 
-      if( opt_block_head ) {
-         // use the data we read
-         rc = fs_entry_write_bufferred_block( core, fent, wvec->head.block_id, opt_block_head, 0, core->blocking_factor );
-      }
-      else {
-         // use the client buffer
-         rc = fs_entry_write_bufferred_block( core, fent, wvec->head.block_id, wvec->head.buf_ptr, wvec->head.write_offset, wvec->head.write_len );
-      }
+      SG_debug("write %zu bytes at %jd of block %" PRIu64 " to a sparse bufferred block (old version %" PRId64 ")\n", write_len, block_offset, block_id, old_block_version );
       
-      if( rc != 0 ) {
-         SG_error("fs_entry_write_bufferred_block( %s %" PRIX64 ".%" PRId64 "[%" PRIu64 "] ) rc = %d\n",
-                fs_path, fent->file_id, fent->version, wvec->head.block_id, rc );
-         
-         return rc;
+      rc = fs_entry_write_sparse_bufferred_block( core, fent, block_id, old_block_version, gateway_id, buf, block_offset, write_len );
+   }
+   else {
+      
+      // either already bufferred, or a new block (whose unwritten bytes are zeros)
+      SG_debug("write %zu bytes at %jd of block %" PRIu64 " to bufferred blocks\n", write_len, block_offset, block_id );
+      
+      rc = fs_entry_write_bufferred_block( core, fent, block_id, buf, block_offset, write_len );
+   }
+   
+   if( rc != 0 ) {
+      SG_error("fs_entry_write_bufferred_block( %s %" PRIX64 ".%" PRId64 "[%" PRIu64 "] ) rc = %d\n", fs_path, fent->file_id, fent->version, block_id, rc );
+   }
+   
+   return rc;
+}
+
+
+// copy a bufferred block's state into saved, so a failed write can put it back with fs_entry_restore_bufferred_block.
+// *had_block is set to false if the block isn't bufferred.  The copy never owns the block's fd.
+// return 0 on success
+// return -ENOMEM on OOM
+// fent must be write-locked
+static int fs_entry_save_bufferred_block( struct fs_entry* fent, uint64_t block_id, struct fs_entry_block_info* saved, bool* had_block ) {
+   
+   memset( saved, 0, sizeof(struct fs_entry_block_info) );
+   saved->block_fd = -1;
+   *had_block = false;
+   
+   modification_map::iterator itr = fent->bufferred_blocks->find( block_id );
+   if( itr == fent->bufferred_blocks->end() ) {
+      return 0;
+   }
+   
+   struct fs_entry_block_info* binfo = &itr->second;
+   
+   saved->version = binfo->version;
+   saved->gateway_id = binfo->gateway_id;
+   saved->block_len = binfo->block_len;
+   saved->dirty = binfo->dirty;
+   
+   if( binfo->hash != NULL ) {
+      saved->hash = SG_CALLOC( unsigned char, binfo->hash_len );
+      if( saved->hash == NULL ) {
+         fs_entry_block_info_free( saved );
+         return -ENOMEM;
       }
-      else {
-         // update manifest 
-         rc = fs_entry_manifest_put_bufferred_block( core, fent, wvec->head.block_id );
-         if( rc != 0 ) {
-            SG_error("fs_entry_manifest_put_bufferred_block( %" PRIu64 " ) rc = %d\n", wvec->head.block_id, rc );
-            return rc;
-         }
+      
+      memcpy( saved->hash, binfo->hash, binfo->hash_len );
+      saved->hash_len = binfo->hash_len;
+   }
+   
+   if( binfo->block_buf != NULL ) {
+      saved->block_buf = SG_CALLOC( char, binfo->block_len );
+      if( saved->block_buf == NULL ) {
+         fs_entry_block_info_free( saved );
+         return -ENOMEM;
       }
+      
+      memcpy( saved->block_buf, binfo->block_buf, binfo->block_len );
+   }
+   
+   if( binfo->dirty_ranges != NULL ) {
+      saved->dirty_ranges = new fs_entry_dirty_range_map_t( *binfo->dirty_ranges );
+   }
+   
+   *had_block = true;
+   return 0;
+}
+
+
+// put back a bufferred block saved by fs_entry_save_bufferred_block, discarding whatever was written to it since.
+// the bufferred block takes ownership of saved's memory.
+// fent must be write-locked
+static void fs_entry_restore_bufferred_block( struct fs_entry* fent, uint64_t block_id, struct fs_entry_block_info* saved, bool had_block ) {
+   
+   if( !had_block ) {
+      fs_entry_clear_bufferred_block( fent, block_id );
+      return;
    }
    
-   // write the partial tail to the block buffer, if it exists 
-   else if( wvec->has_tail ) {
+   int block_fd = -1;
+   
+   modification_map::iterator itr = fent->bufferred_blocks->find( block_id );
+   if( itr != fent->bufferred_blocks->end() ) {
       
-      SG_debug("write partial tail block %" PRIu64 " to bufferred blocks\n", wvec->tail.block_id );
+      // keep the live block's fd; the saved copy never owned one
+      block_fd = itr->second.block_fd;
+      fs_entry_block_info_free_ex( &itr->second, false );
+   }
+   
+   saved->block_fd = block_fd;
+   (*fent->bufferred_blocks)[ block_id ] = *saved;
+   
+   memset( saved, 0, sizeof(struct fs_entry_block_info) );
+   saved->block_fd = -1;
+}
+
+
+// fetch the unwritten parts of the sparse bufferred blocks in [start_block_id, end_block_id] from their older versions, and merge them in.
+// this is the "read" half of a partial write's read-modify-write, deferred until something needs the whole block.
+// blocks that have since been overwritten completely are no longer sparse, so they never get fetched.
+// return 0 on success
+// return -ENODATA if not all data could be obtained, in which case the blocks stay sparse
+// fent must be write-locked
+int fs_entry_fill_sparse_bufferred_blocks( struct fs_core* core, char const* fs_path, struct fs_entry* fent, uint64_t start_block_id, uint64_t end_block_id ) {
+   
+   int rc = 0;
+   modification_map sparse_blocks;
+   
+   // take the sparse blocks out of the block buffer while we fetch, so the reads go to their older versions instead
+   rc = fs_entry_extract_sparse_bufferred_blocks( fent, start_block_id, end_block_id, &sparse_blocks );
+   if( rc != 0 ) {
+      SG_error("fs_entry_extract_sparse_bufferred_blocks( %s ) rc = %d\n", fs_path, rc );
+      return rc;
+   }
+   
+   if( sparse_blocks.size() == 0 ) {
+      return 0;
+   }
+   
+   SG_debug("fill %zu sparse bufferred blocks of %" PRIX64 "\n", sparse_blocks.size(), fent->file_id );
+   
+   struct fs_entry_read_context read_ctx;
+   fs_entry_read_context_init( &read_ctx );
+   
+   for( modification_map::iterator itr = sparse_blocks.begin(); itr != sparse_blocks.end(); itr++ ) {
       
-      // update the block 
-      if( opt_block_tail ) {
-         // use the data we read
-         rc = fs_entry_write_bufferred_block( core, fent, wvec->tail.block_id, opt_block_tail, 0, core->blocking_factor );
-      }
-      else {
-         // use the client buffer
-         rc = fs_entry_write_bufferred_block( core, fent, wvec->tail.block_id, wvec->tail.buf_ptr, 0, wvec->tail.write_len );
-      }
+      // NOTE: the read context frees both the future and its buffer
+      struct fs_entry_read_block_future* read_fut = SG_CALLOC( struct fs_entry_read_block_future, 1 );
       
-      if( rc != 0 ) {
-         SG_error("fs_entry_write_bufferred_block( %s %" PRIX64 ".%" PRId64 "[%" PRIu64 "] ) rc = %d\n",
-                fs_path, fent->file_id, fent->version, wvec->tail.block_id, rc );
+      fs_entry_setup_partial_read_future( core, read_fut, itr->second.gateway_id, fs_path, fent->version, itr->first, itr->second.version, fent->size );
+      
+      fs_entry_read_context_add_block_future( &read_ctx, read_fut );
+   }
+   
+   // NOTE: we're write-locked in this method
+   rc = fs_entry_read_partial_blocks( core, fs_path, fent, true, &read_ctx );
+   if( rc != 0 ) {
+      SG_error("fs_entry_read_partial_blocks(%s %" PRIX64 ".%" PRId64 ") rc = %d\n", fs_path, fent->file_id, fent->version, rc );
+   }
+   else {
+      
+      // merge the older versions in
+      for( fs_entry_read_block_future_set_t::iterator itr = read_ctx.reads->begin(); itr != read_ctx.reads->end(); itr++ ) {
          
-         return rc;
-      }
-      else {
-         // update manifest
-         rc = fs_entry_manifest_put_bufferred_block( core, fent, wvec->tail.block_id );
-         if( rc != 0 ) {
-            SG_error("fs_entry_manifest_put_bufferred_block( %" PRIu64 " ) rc = %d\n", wvec->tail.block_id, rc );
-            return rc;
-         }
+         struct fs_entry_read_block_future* read_fut = *itr;
+         
+         fs_entry_block_info_fill_sparse( &sparse_blocks[ read_fut->block_id ], read_fut->result, read_fut->result_len );
       }
    }
    
+   // put them back, filled in or not
+   fs_entry_emplace_bufferred_blocks( fent, &sparse_blocks );
+   
+   fs_entry_read_context_free_all( core, &read_ctx );
+   
    return rc;
 }
-   
 
 
 // write a write vector in its entirety.
+// partial heads and tails go to the block buffer without fetching the rest of their blocks; a partial head that makes its
+// bufferred block whole gets flushed along with the overwritten blocks.
 // fent must be write-locked
 // return 0 on success; negative on error.
 // if this method fails, the caller should call fs_entry_revert_write to restore the fent.
@@ -653,68 +739,57 @@ static int fs_entry_writev( struct fs_core* core, char* fs_path, struct fs_entry
    
    int rc = 0;
    
-   // head and tail buffers (pointers to buffers flushed to cache)
-   char* block_head = NULL;
-   char* block_tail = NULL;
-   
    // overwritten and new blocks 
    modification_map new_blocks;
    
-   // futures for reading partial heads and tails
-   struct fs_entry_read_block_future head_fut;
-   struct fs_entry_read_block_future tail_fut;
-   
-   memset( &head_fut, 0, sizeof(struct fs_entry_read_block_future) );
-   memset( &tail_fut, 0, sizeof(struct fs_entry_read_block_future) );
-   
    // overwritten blocks 
    fs_entry_whole_block_list_t overwritten;
    
-   struct fs_entry_read_context read_ctx;      // for getting partial heads and tails
-   fs_entry_read_context_init( &read_ctx );
+   // does the partial head stay in the block buffer?
+   bool head_bufferred = false;
    
-   // if we have a partial head and an older version of the affected block, then populate block with the block-to-be-modified
-   if( wvec->has_head && wvec->head.has_old_version ) {
-      
-      SG_debug("Read partial head %" PRIu64 "\n", wvec->head.block_id );
-      
-      uint64_t gateway_id = fent->manifest->get_block_host( core, wvec->head.block_id );
-      
-      block_head = fs_entry_setup_partial_read_future( core, &head_fut, gateway_id, fs_path, fent->version, wvec->head.block_id, wvec->head.block_version, fent->size );
-      
-      // add it to the read context 
-      fs_entry_read_context_add_block_future( &read_ctx, &head_fut );
-   }
+   // the head's bufferred block as it was before this write, so we can undo the head if the rest of the write fails
+   struct fs_entry_block_info old_head;
+   bool had_old_head = false;
    
-   // if we have a partial tail and an older version of the affected block, then populate the block with the block-to-be-modified
-   if( wvec->has_tail && wvec->tail.has_old_version ) {
-      
-      SG_debug("Read partial tail %" PRIu64 "\n", wvec->tail.block_id );
-      
-      uint64_t gateway_id = fent->manifest->get_block_host( core, wvec->tail.block_id );
+   memset( &old_head, 0, sizeof(struct fs_entry_block_info) );
+   old_head.block_fd = -1;
+   
+   // apply the partial head to its bufferred block
+   if( wvec->has_head ) {
       
-      block_tail = fs_entry_setup_partial_read_future( core, &tail_fut, gateway_id, fs_path, fent->version, wvec->tail.block_id, wvec->tail.block_version, fent->size );
+      rc = fs_entry_save_bufferred_block( fent, wvec->head.block_id, &old_head, &had_old_head );
+      if( rc != 0 ) {
+         SG_error("fs_entry_save_bufferred_block( %" PRIu64 " ) rc = %d\n", wvec->head.block_id, rc );
+         return rc;
+      }
       
-      // add it to the read context 
-      fs_entry_read_context_add_block_future( &read_ctx, &tail_fut );
-   }
-   
-   // get partially-overwritten blocks, if we need to, and patch them
-   if( fs_entry_read_context_size( &read_ctx ) > 0 ) {
-      // NOTE: we're write-locked in this method
-      rc = fs_entry_read_partial_blocks( core, fs_path, fent, true, &read_ctx );
+      rc = fs_entry_buffer_partial_block( core, fs_path, fent, wvec->head.block_id, wvec->head.has_old_version, wvec->head.block_version, wvec->head.buf_ptr, wvec->head.write_offset, wvec->head.write_len );
       if( rc != 0 ) {
-         // failed to read data...can't proceed 
-         SG_error("fs_entry_read_partial_blocks(%s %" PRIX64 ".%" PRId64 ") rc = %d\n", fs_path, fent->file_id, fent->version, rc );
-         
-         // free everything 
-         // NOTE: this frees block_head and block_tail, since they were assigned to their respective read futures
-         fs_entry_read_context_free_all( core, &read_ctx );
+         fs_entry_block_info_free( &old_head );
          return rc;
       }
       
-      // apply writes to the head and tail block buffers
-      fs_entry_apply_partial_blocks( core, wvec, block_head, block_tail, &overwritten );
+      char* head_buf = NULL;
+      size_t head_len = 0;
+      
+      // has this block been made whole?
+      if( fs_entry_head_completes_block( core, &wvec->head ) && fs_entry_get_whole_bufferred_block( fent, wvec->head.block_id, &head_buf, &head_len ) == 0 ) {
+         
+         SG_debug("partial head %" PRIu64 " is now a whole block\n", wvec->head.block_id );
+         
+         // flush it with the others.
+         // NOTE: the bufferred block gets cleared only once the flush has finished
+         struct fs_entry_whole_block full_head;
+         
+         full_head.block_id = wvec->head.block_id;
+         full_head.buf_ptr = head_buf;
+         
+         overwritten.push_back( full_head );
+      }
+      else {
+         head_bufferred = true;
+      }
    }
    
    // write all full blocks to cache.
@@ -732,8 +807,15 @@ static int fs_entry_writev( struct fs_core* core, char* fs_path, struct fs_entry
    int write_rc = fs_entry_write_full_blocks_async( core, fs_path, fent, &overwritten, old_blocks, &new_blocks, &futs );
    
    // wait for each cache write to complete
+   struct md_trace_span span;
+   md_trace_begin( &span, "cache_write", fent->file_id );
+   core->state->stats->enter( STAT_CACHE_WRITE );
+   
    int wait_rc = md_cache_flush_writes( &futs );
    
+   core->state->stats->leave( STAT_CACHE_WRITE, wait_rc );
+   md_trace_end( &span );
+   
    if( write_rc != 0 || wait_rc != 0 ) {
       
       if( write_rc != 0 ) {
@@ -748,12 +830,13 @@ static int fs_entry_writev( struct fs_core* core, char* fs_path, struct fs_entry
             rc = wait_rc;
       }
       
-      // roll back cache write 
+      // roll back cache write, and undo the partial head
       fs_entry_cache_evict_blocks_async( core, fent, &new_blocks );
       
-      // free everything 
-      // NOTE: this frees block_head and block_tail, since they were assigned to their respective read futures
-      fs_entry_read_context_free_all( core, &read_ctx );
+      if( wvec->has_head ) {
+         fs_entry_restore_bufferred_block( fent, wvec->head.block_id, &old_head, had_old_head );
+      }
+      
       return rc;
    }
    
@@ -763,23 +846,43 @@ static int fs_entry_writev( struct fs_core* core, char* fs_path, struct fs_entry
    // clear all flushed bufferred blocks 
    fs_entry_clear_bufferred_blocks( fent, &new_blocks );
    
-   // write partial blocks to the block buffer, updating the manifest in the process
-   rc = fs_entry_buffer_partial_blocks( core, fs_path, fent, wvec, block_head, block_tail );
-   if( rc != 0 ) {
-      SG_error("fs_entry_buffer_partial_blocks( %s %" PRIX64 ".%" PRId64 ") rc = %d\n",
-               fs_path, fent->file_id, fent->version, rc );
+   // write the partial tail to the block buffer
+   if( wvec->has_tail ) {
+      
+      rc = fs_entry_buffer_partial_block( core, fs_path, fent, wvec->tail.block_id, wvec->tail.has_old_version, wvec->tail.block_version, wvec->tail.buf_ptr, 0, wvec->tail.write_len );
+   }
+   
+   // update the manifest with the bufferred blocks' new versions
+   if( rc == 0 && head_bufferred ) {
+      
+      rc = fs_entry_manifest_put_bufferred_block( core, fent, wvec->head.block_id );
+      if( rc != 0 ) {
+         SG_error("fs_entry_manifest_put_bufferred_block( %" PRIu64 " ) rc = %d\n", wvec->head.block_id, rc );
+      }
+   }
+   
+   if( rc == 0 && wvec->has_tail ) {
       
+      rc = fs_entry_manifest_put_bufferred_block( core, fent, wvec->tail.block_id );
+      if( rc != 0 ) {
+         SG_error("fs_entry_manifest_put_bufferred_block( %" PRIu64 " ) rc = %d\n", wvec->tail.block_id, rc );
+      }
+   }
+   
+   if( rc != 0 ) {
       
-      // roll back cache write 
+      // roll back cache write, and undo the partial head
       fs_entry_cache_evict_blocks_async( core, fent, &new_blocks );
       
-      // free everything 
-      // NOTE: this frees block_head and block_tail, since they were assigned to their respective read futures
-      fs_entry_read_context_free_all( core, &read_ctx );
+      if( wvec->has_head ) {
+         fs_entry_restore_bufferred_block( fent, wvec->head.block_id, &old_head, had_old_head );
+      }
       
       return rc;
    }
    
+   fs_entry_block_info_free( &old_head );
+   
    // all data committed to disk!
    // merge new writes into the dirty block set, freeing the old ones to be evicted
    fs_entry_merge_new_dirty_blocks( fent, &new_blocks );
@@ -787,9 +890,6 @@ static int fs_entry_writev( struct fs_core* core, char* fs_path, struct fs_entry
    // evict old blocks asynchronously
    fs_entry_cache_evict_blocks_async( core, fent, old_blocks );
    
-   // free everything, including block_head and block_tail
-   fs_entry_read_context_free_all( core, &read_ctx );
-   
    return 0;
 }
 
@@ -851,7 +951,7 @@ int fs_entry_do_fast_write( struct fs_core* core, char const* fs_path, struct fs
 // perform a write.
 // On success, return number of bytes written
 // On failure, return negative 
-ssize_t fs_entry_write( struct fs_core* core, struct fs_file_handle* fh, char const* buf, size_t count, off_t offset ) {
+static ssize_t fs_entry_write_impl( struct fs_core* core, struct fs_file_handle* fh, char const* buf, size_t count, off_t offset ) {
    
    // sanity check
    if( count == 0 )
@@ -971,6 +1071,19 @@ ssize_t fs_entry_write( struct fs_core* core, struct fs_file_handle* fh, char co
    return count;
 }
 
+// write to a file, tracing the request
+ssize_t fs_entry_write( struct fs_core* core, struct fs_file_handle* fh, char const* buf, size_t count, off_t offset ) {
+   
+   struct md_trace_span span;
+   md_trace_request_begin( &span, "write", fh->file_id );
+   
+   ssize_t rc = fs_entry_write_impl( core, fh, buf, count, offset );
+   
+   md_trace_end( &span );
+   
+   return rc;
+}
+
 
 // revert a set of block writes
 int fs_entry_revert_blocks( struct fs_core* core, struct fs_entry* fent, uint64_t old_end_block, modification_map* old_block_info ) {
@@ -1062,6 +1175,7 @@ static int fs_entry_validate_remote_write( char const* fs_path, struct fs_entry*
 
 
 // Reversion all affected blocks from a remote write.
+// old_block_info keeps the first old version it sees for each block, so a batch of remote writes can be reverted as a whole.
 // fent must be write-locked
 static int fs_entry_reversion_blocks( struct fs_core* core, struct fs_entry* fent, uint64_t gateway_id, modification_map* old_block_info, Serialization::WriteMsg* write_msg ) {
    
@@ -1076,18 +1190,21 @@ static int fs_entry_reversion_blocks( struct fs_core* core, struct fs_entry* fen
       int64_t new_version = msg_binfo.block_version();
       unsigned char* block_hash = (unsigned char*)msg_binfo.hash().data();
 
-      // back up old version and gateway, in case we have to restore it
-      int64_t old_version = fent->manifest->get_block_version( block_id );
-      uint64_t old_gateway_id = fent->manifest->get_block_host( core, block_id );
-      unsigned char* old_block_hash = fent->manifest->hash_dup( block_id );
-      
-      struct fs_entry_block_info binfo;
-      memset( &binfo, 0, sizeof(struct fs_entry_block_info) );
-      
-      // remember the old block information, in case we need to revert it
-      fs_entry_block_info_garbage_init( &binfo, old_version, old_block_hash, BLOCK_HASH_LEN(), old_gateway_id );
-      
-      (*old_block_info)[ block_id ] = binfo;
+      if( old_block_info->find( block_id ) == old_block_info->end() ) {
+         
+         // back up old version and gateway, in case we have to restore it
+         int64_t old_version = fent->manifest->get_block_version( block_id );
+         uint64_t old_gateway_id = fent->manifest->get_block_host( core, block_id );
+         unsigned char* old_block_hash = fent->manifest->hash_dup( block_id );
+         
+         struct fs_entry_block_info binfo;
+         memset( &binfo, 0, sizeof(struct fs_entry_block_info) );
+         
+         // remember the old block information, in case we need to revert it
+         fs_entry_block_info_garbage_init( &binfo, old_version, old_block_hash, BLOCK_HASH_LEN(), old_gateway_id );
+         
+         (*old_block_info)[ block_id ] = binfo;
+      }
       
       // put the new version into the manifest
       fs_entry_manifest_put_block( core, gateway_id, fent, block_id, new_version, block_hash );
@@ -1096,73 +1213,66 @@ static int fs_entry_reversion_blocks( struct fs_core* core, struct fs_entry* fen
    return 0;
 }
 
-// get the list of affected blocks from a write message 
-static int fs_entry_list_write_message_blocks( Serialization::WriteMsg* write_msg, uint64_t** affected_blocks, size_t* num_affected_blocks ) {
-   
-   size_t ret_len = write_msg->blocks_size();
-   uint64_t* ret = SG_CALLOC( uint64_t, ret_len );
+// add the affected blocks from a write message to a set of block IDs
+static int fs_entry_list_write_message_blocks( Serialization::WriteMsg* write_msg, set<uint64_t>* affected_blocks ) {
    
    for( int i = 0; i < write_msg->blocks_size(); i++ ) {
       
       // get the block 
       const Serialization::BlockInfo& msg_binfo = write_msg->blocks(i);
       
-      // get block ID
-      uint64_t block_id = msg_binfo.block_id();
-      
-      ret[i] = block_id;
+      affected_blocks->insert( msg_binfo.block_id() );
    }
    
-   *affected_blocks = ret;
-   *num_affected_blocks = ret_len;
-   
    return 0;
 }
 
-// Handle a remote write.  The given write_msg must have been verified prior to calling this method.
-// A remote write is really a batch of one or more writes sent on fsync().  So, write_msg may encode sparse byte ranges
-// Zeroth, sanity check.
-// First, update the local manifest.
-// Second, synchronously replicate the manifest to all RGs.
-// Third, upload new metadata to the MS for this file.
-// Fourth, acknowledge the remote writer.
-int fs_entry_remote_write( struct fs_core* core, char const* fs_path, uint64_t file_id, int64_t file_version, uint64_t coordinator_id, Serialization::WriteMsg* write_msg ) {
+// Apply one or more remote writes to a file, and tell the MS about all of them at once.
+// Each write's result goes to its request's rc.  Writes that fail validation are skipped; the rest succeed or fail together.
+// return 0 if all valid writes were applied (or there were none), or the error that caused them all to fail
+// fent must be write-locked
+static int fs_entry_remote_write_locked( struct fs_core* core, char const* fs_path, struct fs_entry* fent, uint64_t parent_id, char const* parent_name, fs_entry_remote_write_batch_t* reqs ) {
    
-   uint64_t parent_id = 0;
-   char* parent_name = NULL;
    int err = 0;
-   
-   struct fs_entry* fent = fs_entry_resolve_path_and_parent_info( core, fs_path, write_msg->user_id(), write_msg->volume_id(), true, &err, &parent_id, &parent_name );
-   if( err != 0 || fent == NULL ) {
-      return err;
-   }
-   
-   err = fs_entry_validate_remote_write( fs_path, fent, file_id, file_version, coordinator_id, write_msg );
-   if( err != 0 ) {
-      SG_error("fs_entry_validate_remote_write( %s %" PRIX64 ".%" PRId64 " from %" PRIu64 " ) rc = %d\n", fs_path, fent->file_id, file_version, coordinator_id, err );
-      
-      fs_entry_unlock( fent );
-      free( parent_name );
-      return err;
-   }
+   size_t num_applied = 0;
    
    // snapshot the fent so we can garbage-collect the manifest 
    struct replica_snapshot fent_snapshot;
    fs_entry_replica_snapshot( core, fent, 0, 0, &fent_snapshot );
    
-   uint64_t gateway_id = write_msg->gateway_id();
-
    struct timespec ts, ts2, replicate_ts, garbage_collect_ts, update_ts;
    
    SG_BEGIN_TIMING_DATA( ts );
 
    modification_map old_block_info;
+   set<uint64_t> affected_block_set;
    
-   // reversion all affected blocks
-   fs_entry_reversion_blocks( core, fent, gateway_id, &old_block_info, write_msg );
+   for( fs_entry_remote_write_batch_t::iterator itr = reqs->begin(); itr != reqs->end(); itr++ ) {
+      
+      struct fs_entry_remote_write_req* req = *itr;
+      
+      req->rc = fs_entry_validate_remote_write( req->fs_path, fent, req->file_id, req->file_version, req->coordinator_id, req->write_msg );
+      if( req->rc != 0 ) {
+         SG_error("fs_entry_validate_remote_write( %s %" PRIX64 ".%" PRId64 " from %" PRIu64 " ) rc = %d\n", req->fs_path, fent->file_id, req->file_version, req->coordinator_id, req->rc );
+         continue;
+      }
+      
+      // reversion all affected blocks
+      fs_entry_reversion_blocks( core, fent, req->write_msg->gateway_id(), &old_block_info, req->write_msg );
+      
+      // update size
+      fent->size = req->write_msg->metadata().size();
+      
+      fs_entry_list_write_message_blocks( req->write_msg, &affected_block_set );
+      
+      num_applied++;
+   }
+   
+   if( num_applied == 0 ) {
+      return 0;
+   }
    
-   // update size
-   fent->size = write_msg->metadata().size();
+   SG_debug("apply %zu remote write(s) to %s %" PRIX64 "\n", num_applied, fs_path, fent->file_id );
 
    // update modtime
    fs_entry_update_modtime( fent );
@@ -1191,23 +1301,24 @@ int fs_entry_remote_write( struct fs_core* core, char const* fs_path, uint64_t f
       SG_BEGIN_TIMING_DATA( update_ts );
       
       // find the set of affected blocks
-      uint64_t* affected_blocks = NULL;
-      size_t num_affected_blocks = 0;
+      size_t num_affected_blocks = affected_block_set.size();
+      uint64_t* affected_blocks = SG_CALLOC( uint64_t, num_affected_blocks );
       
-      fs_entry_list_write_message_blocks( write_msg, &affected_blocks, &num_affected_blocks );
+      size_t i = 0;
+      for( set<uint64_t>::iterator itr = affected_block_set.begin(); itr != affected_block_set.end(); itr++ ) {
+         affected_blocks[i] = *itr;
+         i++;
+      }
       
       err = ms_client_update_write( core->ms, &fent->write_nonce, &data, affected_blocks, num_affected_blocks );
       
       if( err != 0 ) {
-         SG_error("%ms_client_update(%s) rc = %d\n", fs_path, err );
+         SG_error("ms_client_update_write(%s) rc = %d\n", fs_path, err );
          err = -EREMOTEIO;
       }
       
       // free memory
-      if( affected_blocks ) {
-         free( affected_blocks );
-         affected_blocks = NULL;
-      }
+      free( affected_blocks );
       md_entry_free( &data );      
       
       SG_END_TIMING_DATA( update_ts, ts2, "MS update" );
@@ -1240,17 +1351,208 @@ int fs_entry_remote_write( struct fs_core* core, char const* fs_path, uint64_t f
       }
    }
    if( err != 0 ) {
-      // something went wrong; revert the write
+      // something went wrong; revert the writes
       fs_entry_revert_write( core, fent, &fent_snapshot, fent->size, &old_block_info );
+      
+      for( fs_entry_remote_write_batch_t::iterator itr = reqs->begin(); itr != reqs->end(); itr++ ) {
+         
+         if( (*itr)->rc == 0 ) {
+            (*itr)->rc = err;
+         }
+      }
    }
    
-   fs_entry_unlock( fent );
-   
-   free( parent_name );
-   
    // free memory
    fs_entry_free_modification_map( &old_block_info );
    
    SG_END_TIMING_DATA( ts, ts2, "write, remote" );
    return err;
 }
+
+// set up a remote write request
+static void fs_entry_remote_write_req_init( struct fs_entry_remote_write_req* req, char const* fs_path, uint64_t file_id, int64_t file_version, uint64_t coordinator_id, Serialization::WriteMsg* write_msg ) {
+   
+   memset( req, 0, sizeof(struct fs_entry_remote_write_req) );
+   
+   req->fs_path = fs_path;
+   req->file_id = file_id;
+   req->file_version = file_version;
+   req->coordinator_id = coordinator_id;
+   req->write_msg = write_msg;
+   
+   sem_init( &req->sem, 0, 0 );
+}
+
+// Handle a remote write.  The given write_msg must have been verified prior to calling this method.
+// A remote write is really a batch of one or more writes sent on fsync().  So, write_msg may encode sparse byte ranges
+// Zeroth, sanity check.
+// First, update the local manifest.
+// Second, synchronously replicate the manifest to all RGs.
+// Third, upload new metadata to the MS for this file.
+// Fourth, acknowledge the remote writer.
+int fs_entry_remote_write( struct fs_core* core, char const* fs_path, uint64_t file_id, int64_t file_version, uint64_t coordinator_id, Serialization::WriteMsg* write_msg ) {
+   
+   uint64_t parent_id = 0;
+   char* parent_name = NULL;
+   int err = 0;
+   
+   struct fs_entry* fent = fs_entry_resolve_path_and_parent_info( core, fs_path, write_msg->user_id(), write_msg->volume_id(), true, &err, &parent_id, &parent_name );
+   if( err != 0 || fent == NULL ) {
+      return err;
+   }
+   
+   struct fs_entry_remote_write_req req;
+   fs_entry_remote_write_req_init( &req, fs_path, file_id, file_version, coordinator_id, write_msg );
+   
+   fs_entry_remote_write_batch_t reqs;
+   reqs.push_back( &req );
+   
+   fs_entry_remote_write_locked( core, fs_path, fent, parent_id, parent_name, &reqs );
+   
+   fs_entry_unlock( fent );
+   
+   free( parent_name );
+   sem_destroy( &req.sem );
+   
+   return req.rc;
+}
+
+// join or start a batch of remote writes to a file, and wait for it to be applied.
+// the caller must have counted this write in core->remote_writes_in_flight.
+static int fs_entry_remote_write_batch_apply( struct fs_core* core, char const* fs_path, uint64_t file_id, int64_t file_version, uint64_t coordinator_id, Serialization::WriteMsg* write_msg ) {
+   
+   struct fs_entry_remote_write_req req;
+   fs_entry_remote_write_req_init( &req, fs_path, file_id, file_version, coordinator_id, write_msg );
+   
+   pthread_mutex_lock( &core->remote_write_batches_lock );
+   
+   fs_entry_remote_write_batch_map_t::iterator itr = core->remote_write_batches->find( file_id );
+   if( itr != core->remote_write_batches->end() ) {
+      
+      fs_entry_remote_write_batch_t* batch = itr->second;
+      struct fs_entry_remote_write_req* leader = batch->at(0);
+      
+      // only join if the leader resolves the file as the same user
+      if( leader->write_msg->user_id() == write_msg->user_id() && leader->write_msg->volume_id() == write_msg->volume_id() ) {
+         
+         batch->push_back( &req );
+         
+         pthread_mutex_unlock( &core->remote_write_batches_lock );
+         
+         SG_debug("remote write to %s %" PRIX64 " from %" PRIu64 " joins batch of %" PRIu64 "\n", fs_path, file_id, write_msg->gateway_id(), leader->write_msg->gateway_id() );
+         
+         // wait for the leader to apply it
+         sem_wait( &req.sem );
+         sem_destroy( &req.sem );
+         
+         return req.rc;
+      }
+      else {
+         
+         // go it alone
+         pthread_mutex_unlock( &core->remote_write_batches_lock );
+         
+         sem_destroy( &req.sem );
+         
+         return fs_entry_remote_write( core, fs_path, file_id, file_version, coordinator_id, write_msg );
+      }
+   }
+   
+   // start a new batch
+   fs_entry_remote_write_batch_t* batch = new fs_entry_remote_write_batch_t();
+   batch->push_back( &req );
+   
+   (*core->remote_write_batches)[ file_id ] = batch;
+   
+   // only wait for other writers if there are any (i.e. an earlier batch is still being applied)
+   bool others = ((*core->remote_writes_in_flight)[ file_id ] > 1);
+   
+   pthread_mutex_unlock( &core->remote_write_batches_lock );
+   
+   // give concurrent writers a chance to join
+   if( others && core->conf->remote_write_batch_window_ms > 0 ) {
+      
+      struct timespec window_ts;
+      window_ts.tv_sec = core->conf->remote_write_batch_window_ms / 1000;
+      window_ts.tv_nsec = (core->conf->remote_write_batch_window_ms % 1000) * 1000000;
+      
+      nanosleep( &window_ts, NULL );
+   }
+   
+   uint64_t parent_id = 0;
+   char* parent_name = NULL;
+   int err = 0;
+   
+   // writers keep joining until we have the file to ourselves
+   struct fs_entry* fent = fs_entry_resolve_path_and_parent_info( core, fs_path, write_msg->user_id(), write_msg->volume_id(), true, &err, &parent_id, &parent_name );
+   
+   // close the batch; later writers start the next one
+   pthread_mutex_lock( &core->remote_write_batches_lock );
+   
+   core->remote_write_batches->erase( file_id );
+   
+   pthread_mutex_unlock( &core->remote_write_batches_lock );
+   
+   if( err != 0 || fent == NULL ) {
+      
+      if( err == 0 ) {
+         err = -ENOENT;
+      }
+      
+      for( fs_entry_remote_write_batch_t::iterator itr = batch->begin(); itr != batch->end(); itr++ ) {
+         (*itr)->rc = err;
+      }
+   }
+   else {
+      
+      if( batch->size() > 1 ) {
+         SG_debug("apply a batch of %zu remote writes to %s %" PRIX64 "\n", batch->size(), fs_path, file_id );
+      }
+      
+      fs_entry_remote_write_locked( core, fs_path, fent, parent_id, parent_name, batch );
+      
+      fs_entry_unlock( fent );
+      free( parent_name );
+   }
+   
+   // wake up everyone else (but not ourselves)
+   for( size_t i = 1; i < batch->size(); i++ ) {
+      sem_post( &(batch->at(i)->sem) );
+   }
+   
+   delete batch;
+   sem_destroy( &req.sem );
+   
+   return req.rc;
+}
+
+// Handle a remote write, applying it together with any other remote writes to the same file that arrive while we wait
+// for the batch window to pass and for the file to become free.  The whole batch costs one manifest replication and one MS update.
+// The first writer to arrive applies the batch on behalf of the rest, and wakes them up with their results.
+// The batch window only applies when other writes to the file are in flight; a lone write is applied right away.
+// The given write_msg must have been verified prior to calling this method.
+int fs_entry_remote_write_batched( struct fs_core* core, char const* fs_path, uint64_t file_id, int64_t file_version, uint64_t coordinator_id, Serialization::WriteMsg* write_msg ) {
+   
+   pthread_mutex_lock( &core->remote_write_batches_lock );
+   
+   (*core->remote_writes_in_flight)[ file_id ]++;
+   
+   pthread_mutex_unlock( &core->remote_write_batches_lock );
+   
+   int rc = fs_entry_remote_write_batch_apply( core, fs_path, file_id, file_version, coordinator_id, write_msg );
+   
+   pthread_mutex_lock( &core->remote_write_batches_lock );
+   
+   map<uint64_t, int>::iterator itr = core->remote_writes_in_flight->find( file_id );
+   if( itr != core->remote_writes_in_flight->end() ) {
+      
+      itr->second--;
+      if( itr->second <= 0 ) {
+         core->remote_writes_in_flight->erase( itr );
+      }
+   }
+   
+   pthread_mutex_unlock( &core->remote_write_batches_lock );
+   
+   return rc;
+}
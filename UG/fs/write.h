@@ -66,12 +66,25 @@ struct fs_entry_write_vec {
    bool has_tail;
 };
 
+// a remote write waiting to be applied to a file, along with others sent to it at about the same time
+struct fs_entry_remote_write_req {
+   char const* fs_path;
+   uint64_t file_id;
+   int64_t file_version;
+   uint64_t coordinator_id;
+   Serialization::WriteMsg* write_msg;
+   
+   int rc;                      // result of applying this write
+   sem_t sem;                   // posted once rc is set
+};
+
 ssize_t fs_entry_write( struct fs_core* core, struct fs_file_handle* fh, char const* buf, size_t count, off_t offset );
 
 struct md_cache_block_future* fs_entry_write_block_async( struct fs_core* core, char const* fs_path, struct fs_entry* fent, uint64_t block_id, char const* block, size_t block_len,
                                                           struct fs_entry_block_info* binfo_old, struct fs_entry_block_info* binfo_new, int* ret );
 
 int fs_entry_read_partial_blocks( struct fs_core* core, struct fs_file_handle* fh, char const* fs_path, struct fs_entry* fent, struct fs_entry_read_context* read_ctx );
+int fs_entry_fill_sparse_bufferred_blocks( struct fs_core* core, char const* fs_path, struct fs_entry* fent, uint64_t start_block_id, uint64_t end_block_id );
 
 int fs_entry_put_write_holes( struct fs_core* core, struct fs_entry* fent, off_t offset );
 
@@ -83,5 +96,6 @@ int fs_entry_cache_evict_blocks_async( struct fs_core* core, struct fs_entry* fe
 int fs_entry_update_bufferred_block_write( struct fs_core, struct fs_entry* fent, uint64_t block_id, char* block, size_t block_len );
 
 int fs_entry_remote_write( struct fs_core* core, char const* fs_path, uint64_t file_id, int64_t file_version, uint64_t coordinator_id, Serialization::WriteMsg* write_msg );
+int fs_entry_remote_write_batched( struct fs_core* core, char const* fs_path, uint64_t file_id, int64_t file_version, uint64_t coordinator_id, Serialization::WriteMsg* write_msg );
 
 #endif
\ No newline at end of file
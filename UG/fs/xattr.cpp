@@ -345,36 +345,127 @@ int fs_entry_download_xattr( struct fs_core* core, uint64_t volume, uint64_t fil
 }
 
 
-// cache an xattr.
-static int fs_entry_cache_xattr( struct fs_core* core, char const* fs_path, uint64_t user, uint64_t volume, char const* name, char const* value, size_t value_len, int64_t cur_xattr_nonce ) {
-   // write-lock so we can modify
+// download all of a file's xattrs that we can read, in one request.
+// return 0 on success, and set *ret_xattrs to a new xattr cache and *ret_xattr_nonce to the MS's xattr nonce for the file
+// return -ENOENT if there is no such file 
+// return -ENOMEM if OOM
+// return negative on MS error
+int fs_entry_download_all_xattrs( struct fs_core* core, uint64_t volume, uint64_t file_id, xattr_cache_t** ret_xattrs, int64_t* ret_xattr_nonce ) {
+   
+   char** names = NULL;
+   char** values = NULL;
+   size_t* value_lens = NULL;
+   int64_t xattr_nonce = 0;
+   xattr_cache_t* xattrs = NULL;
+   
+   int rc = ms_client_getallxattrs( core->ms, volume, file_id, &xattr_nonce, &names, &values, &value_lens );
+   if( rc != 0 ) {
+      SG_error("ms_client_getallxattrs( %" PRIX64 " ) rc = %d\n", file_id, rc );
+      
+      if( rc == -404 ) {
+         // no such file 
+         rc = -ENOENT;
+      }
+      
+      return rc;
+   }
+   
+   xattrs = SG_safe_new( xattr_cache_t() );
+   if( xattrs == NULL ) {
+      
+      ms_client_xattrs_free( names, values, value_lens );
+      return -ENOMEM;
+   }
+   
+   try {
+      for( int i = 0; names[i] != NULL; i++ ) {
+         (*xattrs)[ string(names[i]) ] = string( values[i], value_lens[i] );
+      }
+   }
+   catch( bad_alloc& ba ) {
+      
+      ms_client_xattrs_free( names, values, value_lens );
+      delete xattrs;
+      return -ENOMEM;
+   }
+   
+   ms_client_xattrs_free( names, values, value_lens );
+   
+   *ret_xattrs = xattrs;
+   *ret_xattr_nonce = xattr_nonce;
+   
+   return 0;
+}
+
+
+// look up an xattr in a downloaded set of xattrs 
+// return 0 on success, and set *value (malloc'ed) and *value_len 
+// return -ENOATTR if it's not in the set 
+// return -ENOMEM if OOM
+static int fs_entry_find_xattr( xattr_cache_t* xattrs, char const* name, char** value, size_t* value_len ) {
+   
+   xattr_cache_t::iterator itr = xattrs->find( string(name) );
+   if( itr == xattrs->end() ) {
+      return -ENOATTR;
+   }
+   
+   char* val = SG_CALLOC( char, itr->second.size() + 1 );
+   if( val == NULL ) {
+      return -ENOMEM;
+   }
+   
+   memcpy( val, itr->second.data(), itr->second.size() );
+   
+   *value = val;
+   *value_len = itr->second.size();
+   
+   return 0;
+}
+
+
+// cache a downloaded set of xattrs in the fent at fs_path, if the set is as fresh as the fent (i.e. the MS's xattr nonce matches ours).
+// always consumes xattrs
+static int fs_entry_cache_all_xattrs( struct fs_core* core, char const* fs_path, uint64_t user, uint64_t volume, xattr_cache_t* xattrs, int64_t xattr_nonce ) {
+   // xattr_lock guards the cache, so a read lock will do
    int err = 0;
-   struct fs_entry* fent = fs_entry_resolve_path( core, fs_path, user, volume, true, &err );
+   struct fs_entry* fent = fs_entry_resolve_path( core, fs_path, user, volume, false, &err );
    if( !fent || err ) {
       if( !err )
          err = -ENOMEM;
-
+      
+      delete xattrs;
       return err;
    }
-
-   fs_entry_put_cached_xattr( fent, name, value, value_len, cur_xattr_nonce );
+   
+   err = fs_entry_cache_xattr_list( fent, xattrs, xattr_nonce );
    
    fs_entry_unlock( fent );
    
-   return 0;
+   if( err != 0 ) {
+      // stale
+      delete xattrs;
+   }
+   
+   return err;
 }
 
 
 // get the xattr, given a locked fs_entry.
 // unlock the fent as soon as possible
-// check the cache, and then check the MS
-ssize_t fs_entry_do_getxattr( struct fs_core* core, struct fs_entry* fent, char const* name, char** value, size_t* value_len, int* _cache_status, bool unlock_before_download ) {
+// check the cache, and then check the MS.  On a cache miss, download all of the file's xattrs at once (so the next getxattr on this file hits the cache),
+// unless we already know the cache holds them all (in which case the xattr does not exist).
+// if we downloaded the xattrs, hand them back via *downloaded_xattrs and *downloaded_xattr_nonce so the caller can cache them.
+static ssize_t fs_entry_do_getxattr_ex( struct fs_core* core, struct fs_entry* fent, char const* name, char** value, size_t* value_len, int* _cache_status, bool unlock_before_download,
+                                        xattr_cache_t** downloaded_xattrs, int64_t* downloaded_xattr_nonce ) {
    // check the cache
    ssize_t ret = 0;
    char* val = NULL;
    size_t vallen = 0;
+   xattr_cache_t* xattrs = NULL;
+   int64_t xattr_nonce = 0;
    
    int cache_status = fs_entry_get_cached_xattr( fent, name, &val, &vallen );
+   bool have_all = (cache_status < 0 && fs_entry_has_all_cached_xattrs( fent, fent->xattr_nonce ));
    
    uint64_t file_id = fent->file_id;
    uint64_t volume = fent->volume;
@@ -384,14 +475,28 @@ ssize_t fs_entry_do_getxattr( struct fs_core* core, struct fs_entry* fent, char
       fs_entry_unlock( fent );
    }
    
-   if( cache_status < 0 ) {
-      // cache miss 
-      ret = (ssize_t)fs_entry_download_xattr( core, volume, file_id, name, &val );
-   }
-   else {
+   if( cache_status == 0 ) {
       // cache hit
       ret = vallen;
    }
+   else if( have_all ) {
+      // we have every xattr, and this isn't one of them 
+      ret = -ENOATTR;
+   }
+   else {
+      // cache miss 
+      ret = (ssize_t)fs_entry_download_all_xattrs( core, volume, file_id, &xattrs, &xattr_nonce );
+      if( ret == 0 ) {
+         
+         ret = fs_entry_find_xattr( xattrs, name, &val, &vallen );
+         if( ret == 0 ) {
+            ret = vallen;
+         }
+         
+         *downloaded_xattrs = xattrs;
+         *downloaded_xattr_nonce = xattr_nonce;
+      }
+   }
    
    if( ret >= 0 ) {
       // success!
@@ -404,8 +509,31 @@ ssize_t fs_entry_do_getxattr( struct fs_core* core, struct fs_entry* fent, char
 }
 
 
-static ssize_t fs_entry_do_getxattr_and_unlock( struct fs_core* core, struct fs_entry* fent, char const* name, char** value, size_t* value_len, int* _cache_status ) {
-   return fs_entry_do_getxattr( core, fent, name, value, value_len, _cache_status, true );
+// get the xattr, given a locked fs_entry.
+// unlock the fent before downloading, if unlock_before_download is true (otherwise, cache what we download in fent).
+// check the cache, and then check the MS
+ssize_t fs_entry_do_getxattr( struct fs_core* core, struct fs_entry* fent, char const* name, char** value, size_t* value_len, int* _cache_status, bool unlock_before_download ) {
+   
+   xattr_cache_t* xattrs = NULL;
+   int64_t xattr_nonce = 0;
+   
+   ssize_t ret = fs_entry_do_getxattr_ex( core, fent, name, value, value_len, _cache_status, unlock_before_download, &xattrs, &xattr_nonce );
+   
+   if( xattrs != NULL ) {
+      
+      if( !unlock_before_download && fs_entry_cache_xattr_list( fent, xattrs, xattr_nonce ) == 0 ) {
+         
+         // cached
+         if( ret >= 0 ) {
+            *_cache_status = 0;
+         }
+      }
+      else {
+         delete xattrs;
+      }
+   }
+   
+   return ret;
 }
 
 
@@ -428,19 +556,28 @@ ssize_t fs_entry_getxattr( struct fs_core* core, char const* path, char const *n
       return err;
    }
    
-   int64_t cur_xattr_nonce = fent->xattr_nonce;
-   
    ssize_t ret = 0;
    char* val = NULL;
    size_t vallen = 0;
    int cache_status = 0;
+   xattr_cache_t* xattrs = NULL;
+   int64_t xattr_nonce = 0;
    
    // find the xattr handler for this attribute
    struct syndicate_xattr_handler* xattr_handler = xattr_lookup_handler( name );
    if( xattr_handler == NULL ) {
       
       // NOTE: this unlocks fent
-      ret = fs_entry_do_getxattr_and_unlock( core, fent, name, &val, &vallen, &cache_status );
+      ret = fs_entry_do_getxattr_ex( core, fent, name, &val, &vallen, &cache_status, true, &xattrs, &xattr_nonce );
+      
+      if( xattrs != NULL ) {
+         
+         // cache all of the file's xattrs, so we don't ask for them again
+         err = fs_entry_cache_all_xattrs( core, path, user, volume, xattrs, xattr_nonce );
+         if( err != 0 ) {
+            SG_debug("fs_entry_cache_all_xattrs(%s) rc = %d\n", path, err );
+         }
+      }
       
       if( ret >= 0 ) {
          // success!
@@ -450,18 +587,6 @@ ssize_t fs_entry_getxattr( struct fs_core* core, char const* path, char const *n
                ret = -ERANGE;
             }
             else {
-               // cache this?
-               if( cache_status < 0 ) {
-                  
-                  // not cached...
-                  err = fs_entry_cache_xattr( core, path, user, volume, name, val, ret, cur_xattr_nonce );
-                  if( err < 0 ) {
-                     SG_error("fs_entry_cache_xattr(%s, %s) rc = %d\n", path, name, err );
-                     free( val );
-                     return err;
-                  }
-               }
-               
                memcpy( value, val, vallen );
                ret = vallen;
             }
@@ -645,19 +770,54 @@ ssize_t fs_entry_listxattr( struct fs_core* core, char const* path, char *list,
    // copy these values, so we can unlock fent
    uint64_t file_id = fent->file_id;
    uint64_t volume_id = fent->volume;
-   
-   fs_entry_unlock( fent );
+   int64_t cur_xattr_nonce = fent->xattr_nonce;
    
    char* remote_xattr_names = NULL;
    size_t remote_xattr_names_len = 0;
-
-   // get data from the MS
-   int remote_rc = ms_client_listxattr( core->ms, volume_id, file_id, &remote_xattr_names, &remote_xattr_names_len );
+   int remote_rc = -ENODATA;
+   
+   // do we have them all cached?
+   if( fs_entry_has_all_cached_xattrs( fent, cur_xattr_nonce ) ) {
+      remote_rc = fs_entry_list_cached_xattrs( fent, &remote_xattr_names, &remote_xattr_names_len, cur_xattr_nonce );
+   }
+   
+   fs_entry_unlock( fent );
    
    if( remote_rc != 0 ) {
-      SG_error("ms_client_listxattr(%s %" PRIX64 ") rc = %d\n", path, file_id, remote_rc );
       
-      return (ssize_t)remote_rc;
+      // get them all from the MS, and cache them for subsequent getxattr calls
+      xattr_cache_t* xattrs = NULL;
+      int64_t xattr_nonce = 0;
+      
+      remote_rc = fs_entry_download_all_xattrs( core, volume_id, file_id, &xattrs, &xattr_nonce );
+      if( remote_rc != 0 ) {
+         SG_error("fs_entry_download_all_xattrs(%s %" PRIX64 ") rc = %d\n", path, file_id, remote_rc );
+         
+         return (ssize_t)remote_rc;
+      }
+      
+      for( xattr_cache_t::iterator itr = xattrs->begin(); itr != xattrs->end(); itr++ ) {
+         remote_xattr_names_len += itr->first.size() + 1;
+      }
+      
+      remote_xattr_names = SG_CALLOC( char, remote_xattr_names_len + 1 );
+      if( remote_xattr_names == NULL ) {
+         
+         delete xattrs;
+         return -ENOMEM;
+      }
+      
+      off_t offset = 0;
+      for( xattr_cache_t::iterator itr = xattrs->begin(); itr != xattrs->end(); itr++ ) {
+         
+         strcpy( remote_xattr_names + offset, itr->first.c_str() );
+         offset += itr->first.size() + 1;
+      }
+      
+      int cache_rc = fs_entry_cache_all_xattrs( core, path, user, volume, xattrs, xattr_nonce );
+      if( cache_rc != 0 ) {
+         SG_debug("fs_entry_cache_all_xattrs(%s) rc = %d\n", path, cache_rc );
+      }
    }
    
    ssize_t rc = 0;
@@ -71,6 +71,7 @@ int fs_entry_chmodxattr( struct fs_core* core, char const* path, char const* nam
 
 ssize_t fs_entry_do_getxattr( struct fs_core* core, struct fs_entry* fent, char const* name, char** value, size_t* value_len, int* _cache_status, bool unlock_before_download );
 int fs_entry_download_xattr( struct fs_core* core, uint64_t volume, uint64_t file_id, char const* name, char** value );
+int fs_entry_download_all_xattrs( struct fs_core* core, uint64_t volume, uint64_t file_id, xattr_cache_t** ret_xattrs, int64_t* ret_xattr_nonce );
 int fs_entry_get_or_set_xattr( struct fs_core* core, struct fs_entry* fent, char const* name, char const* proposed_value, size_t proposed_value_len, char** value, size_t* value_len, mode_t mode );
 
 #endif
@@ -1879,8 +1879,15 @@ int fs_entry_replica_wait_all( struct fs_core* core, replica_list_t* rctxs, uint
       tsp = &ts;
    }
    
+   struct md_trace_span span;
+   md_trace_begin( &span, "replica_wait", rctxs->size() );
+   core->state->stats->enter( STAT_REPLICATE );
+   
    int rc = fs_entry_replica_wait_and_free( &core->state->replication, rctxs, tsp );
    
+   core->state->stats->leave( STAT_REPLICATE, rc );
+   md_trace_end( &span );
+   
    return rc;
 }
 
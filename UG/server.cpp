@@ -132,6 +132,26 @@ struct md_HTTP_response* SG_server_HTTP_GET_handler( struct md_HTTP_connection_d
    // what is this a request for?
    // a block?
    if( reqdat.block_id != SG_INVALID_BLOCK_ID ) {
+      
+      // if it's in the on-disk cache (and the driver won't transform it on read), send it from there (MHD closes block_fd)
+      off_t block_len = 0;
+      int block_fd = fs_entry_open_block_local( state->core, reqdat.fs_path, reqdat.block_id, &block_len );
+      if( block_fd >= 0 ) {
+         
+         rc = md_create_HTTP_response_fd( resp, "application/octet-stream", 200, block_fd, 0, block_len );
+         if( rc == 0 ) {
+            http_make_default_headers( resp, sb.st_mtime, block_len, true );
+            
+            SG_debug( "served %jd bytes from the cache for %s.%" PRId64 "/%" PRIu64 ".%" PRId64 "\n", (intmax_t)block_len, reqdat.fs_path, reqdat.file_version, reqdat.block_id, reqdat.block_version );
+            
+            md_gateway_request_data_free( &reqdat );
+            return resp;
+         }
+         
+         SG_error( "md_create_HTTP_response_fd(%s.%" PRId64 "/%" PRIu64 ".%" PRId64 ") rc = %d\n", reqdat.fs_path, reqdat.file_version, reqdat.block_id, reqdat.block_version, rc );
+         close( block_fd );
+      }
+      
       // serve back the block
       char* block = SG_CALLOC( char, state->core->blocking_factor );
       
@@ -520,8 +540,8 @@ void SG_server_HTTP_POST_finish( struct md_HTTP_connection_data* md_con_data ) {
          }
          
          else {
-            // update this file's manifest (republishing it in the process)
-            rc = fs_entry_remote_write( state->core, fs_path, file_id, file_version, coordinator_id, msg );
+            // update this file's manifest (republishing it in the process), along with any other concurrent writes to it
+            rc = fs_entry_remote_write_batched( state->core, fs_path, file_id, file_version, coordinator_id, msg );
             if( rc == 0 ) {
                // create an ACCEPTED request--ask the remote writer to hold on to the blocks so we can collate them later
                syndicate_make_accepted_msg( &ack );
@@ -49,112 +49,309 @@ const char* stat_names[] = {
    "syndicatefs_access         ",
    "syndicatefs_create         ",
    "syndicatefs_ftruncate      ",
-   "syndicatefs_fgetattr       "
+   "syndicatefs_fgetattr       ",
+   "revalidate                 ",
+   "manifest_fetch             ",
+   "block_download             ",
+   "cache_write                ",
+   "replicate                  "
 };
 
-
 inline uint64_t time_microseconds() {
    timespec ts;
-   clock_gettime( CLOCK_REALTIME, &ts );
+   clock_gettime( CLOCK_MONOTONIC, &ts );
    return (uint64_t)ts.tv_sec * 1000000LL + (uint64_t)ts.tv_nsec / 1000LL;  
 }
 
 
-void enter_func_active( uint64_t* begin_times, int type ) {
-   begin_times[type] = time_microseconds();
-}
-
-void enter_func_inactive( uint64_t* begin_times, int type ) {
-   return;
+// which histogram bucket holds a latency
+int stats_histogram_bucket( uint64_t value ) {
+   
+   if( value < STATS_HISTOGRAM_SUB_BUCKETS ) {
+      return (int)value;
+   }
+   
+   int msb = 63 - __builtin_clzll( value );
+   int shift = msb - STATS_HISTOGRAM_SUB_BUCKET_BITS;
+   
+   int bucket = (shift + 1) * STATS_HISTOGRAM_SUB_BUCKETS + (int)((value >> shift) & (STATS_HISTOGRAM_SUB_BUCKETS - 1));
+   
+   return MIN( bucket, STATS_HISTOGRAM_NUM_BUCKETS - 1 );
 }
 
-void leave_func_active( uint64_t* counts, uint64_t* elapsed, uint64_t* errors, uint64_t* begins, int type, int rc ) {
-   ++ counts[type];
-   if( rc != 0 )
-      ++ errors[type];
-   else
-      elapsed[type] = time_microseconds() - begins[type];
+// the range of latencies a bucket holds: [*lo, *hi)
+void stats_histogram_bucket_range( int bucket, uint64_t* lo, uint64_t* hi ) {
+   
+   if( bucket < STATS_HISTOGRAM_SUB_BUCKETS ) {
+      *lo = bucket;
+      *hi = bucket + 1;
+      return;
+   }
+   
+   int shift = bucket / STATS_HISTOGRAM_SUB_BUCKETS - 1;
+   uint64_t sub = bucket % STATS_HISTOGRAM_SUB_BUCKETS;
+   
+   *lo = (STATS_HISTOGRAM_SUB_BUCKETS + sub) << shift;
+   *hi = (STATS_HISTOGRAM_SUB_BUCKETS + sub + 1) << shift;
 }
 
-void leave_func_inactive( uint64_t* counts, uint64_t* elapsed, uint64_t* errors, uint64_t* begins, int type, int rc ) {
-   return;
+// get the latency below which the given percentile (0.0 to 100.0) of a histogram's calls fall.
+// returns the midpoint of the bucket that holds it, or 0 if the histogram is empty.
+uint64_t stats_histogram_percentile( struct stats_histogram* hist, double percentile ) {
+   
+   if( hist->count == 0 ) {
+      return 0;
+   }
+   
+   uint64_t rank = (uint64_t)((percentile / 100.0) * (double)hist->count + 0.5);
+   uint64_t seen = 0;
+   
+   rank = MAX( rank, 1 );
+   
+   for( int i = 0; i < STATS_HISTOGRAM_NUM_BUCKETS; i++ ) {
+      
+      seen += hist->buckets[i];
+      
+      if( seen >= rank ) {
+         
+         uint64_t lo = 0, hi = 0;
+         stats_histogram_bucket_range( i, &lo, &hi );
+         
+         return MIN( lo + (hi - lo) / 2, hist->max );
+      }
+   }
+   
+   return hist->max;
 }
 
 
 Stats::Stats( char* op ) {
    if( op ) {
-      this->output_path = (char*)calloc( strlen( op ), 1 );
-      strcpy( this->output_path, op );
+      this->output_path = strdup( op );
    }
    else {
       this->output_path = NULL;
    }
    
-   memset( this->call_counts, 0, sizeof(uint64_t) * STAT_NUM_TYPES );
-   memset( this->elapsed_time, 0, sizeof(uint64_t) * STAT_NUM_TYPES );
-   memset( this->begin_call_times, 0, sizeof(uint64_t) * STAT_NUM_TYPES );
-   memset( this->call_errors, 0, sizeof(uint64_t) * STAT_NUM_TYPES );
+   this->threads = new stats_thread_list_t();
+   this->retired = SG_CALLOC( struct stats_histogram, STAT_NUM_TYPES );
+   
+   pthread_mutex_init( &this->threads_lock, NULL );
+   pthread_key_create( &this->thread_key, Stats::retire_thread );
    
    this->gather_stats = true;
-   this->enter_func = enter_func_active;
-   this->leave_func = leave_func_active;
 }
 
 Stats::~Stats() {
    if( this->output_path )
       free( this->output_path );
+   
+   // no more retirements
+   pthread_key_delete( this->thread_key );
+   
+   for( unsigned int i = 0; i < this->threads->size(); i++ ) {
+      free( this->threads->at(i) );
+   }
+   
+   delete this->threads;
+   free( this->retired );
+   pthread_mutex_destroy( &this->threads_lock );
 }
 
 
-
-
 void Stats::use_conf( struct md_syndicate_conf* conf ) {
    this->gather_stats = conf->gather_stats;
-   if( this->gather_stats ) {
-      this->enter_func = enter_func_active;
-      this->leave_func = leave_func_active;
+   
+   if( conf->stats_path != NULL ) {
+      
+      if( this->output_path )
+         free( this->output_path );
+      
+      this->output_path = strdup( conf->stats_path );
    }
-   else {
-      this->enter_func = enter_func_inactive;
-      this->leave_func = leave_func_inactive;
+}
+
+
+// get the calling thread's statistics, registering them on its first call
+// return NULL if out of memory
+struct stats_thread* Stats::get_thread() {
+   
+   struct stats_thread* st = (struct stats_thread*)pthread_getspecific( this->thread_key );
+   if( st != NULL ) {
+      return st;
+   }
+   
+   st = SG_CALLOC( struct stats_thread, 1 );
+   if( st == NULL || this->retired == NULL ) {
+      free( st );
+      return NULL;
+   }
+   
+   st->owner = this;
+   
+   pthread_mutex_lock( &this->threads_lock );
+   
+   try {
+      this->threads->push_back( st );
    }
+   catch( bad_alloc& ba ) {
+      
+      pthread_mutex_unlock( &this->threads_lock );
+      free( st );
+      return NULL;
+   }
+   
+   pthread_mutex_unlock( &this->threads_lock );
+   
+   pthread_setspecific( this->thread_key, st );
+   
+   return st;
+}
+
+
+static void stats_histogram_add( struct stats_histogram* dest, struct stats_histogram* src ) {
+   
+   for( int j = 0; j < STATS_HISTOGRAM_NUM_BUCKETS; j++ ) {
+      dest->buckets[j] += src->buckets[j];
+   }
+   
+   dest->count += src->count;
+   dest->errors += src->errors;
+   dest->total += src->total;
+   dest->max = MAX( dest->max, src->max );
+}
+
+
+// fold an exiting thread's statistics into the retired totals (called by pthreads)
+void Stats::retire_thread( void* arg ) {
+   
+   struct stats_thread* st = (struct stats_thread*)arg;
+   Stats* stats = st->owner;
+   
+   pthread_mutex_lock( &stats->threads_lock );
+   
+   for( stats_thread_list_t::iterator itr = stats->threads->begin(); itr != stats->threads->end(); itr++ ) {
+      
+      if( *itr == st ) {
+         stats->threads->erase( itr );
+         break;
+      }
+   }
+   
+   for( int i = 0; i < STAT_NUM_TYPES; i++ ) {
+      stats_histogram_add( &stats->retired[i], &st->histograms[i] );
+   }
+   
+   pthread_mutex_unlock( &stats->threads_lock );
+   
+   free( st );
 }
 
 
 void Stats::enter( int stat_type ) {
-   (*this->enter_func)( this->begin_call_times, stat_type );
+   if( !this->gather_stats )
+      return;
+   
+   struct stats_thread* st = this->get_thread();
+   if( st == NULL )
+      return;
+   
+   st->begin_call_times[stat_type] = time_microseconds();
 }
 
 void Stats::leave( int stat_type, int rc ) {
-   (*this->leave_func) (this->call_counts, this->elapsed_time, this->call_errors, this->begin_call_times, stat_type, rc );
+   if( !this->gather_stats )
+      return;
+   
+   struct stats_thread* st = this->get_thread();
+   if( st == NULL )
+      return;
+   
+   struct stats_histogram* hist = &st->histograms[stat_type];
+   
+   if( rc != 0 ) {
+      hist->errors++;
+      return;
+   }
+   
+   uint64_t elapsed = time_microseconds() - st->begin_call_times[stat_type];
+   
+   hist->buckets[ stats_histogram_bucket( elapsed ) ]++;
+   hist->count++;
+   hist->total += elapsed;
+   
+   if( elapsed > hist->max )
+      hist->max = elapsed;
 }
 
+
+// merge all threads' histograms for a call into merged
+void Stats::merge( int stat_type, struct stats_histogram* merged ) {
+   
+   memset( merged, 0, sizeof(struct stats_histogram) );
+   
+   pthread_mutex_lock( &this->threads_lock );
+   
+   if( this->retired != NULL ) {
+      stats_histogram_add( merged, &this->retired[stat_type] );
+   }
+   
+   for( unsigned int i = 0; i < this->threads->size(); i++ ) {
+      stats_histogram_add( merged, &this->threads->at(i)->histograms[stat_type] );
+   }
+   
+   pthread_mutex_unlock( &this->threads_lock );
+}
+
+
 string Stats::dump() {
    if( this->gather_stats ) {
       
+      struct stats_histogram* merged = SG_CALLOC( struct stats_histogram, STAT_NUM_TYPES );
+      if( merged == NULL ) {
+         return string("Out of memory\n");
+      }
+      
+      for( int i = 1; i < STAT_NUM_TYPES; i++ ) {
+         this->merge( i, &merged[i] );
+      }
+      
       string ret = "Number of calls:\n";
       
-      char buf[100];
+      char buf[200];
       for( int i = 1; i < STAT_NUM_TYPES; i++ ) {
-         memset( buf, 0, 100 );
-         sprintf(buf, "%" PRIu64, this->call_counts[i] );
+         memset( buf, 0, 200 );
+         sprintf(buf, "%" PRIu64, merged[i].count + merged[i].errors );
          ret += string("    ") + string( stat_names[i] ) + string( buf ) + string("\n");
       }
       
       ret += "\nTime in each successful call (microseconds):\n";
       
       for( int i = 1; i < STAT_NUM_TYPES; i++ ) {
-         memset( buf, 0, 100 );
-         sprintf(buf, "%" PRIu64, this->elapsed_time[i] );
+         memset( buf, 0, 200 );
+         sprintf(buf, "%" PRIu64, merged[i].total );
          ret += string("    ") + string( stat_names[i] ) + string( buf ) + string("\n");
       }
       
       ret += "\nAverage time per successful call (microseconds):\n";
       
       for( int i = 1; i < STAT_NUM_TYPES; i++ ) {
-         memset( buf, 0, 100 );
-         if( this->call_counts[i] != 0 && this->call_errors[i] < this->call_counts[i] )
-            sprintf(buf, "%lf", (double)this->elapsed_time[i] / ((double)this->call_counts[i] - (double)this->call_errors[i]) );
+         memset( buf, 0, 200 );
+         if( merged[i].count != 0 )
+            sprintf(buf, "%lf", (double)merged[i].total / (double)merged[i].count );
+         else
+            sprintf(buf, "n/a");
+         
+         ret += string("    ") + string( stat_names[i] ) + string( buf ) + string("\n");
+      }
+      
+      ret += "\nLatency of successful calls (microseconds): p50 p99 p999 max\n";
+      
+      for( int i = 1; i < STAT_NUM_TYPES; i++ ) {
+         memset( buf, 0, 200 );
+         if( merged[i].count != 0 )
+            sprintf(buf, "%" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64,
+                    stats_histogram_percentile( &merged[i], 50.0 ), stats_histogram_percentile( &merged[i], 99.0 ), stats_histogram_percentile( &merged[i], 99.9 ), merged[i].max );
          else
             sprintf(buf, "n/a");
          
@@ -164,15 +361,66 @@ string Stats::dump() {
       ret += "\nNumber of errors:\n";
       
       for( int i = 1; i < STAT_NUM_TYPES; i++ ) {
-         memset( buf, 0, 100 );
-         sprintf(buf, "%" PRId64, this->call_errors[i]);
+         memset( buf, 0, 200 );
+         sprintf(buf, "%" PRIu64, merged[i].errors);
          
          ret += string("   ") + string( stat_names[i] ) + string( buf ) + string("\n");
       }
       
+      free( merged );
+      
       return ret;
    }
    else {
       return string("Statistic gathering is disabled in the configuration\n");
    }
 }
+
+
+// write the results to the output path, if there is one.
+// the file is replaced atomically, so readers never see a partial dump.
+// return 0 on success (or if there is no output path)
+// return -errno on failure
+int Stats::dump_to_file() {
+   
+   if( this->output_path == NULL ) {
+      return 0;
+   }
+   
+   string stats_str = this->dump();
+   
+   char* tmp_path = SG_CALLOC( char, strlen(this->output_path) + 50 );
+   if( tmp_path == NULL ) {
+      return -ENOMEM;
+   }
+   
+   sprintf( tmp_path, "%s.%d", this->output_path, getpid() );
+   
+   FILE* f = fopen( tmp_path, "w" );
+   if( f == NULL ) {
+      int errsv = -errno;
+      SG_error("fopen(%s) errno = %d\n", tmp_path, errsv );
+      free( tmp_path );
+      return errsv;
+   }
+   
+   size_t nw = fwrite( stats_str.data(), 1, stats_str.size(), f );
+   int close_rc = fclose( f );
+   
+   if( nw != stats_str.size() || close_rc != 0 ) {
+      SG_error("Failed to write statistics to %s\n", tmp_path );
+      unlink( tmp_path );
+      free( tmp_path );
+      return -EIO;
+   }
+   
+   int rc = rename( tmp_path, this->output_path );
+   if( rc != 0 ) {
+      rc = -errno;
+      SG_error("rename(%s, %s) errno = %d\n", tmp_path, this->output_path, rc );
+      unlink( tmp_path );
+   }
+   
+   free( tmp_path );
+   return rc;
+}
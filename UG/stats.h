@@ -21,6 +21,7 @@
 #include "log.h"
 #include <string>
 #include <sys/time.h>
+#include <vector>
 
 using namespace std;
 
@@ -58,9 +59,45 @@ enum stat_types {
    STAT_FTRUNCATE,
    STAT_FGETATTR,
    
+   // internal phases
+   STAT_REVALIDATE,
+   STAT_MANIFEST_FETCH,
+   STAT_BLOCK_DOWNLOAD,
+   STAT_CACHE_WRITE,
+   STAT_REPLICATE,
+   
    STAT_NUM_TYPES
 };
 
+// Latency histograms, in the style of HdrHistogram: latencies (in microseconds) are bucketed by their power of two,
+// and each power of two is split into STATS_HISTOGRAM_SUB_BUCKETS linear sub-buckets.  This keeps each bucket
+// within 1/STATS_HISTOGRAM_SUB_BUCKETS of the latencies it holds, for any latency up to 2^STATS_HISTOGRAM_MAGNITUDES microseconds.
+#define STATS_HISTOGRAM_SUB_BUCKET_BITS 4
+#define STATS_HISTOGRAM_SUB_BUCKETS (1 << STATS_HISTOGRAM_SUB_BUCKET_BITS)
+#define STATS_HISTOGRAM_MAGNITUDES 32
+#define STATS_HISTOGRAM_NUM_BUCKETS ((STATS_HISTOGRAM_MAGNITUDES - STATS_HISTOGRAM_SUB_BUCKET_BITS + 1) * STATS_HISTOGRAM_SUB_BUCKETS)
+
+struct stats_histogram {
+   uint64_t buckets[ STATS_HISTOGRAM_NUM_BUCKETS ];
+   uint64_t count;              // number of successful calls recorded
+   uint64_t errors;             // number of failed calls
+   uint64_t total;              // total time spent in successful calls
+   uint64_t max;                // longest successful call
+};
+
+class Stats;
+
+// one thread's statistics.  Only its thread writes to it, so recording a call takes no locks or atomic operations;
+// dumps read it while it is being written, so they can be off by the calls in progress.
+// When the thread exits, its statistics are folded into its Stats' retired totals.
+struct stats_thread {
+   Stats* owner;
+   uint64_t begin_call_times[ STAT_NUM_TYPES ];        // when this thread last began each call
+   struct stats_histogram histograms[ STAT_NUM_TYPES ];
+};
+
+typedef vector<struct stats_thread*> stats_thread_list_t;
+
 
 // instrumentation module
 class Stats {
@@ -77,19 +114,27 @@ public:
    
    // dump results
    string dump();
+   int dump_to_file();
+   
+   // merge all threads' histograms for a call
+   void merge( int stat_type, struct stats_histogram* merged );
 
 private:
    
-   // stat counters
-   uint64_t call_counts[ STAT_NUM_TYPES ];        // how often each call was made
-   uint64_t call_errors[ STAT_NUM_TYPES ];        // how often each call failed
-   uint64_t begin_call_times[ STAT_NUM_TYPES ];    // when a call was last begun
-   uint64_t elapsed_time[ STAT_NUM_TYPES ];       // total time spent in each function
+   struct stats_thread* get_thread();
+   static void retire_thread( void* arg );
+   
+   stats_thread_list_t* threads;             // running threads' statistics
+   struct stats_histogram* retired;          // exited threads' statistics, for each call
+   pthread_mutex_t threads_lock;             // guards threads and retired (only taken when a thread starts or stops recording, and on dump)
+   pthread_key_t thread_key;                 // this thread's statistics
+   
    char* output_path;                        // where to dump stats (preferably on a RAM fs)
    bool gather_stats;
-   
-   void (*enter_func)(uint64_t* enter_times, int type );
-   void (*leave_func)(uint64_t* count_times, uint64_t* elapsed_times, uint64_t* error_counts, uint64_t* begin_times, int type, int rc );
 };
 
+int stats_histogram_bucket( uint64_t value );
+void stats_histogram_bucket_range( int bucket, uint64_t* lo, uint64_t* hi );
+uint64_t stats_histogram_percentile( struct stats_histogram* hist, double percentile );
+
 #endif
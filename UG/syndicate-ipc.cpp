@@ -88,6 +88,7 @@ enum IPCMessageOperations {
     OP_TRUNCATE_FILE = 12,
     OP_GET_EXTENDED_ATTR = 13,
     OP_LIST_EXTENDED_ATTR = 14,
+    OP_GET_STATISTICS = 15,
 };
 
 /*
@@ -1432,6 +1433,41 @@ public:
 
         *data_out_size = toWriteSize;
     }
+    
+    void process_getStatistics(const char *message, char **data_out, int *data_out_size, bool *free_data_out) {
+        SG_debug("%s", "process - get statistics\n");
+        
+        // call
+        string statistics = SYNDICATEFS_DATA->stats->dump();
+        int returncode = 0;
+        
+        // keep the statistics file current too
+        int dump_rc = SYNDICATEFS_DATA->stats->dump_to_file();
+        if(dump_rc != 0) {
+            SG_error("dump_to_file rc = %d\n", dump_rc);
+        }
+        
+        int totalMessageSize = 4 + statistics.size();
+        int toWriteSize = 16 + totalMessageSize;
+        
+        if(toWriteSize < PREALLOCATED_OUT_BUFFER_LENGTH) {
+            // use preallocated buffer
+            *data_out = preallocated_buffer_;
+            *free_data_out = false;
+        } else {
+            *data_out = new char[toWriteSize];
+            *free_data_out = true;
+        }
+        char *outBuffer = *data_out;
+        char *bufferNext;
+        
+        writeHeader(outBuffer, OP_GET_STATISTICS, returncode, totalMessageSize, 1, &bufferNext);
+        
+        outBuffer = bufferNext;
+        writeString(outBuffer, statistics.data(), statistics.size(), &bufferNext);
+        
+        *data_out_size = toWriteSize;
+    }
 
 private:
     enum {
@@ -1704,6 +1740,13 @@ public:
                             message_ = new char[total_msg_size_];
                         }
                         message_offset_ = 0;
+                        
+                        if(total_msg_size_ == 0) {
+                            // no message (i.e. OP_GET_STATISTICS), so there's no data to wait for
+                            handle_protocol(message_preallocated_buffer_);
+                            stage_ = STAGE_READ_HEADER;
+                            header_offset_ = 0;
+                        }
                     } else {
                         // chunked header
                         int readSize = bytes_remain;
@@ -1870,6 +1913,9 @@ private:
             case OP_LIST_EXTENDED_ATTR:
                 protocol_->process_listXAttr(message, &data_out_, &data_out_size, &data_out_free_);
                 break;
+            case OP_GET_STATISTICS:
+                protocol_->process_getStatistics(message, &data_out_, &data_out_size, &data_out_free_);
+                break;
         }
 
         if(data_out_size > 0) {
@@ -231,10 +231,22 @@ int syndicate_destroy_ex( struct syndicate_state* state, int wait_replicas ) {
    if( state->stats != NULL ) {
       string statistics_str = state->stats->dump();
       printf("Statistics: \n%s\n", statistics_str.c_str() );
+      
+      int rc = state->stats->dump_to_file();
+      if( rc != 0 ) {
+         SG_error("Failed to write statistics, rc = %d\n", rc );
+      }
+      
       delete state->stats;
       state->stats = NULL;
    }
 
+   if( state->conf.trace_path != NULL ) {
+      
+      SG_debug("writing trace to %s\n", state->conf.trace_path );
+      md_trace_dump_path( state->conf.trace_path );
+   }
+
    SG_debug("%s", "log shutdown\n");
 
    log_shutdown( state->logfile );
@@ -0,0 +1,1719 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+
+// Implementation of the SyndicateFS methods on the FUSE low-level API.
+//
+// The kernel addresses entries by inode number, which we map to referenced fs_entry structures in an inode table.
+// lookup and getattr on entries that are still fresh are answered straight from the fs_entry, without walking
+// (and locking) the path from the root, and read and write go straight to the file handle.  Everything else
+// (and anything stale) goes through the usual path-based calls, using the path recorded at lookup time.
+
+#include "syndicatefs-ll.h"
+
+static struct syndicatefs_ll_state g_ll;
+
+struct fuse_lowlevel_ops get_syndicatefs_ll_opers() {
+   struct fuse_lowlevel_ops lo;
+   memset(&lo, 0, sizeof(lo));
+
+   lo.init = syndicatefs_ll_init;
+   lo.destroy = syndicatefs_ll_destroy;
+   lo.lookup = syndicatefs_ll_lookup;
+   lo.forget = syndicatefs_ll_forget;
+   lo.getattr = syndicatefs_ll_getattr;
+   lo.setattr = syndicatefs_ll_setattr;
+   lo.readlink = syndicatefs_ll_readlink;
+   lo.mknod = syndicatefs_ll_mknod;
+   lo.mkdir = syndicatefs_ll_mkdir;
+   lo.unlink = syndicatefs_ll_unlink;
+   lo.rmdir = syndicatefs_ll_rmdir;
+   lo.symlink = syndicatefs_ll_symlink;
+   lo.rename = syndicatefs_ll_rename;
+   lo.link = syndicatefs_ll_link;
+   lo.open = syndicatefs_ll_open;
+   lo.read = syndicatefs_ll_read;
+   lo.write = syndicatefs_ll_write;
+   lo.flush = syndicatefs_ll_flush;
+   lo.release = syndicatefs_ll_release;
+   lo.fsync = syndicatefs_ll_fsync;
+   lo.opendir = syndicatefs_ll_opendir;
+   lo.readdir = syndicatefs_ll_readdir;
+#ifdef FUSE_CAP_READDIRPLUS
+   lo.readdirplus = syndicatefs_ll_readdirplus;
+#endif
+   lo.releasedir = syndicatefs_ll_releasedir;
+   lo.fsyncdir = syndicatefs_ll_fsyncdir;
+   lo.statfs = syndicatefs_ll_statfs;
+   lo.setxattr = syndicatefs_ll_setxattr;
+   lo.getxattr = syndicatefs_ll_getxattr;
+   lo.listxattr = syndicatefs_ll_listxattr;
+   lo.removexattr = syndicatefs_ll_removexattr;
+   lo.access = syndicatefs_ll_access;
+   lo.create = syndicatefs_ll_create;
+
+   return lo;
+}
+
+
+// how long the kernel may cache entries and attributes (in seconds)
+static double syndicatefs_ll_attr_timeout( struct syndicatefs_ll_state* ll ) {
+   return (double)ll->state->conf.default_read_freshness / 1000.0;
+}
+
+
+// can we use an fs_entry as-is, without revalidating it?
+// fent must be at least read-locked
+static bool syndicatefs_ll_is_fresh( struct fs_entry* fent ) {
+
+   if( fent->link_count <= 0 || fent->ftype == FTYPE_DEAD || fent->deletion_in_progress ) {
+      // unlinked; only the path can tell us what's there now
+      return false;
+   }
+
+   return !fs_entry_is_read_stale( fent );
+}
+
+
+// get the path to an inode, as of its last lookup
+// return 0 on success
+// return -ENOENT if the kernel gave us an inode we don't know about
+static int syndicatefs_ll_get_path( struct syndicatefs_ll_state* ll, fuse_ino_t ino, char** path ) {
+
+   struct fs_entry* fent = fs_inode_table_get( &ll->inodes, ino, path );
+   if( fent == NULL ) {
+      return -ENOENT;
+   }
+
+   fs_inode_put_entry( ll->state->core, fent );
+   return 0;
+}
+
+
+// get the path to a name in a directory inode
+// return 0 on success
+// return -ENOENT if the kernel gave us an inode we don't know about
+// return -ENOMEM if out of memory
+static int syndicatefs_ll_get_child_path( struct syndicatefs_ll_state* ll, fuse_ino_t parent, char const* name, char** path ) {
+
+   char* parent_path = NULL;
+
+   int rc = syndicatefs_ll_get_path( ll, parent, &parent_path );
+   if( rc != 0 ) {
+      return rc;
+   }
+
+   *path = md_fullpath( parent_path, name, NULL );
+   free( parent_path );
+
+   if( *path == NULL ) {
+      return -ENOMEM;
+   }
+
+   return 0;
+}
+
+
+// record a lookup of fent and fill in the kernel's entry for it
+// fent must be at least read-locked
+static int syndicatefs_ll_fill_entry( struct syndicatefs_ll_state* ll, struct fs_entry* fent, char const* path, struct fuse_entry_param* e ) {
+
+   uint64_t ino = 0;
+
+   int rc = fs_inode_table_lookup( ll->state->core, &ll->inodes, fent, path, &ino );
+   if( rc != 0 ) {
+      return rc;
+   }
+
+   memset( e, 0, sizeof(struct fuse_entry_param) );
+
+   fs_entry_stat_locked( ll->state->core, fent, &e->attr );
+
+   e->ino = ino;
+   e->attr.st_ino = ino;
+   e->attr_timeout = syndicatefs_ll_attr_timeout( ll );
+   e->entry_timeout = syndicatefs_ll_attr_timeout( ll );
+
+   return 0;
+}
+
+
+// look up a name in a directory inode, and fill in the kernel's entry for it.
+// if the directory and the child are both fresh, this does not touch the rest of the path.
+static int syndicatefs_ll_do_lookup( struct syndicatefs_ll_state* ll, fuse_ino_t parent, char const* name, struct fuse_entry_param* e ) {
+
+   struct fs_core* core = ll->state->core;
+   uint64_t user = ll->state->conf.owner;
+   int rc = 0;
+
+   char* parent_path = NULL;
+   struct fs_entry* child = NULL;
+
+   struct fs_entry* parent_fent = fs_inode_table_get( &ll->inodes, parent, &parent_path );
+   if( parent_fent == NULL ) {
+      return -ENOENT;
+   }
+
+   char* path = md_fullpath( parent_path, name, NULL );
+   free( parent_path );
+
+   if( path == NULL ) {
+      fs_inode_put_entry( core, parent_fent );
+      return -ENOMEM;
+   }
+
+   fs_entry_rlock( parent_fent );
+
+   if( parent_fent->ftype == FTYPE_DIR && syndicatefs_ll_is_fresh( parent_fent ) && IS_DIR_READABLE( parent_fent->mode, parent_fent->owner, parent_fent->volume, user, core->volume ) ) {
+
+      child = fs_entry_set_find_name( parent_fent->children, name );
+
+      if( child != NULL ) {
+
+         fs_entry_rlock( child );
+
+         if( !syndicatefs_ll_is_fresh( child ) || !IS_READABLE( child->mode, child->owner, child->volume, user, core->volume ) ) {
+
+            // let the full resolution sort it out
+            fs_entry_unlock( child );
+            child = NULL;
+         }
+      }
+   }
+
+   fs_entry_unlock( parent_fent );
+   fs_inode_put_entry( core, parent_fent );
+
+   if( child == NULL ) {
+
+      // stale or unknown; revalidate and resolve the whole path
+      rc = fs_entry_revalidate_path( core, path );
+      if( rc != 0 ) {
+
+         free( path );
+         return rc;
+      }
+
+      child = fs_entry_resolve_path( core, path, user, core->volume, false, &rc );
+      if( child == NULL || rc != 0 ) {
+
+         free( path );
+         return (rc != 0 ? rc : -ENOMEM);
+      }
+   }
+
+   rc = syndicatefs_ll_fill_entry( ll, child, path, e );
+
+   fs_entry_unlock( child );
+   free( path );
+
+   return rc;
+}
+
+
+/** Look up a directory entry by name and get its attributes */
+void syndicatefs_ll_lookup( fuse_req_t req, fuse_ino_t parent, const char* name ) {
+
+   struct syndicatefs_ll_state* ll = SYNDICATEFS_LL_DATA( req );
+   struct syndicate_state* state = ll->state;
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_lookup( %lx, %s )\n", pthread_self(), parent, name );
+
+   state->stats->enter( STAT_GETATTR );
+
+   struct fuse_entry_param e;
+   int rc = syndicatefs_ll_do_lookup( ll, parent, name, &e );
+
+   state->stats->leave( STAT_GETATTR, rc );
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_lookup rc = %d\n", pthread_self(), rc );
+
+   if( rc == -ENOENT && state->conf.negative_cache_size > 0 && state->conf.negative_cache_ttl_ms > 0 ) {
+
+      // let the kernel remember that this name does not exist, for as long as we do
+      memset( &e, 0, sizeof(struct fuse_entry_param) );
+      e.ino = 0;
+      e.entry_timeout = (double)state->conf.negative_cache_ttl_ms / 1000.0;
+
+      fuse_reply_entry( req, &e );
+   }
+   else if( rc != 0 ) {
+      fuse_reply_err( req, -rc );
+   }
+   else {
+      fuse_reply_entry( req, &e );
+   }
+}
+
+
+/** Forget about an inode */
+void syndicatefs_ll_forget( fuse_req_t req, fuse_ino_t ino, unsigned long nlookup ) {
+
+   struct syndicatefs_ll_state* ll = SYNDICATEFS_LL_DATA( req );
+
+   int rc = fs_inode_table_forget( ll->state->core, &ll->inodes, ino, nlookup );
+   if( rc != 0 ) {
+      SG_error("fs_inode_table_forget(%lx, %lu) rc = %d\n", ino, nlookup, rc );
+   }
+
+   fuse_reply_none( req );
+}
+
+
+/** Get file attributes */
+void syndicatefs_ll_getattr( fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* fi ) {
+
+   struct syndicatefs_ll_state* ll = SYNDICATEFS_LL_DATA( req );
+   struct syndicate_state* state = ll->state;
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_getattr( %lx, %p )\n", pthread_self(), ino, fi );
+
+   state->stats->enter( STAT_GETATTR );
+
+   int rc = 0;
+   char* path = NULL;
+   struct stat sb;
+   bool fresh = false;
+
+   struct fs_entry* fent = fs_inode_table_get( &ll->inodes, ino, &path );
+   if( fent == NULL ) {
+
+      state->stats->leave( STAT_GETATTR, -ENOENT );
+      fuse_reply_err( req, ENOENT );
+      return;
+   }
+
+   // use the entry directly if we can
+   fs_entry_rlock( fent );
+
+   fresh = syndicatefs_ll_is_fresh( fent );
+   if( fresh ) {
+      fs_entry_stat_locked( state->core, fent, &sb );
+   }
+
+   fs_entry_unlock( fent );
+   fs_inode_put_entry( state->core, fent );
+
+   if( !fresh ) {
+      rc = fs_entry_stat( state->core, path, &sb, state->conf.owner, state->core->volume );
+   }
+
+   free( path );
+
+   state->stats->leave( STAT_GETATTR, rc );
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_getattr rc = %d\n", pthread_self(), rc );
+
+   if( rc != 0 ) {
+      fuse_reply_err( req, -rc );
+   }
+   else {
+      sb.st_ino = ino;
+      fuse_reply_attr( req, &sb, syndicatefs_ll_attr_timeout( ll ) );
+   }
+}
+
+
+/** Set file attributes (chmod, truncate, ftruncate, utime) */
+void syndicatefs_ll_setattr( fuse_req_t req, fuse_ino_t ino, struct stat* attr, int to_set, struct fuse_file_info* fi ) {
+
+   struct syndicatefs_ll_state* ll = SYNDICATEFS_LL_DATA( req );
+   struct syndicate_state* state = ll->state;
+   struct fs_core* core = state->core;
+   uint64_t user = state->conf.owner;
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_setattr( %lx, %p, %x, %p )\n", pthread_self(), ino, attr, to_set, fi );
+
+   char* path = NULL;
+   struct stat sb;
+
+   int rc = syndicatefs_ll_get_path( ll, ino, &path );
+   if( rc != 0 ) {
+      fuse_reply_err( req, -rc );
+      return;
+   }
+
+   if( to_set & (FUSE_SET_ATTR_UID | FUSE_SET_ATTR_GID) ) {
+      // can't be done here--Syndicate uses 64-bit user_ids and volume_ids
+      rc = -ENOSYS;
+   }
+
+   if( rc == 0 && (to_set & FUSE_SET_ATTR_MODE) ) {
+
+      state->stats->enter( STAT_CHMOD );
+
+      rc = fs_entry_chmod( core, path, user, core->volume, attr->st_mode & 07777 );
+
+      state->stats->leave( STAT_CHMOD, rc );
+   }
+
+   if( rc == 0 && (to_set & FUSE_SET_ATTR_SIZE) ) {
+
+      if( fi != NULL ) {
+
+         state->stats->enter( STAT_FTRUNCATE );
+
+         rc = fs_entry_ftruncate( core, (struct fs_file_handle*)fi->fh, attr->st_size, user, core->volume );
+
+         state->stats->leave( STAT_FTRUNCATE, rc );
+      }
+      else {
+
+         state->stats->enter( STAT_TRUNCATE );
+
+         rc = fs_entry_truncate( core, path, attr->st_size, user, core->volume );
+
+         state->stats->leave( STAT_TRUNCATE, rc );
+      }
+   }
+
+   if( rc == 0 && (to_set & (FUSE_SET_ATTR_ATIME | FUSE_SET_ATTR_MTIME)) ) {
+
+      state->stats->enter( STAT_UTIME );
+
+      // keep whichever time we weren't asked to change
+      rc = fs_entry_stat( core, path, &sb, user, core->volume );
+      if( rc == 0 ) {
+
+         struct utimbuf ubuf;
+
+         ubuf.actime = (to_set & FUSE_SET_ATTR_ATIME) ? attr->st_atime : sb.st_atime;
+         ubuf.modtime = (to_set & FUSE_SET_ATTR_MTIME) ? attr->st_mtime : sb.st_mtime;
+
+         rc = fs_entry_utime( core, path, &ubuf, user, core->volume );
+      }
+
+      state->stats->leave( STAT_UTIME, rc );
+   }
+
+   if( rc == 0 ) {
+      rc = fs_entry_stat( core, path, &sb, user, core->volume );
+   }
+
+   free( path );
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_setattr rc = %d\n", pthread_self(), rc );
+
+   if( rc != 0 ) {
+      fuse_reply_err( req, -rc );
+   }
+   else {
+      sb.st_ino = ino;
+      fuse_reply_attr( req, &sb, syndicatefs_ll_attr_timeout( ll ) );
+   }
+}
+
+
+/** Read the target of a symbolic link (there aren't any) */
+void syndicatefs_ll_readlink( fuse_req_t req, fuse_ino_t ino ) {
+
+   struct syndicate_state* state = SYNDICATEFS_LL_DATA( req )->state;
+
+   state->stats->enter( STAT_READLINK );
+   state->stats->leave( STAT_READLINK, -1 );
+
+   fuse_reply_err( req, EINVAL );
+}
+
+
+/** Create a file node.  Right now, only normal files are supported. */
+void syndicatefs_ll_mknod( fuse_req_t req, fuse_ino_t parent, const char* name, mode_t mode, dev_t rdev ) {
+
+   struct syndicatefs_ll_state* ll = SYNDICATEFS_LL_DATA( req );
+   struct syndicate_state* state = ll->state;
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_mknod( %lx, %s, %o, %d )\n", pthread_self(), parent, name, mode, rdev );
+
+   state->stats->enter( STAT_MKNOD );
+
+   char* path = NULL;
+   struct fuse_entry_param e;
+
+   int rc = syndicatefs_ll_get_child_path( ll, parent, name, &path );
+   if( rc == 0 ) {
+
+      rc = fs_entry_mknod( state->core, path, mode, rdev, state->conf.owner, state->core->volume );
+      free( path );
+   }
+
+   if( rc == 0 ) {
+      rc = syndicatefs_ll_do_lookup( ll, parent, name, &e );
+   }
+
+   state->stats->leave( STAT_MKNOD, rc );
+
+   if( rc != 0 ) {
+      fuse_reply_err( req, -rc );
+   }
+   else {
+      fuse_reply_entry( req, &e );
+   }
+}
+
+
+/** Create a directory */
+void syndicatefs_ll_mkdir( fuse_req_t req, fuse_ino_t parent, const char* name, mode_t mode ) {
+
+   struct syndicatefs_ll_state* ll = SYNDICATEFS_LL_DATA( req );
+   struct syndicate_state* state = ll->state;
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_mkdir( %lx, %s, %o )\n", pthread_self(), parent, name, mode );
+
+   state->stats->enter( STAT_MKDIR );
+
+   char* path = NULL;
+   struct fuse_entry_param e;
+
+   int rc = syndicatefs_ll_get_child_path( ll, parent, name, &path );
+   if( rc == 0 ) {
+
+      rc = fs_entry_mkdir( state->core, path, mode, state->conf.owner, state->core->volume );
+      free( path );
+   }
+
+   if( rc == 0 ) {
+      rc = syndicatefs_ll_do_lookup( ll, parent, name, &e );
+   }
+
+   state->stats->leave( STAT_MKDIR, rc );
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_mkdir rc = %d\n", pthread_self(), rc );
+
+   if( rc != 0 ) {
+      fuse_reply_err( req, -rc );
+   }
+   else {
+      fuse_reply_entry( req, &e );
+   }
+}
+
+
+/** Remove a file */
+void syndicatefs_ll_unlink( fuse_req_t req, fuse_ino_t parent, const char* name ) {
+
+   struct syndicatefs_ll_state* ll = SYNDICATEFS_LL_DATA( req );
+   struct syndicate_state* state = ll->state;
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_unlink( %lx, %s )\n", pthread_self(), parent, name );
+
+   state->stats->enter( STAT_UNLINK );
+
+   char* path = NULL;
+
+   int rc = syndicatefs_ll_get_child_path( ll, parent, name, &path );
+   if( rc == 0 ) {
+
+      rc = fs_entry_unlink( state->core, path, state->conf.owner, state->core->volume );
+      free( path );
+   }
+
+   state->stats->leave( STAT_UNLINK, rc );
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_unlink rc = %d\n", pthread_self(), rc );
+
+   fuse_reply_err( req, -rc );
+}
+
+
+/** Remove a directory */
+void syndicatefs_ll_rmdir( fuse_req_t req, fuse_ino_t parent, const char* name ) {
+
+   struct syndicatefs_ll_state* ll = SYNDICATEFS_LL_DATA( req );
+   struct syndicate_state* state = ll->state;
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_rmdir( %lx, %s )\n", pthread_self(), parent, name );
+
+   state->stats->enter( STAT_RMDIR );
+
+   char* path = NULL;
+
+   int rc = syndicatefs_ll_get_child_path( ll, parent, name, &path );
+   if( rc == 0 ) {
+
+      rc = fs_entry_rmdir( state->core, path, state->conf.owner, state->core->volume );
+      free( path );
+   }
+
+   state->stats->leave( STAT_RMDIR, rc );
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_rmdir rc = %d\n", pthread_self(), rc );
+
+   fuse_reply_err( req, -rc );
+}
+
+
+/** Create a symbolic link (not supported) */
+void syndicatefs_ll_symlink( fuse_req_t req, const char* link, fuse_ino_t parent, const char* name ) {
+
+   struct syndicate_state* state = SYNDICATEFS_LL_DATA( req )->state;
+
+   state->stats->enter( STAT_SYMLINK );
+   state->stats->leave( STAT_SYMLINK, -1 );
+
+   fuse_reply_err( req, EPERM );
+}
+
+
+/** Rename a file */
+void syndicatefs_ll_rename( fuse_req_t req, fuse_ino_t parent, const char* name, fuse_ino_t newparent, const char* newname ) {
+
+   struct syndicatefs_ll_state* ll = SYNDICATEFS_LL_DATA( req );
+   struct syndicate_state* state = ll->state;
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_rename( %lx, %s, %lx, %s )\n", pthread_self(), parent, name, newparent, newname );
+
+   state->stats->enter( STAT_RENAME );
+
+   char* path = NULL;
+   char* newpath = NULL;
+
+   int rc = syndicatefs_ll_get_child_path( ll, parent, name, &path );
+   if( rc == 0 ) {
+      rc = syndicatefs_ll_get_child_path( ll, newparent, newname, &newpath );
+   }
+
+   if( rc == 0 ) {
+      rc = fs_entry_rename( state->core, path, newpath, state->conf.owner, state->core->volume );
+   }
+
+   if( rc == 0 ) {
+
+      // the renamed inodes keep their numbers, but not their paths
+      int inode_rc = fs_inode_table_rename( &ll->inodes, path, newpath );
+      if( inode_rc != 0 ) {
+         SG_error("fs_inode_table_rename(%s, %s) rc = %d\n", path, newpath, inode_rc );
+      }
+   }
+
+   SG_safe_free( path );
+   SG_safe_free( newpath );
+
+   state->stats->leave( STAT_RENAME, rc );
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_rename rc = %d\n", pthread_self(), rc );
+
+   fuse_reply_err( req, -rc );
+}
+
+
+/** Create a hard link (not supported) */
+void syndicatefs_ll_link( fuse_req_t req, fuse_ino_t ino, fuse_ino_t newparent, const char* newname ) {
+
+   struct syndicate_state* state = SYNDICATEFS_LL_DATA( req )->state;
+
+   state->stats->enter( STAT_LINK );
+   state->stats->leave( STAT_LINK, -1 );
+
+   fuse_reply_err( req, EXDEV );
+}
+
+
+// set up the kernel's caching for an open file handle (see syndicatefs_open)
+static void syndicatefs_ll_setup_file_info( struct fs_file_handle* fh, struct fuse_file_info* fi ) {
+
+   fi->fh = (uint64_t)fh;
+
+   if( fh->is_AG ) {
+      // AG-hosted files don't know their sizes up front, so don't let the kernel cut reads short at st_size
+      fi->direct_io = 1;
+   }
+   else {
+      // let the kernel keep its cached pages, unless the file's data changed since they were read
+      fi->keep_cache = fs_file_handle_keep_cache( fh );
+   }
+}
+
+
+/** File open operation */
+void syndicatefs_ll_open( fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* fi ) {
+
+   struct syndicatefs_ll_state* ll = SYNDICATEFS_LL_DATA( req );
+   struct syndicate_state* state = ll->state;
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_open( %lx, %p (flags = %o) )\n", pthread_self(), ino, fi, fi->flags );
+
+   state->stats->enter( STAT_OPEN );
+
+   char* path = NULL;
+   struct fs_file_handle* fh = NULL;
+
+   int rc = syndicatefs_ll_get_path( ll, ino, &path );
+   if( rc == 0 ) {
+
+      fh = fs_entry_open( state->core, path, state->conf.owner, state->core->volume, fi->flags, ~state->conf.usermask, &rc );
+      free( path );
+   }
+
+   if( rc == 0 && fh == NULL ) {
+      rc = -ENOMEM;
+   }
+
+   state->stats->leave( STAT_OPEN, rc );
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_open rc = %d\n", pthread_self(), rc );
+
+   if( rc != 0 ) {
+      fuse_reply_err( req, -rc );
+      return;
+   }
+
+   syndicatefs_ll_setup_file_info( fh, fi );
+
+   if( fuse_reply_open( req, fi ) == -ENOENT ) {
+
+      // interrupted; the kernel won't release this handle
+      fs_entry_close( state->core, fh );
+      free( fh );
+   }
+}
+
+
+/** Read data from an open file */
+void syndicatefs_ll_read( fuse_req_t req, fuse_ino_t ino, size_t size, off_t off, struct fuse_file_info* fi ) {
+
+   struct syndicate_state* state = SYNDICATEFS_LL_DATA( req )->state;
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_read( %lx, %ld, %ld, %p )\n", pthread_self(), ino, size, off, fi );
+
+   state->stats->enter( STAT_READ );
+
+   struct fs_file_handle* fh = (struct fs_file_handle*)fi->fh;
+
+   char* buf = SG_CALLOC( char, size );
+   if( buf == NULL ) {
+
+      state->stats->leave( STAT_READ, -ENOMEM );
+      fuse_reply_err( req, ENOMEM );
+      return;
+   }
+
+   ssize_t rc = fs_entry_read( state->core, fh, buf, size, off );
+
+   state->stats->leave( STAT_READ, (rc >= 0 ? 0 : rc) );
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_read rc = %ld\n", pthread_self(), rc );
+
+   if( rc < 0 ) {
+      fuse_reply_err( req, -rc );
+   }
+   else {
+      fuse_reply_buf( req, buf, rc );
+   }
+
+   free( buf );
+}
+
+
+/** Write data to an open file */
+void syndicatefs_ll_write( fuse_req_t req, fuse_ino_t ino, const char* buf, size_t size, off_t off, struct fuse_file_info* fi ) {
+
+   struct syndicate_state* state = SYNDICATEFS_LL_DATA( req )->state;
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_write( %lx, %p, %ld, %ld, %p )\n", pthread_self(), ino, buf, size, off, fi );
+
+   state->stats->enter( STAT_WRITE );
+
+   struct fs_file_handle* fh = (struct fs_file_handle*)fi->fh;
+
+   ssize_t rc = fs_entry_write( state->core, fh, buf, size, off );
+
+   state->stats->leave( STAT_WRITE, (rc >= 0 ? 0 : rc) );
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_write rc = %ld\n", pthread_self(), rc );
+
+   if( rc < 0 ) {
+      fuse_reply_err( req, -rc );
+   }
+   else {
+      fuse_reply_write( req, rc );
+   }
+}
+
+
+/** Flush cached data */
+void syndicatefs_ll_flush( fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* fi ) {
+
+   struct syndicate_state* state = SYNDICATEFS_LL_DATA( req )->state;
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_flush( %lx, %p )\n", pthread_self(), ino, fi );
+
+   state->stats->enter( STAT_FLUSH );
+
+   int rc = fs_entry_fsync( state->core, (struct fs_file_handle*)fi->fh );
+
+   state->stats->leave( STAT_FLUSH, rc );
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_flush rc = %d\n", pthread_self(), rc );
+
+   fuse_reply_err( req, -rc );
+}
+
+
+/** Release an open file (close) */
+void syndicatefs_ll_release( fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* fi ) {
+
+   struct syndicate_state* state = SYNDICATEFS_LL_DATA( req )->state;
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_release( %lx, %p )\n", pthread_self(), ino, fi );
+
+   state->stats->enter( STAT_RELEASE );
+
+   struct fs_file_handle* fh = (struct fs_file_handle*)fi->fh;
+
+   int rc = fs_entry_close( state->core, fh );
+   if( rc != 0 ) {
+      logerr( state->logfile, "%16lx: syndicatefs_ll_release: fs_entry_close rc = %d\n", pthread_self(), rc );
+   }
+
+   free( fh );
+
+   state->stats->leave( STAT_RELEASE, rc );
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_release rc = %d\n", pthread_self(), rc );
+
+   fuse_reply_err( req, -rc );
+}
+
+
+/** Synchronize file contents (fdatasync, fsync) */
+void syndicatefs_ll_fsync( fuse_req_t req, fuse_ino_t ino, int datasync, struct fuse_file_info* fi ) {
+
+   struct syndicate_state* state = SYNDICATEFS_LL_DATA( req )->state;
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_fsync( %lx, %d, %p )\n", pthread_self(), ino, datasync, fi );
+
+   state->stats->enter( STAT_FSYNC );
+
+   struct fs_file_handle* fh = (struct fs_file_handle*)fi->fh;
+   int rc = 0;
+
+   if( datasync == 0 )
+      rc = fs_entry_fdatasync( state->core, fh );
+
+   if( rc == 0 )
+      fs_entry_fsync( state->core, fh );
+
+   state->stats->leave( STAT_FSYNC, rc );
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_fsync rc = %d\n", pthread_self(), rc );
+
+   fuse_reply_err( req, -rc );
+}
+
+
+/** Open directory */
+void syndicatefs_ll_opendir( fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* fi ) {
+
+   struct syndicatefs_ll_state* ll = SYNDICATEFS_LL_DATA( req );
+   struct syndicate_state* state = ll->state;
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_opendir( %lx, %p )\n", pthread_self(), ino, fi );
+
+   state->stats->enter( STAT_OPENDIR );
+
+   char* path = NULL;
+   struct fs_dir_handle* fdh = NULL;
+
+   int rc = syndicatefs_ll_get_path( ll, ino, &path );
+   if( rc == 0 ) {
+
+      fdh = fs_entry_opendir( state->core, path, state->conf.owner, state->core->volume, &rc );
+      free( path );
+   }
+
+   state->stats->leave( STAT_OPENDIR, rc );
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_opendir rc = %d\n", pthread_self(), rc );
+
+   if( rc != 0 ) {
+      fuse_reply_err( req, -rc );
+      return;
+   }
+
+   fi->fh = (uint64_t)fdh;
+
+   if( fuse_reply_open( req, fi ) == -ENOENT ) {
+
+      // interrupted; the kernel won't release this handle
+      fs_entry_closedir( state->core, fdh );
+      free( fdh );
+   }
+}
+
+
+// a reply buffer being filled with directory entries
+struct syndicatefs_ll_dirbuf {
+   struct syndicatefs_ll_state* ll;
+   fuse_req_t req;
+   char* buf;
+   size_t size;
+   size_t len;
+
+   char* dir_path;              // path to the directory (readdirplus only)
+};
+
+
+// add one directory entry to a readdir reply
+static int syndicatefs_ll_readdir_fill( struct fs_core* core, char const* name, int ftype, struct fs_entry* fent, off_t next_offset, void* cls ) {
+
+   struct syndicatefs_ll_dirbuf* db = (struct syndicatefs_ll_dirbuf*)cls;
+   struct stat sb;
+
+   memset( &sb, 0, sizeof(struct stat) );
+
+   // the kernel only uses the inode number and type; it looks up the rest
+   if( fent != NULL ) {
+      sb.st_ino = fs_inode_from_file_id( fent->file_id );
+   }
+
+   sb.st_mode = (ftype == FTYPE_DIR ? S_IFDIR : S_IFREG);
+
+   size_t ent_len = fuse_add_direntry( db->req, db->buf + db->len, db->size - db->len, name, &sb, next_offset );
+   if( ent_len > db->size - db->len ) {
+      // buffer full; the kernel will ask for the rest starting from this entry
+      return 1;
+   }
+
+   db->len += ent_len;
+   return 0;
+}
+
+
+// list a directory into a reply buffer, starting from off
+static int syndicatefs_ll_do_readdir( fuse_req_t req, size_t size, off_t off, struct fuse_file_info* fi, fs_dir_filler_func filler, char* dir_path, struct syndicatefs_ll_dirbuf* db ) {
+
+   struct syndicatefs_ll_state* ll = SYNDICATEFS_LL_DATA( req );
+   struct fs_dir_handle* fdh = (struct fs_dir_handle*)fi->fh;
+
+   memset( db, 0, sizeof(struct syndicatefs_ll_dirbuf) );
+
+   db->ll = ll;
+   db->req = req;
+   db->size = size;
+   db->dir_path = dir_path;
+
+   db->buf = SG_CALLOC( char, size );
+   if( db->buf == NULL ) {
+      return -ENOMEM;
+   }
+
+   int rc = fs_entry_readdir_iter( ll->state->core, fdh, off, filler, db );
+   if( rc != 0 ) {
+      SG_safe_free( db->buf );
+   }
+
+   return rc;
+}
+
+
+/** Read directory.
+ *
+ * An entry's offset is its position in the directory, so the kernel can pick up where the last buffer left off.
+ */
+void syndicatefs_ll_readdir( fuse_req_t req, fuse_ino_t ino, size_t size, off_t off, struct fuse_file_info* fi ) {
+
+   struct syndicate_state* state = SYNDICATEFS_LL_DATA( req )->state;
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_readdir( %lx, %ld, %ld, %p )\n", pthread_self(), ino, size, off, fi );
+
+   state->stats->enter( STAT_READDIR );
+
+   struct syndicatefs_ll_dirbuf db;
+
+   int rc = syndicatefs_ll_do_readdir( req, size, off, fi, syndicatefs_ll_readdir_fill, NULL, &db );
+
+   state->stats->leave( STAT_READDIR, rc );
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_readdir rc = %d\n", pthread_self(), rc );
+
+   if( rc != 0 ) {
+      fuse_reply_err( req, -rc );
+      return;
+   }
+
+   fuse_reply_buf( req, db.buf, db.len );
+
+   free( db.buf );
+}
+
+
+#ifdef FUSE_CAP_READDIRPLUS
+
+// add one directory entry and its attributes to a readdirplus reply.
+// the kernel counts this as a lookup of the entry.
+static int syndicatefs_ll_readdirplus_fill( struct fs_core* core, char const* name, int ftype, struct fs_entry* fent, off_t next_offset, void* cls ) {
+
+   struct syndicatefs_ll_dirbuf* db = (struct syndicatefs_ll_dirbuf*)cls;
+   struct fuse_entry_param e;
+
+   memset( &e, 0, sizeof(struct fuse_entry_param) );
+
+   // make sure the entry fits (before we count a lookup for it); its size only depends on its name
+   if( fuse_add_direntry_plus( db->req, NULL, 0, name, &e, next_offset ) > db->size - db->len ) {
+      return 1;
+   }
+
+   if( fent == NULL || strcmp( name, "." ) == 0 ) {
+
+      // the kernel doesn't look up . or .., so don't record a lookup for them
+      e.attr.st_ino = (fent != NULL ? fs_inode_from_file_id( fent->file_id ) : 0);
+      e.attr.st_mode = S_IFDIR;
+   }
+   else {
+
+      char* path = md_fullpath( db->dir_path, name, NULL );
+      if( path == NULL ) {
+         // leave the rest for the next buffer
+         return 1;
+      }
+
+      int rc = syndicatefs_ll_fill_entry( db->ll, fent, path, &e );
+      free( path );
+
+      if( rc != 0 ) {
+         return 1;
+      }
+   }
+
+   db->len += fuse_add_direntry_plus( db->req, db->buf + db->len, db->size - db->len, name, &e, next_offset );
+   return 0;
+}
+
+
+/** Read directory, with attributes.  Each child listed counts as a lookup. */
+void syndicatefs_ll_readdirplus( fuse_req_t req, fuse_ino_t ino, size_t size, off_t off, struct fuse_file_info* fi ) {
+
+   struct syndicate_state* state = SYNDICATEFS_LL_DATA( req )->state;
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_readdirplus( %lx, %ld, %ld, %p )\n", pthread_self(), ino, size, off, fi );
+
+   state->stats->enter( STAT_READDIR );
+
+   struct syndicatefs_ll_dirbuf db;
+   char* dir_path = NULL;
+
+   int rc = syndicatefs_ll_get_path( SYNDICATEFS_LL_DATA( req ), ino, &dir_path );
+   if( rc == 0 ) {
+
+      rc = syndicatefs_ll_do_readdir( req, size, off, fi, syndicatefs_ll_readdirplus_fill, dir_path, &db );
+      free( dir_path );
+   }
+
+   state->stats->leave( STAT_READDIR, rc );
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_readdirplus rc = %d\n", pthread_self(), rc );
+
+   if( rc != 0 ) {
+      fuse_reply_err( req, -rc );
+      return;
+   }
+
+   fuse_reply_buf( req, db.buf, db.len );
+
+   free( db.buf );
+}
+
+#endif
+
+
+/** Release directory (closedir) */
+void syndicatefs_ll_releasedir( fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* fi ) {
+
+   struct syndicate_state* state = SYNDICATEFS_LL_DATA( req )->state;
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_releasedir( %lx, %p )\n", pthread_self(), ino, fi );
+
+   state->stats->enter( STAT_RELEASEDIR );
+
+   struct fs_dir_handle* fdh = (struct fs_dir_handle*)fi->fh;
+
+   int rc = fs_entry_closedir( state->core, fdh );
+
+   free( fdh );
+
+   state->stats->leave( STAT_RELEASEDIR, rc );
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_releasedir rc = %d\n", pthread_self(), rc );
+
+   fuse_reply_err( req, -rc );
+}
+
+
+/** Synchronize directory contents (no-op) */
+void syndicatefs_ll_fsyncdir( fuse_req_t req, fuse_ino_t ino, int datasync, struct fuse_file_info* fi ) {
+
+   struct syndicate_state* state = SYNDICATEFS_LL_DATA( req )->state;
+
+   state->stats->enter( STAT_FSYNCDIR );
+   state->stats->leave( STAT_FSYNCDIR, 0 );
+
+   fuse_reply_err( req, 0 );
+}
+
+
+/** Get file system statistics */
+void syndicatefs_ll_statfs( fuse_req_t req, fuse_ino_t ino ) {
+
+   struct syndicatefs_ll_state* ll = SYNDICATEFS_LL_DATA( req );
+   struct syndicate_state* state = ll->state;
+
+   state->stats->enter( STAT_STATFS );
+
+   char* path = NULL;
+   struct statvfs statv;
+
+   int rc = syndicatefs_ll_get_path( ll, ino, &path );
+   if( rc == 0 ) {
+
+      rc = fs_entry_statfs( state->core, path, &statv, state->conf.owner, state->core->volume );
+      free( path );
+   }
+
+   state->stats->leave( STAT_STATFS, rc );
+
+   if( rc != 0 ) {
+      fuse_reply_err( req, -rc );
+   }
+   else {
+      fuse_reply_statfs( req, &statv );
+   }
+}
+
+
+/** Set extended attributes */
+void syndicatefs_ll_setxattr( fuse_req_t req, fuse_ino_t ino, const char* name, const char* value, size_t size, int flags ) {
+
+   struct syndicatefs_ll_state* ll = SYNDICATEFS_LL_DATA( req );
+   struct syndicate_state* state = ll->state;
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_setxattr( %lx, %s, %p, %d, %x )\n", pthread_self(), ino, name, value, size, flags );
+
+   state->stats->enter( STAT_SETXATTR );
+
+   char* path = NULL;
+
+   int rc = syndicatefs_ll_get_path( ll, ino, &path );
+   if( rc == 0 ) {
+
+      rc = fs_entry_setxattr( state->core, path, name, value, size, flags, state->conf.owner, state->core->volume );
+      free( path );
+   }
+
+   state->stats->leave( STAT_SETXATTR, rc );
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_setxattr rc = %d\n", pthread_self(), rc );
+
+   fuse_reply_err( req, -rc );
+}
+
+
+/** Get extended attributes.  A size of 0 asks for the value's length. */
+void syndicatefs_ll_getxattr( fuse_req_t req, fuse_ino_t ino, const char* name, size_t size ) {
+
+   struct syndicatefs_ll_state* ll = SYNDICATEFS_LL_DATA( req );
+   struct syndicate_state* state = ll->state;
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_getxattr( %lx, %s, %d )\n", pthread_self(), ino, name, size );
+
+   state->stats->enter( STAT_GETXATTR );
+
+   char* path = NULL;
+   char* value = NULL;
+   ssize_t rc = 0;
+
+   if( size > 0 ) {
+
+      value = SG_CALLOC( char, size );
+      if( value == NULL ) {
+         rc = -ENOMEM;
+      }
+   }
+
+   if( rc == 0 ) {
+      rc = syndicatefs_ll_get_path( ll, ino, &path );
+   }
+
+   if( rc == 0 ) {
+
+      rc = fs_entry_getxattr( state->core, path, name, value, size, state->conf.owner, state->core->volume );
+      free( path );
+   }
+
+   state->stats->leave( STAT_GETXATTR, (rc >= 0 ? 0 : rc) );
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_getxattr rc = %ld\n", pthread_self(), rc );
+
+   if( rc < 0 ) {
+      fuse_reply_err( req, -rc );
+   }
+   else if( size == 0 ) {
+      fuse_reply_xattr( req, rc );
+   }
+   else {
+      fuse_reply_buf( req, value, rc );
+   }
+
+   SG_safe_free( value );
+}
+
+
+/** List extended attributes.  A size of 0 asks for the list's length. */
+void syndicatefs_ll_listxattr( fuse_req_t req, fuse_ino_t ino, size_t size ) {
+
+   struct syndicatefs_ll_state* ll = SYNDICATEFS_LL_DATA( req );
+   struct syndicate_state* state = ll->state;
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_listxattr( %lx, %d )\n", pthread_self(), ino, size );
+
+   state->stats->enter( STAT_LISTXATTR );
+
+   char* path = NULL;
+   char* list = NULL;
+   ssize_t rc = 0;
+
+   if( size > 0 ) {
+
+      list = SG_CALLOC( char, size );
+      if( list == NULL ) {
+         rc = -ENOMEM;
+      }
+   }
+
+   if( rc == 0 ) {
+      rc = syndicatefs_ll_get_path( ll, ino, &path );
+   }
+
+   if( rc == 0 ) {
+
+      rc = fs_entry_listxattr( state->core, path, list, size, state->conf.owner, state->core->volume );
+      free( path );
+   }
+
+   state->stats->leave( STAT_LISTXATTR, (rc >= 0 ? 0 : rc) );
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_listxattr rc = %ld\n", pthread_self(), rc );
+
+   if( rc < 0 ) {
+      fuse_reply_err( req, -rc );
+   }
+   else if( size == 0 ) {
+      fuse_reply_xattr( req, rc );
+   }
+   else {
+      fuse_reply_buf( req, list, rc );
+   }
+
+   SG_safe_free( list );
+}
+
+
+/** Remove extended attributes */
+void syndicatefs_ll_removexattr( fuse_req_t req, fuse_ino_t ino, const char* name ) {
+
+   struct syndicatefs_ll_state* ll = SYNDICATEFS_LL_DATA( req );
+   struct syndicate_state* state = ll->state;
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_removexattr( %lx, %s )\n", pthread_self(), ino, name );
+
+   state->stats->enter( STAT_REMOVEXATTR );
+
+   char* path = NULL;
+
+   int rc = syndicatefs_ll_get_path( ll, ino, &path );
+   if( rc == 0 ) {
+
+      rc = fs_entry_removexattr( state->core, path, name, state->conf.owner, state->core->volume );
+      free( path );
+   }
+
+   state->stats->leave( STAT_REMOVEXATTR, rc );
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_removexattr rc = %d\n", pthread_self(), rc );
+
+   fuse_reply_err( req, -rc );
+}
+
+
+/** Check file access permissions */
+void syndicatefs_ll_access( fuse_req_t req, fuse_ino_t ino, int mask ) {
+
+   struct syndicatefs_ll_state* ll = SYNDICATEFS_LL_DATA( req );
+   struct syndicate_state* state = ll->state;
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_access( %lx, %x )\n", pthread_self(), ino, mask );
+
+   state->stats->enter( STAT_ACCESS );
+
+   char* path = NULL;
+
+   int rc = syndicatefs_ll_get_path( ll, ino, &path );
+   if( rc == 0 ) {
+
+      rc = fs_entry_access( state->core, path, mask, state->conf.owner, state->core->volume );
+      free( path );
+   }
+
+   state->stats->leave( STAT_ACCESS, rc );
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_access rc = %d\n", pthread_self(), rc );
+
+   fuse_reply_err( req, -rc );
+}
+
+
+/** Create and open a file */
+void syndicatefs_ll_create( fuse_req_t req, fuse_ino_t parent, const char* name, mode_t mode, struct fuse_file_info* fi ) {
+
+   struct syndicatefs_ll_state* ll = SYNDICATEFS_LL_DATA( req );
+   struct syndicate_state* state = ll->state;
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_create( %lx, %s, %o, %p )\n", pthread_self(), parent, name, mode, fi );
+
+   state->stats->enter( STAT_CREATE );
+
+   char* path = NULL;
+   struct fs_file_handle* fh = NULL;
+   struct fuse_entry_param e;
+
+   int rc = syndicatefs_ll_get_child_path( ll, parent, name, &path );
+   if( rc == 0 ) {
+
+      fh = fs_entry_create( state->core, path, state->conf.owner, state->core->volume, mode, &rc );
+
+      if( rc == 0 && fh == NULL ) {
+         rc = -ENOMEM;
+      }
+
+      if( rc == 0 ) {
+
+         // the new file's entry, as the kernel will see it
+         fs_entry_rlock( fh->fent );
+
+         rc = syndicatefs_ll_fill_entry( ll, fh->fent, path, &e );
+
+         fs_entry_unlock( fh->fent );
+
+         if( rc != 0 ) {
+
+            fs_entry_close( state->core, fh );
+            free( fh );
+            fh = NULL;
+         }
+      }
+
+      free( path );
+   }
+
+   state->stats->leave( STAT_CREATE, rc );
+
+   logmsg( state->logfile, "%16lx: syndicatefs_ll_create rc = %d\n", pthread_self(), rc );
+
+   if( rc != 0 ) {
+      fuse_reply_err( req, -rc );
+      return;
+   }
+
+   syndicatefs_ll_setup_file_info( fh, fi );
+
+   if( fuse_reply_create( req, &e, fi ) == -ENOENT ) {
+
+      // interrupted; the kernel won't release this handle or remember this lookup
+      fs_entry_close( state->core, fh );
+      free( fh );
+
+      fs_inode_table_forget( state->core, &ll->inodes, e.ino, 1 );
+   }
+}
+
+
+/** Initialize the filesystem */
+void syndicatefs_ll_init( void* userdata, struct fuse_conn_info* conn ) {
+
+#ifdef FUSE_CAP_SPLICE_WRITE
+   // let the kernel splice write data to us
+   if( conn->capable & FUSE_CAP_SPLICE_WRITE ) {
+      conn->want |= FUSE_CAP_SPLICE_WRITE;
+   }
+   if( conn->capable & FUSE_CAP_SPLICE_MOVE ) {
+      conn->want |= FUSE_CAP_SPLICE_MOVE;
+   }
+#endif
+
+   return;
+}
+
+
+/** Clean up the filesystem */
+void syndicatefs_ll_destroy( void* userdata ) {
+   return;
+}
+
+
+// queue an inode for the kernel to drop its cached pages.
+// called with the fs_entry write-locked, and a kernel reader may be waiting on it with pages locked,
+// so the notification itself gets sent from syndicatefs_ll_inval_main.
+static void syndicatefs_ll_cache_inval( struct fs_core* core, struct fs_entry* fent, void* cls ) {
+
+   struct syndicatefs_ll_state* ll = (struct syndicatefs_ll_state*)cls;
+   uint64_t ino = fs_inode_from_file_id( fent->file_id );
+
+   pthread_mutex_lock( &ll->inval_lock );
+
+   try {
+      ll->inval_queue->push_back( ino );
+   }
+   catch( bad_alloc& ba ) {
+
+      // the kernel will drop the pages on the next open anyway
+      pthread_mutex_unlock( &ll->inval_lock );
+      return;
+   }
+
+   pthread_mutex_unlock( &ll->inval_lock );
+
+   sem_post( &ll->inval_sem );
+}
+
+
+// tell the kernel to drop the cached pages of queued inodes
+static void* syndicatefs_ll_inval_main( void* arg ) {
+
+   struct syndicatefs_ll_state* ll = (struct syndicatefs_ll_state*)arg;
+
+   while( true ) {
+
+      sem_wait( &ll->inval_sem );
+
+      if( !ll->inval_running ) {
+         break;
+      }
+
+      vector<uint64_t> inos;
+
+      pthread_mutex_lock( &ll->inval_lock );
+
+      inos.swap( *ll->inval_queue );
+
+      pthread_mutex_unlock( &ll->inval_lock );
+
+      for( unsigned int i = 0; i < inos.size(); i++ ) {
+
+         int rc = fuse_lowlevel_notify_inval_inode( ll->ch, inos[i], 0, 0 );
+
+         // -ENOENT means the kernel has no such inode cached
+         if( rc != 0 && rc != -ENOENT ) {
+            SG_warn("fuse_lowlevel_notify_inval_inode(%" PRIX64 ") rc = %d\n", inos[i], rc );
+         }
+      }
+   }
+
+   return NULL;
+}
+
+
+// set up the inode table and cache invalidation
+static int syndicatefs_ll_state_init( struct syndicatefs_ll_state* ll, struct syndicate_state* state, struct fuse_chan* ch ) {
+
+   memset( ll, 0, sizeof(struct syndicatefs_ll_state) );
+
+   ll->state = state;
+   ll->ch = ch;
+
+   int rc = fs_inode_table_init( &ll->inodes );
+   if( rc != 0 ) {
+      return rc;
+   }
+
+   // the kernel knows the root without looking it up, and never forgets it
+   uint64_t root_ino = 0;
+
+   fs_entry_rlock( state->core->root );
+
+   rc = fs_inode_table_lookup( state->core, &ll->inodes, state->core->root, "/", &root_ino );
+
+   fs_entry_unlock( state->core->root );
+
+   if( rc != 0 ) {
+
+      fs_inode_table_free( state->core, &ll->inodes );
+      return rc;
+   }
+
+   ll->inval_queue = SG_safe_new( vector<uint64_t>() );
+   if( ll->inval_queue == NULL ) {
+
+      fs_inode_table_free( state->core, &ll->inodes );
+      return -ENOMEM;
+   }
+
+   pthread_mutex_init( &ll->inval_lock, NULL );
+   sem_init( &ll->inval_sem, 0, 0 );
+
+   ll->inval_running = true;
+
+   rc = pthread_create( &ll->inval_thread, NULL, syndicatefs_ll_inval_main, ll );
+   if( rc != 0 ) {
+
+      SG_error("pthread_create rc = %d\n", rc );
+
+      ll->inval_running = false;
+
+      SG_safe_delete( ll->inval_queue );
+      pthread_mutex_destroy( &ll->inval_lock );
+      sem_destroy( &ll->inval_sem );
+
+      fs_inode_table_free( state->core, &ll->inodes );
+      return -rc;
+   }
+
+   fs_core_set_cache_inval_callback( state->core, syndicatefs_ll_cache_inval, ll );
+
+   return 0;
+}
+
+
+// tear down the inode table and cache invalidation
+static int syndicatefs_ll_state_free( struct syndicatefs_ll_state* ll ) {
+
+   fs_core_set_cache_inval_callback( ll->state->core, NULL, NULL );
+
+   ll->inval_running = false;
+   sem_post( &ll->inval_sem );
+
+   pthread_join( ll->inval_thread, NULL );
+
+   SG_safe_delete( ll->inval_queue );
+   pthread_mutex_destroy( &ll->inval_lock );
+   sem_destroy( &ll->inval_sem );
+
+   fs_inode_table_free( ll->state->core, &ll->inodes );
+
+   return 0;
+}
+
+
+// handle extra options for FUSE
+static fuse_args g_fargs = FUSE_ARGS_INIT( 0, NULL );
+static bool g_single_threaded = false;
+
+int syndicatefs_ll_handle_fuse_opt( int fuse_opt, char* fuse_arg ) {
+   int rc = 0;
+   SG_debug("Fuse opt: -%c\n", fuse_opt);
+
+   switch( fuse_opt ) {
+
+      case 's': {
+         // single thread mode
+         g_single_threaded = true;
+         break;
+      }
+      case 'o': {
+         // some fuse argument
+         char* buf = SG_CALLOC( char, strlen(fuse_arg) + 3 );
+         sprintf(buf, "-o%s", fuse_arg );
+         fuse_opt_add_arg( &g_fargs, buf );
+         free( buf );
+         break;
+      }
+      default: {
+         rc = -1;
+         break;
+      }
+   }
+
+   return rc;
+}
+
+
+// combined option parser
+int syndicatefs_ll_handle_opt( int opt_c, char* opt_s ) {
+   // try to handle internal opt
+   int rc = UG_handle_opt( opt_c, opt_s );
+   if( rc != 0 ) {
+      // try to handle it as a FUSE opt
+      rc = syndicatefs_ll_handle_fuse_opt( opt_c, opt_s );
+   }
+   return rc;
+}
+
+
+// syndicatefs-ll-specific usage
+void syndicatefs_ll_usage() {
+   fprintf(stderr, "\n\
+syndicatefs-ll-specific options:\n\
+   -s\n\
+            Run single-threaded.\n\
+   -o ARG\n\
+            Pass a FUSE option.\n\
+\n");
+}
+
+
+// combined usage
+void usage( char const* progname ) {
+   md_common_usage( progname );
+   UG_usage();
+   syndicatefs_ll_usage();
+}
+
+// Program execution starts here!
+int main(int argc, char** argv) {
+
+   int fuse_stat = 0;
+   int rc = 0;
+   int fuse_optind = 0;
+
+   fuse_opt_add_arg( &g_fargs, argv[0] );
+
+   // prevent root from mounting this, since we don't really do much
+   // in the way of checking access.
+#ifndef _FIREWALL
+   if( getuid() == 0 || geteuid() == 0 ) {
+      perror("Running SyndicateFS as root opens unnacceptable security holes\n");
+      return 1;
+   }
+#endif
+
+   struct md_opts syn_opts;
+
+   memset( &syn_opts, 0, sizeof(struct md_opts));
+   UG_opts_init();
+
+   // get options
+   rc = md_opts_parse( &syn_opts, argc, argv, &fuse_optind, UG_SHORTOPTS "so:", syndicatefs_ll_handle_opt );
+   if( rc != 0 ) {
+      usage( argv[0] );
+      exit(1);
+   }
+
+   // get back UG opts
+   struct UG_opts ug_opts;
+   UG_opts_get( &ug_opts );
+
+   // get writes in chunks larger than a page, so whole blocks can reach the cache in one write
+   fuse_opt_add_arg( &g_fargs, "-obig_writes" );
+
+   // allow other users
+   fuse_opt_add_arg( &g_fargs, "-oallow_other" );
+
+   // we need a mountpoint
+   if( syn_opts.first_nonopt_arg == NULL ) {
+      usage( argv[0] );
+      fprintf(stderr, "You must give a mountpoint!\n");
+      exit(1);
+   }
+
+   // get absolute path to mountpoint
+   char* mountpoint = realpath( syn_opts.first_nonopt_arg, NULL );
+   if( mountpoint == NULL ) {
+      int errsv = errno;
+      fprintf(stderr, "syndicatefs-ll: realpath(%s) rc = %d\n", syn_opts.first_nonopt_arg, -errsv );
+      exit(1);
+   }
+
+   struct fuse_chan* ch = fuse_mount( mountpoint, &g_fargs );
+   if( ch == NULL ) {
+      fprintf(stderr, "syndicatefs-ll: failed to mount %s\n", mountpoint );
+      exit(1);
+   }
+
+   // detach before starting any threads, since they would not survive the fork
+   fuse_daemonize( syn_opts.foreground ? 1 : 0 );
+
+   struct md_HTTP syndicate_http;
+   memset( &syndicate_http, 0, sizeof(struct md_HTTP) );
+
+   // start core services
+   rc = syndicate_init( &syn_opts, &ug_opts );
+   if( rc != 0 ) {
+      fprintf(stderr, "Syndicate failed to initialize\n");
+      fuse_unmount( mountpoint, ch );
+      exit(1);
+   }
+
+   struct syndicate_state* state = syndicate_get_state();
+
+   rc = syndicatefs_ll_state_init( &g_ll, state, ch );
+   if( rc != 0 ) {
+      fprintf(stderr, "syndicatefs_ll_state_init rc = %d\n", rc );
+      fuse_unmount( mountpoint, ch );
+      exit(1);
+   }
+
+   // start back-end HTTP server
+   rc = SG_server_init( state, &syndicate_http );
+   if( rc != 0 ) {
+      fuse_unmount( mountpoint, ch );
+      exit(1);
+   }
+
+   // set as running
+   syndicate_set_running();
+
+   printf("\n\nSyndicateFS (low-level) starting up\n\n");
+
+   struct fuse_lowlevel_ops syndicatefs_ll_oper = get_syndicatefs_ll_opers();
+
+   struct fuse_session* se = fuse_lowlevel_new( &g_fargs, &syndicatefs_ll_oper, sizeof(syndicatefs_ll_oper), &g_ll );
+   if( se != NULL ) {
+
+      if( fuse_set_signal_handlers( se ) != -1 ) {
+
+         fuse_session_add_chan( se, ch );
+
+         // GO GO GO!!!
+         if( g_single_threaded ) {
+            fuse_stat = fuse_session_loop( se );
+         }
+         else {
+            fuse_stat = fuse_session_loop_mt( se );
+         }
+
+         fuse_remove_signal_handlers( se );
+         fuse_session_remove_chan( ch );
+      }
+
+      fuse_session_destroy( se );
+   }
+   else {
+      fuse_stat = -1;
+   }
+
+   SG_error( " fuse_session_loop returned %d\n", fuse_stat);
+
+   printf( "\n\nSyndicateFS (low-level) shutting down\n\n");
+
+   fuse_unmount( mountpoint, ch );
+   free( mountpoint );
+
+   SG_server_shutdown( &syndicate_http );
+
+   syndicatefs_ll_state_free( &g_ll );
+
+   int wait_replicas = -1;
+   if( !ug_opts.flush_replicas ) {
+      wait_replicas = 0;
+   }
+
+   syndicate_destroy( wait_replicas );
+
+   fuse_opt_free_args( &g_fargs );
+
+   curl_global_cleanup();
+   google::protobuf::ShutdownProtobufLibrary();
+
+   return fuse_stat;
+}
@@ -0,0 +1,100 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// this is the FUSE low-level interface to Syndicate.
+// Requests address inodes instead of paths, so lookups and getattrs on fresh entries skip path resolution.
+
+#ifndef _SYNDICATEFS_LL_H_
+#define _SYNDICATEFS_LL_H_
+
+#include "libsyndicate/libsyndicate.h"
+#include "stats.h"
+#include "log.h"
+#include "fs.h"
+#include "replication.h"
+#include "syndicate.h"
+#include "server.h"
+#include "opts.h"
+
+#define FUSE_USE_VERSION 28
+
+#include <signal.h>
+#include <semaphore.h>
+
+#include <fuse_lowlevel.h>
+
+// front-end state
+struct syndicatefs_ll_state {
+   struct syndicate_state* state;
+
+   struct fs_inode_table inodes;        // inodes the kernel knows about
+
+   struct fuse_chan* ch;                // kernel channel
+
+   // inodes whose cached pages the kernel should drop
+   vector<uint64_t>* inval_queue;
+   pthread_mutex_t inval_lock;
+   sem_t inval_sem;
+   pthread_t inval_thread;
+   bool inval_running;
+};
+
+#define SYNDICATEFS_LL_DATA( req ) ((struct syndicatefs_ll_state*)fuse_req_userdata( req ))
+
+extern "C" {
+
+// prototypes for FUSE low-level methods
+void syndicatefs_ll_init( void* userdata, struct fuse_conn_info* conn );
+void syndicatefs_ll_destroy( void* userdata );
+void syndicatefs_ll_lookup( fuse_req_t req, fuse_ino_t parent, const char* name );
+void syndicatefs_ll_forget( fuse_req_t req, fuse_ino_t ino, unsigned long nlookup );
+void syndicatefs_ll_getattr( fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* fi );
+void syndicatefs_ll_setattr( fuse_req_t req, fuse_ino_t ino, struct stat* attr, int to_set, struct fuse_file_info* fi );
+void syndicatefs_ll_readlink( fuse_req_t req, fuse_ino_t ino );
+void syndicatefs_ll_mknod( fuse_req_t req, fuse_ino_t parent, const char* name, mode_t mode, dev_t rdev );
+void syndicatefs_ll_mkdir( fuse_req_t req, fuse_ino_t parent, const char* name, mode_t mode );
+void syndicatefs_ll_unlink( fuse_req_t req, fuse_ino_t parent, const char* name );
+void syndicatefs_ll_rmdir( fuse_req_t req, fuse_ino_t parent, const char* name );
+void syndicatefs_ll_symlink( fuse_req_t req, const char* link, fuse_ino_t parent, const char* name );
+void syndicatefs_ll_rename( fuse_req_t req, fuse_ino_t parent, const char* name, fuse_ino_t newparent, const char* newname );
+void syndicatefs_ll_link( fuse_req_t req, fuse_ino_t ino, fuse_ino_t newparent, const char* newname );
+void syndicatefs_ll_open( fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* fi );
+void syndicatefs_ll_read( fuse_req_t req, fuse_ino_t ino, size_t size, off_t off, struct fuse_file_info* fi );
+void syndicatefs_ll_write( fuse_req_t req, fuse_ino_t ino, const char* buf, size_t size, off_t off, struct fuse_file_info* fi );
+void syndicatefs_ll_flush( fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* fi );
+void syndicatefs_ll_release( fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* fi );
+void syndicatefs_ll_fsync( fuse_req_t req, fuse_ino_t ino, int datasync, struct fuse_file_info* fi );
+void syndicatefs_ll_opendir( fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* fi );
+void syndicatefs_ll_readdir( fuse_req_t req, fuse_ino_t ino, size_t size, off_t off, struct fuse_file_info* fi );
+#ifdef FUSE_CAP_READDIRPLUS
+void syndicatefs_ll_readdirplus( fuse_req_t req, fuse_ino_t ino, size_t size, off_t off, struct fuse_file_info* fi );
+#endif
+void syndicatefs_ll_releasedir( fuse_req_t req, fuse_ino_t ino, struct fuse_file_info* fi );
+void syndicatefs_ll_fsyncdir( fuse_req_t req, fuse_ino_t ino, int datasync, struct fuse_file_info* fi );
+void syndicatefs_ll_statfs( fuse_req_t req, fuse_ino_t ino );
+void syndicatefs_ll_setxattr( fuse_req_t req, fuse_ino_t ino, const char* name, const char* value, size_t size, int flags );
+void syndicatefs_ll_getxattr( fuse_req_t req, fuse_ino_t ino, const char* name, size_t size );
+void syndicatefs_ll_listxattr( fuse_req_t req, fuse_ino_t ino, size_t size );
+void syndicatefs_ll_removexattr( fuse_req_t req, fuse_ino_t ino, const char* name );
+void syndicatefs_ll_access( fuse_req_t req, fuse_ino_t ino, int mask );
+void syndicatefs_ll_create( fuse_req_t req, fuse_ino_t parent, const char* name, mode_t mode, struct fuse_file_info* fi );
+
+// get the above functions as a fuse_lowlevel_ops structure
+struct fuse_lowlevel_ops get_syndicatefs_ll_opers();
+
+}
+
+#endif
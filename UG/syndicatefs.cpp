@@ -42,6 +42,9 @@ struct fuse_operations get_syndicatefs_opers() {
    fo.open = syndicatefs_open;
    fo.read = syndicatefs_read;
    fo.write = syndicatefs_write;
+#if FUSE_VERSION >= 29
+   fo.write_buf = syndicatefs_write_buf;
+#endif
    fo.statfs = syndicatefs_statfs;
    fo.flush = syndicatefs_flush;
    fo.release = syndicatefs_release;
@@ -266,8 +269,17 @@ int syndicatefs_open(const char *path, struct fuse_file_info *fi) {
    // store the read handle
    fi->fh = (uint64_t)fh;
 
-   // force direct I/O
-   fi->direct_io = 1;
+   if( fh != NULL ) {
+      
+      if( fh->is_AG ) {
+         // AG-hosted files don't know their sizes up front, so don't let the kernel cut reads short at st_size
+         fi->direct_io = 1;
+      }
+      else {
+         // let the kernel keep its cached pages, unless the file's data changed since they were read
+         fi->keep_cache = fs_file_handle_keep_cache( fh );
+      }
+   }
    
    SYNDICATEFS_DATA->stats->leave( STAT_OPEN, err );
    logmsg( SYNDICATEFS_DATA->logfile, "%16lx: syndicatefs_open rc = %d\n", pthread_self(), err );
@@ -323,6 +335,73 @@ int syndicatefs_write(const char *path, const char *buf, size_t size, off_t offs
 }
 
 
+#if FUSE_VERSION >= 29
+/** Write data to an open file from a FUSE buffer vector (pwrite).
+ *
+ * If FUSE hands us a single in-memory buffer, write straight out of it.
+ * Otherwise (i.e. the data is still in a spliced pipe), pull it into one buffer with a single copy first.
+ * Either way, fs_entry_write caches whole blocks directly from this buffer.
+ */
+int syndicatefs_write_buf(const char *path, struct fuse_bufvec *buf, off_t offset, struct fuse_file_info *fi) {
+   
+   size_t size = fuse_buf_size( buf );
+   
+   logmsg( SYNDICATEFS_DATA->logfile, "%16lx: syndicatefs_write_buf( %s, %p, %ld, %ld, %p )\n", pthread_self(), path, buf, size, offset, fi->fh );
+   
+   SYNDICATEFS_DATA->stats->enter( STAT_WRITE );
+   
+   struct fs_file_handle* fh = (struct fs_file_handle*)fi->fh;
+   
+   char* data = NULL;
+   char* data_copy = NULL;
+   ssize_t rc = 0;
+   
+   if( buf->count == 1 && buf->idx == 0 && !(buf->buf[0].flags & FUSE_BUF_IS_FD) ) {
+      
+      // already in RAM 
+      data = (char*)buf->buf[0].mem + buf->off;
+   }
+   else {
+      
+      // pull it in from the pipe 
+      data_copy = SG_CALLOC( char, size );
+      if( data_copy == NULL ) {
+         
+         SYNDICATEFS_DATA->stats->leave( STAT_WRITE, -ENOMEM );
+         return -ENOMEM;
+      }
+      
+      struct fuse_bufvec dest = FUSE_BUFVEC_INIT( size );
+      dest.buf[0].mem = data_copy;
+      
+      rc = fuse_buf_copy( &dest, buf, (enum fuse_buf_copy_flags)0 );
+      if( rc < 0 ) {
+         
+         logerr( SYNDICATEFS_DATA->logfile, "%16lx: syndicatefs_write_buf: fuse_buf_copy rc = %ld\n", pthread_self(), rc );
+         
+         free( data_copy );
+         SYNDICATEFS_DATA->stats->leave( STAT_WRITE, rc );
+         return (int)rc;
+      }
+      
+      size = rc;
+      data = data_copy;
+   }
+   
+   rc = fs_entry_write( SYNDICATEFS_DATA->core, fh, data, size, offset );
+   
+   if( data_copy != NULL ) {
+      free( data_copy );
+   }
+   
+   SYNDICATEFS_DATA->stats->leave( STAT_WRITE, (rc >= 0 ? 0 : rc)  );
+   
+   logmsg( SYNDICATEFS_DATA->logfile, "%16lx: syndicatefs_write_buf rc = %d\n", pthread_self(), rc );
+   return (int)rc;
+}
+#endif
+
+
 /** Get file system statistics
  *
  * The 'f_frsize', 'f_favail', 'f_fsid' and 'f_flag' fields are ignored
@@ -526,7 +605,34 @@ int syndicatefs_opendir(const char *path, struct fuse_file_info *fi) {
  * is full (or an error happens) the filler function will return
  * '1'.
  *
+ * We use mode 2:  an entry's offset is its position in the directory, so large listings get read a buffer at a time.
  */
+
+// arguments to syndicatefs_readdir_fill
+struct syndicatefs_readdir_cls {
+   void* buf;
+   fuse_fill_dir_t filler;
+};
+
+// feed one directory entry to FUSE
+static int syndicatefs_readdir_fill( struct fs_core* core, char const* name, int ftype, struct fs_entry* fent, off_t next_offset, void* cls ) {
+
+   struct syndicatefs_readdir_cls* args = (struct syndicatefs_readdir_cls*)cls;
+   struct stat sb;
+
+   memset( &sb, 0, sizeof(struct stat) );
+
+   if( fent != NULL ) {
+      sb.st_ino = fent->file_id;
+   }
+
+   sb.st_mode = (ftype == FTYPE_DIR ? S_IFDIR : S_IFREG);
+
+   // nonzero means the buffer is full
+   return (*args->filler)( args->buf, name, &sb, next_offset );
+}
+
+
 int syndicatefs_readdir(const char *path, void *buf, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info *fi) {
 
    
@@ -536,25 +642,11 @@ int syndicatefs_readdir(const char *path, void *buf, fuse_fill_dir_t filler, off
 
    struct fs_dir_handle* fdh = (struct fs_dir_handle *)fi->fh;     // get back our DIR instance
    
-   int rc = 0;
-   struct fs_dir_entry** dirents = fs_entry_readdir( SYNDICATEFS_DATA->core, fdh, &rc );
-   
-   if( rc == 0 && dirents ) {
-      
-      // fill in the directory data
-      int i = 0;
-      while( dirents[i] != NULL ) {
-         if( filler(buf, dirents[i]->data.name, NULL, 0) != 0 ) {
-            logerr( SYNDICATEFS_DATA->logfile, "%16lx: ERR: syndicatefs_readdir filler: buffer full\n");
-            rc = -ENOMEM;
-            break;
-         }
-         i++;
-      }
-   }
-   
-   fs_dir_entry_destroy_all( dirents );
-   free( dirents );
+   struct syndicatefs_readdir_cls args;
+   args.buf = buf;
+   args.filler = filler;
+
+   int rc = fs_entry_readdir_iter( SYNDICATEFS_DATA->core, fdh, offset, syndicatefs_readdir_fill, &args );
    
    logmsg( SYNDICATEFS_DATA->logfile, "%16lx: syndicatefs_readdir rc = %d\n", pthread_self(), rc );
    
@@ -702,6 +794,17 @@ int syndicatefs_fgetattr(const char *path, struct stat *statbuf, struct fuse_fil
 // (and this might as well return void, as it did in older versions of
 // FUSE).
 void *syndicatefs_init(struct fuse_conn_info *conn) {
+   
+#ifdef FUSE_CAP_SPLICE_WRITE
+   // let the kernel splice write data to us, so syndicatefs_write_buf can take it with one copy
+   if( conn->capable & FUSE_CAP_SPLICE_WRITE ) {
+      conn->want |= FUSE_CAP_SPLICE_WRITE;
+   }
+   if( conn->capable & FUSE_CAP_SPLICE_MOVE ) {
+      conn->want |= FUSE_CAP_SPLICE_MOVE;
+   }
+#endif
+   
    return SYNDICATEFS_DATA;
 }
 
@@ -812,9 +915,8 @@ int main(int argc, char** argv) {
    struct UG_opts ug_opts;
    UG_opts_get( &ug_opts );
    
-   // force direct io
-   // TODO: investigate kernel_cache, direct_io, atomic_o_truncate, big_writes, splice_*, auto_cache
-   fuse_opt_add_arg( &g_fargs, "-odirect_io" );
+   // get writes in chunks larger than a page, so whole blocks can reach the cache in one write
+   fuse_opt_add_arg( &g_fargs, "-obig_writes" );
    
    // allow other users 
    fuse_opt_add_arg( &g_fargs, "-oallow_other" );
@@ -854,6 +956,29 @@ int main(int argc, char** argv) {
    }
    
    struct syndicate_state* state = syndicate_get_state();
+   
+   // let the kernel cache entries and attributes for as long as we would consider them fresh for reading.
+   // file data stays in the page cache across opens, until we see that it changed (see syndicatefs_open).
+   if( state->conf.default_read_freshness > 0 ) {
+      
+      char entry_timeout_arg[100];
+      char attr_timeout_arg[100];
+      
+      sprintf( entry_timeout_arg, "-oentry_timeout=%lf", (double)state->conf.default_read_freshness / 1000.0 );
+      sprintf( attr_timeout_arg, "-oattr_timeout=%lf", (double)state->conf.default_read_freshness / 1000.0 );
+      
+      fuse_opt_add_arg( &g_fargs, entry_timeout_arg );
+      fuse_opt_add_arg( &g_fargs, attr_timeout_arg );
+   }
+   
+   // let the kernel remember nonexistent entries for as long as we do
+   if( state->conf.negative_cache_size > 0 && state->conf.negative_cache_ttl_ms > 0 ) {
+      
+      char negative_timeout_arg[100];
+      sprintf( negative_timeout_arg, "-onegative_timeout=%lf", (double)state->conf.negative_cache_ttl_ms / 1000.0 );
+      
+      fuse_opt_add_arg( &g_fargs, negative_timeout_arg );
+   }
 
    // start back-end HTTP server
    rc = SG_server_init( state, &syndicate_http );
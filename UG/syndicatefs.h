@@ -57,6 +57,9 @@ int syndicatefs_utime(const char *path, struct utimbuf *ubuf);
 int syndicatefs_open(const char *path, struct fuse_file_info *fi);
 int syndicatefs_read(const char *path, char *buf, size_t size, off_t offset, struct fuse_file_info *fi);
 int syndicatefs_write(const char *path, const char *buf, size_t size, off_t offset, struct fuse_file_info *fi);
+#if FUSE_VERSION >= 29
+int syndicatefs_write_buf(const char *path, struct fuse_bufvec *buf, off_t offset, struct fuse_file_info *fi);
+#endif
 int syndicatefs_statfs(const char *path, struct statvfs *statv);
 int syndicatefs_flush(const char *path, struct fuse_file_info *fi);
 int syndicatefs_release(const char *path, struct fuse_file_info *fi);
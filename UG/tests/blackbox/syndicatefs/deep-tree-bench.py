@@ -0,0 +1,93 @@
+#!/usr/bin/python
+
+# Deep-tree metadata benchmark.
+# Builds a tree DEPTH directories deep, with FANOUT files in each directory, beneath a directory in a mounted
+# syndicatefs, and then stats every file in the tree NUM_ROUNDS times and reports the rate of each round.
+# Run it once against a syndicatefs mount and once against a syndicatefs-ll mount of the same Volume to compare
+# the two front-ends: syndicatefs resolves every path from the root on each stat, while syndicatefs-ll looks up
+# each fresh entry directly by its inode.
+
+import os
+import sys
+import time
+
+def usage( progname ):
+   print "Usage: %s /path/to/mounted/dir DEPTH FANOUT NUM_ROUNDS" % progname
+   sys.exit(1)
+
+
+def make_tree( root, depth, fanout ):
+   paths = []
+   cur = root
+
+   for i in xrange(0, depth):
+      cur = os.path.join( cur, "d%d" % i )
+      os.mkdir( cur )
+
+      for j in xrange(0, fanout):
+         path = os.path.join( cur, "f%d" % j )
+         fd = open( path, "w" )
+         fd.close()
+
+         paths.append( path )
+
+   return paths
+
+
+def remove_tree( root, depth, fanout ):
+   dirs = []
+   cur = root
+
+   for i in xrange(0, depth):
+      cur = os.path.join( cur, "d%d" % i )
+      dirs.append( cur )
+
+   dirs.reverse()
+
+   for d in dirs:
+      for j in xrange(0, fanout):
+         os.unlink( os.path.join( d, "f%d" % j ) )
+
+      os.rmdir( d )
+
+
+if __name__ == "__main__":
+
+   if len(sys.argv) != 5:
+      usage( sys.argv[0] )
+
+   root = sys.argv[1]
+
+   try:
+      depth = int(sys.argv[2])
+      fanout = int(sys.argv[3])
+      num_rounds = int(sys.argv[4])
+   except:
+      usage( sys.argv[0] )
+
+   if depth <= 0 or fanout <= 0 or num_rounds <= 0:
+      usage( sys.argv[0] )
+
+   start = time.time()
+   paths = make_tree( root, depth, fanout )
+   elapsed = time.time() - start
+
+   print "created %d files in %d directories in %.3f seconds" % (len(paths), depth, elapsed)
+
+   total = 0.0
+
+   for i in xrange(0, num_rounds):
+
+      start = time.time()
+
+      for path in paths:
+         os.stat( path )
+
+      elapsed = time.time() - start
+      total += elapsed
+
+      print "round %d: %d stats in %.3f seconds (%.1f stats/sec)" % (i, len(paths), elapsed, len(paths) / elapsed)
+
+   print "average: %.1f stats/sec" % ((len(paths) * num_rounds) / total)
+
+   remove_tree( root, depth, fanout )
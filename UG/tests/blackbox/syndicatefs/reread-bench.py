@@ -0,0 +1,68 @@
+#!/usr/bin/python
+
+# Re-read benchmark.
+# Reads each of the given files in its entirety NUM_ROUNDS times through a mounted syndicatefs, and reports the
+# throughput of each round.  The files are not changed in between, so once the first round has pulled them in,
+# the later rounds should be served from the kernel's page cache without reaching syndicatefs.
+
+import os
+import sys
+import time
+
+CHUNK_SIZE = 1024 * 1024
+
+def usage( progname ):
+   print "Usage: %s NUM_ROUNDS /path/to/file [/path/to/file...]" % progname
+   sys.exit(1)
+
+
+def read_all( path ):
+   fd = open( path, "r" )
+   total = 0
+
+   while True:
+      buf = fd.read( CHUNK_SIZE )
+      if len(buf) == 0:
+         break
+
+      total += len(buf)
+
+   fd.close()
+   return total
+
+
+if __name__ == "__main__":
+
+   if len(sys.argv) < 3:
+      usage( sys.argv[0] )
+
+   try:
+      num_rounds = int(sys.argv[1])
+   except:
+      usage( sys.argv[0] )
+
+   if num_rounds <= 0:
+      usage( sys.argv[0] )
+
+   paths = sys.argv[2:]
+   warm_bytes = 0
+   warm_time = 0.0
+
+   for i in xrange(0, num_rounds):
+
+      round_bytes = 0
+      start = time.time()
+
+      for path in paths:
+         round_bytes += read_all( path )
+
+      elapsed = time.time() - start
+
+      print "round %d: %d bytes in %.6f s (%.3f MB/s)" % (i, round_bytes, elapsed, (round_bytes / (1024.0 * 1024.0)) / max(elapsed, 1e-9))
+
+      if i > 0:
+         warm_bytes += round_bytes
+         warm_time += elapsed
+
+   if num_rounds > 1:
+      print "warm rounds: %.3f MB/s" % ((warm_bytes / (1024.0 * 1024.0)) / max(warm_time, 1e-9))
@@ -0,0 +1,119 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Import-style lookup storm benchmark.
+// Searches each directory on a search path for NUM_MODULES module names, the way an interpreter resolves imports:
+// for each module, it stats a handful of candidate names in each directory until one exists.  Nearly all of these
+// lookups miss, so with negative entry caching only the first round should reach the MS.
+// Repeats the whole search ROUNDS times, and reports the lookups per second for each round.
+
+#include "common.h"
+
+// candidate names for module "m"
+static char const* candidate_fmts[] = {
+   "%s/%s.so",
+   "%s/%smodule.so",
+   "%s/%s.py",
+   "%s/%s.pyc",
+   "%s/%s/__init__.py",
+   NULL
+};
+
+void usage( char* progname ) {
+   printf("Usage %s [syndicate options] NUM_MODULES ROUNDS /search/dir [/search/dir...]\n", progname );
+   exit(1);
+}
+
+int main( int argc, char** argv ) {
+
+   struct md_HTTP syndicate_http;
+
+   int test_optind = -1;
+   struct timespec ts, ts2;
+
+   // set up the test
+   syndicate_functional_test_init( argc, argv, &test_optind, &syndicate_http );
+
+   if( test_optind < 0 )
+      usage( argv[0] );
+
+   if( test_optind + 2 >= argc )
+      usage( argv[0] );
+
+   uint64_t num_modules = (uint64_t)strtoull( argv[test_optind], NULL, 10 );
+   uint64_t num_rounds = (uint64_t)strtoull( argv[test_optind+1], NULL, 10 );
+
+   char** search_dirs = argv + test_optind + 2;
+   int num_search_dirs = argc - test_optind - 2;
+
+   if( num_modules == 0 || num_rounds == 0 )
+      usage( argv[0] );
+
+   // get state
+   struct syndicate_state* state = syndicate_get_state();
+
+   char path[PATH_MAX];
+   char module_name[100];
+   struct stat sb;
+
+   for( uint64_t r = 0; r < num_rounds; r++ ) {
+
+      uint64_t num_lookups = 0;
+      uint64_t num_found = 0;
+
+      SG_BEGIN_TIMING_DATA( ts );
+
+      for( uint64_t m = 0; m < num_modules; m++ ) {
+
+         bool found = false;
+
+         sprintf( module_name, "module%" PRIu64, m );
+
+         for( int d = 0; d < num_search_dirs && !found; d++ ) {
+
+            for( int c = 0; candidate_fmts[c] != NULL && !found; c++ ) {
+
+               snprintf( path, PATH_MAX, candidate_fmts[c], search_dirs[d], module_name );
+
+               int rc = fs_entry_stat( state->core, path, &sb, SG_SYS_USER, state->core->volume );
+
+               num_lookups++;
+
+               if( rc == 0 ) {
+                  found = true;
+                  num_found++;
+               }
+               else if( rc != -ENOENT ) {
+                  SG_error("\n\n\nfs_entry_stat( %s ) rc = %d\n\n\n", path, rc );
+               }
+            }
+         }
+      }
+
+      SG_END_TIMING_DATA( ts, ts2, "import storm round" );
+
+      double elapsed = ((double)(ts2.tv_nsec - ts.tv_nsec) + (double)(1e9 * (ts2.tv_sec - ts.tv_sec))) / 1e9;
+
+      SG_TIMING_DATA( "lookups/s", (double)num_lookups / elapsed );
+
+      printf("round %" PRIu64 ": %" PRIu64 " lookups, %" PRIu64 " modules found\n", r, num_lookups, num_found );
+   }
+
+   // shut down the test
+   syndicate_functional_test_shutdown( &syndicate_http );
+
+   return 0;
+}
@@ -0,0 +1,133 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Random small-write benchmark.
+// Makes NUM_WRITES writes of WRITE_SIZE bytes at random offsets within an existing file, then fsyncs it, and reports
+// the time spent in each.  Run it against a file coordinated by another gateway to measure what partial-block writes
+// cost when the blocks they patch are remote.
+
+#include "common.h"
+
+void usage( char* progname ) {
+   printf("Usage %s [syndicate options] /path/to/existing/file NUM_WRITES WRITE_SIZE [SEED]\n", progname );
+   exit(1);
+}
+
+int main( int argc, char** argv ) {
+
+   struct md_HTTP syndicate_http;
+
+   int test_optind = -1;
+   struct timespec ts, ts2;
+
+   // set up the test
+   syndicate_functional_test_init( argc, argv, &test_optind, &syndicate_http );
+
+   if( test_optind < 0 )
+      usage( argv[0] );
+
+   if( test_optind + 2 >= argc )
+      usage( argv[0] );
+
+   char* path = argv[test_optind];
+   uint64_t num_writes = (uint64_t)strtoull( argv[test_optind+1], NULL, 10 );
+   size_t write_size = (size_t)strtoull( argv[test_optind+2], NULL, 10 );
+   unsigned int seed = 0;
+
+   if( test_optind + 3 < argc ) {
+      seed = (unsigned int)strtoul( argv[test_optind+3], NULL, 10 );
+   }
+
+   if( num_writes == 0 || write_size == 0 )
+      usage( argv[0] );
+
+   srand( seed );
+
+   // get state
+   struct syndicate_state* state = syndicate_get_state();
+
+   char* buf = SG_CALLOC( char, write_size );
+   if( buf == NULL ) {
+      exit( ENOMEM );
+   }
+
+   for( size_t i = 0; i < write_size; i++ ) {
+      buf[i] = 'A' + (i % 26);
+   }
+
+   // open the file
+   int rc = 0;
+   struct fs_file_handle* fh = fs_entry_open( state->core, path, SG_SYS_USER, state->core->volume, O_WRONLY, 0755, &rc );
+
+   if( fh == NULL || rc != 0 ) {
+      SG_error("\n\n\nfs_entry_open( %s ) rc = %d\n\n\n", path, rc );
+      exit(1);
+   }
+
+   fs_entry_rlock( fh->fent );
+   off_t file_size = fh->fent->size;
+   fs_entry_unlock( fh->fent );
+
+   if( file_size <= (off_t)write_size ) {
+      SG_error("\n\n\n%s is only %jd bytes; need more than %zu\n\n\n", path, file_size, write_size );
+      exit(1);
+   }
+
+   SG_BEGIN_TIMING_DATA( ts );
+
+   // write at random offsets within the file, so the writes patch existing blocks
+   for( uint64_t i = 0; i < num_writes; i++ ) {
+
+      off_t offset = (off_t)(((uint64_t)rand() * (RAND_MAX + 1ULL) + rand()) % (file_size - write_size));
+
+      ssize_t nw = fs_entry_write( state->core, fh, buf, write_size, offset );
+      if( nw < 0 || (size_t)nw != write_size ) {
+         SG_error("\n\n\nfs_entry_write( %s, %zu, %jd ) rc = %zd\n\n\n", path, write_size, offset, nw );
+         exit(1);
+      }
+   }
+
+   SG_END_TIMING_DATA( ts, ts2, "random write" );
+
+   double elapsed = ((double)(ts2.tv_nsec - ts.tv_nsec) + (double)(1e9 * (ts2.tv_sec - ts.tv_sec))) / 1e9;
+
+   SG_TIMING_DATA( "writes/s", (double)num_writes / elapsed );
+
+   // push the data; any deferred block fetches happen here
+   SG_BEGIN_TIMING_DATA( ts );
+
+   rc = fs_entry_fsync( state->core, fh );
+   if( rc != 0 ) {
+      SG_error("\n\n\nfs_entry_fsync( %s ) rc = %d\n\n\n", path, rc );
+      exit(1);
+   }
+
+   SG_END_TIMING_DATA( ts, ts2, "fsync" );
+
+   rc = fs_entry_close( state->core, fh );
+   if( rc != 0 ) {
+      SG_error("\n\n\nfs_entry_close( %s ) rc = %d\n\n\n", path, rc );
+      exit(1);
+   }
+
+   free( fh );
+   free( buf );
+
+   // shut down the test
+   syndicate_functional_test_shutdown( &syndicate_http );
+
+   return 0;
+}
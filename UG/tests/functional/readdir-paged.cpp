@@ -0,0 +1,172 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// list a directory a page at a time with fs_entry_readdir_iter, and check that the pages add up to the whole listing.
+
+#include "common.h"
+
+#include <set>
+
+void usage( char* progname ) {
+   printf("Usage %s [syndicate options] /path/to/dir PAGE_SIZE\n", progname );
+   exit(1);
+}
+
+// one page of a listing
+struct page_cls {
+   int page_size;
+   int count;
+   off_t next_offset;
+   set<string>* names;
+   int duplicates;
+};
+
+// take entries until the page is full
+static int page_fill( struct fs_core* core, char const* name, int ftype, struct fs_entry* fent, off_t next_offset, void* cls ) {
+
+   struct page_cls* page = (struct page_cls*)cls;
+
+   if( page->count >= page->page_size ) {
+      return 1;
+   }
+
+   if( page->names->count( string(name) ) > 0 ) {
+      SG_error("Listed '%s' twice\n", name );
+      page->duplicates++;
+   }
+
+   page->names->insert( string(name) );
+
+   printf("   type=%d name=%s next_offset=%ld\n", ftype, name, next_offset );
+
+   page->count++;
+   page->next_offset = next_offset;
+
+   return 0;
+}
+
+int main( int argc, char** argv ) {
+
+   struct md_HTTP syndicate_http;
+
+   int test_optind = -1;
+
+   // set up the test
+   syndicate_functional_test_init( argc, argv, &test_optind, &syndicate_http );
+
+   // arguments: readdir-paged [syndicate options] /path/to/dir PAGE_SIZE
+   if( test_optind < 0 )
+      usage( argv[0] );
+
+   if( test_optind + 1 >= argc )
+      usage( argv[0] );
+
+   // get path
+   char* path = argv[test_optind];
+
+   int page_size = atoi( argv[test_optind + 1] );
+   if( page_size <= 0 )
+      usage( argv[0] );
+
+   // get state
+   struct syndicate_state* state = syndicate_get_state();
+
+   int rc = 0;
+
+   // open the directory
+   SG_debug("\n\n\nfs_entry_opendir( %s )\n\n\n", path );
+
+   struct fs_dir_handle* fdh = fs_entry_opendir( state->core, path, SG_SYS_USER, state->core->volume, &rc );
+
+   if( rc != 0 ) {
+      SG_error("\n\n\nfs_entry_opendir( %s ) rc = %d\n\n\n", path, rc );
+      exit(1);
+   }
+
+   // read the whole directory, for reference
+   struct fs_dir_entry** dirents = fs_entry_readdir( state->core, fdh, &rc );
+
+   if( rc != 0 ) {
+      SG_error("\n\n\nfs_entry_readdir( %s ) rc = %d\n\n\n", path, rc );
+      exit(1);
+   }
+
+   int64_t num_ents = 0;
+   for( int i = 0; dirents[i] != NULL; i++ ) {
+      num_ents++;
+   }
+
+   fs_dir_entry_destroy_all( dirents );
+   free( dirents );
+
+   // read it again, a page at a time
+   set<string> names;
+   off_t offset = 0;
+   int num_pages = 0;
+   int duplicates = 0;
+
+   while( true ) {
+
+      struct page_cls page;
+      memset( &page, 0, sizeof(struct page_cls) );
+
+      page.page_size = page_size;
+      page.next_offset = offset;
+      page.names = &names;
+
+      SG_debug("\n\n\nfs_entry_readdir_iter( %s, %ld )\n\n\n", path, offset );
+
+      rc = fs_entry_readdir_iter( state->core, fdh, offset, page_fill, &page );
+      if( rc != 0 ) {
+         SG_error("\n\n\nfs_entry_readdir_iter( %s, %ld ) rc = %d\n\n\n", path, offset, rc );
+         exit(1);
+      }
+
+      duplicates += page.duplicates;
+
+      if( page.count == 0 ) {
+         break;
+      }
+
+      num_pages++;
+      offset = page.next_offset;
+
+      printf("page %d: %d entries\n", num_pages, page.count );
+   }
+
+   printf("\n\n");
+
+   printf("read %zu entries of %s in %d pages (%" PRId64 " in one listing)\n", names.size(), path, num_pages, num_ents );
+
+   // close the directory
+   rc = fs_entry_closedir( state->core, fdh );
+   if( rc != 0 ) {
+      SG_error("\n\n\nfs_entry_closedir( %s ) rc = %d\n\n\n", path, rc );
+      exit(1);
+   }
+
+   free( fdh );
+
+   // shut down the test
+   syndicate_functional_test_shutdown( &syndicate_http );
+
+   if( duplicates != 0 || (int64_t)names.size() != num_ents ) {
+      SG_error("Paged listing of %s does not match the full listing\n", path );
+      exit(1);
+   }
+
+   return 0;
+}
@@ -0,0 +1,177 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Remote write stress test.
+// Creates a file, then has NUM_THREADS threads each hand NUM_WRITES WriteMsgs for it to the coordinator logic, as the
+// server would on receipt from remote writers.  Concurrent messages get batched, so the throughput should grow
+// with NUM_THREADS instead of being capped at one MS update per write.
+// NOTE: the messages only update metadata; no block data is sent.
+
+#include "common.h"
+#include "libsyndicateUG/network.h"
+
+char* global_path = NULL;
+struct syndicate_state* global_state = NULL;
+uint64_t global_num_writes = 0;
+int global_num_failures = 0;
+
+uint64_t global_file_id = 0;
+int64_t global_file_version = 0;
+uint64_t global_coordinator_id = 0;
+
+void usage( char* progname ) {
+   printf("Usage %s [syndicate options] /path/to/file NUM_WRITES NUM_THREADS\n", progname );
+   exit(1);
+}
+
+
+void* remote_write_main( void* arg ) {
+
+   uint64_t thread_id = *(uint64_t*)arg;
+   struct fs_core* core = global_state->core;
+
+   unsigned char* hash = SG_CALLOC( unsigned char, BLOCK_HASH_LEN() );
+
+   for( uint64_t i = 0; i < global_num_writes; i++ ) {
+
+      Serialization::WriteMsg write_msg;
+
+      fs_entry_init_write_message( &write_msg, core, Serialization::WriteMsg::WRITE );
+
+      // each thread writes its own block
+      Serialization::FileMetadata* file_md = write_msg.mutable_metadata();
+
+      file_md->set_fs_path( string(global_path) );
+      file_md->set_volume_id( core->volume );
+      file_md->set_file_id( global_file_id );
+      file_md->set_file_version( global_file_version );
+      file_md->set_size( (thread_id + 1) * core->blocking_factor );
+      file_md->set_write_nonce( 0 );
+      file_md->set_coordinator_id( global_coordinator_id );
+
+      Serialization::BlockInfo* msg_binfo = write_msg.add_blocks();
+
+      msg_binfo->set_block_id( thread_id );
+      msg_binfo->set_block_version( fs_entry_next_block_version() );
+      msg_binfo->set_hash( string( (char const*)hash, BLOCK_HASH_LEN() ) );
+
+      int rc = fs_entry_remote_write_batched( core, global_path, global_file_id, global_file_version, global_coordinator_id, &write_msg );
+      if( rc != 0 ) {
+
+         SG_error("\n\n\nfs_entry_remote_write_batched('%s') rc = %d\n\n\n", global_path, rc );
+
+         __sync_fetch_and_add( &global_num_failures, 1 );
+      }
+   }
+
+   free( hash );
+
+   return NULL;
+}
+
+
+int main( int argc, char** argv ) {
+
+   struct md_HTTP syndicate_http;
+
+   int test_optind = -1;
+   uint64_t num_threads = 0;
+   struct timespec ts, ts2;
+
+   // set up the test
+   syndicate_functional_test_init( argc, argv, &test_optind, &syndicate_http );
+
+   if( test_optind < 0 ) {
+      usage( argv[0] );
+   }
+
+   if( test_optind + 2 >= argc ) {
+      usage( argv[0] );
+   }
+
+   global_path = argv[test_optind];
+   global_state = syndicate_get_state();
+
+   global_num_writes = (uint64_t)strtoull( argv[test_optind+1], 0, 10 );
+   num_threads = (uint64_t)strtoull( argv[test_optind+2], 0, 10 );
+
+   if( global_num_writes == 0 || num_threads == 0 ) {
+      usage( argv[0] );
+   }
+
+   // create the file, and remember what remote writers would need to know about it
+   int rc = 0;
+   struct fs_file_handle* fh = fs_entry_create( global_state->core, global_path, SG_SYS_USER, global_state->core->volume, 0755, &rc );
+
+   if( fh == NULL || rc != 0 ) {
+      SG_error("\n\n\nfs_entry_create( %s ) rc = %d\n\n\n", global_path, rc );
+      exit(1);
+   }
+
+   fs_entry_rlock( fh->fent );
+
+   global_file_id = fh->fent->file_id;
+   global_file_version = fh->fent->version;
+   global_coordinator_id = fh->fent->coordinator;
+
+   fs_entry_unlock( fh->fent );
+
+   // start up threads
+   pthread_t* threads = SG_CALLOC( pthread_t, num_threads );
+   uint64_t* thread_ids = SG_CALLOC( uint64_t, num_threads );
+
+   if( threads == NULL || thread_ids == NULL ) {
+      exit( ENOMEM );
+   }
+
+   SG_BEGIN_TIMING_DATA( ts );
+
+   for( uint64_t i = 0; i < num_threads; i++ ) {
+
+      pthread_attr_t attrs;
+      pthread_attr_init( &attrs );
+
+      thread_ids[i] = i;
+      pthread_create( &threads[i], &attrs, remote_write_main, &thread_ids[i] );
+   }
+
+   for( uint64_t i = 0; i < num_threads; i++ ) {
+
+      pthread_join( threads[i], NULL );
+   }
+
+   SG_END_TIMING_DATA( ts, ts2, "remote writes" );
+
+   double elapsed = ((double)(ts2.tv_nsec - ts.tv_nsec) + (double)(1e9 * (ts2.tv_sec - ts.tv_sec))) / 1e9;
+
+   SG_TIMING_DATA( "writes/s", (double)(global_num_writes * num_threads) / elapsed );
+
+   rc = fs_entry_close( global_state->core, fh );
+   if( rc != 0 ) {
+      SG_error("\n\n\nfs_entry_close( %s ) rc = %d\n\n\n", global_path, rc );
+   }
+
+   free( fh );
+   free( threads );
+   free( thread_ids );
+
+   // shut down the test
+   syndicate_functional_test_shutdown( &syndicate_http );
+
+   printf("\n\nTotal failures: %d\n", global_num_failures );
+
+   return 0;
+}
@@ -0,0 +1,305 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Rename storm stress test.
+// Has NUM_THREADS threads each create a file in the given directory and rename it NUM_RENAMES times in a row, while
+// another thread creates and unlinks files in the same directory and times its creates.  Since a rename only locks
+// the directory to move the entry, creates should not stall behind the renames' MS updates, and concurrent renames
+// should share MS requests.  Then, every thread renames its file onto the same name at once, and we check that
+// exactly one file survives there.
+
+#include "common.h"
+
+char* global_dir = NULL;
+uint64_t global_num_renames = 0;
+int global_num_failures = 0;
+
+struct syndicate_state* global_state = NULL;
+
+volatile bool global_storm_running = false;
+uint64_t global_num_creates = 0;
+double global_create_time = 0;
+double global_max_create_time = 0;
+
+void usage( char* progname ) {
+   printf("Usage %s [syndicate options] NUM_THREADS NUM_RENAMES /path/to/dir\n", progname );
+   exit(1);
+}
+
+
+// path to a renamer's file after its i'th rename
+void rename_storm_path( char* path, size_t len, uint64_t thread_id, uint64_t i ) {
+   snprintf( path, len, "%s/rename-storm-%" PRIu64 "-%" PRIu64, global_dir, thread_id, i );
+}
+
+
+// create a file, and close it
+int rename_storm_create( char const* path ) {
+
+   struct fs_core* core = global_state->core;
+   int rc = 0;
+
+   struct fs_file_handle* fh = fs_entry_create( core, path, SG_SYS_USER, core->volume, 0755, &rc );
+   if( fh == NULL || rc != 0 ) {
+      SG_error("\n\n\nfs_entry_create('%s') rc = %d\n\n\n", path, rc );
+      return (rc != 0 ? rc : -EIO);
+   }
+
+   rc = fs_entry_close( core, fh );
+   if( rc != 0 ) {
+      SG_error("\n\n\nfs_entry_close('%s') rc = %d\n\n\n", path, rc );
+   }
+
+   free( fh );
+   return rc;
+}
+
+
+void* rename_main( void* arg ) {
+
+   struct fs_core* core = global_state->core;
+   uint64_t thread_id = (uint64_t)arg;
+   char old_path[PATH_MAX];
+   char new_path[PATH_MAX];
+   struct stat sb;
+
+   for( uint64_t i = 0; i < global_num_renames; i++ ) {
+
+      rename_storm_path( old_path, PATH_MAX, thread_id, i );
+      rename_storm_path( new_path, PATH_MAX, thread_id, i + 1 );
+
+      int rc = fs_entry_rename( core, old_path, new_path, SG_SYS_USER, core->volume );
+      if( rc != 0 ) {
+
+         SG_error("\n\n\nfs_entry_rename('%s', '%s') rc = %d\n\n\n", old_path, new_path, rc );
+
+         __sync_fetch_and_add( &global_num_failures, 1 );
+         break;
+      }
+
+      // the old name must be gone, and the new one must be there
+      rc = fs_entry_stat( core, old_path, &sb, SG_SYS_USER, core->volume );
+      if( rc != -ENOENT ) {
+
+         SG_error("\n\n\nfs_entry_stat('%s') rc = %d, expected %d\n\n\n", old_path, rc, -ENOENT );
+
+         __sync_fetch_and_add( &global_num_failures, 1 );
+      }
+
+      rc = fs_entry_stat( core, new_path, &sb, SG_SYS_USER, core->volume );
+      if( rc != 0 ) {
+
+         SG_error("\n\n\nfs_entry_stat('%s') rc = %d\n\n\n", new_path, rc );
+
+         __sync_fetch_and_add( &global_num_failures, 1 );
+      }
+   }
+
+   return NULL;
+}
+
+
+// create and unlink files in the renamers' directory, and time the creates
+void* create_main( void* arg ) {
+
+   struct fs_core* core = global_state->core;
+   char path[PATH_MAX];
+   struct timespec ts, ts2;
+
+   while( global_storm_running ) {
+
+      snprintf( path, PATH_MAX, "%s/rename-storm-creat-%" PRIu64, global_dir, global_num_creates );
+
+      clock_gettime( CLOCK_MONOTONIC, &ts );
+
+      int rc = rename_storm_create( path );
+
+      clock_gettime( CLOCK_MONOTONIC, &ts2 );
+
+      if( rc != 0 ) {
+         __sync_fetch_and_add( &global_num_failures, 1 );
+         break;
+      }
+
+      double elapsed = ((double)(ts2.tv_nsec - ts.tv_nsec) + (double)(1e9 * (ts2.tv_sec - ts.tv_sec))) / 1e9;
+
+      global_create_time += elapsed;
+      global_num_creates++;
+
+      if( elapsed > global_max_create_time ) {
+         global_max_create_time = elapsed;
+      }
+
+      rc = fs_entry_unlink( core, path, SG_SYS_USER, core->volume );
+      if( rc != 0 ) {
+         SG_error("\n\n\nfs_entry_unlink('%s') rc = %d\n\n\n", path, rc );
+
+         __sync_fetch_and_add( &global_num_failures, 1 );
+         break;
+      }
+   }
+
+   return NULL;
+}
+
+
+// have every thread rename its file onto the same name, and check that exactly one of them is left there
+void* collide_main( void* arg ) {
+
+   struct fs_core* core = global_state->core;
+   uint64_t thread_id = (uint64_t)arg;
+   char old_path[PATH_MAX];
+   char new_path[PATH_MAX];
+
+   rename_storm_path( old_path, PATH_MAX, thread_id, global_num_renames );
+   snprintf( new_path, PATH_MAX, "%s/rename-storm-target", global_dir );
+
+   int rc = fs_entry_rename( core, old_path, new_path, SG_SYS_USER, core->volume );
+   if( rc != 0 ) {
+
+      SG_error("\n\n\nfs_entry_rename('%s', '%s') rc = %d\n\n\n", old_path, new_path, rc );
+
+      __sync_fetch_and_add( &global_num_failures, 1 );
+   }
+
+   return NULL;
+}
+
+
+// run num_threads threads with the given main
+void run_threads( uint64_t num_threads, void* (*thread_main)( void* ) ) {
+
+   pthread_t* threads = SG_CALLOC( pthread_t, num_threads );
+   if( threads == NULL ) {
+      exit( ENOMEM );
+   }
+
+   for( uint64_t i = 0; i < num_threads; i++ ) {
+
+      pthread_attr_t attrs;
+      pthread_attr_init( &attrs );
+
+      pthread_create( &threads[i], &attrs, thread_main, (void*)i );
+   }
+
+   for( uint64_t i = 0; i < num_threads; i++ ) {
+
+      pthread_join( threads[i], NULL );
+   }
+
+   free( threads );
+}
+
+
+int main( int argc, char** argv ) {
+
+   struct md_HTTP syndicate_http;
+
+   int test_optind = -1;
+   uint64_t num_threads = 0;
+   struct timespec ts, ts2;
+   pthread_t create_thread;
+   char path[PATH_MAX];
+   struct stat sb;
+
+   // set up the test
+   syndicate_functional_test_init( argc, argv, &test_optind, &syndicate_http );
+
+   if( test_optind < 0 ) {
+      usage( argv[0] );
+   }
+
+   if( test_optind + 2 >= argc ) {
+      usage( argv[0] );
+   }
+
+   global_state = syndicate_get_state();
+
+   num_threads = (uint64_t)strtoull( argv[test_optind], 0, 10 );
+   global_num_renames = (uint64_t)strtoull( argv[test_optind+1], 0, 10 );
+   global_dir = argv[test_optind+2];
+
+   if( num_threads == 0 || global_num_renames == 0 ) {
+      usage( argv[0] );
+   }
+
+   // give each renamer a file
+   for( uint64_t i = 0; i < num_threads; i++ ) {
+
+      rename_storm_path( path, PATH_MAX, i, 0 );
+
+      int rc = rename_storm_create( path );
+      if( rc != 0 ) {
+         exit(1);
+      }
+   }
+
+   // rename storm, with creates in the same directory
+   global_storm_running = true;
+   pthread_create( &create_thread, NULL, create_main, NULL );
+
+   SG_BEGIN_TIMING_DATA( ts );
+
+   run_threads( num_threads, rename_main );
+
+   SG_END_TIMING_DATA( ts, ts2, "rename storm" );
+
+   global_storm_running = false;
+   pthread_join( create_thread, NULL );
+
+   double elapsed = ((double)(ts2.tv_nsec - ts.tv_nsec) + (double)(1e9 * (ts2.tv_sec - ts.tv_sec))) / 1e9;
+
+   SG_TIMING_DATA( "renames/s", (double)(global_num_renames * num_threads) / elapsed );
+   SG_TIMING_DATA( "creates during storm", (double)global_num_creates );
+   SG_TIMING_DATA( "mean create time", (global_num_creates > 0 ? global_create_time / global_num_creates : 0.0) );
+   SG_TIMING_DATA( "max create time", global_max_create_time );
+
+   // everyone renames onto the same name
+   run_threads( num_threads, collide_main );
+
+   for( uint64_t i = 0; i < num_threads; i++ ) {
+
+      rename_storm_path( path, PATH_MAX, i, global_num_renames );
+
+      int rc = fs_entry_stat( global_state->core, path, &sb, SG_SYS_USER, global_state->core->volume );
+      if( rc != -ENOENT ) {
+
+         SG_error("\n\n\nfs_entry_stat('%s') rc = %d, expected %d\n\n\n", path, rc, -ENOENT );
+         global_num_failures++;
+      }
+   }
+
+   snprintf( path, PATH_MAX, "%s/rename-storm-target", global_dir );
+
+   int rc = fs_entry_stat( global_state->core, path, &sb, SG_SYS_USER, global_state->core->volume );
+   if( rc != 0 ) {
+
+      SG_error("\n\n\nfs_entry_stat('%s') rc = %d\n\n\n", path, rc );
+      global_num_failures++;
+   }
+   else {
+
+      // clean up
+      fs_entry_unlink( global_state->core, path, SG_SYS_USER, global_state->core->volume );
+   }
+
+   // shut down the test
+   syndicate_functional_test_shutdown( &syndicate_http );
+
+   printf("\n\nTotal failures: %d\n", global_num_failures );
+
+   return 0;
+}
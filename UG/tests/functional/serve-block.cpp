@@ -0,0 +1,259 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Block serving test.
+// The block GET handler serves a block either straight from the on-disk cache, or through fs_entry_read_block_local
+// (which runs the driver's read_block_postdown).  Peers must get the same bytes either way.  We write a block through a
+// driver that XORs blocks on write and XORs them back on read, and check that it is served in plaintext, and never from
+// the on-disk cache (which holds the XOR'ed bytes).  Then we put the original driver back, write another block, and
+// check that both ways of serving it agree.
+
+#include "common.h"
+#include "libsyndicateUG/driver.h"
+
+#define XOR_KEY 0x5a
+
+int global_num_failures = 0;
+
+#define CHECK( cond ) \
+   do { \
+      if( !(cond) ) { \
+         SG_error("\n\n\nFAILED: %s\n\n\n", #cond ); \
+         global_num_failures++; \
+      } \
+   } while( 0 )
+
+
+void usage( char* progname ) {
+   printf("Usage %s [syndicate options] /path/to/new/file\n", progname );
+   exit(1);
+}
+
+
+// XOR each byte of a block with XOR_KEY
+void xor_block( char const* in, char* out, size_t len ) {
+
+   for( size_t i = 0; i < len; i++ ) {
+      out[i] = in[i] ^ XOR_KEY;
+   }
+}
+
+// transforming driver: XOR blocks before they are cached and replicated...
+int xor_write_block_preup( struct fs_core* core, struct md_closure* closure, char const* fs_path, struct fs_entry* fent, uint64_t block_id, int64_t block_version,
+                           char const* in_block_data, size_t in_block_data_len, char** out_block_data, size_t* out_block_data_len, void* cls ) {
+
+   *out_block_data = SG_CALLOC( char, in_block_data_len );
+   *out_block_data_len = in_block_data_len;
+
+   xor_block( in_block_data, *out_block_data, in_block_data_len );
+   return 0;
+}
+
+// ...and XOR them back after they are read
+ssize_t xor_read_block_postdown( struct fs_core* core, struct md_closure* closure, char const* fs_path, struct fs_entry* fent, uint64_t block_id, int64_t block_version,
+                                 char const* in_block_data, size_t in_block_data_len, char* out_block_data, size_t out_block_data_len, void* cls ) {
+
+   size_t len = MIN( in_block_data_len, out_block_data_len );
+
+   xor_block( in_block_data, out_block_data, len );
+   return (ssize_t)len;
+}
+
+struct md_closure_callback_entry xor_driver_callbacks[] = {
+   {(char*)"write_block_preup", (void*)xor_write_block_preup},
+   {(char*)"read_block_postdown", (void*)xor_read_block_postdown},
+   {NULL, NULL}
+};
+
+
+// swap the closure's driver methods, and return the old ones
+void swap_driver( struct md_closure* closure, struct md_closure_callback_entry* callbacks, int running, struct md_closure_callback_entry** old_callbacks, int* old_running ) {
+
+   md_closure_wlock( closure );
+
+   *old_callbacks = closure->callbacks;
+   *old_running = closure->running;
+
+   closure->callbacks = callbacks;
+   closure->running = running;
+
+   md_closure_unlock( closure );
+}
+
+
+// write a block's worth of data at the given block, and flush it to the on-disk cache
+int write_block( struct fs_core* core, char const* path, int flags, uint64_t block_id, char const* data ) {
+
+   int rc = 0;
+
+   struct fs_file_handle* fh = fs_entry_open( core, path, SG_SYS_USER, core->volume, flags, 0755, &rc );
+   if( fh == NULL || rc != 0 ) {
+      SG_error("\n\n\nfs_entry_open( %s ) rc = %d\n\n\n", path, rc );
+      return (rc != 0 ? rc : -EIO);
+   }
+
+   ssize_t nw = fs_entry_write( core, fh, data, core->blocking_factor, block_id * core->blocking_factor );
+   if( nw != (ssize_t)core->blocking_factor ) {
+      SG_error("\n\n\nfs_entry_write( %s, %" PRIu64 " ) rc = %zd\n\n\n", path, block_id, nw );
+      rc = (nw < 0 ? (int)nw : -EIO);
+   }
+
+   if( rc == 0 ) {
+      rc = fs_entry_fsync( core, fh );
+      if( rc != 0 ) {
+         SG_error("\n\n\nfs_entry_fsync( %s ) rc = %d\n\n\n", path, rc );
+      }
+   }
+
+   int close_rc = fs_entry_close( core, fh );
+   if( close_rc != 0 ) {
+      SG_error("\n\n\nfs_entry_close( %s ) rc = %d\n\n\n", path, close_rc );
+   }
+
+   free( fh );
+
+   return rc;
+}
+
+
+// get a block from the on-disk cache, the way the block GET handler would if it could
+// return its length, or -ENOENT if the handler would not serve it from there
+ssize_t serve_block_from_cache( struct fs_core* core, char const* path, uint64_t block_id, char* buf, size_t len ) {
+
+   off_t block_len = 0;
+
+   int block_fd = fs_entry_open_block_local( core, path, block_id, &block_len );
+   if( block_fd < 0 ) {
+      return block_fd;
+   }
+
+   ssize_t nr = md_read_uninterrupted( block_fd, buf, MIN( len, (size_t)block_len ) );
+
+   close( block_fd );
+   return nr;
+}
+
+
+int main( int argc, char** argv ) {
+
+   struct md_HTTP syndicate_http;
+
+   int test_optind = -1;
+
+   // set up the test
+   syndicate_functional_test_init( argc, argv, &test_optind, &syndicate_http );
+
+   if( test_optind < 0 || test_optind >= argc )
+      usage( argv[0] );
+
+   char* path = argv[test_optind];
+
+   struct syndicate_state* state = syndicate_get_state();
+   struct fs_core* core = state->core;
+
+   if( core->closure == NULL ) {
+      SG_error("%s", "\n\n\nNo driver closure to test with\n\n\n");
+      exit(1);
+   }
+
+   size_t block_size = core->blocking_factor;
+
+   char* data = SG_CALLOC( char, block_size );
+   char* served = SG_CALLOC( char, block_size );
+   char* cached = SG_CALLOC( char, block_size );
+
+   for( size_t i = 0; i < block_size; i++ ) {
+      data[i] = (char)(i % 251);
+   }
+
+   // install the transforming driver
+   struct md_closure_callback_entry* old_callbacks = NULL;
+   int old_running = 0;
+
+   swap_driver( core->closure, xor_driver_callbacks, 1, &old_callbacks, &old_running );
+
+   int rc = write_block( core, path, O_WRONLY | O_CREAT, 0, data );
+   CHECK( rc == 0 );
+
+   if( rc == 0 ) {
+
+      // the on-disk cache holds the XOR'ed block, so it must not be served from there...
+      ssize_t nr = serve_block_from_cache( core, path, 0, cached, block_size );
+      SG_debug("\n\n\nserve_block_from_cache( %s, 0 ) with transforming driver rc = %zd\n\n\n", path, nr );
+
+      CHECK( nr == -ENOENT );
+
+      // ...and the block it is served instead must be plaintext
+      nr = fs_entry_read_block_local( core, path, 0, served, block_size );
+      SG_debug("\n\n\nfs_entry_read_block_local( %s, 0 ) with transforming driver rc = %zd\n\n\n", path, nr );
+
+      CHECK( nr == (ssize_t)block_size );
+      CHECK( memcmp( served, data, block_size ) == 0 );
+   }
+
+   // put the original driver back
+   struct md_closure_callback_entry* xor_callbacks = NULL;
+   int xor_running = 0;
+
+   swap_driver( core->closure, old_callbacks, old_running, &xor_callbacks, &xor_running );
+
+   for( size_t i = 0; i < block_size; i++ ) {
+      data[i] = (char)(block_size - i);
+   }
+
+   rc = write_block( core, path, O_WRONLY, 1, data );
+   CHECK( rc == 0 );
+
+   if( rc == 0 ) {
+
+      ssize_t nr = fs_entry_read_block_local( core, path, 1, served, block_size );
+      SG_debug("\n\n\nfs_entry_read_block_local( %s, 1 ) rc = %zd\n\n\n", path, nr );
+
+      CHECK( nr == (ssize_t)block_size );
+
+      // if the block is served from the on-disk cache, it must be the same bytes
+      ssize_t nr_cached = serve_block_from_cache( core, path, 1, cached, block_size );
+      SG_debug("\n\n\nserve_block_from_cache( %s, 1 ) rc = %zd\n\n\n", path, nr_cached );
+
+      if( driver_has_read_block_postdown( core->closure ) ) {
+         CHECK( nr_cached == -ENOENT );
+      }
+      else if( nr_cached >= 0 ) {
+         CHECK( nr_cached == nr );
+         CHECK( memcmp( cached, served, block_size ) == 0 );
+      }
+   }
+
+   rc = fs_entry_unlink( core, path, SG_SYS_USER, core->volume );
+   if( rc != 0 ) {
+      SG_error("\n\n\nfs_entry_unlink( %s ) rc = %d\n\n\n", path, rc );
+   }
+
+   free( data );
+   free( served );
+   free( cached );
+
+   // shut down the test
+   syndicate_functional_test_shutdown( &syndicate_http );
+
+   if( global_num_failures != 0 ) {
+      printf("%d checks failed\n", global_num_failures );
+      return 1;
+   }
+
+   printf("all checks passed\n");
+   return 0;
+}
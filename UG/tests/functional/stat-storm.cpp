@@ -0,0 +1,191 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Stat storm benchmark.
+// Has NUM_THREADS threads each stat every given path NUM_STATS times, and reports the aggregate stats per second.
+// Each stat revalidates its path, so with metadata leases on the directories along it, most stats should be
+// answered from cache instead of going to the MS once the entries' max_read_freshness runs out.
+// The storm runs twice: once with every path walk locking each entry along the path (as it used to), and once with
+// lock-free path walks.  While it runs, a probe samples how often the root's lock is held, to show the contention on it.
+
+#include "common.h"
+
+char** global_paths = NULL;
+int global_num_paths = 0;
+uint64_t global_num_stats = 0;
+int global_num_failures = 0;
+
+struct syndicate_state* global_state = NULL;
+
+volatile bool global_storm_running = false;
+uint64_t global_root_probes = 0;
+uint64_t global_root_busy = 0;
+
+void usage( char* progname ) {
+   printf("Usage %s [syndicate options] NUM_THREADS NUM_STATS /path/to/entry [/path/to/entry...]\n", progname );
+   exit(1);
+}
+
+
+void* stat_main( void* arg ) {
+
+   struct fs_core* core = global_state->core;
+   struct stat sb;
+
+   for( uint64_t i = 0; i < global_num_stats; i++ ) {
+
+      for( int j = 0; j < global_num_paths; j++ ) {
+
+         int rc = fs_entry_stat( core, global_paths[j], &sb, SG_SYS_USER, core->volume );
+         if( rc != 0 ) {
+
+            SG_error("\n\n\nfs_entry_stat('%s') rc = %d\n\n\n", global_paths[j], rc );
+
+            __sync_fetch_and_add( &global_num_failures, 1 );
+         }
+      }
+   }
+
+   return NULL;
+}
+
+
+// sample how often the root's lock is held while the storm runs
+void* root_probe_main( void* arg ) {
+
+   struct fs_core* core = global_state->core;
+
+   while( global_storm_running ) {
+
+      int rc = pthread_rwlock_trywrlock( &core->root->lock );
+      if( rc == 0 ) {
+         pthread_rwlock_unlock( &core->root->lock );
+      }
+      else {
+         global_root_busy++;
+      }
+
+      global_root_probes++;
+
+      usleep( 100 );
+   }
+
+   return NULL;
+}
+
+
+// run the storm with num_threads threads
+// return the stats per second
+double run_storm( uint64_t num_threads, char const* label ) {
+
+   struct timespec ts, ts2;
+   pthread_t probe_thread;
+   char key[100];
+
+   pthread_t* threads = SG_CALLOC( pthread_t, num_threads );
+   if( threads == NULL ) {
+      exit( ENOMEM );
+   }
+
+   global_root_probes = 0;
+   global_root_busy = 0;
+   global_storm_running = true;
+
+   pthread_create( &probe_thread, NULL, root_probe_main, NULL );
+
+   SG_BEGIN_TIMING_DATA( ts );
+
+   for( uint64_t i = 0; i < num_threads; i++ ) {
+
+      pthread_attr_t attrs;
+      pthread_attr_init( &attrs );
+
+      pthread_create( &threads[i], &attrs, stat_main, NULL );
+   }
+
+   for( uint64_t i = 0; i < num_threads; i++ ) {
+
+      pthread_join( threads[i], NULL );
+   }
+
+   snprintf( key, 100, "stat storm (%s)", label );
+   SG_END_TIMING_DATA( ts, ts2, key );
+
+   global_storm_running = false;
+   pthread_join( probe_thread, NULL );
+
+   double elapsed = ((double)(ts2.tv_nsec - ts.tv_nsec) + (double)(1e9 * (ts2.tv_sec - ts.tv_sec))) / 1e9;
+   double rate = (double)(global_num_stats * num_threads * global_num_paths) / elapsed;
+
+   snprintf( key, 100, "stats/s (%s)", label );
+   SG_TIMING_DATA( key, rate );
+
+   snprintf( key, 100, "root lock busy fraction (%s)", label );
+   SG_TIMING_DATA( key, (global_root_probes > 0 ? (double)global_root_busy / (double)global_root_probes : 0.0) );
+
+   free( threads );
+
+   return rate;
+}
+
+
+int main( int argc, char** argv ) {
+
+   struct md_HTTP syndicate_http;
+
+   int test_optind = -1;
+   uint64_t num_threads = 0;
+
+   // set up the test
+   syndicate_functional_test_init( argc, argv, &test_optind, &syndicate_http );
+
+   if( test_optind < 0 ) {
+      usage( argv[0] );
+   }
+
+   if( test_optind + 2 >= argc ) {
+      usage( argv[0] );
+   }
+
+   global_state = syndicate_get_state();
+
+   num_threads = (uint64_t)strtoull( argv[test_optind], 0, 10 );
+   global_num_stats = (uint64_t)strtoull( argv[test_optind+1], 0, 10 );
+
+   global_paths = argv + test_optind + 2;
+   global_num_paths = argc - test_optind - 2;
+
+   if( num_threads == 0 || global_num_stats == 0 ) {
+      usage( argv[0] );
+   }
+
+   // with lock coupling...
+   global_state->core->rcu_walk = false;
+   double locked_rate = run_storm( num_threads, "locked" );
+
+   // ...and without
+   global_state->core->rcu_walk = true;
+   double rcu_rate = run_storm( num_threads, "lock-free" );
+
+   SG_TIMING_DATA( "lock-free speedup", rcu_rate / locked_rate );
+
+   // shut down the test
+   syndicate_functional_test_shutdown( &syndicate_http );
+
+   printf("\n\nTotal failures: %d\n", global_num_failures );
+
+   return 0;
+}
@@ -0,0 +1,205 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Statistics histogram test.
+// Records calls with known latencies and results, and checks that the merged histograms (the ones OP_GET_STATISTICS
+// reports) put each call in the right bucket, count errors separately, and keep the calls of threads that have exited.
+
+#include "libsyndicate/libsyndicate.h"
+#include "libsyndicateUG/stats.h"
+
+#define NUM_FAST_CALLS 10
+#define NUM_SLOW_CALLS 5
+#define NUM_FAILED_CALLS 3
+#define SLOW_CALL_USEC 20000
+
+#define NUM_THREADS 4
+#define NUM_THREAD_CALLS 100
+
+int global_num_failures = 0;
+
+#define CHECK( cond ) \
+   do { \
+      if( !(cond) ) { \
+         SG_error("\n\n\nFAILED: %s\n\n\n", #cond ); \
+         global_num_failures++; \
+      } \
+   } while( 0 )
+
+
+// sum the calls in the buckets that hold latencies in [lo, hi)
+uint64_t count_between( struct stats_histogram* hist, uint64_t lo, uint64_t hi ) {
+
+   uint64_t n = 0;
+
+   for( int i = 0; i < STATS_HISTOGRAM_NUM_BUCKETS; i++ ) {
+
+      uint64_t bucket_lo = 0, bucket_hi = 0;
+      stats_histogram_bucket_range( i, &bucket_lo, &bucket_hi );
+
+      if( bucket_lo >= lo && bucket_hi <= hi ) {
+         n += hist->buckets[i];
+      }
+   }
+
+   return n;
+}
+
+
+// every latency must land in the bucket whose range holds it
+void test_buckets() {
+
+   uint64_t values[] = { 0, 1, 15, 16, 17, 31, 32, 33, 1000, 20000, 123456, 1LL << 31, (1LL << 32) - 1 };
+
+   for( unsigned int i = 0; i < sizeof(values) / sizeof(values[0]); i++ ) {
+
+      int bucket = stats_histogram_bucket( values[i] );
+
+      uint64_t lo = 0, hi = 0;
+      stats_histogram_bucket_range( bucket, &lo, &hi );
+
+      SG_debug("latency %" PRIu64 " is in bucket %d: [%" PRIu64 ", %" PRIu64 ")\n", values[i], bucket, lo, hi );
+
+      CHECK( bucket >= 0 && bucket < STATS_HISTOGRAM_NUM_BUCKETS );
+      CHECK( lo <= values[i] && values[i] < hi );
+   }
+
+   // latencies past the last magnitude go to the last bucket
+   CHECK( stats_histogram_bucket( 1LL << 40 ) == STATS_HISTOGRAM_NUM_BUCKETS - 1 );
+}
+
+
+// record fast, slow, and failed calls, and check where they went
+void test_calls( Stats* stats ) {
+
+   for( int i = 0; i < NUM_FAST_CALLS; i++ ) {
+      stats->enter( STAT_GETATTR );
+      stats->leave( STAT_GETATTR, 0 );
+   }
+
+   for( int i = 0; i < NUM_SLOW_CALLS; i++ ) {
+      stats->enter( STAT_GETATTR );
+      usleep( SLOW_CALL_USEC );
+      stats->leave( STAT_GETATTR, 0 );
+   }
+
+   for( int i = 0; i < NUM_FAILED_CALLS; i++ ) {
+      stats->enter( STAT_GETATTR );
+      stats->leave( STAT_GETATTR, -EIO );
+   }
+
+   struct stats_histogram merged;
+   stats->merge( STAT_GETATTR, &merged );
+
+   SG_debug("getattr: count = %" PRIu64 ", errors = %" PRIu64 ", total = %" PRIu64 ", max = %" PRIu64 "\n", merged.count, merged.errors, merged.total, merged.max );
+
+   CHECK( merged.count == NUM_FAST_CALLS + NUM_SLOW_CALLS );
+   CHECK( merged.errors == NUM_FAILED_CALLS );
+
+   // failed calls are not bucketed
+   CHECK( count_between( &merged, 0, UINT64_MAX ) == NUM_FAST_CALLS + NUM_SLOW_CALLS );
+
+   // fast calls take well under a millisecond; slow calls take at least SLOW_CALL_USEC, so they land in its bucket or later ones
+   uint64_t slow_lo = 0, slow_hi = 0;
+   stats_histogram_bucket_range( stats_histogram_bucket( SLOW_CALL_USEC ), &slow_lo, &slow_hi );
+
+   CHECK( count_between( &merged, 0, 1000 ) == NUM_FAST_CALLS );
+   CHECK( count_between( &merged, slow_lo, UINT64_MAX ) == NUM_SLOW_CALLS );
+
+   CHECK( merged.max >= SLOW_CALL_USEC );
+   CHECK( merged.total >= (uint64_t)NUM_SLOW_CALLS * SLOW_CALL_USEC );
+
+   CHECK( stats_histogram_percentile( &merged, 50.0 ) < 1000 );
+   CHECK( stats_histogram_percentile( &merged, 99.0 ) >= slow_lo );
+
+   // other calls are untouched
+   struct stats_histogram other;
+   stats->merge( STAT_READ, &other );
+
+   CHECK( other.count == 0 && other.errors == 0 );
+}
+
+
+void* thread_main( void* arg ) {
+
+   Stats* stats = (Stats*)arg;
+
+   for( int i = 0; i < NUM_THREAD_CALLS; i++ ) {
+      stats->enter( STAT_READ );
+      stats->leave( STAT_READ, 0 );
+   }
+
+   return NULL;
+}
+
+
+// calls made by threads that have since exited still count
+void test_retired_threads( Stats* stats ) {
+
+   pthread_t threads[ NUM_THREADS ];
+
+   for( int i = 0; i < NUM_THREADS; i++ ) {
+      pthread_create( &threads[i], NULL, thread_main, stats );
+   }
+
+   for( int i = 0; i < NUM_THREADS; i++ ) {
+      pthread_join( threads[i], NULL );
+   }
+
+   struct stats_histogram merged;
+   stats->merge( STAT_READ, &merged );
+
+   SG_debug("read: count = %" PRIu64 "\n", merged.count );
+
+   CHECK( merged.count == NUM_THREADS * NUM_THREAD_CALLS );
+   CHECK( count_between( &merged, 0, UINT64_MAX ) == NUM_THREADS * NUM_THREAD_CALLS );
+}
+
+
+// the dump reports the number of calls, including failed ones
+void test_dump( Stats* stats ) {
+
+   string dump = stats->dump();
+
+   char expected[200];
+
+   sprintf( expected, "syndicatefs_getattr        %d\n", NUM_FAST_CALLS + NUM_SLOW_CALLS + NUM_FAILED_CALLS );
+   CHECK( dump.find( expected ) != string::npos );
+
+   sprintf( expected, "syndicatefs_read           %d\n", NUM_THREADS * NUM_THREAD_CALLS );
+   CHECK( dump.find( expected ) != string::npos );
+}
+
+
+int main( int argc, char** argv ) {
+
+   Stats* stats = new Stats( NULL );
+
+   test_buckets();
+   test_calls( stats );
+   test_retired_threads( stats );
+   test_dump( stats );
+
+   delete stats;
+
+   if( global_num_failures != 0 ) {
+      printf("%d checks failed\n", global_num_failures );
+      return 1;
+   }
+
+   printf("all checks passed\n");
+   return 0;
+}
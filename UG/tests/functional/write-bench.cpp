@@ -0,0 +1,109 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Sequential write benchmark.
+// Writes SIZE_MB megabytes to a new file in WRITE_SIZE-byte chunks, and reports throughput.
+// Use a WRITE_SIZE that is a multiple of the volume's block size to exercise the whole-block write path,
+// and an unaligned one to compare against the partial-block path.
+
+#include "common.h"
+
+void usage( char* progname ) {
+   printf("Usage %s [syndicate options] /path/to/file SIZE_MB WRITE_SIZE\n", progname );
+   exit(1);
+}
+
+int main( int argc, char** argv ) {
+   
+   struct md_HTTP syndicate_http;
+   
+   int test_optind = -1;
+   struct timespec ts, ts2;
+   
+   // set up the test 
+   syndicate_functional_test_init( argc, argv, &test_optind, &syndicate_http );
+   
+   if( test_optind < 0 )
+      usage( argv[0] );
+   
+   if( test_optind + 2 >= argc )
+      usage( argv[0] );
+   
+   char* path = argv[test_optind];
+   uint64_t size_mb = (uint64_t)strtoull( argv[test_optind+1], NULL, 10 );
+   size_t write_size = (size_t)strtoull( argv[test_optind+2], NULL, 10 );
+   
+   if( size_mb == 0 || write_size == 0 )
+      usage( argv[0] );
+   
+   uint64_t total = size_mb * 1024 * 1024;
+   
+   // get state 
+   struct syndicate_state* state = syndicate_get_state();
+   
+   char* buf = SG_CALLOC( char, write_size );
+   if( buf == NULL ) {
+      exit( ENOMEM );
+   }
+   
+   for( size_t i = 0; i < write_size; i++ ) {
+      buf[i] = 'a' + (i % 26);
+   }
+   
+   // create the file
+   int rc = 0;
+   struct fs_file_handle* fh = fs_entry_create( state->core, path, SG_SYS_USER, state->core->volume, 0755, &rc );
+   
+   if( fh == NULL || rc != 0 ) {
+      SG_error("\n\n\nfs_entry_create( %s ) rc = %d\n\n\n", path, rc );
+      exit(1);
+   }
+   
+   SG_BEGIN_TIMING_DATA( ts );
+   
+   // write it out, sequentially 
+   for( uint64_t offset = 0; offset < total; offset += write_size ) {
+      
+      size_t len = MIN( write_size, total - offset );
+      
+      ssize_t nw = fs_entry_write( state->core, fh, buf, len, offset );
+      if( nw < 0 || (size_t)nw != len ) {
+         SG_error("\n\n\nfs_entry_write( %s, %zu, %" PRIu64 " ) rc = %zd\n\n\n", path, len, offset, nw );
+         exit(1);
+      }
+   }
+   
+   SG_END_TIMING_DATA( ts, ts2, "sequential write" );
+   
+   double elapsed = ((double)(ts2.tv_nsec - ts.tv_nsec) + (double)(1e9 * (ts2.tv_sec - ts.tv_sec))) / 1e9;
+   
+   SG_TIMING_DATA( "MB/s", (double)size_mb / elapsed );
+   
+   // flush and close
+   rc = fs_entry_close( state->core, fh );
+   if( rc != 0 ) {
+      SG_error("\n\n\nfs_entry_close( %s ) rc = %d\n\n\n", path, rc );
+      exit(1);
+   }
+   
+   free( fh );
+   free( buf );
+   
+   // shut down the test 
+   syndicate_functional_test_shutdown( &syndicate_http );
+   
+   return 0;
+}
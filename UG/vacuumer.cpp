@@ -18,9 +18,38 @@
 #include "replication.h"
 #include "network.h"
 #include "sync.h"
+#include "manifest.h"
 #include "libsyndicate/ms/vacuum.h"
+#include "libsyndicate/ms/getattr.h"
+#include "libsyndicate/ms/path.h"
+#include "libsyndicate/storage.h"
+
+#include <dirent.h>
+
+// journal record suffixes
+#define VACUUM_JOURNAL_SUFFIX ".vac"               // committed request
+#define VACUUM_JOURNAL_SUFFIX_PENDING ".pending"   // request that is not yet committed (i.e. its file is not yet deleted on the MS)
+#define VACUUM_JOURNAL_SUFFIX_TMP ".tmp"           // partially-written record
+
+// journal record header.  Followed by the path, and then num_blocks blocks.
+struct fs_vacuumer_journal_header {
+   uint32_t magic;
+   int32_t type;
+   struct replica_snapshot snapshot;
+   uint32_t fs_path_len;
+   uint32_t num_blocks;
+};
+
+// journal record garbage block.  Followed by hash_len bytes of hash.
+struct fs_vacuumer_journal_block {
+   uint64_t block_id;
+   int64_t version;
+   uint64_t gateway_id;
+   uint32_t hash_len;
+};
 
 static void* vacuumer_main( void* arg );
+static int fs_entry_vacuumer_request_free( struct fs_vacuumer_request* vreq );
 
 int fs_entry_vacuumer_rlock( struct fs_vacuumer* vac ) {
    return pthread_rwlock_rdlock( &vac->vacuum_set_lock );
@@ -60,6 +89,15 @@ int fs_entry_vacuumer_init( struct fs_vacuumer* vac, struct fs_core* core ) {
    
    vac->core = core;
    
+   vac->journal_dir = md_fullpath( core->conf->storage_root, VACUUM_JOURNAL_DIR, NULL );
+   if( vac->journal_dir == NULL ) {
+      return -ENOMEM;
+   }
+   
+   vac->gc_blocks_per_sec = core->conf->gc_blocks_per_second;
+   vac->gc_tokens = vac->gc_blocks_per_sec;
+   clock_gettime( CLOCK_MONOTONIC, &vac->gc_last_refill );
+   
    pthread_rwlock_init( &vac->vacuum_set_lock, NULL );
    pthread_rwlock_init( &vac->vacuum_pending_lock, NULL );
    
@@ -72,6 +110,17 @@ int fs_entry_vacuumer_shutdown( struct fs_vacuumer* vac ) {
    if( vac->running )
       return -EINVAL;
    
+   // free unfinished requests (persistent ones are still journaled)
+   vacuum_set_t* sets[] = { vac->vacuum_set, vac->vacuum_pending_1, vac->vacuum_pending_2 };
+   
+   for( int i = 0; i < 3; i++ ) {
+      for( vacuum_set_t::iterator itr = sets[i]->begin(); itr != sets[i]->end(); itr++ ) {
+         
+         struct fs_vacuumer_request vreq = *itr;
+         fs_entry_vacuumer_request_free( &vreq );
+      }
+   }
+   
    delete vac->vacuum_set;
    vac->vacuum_set = NULL;
    
@@ -82,15 +131,498 @@ int fs_entry_vacuumer_shutdown( struct fs_vacuumer* vac ) {
    vac->vacuum_pending_1 = NULL;
    vac->vacuum_pending_2 = NULL;
    
+   if( vac->journal_dir != NULL ) {
+      free( vac->journal_dir );
+      vac->journal_dir = NULL;
+   }
+   
    pthread_rwlock_destroy( &vac->vacuum_set_lock );
    pthread_rwlock_destroy( &vac->vacuum_pending_lock );
    
    return 0;
 }
 
-// start the vacuumer 
+
+// path to a journal record
+static char* fs_entry_vacuumer_journal_path( struct fs_vacuumer* vac, uint64_t journal_id, char const* suffix ) {
+   
+   char name[50];
+   sprintf( name, "%016" PRIX64 "%s", journal_id, suffix );
+   
+   return md_fullpath( vac->journal_dir, name, NULL );
+}
+
+
+// flush the journal directory, so renames and unlinks in it are durable 
+static int fs_entry_vacuumer_journal_sync( struct fs_vacuumer* vac ) {
+   
+   int rc = 0;
+   int fd = open( vac->journal_dir, O_RDONLY | O_DIRECTORY );
+   if( fd < 0 ) {
+      rc = -errno;
+      SG_error("open(%s) rc = %d\n", vac->journal_dir, rc );
+      return rc;
+   }
+   
+   if( fsync( fd ) != 0 ) {
+      rc = -errno;
+      SG_error("fsync(%s) rc = %d\n", vac->journal_dir, rc );
+   }
+   
+   close( fd );
+   return rc;
+}
+
+
+// serialize a persistent request into a journal record 
+// return 0 on success, and set *buf and *buf_len
+// return -ENOMEM if out of memory
+static int fs_entry_vacuumer_journal_serialize( struct fs_vacuumer_request* vreq, char** buf, size_t* buf_len ) {
+   
+   size_t fs_path_len = strlen( vreq->fs_path );
+   size_t len = sizeof(struct fs_vacuumer_journal_header) + fs_path_len;
+   
+   for( modification_map::iterator itr = vreq->garbage->begin(); itr != vreq->garbage->end(); itr++ ) {
+      len += sizeof(struct fs_vacuumer_journal_block) + itr->second.hash_len;
+   }
+   
+   char* ret = SG_CALLOC( char, len );
+   if( ret == NULL ) {
+      return -ENOMEM;
+   }
+   
+   struct fs_vacuumer_journal_header hdr;
+   memset( &hdr, 0, sizeof(struct fs_vacuumer_journal_header) );
+   
+   hdr.magic = VACUUM_JOURNAL_MAGIC;
+   hdr.type = vreq->type;
+   hdr.fs_path_len = fs_path_len;
+   hdr.num_blocks = vreq->garbage->size();
+   memcpy( &hdr.snapshot, &vreq->fent_snapshot, sizeof(struct replica_snapshot) );
+   
+   memcpy( ret, &hdr, sizeof(struct fs_vacuumer_journal_header) );
+   size_t off = sizeof(struct fs_vacuumer_journal_header);
+   
+   memcpy( ret + off, vreq->fs_path, fs_path_len );
+   off += fs_path_len;
+   
+   for( modification_map::iterator itr = vreq->garbage->begin(); itr != vreq->garbage->end(); itr++ ) {
+      
+      struct fs_vacuumer_journal_block blk;
+      memset( &blk, 0, sizeof(struct fs_vacuumer_journal_block) );
+      
+      blk.block_id = itr->first;
+      blk.version = itr->second.version;
+      blk.gateway_id = itr->second.gateway_id;
+      blk.hash_len = itr->second.hash_len;
+      
+      memcpy( ret + off, &blk, sizeof(struct fs_vacuumer_journal_block) );
+      off += sizeof(struct fs_vacuumer_journal_block);
+      
+      if( blk.hash_len > 0 ) {
+         memcpy( ret + off, itr->second.hash, blk.hash_len );
+         off += blk.hash_len;
+      }
+   }
+   
+   *buf = ret;
+   *buf_len = len;
+   return 0;
+}
+
+
+// parse a journal record into a persistent request 
+// return 0 on success
+// return -EINVAL if the record is malformed
+// return -ENOMEM if out of memory
+static int fs_entry_vacuumer_journal_parse( char const* buf, size_t buf_len, struct fs_vacuumer_request* vreq ) {
+   
+   struct fs_vacuumer_journal_header hdr;
+   
+   if( buf_len < sizeof(struct fs_vacuumer_journal_header) ) {
+      return -EINVAL;
+   }
+   
+   memcpy( &hdr, buf, sizeof(struct fs_vacuumer_journal_header) );
+   size_t off = sizeof(struct fs_vacuumer_journal_header);
+   
+   if( hdr.magic != VACUUM_JOURNAL_MAGIC || (hdr.type != VACUUM_TYPE_FILE && hdr.type != VACUUM_TYPE_BLOCKS) || buf_len - off < hdr.fs_path_len ) {
+      return -EINVAL;
+   }
+   
+   memset( vreq, 0, sizeof(struct fs_vacuumer_request) );
+   
+   vreq->type = hdr.type;
+   memcpy( &vreq->fent_snapshot, &hdr.snapshot, sizeof(struct replica_snapshot) );
+   
+   vreq->fs_path = SG_CALLOC( char, hdr.fs_path_len + 1 );
+   vreq->garbage = new modification_map();
+   
+   if( vreq->fs_path == NULL ) {
+      fs_entry_vacuumer_request_free( vreq );
+      return -ENOMEM;
+   }
+   
+   memcpy( vreq->fs_path, buf + off, hdr.fs_path_len );
+   off += hdr.fs_path_len;
+   
+   for( uint32_t i = 0; i < hdr.num_blocks; i++ ) {
+      
+      struct fs_vacuumer_journal_block blk;
+      unsigned char* hash = NULL;
+      
+      if( buf_len - off < sizeof(struct fs_vacuumer_journal_block) ) {
+         fs_entry_vacuumer_request_free( vreq );
+         return -EINVAL;
+      }
+      
+      memcpy( &blk, buf + off, sizeof(struct fs_vacuumer_journal_block) );
+      off += sizeof(struct fs_vacuumer_journal_block);
+      
+      if( buf_len - off < blk.hash_len ) {
+         fs_entry_vacuumer_request_free( vreq );
+         return -EINVAL;
+      }
+      
+      if( blk.hash_len > 0 ) {
+         
+         hash = SG_CALLOC( unsigned char, blk.hash_len );
+         if( hash == NULL ) {
+            fs_entry_vacuumer_request_free( vreq );
+            return -ENOMEM;
+         }
+         
+         memcpy( hash, buf + off, blk.hash_len );
+         off += blk.hash_len;
+      }
+      
+      struct fs_entry_block_info binfo;
+      fs_entry_block_info_garbage_init( &binfo, blk.version, hash, blk.hash_len, blk.gateway_id );
+      
+      (*vreq->garbage)[ blk.block_id ] = binfo;
+   }
+   
+   return 0;
+}
+
+
+// durably write a persistent request's journal record.
+// the record is written to a temporary file and renamed into place, so a crash never leaves a partial record under its real name.
+// return 0 on success 
+// return negative on error
+static int fs_entry_vacuumer_journal_write( struct fs_vacuumer* vac, struct fs_vacuumer_request* vreq, char const* suffix ) {
+   
+   char* buf = NULL;
+   size_t buf_len = 0;
+   
+   int rc = fs_entry_vacuumer_journal_serialize( vreq, &buf, &buf_len );
+   if( rc != 0 ) {
+      return rc;
+   }
+   
+   char* tmp_path = fs_entry_vacuumer_journal_path( vac, vreq->journal_id, VACUUM_JOURNAL_SUFFIX_TMP );
+   char* path = fs_entry_vacuumer_journal_path( vac, vreq->journal_id, suffix );
+   
+   if( tmp_path == NULL || path == NULL ) {
+      
+      SG_safe_free( tmp_path );
+      SG_safe_free( path );
+      free( buf );
+      return -ENOMEM;
+   }
+   
+   int fd = open( tmp_path, O_CREAT | O_WRONLY | O_TRUNC, 0600 );
+   if( fd < 0 ) {
+      
+      rc = -errno;
+      SG_error("open(%s) rc = %d\n", tmp_path, rc );
+   }
+   else {
+      
+      ssize_t nw = md_write_uninterrupted( fd, buf, buf_len );
+      if( nw < 0 || (size_t)nw != buf_len ) {
+         
+         rc = (nw < 0 ? nw : -EIO);
+         SG_error("md_write_uninterrupted(%s) rc = %d\n", tmp_path, rc );
+      }
+      else if( fsync( fd ) != 0 ) {
+         
+         rc = -errno;
+         SG_error("fsync(%s) rc = %d\n", tmp_path, rc );
+      }
+      
+      close( fd );
+      
+      if( rc == 0 && rename( tmp_path, path ) != 0 ) {
+         
+         rc = -errno;
+         SG_error("rename(%s, %s) rc = %d\n", tmp_path, path, rc );
+      }
+      
+      if( rc != 0 ) {
+         unlink( tmp_path );
+      }
+      else {
+         rc = fs_entry_vacuumer_journal_sync( vac );
+      }
+   }
+   
+   free( tmp_path );
+   free( path );
+   free( buf );
+   
+   return rc;
+}
+
+
+// change the suffix of a journal record, durably 
+static int fs_entry_vacuumer_journal_rename( struct fs_vacuumer* vac, uint64_t journal_id, char const* old_suffix, char const* new_suffix ) {
+   
+   int rc = 0;
+   char* old_path = fs_entry_vacuumer_journal_path( vac, journal_id, old_suffix );
+   char* new_path = fs_entry_vacuumer_journal_path( vac, journal_id, new_suffix );
+   
+   if( old_path == NULL || new_path == NULL ) {
+      rc = -ENOMEM;
+   }
+   else if( rename( old_path, new_path ) != 0 ) {
+      rc = -errno;
+      SG_error("rename(%s, %s) rc = %d\n", old_path, new_path, rc );
+   }
+   else {
+      rc = fs_entry_vacuumer_journal_sync( vac );
+   }
+   
+   SG_safe_free( old_path );
+   SG_safe_free( new_path );
+   
+   return rc;
+}
+
+
+// remove a journal record.  If sync is false, the caller must call fs_entry_vacuumer_journal_sync() to make it durable.
+static int fs_entry_vacuumer_journal_remove( struct fs_vacuumer* vac, uint64_t journal_id, char const* suffix, bool sync ) {
+   
+   int rc = 0;
+   char* path = fs_entry_vacuumer_journal_path( vac, journal_id, suffix );
+   
+   if( path == NULL ) {
+      return -ENOMEM;
+   }
+   
+   if( unlink( path ) != 0 ) {
+      rc = -errno;
+      SG_error("unlink(%s) rc = %d\n", path, rc );
+   }
+   else if( sync ) {
+      rc = fs_entry_vacuumer_journal_sync( vac );
+   }
+   
+   free( path );
+   return rc;
+}
+
+
+// load a journal record into a persistent request
+// return 0 on success
+// return -EIO if it can't be read
+// return -EINVAL if it is malformed
+// return -ENOMEM if out of memory
+static int fs_entry_vacuumer_journal_load( char const* path, uint64_t journal_id, struct fs_vacuumer_request* vreq ) {
+   
+   off_t len = 0;
+   int rc = -EIO;
+   
+   char* buf = md_load_file( path, &len );
+   if( buf != NULL ) {
+      
+      rc = fs_entry_vacuumer_journal_parse( buf, len, vreq );
+      free( buf );
+   }
+   
+   if( rc == 0 ) {
+      vreq->journal_id = journal_id;
+   }
+   
+   return rc;
+}
+
+
+// find out whether or not the MS deleted the file an uncommitted request is for, by asking it for the file.
+// file IDs are never reused, so if the MS has no such file (whether or not it still has an orphaned vacuum log for it), the delete went through.
+// return 1 if the file is gone
+// return 0 if it still exists
+// return negative if we couldn't tell
+static int fs_entry_vacuumer_journal_file_deleted( struct fs_vacuumer* vac, struct fs_vacuumer_request* vreq ) {
+   
+   struct ms_path_ent path_ent;
+   struct ms_client_multi_result result;
+   
+   memset( &result, 0, sizeof(struct ms_client_multi_result) );
+   
+   ms_client_make_path_ent( &path_ent, vreq->fent_snapshot.volume_id, 0, vreq->fent_snapshot.file_id, 0, 0, 0, 0, 0, NULL, NULL );
+   
+   int rc = ms_client_getattr( vac->core->ms, &path_ent, &result );
+   int reply_error = result.reply_error;
+   
+   ms_client_multi_result_free( &result );
+   ms_client_free_path_ent( &path_ent, NULL );
+   
+   if( rc == 0 ) {
+      return 0;
+   }
+   
+   if( reply_error == -ENOENT ) {
+      return 1;
+   }
+   
+   SG_error("ms_client_getattr(%" PRIX64 ") rc = %d, reply_error = %d\n", vreq->fent_snapshot.file_id, rc, reply_error );
+   return rc;
+}
+
+
+// load every committed request from the journal into the pending set, and resolve uncommitted ones.
+// an uncommitted (pending) record belongs to a delete that either failed, or was interrupted by a crash before we committed it
+// (possibly after the MS deleted the file).  Ask the MS which:  if the file is gone, commit the request, so its blocks don't leak;
+// if it still exists, drop the request, since vacuuming a live file would destroy its data.  If the MS can't tell us, keep the
+// record and try again the next time we start.
+static int fs_entry_vacuumer_journal_replay( struct fs_vacuumer* vac ) {
+   
+   int num_replayed = 0;
+   
+   DIR* dir = opendir( vac->journal_dir );
+   if( dir == NULL ) {
+      
+      int rc = -errno;
+      SG_error("opendir(%s) rc = %d\n", vac->journal_dir, rc );
+      return rc;
+   }
+   
+   struct dirent* dent = NULL;
+   
+   while( (dent = readdir( dir )) != NULL ) {
+      
+      uint64_t journal_id = 0;
+      char suffix[20];
+      
+      memset( suffix, 0, 20 );
+      
+      if( sscanf( dent->d_name, "%16" SCNx64 "%19s", &journal_id, suffix ) != 2 ) {
+         continue;
+      }
+      
+      char* path = md_fullpath( vac->journal_dir, dent->d_name, NULL );
+      if( path == NULL ) {
+         closedir( dir );
+         return -ENOMEM;
+      }
+      
+      vac->next_journal_id = MAX( vac->next_journal_id, journal_id + 1 );
+      
+      bool committed = (strcmp( suffix, VACUUM_JOURNAL_SUFFIX ) == 0);
+      bool pending = (strcmp( suffix, VACUUM_JOURNAL_SUFFIX_PENDING ) == 0);
+      
+      if( committed || pending ) {
+         
+         struct fs_vacuumer_request vreq;
+         bool enqueue = false;
+         
+         int rc = fs_entry_vacuumer_journal_load( path, journal_id, &vreq );
+         if( rc != 0 ) {
+            
+            SG_error("Failed to load vacuum request %s, rc = %d\n", path, rc );
+            
+            if( pending ) {
+               unlink( path );
+            }
+         }
+         else if( committed ) {
+            
+            enqueue = true;
+         }
+         else {
+            
+            rc = fs_entry_vacuumer_journal_file_deleted( vac, &vreq );
+            
+            if( rc > 0 ) {
+               
+               // deleted on the MS; finish what the crash interrupted
+               SG_debug("Committing interrupted vacuum request %s\n", path );
+               
+               rc = fs_entry_vacuumer_journal_rename( vac, journal_id, VACUUM_JOURNAL_SUFFIX_PENDING, VACUUM_JOURNAL_SUFFIX );
+               if( rc != 0 ) {
+                  // we'll still vacuum it now, but not after another restart
+                  SG_error("fs_entry_vacuumer_journal_rename(%s) rc = %d\n", path, rc );
+               }
+               
+               enqueue = true;
+            }
+            else if( rc == 0 ) {
+               
+               // the delete failed, so the file is still live
+               SG_error("WARN: dropping uncommitted vacuum request %s\n", path );
+               
+               fs_entry_vacuumer_journal_remove( vac, journal_id, VACUUM_JOURNAL_SUFFIX_PENDING, false );
+            }
+            else {
+               SG_error("WARN: could not resolve uncommitted vacuum request %s (rc = %d); will retry on restart\n", path, rc );
+            }
+            
+            if( !enqueue ) {
+               fs_entry_vacuumer_request_free( &vreq );
+            }
+         }
+         
+         if( enqueue ) {
+            
+            fs_entry_vacuumer_pending_wlock( vac );
+            vac->vacuum_pending->insert( vreq );
+            fs_entry_vacuumer_pending_unlock( vac );
+            
+            num_replayed++;
+         }
+      }
+      else {
+         
+         unlink( path );
+      }
+      
+      free( path );
+   }
+   
+   closedir( dir );
+   
+   fs_entry_vacuumer_journal_sync( vac );
+   
+   if( num_replayed > 0 ) {
+      SG_debug("Resuming %d vacuum requests\n", num_replayed );
+   }
+   
+   return 0;
+}
+
+
+// start the vacuumer, and resume any journaled requests
 int fs_entry_vacuumer_start( struct fs_vacuumer* vac ) {
    
+   int rc = md_mkdirs( vac->journal_dir );
+   if( rc != 0 ) {
+      SG_error("md_mkdirs(%s) rc = %d\n", vac->journal_dir, rc );
+      return rc;
+   }
+   
+   // request IDs increase across restarts 
+   struct timespec now;
+   clock_gettime( CLOCK_REALTIME, &now );
+   
+   vac->next_journal_id = (uint64_t)now.tv_sec * 1000000000LL + (uint64_t)now.tv_nsec;
+   
+   rc = fs_entry_vacuumer_journal_replay( vac );
+   if( rc != 0 ) {
+      SG_error("fs_entry_vacuumer_journal_replay(%s) rc = %d\n", vac->journal_dir, rc );
+      return rc;
+   }
+   
    vac->running = true;
    
    vac->thread = md_start_thread( vacuumer_main, vac, false );
@@ -121,6 +653,12 @@ static int fs_entry_vacuumer_request_free( struct fs_vacuumer_request* vreq ) {
       vreq->fs_path = NULL;
    }
    
+   if( vreq->garbage ) {
+      fs_entry_free_modification_map( vreq->garbage );
+      delete vreq->garbage;
+      vreq->garbage = NULL;
+   }
+   
    return 0;
 }
 
@@ -219,6 +757,230 @@ int fs_entry_vacuumer_log_entry_bg( struct fs_vacuumer* vac, char const* fs_path
    return 0;
 }
 
+
+// start vacuuming a file that is about to be deleted, in the background.
+// durably record the file's state and blocks, so the request survives a restart.  The request takes effect only once it is
+// committed with fs_entry_vacuumer_file_bg_commit(), after the MS deletes the file (deferring vacuuming); if the delete fails,
+// call fs_entry_vacuumer_file_bg_abort() instead.
+// fent must be read-locked, and have a manifest
+// return 0 on success, and fill in vreq
+// return -ENOTCONN if the vacuumer isn't running
+// return negative on journal error
+int fs_entry_vacuumer_file_bg_begin( struct fs_vacuumer* vac, char const* fs_path, struct fs_entry* fent, struct fs_vacuumer_request* vreq ) {
+   
+   if( !vac->running )
+      return -ENOTCONN;
+   
+   memset( vreq, 0, sizeof(struct fs_vacuumer_request) );
+   
+   vreq->type = VACUUM_TYPE_FILE;
+   vreq->fs_path = strdup( fs_path );
+   vreq->garbage = new modification_map();
+   vreq->journal_id = __sync_fetch_and_add( &vac->next_journal_id, 1 );
+   
+   if( vreq->fs_path == NULL ) {
+      fs_entry_vacuumer_request_free( vreq );
+      return -ENOMEM;
+   }
+   
+   fs_entry_replica_snapshot( vac->core, fent, 0, 0, &vreq->fent_snapshot );
+   
+   // all of the file's current blocks will be garbage
+   if( fent->size > 0 ) {
+      
+      uint64_t num_blocks = fent->manifest->get_num_blocks();
+      
+      for( uint64_t i = 0; i < num_blocks; i++ ) {
+         
+         struct fs_entry_block_info binfo;
+         fs_entry_block_info_garbage_init( &binfo, fent->manifest->get_block_version( i ), NULL, 0, 0 );
+         
+         (*vreq->garbage)[ i ] = binfo;
+      }
+   }
+   
+   int rc = fs_entry_vacuumer_journal_write( vac, vreq, VACUUM_JOURNAL_SUFFIX_PENDING );
+   if( rc != 0 ) {
+      SG_error("fs_entry_vacuumer_journal_write(%s %" PRIX64 ") rc = %d\n", fs_path, fent->file_id, rc );
+      
+      fs_entry_vacuumer_request_free( vreq );
+      return rc;
+   }
+   
+   return 0;
+}
+
+
+// commit and enqueue a request from fs_entry_vacuumer_file_bg_begin().  The vacuumer owns vreq's memory afterwards.
+int fs_entry_vacuumer_file_bg_commit( struct fs_vacuumer* vac, struct fs_vacuumer_request* vreq ) {
+   
+   int rc = fs_entry_vacuumer_journal_rename( vac, vreq->journal_id, VACUUM_JOURNAL_SUFFIX_PENDING, VACUUM_JOURNAL_SUFFIX );
+   if( rc != 0 ) {
+      // we'll still vacuum it now, but not after a restart 
+      SG_error("fs_entry_vacuumer_journal_rename(%s %" PRIX64 ") rc = %d\n", vreq->fs_path, vreq->fent_snapshot.file_id, rc );
+   }
+   
+   fs_entry_vacuumer_pending_wlock( vac );
+   
+   vac->vacuum_pending->insert( *vreq );
+   
+   fs_entry_vacuumer_pending_unlock( vac );
+   
+   return 0;
+}
+
+
+// abandon a request from fs_entry_vacuumer_file_bg_begin(), and free it
+int fs_entry_vacuumer_file_bg_abort( struct fs_vacuumer* vac, struct fs_vacuumer_request* vreq ) {
+   
+   fs_entry_vacuumer_journal_remove( vac, vreq->journal_id, VACUUM_JOURNAL_SUFFIX_PENDING, true );
+   fs_entry_vacuumer_request_free( vreq );
+   
+   return 0;
+}
+
+
+// garbage-collect blocks from an older snapshot of a file, persistently and in the background.
+// the vacuumer takes ownership of garbage's contents on success (garbage will be empty).
+// return 0 once the request is durable and enqueued
+// return -ENOTCONN if the vacuumer isn't running
+// return negative on journal error
+int fs_entry_vacuumer_blocks_bg( struct fs_vacuumer* vac, char const* fs_path, struct replica_snapshot* snapshot, modification_map* garbage ) {
+   
+   if( !vac->running )
+      return -ENOTCONN;
+   
+   if( garbage->size() == 0 )
+      return 0;
+   
+   struct fs_vacuumer_request vreq;
+   memset( &vreq, 0, sizeof(struct fs_vacuumer_request ) );
+   
+   vreq.type = VACUUM_TYPE_BLOCKS;
+   vreq.fs_path = strdup( fs_path );
+   vreq.garbage = new modification_map();
+   vreq.journal_id = __sync_fetch_and_add( &vac->next_journal_id, 1 );
+   
+   if( vreq.fs_path == NULL ) {
+      fs_entry_vacuumer_request_free( &vreq );
+      return -ENOMEM;
+   }
+   
+   memcpy( &vreq.fent_snapshot, snapshot, sizeof(struct replica_snapshot) );
+   
+   vreq.garbage->swap( *garbage );
+   
+   int rc = fs_entry_vacuumer_journal_write( vac, &vreq, VACUUM_JOURNAL_SUFFIX );
+   if( rc != 0 ) {
+      SG_error("fs_entry_vacuumer_journal_write(%s %" PRIX64 ") rc = %d\n", fs_path, snapshot->file_id, rc );
+      
+      // give the blocks back
+      vreq.garbage->swap( *garbage );
+      fs_entry_vacuumer_request_free( &vreq );
+      return rc;
+   }
+   
+   fs_entry_vacuumer_pending_wlock( vac );
+   
+   vac->vacuum_pending->insert( vreq );
+   
+   fs_entry_vacuumer_pending_unlock( vac );
+   
+   return 0;
+}
+
+
+// take garbage-collection budget for num_blocks blocks.
+// a request larger than the bucket goes through once the bucket is full, and leaves it in debt.
+// return true if we may proceed; false if we should try again later
+static bool fs_entry_vacuumer_gc_throttle( struct fs_vacuumer* vac, size_t num_blocks ) {
+   
+   if( vac->gc_blocks_per_sec <= 0 ) {
+      return true;
+   }
+   
+   struct timespec now;
+   clock_gettime( CLOCK_MONOTONIC, &now );
+   
+   double elapsed = (double)(now.tv_sec - vac->gc_last_refill.tv_sec) + (double)(now.tv_nsec - vac->gc_last_refill.tv_nsec) / 1e9;
+   
+   vac->gc_tokens = MIN( vac->gc_tokens + elapsed * vac->gc_blocks_per_sec, (double)vac->gc_blocks_per_sec );
+   vac->gc_last_refill = now;
+   
+   if( vac->gc_tokens < MIN( (double)num_blocks, (double)vac->gc_blocks_per_sec ) ) {
+      return false;
+   }
+   
+   vac->gc_tokens -= num_blocks;
+   return true;
+}
+
+
+// garbage-collect a persistent request's blocks (and a deleted file's manifest), in the background.
+// *gc_pending is set to true if garbage collection is underway; fs_entry_vacuumer_gc_done() will then retire the request's
+// journal record once every RG has acknowledged it.  Otherwise, there was nothing to collect.
+// return VACUUM_DONE if they're on their way (or there were none)
+// return VACUUM_THROTTLED if we're out of budget
+// return negative on error
+static int fs_entry_vacuumer_collect_garbage( struct fs_vacuumer* vac, struct fs_vacuumer_request* vreq, bool* gc_pending ) {
+   
+   *gc_pending = false;
+   
+   if( vreq->garbage->size() == 0 ) {
+      return VACUUM_DONE;
+   }
+   
+   if( !fs_entry_vacuumer_gc_throttle( vac, vreq->garbage->size() ) ) {
+      return VACUUM_THROTTLED;
+   }
+   
+   int rc = fs_entry_garbage_collect_kickoff_ex( vac->core, vreq->fs_path, &vreq->fent_snapshot, vreq->garbage, (vreq->type == VACUUM_TYPE_FILE), vreq->journal_id, gc_pending );
+   if( rc != 0 ) {
+      SG_error("fs_entry_garbage_collect_kickoff(%s %" PRIX64 ") rc = %d\n", vreq->fs_path, vreq->fent_snapshot.file_id, rc );
+      return rc;
+   }
+   
+   return VACUUM_DONE;
+}
+
+
+// finish a persistent request whose garbage collection was underway.
+// on success, its journal record is removed.  On failure, the record stays, so the request is retried on the next start.
+// called from the garbage-collection continuations, once every RG has acknowledged (or garbage collection failed)
+int fs_entry_vacuumer_gc_done( struct fs_vacuumer* vac, uint64_t journal_id, int rc ) {
+   
+   if( rc != 0 ) {
+      SG_error("Garbage collection for vacuum request %016" PRIX64 " failed (rc = %d); it will be retried on restart\n", journal_id, rc );
+      return rc;
+   }
+   
+   if( vac->journal_dir == NULL ) {
+      return -ENOTCONN;
+   }
+   
+   SG_debug("Garbage collection for vacuum request %016" PRIX64 " is acknowledged\n", journal_id );
+   
+   return fs_entry_vacuumer_journal_remove( vac, journal_id, VACUUM_JOURNAL_SUFFIX, true );
+}
+
+
+// make a stand-in for a deleted file's fent, with just enough state to fetch its old manifests
+static void fs_entry_vacuumer_standin_fent( struct replica_snapshot* snapshot, struct fs_entry* fent ) {
+   
+   memset( fent, 0, sizeof(struct fs_entry) );
+   
+   fent->ftype = FTYPE_FILE;
+   fent->file_id = snapshot->file_id;
+   fent->version = snapshot->file_version;
+   fent->owner = snapshot->owner_id;
+   fent->coordinator = snapshot->coordinator_id;
+   fent->volume = snapshot->volume_id;
+   fent->size = snapshot->size;
+   fent->mtime_sec = snapshot->fent_mtime_sec;
+   fent->mtime_nsec = snapshot->fent_mtime_nsec;
+   fent->max_write_freshness = snapshot->max_write_freshness;
+}
+
 // build a garbage modification map from a manifest and a list of write-affected blocks.
 // return -EINVAL if the affected blocks aren't in the manifest
 static int fs_entry_vacuumer_get_garbage_block_info( Serialization::ManifestMsg* manifest_msg, uint64_t* affected_blocks, size_t num_affected_blocks, modification_map* garbage ) {
@@ -570,67 +1332,121 @@ static void* vacuumer_main( void* arg ) {
       
       if( vac->vacuum_set->size() > 0 ) {
          
+         bool progress = false;         // did any request get anywhere?
+         int num_journal_removed = 0;
+         
          // process pending requests 
          for( vacuum_set_t::iterator itr = vac->vacuum_set->begin(); itr != vac->vacuum_set->end(); itr++ ) {
             
             struct fs_vacuumer_request vreq = *itr;
             int rc = 0;
             char const* method = NULL;
+            bool gc_pending = false;        // will garbage collection retire the journal record?
+            bool persistent = (vreq.type == VACUUM_TYPE_FILE || vreq.type == VACUUM_TYPE_BLOCKS);
             
             // peek the log 
             struct ms_vacuum_entry ve;
             memset( &ve, 0, sizeof(struct ms_vacuum_entry) );
             
-            rc = fs_entry_vacuumer_get_next_write( vac->core, vreq.fent_snapshot.volume_id, vreq.fent_snapshot.file_id, vreq.fent_snapshot.manifest_mtime_sec, vreq.fent_snapshot.manifest_mtime_nsec, &ve );
-            
-            if( rc < 0 ) {
-               SG_error("fs_entry_vacuumer_get_next_write( %s %" PRIX64 " ) rc = %d\n", vreq.fs_path, vreq.fent_snapshot.file_id, rc );
-            }
-            else if( rc == VACUUM_HEAD ) {
+            if( vreq.type == VACUUM_TYPE_BLOCKS ) {
                
-               // just vacuum the log head 
-               method = "fs_entry_vacuumer_vacuum_write_log (HEAD)";
-               rc = fs_entry_vacuumer_vacuum_write_log( vac->core->ms, &ve );
+               // no writes to vacuum; just the blocks
+               method = "fs_entry_vacuumer_collect_garbage";
+               rc = fs_entry_vacuumer_collect_garbage( vac, &vreq, &gc_pending );
             }
-            else if( rc != VACUUM_DONE ) {
+            else {
+               
+               rc = fs_entry_vacuumer_get_next_write( vac->core, vreq.fent_snapshot.volume_id, vreq.fent_snapshot.file_id, vreq.fent_snapshot.manifest_mtime_sec, vreq.fent_snapshot.manifest_mtime_nsec, &ve );
                
-               // proceed with the request to vacuum data
-               switch( vreq.type ) {
-                  case VACUUM_TYPE_WRITE: {
+               if( rc < 0 ) {
+                  SG_error("fs_entry_vacuumer_get_next_write( %s %" PRIX64 " ) rc = %d\n", vreq.fs_path, vreq.fent_snapshot.file_id, rc );
+               }
+               else if( rc == VACUUM_HEAD ) {
+               
+                  // just vacuum the log head 
+                  method = "fs_entry_vacuumer_vacuum_write_log (HEAD)";
+                  rc = fs_entry_vacuumer_vacuum_write_log( vac->core->ms, &ve );
+               }
+               else if( rc == VACUUM_DONE ) {
+               
+                  if( vreq.type == VACUUM_TYPE_FILE ) {
+                  
+                     // all writes to the deleted file are vacuumed.  Collect its last data.
+                     method = "fs_entry_vacuumer_collect_garbage";
+                     rc = fs_entry_vacuumer_collect_garbage( vac, &vreq, &gc_pending );
+                  }
+               }
+               else {
+               
+                  // proceed with the request to vacuum data
+                  switch( vreq.type ) {
+                     case VACUUM_TYPE_WRITE: {
                      
-                     method = "fs_entry_vacuumer_vacuum_write";
-                     rc = fs_entry_vacuumer_vacuum_write( vac->core, vreq.fs_path, NULL, &vreq.fent_snapshot, &ve );
+                        method = "fs_entry_vacuumer_vacuum_write";
+                        rc = fs_entry_vacuumer_vacuum_write( vac->core, vreq.fs_path, NULL, &vreq.fent_snapshot, &ve );
                      
-                     if( rc >= 0 ) {
-                        // do the log entry as well 
-                        method = "fs_entry_vacuumer_vacuum_write; fs_entry_vacuumer_write_log";
-                        rc = fs_entry_vacuumer_vacuum_write_log( vac->core->ms, &ve );
+                        if( rc >= 0 ) {
+                           // do the log entry as well 
+                           method = "fs_entry_vacuumer_vacuum_write; fs_entry_vacuumer_write_log";
+                           rc = fs_entry_vacuumer_vacuum_write_log( vac->core->ms, &ve );
+                        }
+                     
+                        break;
                      }
+                  
+                     case VACUUM_TYPE_LOG: {
                      
-                     break;
-                  }
+                        method = "fs_entry_vacuumer_vacuum_write_log";
+                        rc = fs_entry_vacuumer_vacuum_write_log( vac->core->ms, &ve );
+                        break;
+                     }
                   
-                  case VACUUM_TYPE_LOG: {
+                     case VACUUM_TYPE_FILE: {
                      
-                     method = "fs_entry_vacuumer_vacuum_write_log";
-                     rc = fs_entry_vacuumer_vacuum_write_log( vac->core->ms, &ve );
-                     break;
-                  }
+                        if( !fs_entry_vacuumer_gc_throttle( vac, ve.num_affected_blocks ) ) {
+                           rc = VACUUM_THROTTLED;
+                           break;
+                        }
+                     
+                        // the file is gone, so fetch its old manifests on behalf of a stand-in
+                        struct fs_entry standin_fent;
+                        fs_entry_vacuumer_standin_fent( &vreq.fent_snapshot, &standin_fent );
+                     
+                        method = "fs_entry_vacuumer_vacuum_write";
+                        rc = fs_entry_vacuumer_vacuum_write( vac->core, vreq.fs_path, &standin_fent, &vreq.fent_snapshot, &ve );
+                     
+                        if( rc >= 0 ) {
+                           method = "fs_entry_vacuumer_vacuum_write; fs_entry_vacuumer_write_log";
+                           rc = fs_entry_vacuumer_vacuum_write_log( vac->core->ms, &ve );
+                        }
+                     
+                        break;
+                     }
                   
-                  default: {
+                     default: {
                      
-                     SG_error("unrecognized request type %d\n", vreq.type );
-                     rc = -EINVAL;
-                     break;
+                        SG_error("unrecognized request type %d\n", vreq.type );
+                        rc = -EINVAL;
+                        break;
+                     }
                   }
                }
             }
             
             // result?
-            if( rc == VACUUM_AGAIN ) {
+            if( rc == VACUUM_THROTTLED ) {
+               // out of garbage-collection budget; try again later
+               fs_entry_vacuumer_pending_wlock( vac );
+               vac->vacuum_pending->insert( vreq );
+               fs_entry_vacuumer_pending_unlock( vac );
+            }
+            else if( rc == VACUUM_AGAIN ) {
                // re-enqueue 
                SG_debug("Re-enqueue result of %s( %" PRIX64 " type %d )\n", method, vreq.fent_snapshot.file_id, vreq.type );
                
+               progress = true;
+               vreq.num_failures = 0;
+               
                fs_entry_vacuumer_pending_wlock( vac );
                vac->vacuum_pending->insert( vreq );
                fs_entry_vacuumer_pending_unlock( vac );
@@ -639,7 +1455,20 @@ static void* vacuumer_main( void* arg ) {
                // done!
                SG_debug("Finished request type %d on %" PRIX64 "\n", vreq.type, vreq.fent_snapshot.file_id );
                
-               fs_entry_vacuumer_set_vacuum_status( vac->core, vreq.fs_path, true, false, true, true );
+               progress = true;
+               
+               if( persistent ) {
+                  
+                  // the file is gone (or the blocks aren't part of it anymore).  If its garbage is still being collected,
+                  // fs_entry_vacuumer_gc_done() forgets the request once every RG has acknowledged; otherwise, forget it now.
+                  if( !gc_pending ) {
+                     fs_entry_vacuumer_journal_remove( vac, vreq.journal_id, VACUUM_JOURNAL_SUFFIX, false );
+                     num_journal_removed++;
+                  }
+               }
+               else {
+                  fs_entry_vacuumer_set_vacuum_status( vac->core, vreq.fs_path, true, false, true, true );
+               }
                
                fs_entry_vacuumer_request_free( &vreq );
             }
@@ -647,9 +1476,27 @@ static void* vacuumer_main( void* arg ) {
                // error 
                SG_error("%s( %" PRIX64 " type %d ) rc = %d\n", method, vreq.fent_snapshot.file_id, vreq.type, rc );
                
-               fs_entry_vacuumer_set_vacuum_status( vac->core, vreq.fs_path, true, false, true, false );
-               
-               fs_entry_vacuumer_request_free( &vreq );
+               if( persistent ) {
+                  
+                  vreq.num_failures++;
+                  
+                  if( vreq.num_failures < VACUUM_MAX_FAILURES ) {
+                     // try again later 
+                     fs_entry_vacuumer_pending_wlock( vac );
+                     vac->vacuum_pending->insert( vreq );
+                     fs_entry_vacuumer_pending_unlock( vac );
+                  }
+                  else {
+                     // leave it in the journal for the next start 
+                     SG_error("Giving up on vacuum request %016" PRIX64 " (%s %" PRIX64 ") until restart\n", vreq.journal_id, vreq.fs_path, vreq.fent_snapshot.file_id );
+                     fs_entry_vacuumer_request_free( &vreq );
+                  }
+               }
+               else {
+                  fs_entry_vacuumer_set_vacuum_status( vac->core, vreq.fs_path, true, false, true, false );
+                  
+                  fs_entry_vacuumer_request_free( &vreq );
+               }
             }
             
             ms_client_vacuum_entry_free( &ve );
@@ -658,6 +1505,16 @@ static void* vacuumer_main( void* arg ) {
          vac->vacuum_set->clear();
          
          fs_entry_vacuumer_unlock( vac );
+         
+         // make finished requests' removal durable, once per pass
+         if( num_journal_removed > 0 ) {
+            fs_entry_vacuumer_journal_sync( vac );
+         }
+         
+         if( !progress ) {
+            // everything is throttled or failing--wait for budget (or the MS and RGs) to come back
+            sleep(1);
+         }
       }
       else {
          
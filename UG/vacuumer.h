@@ -26,9 +26,20 @@
 #define VACUUM_AGAIN 0
 #define VACUUM_DONE 1
 #define VACUUM_HEAD 2
+#define VACUUM_THROTTLED 3                 // out of garbage-collection budget; try again later
 
 #define VACUUM_TYPE_WRITE 1                // vacuum a write to a file
 #define VACUUM_TYPE_LOG 2                  // only remove the vacuum log entry for a file
+#define VACUUM_TYPE_FILE 3                 // vacuum all writes to a deleted file, and then its data
+#define VACUUM_TYPE_BLOCKS 4               // garbage-collect a set of blocks (i.e. ones cut off by a truncate)
+
+// VACUUM_TYPE_FILE and VACUUM_TYPE_BLOCKS requests are persistent: they are journaled under $STORAGE_ROOT/vacuum/
+// before the caller returns, and replayed when the vacuumer starts.
+#define VACUUM_JOURNAL_DIR "vacuum/"
+#define VACUUM_JOURNAL_MAGIC 0x53475643    // "SGVC"
+
+// give up on a persistent request after this many consecutive failures.  Its journal record stays, so it will be retried on the next start.
+#define VACUUM_MAX_FAILURES 10
 
 typedef map<struct replica_context*, int> completion_map_t;
 
@@ -36,6 +47,11 @@ struct fs_vacuumer_request {
    int type;                    // one of VACUUM_TYPE_*
    char* fs_path;
    struct replica_snapshot fent_snapshot;
+   
+   // persistent requests only
+   uint64_t journal_id;         // ID of this request's journal record
+   modification_map* garbage;   // blocks to garbage-collect, once the file's writes (if any) are vacuumed
+   int num_failures;            // number of consecutive failed attempts
 };
 
 struct fs_vacuumer_request_comp {
@@ -63,6 +79,16 @@ struct fs_vacuumer {
    
    pthread_rwlock_t vacuum_pending_lock;
    
+   // persistent request journal
+   char* journal_dir;
+   uint64_t next_journal_id;
+   
+   // garbage-collection rate limit (token bucket).  Every RG in the Volume receives every garbage-collection request,
+   // so this bounds the rate at which each RG is asked to delete blocks.  Only the vacuumer thread touches these.
+   int64_t gc_blocks_per_sec;           // 0 for no limit
+   double gc_tokens;
+   struct timespec gc_last_refill;
+   
    pthread_t thread;
    bool running;
 };
@@ -79,6 +105,15 @@ int fs_entry_vacuumer_write_bg_fent( struct fs_vacuumer* vac, char const* fs_pat
 int fs_entry_vacuumer_log_entry_bg( struct fs_vacuumer* vac, char const* fs_path, struct replica_snapshot* snapshot );
 int fs_entry_vacuumer_file( struct fs_core* core, char const* fs_path, struct fs_entry* fent );
 
+// vacuum in the background, persistently
+int fs_entry_vacuumer_file_bg_begin( struct fs_vacuumer* vac, char const* fs_path, struct fs_entry* fent, struct fs_vacuumer_request* vreq );
+int fs_entry_vacuumer_file_bg_commit( struct fs_vacuumer* vac, struct fs_vacuumer_request* vreq );
+int fs_entry_vacuumer_file_bg_abort( struct fs_vacuumer* vac, struct fs_vacuumer_request* vreq );
+int fs_entry_vacuumer_blocks_bg( struct fs_vacuumer* vac, char const* fs_path, struct replica_snapshot* snapshot, modification_map* garbage );
+
+// called once a persistent request's background garbage collection has finished
+int fs_entry_vacuumer_gc_done( struct fs_vacuumer* vac, uint64_t journal_id, int rc );
+
 // update vacuum state 
 bool fs_entry_vacuumer_is_vacuuming( struct fs_entry* fent );
 bool fs_entry_vacuumer_is_vacuumed( struct fs_entry* fent );
@@ -201,7 +201,13 @@ int md_cache_block_future_clean( struct md_cache_block_future* f ) {
       f->block_fd = -1;
    }
    
-   SG_safe_free( f->block_data );
+   if( !f->borrowed ) {
+      SG_safe_free( f->block_data );
+   }
+   else {
+      f->block_data = NULL;
+   }
+   
    SG_safe_free( f->aio.aio_sigevent.sigev_value.sival_ptr );
    
    memset( &f->aio, 0, sizeof(f->aio) );
@@ -1484,17 +1490,17 @@ void* md_cache_main_loop( void* arg ) {
 }
 
 // add a block to the cache, to be written asynchronously.
+// if borrowed is true, the future only references data, and the caller remains responsible for it.
 // return a future that can be waited on 
 // return NULL on error, and set *_rc to the error code
 // *_rc can be:
 // * -EAGAN if the cache is not running
 // * -ENOMEM if OOM
 // * negative if we failed to open the block (see md_cache_open_block)
-// NOTE: the given data will be referenced!  Do NOT free it!
-struct md_cache_block_future* md_cache_write_block_async( struct md_syndicate_cache* cache,
-                                                          uint64_t file_id, int64_t file_version, uint64_t block_id, int64_t block_version,
-                                                          char* data, size_t data_len,
-                                                          bool detached, int* _rc ) {
+static struct md_cache_block_future* md_cache_write_block_async_ex( struct md_syndicate_cache* cache,
+                                                                    uint64_t file_id, int64_t file_version, uint64_t block_id, int64_t block_version,
+                                                                    char* data, size_t data_len,
+                                                                    bool detached, bool borrowed, int* _rc ) {
    
    *_rc = 0;
    
@@ -1526,6 +1532,8 @@ struct md_cache_block_future* md_cache_write_block_async( struct md_syndicate_ca
    
    md_cache_block_future_init( cache, f, file_id, file_version, block_id, block_version, block_fd, data, data_len, detached );
    
+   f->borrowed = borrowed;
+   
    md_cache_pending_wlock( cache );
    
    try {
@@ -1547,6 +1555,32 @@ struct md_cache_block_future* md_cache_write_block_async( struct md_syndicate_ca
    return f;
 }
 
+
+// add a block to the cache, to be written asynchronously.
+// return a future that can be waited on 
+// return NULL on error, and set *_rc to the error code (see md_cache_write_block_async_ex)
+// NOTE: the given data will be referenced!  Do NOT free it!
+struct md_cache_block_future* md_cache_write_block_async( struct md_syndicate_cache* cache,
+                                                          uint64_t file_id, int64_t file_version, uint64_t block_id, int64_t block_version,
+                                                          char* data, size_t data_len,
+                                                          bool detached, int* _rc ) {
+   
+   return md_cache_write_block_async_ex( cache, file_id, file_version, block_id, block_version, data, data_len, detached, false, _rc );
+}
+
+
+// add a block to the cache, to be written asynchronously, straight out of the caller's buffer (i.e. without copying it).
+// the future will not be detached, and it will not free data.
+// return a future that can be waited on 
+// return NULL on error, and set *_rc to the error code (see md_cache_write_block_async_ex)
+// NOTE: the caller must keep data alive and unmodified until the future has been waited on!
+struct md_cache_block_future* md_cache_write_block_async_borrowed( struct md_syndicate_cache* cache,
+                                                                   uint64_t file_id, int64_t file_version, uint64_t block_id, int64_t block_version,
+                                                                   char const* data, size_t data_len, int* _rc ) {
+   
+   return md_cache_write_block_async_ex( cache, file_id, file_version, block_id, block_version, (char*)data, data_len, false, true, _rc );
+}
+
 // wait for a write to finish
 // return 0 on success
 // return negative if we couldn't wait on the semaphore (see md_download_sem_wait)
@@ -88,6 +88,7 @@ struct md_cache_block_future {
    
    sem_t sem_ongoing;
    bool detached;       // if true, reap this future once the write finishes
+   bool borrowed;       // if true, block_data belongs to the caller and will not be freed with the future
    
    bool finalized;
 };
@@ -183,6 +184,10 @@ struct md_cache_block_future* md_cache_write_block_async( struct md_syndicate_ca
                                                           char* data, size_t data_len,
                                                           bool detached, int* rc );
 
+struct md_cache_block_future* md_cache_write_block_async_borrowed( struct md_syndicate_cache* cache,
+                                                                   uint64_t file_id, int64_t file_version, uint64_t block_id, int64_t block_version,
+                                                                   char const* data, size_t data_len, int* rc );
+
 int md_cache_block_future_wait( struct md_cache_block_future* f );
 int md_cache_block_future_free( struct md_cache_block_future* f );
 int md_cache_block_future_release_fd( struct md_cache_block_future* f );
@@ -102,9 +102,16 @@ int md_create_HTTP_response_ram_static( struct md_HTTP_response* resp, char cons
    return 0;
 }
 
-// make an file-descriptor-based response
-int md_create_HTTP_response_fd( struct md_HTTP_response* resp, char const* mimetype, int status, int fd, off_t offset, size_t size ) {
-   resp->resp = MHD_create_response_from_fd_at_offset( size, fd, offset );
+// make an file-descriptor-based response.  MHD sends size bytes from fd, starting at offset, with sendfile(2) where it can
+// (i.e. without copying the data through user space), and closes fd once it's done with the response.
+// return 0 on success, in which case the response owns fd
+// return -ENOMEM if MHD could not make the response, in which case the caller still owns fd
+int md_create_HTTP_response_fd( struct md_HTTP_response* resp, char const* mimetype, int status, int fd, uint64_t offset, uint64_t size ) {
+   resp->resp = MHD_create_response_from_fd_at_offset64( size, fd, offset );
+   if( resp->resp == NULL ) {
+      return -ENOMEM;
+   }
+   
    resp->status = status;
    MHD_add_response_header( resp->resp, "Content-Type", mimetype );
    return 0;
@@ -133,6 +140,71 @@ void md_free_HTTP_response( struct md_HTTP_response* resp ) {
 }
 
 
+// have a GET handler reply later, from another thread.  The handler calls this and returns NULL; the connection is then
+// suspended (so it does not hold up an HTTP thread) until some thread calls md_HTTP_connection_resume with the response.
+// the server must have been started with MHD_USE_SUSPEND_RESUME.
+// always succeeds
+int md_HTTP_connection_defer( struct md_HTTP_connection_data* con_data ) {
+   
+   pthread_mutex_lock( &con_data->defer_lock );
+   
+   con_data->deferred = true;
+   
+   pthread_mutex_unlock( &con_data->defer_lock );
+   return 0;
+}
+
+
+// supply the response to a deferred connection, and wake it up.  resp must be malloc'ed; the connection takes ownership.
+// call this exactly once per md_HTTP_connection_defer, from any thread.
+// return 0 on success
+// return -EINVAL if the connection was not deferred, or already has a response
+int md_HTTP_connection_resume( struct md_HTTP_connection_data* con_data, struct md_HTTP_response* resp ) {
+   
+   pthread_mutex_lock( &con_data->defer_lock );
+   
+   if( !con_data->deferred || con_data->resp != NULL ) {
+      
+      pthread_mutex_unlock( &con_data->defer_lock );
+      return -EINVAL;
+   }
+   
+   con_data->resp = resp;
+   
+   if( con_data->suspended ) {
+      
+      // MHD will call the connection handler again, which will send resp
+      con_data->suspended = false;
+      MHD_resume_connection( con_data->connection );
+   }
+   
+   // otherwise, the handler thread hasn't suspended the connection yet, and will send resp instead
+   pthread_mutex_unlock( &con_data->defer_lock );
+   
+   return 0;
+}
+
+
+// send a deferred connection's response if we have it, or suspend the connection until we do 
+static int md_HTTP_send_deferred_response( struct MHD_Connection* connection, struct md_HTTP_connection_data* con_data ) {
+   
+   pthread_mutex_lock( &con_data->defer_lock );
+   
+   if( con_data->resp == NULL ) {
+      
+      con_data->suspended = true;
+      MHD_suspend_connection( connection );
+      
+      pthread_mutex_unlock( &con_data->defer_lock );
+      return MHD_YES;
+   }
+   
+   pthread_mutex_unlock( &con_data->defer_lock );
+   
+   return md_HTTP_send_response( connection, con_data->resp );
+}
+
+
 // find an http header value
 char const* md_find_HTTP_header( struct md_HTTP_header** headers, char const* header ) {
    for( int i = 0; headers[i] != NULL; i++ ) {
@@ -409,6 +481,9 @@ static int md_HTTP_connection_handler( void* cls, struct MHD_Connection* connect
       con_data->cls = NULL;
       con_data->status = 200;
       con_data->pp = pp;
+      con_data->connection = connection;
+      
+      pthread_mutex_init( &con_data->defer_lock, NULL );
 
       char const* content_length_str = MHD_lookup_connection_value( connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_CONTENT_LENGTH );
       if( content_length_str != NULL )
@@ -537,7 +612,18 @@ static int md_HTTP_connection_handler( void* cls, struct MHD_Connection* connect
    // GET
    else if( con_data->mode == MD_HTTP_GET ) {
       
+      if( con_data->deferred ) {
+         // woken up with the response
+         return md_HTTP_send_deferred_response( connection, con_data );
+      }
+      
       struct md_HTTP_response* resp = (*http_ctx->HTTP_GET_handler)( con_data );
+      
+      if( resp == NULL && con_data->deferred ) {
+         // handler will reply later
+         return md_HTTP_send_deferred_response( connection, con_data );
+      }
+      
       if( resp == NULL ) {
          resp = SG_CALLOC(struct md_HTTP_response, 1);
          md_create_HTTP_response_ram_static( resp, (char*)"text/plain", 500, MD_HTTP_500_MSG, strlen(MD_HTTP_500_MSG) + 1 );
@@ -600,6 +686,10 @@ void md_HTTP_free_connection_data( struct md_HTTP_connection_data* con_data ) {
       delete con_data->rb;
       con_data->rb = NULL;
    }
+   if( con_data->connection ) {
+      pthread_mutex_destroy( &con_data->defer_lock );
+      con_data->connection = NULL;
+   }
 }
 
 // default cleanup handler
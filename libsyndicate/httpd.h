@@ -130,6 +130,12 @@ struct md_HTTP_connection_data {
    char* url_path;            // path requested
    char* query_string;        // url's query string
    md_response_buffer_t* rb;     // response buffer for small messages
+   
+   // deferred responses (see md_HTTP_connection_defer)
+   struct MHD_Connection* connection;
+   pthread_mutex_t defer_lock;          // guards resp and suspended once deferred
+   bool deferred;                       // the handler will supply the response later, from another thread
+   bool suspended;                      // MHD has suspended the connection until then
 };
 
 // gateway request structure
@@ -256,10 +262,14 @@ int md_response_buffer_upload_iterator(void *coninfo_cls, enum MHD_ValueKind kin
 int md_create_HTTP_response_ram( struct md_HTTP_response* resp, char const* mimetype, int status, char const* data, int len );
 int md_create_HTTP_response_ram_nocopy( struct md_HTTP_response* resp, char const* mimetype, int status, char const* data, int len );
 int md_create_HTTP_response_ram_static( struct md_HTTP_response* resp, char const* mimetype, int status, char const* data, int len );
-int md_create_HTTP_response_fd( struct md_HTTP_response* resp, char const* mimetype, int status, int fd, off_t offset, size_t size );
+int md_create_HTTP_response_fd( struct md_HTTP_response* resp, char const* mimetype, int status, int fd, uint64_t offset, uint64_t size );
 int md_create_HTTP_response_stream( struct md_HTTP_response* resp, char const* mimetype, int status, uint64_t size, size_t blk_size, md_HTTP_stream_callback scb, void* cls, md_HTTP_free_cls_callback fcb );
 void md_free_HTTP_response( struct md_HTTP_response* resp );
 
+// deferred responses 
+int md_HTTP_connection_defer( struct md_HTTP_connection_data* con_data );
+int md_HTTP_connection_resume( struct md_HTTP_connection_data* con_data, struct md_HTTP_response* resp );
+
 // get/set closure
 void* md_cls_get( void* cls );
 void md_cls_set_status( void* cls, int status );
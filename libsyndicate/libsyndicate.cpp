@@ -18,6 +18,7 @@
 #include "libsyndicate/storage.h"
 #include "libsyndicate/opts.h"
 #include "libsyndicate/ms/ms-client.h"
+#include "libsyndicate/trace.h"
 
 #define INI_MAX_LINE 4096
 #define INI_STOP_ON_FIRST_ERROR 1
@@ -153,6 +154,12 @@ static int md_runtime_init( struct md_syndicate_conf* c, char const* key_passwor
       return rc;
    }
    
+   rc = md_trace_init( c->trace_sample_rate );
+   if( rc != 0 ) {
+      SG_error("md_trace_init rc = %d\n", rc );
+      return rc;
+   }
+   
    // get the umask
    mode_t um = md_get_umask();
    c->usermask = um;
@@ -320,6 +327,8 @@ int md_shutdown() {
    
    md_crypt_shutdown();
    
+   md_trace_shutdown();
+   
    curl_global_cleanup();
    return 0;
 }
@@ -440,6 +449,33 @@ static int md_conf_ini_parser( void* userdata, char const* section, char const*
          }
       }
       
+      else if( strcmp( key, SG_CONFIG_STATS_PATH ) == 0 ) {
+         // statistics output path
+         conf->stats_path = SG_strdup_or_null( value );
+         if( conf->stats_path == NULL ) {
+            return -ENOMEM;
+         }
+      }
+      
+      else if( strcmp( key, SG_CONFIG_TRACE_SAMPLE_RATE ) == 0 ) {
+         // trace one in this many requests
+         rc = md_conf_parse_long( value, &val );
+         if( rc == 0 && val >= 0 ) {
+            conf->trace_sample_rate = val;
+         }
+         else {
+            return -EINVAL;
+         }
+      }
+      
+      else if( strcmp( key, SG_CONFIG_TRACE_PATH ) == 0 ) {
+         // where to dump traces
+         conf->trace_path = SG_strdup_or_null( value );
+         if( conf->trace_path == NULL ) {
+            return -ENOMEM;
+         }
+      }
+      
       else if( strcmp( key, SG_CONFIG_GATHER_STATS ) == 0 ) {
          // gather statistics?
          rc = md_conf_parse_long( value, &val );
@@ -462,6 +498,37 @@ static int md_conf_ini_parser( void* userdata, char const* section, char const*
          }
       }
       
+      else if( strcmp( key, SG_CONFIG_NUM_DRIVER_WORKERS ) == 0 ) {
+         // how big is the driver threadpool?
+         rc = md_conf_parse_long( value, &val );
+         if( rc == 0 && val > 0 ) {
+            conf->num_driver_workers = val;
+         }
+         else {
+            return -EINVAL;
+         }
+      }
+      
+      else if( strcmp( key, SG_CONFIG_DRIVER_MAX_CONCURRENCY ) == 0 ) {
+         rc = md_conf_parse_long( value, &val );
+         if( rc == 0 && val > 0 ) {
+            conf->driver_max_concurrency = val;
+         }
+         else {
+            return -EINVAL;
+         }
+      }
+      
+      else if( strcmp( key, SG_CONFIG_DRIVER_MAX_QUEUE ) == 0 ) {
+         rc = md_conf_parse_long( value, &val );
+         if( rc == 0 && val >= 0 ) {
+            conf->driver_max_queue = val;
+         }
+         else {
+            return -EINVAL;
+         }
+      }
+      
       else if( strcmp( key, SG_CONFIG_STORAGE_ROOT ) == 0 ) {
          // storage root
          size_t len = strlen( value );
@@ -604,6 +671,56 @@ static int md_conf_ini_parser( void* userdata, char const* section, char const*
             return -EINVAL;
          }
       }
+      
+      else if( strcmp( key, SG_CONFIG_REMOTE_WRITE_BATCH_WINDOW ) == 0 ) {
+         rc = md_conf_parse_long( value, &val );
+         if( rc == 0 && val >= 0 ) {
+            conf->remote_write_batch_window_ms = val;
+         }
+         else {
+            return -EINVAL;
+         }
+      }
+      
+      else if( strcmp( key, SG_CONFIG_RENAME_BATCH_WINDOW ) == 0 ) {
+         rc = md_conf_parse_long( value, &val );
+         if( rc == 0 && val >= 0 ) {
+            conf->rename_batch_window_ms = val;
+         }
+         else {
+            return -EINVAL;
+         }
+      }
+      
+      else if( strcmp( key, SG_CONFIG_NEGATIVE_CACHE_SIZE ) == 0 ) {
+         rc = md_conf_parse_long( value, &val );
+         if( rc == 0 && val >= 0 ) {
+            conf->negative_cache_size = val;
+         }
+         else {
+            return -EINVAL;
+         }
+      }
+      
+      else if( strcmp( key, SG_CONFIG_NEGATIVE_CACHE_TTL ) == 0 ) {
+         rc = md_conf_parse_long( value, &val );
+         if( rc == 0 && val >= 0 ) {
+            conf->negative_cache_ttl_ms = val;
+         }
+         else {
+            return -EINVAL;
+         }
+      }
+      
+      else if( strcmp( key, SG_CONFIG_GC_BLOCKS_PER_SECOND ) == 0 ) {
+         rc = md_conf_parse_long( value, &val );
+         if( rc == 0 && val >= 0 ) {
+            conf->gc_blocks_per_second = val;
+         }
+         else {
+            return -EINVAL;
+         }
+      }
 
       else {
          SG_error( "Unrecognized key '%s'\n", key );
@@ -644,6 +761,8 @@ int md_free_conf( struct md_syndicate_conf* conf ) {
    void* to_free[] = {
       (void*)conf->metadata_url,
       (void*)conf->logfile_path,
+      (void*)conf->stats_path,
+      (void*)conf->trace_path,
       (void*)conf->content_url,
       (void*)conf->data_root,
       (void*)conf->ms_username,
@@ -2093,6 +2212,10 @@ int md_default_conf( struct md_syndicate_conf* conf, int gateway_type ) {
    
    conf->num_http_threads = sysconf( _SC_NPROCESSORS_CONF );
    
+   conf->num_driver_workers = 64;
+   conf->driver_max_concurrency = 16;
+   conf->driver_max_queue = 4096;
+   
    conf->debug_lock = false;
 
    conf->connect_timeout = 600;
@@ -2113,6 +2236,14 @@ int md_default_conf( struct md_syndicate_conf* conf, int gateway_type ) {
    conf->max_read_retry = 3;
    conf->max_write_retry = 3;
    
+   conf->remote_write_batch_window_ms = 5;
+   conf->rename_batch_window_ms = 2;
+   
+   conf->negative_cache_size = 4096;
+   conf->negative_cache_ttl_ms = 1000;
+   
+   conf->gc_blocks_per_second = 1000;
+   
    if( gateway_type == SYNDICATE_UG ) {
       // need both storage and networking to be set up
       conf->need_storage = true;
@@ -159,6 +159,9 @@ struct md_syndicate_conf {
    int64_t default_write_freshness;                   // default number of milliseconds a file can age before needing refresh for writes
    char* logfile_path;                                // path to the logfile
    bool gather_stats;                                 // gather statistics or not?
+   char* stats_path;                                  // where to write gathered statistics (preferably on a RAM fs)
+   int trace_sample_rate;                             // trace one in this many requests (0 disables tracing)
+   char* trace_path;                                  // where to write traces, as Chrome trace JSON
    char* content_url;                                 // what is the URL under which local data can be accessed publicly?.  Must end in /
    char* storage_root;                                // toplevel directory that stores local syndicate state (blocks, manifests, logs, etc).  Must end in /
    char* volume_name;                                 // name of the volume we're connected to
@@ -168,9 +171,17 @@ struct md_syndicate_conf {
    int max_metadata_read_retry;                       // maximum number of times to retry a metadata read before considering it failed 
    int max_metadata_write_retry;                      // maximum number of times to retry a metadata write before considering it failed
    int retry_delay_ms;                                // number of milliseconds to wait between retries
+   int remote_write_batch_window_ms;                  // number of milliseconds a coordinator waits for concurrent remote writes to a file, when others are already in flight, so it can apply them together
+   int rename_batch_window_ms;                        // number of milliseconds a rename waits for concurrent renames, so the MS can be sent all of them at once
+   int negative_cache_size;                           // maximum number of nonexistent paths to remember (0 disables)
+   int negative_cache_ttl_ms;                         // number of milliseconds a path can be remembered as nonexistent before asking the MS again
+   int gc_blocks_per_second;                          // maximum number of blocks per second the vacuumer asks the RGs to garbage-collect (0 for no limit)
    
    // RG/AG servers
    unsigned int num_http_threads;                     // how many HTTP threads to create
+   unsigned int num_driver_workers;                   // how many threads run driver requests, off of the HTTP threads (AG only)
+   unsigned int driver_max_concurrency;               // maximum number of requests a single driver may be serving at once (AG only)
+   unsigned int driver_max_queue;                     // maximum number of requests that may wait for a single driver before new ones are turned away with a 503 (AG only)
    char* server_key_path;                             // path to PEM-encoded TLS public/private key for this gateway server
    char* server_cert_path;                            // path to PEM-encoded TLS certificate for this gateway server
    char* local_sd_dir;                                // directory containing local storage drivers (AG only)
@@ -242,7 +253,13 @@ struct md_syndicate_conf {
 #define SG_CONFIG_MS_URL                  "MS_URL"
 #define SG_CONFIG_LOGFILE_PATH            "LOGFILE"
 #define SG_CONFIG_GATHER_STATS            "GATHER_STATISTICS"
+#define SG_CONFIG_STATS_PATH              "STATISTICS_FILE"
+#define SG_CONFIG_TRACE_SAMPLE_RATE       "TRACE_SAMPLE_RATE"
+#define SG_CONFIG_TRACE_PATH              "TRACE_FILE"
 #define SG_CONFIG_NUM_HTTP_THREADS        "HTTP_THREADPOOL_SIZE"
+#define SG_CONFIG_NUM_DRIVER_WORKERS      "DRIVER_THREADPOOL_SIZE"
+#define SG_CONFIG_DRIVER_MAX_CONCURRENCY  "DRIVER_MAX_CONCURRENCY"
+#define SG_CONFIG_DRIVER_MAX_QUEUE        "DRIVER_MAX_QUEUE"
 #define SG_CONFIG_STORAGE_ROOT            "STORAGE_ROOT"
 #define SG_CONFIG_TLS_PKEY_PATH           "TLS_PKEY"
 #define SG_CONFIG_TLS_CERT_PATH           "TLS_CERT"
@@ -255,6 +272,11 @@ struct md_syndicate_conf {
 #define SG_CONFIG_DEBUG_LEVEL             "DEBUG_LEVEL"
 #define SG_CONFIG_LOCAL_DRIVERS_DIR       "LOCAL_DRIVERS_DIR"
 #define SG_CONFIG_TRANSFER_TIMEOUT        "TRANSFER_TIMEOUT"
+#define SG_CONFIG_REMOTE_WRITE_BATCH_WINDOW "REMOTE_WRITE_BATCH_WINDOW_MS"
+#define SG_CONFIG_RENAME_BATCH_WINDOW "RENAME_BATCH_WINDOW_MS"
+#define SG_CONFIG_NEGATIVE_CACHE_SIZE     "NEGATIVE_CACHE_SIZE"
+#define SG_CONFIG_NEGATIVE_CACHE_TTL      "NEGATIVE_CACHE_TTL_MS"
+#define SG_CONFIG_GC_BLOCKS_PER_SECOND    "GC_BLOCKS_PER_SECOND"
 
 // URL protocol prefix for local files
 #define SG_LOCAL_PROTO     "file://"
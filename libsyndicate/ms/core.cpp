@@ -270,8 +270,16 @@ int ms_client_init( struct ms_client* client, int gateway_type, struct md_syndic
    
    client->userpass = NULL;
 
+   client->leases = SG_safe_new( ms_client_lease_map_t() );
+   if( client->leases == NULL ) {
+      
+      SG_safe_free( client->url );
+      return -ENOMEM;
+   }
+
    pthread_rwlock_init( &client->lock, NULL );
    pthread_rwlock_init( &client->config_lock, NULL );
+   pthread_rwlock_init( &client->leases_lock, NULL );
 
    client->conf = conf;
 
@@ -283,6 +291,7 @@ int ms_client_init( struct ms_client* client, int gateway_type, struct md_syndic
       SG_error("ms_client_try_load_key rc = %d\n", rc );
       
       SG_safe_free( client->url );
+      SG_safe_delete( client->leases );
       
       return rc;
    }
@@ -297,6 +306,7 @@ int ms_client_init( struct ms_client* client, int gateway_type, struct md_syndic
          SG_error("md_public_key_from_private_key( %p ) rc = %d\n", client->gateway_key, rc );
          
          SG_safe_free( client->url );
+         SG_safe_delete( client->leases );
          return rc;
       }
    }
@@ -310,6 +320,7 @@ int ms_client_init( struct ms_client* client, int gateway_type, struct md_syndic
       SG_error("ms_client_try_load_key rc = %d\n", rc );
       
       SG_safe_free( client->url );
+      SG_safe_delete( client->leases );
       return rc;
    }
    
@@ -353,6 +364,14 @@ int ms_client_destroy( struct ms_client* client ) {
    pthread_rwlock_unlock( &client->config_lock );
    pthread_rwlock_destroy( &client->config_lock );
    
+   // clean up leases 
+   pthread_rwlock_wrlock( &client->leases_lock );
+   
+   SG_safe_delete( client->leases );
+   
+   pthread_rwlock_unlock( &client->leases_lock );
+   pthread_rwlock_destroy( &client->leases_lock );
+   
    sem_destroy( &client->uploader_sem );
    
    // clean up our state
@@ -57,6 +57,16 @@ using namespace std;
 // prototypes 
 struct ms_volume;
 
+// metadata lease on a directory (see lease.h)
+struct ms_client_lease {
+   int64_t generation;          // MS-side generation of the directory's children
+   int64_t since_ms;            // when we first saw this generation; entries loaded before then are not covered
+   int64_t renewed_ms;          // when the MS last confirmed the generation
+   int64_t expires_ms;          // when the lease runs out
+};
+
+typedef map<uint64_t, struct ms_client_lease> ms_client_lease_map_t;
+
 // callback to be alerted when a volume's gateway config changes
 typedef int (*ms_client_config_change_callback)( struct ms_client*, void* );
 
@@ -91,6 +101,8 @@ struct ms_client {
    int max_request_async_batch;     // maximum number of asynchronous requests we can send in one multi_request
    int max_connections;       // maximum number of open connections to make to the MS
    int ms_transfer_timeout;     // how long to wait for data transfer before failing with -EAGAIN
+   int64_t listdir_page_latency_us;     // moving average of how long the MS takes to serve a page of a listing (microseconds)
+   int64_t listdir_page_apply_us;       // moving average of how long the caller takes to consume a page of a listing (microseconds)
    
    //////////////////////////////////////////////////////////////////
    // gateway volume-change structures (represents a consistent view of the Volume control state)
@@ -104,6 +116,11 @@ struct ms_client {
    
    pthread_rwlock_t config_lock;          // lock governing the above
 
+   //////////////////////////////////////////////////////////////////
+   // metadata leases the MS has granted us, by directory ID
+   ms_client_lease_map_t* leases;
+   pthread_rwlock_t leases_lock;          // lock governing the above
+
    //////////////////////////////////////////////////////////////////
    // session information
    int64_t session_expires;                 // when the session password expires
@@ -94,6 +94,13 @@ static int ms_client_update_set_serialize( ms_client_update_set* updates, ms::ms
             }
          }
          
+         // if this is a DELETE, then tell the MS whether or not we'll vacuum outstanding writes afterwards 
+         else if( update->op == ms::ms_update::DELETE ) {
+            if( update->flags & MS_CLIENT_DELETE_DEFER_VACUUM ) {
+               ms_up->set_defer_vacuum( true );
+            }
+         }
+         
          // if this is a RENAME, then add the 'dest' argument
          else if( update->op == ms::ms_update::RENAME ) {
             ms::ms_entry* dest_ent = ms_up->mutable_dest();
@@ -220,9 +227,17 @@ static int ms_client_add_update( ms_client_update_set* updates, struct md_update
    return 0;
 }
 
-// random 64-bit number
+// random 64-bit number.
+// 0 is the root's, and all 1's is reserved (front-ends that need a distinct inode number for file ID 1 use it)
 uint64_t ms_client_make_file_id() {
-   return (uint64_t)md_random64();
+   
+   uint64_t file_id = 0;
+   
+   do {
+      file_id = (uint64_t)md_random64();
+   } while( file_id == 0 || file_id == (uint64_t)(-1) );
+   
+   return file_id;
 }
 
 // free a multi-result 
@@ -574,6 +589,21 @@ static int ms_client_multi_parse_results( struct ms_client_multi_context* ctx, m
          ent = NULL;
       }
    }
+   else {
+      
+      // no entries (i.e. every operation failed, or none returns one); just record the return codes
+      for( int i = 0; i < num_items_processed; i++ ) {
+         
+         struct ms_client_request_result result;
+         memset( &result, 0, sizeof(struct ms_client_request_result) );
+         
+         result.file_id = rctx->file_ids[i];
+         result.rc = reply->errors(i);
+         result.reply_error = *reply_error;
+         
+         ctx->results[ rctx->result_offset + i ] = result;
+      }
+   }
    
    return rc;
 }
@@ -1076,6 +1106,7 @@ int ms_client_rename_request( struct ms_client* client, struct md_entry* src, st
    
    request->ent = src;
    request->dest = dest;
+   request->op = ms::ms_update::RENAME;
    
    return 0;
 }
@@ -1403,6 +1434,11 @@ int ms_client_mkdir( struct ms_client* client, uint64_t* file_id_ret, int64_t* w
 
 // delete a record from the MS, synchronously
 int ms_client_delete( struct ms_client* client, struct md_entry* ent ) {
+   return ms_client_delete_ex( client, ent, 0 );
+}
+
+// delete a record from the MS, synchronously, with MS_CLIENT_DELETE_* flags
+int ms_client_delete_ex( struct ms_client* client, struct md_entry* ent, int flags ) {
    
    int rc = 0;
    struct ms_client_request_result result;
@@ -1414,6 +1450,7 @@ int ms_client_delete( struct ms_client* client, struct md_entry* ent ) {
    // populate the request 
    req.ent = ent;
    req.op = ms::ms_update::DELETE;
+   req.flags = flags;
    
    // perform the operation 
    rc = ms_client_single_rpc( client, &req, &result );
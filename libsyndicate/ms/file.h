@@ -64,6 +64,9 @@ typedef map<long, struct md_update> ms_client_update_set;
 // does an operation return an entry from the MS?
 #define MS_CLIENT_OP_RETURNS_ENTRY( op ) ((op) == ms::ms_update::CREATE || (op) == ms::ms_update::UPDATE || (op) == ms::ms_update::CHCOORD || (op) == ms::ms_update::RENAME)
 
+// DELETE flags 
+#define MS_CLIENT_DELETE_DEFER_VACUUM  0x1      // delete even if there are unvacuumed writes; the caller (the coordinator) will vacuum them afterwards
+
 extern "C" {
    
 // high-level file metadata API
@@ -71,6 +74,7 @@ uint64_t ms_client_make_file_id();
 int ms_client_create( struct ms_client* client, uint64_t* file_id, int64_t* write_nonce, struct md_entry* ent );
 int ms_client_mkdir( struct ms_client* client, uint64_t* file_id, int64_t* write_nonce, struct md_entry* ent );
 int ms_client_delete( struct ms_client* client, struct md_entry* ent );
+int ms_client_delete_ex( struct ms_client* client, struct md_entry* ent, int flags );
 int ms_client_update_write( struct ms_client* client, int64_t* write_nonce, struct md_entry* ent, uint64_t* affected_blocks, size_t num_affected_blocks );
 int ms_client_update( struct ms_client* client, int64_t* write_nonce, struct md_entry* ent );
 int ms_client_coordinate( struct ms_client* client, uint64_t* new_coordinator, int64_t* write_nonce, struct md_entry* ent );
@@ -87,8 +91,8 @@ int ms_client_mkdir_async_request( struct ms_client* client, struct md_entry* en
 int ms_client_update_request( struct ms_client* client, struct md_entry* ent, struct ms_client_request* request );
 int ms_client_update_async_request( struct ms_client* client, struct md_entry* ent, struct ms_client_request* request );
 int ms_client_update_write_request( struct ms_client* client, struct md_entry* ent, uint64_t* affected_blocks, size_t num_affected_blocks, struct ms_client_request* request );
-int ms_client_coordinate_request( struct ms_client* client, struct md_entry* ent );
-int ms_client_rename_request( struct ms_client* client, struct md_entry* src, struct md_entry* dest );
+int ms_client_coordinate_request( struct ms_client* client, struct md_entry* ent, struct ms_client_request* request );
+int ms_client_rename_request( struct ms_client* client, struct md_entry* src, struct md_entry* dest, struct ms_client_request* request );
 int ms_client_delete_request( struct ms_client* client, struct md_entry* ent, struct ms_client_request* request );
 int ms_client_delete_async_request( struct ms_client* client, struct md_entry* ent, struct ms_client_request* request );
 int ms_client_request_set_cls( struct ms_client_request* request, void* cls );
@@ -0,0 +1,147 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "libsyndicate/ms/lease.h"
+
+// remember a lease the MS granted us on a directory.
+// a lease_ttl of 0 means the MS would not grant one, so forget any lease we had.
+// return 0 on success
+// return -ENOMEM if out of memory
+int ms_client_lease_grant( struct ms_client* client, uint64_t file_id, int64_t generation, int32_t lease_ttl ) {
+
+   int64_t now_ms = md_current_time_millis();
+
+   pthread_rwlock_wrlock( &client->leases_lock );
+
+   if( lease_ttl <= 0 ) {
+
+      client->leases->erase( file_id );
+
+      pthread_rwlock_unlock( &client->leases_lock );
+      return 0;
+   }
+
+   try {
+
+      ms_client_lease_map_t::iterator itr = client->leases->find( file_id );
+
+      if( itr == client->leases->end() ) {
+
+         // new lease.  Only entries loaded from now on are covered
+         struct ms_client_lease lease;
+
+         lease.generation = generation;
+         lease.since_ms = now_ms;
+         lease.renewed_ms = now_ms;
+         lease.expires_ms = now_ms + lease_ttl;
+
+         (*client->leases)[ file_id ] = lease;
+      }
+      else {
+
+         struct ms_client_lease* lease = &itr->second;
+
+         if( lease->generation != generation ) {
+
+            // children changed on the MS since we last looked.  Cached entries from before now are suspect.
+            SG_debug("lease generation of %" PRIX64 " changed: %" PRId64 " --> %" PRId64 "\n", file_id, lease->generation, generation );
+
+            lease->generation = generation;
+            lease->since_ms = now_ms;
+         }
+
+         lease->renewed_ms = now_ms;
+         lease->expires_ms = now_ms + lease_ttl;
+      }
+   }
+   catch( bad_alloc& ba ) {
+
+      pthread_rwlock_unlock( &client->leases_lock );
+      return -ENOMEM;
+   }
+
+   pthread_rwlock_unlock( &client->leases_lock );
+
+   return 0;
+}
+
+
+// does a lease on a directory cover an entry that was loaded at loaded_at, and that may be at most max_read_freshness millis out of date?
+// loaded_at can be NULL, in which case only the lease itself is checked (and max_read_freshness is ignored).
+// return 0 if so
+// return -ENOENT if we have no lease on this directory
+// return -ETIMEDOUT if the lease expired
+// return -ESTALE if the lease is valid, but the entry was loaded before the lease's current generation, or the lease
+// was last renewed longer ago than max_read_freshness (so the generation may have changed without our knowing)
+int ms_client_lease_check( struct ms_client* client, uint64_t file_id, struct timespec* loaded_at, int32_t max_read_freshness ) {
+
+   int rc = 0;
+   int64_t now_ms = md_current_time_millis();
+
+   pthread_rwlock_rdlock( &client->leases_lock );
+
+   ms_client_lease_map_t::iterator itr = client->leases->find( file_id );
+
+   if( itr == client->leases->end() ) {
+
+      rc = -ENOENT;
+   }
+   else if( itr->second.expires_ms <= now_ms ) {
+
+      rc = -ETIMEDOUT;
+   }
+   else if( loaded_at != NULL ) {
+
+      int64_t loaded_at_ms = (int64_t)loaded_at->tv_sec * 1000 + (int64_t)loaded_at->tv_nsec / 1000000;
+
+      if( loaded_at_ms < itr->second.since_ms || now_ms - itr->second.renewed_ms >= (int64_t)max_read_freshness ) {
+
+         rc = -ESTALE;
+      }
+   }
+
+   pthread_rwlock_unlock( &client->leases_lock );
+
+   return rc;
+}
+
+
+// forget a lease on a directory (i.e. because we know its children changed)
+// always succeeds
+int ms_client_lease_revoke( struct ms_client* client, uint64_t file_id ) {
+
+   pthread_rwlock_wrlock( &client->leases_lock );
+
+   client->leases->erase( file_id );
+
+   pthread_rwlock_unlock( &client->leases_lock );
+
+   return 0;
+}
+
+
+// forget all leases
+// always succeeds
+int ms_client_lease_revoke_all( struct ms_client* client ) {
+
+   pthread_rwlock_wrlock( &client->leases_lock );
+
+   client->leases->clear();
+
+   pthread_rwlock_unlock( &client->leases_lock );
+
+   return 0;
+}
@@ -0,0 +1,40 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef _MS_CLIENT_LEASE_H_
+#define _MS_CLIENT_LEASE_H_
+
+#include "libsyndicate/ms/core.h"
+
+// Metadata leases.
+// When the MS serves a directory, it may grant a lease on it:  for lease_ttl milliseconds, the caller can trust its
+// cached copies of the directory's children (and of the directory itself, if it is the root) without asking again.
+// The lease is tagged with the MS-side generation of the directory's children, which changes whenever one of
+// them gets created, updated, deleted, or renamed.  A renewed lease with a different generation only covers
+// entries that get (re)loaded after the renewal.
+// We only notice a generation change when the lease gets renewed, so a lease only covers a child if it was renewed
+// within the child's own max_read_freshness.  Children with shorter freshness than the lease fall back to it.
+
+extern "C" {
+
+int ms_client_lease_grant( struct ms_client* client, uint64_t file_id, int64_t generation, int32_t lease_ttl );
+int ms_client_lease_check( struct ms_client* client, uint64_t file_id, struct timespec* loaded_at, int32_t max_read_freshness );
+int ms_client_lease_revoke( struct ms_client* client, uint64_t file_id );
+int ms_client_lease_revoke_all( struct ms_client* client );
+
+}
+
+#endif
@@ -27,11 +27,11 @@ char* ms_client_listdir_generate_batch_url_ex( struct md_download_context* dlctx
    
    pthread_mutex_lock( &ctx->lock );
    
-   if( ctx->batches->size() == 0 && ctx->children->size() < (size_t)ctx->num_children ) {
+   if( ctx->batches->size() == 0 && ctx->num_received < ctx->num_children ) {
       
       if( ctx->downloading->size() == 0 ) {
       
-         SG_debug("Only received %zu of %" PRId64 " children; searching the directory's capacity (%" PRId64 ")\n", ctx->children->size(), ctx->num_children, ctx->capacity );
+         SG_debug("Only received %" PRId64 " of %" PRId64 " children; searching the directory's capacity (%" PRId64 ")\n", ctx->num_received, ctx->num_children, ctx->capacity );
          
          // we've asked for all pages, but we haven't gotten all children yet.
          // queue some more pages
@@ -61,8 +61,12 @@ char* ms_client_listdir_generate_batch_url_ex( struct md_download_context* dlctx
          url = ms_client_file_listdir_url( ctx->client->url, ctx->volume_id, ctx->parent_id, next_batch, -1 );
       }
       
-      // remember which download this was for
+      // remember which download this was for, and when it started
+      struct timespec now;
+      clock_gettime( CLOCK_MONOTONIC, &now );
+      
       (*ctx->downloading)[ dlctx ] = next_batch;
+      (*ctx->started)[ dlctx ] = now;
    }
    
    pthread_mutex_unlock( &ctx->lock );
@@ -126,12 +130,19 @@ int ms_client_listdir_download_cancel( struct md_download_context* dlctx, void*
    
    // no longer downloading 
    ctx->downloading->erase( dlctx );
+   ctx->started->erase( dlctx );
    
    pthread_mutex_unlock( &ctx->lock );
    
    return 0;
 }
 
+
+// microseconds between two times 
+static int64_t ms_client_listdir_elapsed_us( struct timespec* start, struct timespec* end ) {
+   return (int64_t)(end->tv_sec - start->tv_sec) * 1000000L + (int64_t)(end->tv_nsec - start->tv_nsec) / 1000L;
+}
+
 // postprocess a downloaded entry 
 int ms_client_listdir_download_postprocess( struct md_download_context* dlctx, void* cls ) {
    
@@ -159,6 +170,19 @@ int ms_client_listdir_download_postprocess( struct md_download_context* dlctx, v
    // no longer downloading 
    ctx->downloading->erase( itr );
    
+   // how long did the MS take?
+   ms_client_listdir_start_set::iterator start_itr = ctx->started->find( dlctx );
+   if( start_itr != ctx->started->end() ) {
+      
+      struct timespec now;
+      clock_gettime( CLOCK_MONOTONIC, &now );
+      
+      ctx->latency_us += ms_client_listdir_elapsed_us( &start_itr->second, &now );
+      ctx->num_pages++;
+      
+      ctx->started->erase( start_itr );
+   }
+   
    // download status?
    rc = ms_client_download_parse_errors( dlctx );
    
@@ -173,6 +197,10 @@ int ms_client_listdir_download_postprocess( struct md_download_context* dlctx, v
          pthread_mutex_unlock( &ctx->lock );
          return rc;
       }
+      
+      // nothing to collect from this attempt
+      pthread_mutex_unlock( &ctx->lock );
+      return 0;
    }
    else if( rc < 0 ) {
       
@@ -202,7 +230,9 @@ int ms_client_listdir_download_postprocess( struct md_download_context* dlctx, v
       return -ENODATA;
    }
    
-   // merge children in 
+   // merge children in.  When streaming, compact the new children to the front of the page.
+   size_t num_new = 0;
+   
    for( unsigned int i = 0; i < num_children; i++ ) {
       
       uint64_t file_id = children[i].file_id;
@@ -216,11 +246,22 @@ int ms_client_listdir_download_postprocess( struct md_download_context* dlctx, v
       
       if( rc == 0 ) {
          ctx->children_ids->insert( file_id );
-         ctx->children->push_back( children[i] );
+         ctx->num_received++;
+         
+         if( ctx->page_func != NULL ) {
+            children[num_new] = children[i];
+            num_new++;
+         }
+         else {
+            ctx->children->push_back( children[i] );
+         }
+      }
+      else {
+         md_entry_free( &children[i] );
       }
       
       // do we have all children?
-      if( ctx->children->size() >= (size_t)ctx->num_children ) {
+      if( ctx->num_received >= ctx->num_children ) {
          
          // can cancel all other downloads--they're empty 
          rc = MD_DOWNLOAD_FINISH;
@@ -228,13 +269,101 @@ int ms_client_listdir_download_postprocess( struct md_download_context* dlctx, v
       }
    }
    
+   pthread_mutex_unlock( &ctx->lock );
+   
+   if( ctx->page_func != NULL ) {
+      
+      // hand off this page while the next ones download
+      struct timespec apply_start, apply_end;
+      
+      clock_gettime( CLOCK_MONOTONIC, &apply_start );
+      
+      int page_rc = (*ctx->page_func)( ctx->client, children, num_new, ctx->page_func_cls );
+      
+      clock_gettime( CLOCK_MONOTONIC, &apply_end );
+      
+      pthread_mutex_lock( &ctx->lock );
+      ctx->apply_us += ms_client_listdir_elapsed_us( &apply_start, &apply_end );
+      pthread_mutex_unlock( &ctx->lock );
+      
+      for( unsigned int i = 0; i < num_new; i++ ) {
+         md_entry_free( &children[i] );
+      }
+      
+      if( page_rc < 0 ) {
+         
+         SG_error("page_func(%" PRIX64 ") rc = %d\n", ctx->parent_id, page_rc );
+         rc = page_rc;
+      }
+   }
+   
    free( children );
    
-   pthread_mutex_unlock( &ctx->lock );
    return rc;
 }
 
 
+// how many pages of a listing to download at once.
+// we want enough in flight to keep the caller busy consuming pages while the MS serves the next ones--i.e. the
+// MS's per-page latency divided by the caller's per-page time--but no more than the connection limit.
+// with no history, use the connection limit.
+static int ms_client_listdir_window( struct ms_client* client, size_t num_batches ) {
+   
+   ms_client_rlock( client );
+   
+   int max_connections = client->max_connections;
+   int64_t latency_us = client->listdir_page_latency_us;
+   int64_t apply_us = client->listdir_page_apply_us;
+   
+   ms_client_unlock( client );
+   
+   int window = max_connections;
+   
+   if( latency_us > 0 ) {
+      
+      window = (int)MIN( (int64_t)max_connections, (latency_us / MAX( apply_us, 1 )) + 1 );
+      
+      // always fetch the next page while the caller consumes this one 
+      window = MAX( window, 2 );
+   }
+   
+   window = MIN( (size_t)window, num_batches );
+   
+   return MAX( window, 1 );
+}
+
+
+// fold a listing's page timings into the client's moving averages
+static int ms_client_listdir_update_window( struct ms_client* client, struct ms_client_listdir_context* ctx ) {
+   
+   if( ctx->num_pages == 0 ) {
+      return 0;
+   }
+   
+   int64_t latency_us = ctx->latency_us / ctx->num_pages;
+   int64_t apply_us = ctx->apply_us / ctx->num_pages;
+   
+   ms_client_wlock( client );
+   
+   if( client->listdir_page_latency_us == 0 ) {
+      
+      client->listdir_page_latency_us = latency_us;
+      client->listdir_page_apply_us = apply_us;
+   }
+   else {
+      
+      client->listdir_page_latency_us = (3 * client->listdir_page_latency_us + latency_us) / 4;
+      client->listdir_page_apply_us = (3 * client->listdir_page_apply_us + apply_us) / 4;
+   }
+   
+   SG_debug("listdir page latency %" PRId64 "us, apply time %" PRId64 "us\n", client->listdir_page_latency_us, client->listdir_page_apply_us );
+   
+   ms_client_unlock( client );
+   
+   return 0;
+}
+
+
 // set up a listdir or diffdir context 
 // if least_unknown_generation >= 0, then fetch by generation number 
 // otherwise, fetch by directory index
@@ -249,6 +378,7 @@ int ms_client_listdir_context_init_ex( struct ms_client_listdir_context* ctx, st
    ctx->downloading = new ms_client_listdir_batch_set();
    ctx->children = new vector<struct md_entry>();
    ctx->attempts = new ms_client_listdir_attempt_set();
+   ctx->started = new ms_client_listdir_start_set();
    ctx->batches = new queue<int>();
    ctx->children_ids = new set<uint64_t>();
    
@@ -323,14 +453,23 @@ int ms_client_listdir_context_free( struct ms_client_listdir_context* ctx ) {
       ctx->children_ids = NULL;
    }
    
+   if( ctx->started != NULL ) {
+      
+      delete ctx->started;
+      ctx->started = NULL;
+   }
+   
    return 0;
 }
 
 // download metadata for a directory.
 // if least_unknown_generation >= 0, then this is a diffdir operation.
 // otherwise, it's a listdir operation.
+// if page_func is given, each page is handed to it as soon as it arrives, while the next pages download.
+// otherwise, the children are accumulated into results.
 // return partial results, even on error.
-int ms_client_listdir_ex( struct ms_client* client, uint64_t parent_id, int64_t num_children, int64_t least_unknown_generation, int64_t parent_capacity, struct ms_client_multi_result* results ) {
+static int ms_client_listdir_ex( struct ms_client* client, uint64_t parent_id, int64_t num_children, int64_t least_unknown_generation, int64_t parent_capacity,
+                                 ms_client_listdir_page_func page_func, void* page_func_cls, struct ms_client_multi_result* results ) {
    
    int rc = 0;
    struct md_download_config dlconf;
@@ -347,6 +486,9 @@ int ms_client_listdir_ex( struct ms_client* client, uint64_t parent_id, int64_t
    
    ms_client_listdir_context_init_ex( &ctx, client, parent_id, num_children, least_unknown_generation, parent_capacity );
    
+   ctx.page_func = page_func;
+   ctx.page_func_cls = page_func_cls;
+   
    if( least_unknown_generation > 0 ) {
       // doing diffdir
       md_download_config_set_url_generator( &dlconf, ms_client_diffdir_generate_batch_url, &ctx );
@@ -360,11 +502,13 @@ int ms_client_listdir_ex( struct ms_client* client, uint64_t parent_id, int64_t
    md_download_config_set_curl_generator( &dlconf, ms_client_listdir_curl_generator, &ctx );
    md_download_config_set_postprocessor( &dlconf, ms_client_listdir_download_postprocess, &ctx );
    md_download_config_set_canceller( &dlconf, ms_client_listdir_download_cancel, &ctx );
-   md_download_config_set_limits( &dlconf, MIN( (unsigned)client->max_connections, ctx.batches->size() ), -1 );
+   md_download_config_set_limits( &dlconf, ms_client_listdir_window( client, ctx.batches->size() ), -1 );
    
    // run downloads 
    rc = md_download_all( &client->dl, client->conf, &dlconf );
    
+   ms_client_listdir_update_window( client, &ctx );
+   
    if( ctx.children->size() > 0 ) {
       
       ents = SG_CALLOC( struct md_entry, ctx.children->size() );
@@ -375,7 +519,7 @@ int ms_client_listdir_ex( struct ms_client* client, uint64_t parent_id, int64_t
    }
    
    results->num_ents = ctx.children->size();
-   results->num_processed = ctx.children->size();
+   results->num_processed = ctx.num_received;
    
    ctx.children->clear();
    delete ctx.children;
@@ -397,9 +541,27 @@ int ms_client_listdir_ex( struct ms_client* client, uint64_t parent_id, int64_t
 
 
 int ms_client_listdir( struct ms_client* client, uint64_t parent_id, int64_t num_children, int64_t parent_capacity, struct ms_client_multi_result* results ) {
-   return ms_client_listdir_ex( client, parent_id, num_children, -1, parent_capacity, results );
+   return ms_client_listdir_ex( client, parent_id, num_children, -1, parent_capacity, NULL, NULL, results );
 }
 
 int ms_client_diffdir( struct ms_client* client, uint64_t parent_id, int64_t num_children, int64_t least_unknown_generation, struct ms_client_multi_result* results ) {
-   return ms_client_listdir_ex( client, parent_id, num_children, least_unknown_generation, -1, results );
+   return ms_client_listdir_ex( client, parent_id, num_children, least_unknown_generation, -1, NULL, NULL, results );
+}
+
+// list (least_unknown_generation < 0) or diff (least_unknown_generation >= 0) a directory, giving each page of children to page_func as soon as it arrives.
+// page N is consumed while pages N+1... are downloading, so the caller can start on the listing before the rest of it arrives.
+// return 0 on success, and set *reply_error to the MS's listing error (if any)
+// return negative on download error, or if page_func fails
+int ms_client_listdir_stream( struct ms_client* client, uint64_t parent_id, int64_t num_children, int64_t least_unknown_generation, int64_t parent_capacity,
+                              ms_client_listdir_page_func page_func, void* page_func_cls, int* reply_error ) {
+   
+   struct ms_client_multi_result results;
+   
+   int rc = ms_client_listdir_ex( client, parent_id, num_children, least_unknown_generation, parent_capacity, page_func, page_func_cls, &results );
+   
+   *reply_error = results.reply_error;
+   
+   ms_client_multi_result_free( &results );
+   
+   return rc;
 }
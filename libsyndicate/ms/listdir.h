@@ -25,6 +25,12 @@
 
 typedef map<struct md_download_context*, int> ms_client_listdir_batch_set;
 typedef map<int, int> ms_client_listdir_attempt_set;
+typedef map<struct md_download_context*, struct timespec> ms_client_listdir_start_set;
+
+// consume one page of a directory listing, as soon as it arrives (while later pages are still downloading).
+// ents belongs to the listing; copy out whatever needs to outlive the call.
+// return 0 to continue, or negative to abort the listing
+typedef int (*ms_client_listdir_page_func)( struct ms_client* client, struct md_entry* ents, size_t num_ents, void* cls );
 
 // listdir context
 struct ms_client_listdir_context {
@@ -37,10 +43,19 @@ struct ms_client_listdir_context {
    queue<int>* batches;                         // which batches of the index to download next
    
    set<uint64_t>* children_ids;                 // file ids of downloaded children
-   vector<struct md_entry>* children;           // downloaded children
+   vector<struct md_entry>* children;           // downloaded children (if not streaming them to page_func)
+   int64_t num_received;                        // number of children downloaded so far
+   
+   ms_client_listdir_page_func page_func;       // if non-NULL, give each page to this as it arrives
+   void* page_func_cls;
    
    ms_client_listdir_batch_set* downloading;    // which batches of the index are downloading
    ms_client_listdir_attempt_set* attempts;     // download attempts for a given batch
+   ms_client_listdir_start_set* started;        // when each download started
+   
+   int64_t num_pages;                           // number of pages received
+   int64_t latency_us;                          // total time spent waiting for pages (microseconds)
+   int64_t apply_us;                            // total time spent in page_func (microseconds)
    
    int listing_error;
    int64_t num_children;
@@ -55,6 +70,8 @@ extern "C" {
    
 int ms_client_listdir( struct ms_client* client, uint64_t parent_id, int64_t num_children, int64_t parent_capacity, struct ms_client_multi_result* results );
 int ms_client_diffdir( struct ms_client* client, uint64_t parent_id, int64_t num_children, int64_t least_unknown_generation, struct ms_client_multi_result* results );
+int ms_client_listdir_stream( struct ms_client* client, uint64_t parent_id, int64_t num_children, int64_t least_unknown_generation, int64_t parent_capacity,
+                              ms_client_listdir_page_func page_func, void* page_func_cls, int* reply_error );
 
 }
 
@@ -22,6 +22,7 @@
 #include "libsyndicate/ms/core.h"
 #include "libsyndicate/ms/file.h"
 #include "libsyndicate/ms/gateway.h"
+#include "libsyndicate/ms/lease.h"
 #include "libsyndicate/ms/openid.h"
 #include "libsyndicate/ms/register.h"
 #include "libsyndicate/ms/url.h"
@@ -19,6 +19,7 @@
 #include "libsyndicate/ms/url.h"
 #include "libsyndicate/ms/getattr.h"
 #include "libsyndicate/ms/listdir.h"
+#include "libsyndicate/ms/lease.h"
 
 #include "path.h"
 
@@ -174,6 +175,18 @@ int ms_client_listing_read_entries( struct ms_client* client, struct md_download
       return rc;
    }
    
+   // did the MS grant us a lease on this directory?
+   if( reply.has_lease_file_id() ) {
+      
+      rc = ms_client_lease_grant( client, reply.lease_file_id(), reply.lease_generation(), reply.lease_ttl() );
+      if( rc != 0 ) {
+         
+         // not fatal; we'll just revalidate more often
+         SG_warn("ms_client_lease_grant(%" PRIX64 ") rc = %d\n", reply.lease_file_id(), rc );
+         rc = 0;
+      }
+   }
+   
    // get listing data 
    rc = ms_client_parse_listing( &listing, &reply );
    if( rc != 0 ) {
@@ -344,6 +357,12 @@ int ms_client_path_download( struct ms_client* client, ms_path_t* path, ms_path_
       // get the next child 
       memset( &result, 0, sizeof(struct ms_client_multi_result) );
       
+      // its parent is the entry we just got
+      if( i > 0 ) {
+         
+         path->at(i).parent_id = path->at(i-1).file_id;
+      }
+      
       rc = ms_client_getchild( client, &path->at(i), &result );
       
       if( rc != 0 ) {
@@ -367,12 +386,6 @@ int ms_client_path_download( struct ms_client* client, ms_path_t* path, ms_path_
       path->at(i).write_nonce = result.ents[0].write_nonce;
       path->at(i).num_children = result.ents[0].num_children;
       
-      // provide parent if we can 
-      if( i > 0 ) {
-         
-         path->at(i).parent_id = path->at(i-1).file_id;
-      }
-      
       // let the caller know 
       if( download_cb != NULL ) {
          
@@ -215,6 +215,27 @@ char* ms_client_listxattr_url( char const* ms_url, uint64_t volume_id, uint64_t
    return listxattr_path;
 }
 
+// GETALLXATTRS url 
+// return the URL on success 
+// return NULL on OOM
+char* ms_client_getallxattrs_url( char const* ms_url, uint64_t volume_id, uint64_t file_id ) {
+   
+   char volume_id_str[50];
+   sprintf( volume_id_str, "%" PRIu64, volume_id );
+
+   char file_id_str[50];
+   sprintf( file_id_str, "%" PRIX64, file_id );
+
+   char* getallxattrs_path = SG_CALLOC( char, strlen(ms_url) + 1 + strlen("/FILE/GETALLXATTRS/") + 1 + strlen(volume_id_str) + 1 + strlen(file_id_str) + 1 );
+   if( getallxattrs_path == NULL ) {
+      return NULL;
+   }
+   
+   sprintf( getallxattrs_path, "%s/FILE/GETALLXATTRS/%s/%s", ms_url, volume_id_str, file_id_str );
+   
+   return getallxattrs_path;
+}
+
 // URL to read a file's vacuum log
 // return the URL on success 
 // return NULL on OOM
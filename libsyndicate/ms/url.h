@@ -30,6 +30,7 @@ char* ms_client_file_listdir_url( char const* ms_url, uint64_t volume_id, uint64
 
 char* ms_client_getxattr_url( char const* ms_url, uint64_t volume_id, uint64_t file_id, char const* xattr_name );
 char* ms_client_listxattr_url( char const* ms_url, uint64_t volume_id, uint64_t file_id );
+char* ms_client_getallxattrs_url( char const* ms_url, uint64_t volume_id, uint64_t file_id );
 
 char* ms_client_vacuum_url( char const* ms_url, uint64_t volume_id, uint64_t file_id );
 
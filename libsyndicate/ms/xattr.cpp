@@ -122,6 +122,106 @@ int ms_client_listxattr( struct ms_client* client, uint64_t volume_id, uint64_t
    }
 }
 
+// free the names and values returned by ms_client_getallxattrs
+void ms_client_xattrs_free( char** xattr_names, char** xattr_values, size_t* xattr_value_lens ) {
+   
+   if( xattr_names != NULL ) {
+      for( int i = 0; xattr_names[i] != NULL; i++ ) {
+         SG_safe_free( xattr_names[i] );
+      }
+      
+      free( xattr_names );
+   }
+   
+   if( xattr_values != NULL ) {
+      for( int i = 0; xattr_values[i] != NULL; i++ ) {
+         SG_safe_free( xattr_values[i] );
+      }
+      
+      free( xattr_values );
+   }
+   
+   SG_safe_free( xattr_value_lens );
+}
+
+// get the names and values of all of a file's xattrs that we can read, in one request.
+// xattr_names and xattr_values will be NULL-terminated arrays, and xattr_value_lens[i] will be the length of xattr_values[i].
+// xattr_nonce will be set to the file's xattr nonce at the time the MS read the xattrs, so the caller can tell whether or not the set is still fresh.
+// return 0 on success
+// return -ENOENT if the file doesn't exist or isn't readable
+// return -ENOMEM if OOM 
+// return -EBADMSG if the reply is malformed
+// return negative on download error
+int ms_client_getallxattrs( struct ms_client* client, uint64_t volume_id, uint64_t file_id, int64_t* xattr_nonce, char*** xattr_names, char*** xattr_values, size_t** xattr_value_lens ) {
+   
+   char* getallxattrs_url = NULL;
+   int rc = 0;
+   ms::ms_reply reply;
+   char** names = NULL;
+   char** values = NULL;
+   size_t* value_lens = NULL;
+   int num_xattrs = 0;
+   
+   getallxattrs_url = ms_client_getallxattrs_url( client->url, volume_id, file_id );
+   if( getallxattrs_url == NULL ) {
+      
+      return -ENOMEM;
+   }
+   
+   rc = ms_client_read( client, getallxattrs_url, &reply );
+   
+   SG_safe_free( getallxattrs_url );
+   
+   if( rc != 0 ) {
+      
+      SG_error("ms_client_read(getallxattrs %" PRIX64 ") rc = %d\n", file_id, rc );
+      return rc;
+   }
+   
+   num_xattrs = reply.xattr_names_size();
+   
+   if( reply.xattr_values_size() != num_xattrs || !reply.has_xattr_nonce() ) {
+      
+      SG_error("MS replied %d names and %d values for %" PRIX64 " (nonce %s)\n", num_xattrs, reply.xattr_values_size(), file_id, reply.has_xattr_nonce() ? "given" : "missing" );
+      return -EBADMSG;
+   }
+   
+   names = SG_CALLOC( char*, num_xattrs + 1 );
+   values = SG_CALLOC( char*, num_xattrs + 1 );
+   value_lens = SG_CALLOC( size_t, num_xattrs + 1 );
+   
+   if( names == NULL || values == NULL || value_lens == NULL ) {
+      
+      ms_client_xattrs_free( names, values, value_lens );
+      return -ENOMEM;
+   }
+   
+   for( int i = 0; i < num_xattrs; i++ ) {
+      
+      const string& xattr_name = reply.xattr_names(i);
+      const string& xattr_value = reply.xattr_values(i);
+      
+      names[i] = SG_strdup_or_null( xattr_name.c_str() );
+      values[i] = SG_CALLOC( char, xattr_value.size() + 1 );
+      
+      if( names[i] == NULL || values[i] == NULL ) {
+         
+         ms_client_xattrs_free( names, values, value_lens );
+         return -ENOMEM;
+      }
+      
+      memcpy( values[i], xattr_value.data(), xattr_value.size() );
+      value_lens[i] = xattr_value.size();
+   }
+   
+   *xattr_nonce = reply.xattr_nonce();
+   *xattr_names = names;
+   *xattr_values = values;
+   *xattr_value_lens = value_lens;
+   
+   return 0;
+}
+
 // set a file's xattr.
 // flags is either 0, XATTR_CREATE, or XATTR_REPLACE (see setxattr(2))
 // return 0 on success
@@ -26,6 +26,8 @@ extern "C" {
 // xattr API
 int ms_client_getxattr( struct ms_client* client, uint64_t volume_id, uint64_t file_id, char const* xattr_name, char** xattr_value, size_t* xattr_value_len );
 int ms_client_listxattr( struct ms_client* client, uint64_t volume_id, uint64_t file_id, char** xattr_names, size_t* xattr_names_len );
+int ms_client_getallxattrs( struct ms_client* client, uint64_t volume_id, uint64_t file_id, int64_t* xattr_nonce, char*** xattr_names, char*** xattr_values, size_t** xattr_value_lens );
+void ms_client_xattrs_free( char** xattr_names, char** xattr_values, size_t* xattr_value_lens );
 int ms_client_setxattr( struct ms_client* client, struct md_entry* ent, char const* xattr_name, char const* xattr_value, size_t xattr_value_len, mode_t mode, int flags );
 int ms_client_removexattr( struct ms_client* client, struct md_entry* ent, char const* xattr_name );
 int ms_client_chownxattr( struct ms_client* client, struct md_entry* ent, char const* xattr_name, uint64_t new_owner );
@@ -0,0 +1,537 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// bulk unlink throughput against a local stand-in MS.
+// Each file has NUM_WRITES unvacuumed writes in its vacuum log, and the stand-in takes DELAY_MS to serve each request.
+// "sync" unlinks the way the UG used to: drain the vacuum log (peek, remove) and then delete.
+// "deferred" unlinks the way the UG does now: journal the file for the vacuumer (fsync'ed), delete it with
+// MS_CLIENT_DELETE_DEFER_VACUUM, and let a background thread drain the orphaned vacuum logs afterwards.
+// The test checks that every log gets drained either way, and that deferred unlinks are faster.
+
+#include "../standin-ms.h"
+#include "libsyndicate/storage.h"
+#include "libsyndicate/ms/file.h"
+#include "libsyndicate/ms/vacuum.h"
+
+#include <deque>
+
+#define STANDIN_FILE_ID_BASE 0x1000
+
+// one write in a file's vacuum log
+struct standin_vacuum_entry {
+   int64_t file_version;
+   int64_t manifest_mtime_sec;
+   int32_t manifest_mtime_nsec;
+};
+
+typedef deque<struct standin_vacuum_entry> standin_vacuum_log_t;
+typedef map<uint64_t, standin_vacuum_log_t> standin_vacuum_log_map_t;
+
+// the files and vacuum logs the stand-in MS serves
+struct bulk_delete_files {
+   pthread_mutex_t lock;
+   standin_vacuum_log_map_t* logs;      // file ID to vacuum log
+   set<uint64_t>* files;                // files that exist
+   int64_t num_requests;
+};
+
+static struct standin_ms g_ms;
+static struct bulk_delete_files g_files;
+
+// serve GET /FILE/VACUUM/$VOLUME_ID/$FILE_ID: the head of the file's vacuum log, or 404 if it's empty
+static struct md_HTTP_response* standin_ms_GET_handler( struct md_HTTP_connection_data* con_data ) {
+
+   struct md_HTTP_response* resp = SG_CALLOC( struct md_HTTP_response, 1 );
+   uint64_t volume_id = 0;
+   uint64_t file_id = 0;
+   struct standin_vacuum_entry head;
+   bool found = false;
+   ms::ms_reply reply;
+
+   if( resp == NULL ) {
+      return NULL;
+   }
+
+   int rc = sscanf( con_data->url_path, "/FILE/VACUUM/%" PRIu64 "/%" PRIX64, &volume_id, &file_id );
+   if( rc != 2 || volume_id != STANDIN_VOLUME_ID ) {
+
+      standin_ms_respond_status( resp, 404 );
+      return resp;
+   }
+
+   standin_ms_delay( &g_ms );
+
+   pthread_mutex_lock( &g_files.lock );
+
+   g_files.num_requests++;
+
+   standin_vacuum_log_map_t::iterator itr = g_files.logs->find( file_id );
+   if( itr != g_files.logs->end() && itr->second.size() > 0 ) {
+
+      head = itr->second.front();
+      found = true;
+   }
+
+   pthread_mutex_unlock( &g_files.lock );
+
+   if( !found ) {
+
+      standin_ms_respond_status( resp, 404 );
+      return resp;
+   }
+
+   reply.set_error( 0 );
+   reply.set_file_version( head.file_version );
+   reply.set_manifest_mtime_sec( head.manifest_mtime_sec );
+   reply.set_manifest_mtime_nsec( head.manifest_mtime_nsec );
+   reply.add_affected_blocks( 0 );
+
+   standin_ms_respond( &g_ms, resp, &reply );
+   return resp;
+}
+
+// apply one update: DELETE or VACUUM
+// return the per-update error code
+static int bulk_delete_apply_update( struct bulk_delete_files* ms, const ms::ms_update& update ) {
+
+   uint64_t file_id = update.entry().file_id();
+   int rc = 0;
+
+   pthread_mutex_lock( &ms->lock );
+
+   standin_vacuum_log_t* log = NULL;
+
+   standin_vacuum_log_map_t::iterator itr = ms->logs->find( file_id );
+   if( itr != ms->logs->end() ) {
+      log = &itr->second;
+   }
+
+   switch( update.type() ) {
+
+      case ms::ms_update::DELETE: {
+
+         if( ms->files->count( file_id ) == 0 ) {
+            rc = -ENOENT;
+         }
+         else if( log != NULL && log->size() > 0 && !(update.has_defer_vacuum() && update.defer_vacuum()) ) {
+            // the writer has to vacuum first
+            rc = -EAGAIN;
+         }
+         else {
+            // with defer_vacuum, the log outlives the file
+            ms->files->erase( file_id );
+         }
+
+         break;
+      }
+
+      case ms::ms_update::VACUUM: {
+
+         if( log == NULL || log->size() == 0 ) {
+            rc = -ENOENT;
+         }
+         else if( log->front().file_version != update.entry().version()
+               || log->front().manifest_mtime_sec != update.entry().manifest_mtime_sec()
+               || log->front().manifest_mtime_nsec != update.entry().manifest_mtime_nsec() ) {
+            rc = -EINVAL;
+         }
+         else {
+            log->pop_front();
+         }
+
+         break;
+      }
+
+      default: {
+         rc = -ENOSYS;
+         break;
+      }
+   }
+
+   pthread_mutex_unlock( &ms->lock );
+
+   return rc;
+}
+
+// serve POST /FILE/$VOLUME_ID
+static void standin_ms_POST_finish( struct md_HTTP_connection_data* md_con_data ) {
+
+   md_response_buffer_t* rb = md_con_data->rb;
+   ms::ms_updates updates;
+   ms::ms_reply reply;
+
+   md_con_data->resp = SG_CALLOC( struct md_HTTP_response, 1 );
+   if( md_con_data->resp == NULL ) {
+      return;
+   }
+
+   char* msg_buf = md_response_buffer_to_string( rb );
+   size_t msg_sz = md_response_buffer_size( rb );
+
+   int rc = md_parse< ms::ms_updates >( &updates, msg_buf, msg_sz );
+
+   free( msg_buf );
+
+   if( rc != 0 ) {
+
+      SG_error("md_parse ms_updates rc = %d\n", rc );
+      standin_ms_respond_status( md_con_data->resp, 400 );
+      return;
+   }
+
+   standin_ms_delay( &g_ms );
+
+   pthread_mutex_lock( &g_files.lock );
+   g_files.num_requests++;
+   pthread_mutex_unlock( &g_files.lock );
+
+   reply.set_error( 0 );
+
+   for( int i = 0; i < updates.updates_size(); i++ ) {
+      reply.add_errors( bulk_delete_apply_update( &g_files, updates.updates(i) ) );
+   }
+
+   standin_ms_respond( &g_ms, md_con_data->resp, &reply );
+}
+
+// (re)populate the stand-in MS with num_files files, each with num_writes writes to vacuum
+static void bulk_delete_populate( struct bulk_delete_files* ms, int64_t num_files, int num_writes ) {
+
+   pthread_mutex_lock( &ms->lock );
+
+   ms->logs->clear();
+   ms->files->clear();
+   ms->num_requests = 0;
+
+   for( int64_t i = 0; i < num_files; i++ ) {
+
+      uint64_t file_id = STANDIN_FILE_ID_BASE + i;
+      standin_vacuum_log_t* log = &(*ms->logs)[ file_id ];
+
+      for( int j = 0; j < num_writes; j++ ) {
+
+         struct standin_vacuum_entry ve;
+
+         ve.file_version = 1;
+         ve.manifest_mtime_sec = j + 1;
+         ve.manifest_mtime_nsec = 0;
+
+         log->push_back( ve );
+      }
+
+      ms->files->insert( file_id );
+   }
+
+   pthread_mutex_unlock( &ms->lock );
+}
+
+// are all files gone and all vacuum logs empty?
+static bool bulk_delete_drained( struct bulk_delete_files* ms ) {
+
+   bool drained = true;
+
+   pthread_mutex_lock( &ms->lock );
+
+   if( ms->files->size() > 0 ) {
+      drained = false;
+   }
+
+   for( standin_vacuum_log_map_t::iterator itr = ms->logs->begin(); itr != ms->logs->end(); itr++ ) {
+      if( itr->second.size() > 0 ) {
+         drained = false;
+      }
+   }
+
+   pthread_mutex_unlock( &ms->lock );
+
+   return drained;
+}
+
+// drain a file's vacuum log, the way the vacuumer does (minus the block garbage collection)
+// return 0 on success
+static int bulk_delete_vacuum( struct ms_client* client, uint64_t file_id ) {
+
+   while( true ) {
+
+      struct ms_vacuum_entry ve;
+      memset( &ve, 0, sizeof(struct ms_vacuum_entry) );
+
+      int rc = ms_client_peek_vacuum_log( client, STANDIN_VOLUME_ID, file_id, &ve );
+      if( rc == -ENOENT ) {
+         // empty
+         return 0;
+      }
+
+      if( rc != 0 ) {
+         SG_error("ms_client_peek_vacuum_log(%" PRIX64 ") rc = %d\n", file_id, rc );
+         return rc;
+      }
+
+      rc = ms_client_remove_vacuum_log_entry( client, STANDIN_VOLUME_ID, file_id, ve.file_version, ve.manifest_mtime_sec, ve.manifest_mtime_nsec );
+
+      ms_client_vacuum_entry_free( &ve );
+
+      if( rc != 0 ) {
+         SG_error("ms_client_remove_vacuum_log_entry(%" PRIX64 ") rc = %d\n", file_id, rc );
+         return rc;
+      }
+   }
+}
+
+// delete a file from the stand-in MS
+static int bulk_delete_ms_delete( struct ms_client* client, uint64_t file_id, int flags ) {
+
+   struct md_entry ent;
+   memset( &ent, 0, sizeof(struct md_entry) );
+
+   ent.type = MD_ENTRY_FILE;
+   ent.volume = STANDIN_VOLUME_ID;
+   ent.file_id = file_id;
+   ent.name = strdup("file");
+   ent.parent_name = strdup("/");
+
+   int rc = ms_client_delete_ex( client, &ent, flags );
+
+   md_entry_free( &ent );
+
+   return rc;
+}
+
+// journal a file for the vacuumer: write it to a temporary record, fsync it, and rename it into place (like the UG's vacuumer)
+static int bulk_delete_journal( char const* journal_dir, uint64_t file_id ) {
+
+   char tmp_path[PATH_MAX];
+   char path[PATH_MAX];
+
+   snprintf( tmp_path, PATH_MAX, "%s/%016" PRIX64 ".tmp", journal_dir, file_id );
+   snprintf( path, PATH_MAX, "%s/%016" PRIX64 ".vac", journal_dir, file_id );
+
+   int fd = open( tmp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600 );
+   if( fd < 0 ) {
+      return -errno;
+   }
+
+   ssize_t nw = write( fd, &file_id, sizeof(file_id) );
+   if( nw != sizeof(file_id) || fsync( fd ) != 0 ) {
+
+      int errsv = (nw < 0 ? -errno : -EIO);
+      close( fd );
+      return errsv;
+   }
+
+   close( fd );
+
+   if( rename( tmp_path, path ) != 0 ) {
+      return -errno;
+   }
+
+   int dfd = open( journal_dir, O_RDONLY );
+   if( dfd < 0 ) {
+      return -errno;
+   }
+
+   fsync( dfd );
+   close( dfd );
+
+   return 0;
+}
+
+// background drain of orphaned vacuum logs
+struct bulk_delete_drainer {
+   struct ms_client* client;
+   char const* journal_dir;
+   int64_t num_files;
+   int rc;
+};
+
+static void* bulk_delete_drain_main( void* arg ) {
+
+   struct bulk_delete_drainer* drainer = (struct bulk_delete_drainer*)arg;
+
+   for( int64_t i = 0; i < drainer->num_files; i++ ) {
+
+      char path[PATH_MAX];
+      uint64_t file_id = STANDIN_FILE_ID_BASE + i;
+
+      snprintf( path, PATH_MAX, "%s/%016" PRIX64 ".vac", drainer->journal_dir, file_id );
+
+      // wait for the file to be unlinked
+      while( access( path, F_OK ) != 0 ) {
+         usleep( 1000 );
+      }
+
+      int rc = bulk_delete_vacuum( drainer->client, file_id );
+      if( rc != 0 ) {
+         drainer->rc = rc;
+         return NULL;
+      }
+
+      unlink( path );
+   }
+
+   return NULL;
+}
+
+int usage( char const* prog_name ) {
+
+   fprintf(stderr, "Usage: %s PORT NUM_FILES NUM_WRITES DELAY_MS\n", prog_name );
+   return 0;
+}
+
+int main( int argc, char** argv ) {
+
+   int rc = 0;
+   int portnum = 0;
+   int64_t num_files = 0;
+   int num_writes = 0;
+   int delay_ms = 0;
+   char journal_dir[PATH_MAX];
+   struct ms_client* client = NULL;
+   double rate[2];
+   char const* mode_names[2] = { "sync", "deferred" };
+
+   if( argc != 5 ) {
+      usage( argv[0] );
+      exit(1);
+   }
+
+   memset( &g_files, 0, sizeof(struct bulk_delete_files) );
+
+   portnum = strtol( argv[1], NULL, 10 );
+   num_files = strtoll( argv[2], NULL, 10 );
+   num_writes = strtol( argv[3], NULL, 10 );
+   delay_ms = strtol( argv[4], NULL, 10 );
+
+   if( portnum <= 0 || num_files <= 0 || num_writes < 0 ) {
+      usage( argv[0] );
+      exit(1);
+   }
+
+   pthread_mutex_init( &g_files.lock, NULL );
+
+   g_files.logs = new standin_vacuum_log_map_t();
+   g_files.files = new set<uint64_t>();
+
+   snprintf( journal_dir, PATH_MAX, "/tmp/bulk-delete-bench-%d", getpid() );
+
+   rc = md_mkdirs( journal_dir );
+   if( rc != 0 ) {
+      SG_error("md_mkdirs(%s) rc = %d\n", journal_dir, rc );
+      exit(1);
+   }
+
+   rc = standin_ms_start( &g_ms, portnum, delay_ms, standin_ms_GET_handler, standin_ms_POST_finish );
+   if( rc != 0 ) {
+      SG_error("standin_ms_start(%d) rc = %d\n", portnum, rc );
+      exit(1);
+   }
+
+   client = &g_ms.client;
+
+   // updates are signed with the gateway's key
+   rc = md_generate_key( &client->gateway_key );
+   if( rc != 0 ) {
+      SG_error("md_generate_key rc = %d\n", rc );
+      exit(1);
+   }
+
+   for( int mode = 0; mode < 2; mode++ ) {
+
+      struct timespec start, end, drained;
+      struct bulk_delete_drainer drainer;
+      pthread_t drain_thread;
+
+      bulk_delete_populate( &g_files, num_files, num_writes );
+
+      memset( &drainer, 0, sizeof(struct bulk_delete_drainer) );
+      drainer.client = client;
+      drainer.journal_dir = journal_dir;
+      drainer.num_files = num_files;
+
+      if( mode == 1 ) {
+         pthread_create( &drain_thread, NULL, bulk_delete_drain_main, &drainer );
+      }
+
+      clock_gettime( CLOCK_MONOTONIC, &start );
+
+      for( int64_t i = 0; i < num_files; i++ ) {
+
+         uint64_t file_id = STANDIN_FILE_ID_BASE + i;
+
+         if( mode == 0 ) {
+
+            rc = bulk_delete_vacuum( client, file_id );
+            if( rc == 0 ) {
+               rc = bulk_delete_ms_delete( client, file_id, 0 );
+            }
+         }
+         else {
+
+            rc = bulk_delete_journal( journal_dir, file_id );
+            if( rc == 0 ) {
+               rc = bulk_delete_ms_delete( client, file_id, MS_CLIENT_DELETE_DEFER_VACUUM );
+            }
+         }
+
+         if( rc != 0 ) {
+            SG_error("%s unlink of %" PRIX64 " rc = %d\n", mode_names[mode], file_id, rc );
+            exit(1);
+         }
+      }
+
+      clock_gettime( CLOCK_MONOTONIC, &end );
+
+      if( mode == 1 ) {
+
+         pthread_join( drain_thread, NULL );
+
+         if( drainer.rc != 0 ) {
+            SG_error("background vacuum rc = %d\n", drainer.rc );
+            exit(1);
+         }
+      }
+
+      clock_gettime( CLOCK_MONOTONIC, &drained );
+
+      if( !bulk_delete_drained( &g_files ) ) {
+         SG_error("%s: files or vacuum log entries left over\n", mode_names[mode] );
+         exit(1);
+      }
+
+      int64_t unlink_us = MAX( standin_ms_timespec_us( &end ) - standin_ms_timespec_us( &start ), 1 );
+
+      rate[mode] = (double)num_files * 1e6 / (double)unlink_us;
+
+      printf("%s: %" PRId64 " unlinks (%d writes each) in %" PRId64 " us, %.1f unlinks/sec; all vacuumed after %" PRId64 " us, %" PRId64 " MS requests\n",
+             mode_names[mode], num_files, num_writes, unlink_us, rate[mode], standin_ms_timespec_us( &drained ) - standin_ms_timespec_us( &start ), g_files.num_requests );
+   }
+
+   standin_ms_stop( &g_ms );
+
+   rmdir( journal_dir );
+
+   delete g_files.logs;
+   delete g_files.files;
+
+   if( num_writes > 0 && rate[1] <= rate[0] ) {
+      SG_error("Deferred unlinks (%.1f/sec) were no faster than synchronous unlinks (%.1f/sec)\n", rate[1], rate[0] );
+      exit(1);
+   }
+
+   printf("OK\n");
+
+   return 0;
+}
@@ -0,0 +1,133 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// getattr a directory, and check the metadata lease the MS granted on it.
+// Run it with a directory whose max_read_freshness is non-zero; then change one of its children from another
+// gateway and run it again to see the lease generation change.
+
+#include "lease.h"
+
+int usage( char const* prog_name ) {
+   
+   fprintf(stderr, "Usage: %s [SYNDICATE_OPTS] DIR_ID\n", prog_name );
+   return 0;
+}
+
+// print what a lease covers
+void print_lease( struct ms_client* client, uint64_t file_id, char const* what, struct timespec* loaded_at, int32_t max_read_freshness ) {
+   
+   int rc = ms_client_lease_check( client, file_id, loaded_at, max_read_freshness );
+   
+   printf("   lease on %" PRIX64 " covers %s: rc = %d\n", file_id, what, rc );
+}
+
+int main( int argc, char** argv ) {
+   
+   int rc = 0;
+   struct syndicate_state state;
+   struct md_opts opts;
+   struct UG_opts ug_opts;
+   int local_optind = 0;
+   uint64_t volume_id = 0;
+   uint64_t file_id = 0;
+   struct ms_path_ent path_ent;
+   struct ms_client_multi_result result;
+   struct timespec before, after;
+   
+   if( argc < 2 ) {
+      usage( argv[0] );
+      exit(1);
+   }
+   
+   memset( &result, 0, sizeof(struct ms_client_multi_result) );
+   
+   memset( &opts, 0, sizeof(struct md_opts) );
+   
+   memset( &ug_opts, 0, sizeof(struct UG_opts) );
+   
+   // get options
+   rc = md_opts_parse( &opts, argc, argv, &local_optind, NULL, NULL );
+   if( rc != 0 ) {
+      SG_error("md_opts_parse rc = %d\n", rc );
+      md_common_usage( argv[0] );
+      usage( argv[0] );
+      exit(1);
+   }
+   
+   // connect to syndicate
+   rc = syndicate_client_init( &state, &opts, &ug_opts );
+   if( rc != 0 ) {
+      SG_error("syndicate_client_init rc = %d\n", rc );
+      exit(1);
+   }
+   
+   // get volume ID
+   volume_id = ms_client_get_volume_id( state.ms );
+   
+   // get directory id and parse it
+   rc = sscanf( argv[local_optind], "%" PRIX64, &file_id );
+   if( rc != 1 ) {
+      SG_error("failed to parse directory ID '%s'\n", argv[local_optind] );
+      exit(1);
+   }
+   
+   printf("\n\n\nBegin lease\n\n\n");
+   
+   clock_gettime( CLOCK_REALTIME, &before );
+   
+   // no lease yet 
+   print_lease( state.ms, file_id, "nothing (expect -ENOENT)", NULL, 0 );
+   
+   ms_client_make_path_ent( &path_ent, volume_id, 0, file_id, 0, 0, 0, 0, 0, NULL, NULL );
+   
+   rc = ms_client_getattr( state.ms, &path_ent, &result );
+   if( rc != 0 ) {
+      SG_error("ms_client_getattr rc = %d\n", rc );
+      exit(1);
+   }
+   
+   ms_client_multi_result_free( &result );
+   
+   clock_gettime( CLOCK_REALTIME, &after );
+   
+   // have a lease; it should cover entries loaded after it was granted, but not before 
+   print_lease( state.ms, file_id, "itself (expect 0)", NULL, 0 );
+   print_lease( state.ms, file_id, "entries loaded before the grant (expect -ESTALE)", &before, INT32_MAX );
+   print_lease( state.ms, file_id, "entries loaded after the grant (expect 0)", &after, INT32_MAX );
+   print_lease( state.ms, file_id, "entries that must never be stale (expect -ESTALE)", &after, 0 );
+   
+   // renewing with the same generation keeps covering them 
+   rc = ms_client_getattr( state.ms, &path_ent, &result );
+   if( rc != 0 ) {
+      SG_error("ms_client_getattr rc = %d\n", rc );
+      exit(1);
+   }
+   
+   ms_client_multi_result_free( &result );
+   
+   print_lease( state.ms, file_id, "entries loaded after the first grant (expect 0, unless a child changed in between)", &after, INT32_MAX );
+   
+   // revoked leases cover nothing 
+   ms_client_lease_revoke( state.ms, file_id );
+   
+   print_lease( state.ms, file_id, "nothing (expect -ENOENT)", &after, INT32_MAX );
+   
+   printf("\n\n\nEnd lease\n\n\n");
+   
+   syndicate_client_shutdown( &state, 0 );
+   
+   return 0;
+}
@@ -0,0 +1,28 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifndef _LIBSYNDICATE_MS_LEASE_TEST_H_
+#define _LIBSYNDICATE_MS_LEASE_TEST_H_
+
+#include "libsyndicate/ms/getattr.h"
+#include "libsyndicate/ms/lease.h"
+#include "libsyndicate/opts.h"
+#include "libsyndicateUG/syndicate.h"
+#include "libsyndicateUG/client.h"
+
+#include "common.h"
+
+#endif
@@ -0,0 +1,257 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// streaming listdir against a local stand-in MS.
+// The stand-in serves signed, paginated listings of one directory, taking DELAY_MS to serve each page.
+// The test checks that every child arrives exactly once, and that the first page reaches the caller
+// before the MS has finished serving the last page.
+
+#include "../standin-ms.h"
+#include "libsyndicate/ms/listdir.h"
+
+#define STANDIN_PARENT_ID 0x1234
+
+// the directory the stand-in MS serves
+struct listdir_stream_dir {
+   int64_t num_children;
+   int64_t page_size;
+
+   pthread_mutex_t lock;
+   int64_t num_served;
+   struct timespec last_served;
+};
+
+// test state
+struct listdir_stream_test {
+   set<uint64_t>* seen;
+   int64_t num_pages;
+   int apply_ms;
+
+   pthread_mutex_t lock;
+   bool have_first_page;
+   struct timespec first_page;
+};
+
+static struct standin_ms g_ms;
+static struct listdir_stream_dir g_dir;
+
+// fill in a listing reply for one page of the directory
+static void listdir_stream_listing( struct listdir_stream_dir* dir, int page_id, ms::ms_reply* reply ) {
+
+   ms::ms_listing* listing = reply->mutable_listing();
+   listing->set_status( ms::ms_listing::NEW );
+   listing->set_ftype( MD_ENTRY_DIR );
+
+   for( int64_t i = page_id * dir->page_size; i < (page_id + 1) * dir->page_size && i < dir->num_children; i++ ) {
+
+      char name[50];
+      sprintf( name, "child-%" PRId64, i );
+
+      ms::ms_entry* ent = listing->add_entries();
+
+      ent->set_type( MD_ENTRY_FILE );
+      ent->set_file_id( STANDIN_PARENT_ID + 1 + i );
+      ent->set_ctime_sec( 1 );
+      ent->set_ctime_nsec( 0 );
+      ent->set_mtime_sec( 1 );
+      ent->set_mtime_nsec( 0 );
+      ent->set_manifest_mtime_sec( 1 );
+      ent->set_manifest_mtime_nsec( 0 );
+      ent->set_owner( 1 );
+      ent->set_coordinator( 1 );
+      ent->set_volume( STANDIN_VOLUME_ID );
+      ent->set_mode( 0644 );
+      ent->set_size( 0 );
+      ent->set_version( 1 );
+      ent->set_max_read_freshness( 5000 );
+      ent->set_max_write_freshness( 0 );
+      ent->set_name( string(name) );
+      ent->set_write_nonce( 1 );
+      ent->set_xattr_nonce( 1 );
+      ent->set_generation( i + 1 );
+      ent->set_parent_id( STANDIN_PARENT_ID );
+   }
+}
+
+// serve GET /FILE/LISTDIR/$VOLUME_ID/$FILE_ID?page_id=$PAGE_ID
+static struct md_HTTP_response* standin_ms_GET_handler( struct md_HTTP_connection_data* con_data ) {
+
+   struct md_HTTP_response* resp = SG_CALLOC( struct md_HTTP_response, 1 );
+   uint64_t volume_id = 0;
+   uint64_t file_id = 0;
+   int page_id = -1;
+   ms::ms_reply reply;
+
+   if( resp == NULL ) {
+      return NULL;
+   }
+
+   int rc = sscanf( con_data->url_path, "/FILE/LISTDIR/%" PRIu64 "/%" PRIX64, &volume_id, &file_id );
+   if( rc != 2 || volume_id != STANDIN_VOLUME_ID || file_id != STANDIN_PARENT_ID || con_data->query_string == NULL ) {
+
+      standin_ms_respond_status( resp, 404 );
+      return resp;
+   }
+
+   if( sscanf( con_data->query_string, "page_id=%d", &page_id ) != 1 || page_id < 0 ) {
+
+      standin_ms_respond_status( resp, 400 );
+      return resp;
+   }
+
+   standin_ms_delay( &g_ms );
+
+   listdir_stream_listing( &g_dir, page_id, &reply );
+   standin_ms_respond( &g_ms, resp, &reply );
+
+   pthread_mutex_lock( &g_dir.lock );
+
+   g_dir.num_served++;
+   clock_gettime( CLOCK_MONOTONIC, &g_dir.last_served );
+
+   pthread_mutex_unlock( &g_dir.lock );
+
+   return resp;
+}
+
+// consume a page of the listing
+static int listdir_stream_page( struct ms_client* client, struct md_entry* ents, size_t num_ents, void* cls ) {
+
+   struct listdir_stream_test* test = (struct listdir_stream_test*)cls;
+   int rc = 0;
+
+   pthread_mutex_lock( &test->lock );
+
+   if( !test->have_first_page ) {
+
+      clock_gettime( CLOCK_MONOTONIC, &test->first_page );
+      test->have_first_page = true;
+   }
+
+   test->num_pages++;
+
+   for( size_t i = 0; i < num_ents; i++ ) {
+
+      if( test->seen->count( ents[i].file_id ) > 0 ) {
+
+         SG_error("Duplicate child %" PRIX64 " (%s)\n", ents[i].file_id, ents[i].name );
+         rc = -EBADMSG;
+         continue;
+      }
+
+      test->seen->insert( ents[i].file_id );
+   }
+
+   pthread_mutex_unlock( &test->lock );
+
+   // simulate merging the page into the filesystem
+   usleep( test->apply_ms * 1000 );
+
+   return rc;
+}
+
+int usage( char const* prog_name ) {
+
+   fprintf(stderr, "Usage: %s PORT NUM_CHILDREN PAGE_SIZE DELAY_MS APPLY_MS\n", prog_name );
+   return 0;
+}
+
+int main( int argc, char** argv ) {
+
+   int rc = 0;
+   int portnum = 0;
+   int delay_ms = 0;
+   int reply_error = 0;
+   struct listdir_stream_test test;
+
+   if( argc != 6 ) {
+      usage( argv[0] );
+      exit(1);
+   }
+
+   memset( &g_dir, 0, sizeof(struct listdir_stream_dir) );
+   memset( &test, 0, sizeof(struct listdir_stream_test) );
+
+   portnum = strtol( argv[1], NULL, 10 );
+   g_dir.num_children = strtoll( argv[2], NULL, 10 );
+   g_dir.page_size = strtoll( argv[3], NULL, 10 );
+   delay_ms = strtol( argv[4], NULL, 10 );
+   test.apply_ms = strtol( argv[5], NULL, 10 );
+
+   if( portnum <= 0 || g_dir.num_children <= 0 || g_dir.page_size <= 0 ) {
+      usage( argv[0] );
+      exit(1);
+   }
+
+   pthread_mutex_init( &g_dir.lock, NULL );
+   pthread_mutex_init( &test.lock, NULL );
+
+   test.seen = new set<uint64_t>();
+
+   rc = standin_ms_start( &g_ms, portnum, delay_ms, standin_ms_GET_handler, NULL );
+   if( rc != 0 ) {
+      SG_error("standin_ms_start(%d) rc = %d\n", portnum, rc );
+      exit(1);
+   }
+
+   struct ms_client* client = &g_ms.client;
+
+   client->page_size = g_dir.page_size;
+
+   // list the directory twice: once cold, and once with the window sized from the first listing's history
+   for( int round = 0; round < 2; round++ ) {
+
+      struct timespec start, end;
+
+      test.seen->clear();
+      test.num_pages = 0;
+      test.have_first_page = false;
+      g_dir.num_served = 0;
+
+      clock_gettime( CLOCK_MONOTONIC, &start );
+
+      rc = ms_client_listdir_stream( client, STANDIN_PARENT_ID, g_dir.num_children, -1, g_dir.num_children, listdir_stream_page, &test, &reply_error );
+
+      clock_gettime( CLOCK_MONOTONIC, &end );
+
+      if( rc != 0 ) {
+         SG_error("ms_client_listdir_stream rc = %d, reply_error = %d\n", rc, reply_error );
+         exit(1);
+      }
+
+      if( (int64_t)test.seen->size() != g_dir.num_children ) {
+         SG_error("Got %zu children, expected %" PRId64 "\n", test.seen->size(), g_dir.num_children );
+         exit(1);
+      }
+
+      if( standin_ms_timespec_us( &test.first_page ) >= standin_ms_timespec_us( &g_dir.last_served ) ) {
+         SG_error("%s", "First page was not delivered until the whole listing was served\n");
+         exit(1);
+      }
+
+      printf("round %d: %" PRId64 " children in %" PRId64 " pages (%" PRId64 " served), %" PRId64 " us total, first page after %" PRId64 " us; page latency %" PRId64 " us, page apply %" PRId64 " us\n",
+             round, (int64_t)test.seen->size(), test.num_pages, g_dir.num_served, standin_ms_timespec_us( &end ) - standin_ms_timespec_us( &start ), standin_ms_timespec_us( &test.first_page ) - standin_ms_timespec_us( &start ),
+             client->listdir_page_latency_us, client->listdir_page_apply_us );
+   }
+
+   standin_ms_stop( &g_ms );
+
+   delete test.seen;
+
+   printf("OK\n");
+
+   return 0;
+}
@@ -0,0 +1,166 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "standin-ms.h"
+
+// start a stand-in MS on portnum, serving GETs with get_handler and POSTs with post_finish (if not NULL),
+// and connect ms->client to it.
+// return 0 on success
+// return negative on error
+int standin_ms_start( struct standin_ms* ms, int portnum, int delay_ms, standin_ms_GET_handler_t get_handler, standin_ms_POST_finish_t post_finish ) {
+
+   int rc = 0;
+
+   memset( ms, 0, sizeof(struct standin_ms) );
+
+   ms->delay_ms = delay_ms;
+
+   curl_global_init( CURL_GLOBAL_ALL );
+   md_crypt_init();
+
+   // the stand-in MS's volume key
+   rc = md_generate_key( &ms->volume_key );
+   if( rc != 0 ) {
+      SG_error("md_generate_key rc = %d\n", rc );
+      return rc;
+   }
+
+   rc = md_public_key_from_private_key( &ms->volume.volume_public_key, ms->volume_key );
+   if( rc != 0 ) {
+      SG_error("md_public_key_from_private_key rc = %d\n", rc );
+      return rc;
+   }
+
+   ms->volume.volume_id = STANDIN_VOLUME_ID;
+
+   // start the stand-in MS
+   md_default_conf( &ms->conf, SYNDICATE_UG );
+
+   ms->conf.num_http_threads = 8;
+   ms->conf.verify_peer = false;
+
+   md_HTTP_init( &ms->http, MD_HTTP_TYPE_STATEMACHINE );
+   md_HTTP_GET( ms->http, get_handler );
+
+   if( post_finish != NULL ) {
+      md_HTTP_POST_iterator( ms->http, md_response_buffer_upload_iterator );
+      md_HTTP_POST_finish( ms->http, post_finish );
+   }
+
+   rc = md_start_HTTP( &ms->http, portnum, &ms->conf );
+   if( rc != 0 ) {
+      SG_error("md_start_HTTP(%d) rc = %d\n", portnum, rc );
+      return rc;
+   }
+
+   // connect a client to it
+   sprintf( ms->url, "http://localhost:%d", portnum );
+   ms->conf.metadata_url = ms->url;
+
+   rc = ms_client_init( &ms->client, SYNDICATE_UG, &ms->conf );
+   if( rc != 0 ) {
+      SG_error("ms_client_init rc = %d\n", rc );
+
+      md_stop_HTTP( &ms->http );
+      md_free_HTTP( &ms->http );
+      return rc;
+   }
+
+   ms->client.volume = &ms->volume;
+   ms->client.max_connections = MS_CLIENT_DEFAULT_MAX_CONNECTIONS;
+   ms->client.ms_transfer_timeout = MS_CLIENT_DEFAULT_MS_TRANSFER_TIMEOUT;
+   ms->client.userpass = strdup("test:test");
+
+   return 0;
+}
+
+// stop the client's downloads and the stand-in MS
+int standin_ms_stop( struct standin_ms* ms ) {
+
+   md_downloader_stop( &ms->client.dl );
+   md_stop_HTTP( &ms->http );
+   md_free_HTTP( &ms->http );
+
+   return 0;
+}
+
+// simulate the MS's latency
+void standin_ms_delay( struct standin_ms* ms ) {
+   usleep( ms->delay_ms * 1000 );
+}
+
+// sign and serialize a reply (its error code is 0 unless the caller set it)
+// return 0 on success, and set *buf and *buf_len
+int standin_ms_reply( struct standin_ms* ms, ms::ms_reply* reply, char** buf, size_t* buf_len ) {
+
+   reply->set_volume_version( 1 );
+   reply->set_cert_version( 1 );
+
+   if( !reply->has_error() ) {
+      reply->set_error( 0 );
+   }
+
+   int rc = md_sign< ms::ms_reply >( ms->volume_key, reply );
+   if( rc != 0 ) {
+      SG_error("md_sign rc = %d\n", rc );
+      return rc;
+   }
+
+   return md_serialize< ms::ms_reply >( reply, buf, buf_len );
+}
+
+// respond with a reply, or with a 500 if we couldn't make it
+void standin_ms_respond( struct standin_ms* ms, struct md_HTTP_response* resp, ms::ms_reply* reply ) {
+
+   char* buf = NULL;
+   size_t buf_len = 0;
+
+   int rc = standin_ms_reply( ms, reply, &buf, &buf_len );
+   if( rc != 0 ) {
+
+      standin_ms_respond_status( resp, 500 );
+      return;
+   }
+
+   md_create_HTTP_response_ram( resp, "application/octet-stream", 200, buf, buf_len );
+   free( buf );
+}
+
+// respond with an HTTP error
+void standin_ms_respond_status( struct md_HTTP_response* resp, int status ) {
+
+   char const* msg = NULL;
+
+   switch( status ) {
+      case 400:
+         msg = "Bad request\n";
+         break;
+
+      case 404:
+         msg = "Not found\n";
+         break;
+
+      default:
+         msg = "Internal error\n";
+         break;
+   }
+
+   md_create_HTTP_response_ram( resp, "text/plain", status, msg, strlen(msg) + 1 );
+}
+
+int64_t standin_ms_timespec_us( struct timespec* ts ) {
+   return (int64_t)ts->tv_sec * 1000000L + ts->tv_nsec / 1000L;
+}
@@ -0,0 +1,58 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// A local stand-in MS for tests and benchmarks.
+// It is an HTTP server on localhost that signs its replies with its own volume key, plus an ms_client that trusts that key
+// and talks to it.  Each test supplies the handlers that serve its requests.
+
+#ifndef _LIBSYNDICATE_TEST_STANDIN_MS_H_
+#define _LIBSYNDICATE_TEST_STANDIN_MS_H_
+
+#include "libsyndicate/libsyndicate.h"
+#include "libsyndicate/httpd.h"
+#include "libsyndicate/crypt.h"
+#include "libsyndicate/ms/core.h"
+#include "libsyndicate/ms/volume.h"
+
+#define STANDIN_VOLUME_ID 1
+
+typedef struct md_HTTP_response* (*standin_ms_GET_handler_t)( struct md_HTTP_connection_data* con_data );
+typedef void (*standin_ms_POST_finish_t)( struct md_HTTP_connection_data* con_data );
+
+struct standin_ms {
+   EVP_PKEY* volume_key;        // signs every reply
+   int delay_ms;                // simulated latency of each request
+
+   struct md_syndicate_conf conf;
+   struct md_HTTP http;
+   char url[100];
+
+   struct ms_volume volume;
+   struct ms_client client;     // connected to the stand-in
+};
+
+int standin_ms_start( struct standin_ms* ms, int portnum, int delay_ms, standin_ms_GET_handler_t get_handler, standin_ms_POST_finish_t post_finish );
+int standin_ms_stop( struct standin_ms* ms );
+
+void standin_ms_delay( struct standin_ms* ms );
+
+int standin_ms_reply( struct standin_ms* ms, ms::ms_reply* reply, char** buf, size_t* buf_len );
+void standin_ms_respond( struct standin_ms* ms, struct md_HTTP_response* resp, ms::ms_reply* reply );
+void standin_ms_respond_status( struct md_HTTP_response* resp, int status );
+
+int64_t standin_ms_timespec_us( struct timespec* ts );
+
+#endif
@@ -0,0 +1,325 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// `getfattr -d` over many files, against a local stand-in MS.
+// The stand-in serves NUM_FILES files with NUM_XATTRS xattrs each, taking DELAY_MS to serve each request.
+// For each file, getfattr lists the xattrs and then reads each one.  We do this twice:
+// once with a listxattr request plus one getxattr request per xattr (the old UG behavior), and
+// once with a single getallxattrs request whose results answer the list and the reads (the UG caches the whole set).
+// The test checks that both ways see the same xattrs, and that the batched way sends one request per file.
+
+#include "../standin-ms.h"
+#include "libsyndicate/ms/xattr.h"
+
+#define STANDIN_FILE_ID_BASE 0x1000
+
+// the files the stand-in MS serves, and the requests it has served
+struct xattr_bench_files {
+   int64_t num_files;
+   int num_xattrs;
+
+   pthread_mutex_t lock;
+   int64_t num_getxattr;
+   int64_t num_listxattr;
+   int64_t num_getallxattrs;
+};
+
+static struct standin_ms g_ms;
+static struct xattr_bench_files g_files;
+
+static void xattr_bench_name( int i, char* name ) {
+   sprintf( name, "user.xattr-%d", i );
+}
+
+static void xattr_bench_value( uint64_t file_id, int i, char* value ) {
+   sprintf( value, "value-%" PRIX64 "-%d", file_id, i );
+}
+
+// serve GET /FILE/{GETXATTR,LISTXATTR,GETALLXATTRS}/$VOLUME_ID/$FILE_ID[/$XATTR_NAME]
+static struct md_HTTP_response* standin_ms_GET_handler( struct md_HTTP_connection_data* con_data ) {
+
+   struct md_HTTP_response* resp = SG_CALLOC( struct md_HTTP_response, 1 );
+   uint64_t volume_id = 0;
+   uint64_t file_id = 0;
+   char method[50];
+   char xattr_name[100];
+   char name[100];
+   char value[100];
+   ms::ms_reply reply;
+   int64_t* counter = NULL;
+
+   if( resp == NULL ) {
+      return NULL;
+   }
+
+   memset( xattr_name, 0, 100 );
+
+   int rc = sscanf( con_data->url_path, "/FILE/%49[A-Z]/%" PRIu64 "/%" PRIX64 "/%99s", method, &volume_id, &file_id, xattr_name );
+   if( rc < 3 || volume_id != STANDIN_VOLUME_ID || file_id < STANDIN_FILE_ID_BASE || file_id >= (uint64_t)(STANDIN_FILE_ID_BASE + g_files.num_files) ) {
+
+      standin_ms_respond_status( resp, 404 );
+      return resp;
+   }
+
+   standin_ms_delay( &g_ms );
+
+   if( strcmp( method, "GETXATTR" ) == 0 && rc == 4 ) {
+
+      int i = -1;
+      if( sscanf( xattr_name, "user.xattr-%d", &i ) != 1 || i < 0 || i >= g_files.num_xattrs ) {
+
+         standin_ms_respond_status( resp, 404 );
+         return resp;
+      }
+
+      xattr_bench_value( file_id, i, value );
+      reply.set_xattr_value( string(value) );
+
+      counter = &g_files.num_getxattr;
+   }
+   else if( strcmp( method, "LISTXATTR" ) == 0 ) {
+
+      for( int i = 0; i < g_files.num_xattrs; i++ ) {
+
+         xattr_bench_name( i, name );
+         reply.add_xattr_names( string(name) );
+      }
+
+      counter = &g_files.num_listxattr;
+   }
+   else if( strcmp( method, "GETALLXATTRS" ) == 0 ) {
+
+      for( int i = 0; i < g_files.num_xattrs; i++ ) {
+
+         xattr_bench_name( i, name );
+         xattr_bench_value( file_id, i, value );
+
+         reply.add_xattr_names( string(name) );
+         reply.add_xattr_values( string(value) );
+      }
+
+      reply.set_xattr_nonce( (int64_t)file_id );
+
+      counter = &g_files.num_getallxattrs;
+   }
+   else {
+
+      standin_ms_respond_status( resp, 400 );
+      return resp;
+   }
+
+   standin_ms_respond( &g_ms, resp, &reply );
+
+   pthread_mutex_lock( &g_files.lock );
+
+   (*counter)++;
+
+   pthread_mutex_unlock( &g_files.lock );
+
+   return resp;
+}
+
+// check a value we got for a file's xattr
+static int xattr_bench_check( uint64_t file_id, char const* xattr_name, char const* xattr_value, size_t xattr_value_len ) {
+
+   int i = -1;
+   char expected[100];
+
+   if( sscanf( xattr_name, "user.xattr-%d", &i ) != 1 ) {
+      SG_error("Unexpected xattr '%s'\n", xattr_name );
+      return -EBADMSG;
+   }
+
+   xattr_bench_value( file_id, i, expected );
+
+   if( xattr_value_len != strlen(expected) || memcmp( xattr_value, expected, xattr_value_len ) != 0 ) {
+      SG_error("%" PRIX64 ": %s = '%.*s', expected '%s'\n", file_id, xattr_name, (int)xattr_value_len, xattr_value, expected );
+      return -EBADMSG;
+   }
+
+   return 0;
+}
+
+// getfattr -d on one file, one xattr at a time
+// return the number of xattrs read on success
+// return negative on error
+static int xattr_bench_dump_each( struct ms_client* client, uint64_t file_id ) {
+
+   char* names = NULL;
+   size_t names_len = 0;
+   int num_read = 0;
+
+   int rc = ms_client_listxattr( client, STANDIN_VOLUME_ID, file_id, &names, &names_len );
+   if( rc != 0 ) {
+      SG_error("ms_client_listxattr(%" PRIX64 ") rc = %d\n", file_id, rc );
+      return rc;
+   }
+
+   for( size_t off = 0; off < names_len; off += strlen(names + off) + 1 ) {
+
+      char* value = NULL;
+      size_t value_len = 0;
+
+      rc = ms_client_getxattr( client, STANDIN_VOLUME_ID, file_id, names + off, &value, &value_len );
+      if( rc != 0 ) {
+         SG_error("ms_client_getxattr(%" PRIX64 ", %s) rc = %d\n", file_id, names + off, rc );
+         break;
+      }
+
+      rc = xattr_bench_check( file_id, names + off, value, value_len );
+      free( value );
+
+      if( rc != 0 ) {
+         break;
+      }
+
+      num_read++;
+   }
+
+   free( names );
+
+   return (rc == 0 ? num_read : rc);
+}
+
+// getfattr -d on one file, with all xattrs fetched at once (the list and the reads are then served from the set)
+// return the number of xattrs read on success
+// return negative on error
+static int xattr_bench_dump_all( struct ms_client* client, uint64_t file_id ) {
+
+   char** names = NULL;
+   char** values = NULL;
+   size_t* value_lens = NULL;
+   int64_t xattr_nonce = 0;
+   int num_read = 0;
+
+   int rc = ms_client_getallxattrs( client, STANDIN_VOLUME_ID, file_id, &xattr_nonce, &names, &values, &value_lens );
+   if( rc != 0 ) {
+      SG_error("ms_client_getallxattrs(%" PRIX64 ") rc = %d\n", file_id, rc );
+      return rc;
+   }
+
+   if( xattr_nonce != (int64_t)file_id ) {
+      SG_error("%" PRIX64 ": xattr nonce %" PRId64 "\n", file_id, xattr_nonce );
+      rc = -EBADMSG;
+   }
+
+   for( int i = 0; rc == 0 && names[i] != NULL; i++ ) {
+
+      rc = xattr_bench_check( file_id, names[i], values[i], value_lens[i] );
+      if( rc == 0 ) {
+         num_read++;
+      }
+   }
+
+   ms_client_xattrs_free( names, values, value_lens );
+
+   return (rc == 0 ? num_read : rc);
+}
+
+int usage( char const* prog_name ) {
+
+   fprintf(stderr, "Usage: %s PORT NUM_FILES NUM_XATTRS DELAY_MS\n", prog_name );
+   return 0;
+}
+
+int main( int argc, char** argv ) {
+
+   int rc = 0;
+   int portnum = 0;
+   int delay_ms = 0;
+   int64_t elapsed_us[2];
+   int64_t num_requests[2];
+
+   if( argc != 5 ) {
+      usage( argv[0] );
+      exit(1);
+   }
+
+   memset( &g_files, 0, sizeof(struct xattr_bench_files) );
+
+   portnum = strtol( argv[1], NULL, 10 );
+   g_files.num_files = strtoll( argv[2], NULL, 10 );
+   g_files.num_xattrs = strtol( argv[3], NULL, 10 );
+   delay_ms = strtol( argv[4], NULL, 10 );
+
+   if( portnum <= 0 || g_files.num_files <= 0 || g_files.num_xattrs < 0 ) {
+      usage( argv[0] );
+      exit(1);
+   }
+
+   pthread_mutex_init( &g_files.lock, NULL );
+
+   rc = standin_ms_start( &g_ms, portnum, delay_ms, standin_ms_GET_handler, NULL );
+   if( rc != 0 ) {
+      SG_error("standin_ms_start(%d) rc = %d\n", portnum, rc );
+      exit(1);
+   }
+
+   // dump every file's xattrs: first one xattr at a time, and then all at once
+   for( int round = 0; round < 2; round++ ) {
+
+      struct timespec start, end;
+
+      g_files.num_getxattr = 0;
+      g_files.num_listxattr = 0;
+      g_files.num_getallxattrs = 0;
+
+      clock_gettime( CLOCK_MONOTONIC, &start );
+
+      for( int64_t i = 0; i < g_files.num_files; i++ ) {
+
+         uint64_t file_id = STANDIN_FILE_ID_BASE + i;
+
+         if( round == 0 ) {
+            rc = xattr_bench_dump_each( &g_ms.client, file_id );
+         }
+         else {
+            rc = xattr_bench_dump_all( &g_ms.client, file_id );
+         }
+
+         if( rc < 0 ) {
+            SG_error("dump %" PRIX64 " rc = %d\n", file_id, rc );
+            exit(1);
+         }
+
+         if( rc != g_files.num_xattrs ) {
+            SG_error("%" PRIX64 ": got %d xattrs, expected %d\n", file_id, rc, g_files.num_xattrs );
+            exit(1);
+         }
+      }
+
+      clock_gettime( CLOCK_MONOTONIC, &end );
+
+      elapsed_us[round] = standin_ms_timespec_us( &end ) - standin_ms_timespec_us( &start );
+      num_requests[round] = g_files.num_getxattr + g_files.num_listxattr + g_files.num_getallxattrs;
+
+      printf("%s: %" PRId64 " files x %d xattrs in %" PRId64 " us; %" PRId64 " MS requests (%" PRId64 " listxattr, %" PRId64 " getxattr, %" PRId64 " getallxattrs)\n",
+             (round == 0 ? "per-xattr" : "batched"), g_files.num_files, g_files.num_xattrs, elapsed_us[round], num_requests[round], g_files.num_listxattr, g_files.num_getxattr, g_files.num_getallxattrs );
+   }
+
+   if( num_requests[1] != g_files.num_files ) {
+      SG_error("Batched dump sent %" PRId64 " requests for %" PRId64 " files\n", num_requests[1], g_files.num_files );
+      exit(1);
+   }
+
+   printf("speedup: %.2fx\n", (double)elapsed_us[0] / (double)MAX( elapsed_us[1], 1 ) );
+
+   standin_ms_stop( &g_ms );
+
+   printf("OK\n");
+
+   return 0;
+}
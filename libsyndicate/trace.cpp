@@ -0,0 +1,347 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "trace.h"
+
+#include <sys/syscall.h>
+
+volatile int md_trace_sample_rate = 0;
+
+static md_trace_ring_list_t* md_trace_rings = NULL;     // every ring, including ones whose threads exited
+static pthread_mutex_t md_trace_rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t md_trace_ring_key;
+static bool md_trace_inited = false;
+
+static uint64_t md_trace_next_id = 1;
+
+static uint64_t md_trace_now_us(void) {
+   struct timespec ts;
+   clock_gettime( CLOCK_MONOTONIC, &ts );
+   return (uint64_t)ts.tv_sec * 1000000LL + (uint64_t)ts.tv_nsec / 1000LL;
+}
+
+// release an exiting thread's ring for reuse (its spans stay dumpable until then)
+static void md_trace_ring_release( void* arg ) {
+
+   struct md_trace_ring* ring = (struct md_trace_ring*)arg;
+
+   pthread_mutex_lock( &md_trace_rings_lock );
+
+   ring->in_use = false;
+   ring->trace_id = 0;
+
+   pthread_mutex_unlock( &md_trace_rings_lock );
+}
+
+
+// get the calling thread's ring, reusing an exited thread's ring or making a new one if need be
+// return NULL if out of memory, or if tracing is not initialized
+static struct md_trace_ring* md_trace_get_ring(void) {
+
+   if( !md_trace_inited ) {
+      return NULL;
+   }
+
+   struct md_trace_ring* ring = (struct md_trace_ring*)pthread_getspecific( md_trace_ring_key );
+   if( ring != NULL ) {
+      return ring;
+   }
+
+   pid_t tid = (pid_t)syscall( SYS_gettid );
+
+   pthread_mutex_lock( &md_trace_rings_lock );
+
+   for( unsigned int i = 0; i < md_trace_rings->size(); i++ ) {
+
+      if( !md_trace_rings->at(i)->in_use ) {
+         ring = md_trace_rings->at(i);
+         break;
+      }
+   }
+
+   if( ring == NULL ) {
+
+      ring = SG_CALLOC( struct md_trace_ring, 1 );
+      if( ring == NULL ) {
+
+         pthread_mutex_unlock( &md_trace_rings_lock );
+         return NULL;
+      }
+
+      try {
+         md_trace_rings->push_back( ring );
+      }
+      catch( bad_alloc& ba ) {
+
+         pthread_mutex_unlock( &md_trace_rings_lock );
+         free( ring );
+         return NULL;
+      }
+   }
+
+   ring->tid = tid;
+   ring->in_use = true;
+
+   pthread_mutex_unlock( &md_trace_rings_lock );
+
+   pthread_setspecific( md_trace_ring_key, ring );
+
+   return ring;
+}
+
+
+// set up tracing.  Sample one in every sample_rate requests (0 disables tracing)
+// return 0 on success
+// return -ENOMEM if out of memory
+int md_trace_init( int sample_rate ) {
+
+   pthread_mutex_lock( &md_trace_rings_lock );
+
+   if( !md_trace_inited ) {
+
+      md_trace_rings = SG_safe_new( md_trace_ring_list_t() );
+      if( md_trace_rings == NULL ) {
+
+         pthread_mutex_unlock( &md_trace_rings_lock );
+         return -ENOMEM;
+      }
+
+      pthread_key_create( &md_trace_ring_key, md_trace_ring_release );
+      md_trace_inited = true;
+   }
+
+   pthread_mutex_unlock( &md_trace_rings_lock );
+
+   md_trace_sample_rate = MAX( sample_rate, 0 );
+
+   if( md_trace_sample_rate > 0 ) {
+      SG_debug("Tracing 1 in every %d requests\n", md_trace_sample_rate );
+   }
+
+   return 0;
+}
+
+
+// stop tracing and free all rings.
+// only call this once no other threads are tracing
+int md_trace_shutdown(void) {
+
+   md_trace_sample_rate = 0;
+
+   pthread_mutex_lock( &md_trace_rings_lock );
+
+   if( md_trace_inited ) {
+
+      pthread_key_delete( md_trace_ring_key );
+
+      for( unsigned int i = 0; i < md_trace_rings->size(); i++ ) {
+         free( md_trace_rings->at(i) );
+      }
+
+      SG_safe_delete( md_trace_rings );
+      md_trace_inited = false;
+   }
+
+   pthread_mutex_unlock( &md_trace_rings_lock );
+
+   return 0;
+}
+
+
+// begin a request, and decide whether or not to sample it
+void md_trace_request_begin_ex( struct md_trace_span* span, char const* name, uint64_t arg ) {
+
+   struct md_trace_ring* ring = md_trace_get_ring();
+   if( ring == NULL ) {
+      return;
+   }
+
+   if( ring->trace_id != 0 ) {
+      // already in a sampled request (i.e. a request nested in another); record it as an ordinary span
+      md_trace_begin_ex( span, name, arg );
+      return;
+   }
+
+   ring->num_requests++;
+
+   int sample_rate = md_trace_sample_rate;
+   if( sample_rate <= 0 || (ring->num_requests % sample_rate) != 0 ) {
+      // not sampled
+      return;
+   }
+
+   ring->trace_id = __sync_fetch_and_add( &md_trace_next_id, 1 );
+
+   span->name = name;
+   span->arg = arg;
+   span->root = true;
+   span->active = true;
+   span->start_us = md_trace_now_us();
+}
+
+
+// begin a span, if the thread is in a sampled request
+void md_trace_begin_ex( struct md_trace_span* span, char const* name, uint64_t arg ) {
+
+   struct md_trace_ring* ring = (md_trace_inited ? (struct md_trace_ring*)pthread_getspecific( md_trace_ring_key ) : NULL);
+
+   if( ring == NULL || ring->trace_id == 0 ) {
+      return;
+   }
+
+   span->name = name;
+   span->arg = arg;
+   span->root = false;
+   span->active = true;
+   span->start_us = md_trace_now_us();
+}
+
+
+// finish a span, and record it into the thread's ring
+void md_trace_end_ex( struct md_trace_span* span ) {
+
+   struct md_trace_ring* ring = (md_trace_inited ? (struct md_trace_ring*)pthread_getspecific( md_trace_ring_key ) : NULL);
+
+   span->active = false;
+
+   if( ring == NULL || ring->trace_id == 0 ) {
+      return;
+   }
+
+   struct md_trace_event* ev = &ring->events[ ring->num_events % MD_TRACE_RING_SIZE ];
+
+   ev->name = span->name;
+   ev->trace_id = ring->trace_id;
+   ev->arg = span->arg;
+   ev->start_us = span->start_us;
+   ev->duration_us = md_trace_now_us() - span->start_us;
+
+   // publish it only once it's complete
+   __sync_synchronize();
+   ring->num_events++;
+
+   if( span->root ) {
+      // request is over
+      ring->trace_id = 0;
+   }
+}
+
+
+// write a JSON string, escaping it as needed
+static void md_trace_write_json_string( FILE* f, char const* str ) {
+
+   fputc( '"', f );
+
+   for( char const* p = str; *p != '\0'; p++ ) {
+
+      if( *p == '"' || *p == '\\' ) {
+         fputc( '\\', f );
+         fputc( *p, f );
+      }
+      else if( (unsigned char)*p < 0x20 ) {
+         fprintf( f, "\\u%04x", (unsigned char)*p );
+      }
+      else {
+         fputc( *p, f );
+      }
+   }
+
+   fputc( '"', f );
+}
+
+
+// write out every thread's recorded spans as Chrome trace JSON ("X" events, one per span)
+// return 0 on success
+// return -EIO if we failed to write
+int md_trace_dump( FILE* f ) {
+
+   bool first = true;
+   pid_t pid = getpid();
+
+   fprintf( f, "{\"traceEvents\":[\n" );
+
+   pthread_mutex_lock( &md_trace_rings_lock );
+
+   if( md_trace_inited ) {
+
+      for( unsigned int i = 0; i < md_trace_rings->size(); i++ ) {
+
+         struct md_trace_ring* ring = md_trace_rings->at(i);
+
+         uint64_t num_events = ring->num_events;
+         uint64_t start = (num_events > MD_TRACE_RING_SIZE ? num_events - MD_TRACE_RING_SIZE : 0);
+
+         __sync_synchronize();
+
+         for( uint64_t j = start; j < num_events; j++ ) {
+
+            struct md_trace_event* ev = &ring->events[ j % MD_TRACE_RING_SIZE ];
+
+            if( ev->name == NULL ) {
+               continue;
+            }
+
+            if( !first ) {
+               fprintf( f, ",\n" );
+            }
+
+            first = false;
+
+            fprintf( f, "{\"name\":" );
+            md_trace_write_json_string( f, ev->name );
+            fprintf( f, ",\"ph\":\"X\",\"ts\":%" PRIu64 ",\"dur\":%" PRIu64 ",\"pid\":%d,\"tid\":%d,\"args\":{\"trace_id\":%" PRIu64 ",\"arg\":\"%" PRIX64 "\"}}",
+                     ev->start_us, ev->duration_us, (int)pid, (int)ring->tid, ev->trace_id, ev->arg );
+         }
+      }
+   }
+
+   pthread_mutex_unlock( &md_trace_rings_lock );
+
+   fprintf( f, "\n],\"displayTimeUnit\":\"ms\"}\n" );
+
+   if( ferror( f ) ) {
+      return -EIO;
+   }
+
+   return 0;
+}
+
+
+// write out every thread's recorded spans to a file, as Chrome trace JSON
+// return 0 on success
+// return -errno on failure
+int md_trace_dump_path( char const* path ) {
+
+   FILE* f = fopen( path, "w" );
+   if( f == NULL ) {
+
+      int errsv = -errno;
+      SG_error("fopen(%s) errno = %d\n", path, errsv );
+      return errsv;
+   }
+
+   int rc = md_trace_dump( f );
+
+   if( fclose( f ) != 0 && rc == 0 ) {
+      rc = -errno;
+   }
+
+   if( rc != 0 ) {
+      SG_error("Failed to write trace to %s, rc = %d\n", path, rc );
+   }
+
+   return rc;
+}
@@ -0,0 +1,111 @@
+/*
+   Copyright 2014 The Trustees of Princeton University
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+// Lightweight request tracing.
+// A request (e.g. a FUSE read) opens a root span with md_trace_request_begin(); one in every md_trace_sample_rate
+// requests is sampled.  While a sampled request runs, every span its thread opens with md_trace_begin() is recorded
+// into that thread's ring buffer, which holds the last MD_TRACE_RING_SIZE spans.  md_trace_dump() writes all threads'
+// rings out as Chrome trace JSON (load it in chrome://tracing).
+// With tracing off, opening and closing a span costs a branch each.
+
+#ifndef _LIBSYNDICATE_TRACE_H_
+#define _LIBSYNDICATE_TRACE_H_
+
+#include "util.h"
+
+#include <inttypes.h>
+#include <vector>
+
+using namespace std;
+
+#define MD_TRACE_RING_SIZE 4096
+
+// a finished span
+struct md_trace_event {
+   char const* name;            // static string
+   uint64_t trace_id;           // request this span belongs to
+   uint64_t arg;                // span-specific argument (i.e. file ID or block ID)
+   uint64_t start_us;           // CLOCK_MONOTONIC microseconds
+   uint64_t duration_us;
+};
+
+// one thread's recent spans.  Only its thread writes to it; dumps read it concurrently, so a dump can contain a span
+// that is being overwritten.
+struct md_trace_ring {
+   struct md_trace_event events[ MD_TRACE_RING_SIZE ];
+   uint64_t num_events;         // number of spans ever written (the next one goes to num_events % MD_TRACE_RING_SIZE)
+
+   pid_t tid;                   // thread that owns (or last owned) this ring
+   bool in_use;                 // false once the thread exits (so the ring can be reused)
+
+   uint64_t trace_id;           // sampled request in progress, or 0 if none
+   uint64_t num_requests;       // number of requests begun (for sampling)
+};
+
+typedef vector<struct md_trace_ring*> md_trace_ring_list_t;
+
+// an open span (lives on the caller's stack)
+struct md_trace_span {
+   char const* name;
+   uint64_t arg;
+   uint64_t start_us;
+   bool active;                 // being recorded?
+   bool root;                   // is this a request's root span?
+};
+
+extern "C" {
+
+// set to 0 to disable tracing
+extern volatile int md_trace_sample_rate;
+
+int md_trace_init( int sample_rate );
+int md_trace_shutdown(void);
+
+void md_trace_request_begin_ex( struct md_trace_span* span, char const* name, uint64_t arg );
+void md_trace_begin_ex( struct md_trace_span* span, char const* name, uint64_t arg );
+void md_trace_end_ex( struct md_trace_span* span );
+
+int md_trace_dump( FILE* f );
+int md_trace_dump_path( char const* path );
+
+}
+
+// begin a request's root span.  If the request is sampled, its thread records every span until md_trace_end() on this one.
+static inline void md_trace_request_begin( struct md_trace_span* span, char const* name, uint64_t arg ) {
+   span->active = false;
+
+   if( __builtin_expect( md_trace_sample_rate > 0, 0 ) ) {
+      md_trace_request_begin_ex( span, name, arg );
+   }
+}
+
+// begin a span within a request.  It is recorded only if the request is sampled.
+static inline void md_trace_begin( struct md_trace_span* span, char const* name, uint64_t arg ) {
+   span->active = false;
+
+   if( __builtin_expect( md_trace_sample_rate > 0, 0 ) ) {
+      md_trace_begin_ex( span, name, arg );
+   }
+}
+
+// end a span, recording it if need be
+static inline void md_trace_end( struct md_trace_span* span ) {
+   if( __builtin_expect( span->active, 0 ) ) {
+      md_trace_end_ex( span );
+   }
+}
+
+#endif
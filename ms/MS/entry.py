@@ -327,6 +327,21 @@ class MSEntryXAttr( storagetypes.Object ):
       
       return 0, visible_names
    
+   @classmethod
+   def GetAllXAttrs( cls, volume, msent, requester_owner_id, caller_is_admin=False ):
+      """
+      Get the names and values of all of this MSEntry's xattrs that are readable by the requester.
+      Return (0, names, values) on success.
+      """
+      xattrs = cls.ListAll( {"MSEntryXAttr.file_id ==": msent.file_id, "MSEntryXAttr.volume_id ==": msent.volume_id} )
+      
+      readable = filter( lambda xattr: cls.XAttrReadable( requester_owner_id, xattr, caller_is_admin ), xattrs )
+      
+      names = [xattr.xattr_name for xattr in readable]
+      values = [xattr.xattr_value for xattr in readable]
+      
+      return 0, names, values
+   
    @classmethod
    def ReadXAttr( cls, volume_id, file_id, xattr_name ):
       """
@@ -758,6 +773,50 @@ class MSEntryVacuumLog( storagetypes.Object ):
          return 0
 
 
+class MSEntryVacuumOrphan( storagetypes.Object ):
+   """
+   Record of a file that was deleted before its vacuum log was drained.
+   The file's vacuum log outlives it, and only the file's last coordinator may drain it.
+   """
+   
+   file_id = storagetypes.String( default="None" )
+   volume_id = storagetypes.Integer( default=-1 )
+   coordinator_id = storagetypes.Integer( default=-1, indexed=False )
+   
+   @classmethod
+   def make_key_name( cls, volume_id, file_id ):
+      return "MSEntryVacuumOrphan: volume_id=%s,file_id=%s" % (volume_id, file_id)
+   
+   @classmethod
+   def create_async( cls, _volume_id, _file_id, _coordinator_id ):
+      
+      key_name = MSEntryVacuumOrphan.make_key_name( _volume_id, _file_id )
+      
+      return MSEntryVacuumOrphan.get_or_insert_async( key_name,
+                                                      volume_id=_volume_id,
+                                                      file_id=_file_id,
+                                                      coordinator_id=_coordinator_id )
+   
+   @classmethod
+   def Read( cls, volume_id, file_id ):
+      """
+      Get the orphan record for a deleted file, or None if there is none.
+      """
+      
+      key_name = MSEntryVacuumOrphan.make_key_name( volume_id, file_id )
+      return storagetypes.make_key( MSEntryVacuumOrphan, key_name ).get()
+   
+   @classmethod
+   def Remove( cls, volume_id, file_id ):
+      """
+      Forget a deleted file, once its vacuum log is empty.
+      """
+      
+      key_name = MSEntryVacuumOrphan.make_key_name( volume_id, file_id )
+      storagetypes.make_key( MSEntryVacuumOrphan, key_name ).delete()
+      return 0
+
+
 
 class MSEntry( storagetypes.Object ):
    """
@@ -2045,8 +2104,35 @@ class MSEntry( storagetypes.Object ):
          
          return src_absent_rc
       
-      # put a new nameholder for src
-      new_nameholder_fut = MSEntryNameHolder.create_async( volume_id, dest_parent_id, src_file_id, dest_name )
+      # claim dest's name for src.  It may be free, or held by dest (which we're overwriting), but if anything else holds it,
+      # then it was created (or renamed there) since the client looked, and src would end up sharing a name with it.
+      new_nameholder_key_name = MSEntryNameHolder.make_key_name( volume_id, dest_parent_id, dest_name )
+      new_nameholder_key = storagetypes.make_key( MSEntryNameHolder, new_nameholder_key_name )
+      
+      allowed_file_ids = [src_file_id]
+      if dest is not None:
+         allowed_file_ids.append( dest_file_id )
+      
+      def claim_dest_name_txn():
+         nameholder = new_nameholder_key.get()
+         if nameholder is not None and nameholder.file_id not in allowed_file_ids:
+            return -errno.EEXIST
+         
+         nameholder = MSEntryNameHolder( key=new_nameholder_key, volume_id=volume_id, parent_id=dest_parent_id, file_id=src_file_id, name=dest_name )
+         nameholder.put()
+         return 0
+      
+      rc = storagetypes.transaction( claim_dest_name_txn )
+      
+      storagetypes.memcache.delete( new_nameholder_key_name )
+      
+      if rc != 0:
+         logging.error("Rename %s: /%s/%s/%s already exists" % (src_file_id, volume_id, dest_parent_id, dest_name))
+         
+         if dest != None:
+            MSEntry.__delete_undo( dest )
+         
+         return rc
       
       # we're good to go
       src_write_attrs = {
@@ -2056,12 +2142,13 @@ class MSEntry( storagetypes.Object ):
          "mtime_nsec": src_attrs['mtime_nsec']
       }
       
+      # dest's nameholder is src's now, so leave it be
       if dest is not None:
-         dest_delete_fut = MSEntry.__delete_finish_async( volume, dest_parent, dest )
+         dest_delete_fut = MSEntry.__delete_finish_async( volume, dest_parent, dest, delete_nameholder=False )
       
       src_write_fut = MSEntry.__write_msentry_async( src, volume.num_shards, write_base=True, **src_write_attrs )
       
-      futs = [src_write_fut, new_nameholder_fut]
+      futs = [src_write_fut]
       
       if dest_delete_fut != None:
          futs.append( dest_delete_fut )
@@ -2089,18 +2176,30 @@ class MSEntry( storagetypes.Object ):
    
    @classmethod
    @storagetypes.concurrent
-   def __delete_begin_async( cls, volume, ent ):
+   def __delete_begin_async( cls, volume, ent, defer_vacuum=False ):
       """
       Begin deleting an entry by marking it as deleted.
       Verify that it is empty if it is a directory.
+      If defer_vacuum is True, a file may be deleted before its vacuum log is drained; its coordinator will drain it afterwards.
       """
       
       ent_cache_key_name = MSEntry.cache_key_name( ent.volume_id, ent.file_id )
       ent_key_name = MSEntry.make_key_name( ent.volume_id, ent.file_id )
       
-      # mark as deleted.  Creates will fail from now on
-      ent.deleted = True
-      yield ent.put_async()
+      # mark as deleted.  Creates will fail from now on.
+      # A file whose vacuum log outlives it gets its orphan record in the same transaction, so there is an orphan record if and only if the delete happened.
+      if ent.ftype != MSENTRY_TYPE_DIR and defer_vacuum:
+         
+         def delete_mark_txn():
+            ent.deleted = True
+            ent.put()
+            MSEntryVacuumOrphan.create_async( ent.volume_id, ent.file_id, ent.coordinator_id ).get_result()
+         
+         yield storagetypes.transaction_async( delete_mark_txn, xg=True )
+      
+      else:
+         ent.deleted = True
+         yield ent.put_async()
       
       # clear from cache
       storagetypes.memcache.delete( ent_cache_key_name )
@@ -2125,8 +2224,9 @@ class MSEntry( storagetypes.Object ):
             storagetypes.concurrent_return( -errno.ENOTEMPTY )
          
                
-      # otherwise, ent is a file.  Make sure there are no outstanding writes that need to be vacuumed 
-      else:
+      # otherwise, ent is a file.  Unless its coordinator will vacuum its outstanding writes later (and has kept access to the
+      # vacuum log through the orphan record), make sure there are no outstanding writes that need to be vacuumed 
+      elif not defer_vacuum:
          # log check---there must be no outstanding writes 
          vacuum_log_head_list = yield MSEntryVacuumLog.Peek( ent.volume_id, ent.file_id, async=True )
          
@@ -2146,8 +2246,8 @@ class MSEntry( storagetypes.Object ):
       
       
    @classmethod
-   def __delete_begin( cls, volume, ent ):
-      delete_fut = MSEntry.__delete_begin_async( volume, ent )
+   def __delete_begin( cls, volume, ent, defer_vacuum=False ):
+      delete_fut = MSEntry.__delete_begin_async( volume, ent, defer_vacuum=defer_vacuum )
       rc = delete_fut.get_result()
       return rc
    
@@ -2169,10 +2269,11 @@ class MSEntry( storagetypes.Object ):
    
    @classmethod
    @storagetypes.concurrent
-   def __delete_finish_async( cls, volume, parent_ent, ent ):
+   def __delete_finish_async( cls, volume, parent_ent, ent, delete_nameholder=True ):
       """
       Finish deleting an entry.
       Remove it and its nameholder and xattrs, update its parent's shard, and update the index
+      If delete_nameholder is False, leave the nameholder alone (a rename has taken it over).
       """
 
       if not ent.deleted:
@@ -2196,7 +2297,11 @@ class MSEntry( storagetypes.Object ):
       nh_key = storagetypes.make_key( MSEntryNameHolder, MSEntryNameHolder.make_key_name( volume_id, parent_id, ent.name ) )
       
       # queue delete this entry and its nameholders
-      storagetypes.deferred.defer( MSEntry.delete_all, [nh_key, ent_key] + ent_shard_keys )
+      delete_keys = [ent_key] + ent_shard_keys
+      if delete_nameholder:
+         delete_keys.append( nh_key )
+      
+      storagetypes.deferred.defer( MSEntry.delete_all, delete_keys )
       
       # queue delete xattrs
       storagetypes.deferred.defer( MSEntryXAttr.Delete_ByFile, volume.volume_id, ent.file_id )
@@ -2230,11 +2335,12 @@ class MSEntry( storagetypes.Object ):
       return 0
 
    @classmethod
-   def Delete( cls, user_owner_id, volume, **ent_attrs ):
+   def Delete( cls, user_owner_id, volume, defer_vacuum=False, **ent_attrs ):
       
       # delete an MSEntry.
       # A file will be deleted by at most one UG
       # A directy can be deleted by anyone, and it must be empty
+      # A file with outstanding writes can only be deleted if its coordinator defers vacuuming them
 
       volume_id = volume.volume_id
       file_id = ent_attrs['file_id']
@@ -2287,7 +2393,7 @@ class MSEntry( storagetypes.Object ):
       
       ret = 0
       
-      rc = MSEntry.__delete_begin( volume, ent )
+      rc = MSEntry.__delete_begin( volume, ent, defer_vacuum=defer_vacuum )
       if rc == 0:
          ret = MSEntry.__delete_finish( volume, parent_ent, ent )
       else:
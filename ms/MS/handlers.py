@@ -442,6 +442,7 @@ class MSFileHandler(webapp2.RequestHandler):
    get_api_calls = {
       "GETXATTR":       lambda gateway, volume, file_id, args, kw: file_xattr_getxattr( gateway, volume, file_id, *args, **kw ),    # args == [xattr_name]
       "LISTXATTR":      lambda gateway, volume, file_id, args, kw: file_xattr_listxattr( gateway, volume, file_id, *args, **kw ),   # args == []
+      "GETALLXATTRS":   lambda gateway, volume, file_id, args, kw: file_xattr_getallxattrs( gateway, volume, file_id, *args, **kw ),   # args == []
       "GETATTR":        lambda gateway, volume, file_id, args, kw: file_getattr( gateway, volume, file_id, *args, **kw ),           # args == [file_version_str, write_nonce]
       "GETCHILD":       lambda gateway, volume, file_id, args, kw: file_getchild( gateway, volume, file_id, *args, **kw ),          # args == [name]
       "LISTDIR":        lambda gateway, volume, file_id, args, kw: file_listdir( gateway, volume, file_id, *args, **kw ),           # args == [], kw={page_id, lug}
@@ -451,6 +452,7 @@ class MSFileHandler(webapp2.RequestHandler):
    get_benchmark_headers = {
       "GETXATTR":               "X-Getxattr-Time",
       "LISTXATTR":              "X-Listxattr-Time",
+      "GETALLXATTRS":           "X-Getallxattrs-Time",
       "GETATTR":                "X-Getattr-Time",
       "GETCHILD":               "X-Getchild-Time",
       "LISTDIR":                "X-Listdir-Time",
@@ -682,6 +684,10 @@ class MSFileHandler(webapp2.RequestHandler):
             rc = benchmark( benchmark_header, timing, lambda: api_call( reply, gateway, volume, update ) )
             reply.errors.append( rc )
             
+            if rc == 0:
+               # leases on the affected directories no longer cover their old children
+               file_lease_invalidate( volume, update )
+            
             num_processed += 1
             
          except storagetypes.RequestDeadlineExceededError, de:
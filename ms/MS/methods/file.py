@@ -113,6 +113,83 @@ def file_read_allowed( owner_id, file_data ):
    return error
 
 
+# ----------------------------------
+def file_lease_generation_key_name( volume_id, file_id ):
+   """
+   Memcache key for the generation of a directory's children.
+   """
+   return "MSLeaseGeneration: volume_id=%s,file_id=%s" % (volume_id, file_id)
+
+
+# ----------------------------------
+def file_lease_generation( volume_id, file_id ):
+   """
+   Get the generation of a directory's children, which tags the leases we grant on it.
+   If we lost track of it, start a new one, so leases that get renewed stop covering what the caller cached before.
+   """
+   key_name = file_lease_generation_key_name( volume_id, file_id )
+   
+   generation = storagetypes.memcache.get( key_name )
+   if generation is None:
+      
+      storagetypes.memcache.add( key_name, random.randint( 0, 2**62 ) )
+      generation = storagetypes.memcache.get( key_name )
+      
+      if generation is None:
+         # memcache is unavailable; this lease will never be renewed with the same generation
+         generation = random.randint( 0, 2**62 )
+   
+   return generation
+
+
+# ----------------------------------
+def file_lease_invalidate( volume, update ):
+   """
+   An update changed an entry.  Bump the generation of the directory (or directories) that contain it,
+   so no lease granted on them covers what the caller cached before the update.
+   The root has no parent, so leases on it cover it as well.
+   """
+   
+   dir_ids = []
+   
+   if update.entry.HasField( "parent_id" ):
+      dir_ids.append( update.entry.parent_id )
+   
+   if update.entry.file_id == 0:
+      dir_ids.append( 0 )
+   
+   if update.HasField( "dest" ) and update.dest.HasField( "parent_id" ):
+      dir_ids.append( update.dest.parent_id )
+   
+   for dir_id in set(dir_ids):
+      
+      key_name = file_lease_generation_key_name( volume.volume_id, dir_id )
+      
+      if storagetypes.memcache.incr( key_name ) is None:
+         # not tracked (or memcache is unavailable); start a new generation 
+         storagetypes.memcache.set( key_name, random.randint( 0, 2**62 ) )
+   
+
+# ----------------------------------
+def file_lease_grant( reply, volume, file_data ):
+   """
+   Grant the caller a lease on a directory it read, good for as long as the directory would stay fresh.
+   """
+   
+   if file_data.ftype != MSENTRY_TYPE_DIR:
+      return 
+   
+   lease_ttl = min( file_data.max_read_freshness, msconfig.METADATA_LEASE_MAX_TTL )
+   if lease_ttl <= 0:
+      return 
+   
+   file_id = MSEntry.serialize_id( file_data.file_id )
+   
+   reply.lease_file_id = file_id
+   reply.lease_generation = file_lease_generation( volume.volume_id, file_id )
+   reply.lease_ttl = lease_ttl
+   
+
 # ----------------------------------
 def _getattr( owner_id, volume, file_id, file_version, write_nonce ):
    """
@@ -179,6 +256,9 @@ def _getattr( owner_id, volume, file_id, file_version, write_nonce ):
          file_data.protobuf( ent_pb, num_children=num_children, generation=generation )
          
          # logging.info("Getattr %s: Serve back: %s" % (file_id, file_data))
+      
+      # whether or not it changed, the caller can trust the directory's children for a while
+      file_lease_grant( reply, volume, file_data )
          
    else:
       # not possible to reply
@@ -237,6 +317,8 @@ def _getchild( owner_id, volume, parent_id, name ):
       file_data.protobuf( ent_pb, num_children=num_children )
       
       # logging.info("Getchild %s: Serve back: %s" % (parent_id, file_data))
+      
+      file_lease_grant( reply, volume, file_data )
    
    else:
       # not possible to reply
@@ -518,9 +600,12 @@ def file_delete( reply, gateway, volume, update, async=False ):
          
       attrs = MSEntry.unprotobuf_dict( update.entry )
    
-      logging.info("delete /%s/%s (%s)" % (attrs['volume_id'], attrs['file_id'], attrs['name'] ) )
+      # will the coordinator vacuum outstanding writes after the delete?
+      defer_vacuum = update.HasField("defer_vacuum") and update.defer_vacuum
+      
+      logging.info("delete /%s/%s (%s), defer_vacuum = %s" % (attrs['volume_id'], attrs['file_id'], attrs['name'], defer_vacuum ) )
    
-      rc = MSEntry.Delete( gateway.owner_id, volume, **attrs )
+      rc = MSEntry.Delete( gateway.owner_id, volume, defer_vacuum=defer_vacuum, **attrs )
    
       logging.info("delete /%s/%s (%s) rc = %s" % (attrs['volume_id'], attrs['file_id'], attrs['name'], rc ) )
       
@@ -848,6 +933,28 @@ def file_xattr_listxattr_response( volume, rc, xattr_names ):
    return file_update_complete_response( volume, reply )
 
 
+# ----------------------------------
+def file_xattr_getallxattrs_response( volume, rc, xattr_names, xattr_values, xattr_nonce ):
+   """
+   Generate a serialized, signed ms_reply protobuf from
+   a getallxattrs return code (rc), the xattr names and values, and the file's xattr nonce.
+   """
+
+   # create and sign the response 
+   reply = file_update_init_response( volume )
+   reply.error = rc
+   
+   if rc == 0:
+      
+      for (name, value) in zip( xattr_names, xattr_values ):
+         reply.xattr_names.append( name )
+         reply.xattr_values.append( value )
+      
+      reply.xattr_nonce = xattr_nonce
+      
+   return file_update_complete_response( volume, reply )
+
+
 # ----------------------------------
 def file_xattr_getxattr( gateway, volume, file_id, xattr_name, caller_is_admin=False ):
    """
@@ -903,6 +1010,40 @@ def file_xattr_listxattr( gateway, volume, file_id, unused=None, caller_is_admin
    return file_xattr_listxattr_response( volume, rc, xattr_names )
 
 
+# ----------------------------------
+def file_xattr_getallxattrs( gateway, volume, file_id, unused=None, caller_is_admin=False ):
+   """
+   Get the names and values of all of a file's extended attributes that the caller can read,
+   along with the file's xattr nonce (so the caller can cache them as a set).
+   This is part of the File Metadata API.
+   
+   NOTE: unused=None is required for the File Metadata API dispatcher to work.
+   """
+   
+   logging.info("getallxattrs /%s/%s" % (volume.volume_id, file_id) )
+
+   rc, msent = file_xattr_get_and_check_msentry_readable( gateway, volume, file_id, caller_is_admin )
+   xattr_names = []
+   xattr_values = []
+   xattr_nonce = 0
+   
+   if rc == 0 and msent != None:
+      
+      # get gateway owner ID
+      gateway_owner_id = GATEWAY_ID_ANON
+      if gateway is not None:
+         gateway_owner_id = gateway.owner_id
+      
+      xattr_nonce = msent.xattr_nonce
+      
+      # get the xattrs
+      rc, xattr_names, xattr_values = MSEntryXAttr.GetAllXAttrs( volume, msent, gateway_owner_id, caller_is_admin )
+   
+   logging.info("getallxattrs /%s/%s rc = %d" % (volume.volume_id, file_id, rc) )
+
+   return file_xattr_getallxattrs_response( volume, rc, xattr_names, xattr_values, xattr_nonce )
+
+
 # ----------------------------------
 def file_xattr_setxattr( reply, gateway, volume, update, caller_is_admin=False ):
    """
@@ -1080,11 +1221,30 @@ def file_xattr_chownxattr( reply, gateway, volume, update, caller_is_admin=False
 
 
 # ----------------------------------
-def file_vacuum_log_check_access( gateway, msent ):
+def file_vacuum_log_check_access( gateway, coordinator_id ):
    """
    Verify that the gateway is allowed to manipulate the MSEntry's manifest log.
    """
-   return msent.coordinator_id == gateway.g_id
+   return coordinator_id == gateway.g_id
+
+
+# ----------------------------------
+def file_vacuum_log_get_coordinator( volume, file_id ):
+   """
+   Get the ID of the gateway that may manipulate a file's vacuum log.
+   This is the file's coordinator, or its last coordinator if it was deleted before its log was drained.
+   Return (coordinator_id, orphaned), or (None, False) if there is no such file.
+   """
+   
+   msent = MSEntry.Read( volume, file_id )
+   if msent is not None:
+      return (msent.coordinator_id, False)
+   
+   orphan = MSEntryVacuumOrphan.Read( volume.volume_id, file_id )
+   if orphan is not None:
+      return (orphan.coordinator_id, True)
+   
+   return (None, False)
 
 
 # ----------------------------------
@@ -1118,15 +1278,15 @@ def file_vacuum_log_peek( gateway, volume, file_id, caller_is_admin=False ):
    rc = 0
    log_head = None
    
-   msent = MSEntry.Read( volume, file_id )
-   if msent is None:
+   coordinator_id, orphaned = file_vacuum_log_get_coordinator( volume, file_id )
+   if coordinator_id is None:
       logging.error("No entry for %s" % file_id)
       rc = -errno.ENOENT 
       
    else:
       
       # security check
-      if not caller_is_admin and not file_vacuum_log_check_access( gateway, msent ):
+      if not caller_is_admin and not file_vacuum_log_check_access( gateway, coordinator_id ):
          logging.error("Gateway %s is not allowed to access the vacuum log of %s" % (gateway.name, file_id))
          rc = -errno.EACCES
       
@@ -1137,6 +1297,10 @@ def file_vacuum_log_peek( gateway, volume, file_id, caller_is_admin=False ):
          if log_head_list is None or len(log_head_list) == 0:
             # no more data
             rc = -errno.ENOENT 
+            
+            if orphaned:
+               # deleted file is fully vacuumed 
+               MSEntryVacuumOrphan.Remove( volume.volume_id, file_id )
          
          else:
             log_head = log_head_list[0]
@@ -1175,15 +1339,15 @@ def file_vacuum_log_remove( reply, gateway, volume, update, caller_is_admin=Fals
       manifest_mtime_sec = attrs['manifest_mtime_sec']
       manifest_mtime_nsec = attrs['manifest_mtime_nsec']
       
-      # get msent
-      msent = MSEntry.Read( volume, file_id )
-      if msent is None:
+      # get the coordinator
+      coordinator_id, _ = file_vacuum_log_get_coordinator( volume, file_id )
+      if coordinator_id is None:
          logging.error("No entry for %s" % file_id )
          rc = -errno.ENOENT
       
       else:
          # security check 
-         if not caller_is_admin and not file_vacuum_log_check_access( gateway, msent ):
+         if not caller_is_admin and not file_vacuum_log_check_access( gateway, coordinator_id ):
             logging.error("Gateway %s is not allowed to access the vacuum log of %s" % (gateway.name, file_id))
             rc = -errno.EACCES 
             
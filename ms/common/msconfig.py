@@ -169,3 +169,6 @@ MAX_TRANSFER_TIME = 300
 
 # RESOLVE_MAX_PAGE_SIZE = 3       # for testing
 
+# metadata leases on directories last as long as the directory's max_read_freshness, up to this many milliseconds (0 disables them)
+METADATA_LEASE_MAX_TTL = 60000
+
@@ -44,6 +44,7 @@ handlers = [
     (r'[/]+FILE[/]+(LISTDIR)[/]+([0123456789]+)[/]+([0123456789ABCDEF]+)[/]*', MSFileHandler ),                                           # GET: for listing file metadata
     (r'[/]+FILE[/]+(GETXATTR)[/]+([0123456789]+)[/]+([0123456789ABCDEF]+)[/]+([a-zA-Z0-9!\"#$%&\'\(\)\*\+,\-.:;<=>?@\[\\\]^_`\{\|\}~]+)[/]*', MSFileHandler ),  # GET: for getting xattrs.
     (r'[/]+FILE[/]+(LISTXATTR)[/]+([0123456789]+)[/]+([0123456789ABCDEF]+)[/]*', MSFileHandler ),                                        # GET: for listing xattrs.
+    (r'[/]+FILE[/]+(GETALLXATTRS)[/]+([0123456789]+)[/]+([0123456789ABCDEF]+)[/]*', MSFileHandler ),                                     # GET: for getting all xattrs at once.
     (r'[/]+FILE[/]+(VACUUM)[/]+([0123456789]+)[/]+([0123456789ABCDEF]+)[/]*', MSFileHandler ),
     (r'[/]+FILE[/]+([0123456789]+)[/]*', MSFileHandler ),                         # POST: for creating, updating, deleting, renaming, changing coordinator, setting/deleting/chown-ing/chmod-ing xattrs, and garbage collection
                                                                                   # The specific operation is encoded in the posted data.  This handler dispatches the call to the appropriate objects.